@@ -85,6 +85,9 @@ public:
     uint64_t m_neighborDepletedStorageDelaySeconds;
     uint64_t m_fragmentBundlesLargerThanBytes;
     bool m_enforceBundlePriority;
+    uint64_t m_numIngressWorkerThreads; //0 => bundles are processed on the induct thread which received them
+    uint64_t m_moduleBusBatchMaxMessages; //bundles (or acks) per ingress to egress/storage (or egress to ingress) zmq message, 1 => no batching
+    uint64_t m_moduleBusBatchLingerMicroseconds; //longest a partial batch waits for more bundles (or acks) before it is sent
 
     //pub-sub from router to all modules (defined in HdtnConfig as the TCP socket is used by hdtn-one-process)
     uint16_t m_zmqBoundRouterPubSubPortPath;
@@ -34,12 +34,16 @@
 
 struct storage_disk_config_t {
     std::string name;
+    /// Path of the disk's store file, or (Linux only) of a raw block device or partition whose size is probed with the
+    /// BLKGETSIZE64 ioctl and must hold at least totalStorageCapacityBytes divided by the number of disks
     std::string storeFilePath;
+    /// Open the store file with O_DIRECT (FILE_FLAG_NO_BUFFERING on Windows) to bypass the OS page cache (optional json key, default false)
+    bool useDirectIo;
 
     CONFIG_LIB_EXPORT storage_disk_config_t();
     CONFIG_LIB_EXPORT ~storage_disk_config_t();
 
-    CONFIG_LIB_EXPORT storage_disk_config_t(const std::string & paramName, const std::string & paramStoreFilePath);
+    CONFIG_LIB_EXPORT storage_disk_config_t(const std::string & paramName, const std::string & paramStoreFilePath, const bool paramUseDirectIo = false);
     CONFIG_LIB_EXPORT bool operator==(const storage_disk_config_t & other) const;
 
 
@@ -90,7 +94,7 @@ public:
     CONFIG_LIB_EXPORT virtual boost::property_tree::ptree GetNewPropertyTree() const override;
     CONFIG_LIB_EXPORT virtual bool SetValuesFromPropertyTree(const boost::property_tree::ptree & pt) override;
 
-    CONFIG_LIB_EXPORT void AddDisk(const std::string & name, const std::string & storeFilePath);
+    CONFIG_LIB_EXPORT void AddDisk(const std::string & name, const std::string & storeFilePath, const bool useDirectIo = false);
 public:
 
     std::string m_storageImplementation;
@@ -98,6 +102,45 @@ public:
     bool m_autoDeleteFilesOnExit;
     uint64_t m_totalStorageCapacityBytes;
     std::string m_storageDeletionPolicy;
+    /// Upper bound in bytes of one coalesced (vectored) disk read or write of adjacent segments (optional json key, default 131072).
+    /// Values of one segment or less disable coalescing.
+    uint64_t m_maxCoalescedDiskIoSizeBytes;
+    /// When storageImplementation is "ram", back each disk's memory region with huge pages (optional json key, default false).
+    /// Falls back to normal pages if huge pages cannot be reserved.
+    bool m_ramStorageUseHugePages;
+    /// Path of the append-only catalog journal (optional json key, default empty which disables the journal).
+    /// A snapshot of the catalog is kept beside it at the same path with ".snapshot" appended, so that a restore
+    /// only has to load the snapshot and replay the journal instead of scanning every segment of every disk.
+    std::string m_catalogJournalFilePath;
+    /// Number of journal records after which a new catalog snapshot is written and the journal is restarted (optional json key, default 100000).
+    uint64_t m_catalogJournalSnapshotIntervalRecords;
+    /// Seconds before a scheduled contact begins that the router tells storage to preload the outduct's next bundles into RAM
+    /// (optional json key, default 5, 0 disables preloading).
+    uint64_t m_preloadSecondsBeforeContact;
+    /// Upper bound in bytes of the bundles preloaded into RAM for one outduct ahead of its contact (optional json key, default 16777216).
+    uint64_t m_preloadMaxBytesPerOutduct;
+    /// Upper bound in bytes of the RAM hot tier which keeps newly stored bundles in memory and writes them to disk lazily
+    /// (optional json key, default 0 disables the hot tier so every bundle is written to disk immediately).
+    uint64_t m_ramHotTierMaxBytes;
+    /// Milliseconds a bundle may stay in the RAM hot tier before it is written to disk (optional json key, default 1000).
+    uint64_t m_ramHotTierMaxResidentMilliseconds;
+    /// Bypass the RAM hot tier for bundles with custody so that they are written to disk immediately (optional json key, default true).
+    bool m_ramHotTierWriteCustodyBundlesImmediately;
+    /// Number of release worker threads, each owning a shard of the outducts, which read the bundles released from storage
+    /// off the disks in parallel (optional json key, default 0 reads them on the storage thread).
+    uint64_t m_numReleaseWorkerThreads;
+    /// Upper bound in bytes of the storage segments used as small-bundle slabs, which pack bundles small enough for a slab slot
+    /// into shared segments instead of one segment each; every slab segment is also mirrored in RAM
+    /// (optional json key, default 0 stores every bundle in its own segments).
+    uint64_t m_smallBundleSlabMaxBytes;
+    /// Maximum rate in bytes per second at which the blocks of freed storage segments are handed back to the disk
+    /// (punched out of the store file, or discarded if the store is a block device) in batches by a background thread
+    /// (optional json key, default 0 never reclaims freed blocks).
+    uint64_t m_diskSpaceReclaimMaxBytesPerSecond;
+    /// Measure each disk's throughput and steer the segments of new bundles away from the disks that are falling behind,
+    /// so that a slow disk among fast ones does not pace the whole store (optional json key, default false stripes every
+    /// bundle's segments evenly across the disks).
+    bool m_adaptiveDiskStriping;
     storage_disk_config_vector_t m_storageDiskConfigVector;
 };
 
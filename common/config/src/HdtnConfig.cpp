@@ -42,6 +42,9 @@ HdtnConfig::HdtnConfig() :
     m_neighborDepletedStorageDelaySeconds(0),
     m_fragmentBundlesLargerThanBytes(0),
     m_enforceBundlePriority(false),
+    m_numIngressWorkerThreads(0),
+    m_moduleBusBatchMaxMessages(1),
+    m_moduleBusBatchLingerMicroseconds(200),
     m_zmqBoundRouterPubSubPortPath(10200),
     m_zmqBoundTelemApiPortPath(10305),
     m_inductsConfig(),
@@ -73,6 +76,9 @@ HdtnConfig::HdtnConfig(const HdtnConfig& o) :
     m_neighborDepletedStorageDelaySeconds(o.m_neighborDepletedStorageDelaySeconds),
     m_fragmentBundlesLargerThanBytes(o.m_fragmentBundlesLargerThanBytes),
     m_enforceBundlePriority(o.m_enforceBundlePriority),
+    m_numIngressWorkerThreads(o.m_numIngressWorkerThreads),
+    m_moduleBusBatchMaxMessages(o.m_moduleBusBatchMaxMessages),
+    m_moduleBusBatchLingerMicroseconds(o.m_moduleBusBatchLingerMicroseconds),
     m_zmqBoundRouterPubSubPortPath(o.m_zmqBoundRouterPubSubPortPath),
     m_zmqBoundTelemApiPortPath(o.m_zmqBoundTelemApiPortPath),
     m_inductsConfig(o.m_inductsConfig),
@@ -101,6 +107,9 @@ HdtnConfig::HdtnConfig(HdtnConfig&& o) noexcept :
     m_neighborDepletedStorageDelaySeconds(o.m_neighborDepletedStorageDelaySeconds),
     m_fragmentBundlesLargerThanBytes(o.m_fragmentBundlesLargerThanBytes),
     m_enforceBundlePriority(o.m_enforceBundlePriority),
+    m_numIngressWorkerThreads(o.m_numIngressWorkerThreads),
+    m_moduleBusBatchMaxMessages(o.m_moduleBusBatchMaxMessages),
+    m_moduleBusBatchLingerMicroseconds(o.m_moduleBusBatchLingerMicroseconds),
     m_zmqBoundRouterPubSubPortPath(o.m_zmqBoundRouterPubSubPortPath),
     m_zmqBoundTelemApiPortPath(o.m_zmqBoundTelemApiPortPath),
     m_inductsConfig(std::move(o.m_inductsConfig)),
@@ -129,6 +138,9 @@ HdtnConfig& HdtnConfig::operator=(const HdtnConfig& o) {
     m_neighborDepletedStorageDelaySeconds = o.m_neighborDepletedStorageDelaySeconds;
     m_fragmentBundlesLargerThanBytes = o.m_fragmentBundlesLargerThanBytes;
     m_enforceBundlePriority = o.m_enforceBundlePriority;
+    m_numIngressWorkerThreads = o.m_numIngressWorkerThreads;
+    m_moduleBusBatchMaxMessages = o.m_moduleBusBatchMaxMessages;
+    m_moduleBusBatchLingerMicroseconds = o.m_moduleBusBatchLingerMicroseconds;
     m_zmqBoundRouterPubSubPortPath = o.m_zmqBoundRouterPubSubPortPath;
     m_zmqBoundTelemApiPortPath = o.m_zmqBoundTelemApiPortPath;
     m_inductsConfig = o.m_inductsConfig;
@@ -158,6 +170,9 @@ HdtnConfig& HdtnConfig::operator=(HdtnConfig&& o) noexcept {
     m_neighborDepletedStorageDelaySeconds = o.m_neighborDepletedStorageDelaySeconds;
     m_fragmentBundlesLargerThanBytes = o.m_fragmentBundlesLargerThanBytes;
     m_enforceBundlePriority = o.m_enforceBundlePriority;
+    m_numIngressWorkerThreads = o.m_numIngressWorkerThreads;
+    m_moduleBusBatchMaxMessages = o.m_moduleBusBatchMaxMessages;
+    m_moduleBusBatchLingerMicroseconds = o.m_moduleBusBatchLingerMicroseconds;
     m_zmqBoundRouterPubSubPortPath = o.m_zmqBoundRouterPubSubPortPath;
     m_zmqBoundTelemApiPortPath = o.m_zmqBoundTelemApiPortPath;
     m_inductsConfig = std::move(o.m_inductsConfig);
@@ -186,6 +201,9 @@ bool HdtnConfig::operator==(const HdtnConfig & o) const {
         (m_neighborDepletedStorageDelaySeconds == o.m_neighborDepletedStorageDelaySeconds) &&
         (m_fragmentBundlesLargerThanBytes == o.m_fragmentBundlesLargerThanBytes) &&
         (m_enforceBundlePriority == o.m_enforceBundlePriority) &&
+        (m_numIngressWorkerThreads == o.m_numIngressWorkerThreads) &&
+        (m_moduleBusBatchMaxMessages == o.m_moduleBusBatchMaxMessages) &&
+        (m_moduleBusBatchLingerMicroseconds == o.m_moduleBusBatchLingerMicroseconds) &&
         (m_zmqBoundRouterPubSubPortPath == o.m_zmqBoundRouterPubSubPortPath) &&
         (m_zmqBoundTelemApiPortPath == o.m_zmqBoundTelemApiPortPath) &&
         (m_inductsConfig == o.m_inductsConfig) &&
@@ -222,6 +240,9 @@ bool HdtnConfig::SetValuesFromPropertyTree(const boost::property_tree::ptree & p
         m_neighborDepletedStorageDelaySeconds = pt.get<uint64_t>("neighborDepletedStorageDelaySeconds");
         m_fragmentBundlesLargerThanBytes = pt.get<uint64_t>("fragmentBundlesLargerThanBytes");
         m_enforceBundlePriority = pt.get<bool>("enforceBundlePriority");
+        m_numIngressWorkerThreads = pt.get<uint64_t>("numIngressWorkerThreads", 0); //optional
+        m_moduleBusBatchMaxMessages = pt.get<uint64_t>("moduleBusBatchMaxMessages", 1); //optional
+        m_moduleBusBatchLingerMicroseconds = pt.get<uint64_t>("moduleBusBatchLingerMicroseconds", 200); //optional
 
         m_zmqBoundRouterPubSubPortPath = pt.get<uint16_t>("zmqBoundRouterPubSubPortPath");
         m_zmqBoundTelemApiPortPath = pt.get<uint16_t>("zmqBoundTelemApiPortPath");
@@ -322,6 +343,9 @@ boost::property_tree::ptree HdtnConfig::GetNewPropertyTree() const {
     pt.put("neighborDepletedStorageDelaySeconds", m_neighborDepletedStorageDelaySeconds);
     pt.put("fragmentBundlesLargerThanBytes", m_fragmentBundlesLargerThanBytes);
     pt.put("enforceBundlePriority", m_enforceBundlePriority);
+    pt.put("numIngressWorkerThreads", m_numIngressWorkerThreads);
+    pt.put("moduleBusBatchMaxMessages", m_moduleBusBatchMaxMessages);
+    pt.put("moduleBusBatchLingerMicroseconds", m_moduleBusBatchLingerMicroseconds);
 
     pt.put("zmqBoundRouterPubSubPortPath", m_zmqBoundRouterPubSubPortPath);
     pt.put("zmqBoundTelemApiPortPath", m_zmqBoundTelemApiPortPath);
@@ -19,27 +19,33 @@
 
 static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::none;
 
-static const std::vector<std::string> VALID_STORAGE_IMPLEMENTATION_NAMES = { "stdio_multi_threaded", "asio_single_threaded" };
+static const std::vector<std::string> VALID_STORAGE_IMPLEMENTATION_NAMES = { "stdio_multi_threaded", "asio_single_threaded", "io_uring_single_threaded", "ram" };
 static const std::vector<std::string> VALID_STORAGE_DELETION_POLICIES = { "never", "on_expiration", "on_storage_full" };
+static constexpr uint64_t DEFAULT_MAX_COALESCED_DISK_IO_SIZE_BYTES = 131072; //32 segments of 4KB
+static constexpr uint64_t DEFAULT_CATALOG_JOURNAL_SNAPSHOT_INTERVAL_RECORDS = 100000;
+static constexpr uint64_t DEFAULT_PRELOAD_SECONDS_BEFORE_CONTACT = 5;
+static constexpr uint64_t DEFAULT_PRELOAD_MAX_BYTES_PER_OUTDUCT = 16777216;
+static constexpr uint64_t DEFAULT_RAM_HOT_TIER_MAX_RESIDENT_MILLISECONDS = 1000;
 
-storage_disk_config_t::storage_disk_config_t() : name(""), storeFilePath("") {}
+storage_disk_config_t::storage_disk_config_t() : name(""), storeFilePath(""), useDirectIo(false) {}
 storage_disk_config_t::~storage_disk_config_t() {}
 
-storage_disk_config_t::storage_disk_config_t(const std::string & paramName, const std::string & paramStoreFilePath) :
-    name(paramName), storeFilePath(paramStoreFilePath) {}
+storage_disk_config_t::storage_disk_config_t(const std::string & paramName, const std::string & paramStoreFilePath, const bool paramUseDirectIo) :
+    name(paramName), storeFilePath(paramStoreFilePath), useDirectIo(paramUseDirectIo) {}
 
 //a copy constructor: X(const X&)
 storage_disk_config_t::storage_disk_config_t(const storage_disk_config_t& o) :
-    name(o.name), storeFilePath(o.storeFilePath) { }
+    name(o.name), storeFilePath(o.storeFilePath), useDirectIo(o.useDirectIo) { }
 
 //a move constructor: X(X&&)
 storage_disk_config_t::storage_disk_config_t(storage_disk_config_t&& o) noexcept :
-    name(std::move(o.name)), storeFilePath(std::move(o.storeFilePath)) { }
+    name(std::move(o.name)), storeFilePath(std::move(o.storeFilePath)), useDirectIo(o.useDirectIo) { }
 
 //a copy assignment: operator=(const X&)
 storage_disk_config_t& storage_disk_config_t::operator=(const storage_disk_config_t& o) {
     name = o.name;
     storeFilePath = o.storeFilePath;
+    useDirectIo = o.useDirectIo;
     return *this;
 }
 
@@ -47,11 +53,12 @@ storage_disk_config_t& storage_disk_config_t::operator=(const storage_disk_confi
 storage_disk_config_t& storage_disk_config_t::operator=(storage_disk_config_t&& o) noexcept {
     name = std::move(o.name);
     storeFilePath = std::move(o.storeFilePath);
+    useDirectIo = o.useDirectIo;
     return *this;
 }
 
 bool storage_disk_config_t::operator==(const storage_disk_config_t & other) const {
-    return (name == other.name) && (storeFilePath == other.storeFilePath);
+    return (name == other.name) && (storeFilePath == other.storeFilePath) && (useDirectIo == other.useDirectIo);
 }
 
 StorageConfig::StorageConfig() :
@@ -60,6 +67,19 @@ StorageConfig::StorageConfig() :
     m_autoDeleteFilesOnExit(true),
     m_totalStorageCapacityBytes(1),
     m_storageDeletionPolicy("never"),
+    m_maxCoalescedDiskIoSizeBytes(DEFAULT_MAX_COALESCED_DISK_IO_SIZE_BYTES),
+    m_ramStorageUseHugePages(false),
+    m_catalogJournalFilePath(""),
+    m_catalogJournalSnapshotIntervalRecords(DEFAULT_CATALOG_JOURNAL_SNAPSHOT_INTERVAL_RECORDS),
+    m_preloadSecondsBeforeContact(DEFAULT_PRELOAD_SECONDS_BEFORE_CONTACT),
+    m_preloadMaxBytesPerOutduct(DEFAULT_PRELOAD_MAX_BYTES_PER_OUTDUCT),
+    m_ramHotTierMaxBytes(0),
+    m_ramHotTierMaxResidentMilliseconds(DEFAULT_RAM_HOT_TIER_MAX_RESIDENT_MILLISECONDS),
+    m_ramHotTierWriteCustodyBundlesImmediately(true),
+    m_numReleaseWorkerThreads(0),
+    m_smallBundleSlabMaxBytes(0),
+    m_diskSpaceReclaimMaxBytesPerSecond(0),
+    m_adaptiveDiskStriping(false),
     m_storageDiskConfigVector() { }
 
 StorageConfig::~StorageConfig() {
@@ -72,6 +92,19 @@ StorageConfig::StorageConfig(const StorageConfig& o) :
     m_autoDeleteFilesOnExit(o.m_autoDeleteFilesOnExit),
     m_totalStorageCapacityBytes(o.m_totalStorageCapacityBytes),
     m_storageDeletionPolicy(o.m_storageDeletionPolicy),
+    m_maxCoalescedDiskIoSizeBytes(o.m_maxCoalescedDiskIoSizeBytes),
+    m_ramStorageUseHugePages(o.m_ramStorageUseHugePages),
+    m_catalogJournalFilePath(o.m_catalogJournalFilePath),
+    m_catalogJournalSnapshotIntervalRecords(o.m_catalogJournalSnapshotIntervalRecords),
+    m_preloadSecondsBeforeContact(o.m_preloadSecondsBeforeContact),
+    m_preloadMaxBytesPerOutduct(o.m_preloadMaxBytesPerOutduct),
+    m_ramHotTierMaxBytes(o.m_ramHotTierMaxBytes),
+    m_ramHotTierMaxResidentMilliseconds(o.m_ramHotTierMaxResidentMilliseconds),
+    m_ramHotTierWriteCustodyBundlesImmediately(o.m_ramHotTierWriteCustodyBundlesImmediately),
+    m_numReleaseWorkerThreads(o.m_numReleaseWorkerThreads),
+    m_smallBundleSlabMaxBytes(o.m_smallBundleSlabMaxBytes),
+    m_diskSpaceReclaimMaxBytesPerSecond(o.m_diskSpaceReclaimMaxBytesPerSecond),
+    m_adaptiveDiskStriping(o.m_adaptiveDiskStriping),
     m_storageDiskConfigVector(o.m_storageDiskConfigVector) { }
 
 //a move constructor: X(X&&)
@@ -81,6 +114,19 @@ StorageConfig::StorageConfig(StorageConfig&& o) noexcept :
     m_autoDeleteFilesOnExit(o.m_autoDeleteFilesOnExit),
     m_totalStorageCapacityBytes(o.m_totalStorageCapacityBytes),
     m_storageDeletionPolicy(std::move(o.m_storageDeletionPolicy)),
+    m_maxCoalescedDiskIoSizeBytes(o.m_maxCoalescedDiskIoSizeBytes),
+    m_ramStorageUseHugePages(o.m_ramStorageUseHugePages),
+    m_catalogJournalFilePath(std::move(o.m_catalogJournalFilePath)),
+    m_catalogJournalSnapshotIntervalRecords(o.m_catalogJournalSnapshotIntervalRecords),
+    m_preloadSecondsBeforeContact(o.m_preloadSecondsBeforeContact),
+    m_preloadMaxBytesPerOutduct(o.m_preloadMaxBytesPerOutduct),
+    m_ramHotTierMaxBytes(o.m_ramHotTierMaxBytes),
+    m_ramHotTierMaxResidentMilliseconds(o.m_ramHotTierMaxResidentMilliseconds),
+    m_ramHotTierWriteCustodyBundlesImmediately(o.m_ramHotTierWriteCustodyBundlesImmediately),
+    m_numReleaseWorkerThreads(o.m_numReleaseWorkerThreads),
+    m_smallBundleSlabMaxBytes(o.m_smallBundleSlabMaxBytes),
+    m_diskSpaceReclaimMaxBytesPerSecond(o.m_diskSpaceReclaimMaxBytesPerSecond),
+    m_adaptiveDiskStriping(o.m_adaptiveDiskStriping),
     m_storageDiskConfigVector(std::move(o.m_storageDiskConfigVector)) { }
 
 //a copy assignment: operator=(const X&)
@@ -90,6 +136,19 @@ StorageConfig& StorageConfig::operator=(const StorageConfig& o) {
     m_autoDeleteFilesOnExit = o.m_autoDeleteFilesOnExit;
     m_totalStorageCapacityBytes = o.m_totalStorageCapacityBytes;
     m_storageDeletionPolicy = o.m_storageDeletionPolicy;
+    m_maxCoalescedDiskIoSizeBytes = o.m_maxCoalescedDiskIoSizeBytes;
+    m_ramStorageUseHugePages = o.m_ramStorageUseHugePages;
+    m_catalogJournalFilePath = o.m_catalogJournalFilePath;
+    m_catalogJournalSnapshotIntervalRecords = o.m_catalogJournalSnapshotIntervalRecords;
+    m_preloadSecondsBeforeContact = o.m_preloadSecondsBeforeContact;
+    m_preloadMaxBytesPerOutduct = o.m_preloadMaxBytesPerOutduct;
+    m_ramHotTierMaxBytes = o.m_ramHotTierMaxBytes;
+    m_ramHotTierMaxResidentMilliseconds = o.m_ramHotTierMaxResidentMilliseconds;
+    m_ramHotTierWriteCustodyBundlesImmediately = o.m_ramHotTierWriteCustodyBundlesImmediately;
+    m_numReleaseWorkerThreads = o.m_numReleaseWorkerThreads;
+    m_smallBundleSlabMaxBytes = o.m_smallBundleSlabMaxBytes;
+    m_diskSpaceReclaimMaxBytesPerSecond = o.m_diskSpaceReclaimMaxBytesPerSecond;
+    m_adaptiveDiskStriping = o.m_adaptiveDiskStriping;
     m_storageDiskConfigVector = o.m_storageDiskConfigVector;
     return *this;
 }
@@ -101,6 +160,19 @@ StorageConfig& StorageConfig::operator=(StorageConfig&& o) noexcept {
     m_autoDeleteFilesOnExit = o.m_autoDeleteFilesOnExit;
     m_totalStorageCapacityBytes = o.m_totalStorageCapacityBytes;
     m_storageDeletionPolicy = std::move(o.m_storageDeletionPolicy);
+    m_maxCoalescedDiskIoSizeBytes = o.m_maxCoalescedDiskIoSizeBytes;
+    m_ramStorageUseHugePages = o.m_ramStorageUseHugePages;
+    m_catalogJournalFilePath = std::move(o.m_catalogJournalFilePath);
+    m_catalogJournalSnapshotIntervalRecords = o.m_catalogJournalSnapshotIntervalRecords;
+    m_preloadSecondsBeforeContact = o.m_preloadSecondsBeforeContact;
+    m_preloadMaxBytesPerOutduct = o.m_preloadMaxBytesPerOutduct;
+    m_ramHotTierMaxBytes = o.m_ramHotTierMaxBytes;
+    m_ramHotTierMaxResidentMilliseconds = o.m_ramHotTierMaxResidentMilliseconds;
+    m_ramHotTierWriteCustodyBundlesImmediately = o.m_ramHotTierWriteCustodyBundlesImmediately;
+    m_numReleaseWorkerThreads = o.m_numReleaseWorkerThreads;
+    m_smallBundleSlabMaxBytes = o.m_smallBundleSlabMaxBytes;
+    m_diskSpaceReclaimMaxBytesPerSecond = o.m_diskSpaceReclaimMaxBytesPerSecond;
+    m_adaptiveDiskStriping = o.m_adaptiveDiskStriping;
     m_storageDiskConfigVector = std::move(o.m_storageDiskConfigVector);
     return *this;
 }
@@ -112,6 +184,19 @@ bool StorageConfig::operator==(const StorageConfig & other) const {
         (m_autoDeleteFilesOnExit == other.m_autoDeleteFilesOnExit) &&
         (m_totalStorageCapacityBytes == other.m_totalStorageCapacityBytes) &&
         (m_storageDeletionPolicy == other.m_storageDeletionPolicy) &&
+        (m_maxCoalescedDiskIoSizeBytes == other.m_maxCoalescedDiskIoSizeBytes) &&
+        (m_ramStorageUseHugePages == other.m_ramStorageUseHugePages) &&
+        (m_catalogJournalFilePath == other.m_catalogJournalFilePath) &&
+        (m_catalogJournalSnapshotIntervalRecords == other.m_catalogJournalSnapshotIntervalRecords) &&
+        (m_preloadSecondsBeforeContact == other.m_preloadSecondsBeforeContact) &&
+        (m_preloadMaxBytesPerOutduct == other.m_preloadMaxBytesPerOutduct) &&
+        (m_ramHotTierMaxBytes == other.m_ramHotTierMaxBytes) &&
+        (m_ramHotTierMaxResidentMilliseconds == other.m_ramHotTierMaxResidentMilliseconds) &&
+        (m_ramHotTierWriteCustodyBundlesImmediately == other.m_ramHotTierWriteCustodyBundlesImmediately) &&
+        (m_numReleaseWorkerThreads == other.m_numReleaseWorkerThreads) &&
+        (m_smallBundleSlabMaxBytes == other.m_smallBundleSlabMaxBytes) &&
+        (m_diskSpaceReclaimMaxBytesPerSecond == other.m_diskSpaceReclaimMaxBytesPerSecond) &&
+        (m_adaptiveDiskStriping == other.m_adaptiveDiskStriping) &&
         (m_storageDiskConfigVector == other.m_storageDiskConfigVector);
 }
 
@@ -148,6 +233,19 @@ bool StorageConfig::SetValuesFromPropertyTree(const boost::property_tree::ptree
         m_tryToRestoreFromDisk = pt.get<bool>("tryToRestoreFromDisk");
         m_autoDeleteFilesOnExit = pt.get<bool>("autoDeleteFilesOnExit");
         m_totalStorageCapacityBytes = pt.get<uint64_t>("totalStorageCapacityBytes");
+        m_maxCoalescedDiskIoSizeBytes = pt.get<uint64_t>("maxCoalescedDiskIoSizeBytes", DEFAULT_MAX_COALESCED_DISK_IO_SIZE_BYTES); //optional
+        m_ramStorageUseHugePages = pt.get<bool>("ramStorageUseHugePages", false); //optional
+        m_catalogJournalFilePath = pt.get<std::string>("catalogJournalFilePath", ""); //optional
+        m_catalogJournalSnapshotIntervalRecords = pt.get<uint64_t>("catalogJournalSnapshotIntervalRecords", DEFAULT_CATALOG_JOURNAL_SNAPSHOT_INTERVAL_RECORDS); //optional
+        m_preloadSecondsBeforeContact = pt.get<uint64_t>("preloadSecondsBeforeContact", DEFAULT_PRELOAD_SECONDS_BEFORE_CONTACT); //optional
+        m_preloadMaxBytesPerOutduct = pt.get<uint64_t>("preloadMaxBytesPerOutduct", DEFAULT_PRELOAD_MAX_BYTES_PER_OUTDUCT); //optional
+        m_ramHotTierMaxBytes = pt.get<uint64_t>("ramHotTierMaxBytes", 0); //optional
+        m_ramHotTierMaxResidentMilliseconds = pt.get<uint64_t>("ramHotTierMaxResidentMilliseconds", DEFAULT_RAM_HOT_TIER_MAX_RESIDENT_MILLISECONDS); //optional
+        m_ramHotTierWriteCustodyBundlesImmediately = pt.get<bool>("ramHotTierWriteCustodyBundlesImmediately", true); //optional
+        m_numReleaseWorkerThreads = pt.get<uint64_t>("numReleaseWorkerThreads", 0); //optional
+        m_smallBundleSlabMaxBytes = pt.get<uint64_t>("smallBundleSlabMaxBytes", 0); //optional
+        m_diskSpaceReclaimMaxBytesPerSecond = pt.get<uint64_t>("diskSpaceReclaimMaxBytesPerSecond", 0); //optional
+        m_adaptiveDiskStriping = pt.get<bool>("adaptiveDiskStriping", false); //optional
     }
     catch (const boost::property_tree::ptree_error & e) {
         LOG_ERROR(subprocess) << "error parsing JSON Storage config: " << e.what();
@@ -158,6 +256,18 @@ bool StorageConfig::SetValuesFromPropertyTree(const boost::property_tree::ptree
         LOG_ERROR(subprocess) << "error parsing JSON Storage config: totalStorageCapacityBytes must be defined and non-zero";
         return false;
     }
+    if (m_tryToRestoreFromDisk && (m_storageImplementation == "ram")) {
+        LOG_ERROR(subprocess) << "error parsing JSON Storage config: tryToRestoreFromDisk cannot be true when storageImplementation is ram";
+        return false;
+    }
+    if ((!m_catalogJournalFilePath.empty()) && (m_storageImplementation == "ram")) {
+        LOG_ERROR(subprocess) << "error parsing JSON Storage config: catalogJournalFilePath must be empty when storageImplementation is ram";
+        return false;
+    }
+    if (m_catalogJournalSnapshotIntervalRecords == 0) {
+        LOG_ERROR(subprocess) << "error parsing JSON Storage config: catalogJournalSnapshotIntervalRecords must be non-zero";
+        return false;
+    }
 
     //for non-throw versions of get_child which return a reference to the second parameter
     static const boost::property_tree::ptree EMPTY_PTREE;
@@ -170,6 +280,7 @@ bool StorageConfig::SetValuesFromPropertyTree(const boost::property_tree::ptree
         try {
             storageDiskConfig.name = storageDiskConfigPt.second.get<std::string>("name");
             storageDiskConfig.storeFilePath = storageDiskConfigPt.second.get<std::string>("storeFilePath");
+            storageDiskConfig.useDirectIo = storageDiskConfigPt.second.get<bool>("useDirectIo", false); //optional
         }
         catch (const boost::property_tree::ptree_error & e) {
             LOG_ERROR(subprocess) << "error parsing JSON storageDiskConfigVector[" << (storageDiskConfigVectorIndex - 1) << "]: " << e.what();
@@ -234,18 +345,32 @@ boost::property_tree::ptree StorageConfig::GetNewPropertyTree() const {
     pt.put("autoDeleteFilesOnExit", m_autoDeleteFilesOnExit);
     pt.put("totalStorageCapacityBytes", m_totalStorageCapacityBytes);
     pt.put("storageDeletionPolicy", m_storageDeletionPolicy);
+    pt.put("maxCoalescedDiskIoSizeBytes", m_maxCoalescedDiskIoSizeBytes);
+    pt.put("ramStorageUseHugePages", m_ramStorageUseHugePages);
+    pt.put("catalogJournalFilePath", m_catalogJournalFilePath);
+    pt.put("catalogJournalSnapshotIntervalRecords", m_catalogJournalSnapshotIntervalRecords);
+    pt.put("preloadSecondsBeforeContact", m_preloadSecondsBeforeContact);
+    pt.put("preloadMaxBytesPerOutduct", m_preloadMaxBytesPerOutduct);
+    pt.put("ramHotTierMaxBytes", m_ramHotTierMaxBytes);
+    pt.put("ramHotTierMaxResidentMilliseconds", m_ramHotTierMaxResidentMilliseconds);
+    pt.put("ramHotTierWriteCustodyBundlesImmediately", m_ramHotTierWriteCustodyBundlesImmediately);
+    pt.put("numReleaseWorkerThreads", m_numReleaseWorkerThreads);
+    pt.put("smallBundleSlabMaxBytes", m_smallBundleSlabMaxBytes);
+    pt.put("diskSpaceReclaimMaxBytesPerSecond", m_diskSpaceReclaimMaxBytesPerSecond);
+    pt.put("adaptiveDiskStriping", m_adaptiveDiskStriping);
     boost::property_tree::ptree & storageDiskConfigVectorPt = pt.put_child("storageDiskConfigVector", m_storageDiskConfigVector.empty() ? boost::property_tree::ptree("[]") : boost::property_tree::ptree());
     for (storage_disk_config_vector_t::const_iterator storageDiskConfigVectorIt = m_storageDiskConfigVector.cbegin(); storageDiskConfigVectorIt != m_storageDiskConfigVector.cend(); ++storageDiskConfigVectorIt) {
         const storage_disk_config_t & storageDiskConfig = *storageDiskConfigVectorIt;
         boost::property_tree::ptree & storageDiskConfigPt = (storageDiskConfigVectorPt.push_back(std::make_pair("", boost::property_tree::ptree())))->second; //using "" as key creates json array
         storageDiskConfigPt.put("name", storageDiskConfig.name);
         storageDiskConfigPt.put("storeFilePath", storageDiskConfig.storeFilePath);
+        storageDiskConfigPt.put("useDirectIo", storageDiskConfig.useDirectIo);
     }
 
     return pt;
 }
 
 
-void StorageConfig::AddDisk(const std::string & name, const std::string & storeFilePath) {
-    m_storageDiskConfigVector.push_back(storage_disk_config_t(name, storeFilePath));
+void StorageConfig::AddDisk(const std::string & name, const std::string & storeFilePath, const bool useDirectIo) {
+    m_storageDiskConfigVector.push_back(storage_disk_config_t(name, storeFilePath, useDirectIo));
 }
@@ -50,5 +50,23 @@ BOOST_AUTO_TEST_CASE(HdtnConfigTestCase)
     BOOST_REQUIRE(hdtnConfig == *hdtnConfigFromJsonPtr);
     BOOST_REQUIRE_EQUAL(hdtnJson, hdtnConfigFromJsonPtr->ToJson());
     BOOST_REQUIRE(boost::filesystem::remove(jsonFileToCreate));
+
+    //ingress worker threads
+    BOOST_REQUIRE_EQUAL(hdtnConfigFromJsonPtr->m_numIngressWorkerThreads, 0);
+    HdtnConfig hdtnConfigCopy(hdtnConfig);
+    hdtnConfigCopy.m_numIngressWorkerThreads = 4;
+    BOOST_REQUIRE(!(hdtnConfig == hdtnConfigCopy));
+    HdtnConfig_ptr hdtnConfigCopyFromJsonPtr = HdtnConfig::CreateFromJson(hdtnConfigCopy.ToJson());
+    BOOST_REQUIRE(hdtnConfigCopyFromJsonPtr);
+    BOOST_REQUIRE(hdtnConfigCopy == *hdtnConfigCopyFromJsonPtr);
+
+    //module bus batches
+    BOOST_REQUIRE_EQUAL(hdtnConfigFromJsonPtr->m_moduleBusBatchMaxMessages, 1);
+    hdtnConfigCopy.m_moduleBusBatchMaxMessages = 32;
+    hdtnConfigCopy.m_moduleBusBatchLingerMicroseconds = 500;
+    BOOST_REQUIRE(!(*hdtnConfigCopyFromJsonPtr == hdtnConfigCopy));
+    hdtnConfigCopyFromJsonPtr = HdtnConfig::CreateFromJson(hdtnConfigCopy.ToJson());
+    BOOST_REQUIRE(hdtnConfigCopyFromJsonPtr);
+    BOOST_REQUIRE(hdtnConfigCopy == *hdtnConfigCopyFromJsonPtr);
 }
 
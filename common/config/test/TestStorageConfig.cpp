@@ -21,13 +21,13 @@ BOOST_AUTO_TEST_CASE(StorageConfigTestCase)
     StorageConfig_ptr sc1 = std::make_shared< StorageConfig>();
     sc1->m_totalStorageCapacityBytes = 100000;
     sc1->AddDisk("d1", "/mnt/d1/d1.bin");
-    sc1->AddDisk("d2", "/mnt/d2/d2.bin");
+    sc1->AddDisk("d2", "/mnt/d2/d2.bin", true);
     //sc1->ToJsonFile("storageConfig.json");
 
     StorageConfig_ptr sc1_copy = std::make_shared< StorageConfig>();
     sc1_copy->m_totalStorageCapacityBytes = 100000;
     sc1_copy->AddDisk("d1", "/mnt/d1/d1.bin");
-    sc1_copy->AddDisk("d2", "/mnt/d2/d2.bin");
+    sc1_copy->AddDisk("d2", "/mnt/d2/d2.bin", true);
 
     StorageConfig_ptr sc2 = std::make_shared< StorageConfig>();
     sc2->m_totalStorageCapacityBytes = 100000;
@@ -52,6 +52,108 @@ BOOST_AUTO_TEST_CASE(StorageConfigTestCase)
     BOOST_REQUIRE(sc1Json == sc1_fromJson->ToJson());
     BOOST_REQUIRE_EQUAL(sc1_fromJson->m_storageDiskConfigVector.size(), 2);
     BOOST_REQUIRE_EQUAL(sc1_fromJson->m_totalStorageCapacityBytes, 100000);
+    BOOST_REQUIRE(!sc1_fromJson->m_storageDiskConfigVector[0].useDirectIo);
+    BOOST_REQUIRE(sc1_fromJson->m_storageDiskConfigVector[1].useDirectIo);
+    sc1_copy->m_storageDiskConfigVector[1].useDirectIo = false;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy->m_storageDiskConfigVector[1].useDirectIo = true;
+    BOOST_REQUIRE(*sc1 == *sc1_copy);
+
+    //maxCoalescedDiskIoSizeBytes is optional in json
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_maxCoalescedDiskIoSizeBytes, 131072);
+    sc1_copy->m_maxCoalescedDiskIoSizeBytes = 4096;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    StorageConfig_ptr sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE_EQUAL(sc1_copy_fromJson->m_maxCoalescedDiskIoSizeBytes, 4096);
+
+    //ram implementation
+    BOOST_REQUIRE(!sc1_fromJson->m_ramStorageUseHugePages);
+    sc1_copy->m_storageImplementation = "ram";
+    sc1_copy->m_ramStorageUseHugePages = true;
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+    //ram has nothing to restore from
+    sc1_copy->m_tryToRestoreFromDisk = true;
+    BOOST_REQUIRE(!StorageConfig::CreateFromJson(sc1_copy->ToJson()));
+
+    //catalog journal
+    BOOST_REQUIRE(sc1_fromJson->m_catalogJournalFilePath.empty());
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_catalogJournalSnapshotIntervalRecords, 100000);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_catalogJournalFilePath = "catalog_journal.bin";
+    sc1_copy->m_catalogJournalSnapshotIntervalRecords = 5;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+    sc1_copy->m_catalogJournalSnapshotIntervalRecords = 0;
+    BOOST_REQUIRE(!StorageConfig::CreateFromJson(sc1_copy->ToJson()));
+    //ram has no catalog to journal
+    sc1_copy->m_catalogJournalSnapshotIntervalRecords = 5;
+    sc1_copy->m_storageImplementation = "ram";
+    BOOST_REQUIRE(!StorageConfig::CreateFromJson(sc1_copy->ToJson()));
+
+    //contact preloading
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_preloadSecondsBeforeContact, 5);
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_preloadMaxBytesPerOutduct, 16777216);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_preloadSecondsBeforeContact = 0;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy->m_preloadMaxBytesPerOutduct = 1000;
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+
+    //ram hot tier
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_ramHotTierMaxBytes, 0);
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_ramHotTierMaxResidentMilliseconds, 1000);
+    BOOST_REQUIRE(sc1_fromJson->m_ramHotTierWriteCustodyBundlesImmediately);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_ramHotTierMaxBytes = 1000000;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy->m_ramHotTierMaxResidentMilliseconds = 50;
+    sc1_copy->m_ramHotTierWriteCustodyBundlesImmediately = false;
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+
+    //release worker threads
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_numReleaseWorkerThreads, 0);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_numReleaseWorkerThreads = 4;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+
+    //small bundle slabs
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_smallBundleSlabMaxBytes, 0);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_smallBundleSlabMaxBytes = 16777216;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+
+    //disk space reclaimer
+    BOOST_REQUIRE_EQUAL(sc1_fromJson->m_diskSpaceReclaimMaxBytesPerSecond, 0);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_diskSpaceReclaimMaxBytesPerSecond = 104857600;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
+
+    //adaptive disk striping
+    BOOST_REQUIRE(!sc1_fromJson->m_adaptiveDiskStriping);
+    sc1_copy = std::make_shared<StorageConfig>(*sc1);
+    sc1_copy->m_adaptiveDiskStriping = true;
+    BOOST_REQUIRE(!(*sc1 == *sc1_copy));
+    sc1_copy_fromJson = StorageConfig::CreateFromJson(sc1_copy->ToJson());
+    BOOST_REQUIRE(sc1_copy_fromJson); //not null
+    BOOST_REQUIRE(*sc1_copy == *sc1_copy_fromJson);
 
 }
 
@@ -0,0 +1,65 @@
+/**
+ * @file InprocBundleRings.hpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * The InprocBundleRings.hpp defines the SpscDescriptorRing paths which replace the ZeroMQ inproc sockets
+ * carrying bundles from ingress to egress, from ingress to storage, and from storage to egress when HDTN runs
+ * as one process with the spsc-ring inproc transport.
+ * Each descriptor is the same fixed-sized message (from message.hpp) that is otherwise sent as the
+ * first part of the ZeroMQ message, plus the zmq::message_t of its bundle (empty for messages without one),
+ * so the receiving module handles both transports the same way.
+ * Ingress has many producer threads (its induct threads and ingress workers), so each of its paths is a
+ * SpscDescriptorRingGroup which gives every one of those threads a ring of its own.
+ */
+
+#ifndef _HDTN_INPROC_BUNDLE_RINGS_H
+#define _HDTN_INPROC_BUNDLE_RINGS_H 1
+
+#include "message.hpp"
+#include "zmq.hpp"
+#include "SpscDescriptorRing.h"
+
+#define HDTN_INPROC_BUNDLE_RING_CAPACITY (4096)
+#define HDTN_INPROC_BUNDLE_NUM_PRODUCER_RINGS (8) //default per ingress path (ingress threads beyond the first 7 share one ring)
+#define HDTN_INPROC_BUNDLE_PRODUCER_RING_CAPACITY (1024)
+
+namespace hdtn {
+
+struct ToEgressDescriptor {
+    ToEgressHdr toEgressHdr;
+    zmq::message_t bundle;
+};
+typedef SpscDescriptorRing<ToEgressDescriptor> ToEgressRing;
+typedef SpscDescriptorRingGroup<ToEgressDescriptor> ToEgressRingGroup;
+
+struct ToStorageDescriptor {
+    ToStorageHdr toStorageHdr;
+    zmq::message_t bundle;
+};
+typedef SpscDescriptorRingGroup<ToStorageDescriptor> ToStorageRingGroup;
+
+struct InprocBundleRings {
+    /// @param numProducerRings The number of rings of each ingress path (see SpscDescriptorRingGroup), at least one per expected ingress producer thread plus the shared ring.
+    explicit InprocBundleRings(const unsigned int numProducerRings = HDTN_INPROC_BUNDLE_NUM_PRODUCER_RINGS) :
+        ingressToEgressRings(numProducerRings, HDTN_INPROC_BUNDLE_PRODUCER_RING_CAPACITY),
+        ingressToStorageRings(numProducerRings, HDTN_INPROC_BUNDLE_PRODUCER_RING_CAPACITY),
+        storageToEgressRing(HDTN_INPROC_BUNDLE_RING_CAPACITY) {}
+
+    ToEgressRingGroup ingressToEgressRings; //one ring per ingress producer thread, consumed by egress
+    ToStorageRingGroup ingressToStorageRings; //one ring per ingress producer thread, consumed by storage
+    ToEgressRing storageToEgressRing; //produced by the storage thread, consumed by egress
+};
+
+}  // namespace hdtn
+
+#endif //_HDTN_INPROC_BUNDLE_RINGS_H
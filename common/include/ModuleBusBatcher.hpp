@@ -0,0 +1,294 @@
+/**
+ * @file ModuleBusBatcher.hpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * The ModuleBusBatcher class gathers the fixed-sized headers (from message.hpp) of messages sent on one
+ * ZeroMQ socket of the HDTN message bus, each optionally followed by its bundle, into batch messages.
+ * A batch is one multipart message: a BatchHdr, a part holding every header back to back, then
+ * (if the batch carries bundles) one part per bundle in the same order, so the per-message bus overhead
+ * (a message, a header allocation and a receiver wakeup) is paid once per batch instead of once per bundle.
+ * Messages are appended under the socket's own mutex, so a batch never interleaves with other messages of the socket.
+ * A batch is sent as soon as it is full, or by the linger thread once its oldest message has waited the linger duration.
+ * A batch is all or nothing: the socket is handed shared copies of the bundles (zmq::message_t::copy, which references
+ * rather than copies the data of a large message), so a batch whose send fails partway (whose earlier parts are never
+ * delivered on their own) still holds every one of its bundles.  The messages of a batch which could not be sent are kept
+ * for HandleFailedBatches(), which gives them to the send failed callback without the socket mutex held, so the callback
+ * may block (e.g. to reroute them).
+ */
+
+#ifndef _HDTN_MODULE_BUS_BATCHER_H
+#define _HDTN_MODULE_BUS_BATCHER_H 1
+
+#include "message.hpp"
+#include "zmq.hpp"
+#include "ThreadNamer.h"
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/bind/bind.hpp>
+#include <boost/core/noncopyable.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/thread.hpp>
+
+namespace hdtn {
+
+template <typename hdrType, typename socketType = zmq::socket_t> //socketType other than zmq::socket_t for unit tests
+class ModuleBusBatcher : private boost::noncopyable {
+public:
+    /// Called (without the socket mutex held) with the headers and bundles of every message of the batches which could not be sent
+    /// (bundles is empty if the batches do not carry bundles).
+    typedef boost::function<void(std::vector<hdrType>& headers, std::vector<zmq::message_t>& bundles)> send_failed_callback_t;
+
+    ModuleBusBatcher() :
+        m_socketPtr(NULL),
+        m_socketMutexPtr(NULL),
+        m_batchMsgType(0),
+        m_carriesBundles(false),
+        m_maxMessagesPerBatch(1),
+        m_running(false),
+        m_hasFailedBatches(false) {}
+
+    ~ModuleBusBatcher() {
+        Stop();
+    }
+
+    /**
+     * Start batching the messages sent on a socket.
+     * @param socketPtr The socket, which must outlive Stop().
+     * @param socketMutexPtr The mutex which every sender on the socket (and every Append_NotThreadSafe caller) holds.
+     * @param batchMsgType The CommonHdr type of the BatchHdr.
+     * @param carriesBundles True if each header is followed by a bundle.
+     * @param maxMessagesPerBatch The number of messages which fill a batch.
+     * @param lingerDuration The longest time the oldest message of a partial batch waits for more messages.
+     * @param sendFailedCallback Called with every batch which could not be sent.
+     * @param threadName The name of the linger thread.
+     * @return False (and nothing started) if maxMessagesPerBatch is less than 2, i.e. each message should be sent on its own.
+     */
+    bool Start(socketType* socketPtr, boost::mutex* socketMutexPtr, const uint16_t batchMsgType, const bool carriesBundles,
+        const uint64_t maxMessagesPerBatch, const boost::posix_time::time_duration& lingerDuration,
+        const send_failed_callback_t& sendFailedCallback, const std::string& threadName)
+    {
+        if ((maxMessagesPerBatch < 2) || m_lingerThreadPtr) {
+            return false;
+        }
+        m_socketPtr = socketPtr;
+        m_socketMutexPtr = socketMutexPtr;
+        m_batchMsgType = batchMsgType;
+        m_carriesBundles = carriesBundles;
+        m_maxMessagesPerBatch = maxMessagesPerBatch;
+        m_lingerDuration = lingerDuration;
+        m_sendFailedCallback = sendFailedCallback;
+        m_threadName = threadName;
+        m_headers.reserve(maxMessagesPerBatch);
+        if (carriesBundles) {
+            m_bundles.reserve(maxMessagesPerBatch);
+        }
+        m_running = true;
+        m_lingerThreadPtr = boost::make_unique<boost::thread>(boost::bind(&ModuleBusBatcher::LingerThreadFunc, this));
+        return true;
+    }
+
+    /// Stop the linger thread and send what remains of the batch (the socket must still exist).
+    void Stop() {
+        if (!m_lingerThreadPtr) {
+            return;
+        }
+        {
+            boost::mutex::scoped_lock lock(*m_socketMutexPtr);
+            m_running = false;
+            Send_NotThreadSafe();
+        }
+        m_conditionVariable.notify_one();
+        m_lingerThreadPtr->join();
+        m_lingerThreadPtr.reset();
+        HandleFailedBatches();
+    }
+
+    /// @return True if messages are to be appended to this batcher (caller holds the socket mutex).
+    bool IsRunning_NotThreadSafe() const noexcept {
+        return m_running;
+    }
+
+    /**
+     * Add a message to the batch, which is sent once full (caller holds the socket mutex).
+     * @param hdr The header of the message.
+     * @param bundlePtr The bundle to move into the batch, or NULL if the batch does not carry bundles.
+     */
+    void Append_NotThreadSafe(const hdrType& hdr, zmq::message_t* bundlePtr) {
+        m_headers.push_back(hdr);
+        if (m_carriesBundles) {
+            m_bundles.emplace_back(std::move(*bundlePtr));
+        }
+        if (m_headers.size() == 1) {
+            m_lingerExpiry = boost::posix_time::microsec_clock::universal_time() + m_lingerDuration;
+            m_conditionVariable.notify_one();
+        }
+        if (m_headers.size() >= m_maxMessagesPerBatch) {
+            Send_NotThreadSafe();
+        }
+    }
+
+    /**
+     * Send the partial batch now, e.g. before an unbatched message which must not overtake it (caller holds the socket mutex).
+     * If it can't be sent, all of its messages are kept for HandleFailedBatches().
+     */
+    void Send_NotThreadSafe() {
+        if (m_headers.empty()) {
+            return;
+        }
+        if ((!SendBatch(*m_socketPtr, m_batchMsgType, m_headers, (m_carriesBundles) ? &m_bundles : NULL)) && m_sendFailedCallback) {
+            m_failedHeaders.insert(m_failedHeaders.end(), m_headers.cbegin(), m_headers.cend());
+            if (m_carriesBundles) {
+                for (std::size_t i = 0; i < m_bundles.size(); ++i) {
+                    m_failedBundles.emplace_back(std::move(m_bundles[i]));
+                }
+            }
+            m_hasFailedBatches.store(true, std::memory_order_release);
+        }
+        m_headers.clear();
+        m_bundles.clear();
+    }
+
+    /// Give the messages of the batches which could not be sent to the send failed callback (caller must NOT hold the socket mutex).
+    void HandleFailedBatches() {
+        if (!m_hasFailedBatches.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::vector<hdrType> failedHeaders;
+        std::vector<zmq::message_t> failedBundles;
+        {
+            boost::mutex::scoped_lock lock(*m_socketMutexPtr);
+            failedHeaders.swap(m_failedHeaders);
+            failedBundles.swap(m_failedBundles);
+            m_hasFailedBatches.store(false, std::memory_order_relaxed);
+        }
+        if (!failedHeaders.empty()) {
+            m_sendFailedCallback(failedHeaders, failedBundles);
+        }
+    }
+
+    /**
+     * Send one batch message.
+     * @param bundlesPtr The bundles (one per header), or NULL if the batch does not carry bundles.  The socket is handed shared
+     * copies, so every bundle is still held (e.g. to be rerouted) if the batch can't be sent, even partway through.
+     * @return False if any part could not be sent (none of the batch is then delivered).
+     */
+    static bool SendBatch(socketType& socket, const uint16_t batchMsgType, const std::vector<hdrType>& headers,
+        std::vector<zmq::message_t>* bundlesPtr)
+    {
+        BatchHdr batchHdr;
+        batchHdr.base.type = batchMsgType;
+        batchHdr.base.flags = 0;
+        batchHdr.numMessages = static_cast<uint32_t>(headers.size());
+        if (!socket.send(zmq::const_buffer(&batchHdr, sizeof(batchHdr)), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
+            return false;
+        }
+        if (!socket.send(zmq::const_buffer(headers.data(), headers.size() * sizeof(hdrType)),
+            (bundlesPtr) ? (zmq::send_flags::sndmore | zmq::send_flags::dontwait) : zmq::send_flags::dontwait))
+        {
+            return false;
+        }
+        if (bundlesPtr) {
+            std::vector<zmq::message_t>& bundles = *bundlesPtr;
+            for (std::size_t i = 0; i < bundles.size(); ++i) {
+                const bool isLast = ((i + 1) == bundles.size());
+                zmq::message_t sharedBundle;
+                sharedBundle.copy(bundles[i]);
+                if (!socket.send(std::move(sharedBundle), (isLast) ? zmq::send_flags::dontwait : (zmq::send_flags::sndmore | zmq::send_flags::dontwait))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Receive the headers part of a batch whose BatchHdr was just received (copied out for natural alignment).
+     * @return False if the part is missing or does not hold exactly numMessages headers.
+     */
+    static bool ReceiveHeaders(socketType& socket, const BatchHdr& batchHdr, std::vector<hdrType>& headers) {
+        zmq::message_t headersMessage;
+        if (!socket.recv(headersMessage, zmq::recv_flags::none)) {
+            return false;
+        }
+        if (headersMessage.size() != (static_cast<std::size_t>(batchHdr.numMessages) * sizeof(hdrType))) {
+            return false;
+        }
+        headers.resize(batchHdr.numMessages);
+        if (batchHdr.numMessages) {
+            memcpy(static_cast<void*>(headers.data()), headersMessage.data(), headersMessage.size()); //headers are trivially copyable messages
+        }
+        return true;
+    }
+
+    /// Discard the remaining parts of a partially received (bad) batch so the next receive starts at a new message.
+    static void DiscardRemainingParts(socketType& socket) {
+        while (socket.get(zmq::sockopt::rcvmore)) {
+            zmq::message_t unusedPart;
+            if (!socket.recv(unusedPart, zmq::recv_flags::none)) {
+                break;
+            }
+        }
+    }
+
+private:
+    void LingerThreadFunc() {
+        ThreadNamer::SetThisThreadName(m_threadName);
+        boost::mutex::scoped_lock lock(*m_socketMutexPtr);
+        while (m_running) {
+            if (m_headers.empty()) {
+                m_conditionVariable.wait(lock); //unlock the socket mutex and wait for a new batch
+            }
+            else if (boost::posix_time::microsec_clock::universal_time() >= m_lingerExpiry) {
+                Send_NotThreadSafe();
+                if (m_hasFailedBatches.load(std::memory_order_relaxed)) {
+                    lock.unlock();
+                    HandleFailedBatches();
+                    lock.lock();
+                }
+            }
+            else {
+                m_conditionVariable.timed_wait(lock, m_lingerExpiry);
+            }
+        }
+    }
+
+    socketType* m_socketPtr;
+    boost::mutex* m_socketMutexPtr;
+    uint16_t m_batchMsgType;
+    bool m_carriesBundles;
+    uint64_t m_maxMessagesPerBatch;
+    boost::posix_time::time_duration m_lingerDuration;
+    send_failed_callback_t m_sendFailedCallback;
+    std::string m_threadName;
+
+    //protected by the socket mutex
+    std::vector<hdrType> m_headers;
+    std::vector<zmq::message_t> m_bundles;
+    boost::posix_time::ptime m_lingerExpiry;
+    bool m_running;
+    std::vector<hdrType> m_failedHeaders;
+    std::vector<zmq::message_t> m_failedBundles;
+    std::atomic<bool> m_hasFailedBatches; //also read without the socket mutex
+
+    boost::condition_variable m_conditionVariable;
+    std::unique_ptr<boost::thread> m_lingerThreadPtr;
+};
+
+}  // namespace hdtn
+
+#endif //_HDTN_MODULE_BUS_BATCHER_H
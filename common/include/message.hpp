@@ -39,6 +39,8 @@
 #define HDTN_MSGTYPE_STORAGE_REMOVE_OPPORTUNISTIC_LINK (0x0009)
 #define HDTN_MSGTYPE_BUNDLES_TO_ROUTER (0x000A)
 #define HDTN_MSGTYPE_BUNDLES_FROM_ROUTER (0x000B)
+#define HDTN_MSGTYPE_EGRESS_BATCH (0x000C) //BatchHdr, then a frame of ToEgressHdr, then one frame per bundle
+#define HDTN_MSGTYPE_STORE_BATCH (0x000D) //BatchHdr, then a frame of ToStorageHdr, then one frame per bundle
 
 // Egress Messages range is 0xE000 to 0xEAFF
 #define HDTN_MSGTYPE_ENOTIMPL (0xE000)  // convergence layer type not  // implemented
@@ -75,6 +77,8 @@
 #define HDTN_MSGTYPE_STORAGE_ACK_TO_INGRESS (0x5557)
 #define HDTN_MSGTYPE_ALL_OUTDUCT_CAPABILITIES_TELEMETRY (0x5558)
 #define HDTN_MSGTYPE_DEPLETED_STORAGE_REPORT (0x5559)
+#define HDTN_MSGTYPE_EGRESS_ACK_BATCH_TO_INGRESS (0x555A) //BatchHdr, then a frame of EgressAckHdr
+#define HDTN_MSGTYPE_STORAGE_ACK_BATCH_TO_INGRESS (0x555B) //BatchHdr, then a frame of StorageAckHdr
 
 #define HDTN_NOROUTE (UINT64_MAX) // no route available
 
@@ -149,6 +153,14 @@ struct StorageAckHdr {
     uint64_t outductIndex; //for bundle pipeline limiting on a per outduct basis
 };
 
+//First part of a batch message which carries numMessages fixed-sized headers back to back in its second part
+//(followed by numMessages bundle parts when the headers are for bundles).
+//It is no larger than any header it batches, so a receiver can read it into the buffer of the unbatched header.
+struct BatchHdr {
+    CommonHdr base;
+    uint32_t numMessages;
+};
+
 struct TelemStorageHdr {
     CommonHdr base;
     StorageStats stats;
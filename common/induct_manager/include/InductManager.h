@@ -22,6 +22,10 @@
 
 #include "Induct.h"
 #include <list>
+#include <vector>
+
+//a bundle along with the index (in the inducts config) of the induct which received it
+typedef boost::function<void(padded_vector_uint8_t & movableBundle, const uint64_t inductIndex)> InductIndexProcessBundleCallback_t;
 
 class InductManager {
 public:
@@ -30,8 +34,16 @@ public:
     INDUCT_MANAGER_LIB_EXPORT bool LoadInductsFromConfig(const InductProcessBundleCallback_t & inductProcessBundleCallback, const InductsConfig & inductsConfig,
         const uint64_t myNodeId, const uint64_t maxUdpRxPacketSizeBytesForAllLtp, const uint64_t maxBundleSizeBytes,
         const OnNewOpportunisticLinkCallback_t & onNewOpportunisticLinkCallback, const OnDeletedOpportunisticLinkCallback_t & onDeletedOpportunisticLinkCallback);
+    //LoadInductsFromConfig, except that each bundle is passed along with the index of its induct in inductsConfig
+    INDUCT_MANAGER_LIB_EXPORT bool LoadInductsFromConfigWithInductIndex(const InductIndexProcessBundleCallback_t & inductIndexProcessBundleCallback, const InductsConfig & inductsConfig,
+        const uint64_t myNodeId, const uint64_t maxUdpRxPacketSizeBytesForAllLtp, const uint64_t maxBundleSizeBytes,
+        const OnNewOpportunisticLinkCallback_t & onNewOpportunisticLinkCallback, const OnDeletedOpportunisticLinkCallback_t & onDeletedOpportunisticLinkCallback);
     INDUCT_MANAGER_LIB_EXPORT void Clear();
     INDUCT_MANAGER_LIB_EXPORT void PopulateAllInductTelemetry(AllInductTelemetry_t& allInductTelem);
+private:
+    INDUCT_MANAGER_LIB_NO_EXPORT bool LoadInductsFromConfigPerInductCallback(const std::vector<InductProcessBundleCallback_t> & inductProcessBundleCallbacks, const InductsConfig & inductsConfig,
+        const uint64_t myNodeId, const uint64_t maxUdpRxPacketSizeBytesForAllLtp, const uint64_t maxBundleSizeBytes,
+        const OnNewOpportunisticLinkCallback_t & onNewOpportunisticLinkCallback, const OnDeletedOpportunisticLinkCallback_t & onDeletedOpportunisticLinkCallback);
 public:
 
     std::list<std::unique_ptr<Induct> > m_inductsList;
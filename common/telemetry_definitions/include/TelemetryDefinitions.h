@@ -74,6 +74,13 @@ struct CLASS_VISIBILITY_TELEMETRY_DEFINITIONS StorageTelemetry_t : public JsonSe
     //from BundleStorageManagerBase's MemoryManager
     uint64_t m_usedSpaceBytes;
     uint64_t m_freeSpaceBytes;
+
+    //from BundleStorageManagerBase's DiskSpaceReclaimer
+    uint64_t m_totalBytesReclaimedFromDisk;
+    uint64_t m_totalDiskSpaceReclaimOperations;
+
+    //from BundleStorageManagerBase's disk throughput measurements (one per disk, bytes per second of busy time, 0 if not measured)
+    std::vector<uint64_t> m_diskThroughputBytesPerSecondVec;
 };
 
 
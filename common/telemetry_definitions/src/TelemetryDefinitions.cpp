@@ -54,7 +54,10 @@ StorageTelemetry_t::StorageTelemetry_t() :
     m_totalBundleByteEraseOperationsFromDisk(0),
     //from BundleStorageManagerBase's MemoryManager
     m_usedSpaceBytes(0),
-    m_freeSpaceBytes(0) {}
+    m_freeSpaceBytes(0),
+    //from BundleStorageManagerBase's DiskSpaceReclaimer
+    m_totalBytesReclaimedFromDisk(0),
+    m_totalDiskSpaceReclaimOperations(0) {}
 StorageTelemetry_t::~StorageTelemetry_t() {}
 bool StorageTelemetry_t::operator==(const StorageTelemetry_t& o) const {
     return (m_timestampMilliseconds == o.m_timestampMilliseconds)
@@ -76,7 +79,10 @@ bool StorageTelemetry_t::operator==(const StorageTelemetry_t& o) const {
         && (m_totalBundleEraseOperationsFromDisk == o.m_totalBundleEraseOperationsFromDisk)
         && (m_totalBundleByteEraseOperationsFromDisk == o.m_totalBundleByteEraseOperationsFromDisk)
         && (m_usedSpaceBytes == o.m_usedSpaceBytes)
-        && (m_freeSpaceBytes == o.m_freeSpaceBytes);
+        && (m_freeSpaceBytes == o.m_freeSpaceBytes)
+        && (m_totalBytesReclaimedFromDisk == o.m_totalBytesReclaimedFromDisk)
+        && (m_totalDiskSpaceReclaimOperations == o.m_totalDiskSpaceReclaimOperations)
+        && (m_diskThroughputBytesPerSecondVec == o.m_diskThroughputBytesPerSecondVec);
 }
 bool StorageTelemetry_t::operator!=(const StorageTelemetry_t& o) const {
     return !(*this == o);
@@ -104,6 +110,13 @@ bool StorageTelemetry_t::SetValuesFromPropertyTree(const boost::property_tree::p
         m_totalBundleByteEraseOperationsFromDisk = pt.get<uint64_t>("totalBundleByteEraseOperationsFromDisk");
         m_usedSpaceBytes = pt.get<uint64_t>("usedSpaceBytes");
         m_freeSpaceBytes = pt.get<uint64_t>("freeSpaceBytes");
+        m_totalBytesReclaimedFromDisk = pt.get<uint64_t>("totalBytesReclaimedFromDisk");
+        m_totalDiskSpaceReclaimOperations = pt.get<uint64_t>("totalDiskSpaceReclaimOperations");
+        const boost::property_tree::ptree& diskThroughputPt = pt.get_child("diskThroughputBytesPerSecond");
+        m_diskThroughputBytesPerSecondVec.clear();
+        BOOST_FOREACH(const boost::property_tree::ptree::value_type & diskThroughputValuePt, diskThroughputPt) {
+            m_diskThroughputBytesPerSecondVec.push_back(diskThroughputValuePt.second.get_value<uint64_t>());
+        }
     }
     catch (const boost::property_tree::ptree_error& e) {
         LOG_ERROR(subprocess) << "parsing JSON StorageTelemetry_t: " << e.what();
@@ -134,6 +147,13 @@ boost::property_tree::ptree StorageTelemetry_t::GetNewPropertyTree() const {
     pt.put("totalBundleByteEraseOperationsFromDisk", m_totalBundleByteEraseOperationsFromDisk);
     pt.put("usedSpaceBytes", m_usedSpaceBytes);
     pt.put("freeSpaceBytes", m_freeSpaceBytes);
+    pt.put("totalBytesReclaimedFromDisk", m_totalBytesReclaimedFromDisk);
+    pt.put("totalDiskSpaceReclaimOperations", m_totalDiskSpaceReclaimOperations);
+    boost::property_tree::ptree& diskThroughputPt = pt.put_child("diskThroughputBytesPerSecond",
+        m_diskThroughputBytesPerSecondVec.empty() ? boost::property_tree::ptree("[]") : boost::property_tree::ptree());
+    for (std::size_t i = 0; i < m_diskThroughputBytesPerSecondVec.size(); ++i) {
+        diskThroughputPt.push_back(std::make_pair("", boost::property_tree::ptree(std::to_string(m_diskThroughputBytesPerSecondVec[i])))); //using "" as key creates json array
+    }
     return pt;
 }
 
@@ -45,6 +45,13 @@ BOOST_AUTO_TEST_CASE(TelemetryDefinitionsStorageTestCase)
     t.m_usedSpaceBytes = 150;
     t.m_freeSpaceBytes = 160;
 
+    //from BundleStorageManagerBase's DiskSpaceReclaimer
+    t.m_totalBytesReclaimedFromDisk = 170;
+    t.m_totalDiskSpaceReclaimOperations = 180;
+
+    //from BundleStorageManagerBase's disk throughput measurements
+    t.m_diskThroughputBytesPerSecondVec = { 2000000000, 0, 500000000 };
+
     const std::string tJson = t.ToJson();
     //std::cout << tJson << "\n";
     StorageTelemetry_t t2;
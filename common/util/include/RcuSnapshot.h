@@ -0,0 +1,129 @@
+/**
+ * @file RcuSnapshot.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This RcuSnapshot class publishes an immutable snapshot (read-copy-update style) to any number of reader threads
+ * which take no locks: a reader brackets its accesses with a ReadGuard, which costs one atomic increment and decrement
+ * of a reader count in a cache line slot of its own (reader threads are spread over RCU_SNAPSHOT_NUM_READER_SLOTS slots,
+ * so readers only share a slot, and its cache line, beyond that many threads).  A writer builds a whole new snapshot and
+ * Publish() swaps it in atomically, then waits for a grace period (every reader which may still see the old snapshot has
+ * left its ReadGuard, found by scanning every slot) before deleting the old snapshot.
+ * Each slot has two reader counts, and the writer flips which one new readers use before draining the other one,
+ * so that a steady stream of readers cannot starve the writer.
+ * Writers must be serialized by the caller, and a ReadGuard must not be held while the same thread publishes.
+ */
+
+#ifndef _RCU_SNAPSHOT_H
+#define _RCU_SNAPSHOT_H 1
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <boost/core/noncopyable.hpp>
+
+#define RCU_SNAPSHOT_NUM_READER_SLOTS 64 //reader threads beyond this many share slots
+
+template <typename snapshotType>
+class RcuSnapshot : private boost::noncopyable {
+private:
+    //the reader counts of the threads assigned to this slot, on a cache line of their own
+    struct alignas(64) ReaderSlot {
+        ReaderSlot() : counts{ {0}, {0} } {}
+        std::atomic<uint64_t> counts[2];
+    };
+public:
+    class ReadGuard : private boost::noncopyable {
+    private:
+        ReadGuard() = delete;
+    public:
+        explicit ReadGuard(const RcuSnapshot& rcuSnapshot) noexcept :
+            m_readerCountRef(rcuSnapshot.EnterReadSide()),
+            m_snapshotPtr(rcuSnapshot.m_currentSnapshotPtr.load(std::memory_order_seq_cst)) {}
+        ~ReadGuard() {
+            m_readerCountRef.fetch_sub(1, std::memory_order_release); //the snapshot accesses happen before the writer sees the count drop
+        }
+        const snapshotType& operator*() const noexcept {
+            return *m_snapshotPtr;
+        }
+        const snapshotType* operator->() const noexcept {
+            return m_snapshotPtr;
+        }
+    private:
+        std::atomic<uint64_t>& m_readerCountRef;
+        const snapshotType* const m_snapshotPtr;
+    };
+
+    /// Start with a default constructed snapshot so that readers never see a NULL snapshot.
+    RcuSnapshot() :
+        m_currentSnapshotPtr(new snapshotType()),
+        m_readerCountIndex(0) {}
+
+    ~RcuSnapshot() {
+        delete m_currentSnapshotPtr.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Swap in a new snapshot, then delete the old one once no reader can still be using it (writer only).
+     * @param newSnapshotPtr The new snapshot, of which this takes ownership.
+     */
+    void Publish(std::unique_ptr<snapshotType>&& newSnapshotPtr) {
+        snapshotType* const oldSnapshotPtr = m_currentSnapshotPtr.exchange(newSnapshotPtr.release(), std::memory_order_seq_cst);
+        WaitForReaders();
+        delete oldSnapshotPtr;
+    }
+
+    /// @return The current snapshot, which only the (serialized) writers may read without a ReadGuard.
+    const snapshotType& GetCurrent_WriterOnly() const noexcept {
+        return *m_currentSnapshotPtr.load(std::memory_order_acquire);
+    }
+
+private:
+    static unsigned int GetThisThreadReaderSlotIndex() noexcept {
+        static std::atomic<unsigned int> nextReaderSlotIndex(0);
+        static thread_local const unsigned int thisThreadReaderSlotIndex =
+            nextReaderSlotIndex.fetch_add(1, std::memory_order_relaxed) % RCU_SNAPSHOT_NUM_READER_SLOTS;
+        return thisThreadReaderSlotIndex;
+    }
+
+    std::atomic<uint64_t>& EnterReadSide() const noexcept {
+        //the count index may be stale (relaxed) since the writer drains both counts
+        std::atomic<uint64_t>& readerCount =
+            m_readerSlots[GetThisThreadReaderSlotIndex()].counts[m_readerCountIndex.load(std::memory_order_relaxed)];
+        //seq_cst (with the snapshot load and the writer's exchange and drain loads) so that the snapshot is not loaded before
+        //the increment is visible; uncontended since the slot is this thread's own
+        readerCount.fetch_add(1, std::memory_order_seq_cst);
+        return readerCount;
+    }
+
+    void WaitForReaders() const {
+        //A reader whose increment the writer doesn't see while draining loads the snapshot after the exchange,
+        //so it sees the new snapshot.  Draining both counts (the one readers use and the one a delayed reader may still pick)
+        //of every slot is enough.
+        for (unsigned int pass = 0; pass < 2; ++pass) {
+            const unsigned int drainIndex = m_readerCountIndex.load(std::memory_order_relaxed); //only the writer stores it
+            m_readerCountIndex.store(drainIndex ^ 1u, std::memory_order_release); //new readers move to the other count
+            for (unsigned int slotIndex = 0; slotIndex < RCU_SNAPSHOT_NUM_READER_SLOTS; ++slotIndex) {
+                while (m_readerSlots[slotIndex].counts[drainIndex].load(std::memory_order_seq_cst) != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+
+    std::atomic<snapshotType*> m_currentSnapshotPtr;
+    mutable std::atomic<unsigned int> m_readerCountIndex;
+    mutable ReaderSlot m_readerSlots[RCU_SNAPSHOT_NUM_READER_SLOTS];
+};
+
+#endif //_RCU_SNAPSHOT_H
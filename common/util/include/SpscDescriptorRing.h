@@ -0,0 +1,236 @@
+/**
+ * @file SpscDescriptorRing.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This SpscDescriptorRing class is a lock-free ring of descriptors (i.e. a message header plus the zmq::message_t
+ * of its bundle) passed from one producer thread to one consumer thread of the same process.
+ * The slot indices are shared through a CircularIndexBufferSingleProducerSingleConsumerConfigurable, and a
+ * descriptor is moved into and out of its preallocated slot, so passing one costs no allocation.
+ * A consumer which also waits on zmq sockets adds GetPollFd() to its zmq::pollitem_t array (as a raw file descriptor)
+ * and brackets its poll with PrepareToWait() and FinishWait(), so that a producer only signals the SpscRingWakeup
+ * (an eventfd) when the consumer is actually waiting.
+ * The wakeup requires Linux (IsSupported() returns false elsewhere, in which case the ring must not be used).
+ * A SpscDescriptorRingGroup passes descriptors from many producer threads to one consumer thread by giving each
+ * producer thread a ring of its own, so that producers never serialize on a lock; the consumer polls every ring.
+ */
+
+#ifndef _SPSC_DESCRIPTOR_RING_H
+#define _SPSC_DESCRIPTOR_RING_H 1
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <boost/core/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "CircularIndexBufferSingleProducerSingleConsumerConfigurable.h"
+#include "hdtn_util_export.h"
+
+class SpscRingWakeup : private boost::noncopyable {
+public:
+    HDTN_UTIL_EXPORT SpscRingWakeup();
+    HDTN_UTIL_EXPORT ~SpscRingWakeup();
+    /// @return True if this platform provides the wakeup file descriptor.
+    HDTN_UTIL_EXPORT static bool IsSupported() noexcept;
+    /// Make the file descriptor readable (called by the producer).
+    HDTN_UTIL_EXPORT void Signal() noexcept;
+    /// Make the file descriptor no longer readable (called by the consumer).
+    HDTN_UTIL_EXPORT void Drain() noexcept;
+    /// @return The file descriptor to poll for readability, or -1 if not supported.
+    HDTN_UTIL_EXPORT int GetPollFd() const noexcept;
+private:
+    int m_fd;
+};
+
+template <typename descriptorType>
+class SpscDescriptorRing : private boost::noncopyable {
+private:
+    SpscDescriptorRing() = delete;
+public:
+    /**
+     * Allocate the slots of the ring.
+     * @param capacity The number of slots (one of which is always left empty to tell a full ring from an empty one).
+     */
+    SpscDescriptorRing(const unsigned int capacity) :
+        m_circularIndexBuffer(capacity),
+        m_slots(capacity),
+        m_consumerIsWaiting(false) {}
+
+    /**
+     * Move a descriptor into the ring (producer thread only).
+     * @param descriptor The descriptor, which is left moved-from on success and untouched on failure.
+     * @return False if the ring is full.
+     */
+    bool TryPush(descriptorType & descriptor) {
+        const unsigned int writeIndex = m_circularIndexBuffer.GetIndexForWrite();
+        if (writeIndex == CIRCULAR_INDEX_BUFFER_FULL) {
+            return false;
+        }
+        m_slots[writeIndex] = std::move(descriptor);
+        m_circularIndexBuffer.CommitWrite();
+        //pairs with the fence of PrepareToWait so that either the consumer sees this descriptor or this sees the consumer waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumerIsWaiting.load(std::memory_order_relaxed)) {
+            m_wakeup.Signal();
+        }
+        return true;
+    }
+
+    /**
+     * Move the oldest descriptor out of the ring (consumer thread only).
+     * @return False if the ring is empty.
+     */
+    bool TryPop(descriptorType & descriptor) {
+        const unsigned int readIndex = m_circularIndexBuffer.GetIndexForRead();
+        if (readIndex == CIRCULAR_INDEX_BUFFER_EMPTY) {
+            return false;
+        }
+        descriptor = std::move(m_slots[readIndex]);
+        m_circularIndexBuffer.CommitRead();
+        return true;
+    }
+
+    /**
+     * Called by the consumer before it blocks in a poll of GetPollFd().
+     * @return False if the ring already holds descriptors, in which case the consumer must not block.
+     */
+    bool PrepareToWait() noexcept {
+        m_consumerIsWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return m_circularIndexBuffer.IsEmpty();
+    }
+
+    /// Called by the consumer after every poll which PrepareToWait() preceded.
+    void FinishWait() noexcept {
+        m_consumerIsWaiting.store(false, std::memory_order_relaxed);
+        m_wakeup.Drain();
+    }
+
+    int GetPollFd() const noexcept {
+        return m_wakeup.GetPollFd();
+    }
+    unsigned int NumInRing() const noexcept {
+        return m_circularIndexBuffer.NumInBuffer();
+    }
+    unsigned int GetCapacity() const noexcept {
+        return m_circularIndexBuffer.GetCapacity();
+    }
+
+private:
+    CircularIndexBufferSingleProducerSingleConsumerConfigurable m_circularIndexBuffer;
+    std::vector<descriptorType> m_slots;
+    std::atomic<bool> m_consumerIsWaiting;
+    SpscRingWakeup m_wakeup;
+};
+
+template <typename descriptorType>
+class SpscDescriptorRingGroup : private boost::noncopyable {
+private:
+    SpscDescriptorRingGroup() = delete;
+public:
+    typedef SpscDescriptorRing<descriptorType> ring_t;
+
+    /**
+     * Allocate every ring of the group up front, so that the consumer's set of rings (and poll file descriptors) never changes.
+     * Ring 0 is shared, under a mutex, by the producer threads which arrive after the other numRings - 1 rings are taken.
+     * @param numRings The number of rings (at least 1).
+     * @param capacityPerRing The number of slots of each ring.
+     */
+    SpscDescriptorRingGroup(const unsigned int numRings, const unsigned int capacityPerRing) :
+        m_groupId(GetNextGroupId()),
+        m_nextDedicatedRingIndex(1)
+    {
+        m_rings.reserve((numRings) ? numRings : 1);
+        for (unsigned int i = 0; i < m_rings.capacity(); ++i) {
+            m_rings.emplace_back(new ring_t(capacityPerRing));
+        }
+    }
+
+    /**
+     * Move a descriptor into the calling thread's ring (any producer thread).  The first push of a thread takes its ring,
+     * so the descriptors of one thread are always popped in the order that thread pushed them.
+     * @param descriptor The descriptor, which is left moved-from on success and untouched on failure.
+     * @return False if the thread's ring is full.
+     */
+    bool TryPush(descriptorType & descriptor) {
+        //a thread remembers the ring it took from only one group (of this descriptor type) at a time,
+        //which is matched by group id (never reused) rather than address, so a destroyed group's ring is never touched
+        struct thread_ring_t {
+            uint64_t groupId;
+            ring_t * ringPtr;
+        };
+        static thread_local thread_ring_t threadRing = { 0, NULL };
+        if (threadRing.groupId != m_groupId) {
+            const unsigned int ringIndex = m_nextDedicatedRingIndex.fetch_add(1, std::memory_order_relaxed);
+            threadRing.groupId = m_groupId;
+            threadRing.ringPtr = (ringIndex < m_rings.size()) ? m_rings[ringIndex].get() : NULL; //NULL => shared ring 0
+        }
+        if (threadRing.ringPtr) {
+            return threadRing.ringPtr->TryPush(descriptor);
+        }
+        boost::mutex::scoped_lock lock(m_sharedRingMutex);
+        return m_rings[0]->TryPush(descriptor);
+    }
+
+    /**
+     * TryPush, retrying (with the thread's ring lock released between attempts) while the thread's ring is full,
+     * so that a slow consumer back-pressures the producer rather than the descriptor being lost.
+     * @param descriptor The descriptor, which is left moved-from on success and untouched on failure.
+     * @param timeout The longest to wait for the consumer to make room.
+     * @return False if the thread's ring is still full after the timeout.
+     */
+    bool TryPushFor(descriptorType & descriptor, const boost::posix_time::time_duration & timeout) {
+        if (TryPush(descriptor)) {
+            return true;
+        }
+        static const boost::posix_time::time_duration retryInterval = boost::posix_time::microseconds(100);
+        const boost::posix_time::ptime expiry = boost::posix_time::microsec_clock::universal_time() + timeout;
+        while (boost::posix_time::microsec_clock::universal_time() < expiry) {
+            boost::this_thread::sleep(retryInterval);
+            if (TryPush(descriptor)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @return The number of rings, which the consumer polls and pops.
+    unsigned int GetNumRings() const noexcept {
+        return static_cast<unsigned int>(m_rings.size());
+    }
+    /// @return Ring ringIndex (consumer thread only).
+    ring_t & GetRing(const unsigned int ringIndex) noexcept {
+        return *m_rings[ringIndex];
+    }
+    /// @return The number of rings given to a producer thread of their own (excluding the shared ring 0).
+    unsigned int GetNumDedicatedRingsTaken() const noexcept {
+        const unsigned int nextDedicatedRingIndex = m_nextDedicatedRingIndex.load(std::memory_order_relaxed);
+        return ((nextDedicatedRingIndex < m_rings.size()) ? nextDedicatedRingIndex : static_cast<unsigned int>(m_rings.size())) - 1;
+    }
+
+private:
+    static uint64_t GetNextGroupId() noexcept {
+        static std::atomic<uint64_t> nextGroupId(1); //0 is no group
+        return nextGroupId.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const uint64_t m_groupId;
+    std::vector<std::unique_ptr<ring_t> > m_rings;
+    std::atomic<unsigned int> m_nextDedicatedRingIndex;
+    boost::mutex m_sharedRingMutex;
+};
+
+#endif //_SPSC_DESCRIPTOR_RING_H
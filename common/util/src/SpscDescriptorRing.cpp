@@ -0,0 +1,63 @@
+/**
+ * @file SpscDescriptorRing.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "SpscDescriptorRing.h"
+#include <cstdint>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+SpscRingWakeup::SpscRingWakeup() :
+#ifdef __linux__
+    m_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+#else
+    m_fd(-1)
+#endif
+{}
+
+SpscRingWakeup::~SpscRingWakeup() {
+#ifdef __linux__
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+#endif
+}
+
+bool SpscRingWakeup::IsSupported() noexcept {
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+void SpscRingWakeup::Signal() noexcept {
+#ifdef __linux__
+    const uint64_t one = 1;
+    const ssize_t unused = write(m_fd, &one, sizeof(one)); //only fails (EAGAIN) if the counter would overflow, which still leaves it readable
+    (void)unused;
+#endif
+}
+
+void SpscRingWakeup::Drain() noexcept {
+#ifdef __linux__
+    uint64_t count;
+    const ssize_t unused = read(m_fd, &count, sizeof(count)); //EAGAIN if not signaled
+    (void)unused;
+#endif
+}
+
+int SpscRingWakeup::GetPollFd() const noexcept {
+    return m_fd;
+}
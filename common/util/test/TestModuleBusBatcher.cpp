@@ -0,0 +1,368 @@
+/**
+ * @file TestModuleBusBatcher.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "ModuleBusBatcher.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+static hdtn::ToStorageHdr MakeToStorageHdr(const uint64_t uniqueId) {
+    hdtn::ToStorageHdr hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.base.type = HDTN_MSGTYPE_STORE;
+    hdr.ingressUniqueId = uniqueId;
+    hdr.outductIndex = uniqueId + 100;
+    return hdr;
+}
+
+static zmq::message_t MakeBundle(const uint64_t uniqueId) {
+    const std::string bundle = "bundle" + std::to_string(uniqueId);
+    return zmq::message_t(bundle.data(), bundle.size());
+}
+
+static std::string ToString(const zmq::message_t& message) {
+    return std::string(static_cast<const char*>(message.data()), message.size());
+}
+
+//receives one batch of ToStorageHdr (with bundles) and checks its unique ids are firstUniqueId..firstUniqueId+numMessages-1
+static void RequireBatchOfBundles(zmq::socket_t& pullSock, const uint64_t firstUniqueId, const uint32_t numMessages) {
+    hdtn::BatchHdr batchHdr;
+    BOOST_REQUIRE(pullSock.recv(zmq::mutable_buffer(&batchHdr, sizeof(batchHdr)), zmq::recv_flags::none));
+    BOOST_REQUIRE_EQUAL(batchHdr.base.type, HDTN_MSGTYPE_STORE_BATCH);
+    BOOST_REQUIRE_EQUAL(batchHdr.numMessages, numMessages);
+    std::vector<hdtn::ToStorageHdr> headers;
+    BOOST_REQUIRE(hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::ReceiveHeaders(pullSock, batchHdr, headers));
+    BOOST_REQUIRE_EQUAL(headers.size(), numMessages);
+    for (uint32_t i = 0; i < numMessages; ++i) {
+        BOOST_REQUIRE(pullSock.get(zmq::sockopt::rcvmore));
+        BOOST_REQUIRE_EQUAL(headers[i].ingressUniqueId, firstUniqueId + i);
+        BOOST_REQUIRE_EQUAL(headers[i].outductIndex, firstUniqueId + i + 100);
+        zmq::message_t bundle;
+        BOOST_REQUIRE(pullSock.recv(bundle, zmq::recv_flags::none));
+        BOOST_REQUIRE_EQUAL(ToString(bundle), ToString(MakeBundle(firstUniqueId + i)));
+    }
+    BOOST_REQUIRE(!pullSock.get(zmq::sockopt::rcvmore));
+}
+
+BOOST_AUTO_TEST_CASE(ModuleBusBatcherSendAndReceiveTestCase)
+{
+    zmq::context_t context;
+    zmq::socket_t pushSock(context, zmq::socket_type::push);
+    zmq::socket_t pullSock(context, zmq::socket_type::pull);
+    pushSock.set(zmq::sockopt::linger, 0);
+    pullSock.set(zmq::sockopt::rcvtimeo, 2000);
+    pullSock.bind("inproc://test_module_bus_batcher_send_and_receive");
+    pushSock.connect("inproc://test_module_bus_batcher_send_and_receive");
+
+    //a batch carrying bundles
+    std::vector<hdtn::ToStorageHdr> headers;
+    std::vector<zmq::message_t> bundles;
+    for (uint64_t id = 0; id < 3; ++id) {
+        headers.push_back(MakeToStorageHdr(id));
+        bundles.emplace_back(MakeBundle(id));
+    }
+    BOOST_REQUIRE(hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::SendBatch(pushSock, HDTN_MSGTYPE_STORE_BATCH, headers, &bundles));
+    RequireBatchOfBundles(pullSock, 0, 3);
+
+    //a batch of acks (no bundles)
+    std::vector<hdtn::StorageAckHdr> acks(2);
+    memset(acks.data(), 0, acks.size() * sizeof(hdtn::StorageAckHdr));
+    acks[0].ingressUniqueId = 7;
+    acks[1].ingressUniqueId = 8;
+    BOOST_REQUIRE(hdtn::ModuleBusBatcher<hdtn::StorageAckHdr>::SendBatch(pushSock, HDTN_MSGTYPE_STORAGE_ACK_BATCH_TO_INGRESS, acks, NULL));
+    hdtn::BatchHdr batchHdr;
+    BOOST_REQUIRE(pullSock.recv(zmq::mutable_buffer(&batchHdr, sizeof(batchHdr)), zmq::recv_flags::none));
+    BOOST_REQUIRE_EQUAL(batchHdr.base.type, HDTN_MSGTYPE_STORAGE_ACK_BATCH_TO_INGRESS);
+    std::vector<hdtn::StorageAckHdr> receivedAcks;
+    BOOST_REQUIRE(hdtn::ModuleBusBatcher<hdtn::StorageAckHdr>::ReceiveHeaders(pullSock, batchHdr, receivedAcks));
+    BOOST_REQUIRE_EQUAL(receivedAcks.size(), 2);
+    BOOST_REQUIRE_EQUAL(receivedAcks[0].ingressUniqueId, 7);
+    BOOST_REQUIRE_EQUAL(receivedAcks[1].ingressUniqueId, 8);
+    BOOST_REQUIRE(!pullSock.get(zmq::sockopt::rcvmore));
+
+    //a bad batch (its headers part is one header short) is discarded without losing the next message
+    hdtn::BatchHdr badBatchHdr;
+    memset(&badBatchHdr, 0, sizeof(badBatchHdr));
+    badBatchHdr.base.type = HDTN_MSGTYPE_STORE_BATCH;
+    badBatchHdr.numMessages = 2;
+    const hdtn::ToStorageHdr oneHdr = MakeToStorageHdr(0);
+    BOOST_REQUIRE(pushSock.send(zmq::const_buffer(&badBatchHdr, sizeof(badBatchHdr)), zmq::send_flags::sndmore));
+    BOOST_REQUIRE(pushSock.send(zmq::const_buffer(&oneHdr, sizeof(oneHdr)), zmq::send_flags::sndmore));
+    BOOST_REQUIRE(pushSock.send(MakeBundle(0), zmq::send_flags::sndmore));
+    BOOST_REQUIRE(pushSock.send(MakeBundle(1), zmq::send_flags::none));
+    headers.resize(1);
+    headers[0] = MakeToStorageHdr(5);
+    bundles.clear();
+    bundles.emplace_back(MakeBundle(5));
+    BOOST_REQUIRE(hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::SendBatch(pushSock, HDTN_MSGTYPE_STORE_BATCH, headers, &bundles));
+
+    BOOST_REQUIRE(pullSock.recv(zmq::mutable_buffer(&batchHdr, sizeof(batchHdr)), zmq::recv_flags::none));
+    std::vector<hdtn::ToStorageHdr> receivedHeaders;
+    BOOST_REQUIRE(!hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::ReceiveHeaders(pullSock, batchHdr, receivedHeaders));
+    hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::DiscardRemainingParts(pullSock);
+    RequireBatchOfBundles(pullSock, 5, 1);
+}
+
+BOOST_AUTO_TEST_CASE(ModuleBusBatcherLingerTestCase)
+{
+    zmq::context_t context;
+    zmq::socket_t pushSock(context, zmq::socket_type::push);
+    zmq::socket_t pullSock(context, zmq::socket_type::pull);
+    pushSock.set(zmq::sockopt::linger, 0);
+    pullSock.set(zmq::sockopt::rcvtimeo, 2000);
+    pullSock.bind("inproc://test_module_bus_batcher_linger");
+    pushSock.connect("inproc://test_module_bus_batcher_linger");
+    boost::mutex socketMutex;
+
+    //each message on its own is not batched
+    {
+        hdtn::ModuleBusBatcher<hdtn::ToStorageHdr> batcher;
+        BOOST_REQUIRE(!batcher.Start(&pushSock, &socketMutex, HDTN_MSGTYPE_STORE_BATCH, true, 1,
+            boost::posix_time::milliseconds(50), hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::send_failed_callback_t(), "batcher"));
+        BOOST_REQUIRE(!batcher.IsRunning_NotThreadSafe());
+    }
+
+    //a partial batch is sent by the linger thread once its oldest message has waited the linger duration
+    {
+        hdtn::ModuleBusBatcher<hdtn::ToStorageHdr> batcher;
+        BOOST_REQUIRE(batcher.Start(&pushSock, &socketMutex, HDTN_MSGTYPE_STORE_BATCH, true, 4,
+            boost::posix_time::milliseconds(50), hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::send_failed_callback_t(), "batcher"));
+        const boost::posix_time::ptime startTime = boost::posix_time::microsec_clock::universal_time();
+        {
+            boost::mutex::scoped_lock lock(socketMutex);
+            BOOST_REQUIRE(batcher.IsRunning_NotThreadSafe());
+            for (uint64_t id = 0; id < 2; ++id) {
+                zmq::message_t bundle(MakeBundle(id));
+                batcher.Append_NotThreadSafe(MakeToStorageHdr(id), &bundle);
+            }
+        }
+        RequireBatchOfBundles(pullSock, 0, 2);
+        BOOST_REQUIRE_GE((boost::posix_time::microsec_clock::universal_time() - startTime).total_milliseconds(), 50);
+        batcher.Stop();
+    }
+
+    //a full batch is sent without waiting for the (long) linger duration, and Stop() sends the partial batch
+    {
+        hdtn::ModuleBusBatcher<hdtn::ToStorageHdr> batcher;
+        BOOST_REQUIRE(batcher.Start(&pushSock, &socketMutex, HDTN_MSGTYPE_STORE_BATCH, true, 4,
+            boost::posix_time::seconds(10), hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::send_failed_callback_t(), "batcher"));
+        {
+            boost::mutex::scoped_lock lock(socketMutex);
+            for (uint64_t id = 10; id < 15; ++id) {
+                zmq::message_t bundle(MakeBundle(id));
+                batcher.Append_NotThreadSafe(MakeToStorageHdr(id), &bundle);
+            }
+        }
+        RequireBatchOfBundles(pullSock, 10, 4);
+        batcher.Stop();
+        RequireBatchOfBundles(pullSock, 14, 1);
+        BOOST_REQUIRE(!batcher.IsRunning_NotThreadSafe());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ModuleBusBatcherSendFailedTestCase)
+{
+    //a push socket without a peer can't send (without waiting)
+    zmq::context_t context;
+    zmq::socket_t pushSock(context, zmq::socket_type::push);
+    pushSock.set(zmq::sockopt::linger, 0);
+    pushSock.bind("inproc://test_module_bus_batcher_send_failed");
+    boost::mutex socketMutex;
+
+    boost::mutex callbackMutex;
+    boost::condition_variable callbackConditionVariable;
+    std::vector<hdtn::ToStorageHdr> failedHeaders;
+    std::vector<zmq::message_t> failedBundles;
+    unsigned int numCallbacks = 0;
+    std::atomic<bool> socketMutexWasHeld(false);
+    const hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::send_failed_callback_t sendFailedCallback =
+        [&](std::vector<hdtn::ToStorageHdr>& headers, std::vector<zmq::message_t>& bundles) {
+        if (socketMutex.try_lock()) {
+            socketMutex.unlock();
+        }
+        else {
+            socketMutexWasHeld = true;
+        }
+        boost::mutex::scoped_lock lock(callbackMutex);
+        for (std::size_t i = 0; i < headers.size(); ++i) {
+            failedHeaders.push_back(headers[i]);
+            failedBundles.emplace_back(std::move(bundles[i]));
+        }
+        ++numCallbacks;
+        callbackConditionVariable.notify_one();
+    };
+
+    //a full batch which can't be sent is kept until HandleFailedBatches() (called without the socket mutex held)
+    {
+        hdtn::ModuleBusBatcher<hdtn::ToStorageHdr> batcher;
+        BOOST_REQUIRE(batcher.Start(&pushSock, &socketMutex, HDTN_MSGTYPE_STORE_BATCH, true, 3,
+            boost::posix_time::seconds(10), sendFailedCallback, "batcher"));
+        {
+            boost::mutex::scoped_lock lock(socketMutex);
+            for (uint64_t id = 0; id < 3; ++id) {
+                zmq::message_t bundle(MakeBundle(id));
+                batcher.Append_NotThreadSafe(MakeToStorageHdr(id), &bundle);
+            }
+        }
+        BOOST_REQUIRE_EQUAL(numCallbacks, 0);
+        batcher.HandleFailedBatches();
+        BOOST_REQUIRE_EQUAL(numCallbacks, 1);
+        batcher.HandleFailedBatches(); //nothing more to handle
+        BOOST_REQUIRE_EQUAL(numCallbacks, 1);
+        batcher.Stop();
+        BOOST_REQUIRE_EQUAL(numCallbacks, 1);
+    }
+    BOOST_REQUIRE(!socketMutexWasHeld);
+    BOOST_REQUIRE_EQUAL(failedHeaders.size(), 3);
+    BOOST_REQUIRE_EQUAL(failedBundles.size(), 3);
+    for (uint64_t id = 0; id < 3; ++id) {
+        BOOST_REQUIRE_EQUAL(failedHeaders[id].ingressUniqueId, id);
+        BOOST_REQUIRE_EQUAL(ToString(failedBundles[id]), ToString(MakeBundle(id))); //intact, so the caller can reroute them
+    }
+
+    //a partial batch which the linger thread can't send is given to the callback by the linger thread
+    failedHeaders.clear();
+    failedBundles.clear();
+    numCallbacks = 0;
+    {
+        hdtn::ModuleBusBatcher<hdtn::ToStorageHdr> batcher;
+        BOOST_REQUIRE(batcher.Start(&pushSock, &socketMutex, HDTN_MSGTYPE_STORE_BATCH, true, 3,
+            boost::posix_time::milliseconds(20), sendFailedCallback, "batcher"));
+        {
+            boost::mutex::scoped_lock lock(socketMutex);
+            zmq::message_t bundle(MakeBundle(7));
+            batcher.Append_NotThreadSafe(MakeToStorageHdr(7), &bundle);
+        }
+        {
+            boost::mutex::scoped_lock lock(callbackMutex);
+            const boost::posix_time::ptime timeoutExpiry = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(2);
+            while ((numCallbacks == 0) && callbackConditionVariable.timed_wait(lock, timeoutExpiry)) {}
+            BOOST_REQUIRE_EQUAL(numCallbacks, 1);
+        }
+        batcher.Stop();
+    }
+    BOOST_REQUIRE(!socketMutexWasHeld);
+    BOOST_REQUIRE_EQUAL(failedHeaders.size(), 1);
+    BOOST_REQUIRE_EQUAL(failedHeaders[0].ingressUniqueId, 7);
+    BOOST_REQUIRE_EQUAL(ToString(failedBundles[0]), ToString(MakeBundle(7)));
+}
+
+//a socket which accepts parts until a given part of a message, whose send then fails (as when the peer goes away mid-message)
+class PartFailingSocket {
+public:
+    PartFailingSocket() : failAtPartIndex(SIZE_MAX), numPartsOfThisMessage(0), numMessagesSent(0) {}
+    zmq::send_result_t send(zmq::const_buffer buf, zmq::send_flags flags) {
+        if (!AcceptPart(flags)) {
+            return {};
+        }
+        return buf.size();
+    }
+    zmq::send_result_t send(zmq::message_t&& msg, zmq::send_flags flags) {
+        if (!AcceptPart(flags)) {
+            return {}; //msg untouched, as with a zmq::socket_t
+        }
+        const std::size_t size = msg.size();
+        zmq::message_t consumedPart(std::move(msg));
+        return size;
+    }
+    std::size_t failAtPartIndex;
+    std::size_t numPartsOfThisMessage;
+    std::size_t numMessagesSent;
+private:
+    bool AcceptPart(const zmq::send_flags flags) {
+        if (numPartsOfThisMessage == failAtPartIndex) {
+            numPartsOfThisMessage = 0; //the parts already accepted are discarded, never delivered
+            return false;
+        }
+        if ((static_cast<int>(flags) & static_cast<int>(zmq::send_flags::sndmore)) != 0) {
+            ++numPartsOfThisMessage;
+        }
+        else {
+            numPartsOfThisMessage = 0;
+            ++numMessagesSent;
+        }
+        return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(ModuleBusBatcherSendFailedPartwayTestCase)
+{
+    typedef hdtn::ModuleBusBatcher<hdtn::ToStorageHdr, PartFailingSocket> part_failing_batcher_t;
+    PartFailingSocket socket;
+    boost::mutex socketMutex;
+    std::vector<hdtn::ToStorageHdr> failedHeaders;
+    std::vector<zmq::message_t> failedBundles;
+    const part_failing_batcher_t::send_failed_callback_t sendFailedCallback =
+        [&](std::vector<hdtn::ToStorageHdr>& headers, std::vector<zmq::message_t>& bundles) {
+        for (std::size_t i = 0; i < headers.size(); ++i) {
+            failedHeaders.push_back(headers[i]);
+            failedBundles.emplace_back(std::move(bundles[i]));
+        }
+    };
+
+    //SendBatch fails on the third bundle (the parts are the BatchHdr, the headers, then one per bundle),
+    //after the first two bundles were handed to the socket, yet still holds all four
+    std::vector<hdtn::ToStorageHdr> headers;
+    std::vector<zmq::message_t> bundles;
+    for (uint64_t id = 0; id < 4; ++id) {
+        headers.push_back(MakeToStorageHdr(id));
+        bundles.emplace_back(MakeBundle(id));
+    }
+    socket.failAtPartIndex = 4;
+    BOOST_REQUIRE(!part_failing_batcher_t::SendBatch(socket, HDTN_MSGTYPE_STORE_BATCH, headers, &bundles));
+    BOOST_REQUIRE_EQUAL(socket.numMessagesSent, 0);
+    for (uint64_t id = 0; id < 4; ++id) {
+        BOOST_REQUIRE_EQUAL(ToString(bundles[id]), ToString(MakeBundle(id)));
+    }
+
+    //so the batcher gives every message of the failed batch to the callback, e.g. to release all of their pipeline reservations
+    {
+        part_failing_batcher_t batcher;
+        BOOST_REQUIRE(batcher.Start(&socket, &socketMutex, HDTN_MSGTYPE_STORE_BATCH, true, 4,
+            boost::posix_time::seconds(10), sendFailedCallback, "batcher"));
+        {
+            boost::mutex::scoped_lock lock(socketMutex);
+            for (uint64_t id = 0; id < 4; ++id) {
+                zmq::message_t bundle(MakeBundle(id));
+                batcher.Append_NotThreadSafe(MakeToStorageHdr(id), &bundle);
+            }
+        }
+        batcher.HandleFailedBatches();
+        BOOST_REQUIRE_EQUAL(failedHeaders.size(), 4);
+        BOOST_REQUIRE_EQUAL(failedBundles.size(), 4);
+        for (uint64_t id = 0; id < 4; ++id) {
+            BOOST_REQUIRE_EQUAL(failedHeaders[id].ingressUniqueId, id);
+            BOOST_REQUIRE_EQUAL(ToString(failedBundles[id]), ToString(MakeBundle(id))); //intact, so the caller can reroute them
+        }
+
+        //a batch which is sent whole is not reported
+        failedHeaders.clear();
+        failedBundles.clear();
+        socket.failAtPartIndex = SIZE_MAX;
+        {
+            boost::mutex::scoped_lock lock(socketMutex);
+            for (uint64_t id = 10; id < 14; ++id) {
+                zmq::message_t bundle(MakeBundle(id));
+                batcher.Append_NotThreadSafe(MakeToStorageHdr(id), &bundle);
+            }
+        }
+        batcher.HandleFailedBatches();
+        BOOST_REQUIRE_EQUAL(socket.numMessagesSent, 1);
+        BOOST_REQUIRE(failedHeaders.empty());
+        batcher.Stop();
+    }
+}
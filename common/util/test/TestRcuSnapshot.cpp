@@ -0,0 +1,143 @@
+/**
+ * @file TestRcuSnapshot.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "RcuSnapshot.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <boost/make_unique.hpp>
+#include <boost/thread.hpp>
+
+static std::atomic<int> g_numLiveTestSnapshots(0);
+
+struct test_snapshot_t {
+    test_snapshot_t() : version(0), values(16, 0) {
+        ++g_numLiveTestSnapshots;
+    }
+    explicit test_snapshot_t(const uint64_t v) : version(v), values(16, v) {
+        ++g_numLiveTestSnapshots;
+    }
+    ~test_snapshot_t() {
+        version = UINT64_MAX; //poison so that a reader of a deleted snapshot is caught
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            values[i] = UINT64_MAX;
+        }
+        --g_numLiveTestSnapshots;
+    }
+    uint64_t version;
+    std::vector<uint64_t> values;
+};
+
+BOOST_AUTO_TEST_CASE(RcuSnapshotPublishTestCase)
+{
+    {
+        RcuSnapshot<test_snapshot_t> rcuSnapshot;
+        BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 1);
+        {
+            RcuSnapshot<test_snapshot_t>::ReadGuard readGuard(rcuSnapshot);
+            BOOST_REQUIRE_EQUAL(readGuard->version, 0);
+        }
+        for (uint64_t v = 1; v <= 3; ++v) {
+            rcuSnapshot.Publish(boost::make_unique<test_snapshot_t>(v));
+            BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 1); //old snapshot deleted
+            BOOST_REQUIRE_EQUAL(rcuSnapshot.GetCurrent_WriterOnly().version, v);
+            RcuSnapshot<test_snapshot_t>::ReadGuard readGuard(rcuSnapshot);
+            BOOST_REQUIRE_EQUAL((*readGuard).version, v);
+        }
+    }
+    BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(RcuSnapshotConcurrentReadersTestCase)
+{
+    static const uint64_t NUM_PUBLISHES = 2000;
+    static const unsigned int NUM_READERS = 4;
+    {
+        RcuSnapshot<test_snapshot_t> rcuSnapshot;
+        std::atomic<bool> running(true);
+        std::atomic<uint64_t> numBadReads(0);
+        std::vector<std::unique_ptr<boost::thread> > readerThreads;
+        for (unsigned int i = 0; i < NUM_READERS; ++i) {
+            readerThreads.emplace_back(boost::make_unique<boost::thread>([&rcuSnapshot, &running, &numBadReads]() {
+                uint64_t lastVersion = 0;
+                while (running.load(std::memory_order_acquire)) {
+                    RcuSnapshot<test_snapshot_t>::ReadGuard readGuard(rcuSnapshot);
+                    const uint64_t version = readGuard->version;
+                    if ((version < lastVersion) || (version == UINT64_MAX)) {
+                        ++numBadReads;
+                    }
+                    lastVersion = version;
+                    for (std::size_t j = 0; j < readGuard->values.size(); ++j) {
+                        if (readGuard->values[j] != version) {
+                            ++numBadReads;
+                        }
+                    }
+                }
+            }));
+        }
+        for (uint64_t v = 1; v <= NUM_PUBLISHES; ++v) {
+            rcuSnapshot.Publish(boost::make_unique<test_snapshot_t>(v));
+        }
+        running.store(false, std::memory_order_release);
+        for (std::size_t i = 0; i < readerThreads.size(); ++i) {
+            readerThreads[i]->join();
+        }
+        BOOST_REQUIRE_EQUAL(numBadReads.load(), 0);
+        BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 1);
+    }
+    BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(RcuSnapshotSharedReaderSlotsTestCase)
+{
+    static const uint64_t NUM_PUBLISHES = 200;
+    static const unsigned int NUM_READERS = RCU_SNAPSHOT_NUM_READER_SLOTS + 4; //some reader threads share a slot
+    {
+        RcuSnapshot<test_snapshot_t> rcuSnapshot;
+        std::atomic<bool> running(true);
+        std::atomic<uint64_t> numBadReads(0);
+        std::vector<std::unique_ptr<boost::thread> > readerThreads;
+        for (unsigned int i = 0; i < NUM_READERS; ++i) {
+            readerThreads.emplace_back(boost::make_unique<boost::thread>([&rcuSnapshot, &running, &numBadReads]() {
+                while (running.load(std::memory_order_acquire)) {
+                    RcuSnapshot<test_snapshot_t>::ReadGuard outerReadGuard(rcuSnapshot);
+                    const uint64_t version = outerReadGuard->version;
+                    {
+                        RcuSnapshot<test_snapshot_t>::ReadGuard innerReadGuard(rcuSnapshot); //nested on the same slot
+                        if ((innerReadGuard->version < version) || (innerReadGuard->version == UINT64_MAX)) {
+                            ++numBadReads;
+                        }
+                    }
+                    boost::this_thread::yield();
+                    for (std::size_t j = 0; j < outerReadGuard->values.size(); ++j) {
+                        if (outerReadGuard->values[j] != version) { //still alive after the inner guard left
+                            ++numBadReads;
+                        }
+                    }
+                }
+            }));
+        }
+        for (uint64_t v = 1; v <= NUM_PUBLISHES; ++v) {
+            rcuSnapshot.Publish(boost::make_unique<test_snapshot_t>(v));
+        }
+        running.store(false, std::memory_order_release);
+        for (std::size_t i = 0; i < readerThreads.size(); ++i) {
+            readerThreads[i]->join();
+        }
+        BOOST_REQUIRE_EQUAL(numBadReads.load(), 0);
+        BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 1);
+    }
+    BOOST_REQUIRE_EQUAL(g_numLiveTestSnapshots.load(), 0);
+}
@@ -0,0 +1,211 @@
+/**
+ * @file TestSpscDescriptorRing.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "SpscDescriptorRing.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <boost/thread.hpp>
+#ifdef __linux__
+#include <poll.h>
+#endif
+
+struct test_descriptor_t {
+    uint64_t sequence;
+    std::unique_ptr<uint64_t> bundle; //move-only like a zmq::message_t
+};
+
+BOOST_AUTO_TEST_CASE(SpscDescriptorRingPushPopTestCase)
+{
+    static const unsigned int CAPACITY = 8;
+    SpscDescriptorRing<test_descriptor_t> ring(CAPACITY);
+    test_descriptor_t descriptor;
+    BOOST_REQUIRE(!ring.TryPop(descriptor));
+    for (unsigned int pass = 0; pass < 3; ++pass) { //wrap around
+        for (uint64_t i = 0; i < (CAPACITY - 1); ++i) {
+            descriptor.sequence = i;
+            descriptor.bundle.reset(new uint64_t(i * 10));
+            BOOST_REQUIRE(ring.TryPush(descriptor));
+            BOOST_REQUIRE(!descriptor.bundle); //moved into the slot
+        }
+        BOOST_REQUIRE_EQUAL(ring.NumInRing(), CAPACITY - 1);
+        descriptor.sequence = 1000;
+        descriptor.bundle.reset(new uint64_t(1000));
+        BOOST_REQUIRE(!ring.TryPush(descriptor)); //full
+        BOOST_REQUIRE(descriptor.bundle); //untouched
+        BOOST_REQUIRE(!ring.PrepareToWait()); //must not block while descriptors are waiting
+        ring.FinishWait();
+        for (uint64_t i = 0; i < (CAPACITY - 1); ++i) {
+            BOOST_REQUIRE(ring.TryPop(descriptor));
+            BOOST_REQUIRE_EQUAL(descriptor.sequence, i);
+            BOOST_REQUIRE(descriptor.bundle);
+            BOOST_REQUIRE_EQUAL(*descriptor.bundle, i * 10);
+        }
+        BOOST_REQUIRE(!ring.TryPop(descriptor));
+        BOOST_REQUIRE(ring.PrepareToWait());
+        ring.FinishWait();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(SpscDescriptorRingGroupTryPushForTestCase)
+{
+    static const unsigned int CAPACITY = 8;
+    SpscDescriptorRingGroup<test_descriptor_t> ringGroup(1, CAPACITY); //every producer on the shared ring 0
+    test_descriptor_t descriptor;
+    for (uint64_t i = 0; i < (CAPACITY - 1); ++i) {
+        descriptor.sequence = i;
+        descriptor.bundle.reset(new uint64_t(i));
+        BOOST_REQUIRE(ringGroup.TryPushFor(descriptor, boost::posix_time::milliseconds(0)));
+    }
+    descriptor.sequence = CAPACITY - 1;
+    descriptor.bundle.reset(new uint64_t(CAPACITY - 1));
+    BOOST_REQUIRE(!ringGroup.TryPushFor(descriptor, boost::posix_time::milliseconds(20))); //full, nothing consumed
+    BOOST_REQUIRE(descriptor.bundle); //untouched
+
+    //a consumer which makes room before the timeout lets the waiting push through
+    uint64_t poppedSequence = UINT64_MAX;
+    boost::thread consumerThread([&ringGroup, &poppedSequence]() {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+        test_descriptor_t poppedDescriptor;
+        if (ringGroup.GetRing(0).TryPop(poppedDescriptor)) {
+            poppedSequence = poppedDescriptor.sequence;
+        }
+    });
+    BOOST_REQUIRE(ringGroup.TryPushFor(descriptor, boost::posix_time::seconds(2)));
+    BOOST_REQUIRE(!descriptor.bundle); //moved into the slot
+    consumerThread.join();
+    BOOST_REQUIRE_EQUAL(poppedSequence, 0);
+    for (uint64_t i = 1; i < CAPACITY; ++i) {
+        BOOST_REQUIRE(ringGroup.GetRing(0).TryPop(descriptor));
+        BOOST_REQUIRE_EQUAL(descriptor.sequence, i);
+    }
+}
+
+#ifdef __linux__
+BOOST_AUTO_TEST_CASE(SpscDescriptorRingWakeupTestCase)
+{
+    BOOST_REQUIRE(SpscRingWakeup::IsSupported());
+    static const uint64_t NUM_DESCRIPTORS = 200000;
+    SpscDescriptorRing<test_descriptor_t> ring(64);
+    BOOST_REQUIRE_GE(ring.GetPollFd(), 0);
+
+    boost::thread producerThread([&ring]() {
+        test_descriptor_t descriptor;
+        for (uint64_t i = 0; i < NUM_DESCRIPTORS; ++i) {
+            descriptor.sequence = i;
+            descriptor.bundle.reset(new uint64_t(i));
+            while (!ring.TryPush(descriptor)) {
+                boost::this_thread::yield();
+            }
+            if ((i % 1000) == 0) {
+                boost::this_thread::sleep(boost::posix_time::microseconds(100)); //let the consumer fall asleep now and then
+            }
+        }
+    });
+
+    //the consumer only ever blocks on the file descriptor (with a timeout long enough to fail the test if a wakeup is lost)
+    uint64_t expectedSequence = 0;
+    unsigned int numTimeouts = 0;
+    test_descriptor_t descriptor;
+    while (expectedSequence < NUM_DESCRIPTORS) {
+        const bool mayBlock = ring.PrepareToWait();
+        struct pollfd pfd;
+        pfd.fd = ring.GetPollFd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, (mayBlock) ? 2000 : 0) == 0 && mayBlock) {
+            ++numTimeouts;
+        }
+        ring.FinishWait();
+        while (ring.TryPop(descriptor)) {
+            BOOST_REQUIRE_EQUAL(descriptor.sequence, expectedSequence);
+            BOOST_REQUIRE_EQUAL(*descriptor.bundle, expectedSequence);
+            ++expectedSequence;
+        }
+    }
+    producerThread.join();
+    BOOST_REQUIRE_EQUAL(numTimeouts, 0);
+}
+
+BOOST_AUTO_TEST_CASE(SpscDescriptorRingGroupTestCase)
+{
+    //more producer threads than rings: the first two take rings 1 and 2, the rest share ring 0
+    static const unsigned int NUM_RINGS = 3;
+    static const unsigned int NUM_PRODUCERS = 5;
+    static const uint64_t NUM_DESCRIPTORS_PER_PRODUCER = 50000;
+    SpscDescriptorRingGroup<test_descriptor_t> ringGroup(NUM_RINGS, 64);
+    BOOST_REQUIRE_EQUAL(ringGroup.GetNumRings(), NUM_RINGS);
+    BOOST_REQUIRE_EQUAL(ringGroup.GetNumDedicatedRingsTaken(), 0);
+
+    std::vector<std::unique_ptr<boost::thread> > producerThreads;
+    for (uint64_t producerId = 0; producerId < NUM_PRODUCERS; ++producerId) {
+        producerThreads.emplace_back(new boost::thread([&ringGroup, producerId]() {
+            test_descriptor_t descriptor;
+            for (uint64_t i = 0; i < NUM_DESCRIPTORS_PER_PRODUCER; ++i) {
+                descriptor.sequence = (producerId << 32) | i;
+                descriptor.bundle.reset(new uint64_t(i));
+                while (!ringGroup.TryPush(descriptor)) {
+                    boost::this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    //the consumer blocks on the file descriptors of all rings, and every producer's descriptors must arrive in order
+    std::vector<uint64_t> expectedSequences(NUM_PRODUCERS, 0);
+    std::vector<uint64_t> producerIdOfRing(NUM_RINGS, UINT64_MAX);
+    std::vector<struct pollfd> pfds(NUM_RINGS);
+    uint64_t numPopped = 0;
+    unsigned int numTimeouts = 0;
+    test_descriptor_t descriptor;
+    while (numPopped < (NUM_PRODUCERS * NUM_DESCRIPTORS_PER_PRODUCER)) {
+        bool mayBlock = true;
+        for (unsigned int ringIndex = 0; ringIndex < NUM_RINGS; ++ringIndex) {
+            mayBlock &= ringGroup.GetRing(ringIndex).PrepareToWait();
+            pfds[ringIndex].fd = ringGroup.GetRing(ringIndex).GetPollFd();
+            pfds[ringIndex].events = POLLIN;
+            pfds[ringIndex].revents = 0;
+        }
+        if (poll(pfds.data(), NUM_RINGS, (mayBlock) ? 2000 : 0) == 0 && mayBlock) {
+            ++numTimeouts;
+        }
+        for (unsigned int ringIndex = 0; ringIndex < NUM_RINGS; ++ringIndex) {
+            ringGroup.GetRing(ringIndex).FinishWait();
+            while (ringGroup.GetRing(ringIndex).TryPop(descriptor)) {
+                const uint64_t producerId = descriptor.sequence >> 32;
+                BOOST_REQUIRE_LT(producerId, NUM_PRODUCERS);
+                BOOST_REQUIRE_EQUAL(descriptor.sequence & UINT32_MAX, expectedSequences[producerId]);
+                BOOST_REQUIRE_EQUAL(*descriptor.bundle, expectedSequences[producerId]);
+                ++expectedSequences[producerId];
+                ++numPopped;
+                if (ringIndex != 0) { //a ring taken by a thread holds that thread's descriptors only
+                    if (producerIdOfRing[ringIndex] == UINT64_MAX) {
+                        producerIdOfRing[ringIndex] = producerId;
+                    }
+                    BOOST_REQUIRE_EQUAL(producerIdOfRing[ringIndex], producerId);
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < producerThreads.size(); ++i) {
+        producerThreads[i]->join();
+    }
+    BOOST_REQUIRE_EQUAL(numTimeouts, 0);
+    BOOST_REQUIRE_EQUAL(ringGroup.GetNumDedicatedRingsTaken(), NUM_RINGS - 1);
+    BOOST_REQUIRE_NE(producerIdOfRing[1], producerIdOfRing[2]);
+    for (unsigned int producerId = 0; producerId < NUM_PRODUCERS; ++producerId) {
+        BOOST_REQUIRE_EQUAL(expectedSequences[producerId], NUM_DESCRIPTORS_PER_PRODUCER);
+    }
+}
+#endif
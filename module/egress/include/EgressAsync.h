@@ -35,6 +35,7 @@
 
 namespace hdtn {
 
+struct InprocBundleRings;
 
 class Egress : private boost::noncopyable {
 public:
@@ -43,7 +44,8 @@ public:
     EGRESS_ASYNC_LIB_EXPORT void Stop();
     EGRESS_ASYNC_LIB_EXPORT bool Init(const HdtnConfig& hdtnConfig,
         const HdtnDistributedConfig& hdtnDistributedConfig,
-        zmq::context_t * hdtnOneProcessZmqInprocContextPtr = NULL);
+        zmq::context_t * hdtnOneProcessZmqInprocContextPtr = NULL,
+        InprocBundleRings * hdtnOneProcessInprocBundleRingsPtr = NULL);
 
 private:
 
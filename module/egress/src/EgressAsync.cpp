@@ -31,6 +31,8 @@
 #include "TimestampUtil.h"
 #include "ThreadNamer.h"
 #include "TelemetryServer.h"
+#include "InprocBundleRings.hpp"
+#include "ModuleBusBatcher.hpp"
 
 namespace hdtn {
 
@@ -41,14 +43,18 @@ struct Egress::Impl : private boost::noncopyable {
     Impl();
     ~Impl();
     void Stop();
-    bool Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr);
+    bool Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr,
+        InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr);
 
 private:
     void RouterEventHandler();
     void ReadZmqThreadFunc();
+    void HandleToEgressMessage(const bool isCutThroughFromIngress, const hdtn::ToEgressHdr& toEgressHeader,
+        zmq::message_t& zmqMessageBundle, std::set<uint64_t>& availableDestOpportunisticNodeIdsSet);
     void WholeBundleReadyCallback(padded_vector_uint8_t& wholeBundleVec);
     void OnFailedBundleZmqSendCallback(zmq::message_t& movableBundle, std::vector<uint8_t>& userData, uint64_t outductUuid, bool successCallbackCalled);
     void OnSuccessfulBundleSendCallback(std::vector<uint8_t>& userData, uint64_t outductUuid);
+    void OnEgressAckBatchSendFailed(std::vector<hdtn::EgressAckHdr>& egressAckHdrs, std::vector<zmq::message_t>& unusedBundles);
     void OnOutductLinkStatusChangedCallback(bool isLinkDownEvent, uint64_t outductUuid);
     void ResendOutductCapabilities();
     void RouterEventHandler(hdtn::IreleaseChangeHdr& releaseChangeHdr);
@@ -68,6 +74,7 @@ private:
     std::unique_ptr<zmq::socket_t> m_zmqPullSock_boundIngressToConnectingEgressPtr;
     std::unique_ptr<zmq::socket_t> m_zmqPushSock_connectingEgressToBoundIngressPtr;
     boost::mutex m_mutex_zmqPushSock_connectingEgressToBoundIngress;
+    ModuleBusBatcher<hdtn::EgressAckHdr> m_egressAckToIngressBatcher; //not running unless hdtn config moduleBusBatchMaxMessages > 1 (protected by the mutex above)
     std::unique_ptr<zmq::socket_t> m_zmqPushSock_connectingEgressBundlesOnlyToBoundIngressPtr;
     std::unique_ptr<zmq::socket_t> m_zmqPullSock_connectingStorageToBoundEgressPtr;
     std::unique_ptr<zmq::socket_t> m_zmqPushSock_boundEgressToConnectingStoragePtr;
@@ -81,6 +88,8 @@ private:
     std::unique_ptr<zmq::socket_t> m_zmqPairSock_LinkStatusWaitPtr;
     std::unique_ptr<zmq::socket_t> m_zmqPairSock_LinkStatusNotifyOnePtr;
 
+    InprocBundleRings* m_inprocBundleRingsPtr; //NULL unless one-process with the spsc-ring inproc transport (replaces the first two sockets above)
+
     HdtnConfig m_hdtnConfig;
 
     boost::mutex m_mutexPushBundleToIngress;
@@ -110,6 +119,7 @@ Egress::Impl::Impl() :
     m_totalCustodyTransfersSentToIngress(0),
     m_totalTcpclBundlesReceivedMutexProtected(0),
     m_totalTcpclBundleBytesReceivedMutexProtected(0),
+    m_inprocBundleRingsPtr(NULL),
     m_running(false),
     m_workerThreadStartupInProgress(false) {}
 
@@ -142,12 +152,17 @@ void Egress::Impl::Stop() {
             LOG_ERROR(subprocess) << "error stopping Egress thread: " << e.what();
         }
     }
+    m_egressAckToIngressBatcher.Stop(); //send the last partial batch of acks (later acks are sent unbatched)
 }
 
-bool Egress::Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr) {
-    return m_pimpl->Init(hdtnConfig, hdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr);
+bool Egress::Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr,
+    InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr)
+{
+    return m_pimpl->Init(hdtnConfig, hdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr, hdtnOneProcessInprocBundleRingsPtr);
 }
-bool Egress::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t * hdtnOneProcessZmqInprocContextPtr) {
+bool Egress::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t * hdtnOneProcessZmqInprocContextPtr,
+    InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr)
+{
     
     if (m_running.load(std::memory_order_acquire)) {
         LOG_ERROR(subprocess) << "Egress::Init called while Egress is already running";
@@ -155,6 +170,7 @@ bool Egress::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDistributedConf
     }
 
     m_hdtnConfig = hdtnConfig;
+    m_inprocBundleRingsPtr = (hdtnOneProcessZmqInprocContextPtr) ? hdtnOneProcessInprocBundleRingsPtr : NULL;
 
 
     m_zmqCtxPtr = boost::make_unique<zmq::context_t>(); //needed at least by router pubsub (and if one-process is not used)
@@ -299,6 +315,15 @@ bool Egress::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDistributedConf
         return false;
     }
 
+    //batch the acks of the bundles which ingress cut through to egress
+    if (m_egressAckToIngressBatcher.Start(m_zmqPushSock_connectingEgressToBoundIngressPtr.get(), &m_mutex_zmqPushSock_connectingEgressToBoundIngress,
+        HDTN_MSGTYPE_EGRESS_ACK_BATCH_TO_INGRESS, false, m_hdtnConfig.m_moduleBusBatchMaxMessages,
+        boost::posix_time::microseconds(m_hdtnConfig.m_moduleBusBatchLingerMicroseconds),
+        boost::bind(&Egress::Impl::OnEgressAckBatchSendFailed, this, boost::placeholders::_1, boost::placeholders::_2), "egressAckBatch"))
+    {
+        LOG_INFO(subprocess) << "batching up to " << m_hdtnConfig.m_moduleBusBatchMaxMessages << " acks per message to ingress";
+    }
+
     //load outducts after all zmq sockets created (in case an outduct link status changed callback is called which uses them)
     if (!m_outductManager.LoadOutductsFromConfig(m_hdtnConfig.m_outductsConfig, m_hdtnConfig.m_myNodeId, m_hdtnConfig.m_maxLtpReceiveUdpPacketSizeBytes, m_hdtnConfig.m_maxBundleSizeBytes,
         boost::bind(&Egress::Impl::WholeBundleReadyCallback, this, boost::placeholders::_1),
@@ -386,6 +411,128 @@ void Egress::Impl::RouterEventHandler() {
     }
 }
 
+void Egress::Impl::HandleToEgressMessage(const bool isCutThroughFromIngress, const hdtn::ToEgressHdr& toEgressHeader,
+    zmq::message_t& zmqMessageBundle, std::set<uint64_t>& availableDestOpportunisticNodeIdsSet)
+{
+    if (isCutThroughFromIngress && (toEgressHeader.base.type == HDTN_MSGTYPE_EGRESS_ADD_OPPORTUNISTIC_LINK)) {
+        LOG_INFO(subprocess) << "adding opportunistic link " << toEgressHeader.finalDestEid.nodeId;
+        availableDestOpportunisticNodeIdsSet.insert(toEgressHeader.finalDestEid.nodeId);
+        return;
+    }
+    else if (isCutThroughFromIngress && (toEgressHeader.base.type == HDTN_MSGTYPE_EGRESS_REMOVE_OPPORTUNISTIC_LINK)) {
+        LOG_INFO(subprocess) << "removing opportunistic link " << toEgressHeader.finalDestEid.nodeId;
+        availableDestOpportunisticNodeIdsSet.erase(toEgressHeader.finalDestEid.nodeId);
+        return;
+    }
+    else if (isCutThroughFromIngress && (toEgressHeader.base.type == HDTN_MSGTYPE_BUNDLES_TO_ROUTER)) {
+        LOG_INFO(subprocess) << "forwarding bundle to router";
+        hdtn::LinkStatusHdr linkStatusMsg;
+        linkStatusMsg.base.type = HDTN_MSGTYPE_BUNDLES_TO_ROUTER;
+        while (m_running.load(std::memory_order_acquire) && !m_zmqPushSock_boundEgressToConnectingRouterPtr->send(
+            zmq::const_buffer(&linkStatusMsg, sizeof(linkStatusMsg)), zmq::send_flags::sndmore | zmq::send_flags::dontwait))
+        {
+            LOG_INFO(subprocess) << "waiting for router to become available to send HDTN_MSGTYPE_BUNDLES_TO_ROUTER header";
+            boost::this_thread::sleep(boost::posix_time::seconds(1));
+        }
+        while (m_running.load(std::memory_order_acquire) && !m_zmqPushSock_boundEgressToConnectingRouterPtr->send(zmqMessageBundle, zmq::send_flags::dontwait)) {
+            LOG_INFO(subprocess) << "waiting for router to become available to send it a router-only bundle received by ingress";
+            boost::this_thread::sleep(boost::posix_time::seconds(1));
+        }
+        return;
+    }
+    else if (toEgressHeader.base.type != HDTN_MSGTYPE_EGRESS) {
+        LOG_ERROR(subprocess) << "toEgressHeader.base.type != HDTN_MSGTYPE_EGRESS";
+        return;
+    }
+
+    const uint64_t zmqMessageBundleSize = zmqMessageBundle.size();
+    
+
+    const cbhe_eid_t & finalDestEid = toEgressHeader.finalDestEid;
+    //TODO DERMINE IF availableDestOpportunisticNodeIdsSet IS NEEDED
+    if ((!isCutThroughFromIngress) && (availableDestOpportunisticNodeIdsSet.count(finalDestEid.nodeId) || toEgressHeader.IsOpportunisticLink())) { //from storage and opportunistic link available in ingress
+        hdtn::EgressAckHdr * egressAckPtr = new hdtn::EgressAckHdr();
+        //memset 0 not needed because all values set below
+        egressAckPtr->base.type = HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
+        egressAckPtr->base.flags = 0;
+        egressAckPtr->nextHopNodeId = toEgressHeader.nextHopNodeId;
+        egressAckPtr->finalDestEid = finalDestEid;
+        egressAckPtr->error = EGRESS_ACK_ERROR_TYPE::NO_ERRORS; //can set later before sending this ack if error
+        egressAckPtr->deleteNow = (toEgressHeader.hasCustody == 0);
+        egressAckPtr->isResponseToStorageCutThrough = toEgressHeader.isCutThroughFromStorage;
+        egressAckPtr->custodyId = toEgressHeader.custodyId;
+        egressAckPtr->outductIndex = toEgressHeader.outductIndex;
+
+        zmq::message_t messageWithDataStolen(egressAckPtr, sizeof(hdtn::EgressAckHdr), CustomCleanupEgressAckHdrNoHint); //storage can be acked right away since bundle transferred
+        {
+            boost::mutex::scoped_lock lock(m_mutex_zmqPushSock_boundEgressToConnectingStorage);
+            if (!m_zmqPushSock_boundEgressToConnectingStoragePtr->send(std::move(messageWithDataStolen), zmq::send_flags::dontwait)) {
+                LOG_ERROR(subprocess) << "m_zmqPushSock_boundEgressToConnectingStoragePtr could not send";
+                return;
+            }
+            ++m_totalCustodyTransfersSentToStorage;
+        }
+
+        boost::mutex::scoped_lock lock(m_mutexPushBundleToIngress);
+        static const char messageFlags = 0; //0 => from storage and needs no processing
+        static const zmq::const_buffer messageFlagsConstBuf(&messageFlags, sizeof(messageFlags));
+        if (!m_zmqPushSock_connectingEgressBundlesOnlyToBoundIngressPtr->send(messageFlagsConstBuf, zmq::send_flags::sndmore)) { //blocks if above 5 high water mark
+            LOG_ERROR(subprocess) << "WholeBundleReadyCallback: zmq could not send messageFlagsConstBuf to ingress";
+        }
+        else if (!m_zmqPushSock_connectingEgressBundlesOnlyToBoundIngressPtr->send(std::move(zmqMessageBundle), zmq::send_flags::none)) { //blocks if above 5 high water mark
+            LOG_ERROR(subprocess) << "WholeBundleReadyCallback: zmq could not forward bundle to ingress";
+        }
+        else {
+            ++m_allOutductTelem.m_totalStorageToIngressOpportunisticBundles;
+            m_allOutductTelem.m_totalStorageToIngressOpportunisticBundleBytes += zmqMessageBundleSize;
+        }
+    }
+    else if (Outduct * outduct = m_outductManager.GetOutductByFinalDestinationEid_ThreadSafe(finalDestEid)) {
+        std::vector<uint8_t> userData(sizeof(hdtn::EgressAckHdr));
+        hdtn::EgressAckHdr* egressAckPtr = (hdtn::EgressAckHdr*)userData.data();
+        //memset 0 not needed because all values set below
+        egressAckPtr->base.type = (isCutThroughFromIngress) ? HDTN_MSGTYPE_EGRESS_ACK_TO_INGRESS : HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
+        egressAckPtr->base.flags = 0;
+        egressAckPtr->nextHopNodeId = toEgressHeader.nextHopNodeId;
+        egressAckPtr->finalDestEid = finalDestEid;
+        egressAckPtr->error = EGRESS_ACK_ERROR_TYPE::NO_ERRORS; //can set later before sending this ack if error
+        egressAckPtr->deleteNow = (toEgressHeader.hasCustody == 0);
+        egressAckPtr->isResponseToStorageCutThrough = toEgressHeader.isCutThroughFromStorage;
+        egressAckPtr->custodyId = toEgressHeader.custodyId;
+        egressAckPtr->outductIndex = toEgressHeader.outductIndex;
+        outduct->Forward(zmqMessageBundle, std::move(userData));
+        if (zmqMessageBundle.size() != 0) {
+            LOG_ERROR(subprocess) << "hdtn::HegrManagerAsync::ProcessZmqMessagesThreadFunc, zmqMessage was not moved.. bundle shall remain in storage";
+
+            OnFailedBundleZmqSendCallback(zmqMessageBundle, userData, outduct->GetOutductUuid(), false); //todo is this correct?.. verify userdata not moved
+        }
+        else {
+            m_allOutductTelem.m_totalBundleBytesGivenToOutducts += zmqMessageBundleSize;
+            ++m_allOutductTelem.m_totalBundlesGivenToOutducts;
+        }
+    }
+    else {
+        LOG_INFO(subprocess) << "While processing bundle: no outduct for "
+            << Uri::GetIpnUriString(finalDestEid.nodeId, finalDestEid.serviceId)
+            << " returning to storage";
+
+        std::vector<uint8_t> userData(sizeof(hdtn::EgressAckHdr));
+        hdtn::EgressAckHdr* egressAckPtr = (hdtn::EgressAckHdr*)userData.data();
+        //memset 0 not needed because all values set below
+        egressAckPtr->base.type = (isCutThroughFromIngress) ? HDTN_MSGTYPE_EGRESS_ACK_TO_INGRESS : HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
+        egressAckPtr->base.flags = 0;
+        egressAckPtr->nextHopNodeId = toEgressHeader.nextHopNodeId;
+        egressAckPtr->finalDestEid = finalDestEid;
+        egressAckPtr->error = EGRESS_ACK_ERROR_TYPE::NO_ERRORS; // this is updated in OnFailed... below
+        egressAckPtr->deleteNow = (toEgressHeader.hasCustody == 0); // Doesn't matter, the error flag set in OnFailed will prevent deletion
+        egressAckPtr->isResponseToStorageCutThrough = toEgressHeader.isCutThroughFromStorage;
+        egressAckPtr->custodyId = toEgressHeader.custodyId;
+        egressAckPtr->outductIndex = toEgressHeader.outductIndex;
+
+        OnFailedBundleZmqSendCallback(zmqMessageBundle, userData, NO_OUTDUCT, false);
+    }
+}
+
 void Egress::Impl::ReadZmqThreadFunc() {
     ThreadNamer::SetThisThreadName("egressZmqReader");
 
@@ -415,7 +562,7 @@ void Egress::Impl::ReadZmqThreadFunc() {
     //m_zmqPullSock_boundIngressToConnectingEgressPtr->set(zmq::sockopt::rcvtimeo, timeout);
     //m_zmqPullSock_connectingStorageToBoundEgressPtr->set(zmq::sockopt::rcvtimeo, timeout);
 
-    zmq::pollitem_t items[NUM_SOCKETS] = {
+    std::vector<zmq::pollitem_t> items = {
         {m_zmqPullSock_boundIngressToConnectingEgressPtr->handle(), 0, ZMQ_POLLIN, 0},
         {m_zmqPullSock_connectingStorageToBoundEgressPtr->handle(), 0, ZMQ_POLLIN, 0},
         {m_zmqPullSock_connectingRouterToBoundEgressPtr->handle(), 0, ZMQ_POLLIN, 0},
@@ -423,6 +570,20 @@ void Egress::Impl::ReadZmqThreadFunc() {
         {m_zmqPairSock_LinkStatusWaitPtr->handle(), 0, ZMQ_POLLIN, 0},
         {m_zmqSubSock_boundRouterToConnectingEgressPtr->handle(), 0, ZMQ_POLLIN, 0}
     };
+    //the inproc bundle rings (if used) are polled by their wakeup file descriptors after the sockets:
+    //the storage ring first, then every ring of the ingress producer threads
+    std::vector<ToEgressRing*> inprocRingPtrs;
+    if (m_inprocBundleRingsPtr) {
+        inprocRingPtrs.push_back(&m_inprocBundleRingsPtr->storageToEgressRing);
+        for (unsigned int ringIndex = 0; ringIndex < m_inprocBundleRingsPtr->ingressToEgressRings.GetNumRings(); ++ringIndex) {
+            inprocRingPtrs.push_back(&m_inprocBundleRingsPtr->ingressToEgressRings.GetRing(ringIndex));
+        }
+        for (std::size_t ringIndex = 0; ringIndex < inprocRingPtrs.size(); ++ringIndex) {
+            items.push_back({NULL, inprocRingPtrs[ringIndex]->GetPollFd(), ZMQ_POLLIN, 0});
+        }
+    }
+    ToEgressDescriptor ringDescriptor;
+    std::vector<hdtn::ToEgressHdr> toEgressHdrsBatch;
     zmq::socket_t * const firstTwoSockets[2] = {
         m_zmqPullSock_boundIngressToConnectingEgressPtr.get(),
         m_zmqPullSock_connectingStorageToBoundEgressPtr.get()
@@ -441,12 +602,31 @@ void Egress::Impl::ReadZmqThreadFunc() {
     static const long DEFAULT_BIG_TIMEOUT_POLL = 250; // milliseconds
     while (m_running.load(std::memory_order_acquire)) { //keep thread alive if running
         int rc = 0;
+        long timeoutPoll = DEFAULT_BIG_TIMEOUT_POLL;
+        for (std::size_t ringIndex = 0; ringIndex < inprocRingPtrs.size(); ++ringIndex) {
+            if (!inprocRingPtrs[ringIndex]->PrepareToWait()) { //not empty
+                timeoutPoll = 0;
+            }
+        }
         try {
-            rc = zmq::poll(&items[0], NUM_SOCKETS, DEFAULT_BIG_TIMEOUT_POLL);
+            rc = zmq::poll(items.data(), items.size(), timeoutPoll);
         }
         catch (zmq::error_t & e) {
             LOG_ERROR(subprocess) << "caught zmq::error_t in hdtn::HegrManagerAsync::ReadZmqThreadFunc: " << e.what();
-            continue;
+            rc = 0;
+        }
+        if (m_inprocBundleRingsPtr) {
+            //at most one ring's worth each so that the sockets are not starved
+            for (std::size_t ringIndex = 0; ringIndex < inprocRingPtrs.size(); ++ringIndex) {
+                ToEgressRing& ring = *inprocRingPtrs[ringIndex];
+                ring.FinishWait();
+                const bool isFromIngress = (ringIndex != 0);
+                const unsigned int maxToPop = ring.GetCapacity();
+                for (unsigned int i = 0; (i < maxToPop) && ring.TryPop(ringDescriptor); ++i) {
+                    HandleToEgressMessage(isFromIngress, ringDescriptor.toEgressHdr, ringDescriptor.bundle, availableDestOpportunisticNodeIdsSet);
+                }
+            }
+            ringDescriptor.bundle.rebuild(); //release a bundle that wasn't moved into an outduct
         }
         if (rc > 0) {
             for (unsigned int itemIndex = 0; itemIndex < 2; ++itemIndex) { //skip m_zmqPullSignalInprocSockPtr in this loop
@@ -455,150 +635,46 @@ void Egress::Impl::ReadZmqThreadFunc() {
                     continue;
                 }
 
-                const bool isCutThroughFromIngress = (itemIndex == 0);
-
                 hdtn::ToEgressHdr toEgressHeader;
                 const zmq::recv_buffer_result_t res = firstTwoSockets[itemIndex]->recv(zmq::mutable_buffer(&toEgressHeader, sizeof(hdtn::ToEgressHdr)), zmq::recv_flags::none);
                 if (!res) {
                     LOG_ERROR(subprocess) << "HegrManagerAsync::ReadZmqThreadFunc: cannot read BlockHdr";
                     continue;
                 }
-                else if ((res->truncated()) || (res->size != sizeof(hdtn::ToEgressHdr))) {
-                    LOG_ERROR(subprocess) << "blockhdr message mismatch: untruncated = " << res->untruncated_size 
-                        << " truncated = " << res->size << " expected = " << sizeof(hdtn::ToEgressHdr);
-                    continue;
-                }
-                else if ((itemIndex == 0) && (toEgressHeader.base.type == HDTN_MSGTYPE_EGRESS_ADD_OPPORTUNISTIC_LINK)) {
-                    LOG_INFO(subprocess) << "adding opportunistic link " << toEgressHeader.finalDestEid.nodeId;
-                    availableDestOpportunisticNodeIdsSet.insert(toEgressHeader.finalDestEid.nodeId);
-                    continue;
-                }
-                else if ((itemIndex == 0) && (toEgressHeader.base.type == HDTN_MSGTYPE_EGRESS_REMOVE_OPPORTUNISTIC_LINK)) {
-                    LOG_INFO(subprocess) << "removing opportunistic link " << toEgressHeader.finalDestEid.nodeId;
-                    availableDestOpportunisticNodeIdsSet.erase(toEgressHeader.finalDestEid.nodeId);
-                    continue;
-                }
-                else if ((itemIndex == 0) && (toEgressHeader.base.type == HDTN_MSGTYPE_BUNDLES_TO_ROUTER)) {
-                    LOG_INFO(subprocess) << "forwarding bundle to router";
-                    zmq::message_t zmqMessageBundleToRouter;
-                    //message guaranteed to be there due to the zmq::send_flags::sndmore
-                    if (!firstTwoSockets[itemIndex]->recv(zmqMessageBundleToRouter, zmq::recv_flags::none)) {
-                        LOG_ERROR(subprocess) << "error receiving zmqMessageBundleToRouter";
+                else if ((res->size == sizeof(hdtn::BatchHdr)) && (toEgressHeader.base.type == HDTN_MSGTYPE_EGRESS_BATCH)) {
+                    hdtn::BatchHdr batchHdr;
+                    memcpy(&batchHdr, &toEgressHeader, sizeof(hdtn::BatchHdr));
+                    if (!ModuleBusBatcher<hdtn::ToEgressHdr>::ReceiveHeaders(*firstTwoSockets[itemIndex], batchHdr, toEgressHdrsBatch)) {
+                        LOG_ERROR(subprocess) << "cannot read the " << batchHdr.numMessages << " ToEgressHdr of a bundle batch";
+                        ModuleBusBatcher<hdtn::ToEgressHdr>::DiscardRemainingParts(*firstTwoSockets[itemIndex]);
+                        continue;
                     }
-                    else {
-                        hdtn::LinkStatusHdr linkStatusMsg;
-                        linkStatusMsg.base.type = HDTN_MSGTYPE_BUNDLES_TO_ROUTER;
-                        while (m_running.load(std::memory_order_acquire) && !m_zmqPushSock_boundEgressToConnectingRouterPtr->send(
-                            zmq::const_buffer(&linkStatusMsg, sizeof(linkStatusMsg)), zmq::send_flags::sndmore | zmq::send_flags::dontwait))
-                        {
-                            LOG_INFO(subprocess) << "waiting for router to become available to send HDTN_MSGTYPE_BUNDLES_TO_ROUTER header";
-                            boost::this_thread::sleep(boost::posix_time::seconds(1));
-                        }
-                        while (m_running.load(std::memory_order_acquire) && !m_zmqPushSock_boundEgressToConnectingRouterPtr->send(zmqMessageBundleToRouter, zmq::send_flags::dontwait)) {
-                            LOG_INFO(subprocess) << "waiting for router to become available to send it a router-only bundle received by ingress";
-                            boost::this_thread::sleep(boost::posix_time::seconds(1));
+                    for (std::size_t i = 0; i < toEgressHdrsBatch.size(); ++i) {
+                        zmq::message_t zmqMessageBundle;
+                        //message guaranteed to be there due to the zmq::send_flags::sndmore
+                        if (!firstTwoSockets[itemIndex]->recv(zmqMessageBundle, zmq::recv_flags::none)) {
+                            LOG_ERROR(subprocess) << "error receiving bundle " << i << " of a bundle batch";
+                            break;
                         }
+                        HandleToEgressMessage((itemIndex == 0), toEgressHdrsBatch[i], zmqMessageBundle, availableDestOpportunisticNodeIdsSet);
                     }
                     continue;
                 }
-                else if (toEgressHeader.base.type != HDTN_MSGTYPE_EGRESS) {
-                    LOG_ERROR(subprocess) << "toEgressHeader.base.type != HDTN_MSGTYPE_EGRESS";
-                    continue;
-                }
-                
-                zmq::message_t zmqMessageBundle;
-                //message guaranteed to be there due to the zmq::send_flags::sndmore
-                if (!firstTwoSockets[itemIndex]->recv(zmqMessageBundle, zmq::recv_flags::none)) {
-                    LOG_ERROR(subprocess) << "error on sockets[itemIndex]->recv";
+                else if ((res->truncated()) || (res->size != sizeof(hdtn::ToEgressHdr))) {
+                    LOG_ERROR(subprocess) << "blockhdr message mismatch: untruncated = " << res->untruncated_size 
+                        << " truncated = " << res->size << " expected = " << sizeof(hdtn::ToEgressHdr);
                     continue;
                 }
-                const uint64_t zmqMessageBundleSize = zmqMessageBundle.size();
-                
 
-                const cbhe_eid_t & finalDestEid = toEgressHeader.finalDestEid;
-                //TODO DERMINE IF availableDestOpportunisticNodeIdsSet IS NEEDED
-                if ((itemIndex == 1) && (availableDestOpportunisticNodeIdsSet.count(finalDestEid.nodeId) || toEgressHeader.IsOpportunisticLink())) { //from storage and opportunistic link available in ingress
-                    hdtn::EgressAckHdr * egressAckPtr = new hdtn::EgressAckHdr();
-                    //memset 0 not needed because all values set below
-                    egressAckPtr->base.type = HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
-                    egressAckPtr->base.flags = 0;
-                    egressAckPtr->nextHopNodeId = toEgressHeader.nextHopNodeId;
-                    egressAckPtr->finalDestEid = finalDestEid;
-                    egressAckPtr->error = EGRESS_ACK_ERROR_TYPE::NO_ERRORS; //can set later before sending this ack if error
-                    egressAckPtr->deleteNow = (toEgressHeader.hasCustody == 0);
-                    egressAckPtr->isResponseToStorageCutThrough = toEgressHeader.isCutThroughFromStorage;
-                    egressAckPtr->custodyId = toEgressHeader.custodyId;
-                    egressAckPtr->outductIndex = toEgressHeader.outductIndex;
-
-                    zmq::message_t messageWithDataStolen(egressAckPtr, sizeof(hdtn::EgressAckHdr), CustomCleanupEgressAckHdrNoHint); //storage can be acked right away since bundle transferred
-                    {
-                        boost::mutex::scoped_lock lock(m_mutex_zmqPushSock_boundEgressToConnectingStorage);
-                        if (!m_zmqPushSock_boundEgressToConnectingStoragePtr->send(std::move(messageWithDataStolen), zmq::send_flags::dontwait)) {
-                            LOG_ERROR(subprocess) << "m_zmqPushSock_boundEgressToConnectingStoragePtr could not send";
-                            break;
-                        }
-                        ++m_totalCustodyTransfersSentToStorage;
-                    }
-
-                    boost::mutex::scoped_lock lock(m_mutexPushBundleToIngress);
-                    static const char messageFlags = 0; //0 => from storage and needs no processing
-                    static const zmq::const_buffer messageFlagsConstBuf(&messageFlags, sizeof(messageFlags));
-                    if (!m_zmqPushSock_connectingEgressBundlesOnlyToBoundIngressPtr->send(messageFlagsConstBuf, zmq::send_flags::sndmore)) { //blocks if above 5 high water mark
-                        LOG_ERROR(subprocess) << "WholeBundleReadyCallback: zmq could not send messageFlagsConstBuf to ingress";
-                    }
-                    else if (!m_zmqPushSock_connectingEgressBundlesOnlyToBoundIngressPtr->send(std::move(zmqMessageBundle), zmq::send_flags::none)) { //blocks if above 5 high water mark
-                        LOG_ERROR(subprocess) << "WholeBundleReadyCallback: zmq could not forward bundle to ingress";
-                    }
-                    else {
-                        ++m_allOutductTelem.m_totalStorageToIngressOpportunisticBundles;
-                        m_allOutductTelem.m_totalStorageToIngressOpportunisticBundleBytes += zmqMessageBundleSize;
-                    }
-                }
-                else if (Outduct * outduct = m_outductManager.GetOutductByFinalDestinationEid_ThreadSafe(finalDestEid)) {
-                    std::vector<uint8_t> userData(sizeof(hdtn::EgressAckHdr));
-                    hdtn::EgressAckHdr* egressAckPtr = (hdtn::EgressAckHdr*)userData.data();
-                    //memset 0 not needed because all values set below
-                    egressAckPtr->base.type = (isCutThroughFromIngress) ? HDTN_MSGTYPE_EGRESS_ACK_TO_INGRESS : HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
-                    egressAckPtr->base.flags = 0;
-                    egressAckPtr->nextHopNodeId = toEgressHeader.nextHopNodeId;
-                    egressAckPtr->finalDestEid = finalDestEid;
-                    egressAckPtr->error = EGRESS_ACK_ERROR_TYPE::NO_ERRORS; //can set later before sending this ack if error
-                    egressAckPtr->deleteNow = (toEgressHeader.hasCustody == 0);
-                    egressAckPtr->isResponseToStorageCutThrough = toEgressHeader.isCutThroughFromStorage;
-                    egressAckPtr->custodyId = toEgressHeader.custodyId;
-                    egressAckPtr->outductIndex = toEgressHeader.outductIndex;
-                    outduct->Forward(zmqMessageBundle, std::move(userData));
-                    if (zmqMessageBundle.size() != 0) {
-                        LOG_ERROR(subprocess) << "hdtn::HegrManagerAsync::ProcessZmqMessagesThreadFunc, zmqMessage was not moved.. bundle shall remain in storage";
-
-                        OnFailedBundleZmqSendCallback(zmqMessageBundle, userData, outduct->GetOutductUuid(), false); //todo is this correct?.. verify userdata not moved
-                    }
-                    else {
-                        m_allOutductTelem.m_totalBundleBytesGivenToOutducts += zmqMessageBundleSize;
-                        ++m_allOutductTelem.m_totalBundlesGivenToOutducts;
+                zmq::message_t zmqMessageBundle;
+                if ((toEgressHeader.base.type == HDTN_MSGTYPE_EGRESS) || ((itemIndex == 0) && (toEgressHeader.base.type == HDTN_MSGTYPE_BUNDLES_TO_ROUTER))) {
+                    //message guaranteed to be there due to the zmq::send_flags::sndmore
+                    if (!firstTwoSockets[itemIndex]->recv(zmqMessageBundle, zmq::recv_flags::none)) {
+                        LOG_ERROR(subprocess) << "error on sockets[itemIndex]->recv";
+                        continue;
                     }
                 }
-                else {
-                    LOG_INFO(subprocess) << "While processing bundle: no outduct for "
-                        << Uri::GetIpnUriString(finalDestEid.nodeId, finalDestEid.serviceId)
-                        << " returning to storage";
-
-                    std::vector<uint8_t> userData(sizeof(hdtn::EgressAckHdr));
-                    hdtn::EgressAckHdr* egressAckPtr = (hdtn::EgressAckHdr*)userData.data();
-                    //memset 0 not needed because all values set below
-                    egressAckPtr->base.type = (isCutThroughFromIngress) ? HDTN_MSGTYPE_EGRESS_ACK_TO_INGRESS : HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
-                    egressAckPtr->base.flags = 0;
-                    egressAckPtr->nextHopNodeId = toEgressHeader.nextHopNodeId;
-                    egressAckPtr->finalDestEid = finalDestEid;
-                    egressAckPtr->error = EGRESS_ACK_ERROR_TYPE::NO_ERRORS; // this is updated in OnFailed... below
-                    egressAckPtr->deleteNow = (toEgressHeader.hasCustody == 0); // Doesn't matter, the error flag set in OnFailed will prevent deletion
-                    egressAckPtr->isResponseToStorageCutThrough = toEgressHeader.isCutThroughFromStorage;
-                    egressAckPtr->custodyId = toEgressHeader.custodyId;
-                    egressAckPtr->outductIndex = toEgressHeader.outductIndex;
-
-                    OnFailedBundleZmqSendCallback(zmqMessageBundle, userData, NO_OUTDUCT, false);
-                }
-
+                HandleToEgressMessage((itemIndex == 0), toEgressHeader, zmqMessageBundle, availableDestOpportunisticNodeIdsSet);
             }
 
             if (items[2].revents & ZMQ_POLLIN) { //events from Router
@@ -834,6 +910,7 @@ void Egress::Impl::OnFailedBundleZmqSendCallback(zmq::message_t& movableBundle,
             //send ack message to ingress
             {
                 boost::mutex::scoped_lock lock(m_mutex_zmqPushSock_connectingEgressToBoundIngress);
+                m_egressAckToIngressBatcher.Send_NotThreadSafe(); //the link down ack must not overtake the acks already batched
                 if (!m_zmqPushSock_connectingEgressToBoundIngressPtr->send(std::move(zmqUserDataMessageWithDataStolen), zmq::send_flags::dontwait)) {
                     LOG_ERROR(subprocess) << "zmq could not send ingress an ack from egress";
                 }
@@ -886,6 +963,16 @@ void Egress::Impl::OnSuccessfulBundleSendCallback(std::vector<uint8_t>& userData
 
     static constexpr bool isLinkDownEvent = false;
     OnOutductLinkStatusChangedCallback(isLinkDownEvent, outductUuid);
+
+    const hdtn::EgressAckHdr& egressAck = *((const hdtn::EgressAckHdr*)userData.data());
+    if (egressAck.base.type != HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE) {
+        boost::mutex::scoped_lock lock(m_mutex_zmqPushSock_connectingEgressToBoundIngress);
+        if (m_egressAckToIngressBatcher.IsRunning_NotThreadSafe()) {
+            m_egressAckToIngressBatcher.Append_NotThreadSafe(egressAck, NULL); //copied into the batch
+            ++m_totalCustodyTransfersSentToIngress;
+            return;
+        }
+    }
     
     //this is an optimization because we only have one chunk to send
     //The zmq_msg_init_data() function shall initialise the message object referenced by msg
@@ -912,6 +999,11 @@ void Egress::Impl::OnSuccessfulBundleSendCallback(std::vector<uint8_t>& userData
         ++m_totalCustodyTransfersSentToIngress;
     }
 }
+//called by m_egressAckToIngressBatcher (from HandleFailedBatches) without m_mutex_zmqPushSock_connectingEgressToBoundIngress held
+void Egress::Impl::OnEgressAckBatchSendFailed(std::vector<hdtn::EgressAckHdr>& egressAckHdrs, std::vector<zmq::message_t>& unusedBundles) {
+    (void)unusedBundles;
+    LOG_ERROR(subprocess) << "zmq could not send ingress a batch of " << egressAckHdrs.size() << " acks from egress";
+}
 //Inform router only if the physical link status actually changes or the physical link status is initially unknown.
 //Note: LTP "ping" maintains its own physical link status and will also only call this function if the physical link status actually changes
 void Egress::Impl::OnOutductLinkStatusChangedCallback(bool isLinkDownEvent, uint64_t outductUuid) {
@@ -22,8 +22,10 @@
 
 #include <fstream>
 #include <iostream>
+#include <algorithm>
 #include "Logger.h"
 #include "message.hpp"
+#include "InprocBundleRings.hpp"
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/program_options.hpp>
@@ -80,6 +82,7 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
         bool useMgr;
         boost::filesystem::path contactPlanFilePath;
         std::string maskerImpl;
+        bool useSpscRingInprocTransport;
 
 #ifdef RUN_TELEMETRY
         TelemetryRunnerProgramOptions telemetryRunnerOptions;
@@ -95,6 +98,7 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
                 ("use-unix-timestamp", "Use unix timestamp in contact plan.")
                 ("use-mgr", "Use Multigraph Routing Algorithm")
                 ("masker", boost::program_options::value<std::string>()->default_value(""), "Which Masker implementation to use")
+                ("inproc-transport", boost::program_options::value<std::string>()->default_value("zmq"), "Transport of bundles from ingress and storage to egress: zmq or spsc-ring (Linux only).")
                 ;
 #ifdef RUN_TELEMETRY
             TelemetryRunnerProgramOptions::AppendToDesc(desc);
@@ -142,6 +146,21 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
             LOG_INFO(subprocess) << "ContactPlan file: " << contactPlanFilePath;
 
             maskerImpl = vm["masker"].as<std::string>();
+
+            const std::string inprocTransport = vm["inproc-transport"].as<std::string>();
+            if (inprocTransport == "zmq") {
+                useSpscRingInprocTransport = false;
+            }
+            else if (inprocTransport == "spsc-ring") {
+                useSpscRingInprocTransport = SpscRingWakeup::IsSupported();
+                if (!useSpscRingInprocTransport) {
+                    LOG_WARNING(subprocess) << "inproc-transport spsc-ring is not supported on this platform, using zmq";
+                }
+            }
+            else {
+                LOG_ERROR(subprocess) << "invalid inproc-transport " << inprocTransport << " (must be zmq or spsc-ring)";
+                return false;
+            }
         }
         catch (boost::bad_any_cast & e) {
             LOG_ERROR(subprocess) << "invalid data error: " << e.what();
@@ -160,6 +179,14 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
         //The io_threads argument specifies the size of the 0MQ thread pool to handle I/O operations.
         //If your application is using only the inproc transport for messaging you may set this to zero, otherwise set it to at least one.
         std::unique_ptr<zmq::context_t> hdtnOneProcessZmqInprocContextPtr = boost::make_unique<zmq::context_t>(0);// 0 Threads
+        std::unique_ptr<hdtn::InprocBundleRings> hdtnOneProcessInprocBundleRingsPtr;
+        if (useSpscRingInprocTransport) {
+            LOG_INFO(subprocess) << "using spsc rings for bundles to egress";
+            //a ring of its own for every induct (its receiving thread) and ingress worker, so that they don't share ring 0 under its mutex
+            const uint64_t numIngressProducerThreads = hdtnConfig->m_inductsConfig.m_inductElementConfigVector.size() + hdtnConfig->m_numIngressWorkerThreads;
+            hdtnOneProcessInprocBundleRingsPtr = boost::make_unique<hdtn::InprocBundleRings>(static_cast<unsigned int>(
+                std::max<uint64_t>(HDTN_INPROC_BUNDLE_NUM_PRODUCER_RINGS, numIngressProducerThreads + 1)));
+        }
 
         LOG_INFO(subprocess) << "starting Router..";
         std::unique_ptr<Router> routerPtr = boost::make_unique<Router>();
@@ -171,7 +198,7 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
         //No need to create Egress, Ingress, and Storage on heap with unique_ptr to prevent stack overflows because they use the pimpl pattern
         //However, the unique_ptr reset() function is useful for isolating destructor hangs on exit
         std::unique_ptr<hdtn::Egress> egressPtr = boost::make_unique<hdtn::Egress>();
-        if (!egressPtr->Init(*hdtnConfig, unusedHdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr.get())) {
+        if (!egressPtr->Init(*hdtnConfig, unusedHdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr.get(), hdtnOneProcessInprocBundleRingsPtr.get())) {
             return false;
         }
 
@@ -180,7 +207,8 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
         if (!ingressPtr->Init(*hdtnConfig, bpSecConfigFilePath,
             unusedHdtnDistributedConfig,
             hdtnOneProcessZmqInprocContextPtr.get(),
-            maskerImpl))
+            maskerImpl,
+            hdtnOneProcessInprocBundleRingsPtr.get()))
         {
             return false;
         }
@@ -188,7 +216,8 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
         LOG_INFO(subprocess) << "starting Storage..";
         std::unique_ptr<ZmqStorageInterface> storagePtr = boost::make_unique<ZmqStorageInterface>();
         if (!storagePtr->Init(*hdtnConfig, unusedHdtnDistributedConfig,
-            hdtnOneProcessZmqInprocContextPtr.get()))
+            hdtnOneProcessZmqInprocContextPtr.get(),
+            hdtnOneProcessInprocBundleRingsPtr.get()))
         {
             return false;
         }
@@ -262,6 +291,8 @@ bool HdtnOneProcessRunner::Run(int argc, const char *const argv[], std::atomic<b
         LOG_INFO(subprocess) << "Egress: deleting..";
         egressPtr.reset();
 
+        hdtnOneProcessInprocBundleRingsPtr.reset(); //after all producers and the consumer are deleted
+
         LOG_INFO(subprocess) << "Inproc zmq context: deleting..";
         hdtnOneProcessZmqInprocContextPtr.reset();
 
@@ -0,0 +1,91 @@
+/**
+ * @file BundlePipelineAckingSet.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * The BundlePipelineAckingSet class is the lock-free accounting (used by ingress) of the bundles in flight
+ * on an outduct's egress and storage cut-through paths.
+ * Each path's budget (number of bundles and bytes, packed into one word so that both are taken by one compare-and-swap)
+ * is reserved by the induct (or ingress worker) threads and given back by the acks without a lock, and the in flight
+ * unique ids (with their sizes) are kept in an open addressing table of atomic slots.  A reserving thread only takes
+ * the mutex to wait when its paths are full, and each ack wakes at most one waiter (which wakes the next one if it got budget).
+ * The packed word holds at most BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE bundles (and 2^44 - 1 bytes) per path,
+ * so larger limits are clamped with an error log.
+ */
+
+#ifndef _BUNDLE_PIPELINE_ACKING_SET_H
+#define _BUNDLE_PIPELINE_ACKING_SET_H 1
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <boost/core/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "ingress_async_lib_export.h"
+
+//the limit of an outduct's maxBundlesInPipeline (a path is limited to half of it), bounded by the 20 bundle count bits of the packed word
+#define BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE (static_cast<uint64_t>(1) << 20)
+
+namespace hdtn {
+
+class BundlePipelineAckingSet : private boost::noncopyable {
+public:
+    BundlePipelineAckingSet() = delete; //vector resize() not possible, must use reserve()
+    INGRESS_ASYNC_LIB_EXPORT BundlePipelineAckingSet(const uint64_t paramMaxBundlesInPipeline,
+        const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp);
+    INGRESS_ASYNC_LIB_EXPORT void Update(const uint64_t paramMaxBundlesInPipeline,
+        const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp);
+
+    INGRESS_ASYNC_LIB_EXPORT bool CompareAndPop_ThreadSafe(const uint64_t uniqueId, const bool isEgress);
+
+    INGRESS_ASYNC_LIB_EXPORT bool WaitForPipelineAvailabilityAndReserve(const bool checkEgressPipeline, const bool checkStoragePipeline,
+        const boost::posix_time::time_duration& timeoutDuration, const uint64_t uniqueId, const uint64_t bundleSizeBytes,
+        bool& reservedEgressPipelineAvailability, bool& reservedStoragePipelineAvailability);
+    INGRESS_ASYNC_LIB_EXPORT bool WaitForStoragePipelineAvailabilityAndReserve(const boost::posix_time::time_duration& timeoutDuration,
+        const uint64_t uniqueId, const uint64_t bundleSizeBytes);
+    INGRESS_ASYNC_LIB_EXPORT uint64_t GetNextHopNodeId() const;
+    /// @return The number of bundles reserved on the egress (or storage) path and not yet popped.
+    INGRESS_ASYNC_LIB_EXPORT uint64_t GetNumBundlesInPipeline(const bool isEgress) const noexcept;
+    /// @return The sum of the sizes of the bundles reserved on the egress (or storage) path and not yet popped.
+    INGRESS_ASYNC_LIB_EXPORT uint64_t GetNumBytesInPipeline(const bool isEgress) const noexcept;
+    /// @return The (possibly clamped) number of bundles a path may keep in flight.
+    INGRESS_ASYNC_LIB_EXPORT uint64_t GetHalfOfMaxBundlesInPipeline() const noexcept;
+private:
+    struct InFlightSlot {
+        std::atomic<uint64_t> uniqueIdPlusOne; //0 => empty
+        std::atomic<uint64_t> bundleSizeBytes;
+    };
+    struct PathInFlight {
+        std::atomic<uint64_t> packedBundlesAndBytes; //number of bundles in the upper bits, bytes in the lower bits
+        std::unique_ptr<InFlightSlot[]> slots;
+    };
+    bool TryReserve(PathInFlight& path, const uint64_t uniqueId, const uint64_t bundleSizeBytes);
+    void WakeOneWaiter();
+
+    PathInFlight m_egressPath;
+    PathInFlight m_storagePath;
+    uint64_t m_slotsMask;
+    std::atomic<uint64_t> m_halfOfMaxBundlesInPipeline;
+    std::atomic<uint64_t> m_halfOfMaxBytesInPipeline;
+    std::atomic<unsigned int> m_numWaiters;
+    boost::mutex m_waitMutex;
+    boost::condition_variable m_waitConditionVariable;
+    uint64_t m_nextHopNodeId;
+public:
+    bool m_linkIsUp;
+};
+
+}  // namespace hdtn
+
+#endif  //_BUNDLE_PIPELINE_ACKING_SET_H
@@ -0,0 +1,85 @@
+/**
+ * @file IngressWorkerPool.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * The IngressWorkerPool class is the pool of ingress worker threads (hdtn config numIngressWorkerThreads)
+ * which process (decode, bpsec, mask and route) the bundles received by the inducts.
+ * Each induct is pinned to one worker (its induct index modulo the number of workers), and each worker processes
+ * its bundles in the order they were pushed, so the bundles of one induct are forwarded in the order received.
+ * An induct thread blocks while its worker's queue is full (flow control), even if other workers are idle,
+ * so a single induct is processed by one worker at a time and only separate inducts are processed in parallel.
+ */
+
+#ifndef _INGRESS_WORKER_POOL_H
+#define _INGRESS_WORKER_POOL_H 1
+
+#include <cstdint>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <boost/core/noncopyable.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "PaddedVectorUint8.h"
+#include "ingress_async_lib_export.h"
+
+namespace hdtn {
+
+class IngressWorkerPool : private boost::noncopyable {
+public:
+    typedef boost::function<void(padded_vector_uint8_t & movableBundle)> ProcessBundleCallback_t;
+
+    INGRESS_ASYNC_LIB_EXPORT IngressWorkerPool();
+    INGRESS_ASYNC_LIB_EXPORT ~IngressWorkerPool();
+    /**
+     * Start the worker threads.
+     * @param numWorkers The number of worker threads (0 starts none).
+     * @param maxQueuedBundlesPerWorker The most bundles queued to a worker before a pushing thread blocks.
+     * @param processBundleCallback Called on a worker thread for each bundle pushed.
+     */
+    INGRESS_ASYNC_LIB_EXPORT void Start(const unsigned int numWorkers, const std::size_t maxQueuedBundlesPerWorker,
+        const ProcessBundleCallback_t & processBundleCallback);
+    /// Stop the worker threads once they have processed every bundle already queued.
+    INGRESS_ASYNC_LIB_EXPORT void Stop();
+    /**
+     * Queue a bundle to the worker of its induct, blocking while that worker's queue is full.
+     * @param inductIndex The index (in the inducts config) of the induct which received the bundle.
+     * @param movableBundle The bundle, moved into the queue.
+     * @return True if queued, or false if the pool is not running (the bundle is dropped).
+     */
+    INGRESS_ASYNC_LIB_EXPORT bool Push(const uint64_t inductIndex, padded_vector_uint8_t & movableBundle);
+    INGRESS_ASYNC_LIB_EXPORT std::size_t GetNumWorkers() const noexcept;
+
+private:
+    struct Worker : private boost::noncopyable {
+        std::unique_ptr<boost::thread> threadPtr;
+        boost::mutex mutex;
+        boost::condition_variable conditionVariableNotEmpty;
+        boost::condition_variable conditionVariableNotFull;
+        std::deque<padded_vector_uint8_t> bundles; //protected by mutex
+    };
+    typedef std::unique_ptr<Worker> WorkerPtr_t;
+    INGRESS_ASYNC_LIB_NO_EXPORT void WorkerThreadFunc(Worker* workerPtr, const unsigned int workerIndex);
+
+    std::vector<WorkerPtr_t> m_workersVec;
+    std::atomic<bool> m_running;
+    std::size_t m_maxQueuedBundlesPerWorker;
+    ProcessBundleCallback_t m_processBundleCallback;
+};
+
+} // namespace hdtn
+
+#endif //_INGRESS_WORKER_POOL_H
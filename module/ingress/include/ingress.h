@@ -22,6 +22,7 @@
 #define _HDTN_INGRESS_H
 
 #include <cstdint>
+#include <atomic>
 #include "zmq.hpp"
 #include <memory>
 #include "HdtnConfig.h"
@@ -32,6 +33,7 @@
 
 namespace hdtn {
 
+struct InprocBundleRings;
 
 class Ingress : private boost::noncopyable {
 public:
@@ -41,7 +43,8 @@ public:
     INGRESS_ASYNC_LIB_EXPORT bool Stopped() noexcept;
     INGRESS_ASYNC_LIB_EXPORT bool Init(const HdtnConfig& hdtnConfig,
         const boost::filesystem::path& bpSecConfigFilePath, const HdtnDistributedConfig& hdtnDistributedConfig,
-        zmq::context_t* hdtnOneProcessZmqInprocContextPtr = NULL, const std::string& maskerImpl = "");
+        zmq::context_t* hdtnOneProcessZmqInprocContextPtr = NULL, const std::string& maskerImpl = "",
+        InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr = NULL);
 private:
 
     // Internal implementation class
@@ -51,10 +54,10 @@ private:
     std::unique_ptr<Impl> m_pimpl;
 
 public:
-    uint64_t& m_bundleCountStorage;
-    uint64_t& m_bundleByteCountStorage;
-    uint64_t& m_bundleCountEgress;
-    uint64_t& m_bundleByteCountEgress;
+    std::atomic<uint64_t>& m_bundleCountStorage;
+    std::atomic<uint64_t>& m_bundleByteCountStorage;
+    std::atomic<uint64_t>& m_bundleCountEgress;
+    std::atomic<uint64_t>& m_bundleByteCountEgress;
 };
 
 
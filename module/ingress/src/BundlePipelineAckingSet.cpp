@@ -0,0 +1,194 @@
+/**
+ * @file BundlePipelineAckingSet.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "BundlePipelineAckingSet.h"
+#include "Logger.h"
+#include <algorithm>
+
+namespace hdtn {
+
+static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::ingress;
+static constexpr unsigned int PIPELINE_PACKED_BYTES_BITS = 44;
+static_assert((BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE >> 1) < (static_cast<uint64_t>(1) << (64 - PIPELINE_PACKED_BYTES_BITS)),
+    "the bundle count of a path must fit in the upper bits of its packed word");
+static constexpr uint64_t PIPELINE_PACKED_BYTES_MASK = (static_cast<uint64_t>(1) << PIPELINE_PACKED_BYTES_BITS) - 1;
+static constexpr uint64_t PIPELINE_PACKED_ONE_BUNDLE = static_cast<uint64_t>(1) << PIPELINE_PACKED_BYTES_BITS;
+static constexpr uint64_t PIPELINE_IN_FLIGHT_SLOT_CLAIMED = UINT64_MAX; //being filled in by a reserving thread
+static constexpr uint64_t PIPELINE_MIN_IN_FLIGHT_SLOTS = 64;
+
+BundlePipelineAckingSet::BundlePipelineAckingSet(const uint64_t paramMaxBundlesInPipeline,
+    const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp) :
+    m_numWaiters(0)
+{
+    //at least twice the max bundles in pipeline so that a path (limited to half of them) keeps its table at most a quarter full
+    //(Update logs the clamp)
+    const uint64_t maxBundlesInPipeline = std::min(paramMaxBundlesInPipeline, BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE);
+    uint64_t numSlots = PIPELINE_MIN_IN_FLIGHT_SLOTS;
+    while (numSlots < (maxBundlesInPipeline << 1)) {
+        numSlots <<= 1;
+    }
+    m_slotsMask = numSlots - 1;
+    PathInFlight* const paths[2] = { &m_egressPath, &m_storagePath };
+    for (unsigned int i = 0; i < 2; ++i) {
+        paths[i]->packedBundlesAndBytes.store(0, std::memory_order_relaxed);
+        paths[i]->slots.reset(new InFlightSlot[numSlots]);
+        for (uint64_t j = 0; j < numSlots; ++j) {
+            paths[i]->slots[j].uniqueIdPlusOne.store(0, std::memory_order_relaxed);
+            paths[i]->slots[j].bundleSizeBytes.store(0, std::memory_order_relaxed);
+        }
+    }
+    Update(paramMaxBundlesInPipeline, paramMaxBundleSizeBytesInPipeline, paramNextHopNodeId, paramLinkIsUp);
+}
+void BundlePipelineAckingSet::Update(const uint64_t paramMaxBundlesInPipeline,
+    const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp)
+{
+    //the bundle count of a path must fit in the upper bits of its packed word
+    uint64_t maxBundlesInPipeline = paramMaxBundlesInPipeline;
+    if (maxBundlesInPipeline > BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE) {
+        LOG_ERROR(subprocess) << "maxBundlesInPipeline " << paramMaxBundlesInPipeline << " of next hop node " << paramNextHopNodeId
+            << " exceeds the ingress limit of " << BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE << " and is clamped to it";
+        maxBundlesInPipeline = BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE;
+    }
+    //the slot tables cannot grow while in use, so a path is limited to half of their slots
+    const uint64_t maxHalfOfMaxBundlesInPipeline = (m_slotsMask + 1) >> 1;
+    uint64_t halfOfMaxBundlesInPipeline = maxBundlesInPipeline >> 1;
+    if (halfOfMaxBundlesInPipeline > maxHalfOfMaxBundlesInPipeline) {
+        LOG_ERROR(subprocess) << "maxBundlesInPipeline of next hop node " << paramNextHopNodeId << " increased to "
+            << paramMaxBundlesInPipeline << " but ingress can only keep " << (maxHalfOfMaxBundlesInPipeline << 1) << " in its pipeline until restarted";
+        halfOfMaxBundlesInPipeline = maxHalfOfMaxBundlesInPipeline;
+    }
+    m_halfOfMaxBundlesInPipeline.store(halfOfMaxBundlesInPipeline, std::memory_order_relaxed);
+    m_halfOfMaxBytesInPipeline.store(std::min(paramMaxBundleSizeBytesInPipeline >> 1, PIPELINE_PACKED_BYTES_MASK), std::memory_order_relaxed);
+    m_nextHopNodeId = paramNextHopNodeId;
+    m_linkIsUp = paramLinkIsUp;
+}
+
+bool BundlePipelineAckingSet::TryReserve(PathInFlight& path, const uint64_t uniqueId, const uint64_t bundleSizeBytes) {
+    const uint64_t halfOfMaxBundlesInPipeline = m_halfOfMaxBundlesInPipeline.load(std::memory_order_relaxed);
+    const uint64_t halfOfMaxBytesInPipeline = m_halfOfMaxBytesInPipeline.load(std::memory_order_relaxed);
+    uint64_t packed = path.packedBundlesAndBytes.load(std::memory_order_relaxed);
+    do {
+        if (((packed >> PIPELINE_PACKED_BYTES_BITS) >= halfOfMaxBundlesInPipeline)
+            || (((packed & PIPELINE_PACKED_BYTES_MASK) + bundleSizeBytes) > halfOfMaxBytesInPipeline))
+        {
+            return false;
+        }
+    } while (!path.packedBundlesAndBytes.compare_exchange_weak(packed, packed + PIPELINE_PACKED_ONE_BUNDLE + bundleSizeBytes,
+        std::memory_order_acq_rel, std::memory_order_relaxed));
+
+    //claim a slot for the unique id (starting at its natural slot, found there on the ack unless ids collide)
+    for (uint64_t i = 0; i <= m_slotsMask; ++i) {
+        InFlightSlot& slot = path.slots[(uniqueId + i) & m_slotsMask];
+        uint64_t expected = 0;
+        if (slot.uniqueIdPlusOne.compare_exchange_strong(expected, PIPELINE_IN_FLIGHT_SLOT_CLAIMED, std::memory_order_acquire, std::memory_order_relaxed)) {
+            slot.bundleSizeBytes.store(bundleSizeBytes, std::memory_order_relaxed);
+            slot.uniqueIdPlusOne.store(uniqueId + 1, std::memory_order_release);
+            return true;
+        }
+    }
+    //unreachable as long as the budget above keeps the table at most half full
+    path.packedBundlesAndBytes.fetch_sub(PIPELINE_PACKED_ONE_BUNDLE + bundleSizeBytes, std::memory_order_seq_cst);
+    WakeOneWaiter();
+    return false;
+}
+
+void BundlePipelineAckingSet::WakeOneWaiter() {
+    if (m_numWaiters.load(std::memory_order_seq_cst)) {
+        //lock then unlock the mutex to prevent a missed notify to a waiter between its last reserve attempt and its wait
+        m_waitMutex.lock();
+        m_waitMutex.unlock();
+        m_waitConditionVariable.notify_one();
+    }
+}
+
+bool BundlePipelineAckingSet::CompareAndPop_ThreadSafe(const uint64_t uniqueId, const bool isEgress) {
+    PathInFlight& path = (isEgress) ? m_egressPath : m_storagePath;
+    const uint64_t uniqueIdPlusOne = uniqueId + 1;
+    for (uint64_t i = 0; i <= m_slotsMask; ++i) {
+        InFlightSlot& slot = path.slots[(uniqueId + i) & m_slotsMask];
+        if (slot.uniqueIdPlusOne.load(std::memory_order_acquire) == uniqueIdPlusOne) {
+            const uint64_t bundleSizeBytes = slot.bundleSizeBytes.load(std::memory_order_relaxed); //read before the slot is freed
+            uint64_t expected = uniqueIdPlusOne;
+            if (!slot.uniqueIdPlusOne.compare_exchange_strong(expected, 0, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                return false; //popped by another thread
+            }
+            //seq_cst pairs with the seq_cst of the waiter's m_numWaiters increment (either the waiter sees this budget or this sees the waiter)
+            path.packedBundlesAndBytes.fetch_sub(PIPELINE_PACKED_ONE_BUNDLE + bundleSizeBytes, std::memory_order_seq_cst);
+            WakeOneWaiter();
+            return true;
+        }
+    }
+    return false;
+}
+
+//make sure at least one of [checkEgressPipeline, checkStoragePipeline] are true, otherwise a timeout will occur followed by a return false
+//return true if either the egress or storage got reserved, false if timeout
+bool BundlePipelineAckingSet::WaitForPipelineAvailabilityAndReserve(const bool checkEgressPipeline, const bool checkStoragePipeline,
+    const boost::posix_time::time_duration & timeoutDuration, const uint64_t uniqueId, const uint64_t bundleSizeBytes,
+    bool & reservedEgressPipelineAvailability, bool& reservedStoragePipelineAvailability)
+{
+    //egress gets first priority, storage gets second priority
+    reservedEgressPipelineAvailability = checkEgressPipeline && TryReserve(m_egressPath, uniqueId, bundleSizeBytes);
+    reservedStoragePipelineAvailability = (!reservedEgressPipelineAvailability) && checkStoragePipeline && TryReserve(m_storagePath, uniqueId, bundleSizeBytes);
+    if (reservedEgressPipelineAvailability || reservedStoragePipelineAvailability) {
+        return true;
+    }
+
+    //slow path: wait for an ack
+    const boost::posix_time::ptime timeoutExpiry(boost::posix_time::microsec_clock::universal_time() + timeoutDuration);
+    boost::mutex::scoped_lock lock(m_waitMutex);
+    m_numWaiters.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst); //the reserve attempts below must see budget given back before the increment
+    bool timedOut = false;
+    while (true) {
+        reservedEgressPipelineAvailability = checkEgressPipeline && TryReserve(m_egressPath, uniqueId, bundleSizeBytes);
+        reservedStoragePipelineAvailability = (!reservedEgressPipelineAvailability) && checkStoragePipeline && TryReserve(m_storagePath, uniqueId, bundleSizeBytes);
+        if (reservedEgressPipelineAvailability || reservedStoragePipelineAvailability || timedOut) {
+            break;
+        }
+        //timed_wait Returns: false if the call is returning because the time specified by abs_time was reached, true otherwise. (false=>timeout)
+        timedOut = !m_waitConditionVariable.timed_wait(lock, timeoutExpiry);
+    }
+    m_numWaiters.fetch_sub(1, std::memory_order_seq_cst);
+    lock.unlock();
+    if (reservedEgressPipelineAvailability || reservedStoragePipelineAvailability) {
+        //an ack wakes only one waiter, so pass the wakeup on in case the ack freed enough budget for another waiter too
+        WakeOneWaiter();
+        return true;
+    }
+    return false;
+}
+bool BundlePipelineAckingSet::WaitForStoragePipelineAvailabilityAndReserve(const boost::posix_time::time_duration& timeoutDuration,
+    const uint64_t uniqueId, const uint64_t bundleSizeBytes)
+{
+    bool dontCare1, dontCare2;
+    return WaitForPipelineAvailabilityAndReserve(false, true,
+        timeoutDuration, uniqueId, bundleSizeBytes,
+        dontCare1, dontCare2);
+}
+uint64_t BundlePipelineAckingSet::GetNextHopNodeId() const {
+    return m_nextHopNodeId;
+}
+uint64_t BundlePipelineAckingSet::GetNumBundlesInPipeline(const bool isEgress) const noexcept {
+    const PathInFlight& path = (isEgress) ? m_egressPath : m_storagePath;
+    return path.packedBundlesAndBytes.load(std::memory_order_acquire) >> PIPELINE_PACKED_BYTES_BITS;
+}
+uint64_t BundlePipelineAckingSet::GetNumBytesInPipeline(const bool isEgress) const noexcept {
+    const PathInFlight& path = (isEgress) ? m_egressPath : m_storagePath;
+    return path.packedBundlesAndBytes.load(std::memory_order_acquire) & PIPELINE_PACKED_BYTES_MASK;
+}
+uint64_t BundlePipelineAckingSet::GetHalfOfMaxBundlesInPipeline() const noexcept {
+    return m_halfOfMaxBundlesInPipeline.load(std::memory_order_relaxed);
+}
+
+}  // namespace hdtn
@@ -0,0 +1,124 @@
+/**
+ * @file IngressWorkerPool.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "IngressWorkerPool.h"
+#include "Logger.h"
+#include "ThreadNamer.h"
+#include <boost/bind/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_unique.hpp>
+
+namespace hdtn {
+
+static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::ingress;
+
+IngressWorkerPool::IngressWorkerPool() :
+    m_running(false),
+    m_maxQueuedBundlesPerWorker(1)
+{}
+
+IngressWorkerPool::~IngressWorkerPool() {
+    Stop();
+}
+
+void IngressWorkerPool::Start(const unsigned int numWorkers, const std::size_t maxQueuedBundlesPerWorker,
+    const ProcessBundleCallback_t & processBundleCallback)
+{
+    if (numWorkers == 0) {
+        return;
+    }
+    m_maxQueuedBundlesPerWorker = (maxQueuedBundlesPerWorker) ? maxQueuedBundlesPerWorker : 1;
+    m_processBundleCallback = processBundleCallback;
+    m_running = true;
+    m_workersVec.resize(numWorkers);
+    for (unsigned int i = 0; i < numWorkers; ++i) {
+        m_workersVec[i] = boost::make_unique<Worker>();
+    }
+    for (unsigned int i = 0; i < numWorkers; ++i) {
+        Worker& worker = *m_workersVec[i];
+        worker.threadPtr = boost::make_unique<boost::thread>(
+            boost::bind(&IngressWorkerPool::WorkerThreadFunc, this, &worker, i)); //create and start the worker thread
+    }
+    LOG_INFO(subprocess) << "started " << numWorkers << " ingress worker threads";
+}
+
+void IngressWorkerPool::Stop() {
+    m_running = false; //thread stopping criteria (the workers finish their queued bundles first)
+    for (std::size_t i = 0; i < m_workersVec.size(); ++i) {
+        Worker& worker = *m_workersVec[i];
+        //lock then unlock the worker's mutex to prevent a missed notify after setting the stopping criteria above
+        worker.mutex.lock();
+        worker.mutex.unlock();
+        worker.conditionVariableNotEmpty.notify_one();
+        worker.conditionVariableNotFull.notify_all();
+    }
+    for (std::size_t i = 0; i < m_workersVec.size(); ++i) {
+        Worker& worker = *m_workersVec[i];
+        if (worker.threadPtr) {
+            try {
+                worker.threadPtr->join();
+                worker.threadPtr.reset();
+            }
+            catch (boost::thread_resource_error& e) {
+                LOG_ERROR(subprocess) << "error stopping ingress worker thread: " << e.what();
+            }
+        }
+    }
+    m_workersVec.clear();
+}
+
+bool IngressWorkerPool::Push(const uint64_t inductIndex, padded_vector_uint8_t & movableBundle) {
+    if (m_workersVec.empty()) {
+        return false;
+    }
+    Worker& worker = *m_workersVec[inductIndex % m_workersVec.size()];
+    {
+        boost::mutex::scoped_lock lock(worker.mutex);
+        while ((worker.bundles.size() >= m_maxQueuedBundlesPerWorker) && m_running.load(std::memory_order_acquire)) {
+            worker.conditionVariableNotFull.wait(lock);
+        }
+        if (!m_running.load(std::memory_order_acquire)) {
+            return false;
+        }
+        worker.bundles.push_back(std::move(movableBundle));
+    }
+    worker.conditionVariableNotEmpty.notify_one();
+    return true;
+}
+
+std::size_t IngressWorkerPool::GetNumWorkers() const noexcept {
+    return m_workersVec.size();
+}
+
+void IngressWorkerPool::WorkerThreadFunc(Worker* workerPtr, const unsigned int workerIndex) {
+    ThreadNamer::SetThisThreadName("ingressWorker" + boost::lexical_cast<std::string>(workerIndex));
+    Worker& worker = *workerPtr;
+    padded_vector_uint8_t bundleVec;
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(worker.mutex);
+            while (worker.bundles.empty() && m_running.load(std::memory_order_acquire)) { //lock mutex (above) before checking condition
+                worker.conditionVariableNotEmpty.wait(lock);
+            }
+            if (worker.bundles.empty()) { //stopping and drained
+                break;
+            }
+            bundleVec = std::move(worker.bundles.front());
+            worker.bundles.pop_front();
+        }
+        worker.conditionVariableNotFull.notify_one();
+        m_processBundleCallback(bundleVec);
+    }
+}
+
+} // namespace hdtn
@@ -17,16 +17,22 @@
  * This file contains the implemetation for the ingress module of HDTN.
  */
 #include "ingress.h"
+#include "BundlePipelineAckingSet.h"
 //#include "util/tsc.h"
 #include "codec/bpv6.h"
 #include "Logger.h"
 #include "message.hpp"
+#include "InprocBundleRings.hpp"
+#include "ModuleBusBatcher.hpp"
+#include "RcuSnapshot.h"
+#include "IngressWorkerPool.h"
 #include <boost/asio.hpp>
 #include <boost/thread.hpp>
 #include "InductManager.h"
 #include "BpSecConfig.h"
 #include <list>
 #include <queue>
+#include <deque>
 #include <boost/bind/bind.hpp>
 #include <boost/make_unique.hpp>
 #include <boost/lexical_cast.hpp>
@@ -38,15 +44,12 @@
 #include "TcpclV4Induct.h"
 #include "StcpInduct.h"
 #include "SlipOverUartInduct.h"
-#include "FreeListAllocator.h"
 #include "TelemetryDefinitions.h"
 #include "ThreadNamer.h"
 #include "TelemetryServer.h"
 #include <unordered_map>
+#include <algorithm>
 #include <atomic>
-#if (__cplusplus >= 201703L)
-#include <shared_mutex>
-#endif
 
 #include "BinaryConversions.h"
 #ifdef BPSEC_SUPPORT_ENABLED
@@ -62,6 +65,8 @@ namespace hdtn {
 static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::ingress;
 static constexpr uint64_t STORAGE_MAX_BUNDLES_IN_PIPELINE = 5;//"zmq-path-to-storage" up to zmqMaxMessageSizeBytes or 5 bundles,
 static constexpr uint64_t MY_PING_SERVICE_ID = 1;
+static constexpr std::size_t INGRESS_WORKER_MAX_QUEUED_BUNDLES = 4; //per worker, an induct thread blocks (i.e. flow control) when exceeded
+static const boost::posix_time::time_duration INPROC_RING_FULL_WAIT = boost::posix_time::seconds(2); //same wait as for the storage pipeline
 
 struct Ingress::Impl : private boost::noncopyable {
 
@@ -70,69 +75,73 @@ struct Ingress::Impl : private boost::noncopyable {
     void Stop();
     bool Stopped() noexcept;
     bool Init(const HdtnConfig& hdtnConfig, const boost::filesystem::path& bpSecConfigFilePath,
-           const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr, const std::string& maskerImpl);
+           const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr, const std::string& maskerImpl,
+           InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr);
 
 private:
     void ReadZmqAcksThreadFunc();
+    bool ProcessEgressAck(const hdtn::EgressAckHdr& receivedEgressAckHdr);
+    bool ProcessStorageAck(const hdtn::StorageAckHdr& receivedStorageAck);
     void ZmqTelemThreadFunc();
     void RouterEventHandler();
     bool ProcessPaddedData(uint8_t* bundleDataBegin, std::size_t bundleCurrentSize,
         std::unique_ptr<zmq::message_t>& zmqPaddedMessageUnderlyingDataUniquePtr, padded_vector_uint8_t& paddedVecMessageUnderlyingData,
-        const bool usingZmqData, const bool needsProcessing, const bool isSafeToYieldThisThread);
+        const bool usingZmqData, const bool needsProcessing);
     void ReadTcpclOpportunisticBundlesFromEgressThreadFunc();
-    void WholeBundleReadyCallback(padded_vector_uint8_t& wholeBundleVec);
+    void WholeBundleReadyCallback(padded_vector_uint8_t& wholeBundleVec, const uint64_t inductIndex);
+    void ProcessBundleOnIngressWorker(padded_vector_uint8_t& bundleVec);
     void OnNewOpportunisticLinkCallback(const uint64_t remoteNodeId, Induct* thisInductPtr, void* sinkPtr);
     void OnDeletedOpportunisticLinkCallback(const uint64_t remoteNodeId, Induct* thisInductPtr, void* sinkPtrAboutToBeDeleted);
     void SendOpportunisticLinkMessages(const uint64_t remoteNodeId, bool isAvailable);
+    void LookupRoute(const cbhe_eid_t& finalDestEid, uint64_t& outductArrayIndex, Induct*& opportunisticInductPtr) const;
+    void PublishRoutingSnapshot_NotThreadSafe();
+    bool PushToEgressRing(const hdtn::ToEgressHdr& toEgressHdr, zmq::message_t* zmqMessageBundlePtr, const boost::posix_time::time_duration& timeout);
+    bool PushToStorageRing(const hdtn::ToStorageHdr& toStorageHdr, zmq::message_t* zmqMessageBundlePtr, const boost::posix_time::time_duration& timeout);
+    bool SendToStorage_NotThreadSafe(const hdtn::ToStorageHdr& toStorageHdr, zmq::message_t& zmqMessageBundle);
+    void HandleFailedBatches();
+    void OnToEgressBatchSendFailed(std::vector<hdtn::ToEgressHdr>& toEgressHdrs, std::vector<zmq::message_t>& zmqMessageBundles);
+    void OnToStorageBatchSendFailed(std::vector<hdtn::ToStorageHdr>& toStorageHdrs, std::vector<zmq::message_t>& zmqMessageBundles);
     void SendPing(const uint64_t remoteNodeId, const uint64_t remotePingServiceNumber, const uint64_t bpVersion);
     void ProcessReceivedPingPayload(const uint8_t* data, const uint64_t size, const uint64_t bpVersion);
 
 public:
-    uint64_t m_bundleCountStorage; //protected by m_ingressToStorageZmqSocketMutex
-    uint64_t m_bundleByteCountStorage; //protected by m_ingressToStorageZmqSocketMutex
-    uint64_t m_bundleCountEgress; //protected by m_ingressToEgressZmqSocketMutex
-    uint64_t m_bundleByteCountEgress; //protected by m_ingressToEgressZmqSocketMutex
+    std::atomic<uint64_t> m_bundleCountStorage; //atomic because the spsc-ring inproc transport pushes without the socket mutexes
+    std::atomic<uint64_t> m_bundleByteCountStorage;
+    std::atomic<uint64_t> m_bundleCountEgress;
+    std::atomic<uint64_t> m_bundleByteCountEgress;
 #ifdef MASKING_ENABLED
     std::shared_ptr<Masker> m_pmasker;
 #endif
 
 private:
-    struct BundlePipelineAckingSet : private boost::noncopyable {
-        BundlePipelineAckingSet() = delete; //vector resize() not possible, must use reserve()
-        BundlePipelineAckingSet(const uint64_t paramMaxBundlesInPipeline,
-            const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp);
-        void Update(const uint64_t paramMaxBundlesInPipeline,
-            const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp);
-
-        bool CompareAndPop_ThreadSafe(const uint64_t uniqueId, const bool isEgress);
-
-        bool WaitForPipelineAvailabilityAndReserve(const bool checkEgressPipeline, const bool checkStoragePipeline,
-            const boost::posix_time::time_duration& timeoutDuration, const uint64_t uniqueId, const uint64_t bundleSizeBytes,
-            bool& reservedEgressPipelineAvailability, bool& reservedStoragePipelineAvailability);
-        bool WaitForStoragePipelineAvailabilityAndReserve(const boost::posix_time::time_duration& timeoutDuration,
-            const uint64_t uniqueId, const uint64_t bundleSizeBytes);
-        void NotifyAll();
-        uint64_t GetNextHopNodeId() const;
+    typedef std::unique_ptr<BundlePipelineAckingSet> BundlePipelineAckingSetPtr;
+
+    //An immutable routing table of the bundles' final destinations (the outduct capabilities telemetry from egress and the
+    //opportunistic links of the inducts), rebuilt and published through m_routingSnapshot on every change so that the per-bundle
+    //lookup takes no locks.  Each node id is hashed (open addressing, linear probing) to one flat NodeRoute, so a bundle's
+    //whole route (including an opportunistic link) is found with one probe of one cache line in the common case.
+    struct RoutingSnapshot {
+        struct NodeRoute {
+            uint64_t nodeIdPlusOne; //0 => empty
+            uint64_t outductArrayIndex; //UINT64_MAX => no route for the whole node
+            Induct* opportunisticInductPtr; //NULL => no opportunistic link
+            uint32_t eidRoutesBeginIndex; //into m_eidRoutes, routes for specific service ids of this node (which take precedence)
+            uint32_t eidRoutesCount;
+        };
+        RoutingSnapshot();
+        void Build(const std::map<uint64_t, uint64_t>& mapFinalDestNodeIdToOutductArrayIndex,
+            const std::map<cbhe_eid_t, uint64_t>& mapFinalDestEidToOutductArrayIndex,
+            const std::map<uint64_t, Induct*>& mapOpportunisticNodeIdToInduct);
+        const NodeRoute* Find(const uint64_t nodeId) const noexcept;
+        uint64_t GetOutductArrayIndex(const NodeRoute& nodeRoute, const uint64_t serviceId) const noexcept;
     private:
-        
-        boost::mutex m_mutex;
-        boost::condition_variable m_conditionVariable;
-        typedef std::unordered_map<uint64_t, uint64_t,
-            std::hash<uint64_t>,
-            std::equal_to<uint64_t>,
-            FreeListAllocatorDynamic<std::pair<const uint64_t, uint64_t> > > umap_64_to_64_t;
-        umap_64_to_64_t m_mapEgressBundleUniqueIdToBundleSizeBytes;
-        umap_64_to_64_t m_mapStorageBundleUniqueIdToBundleSizeBytes;
-        uint64_t m_egressBytesInPipeline;
-        uint64_t m_storageBytesInPipeline;
-
-        uint64_t m_maxBundlesInPipeline;
-        uint64_t m_maxBundleSizeBytesInPipeline;
-        uint64_t m_nextHopNodeId;
-    public:
-        bool m_linkIsUp;
+        uint64_t Hash(const uint64_t nodeId) const noexcept;
+        NodeRoute& FindOrInsert(const uint64_t nodeId);
+
+        std::vector<NodeRoute> m_nodeRoutes; //power of 2 size, at most half full
+        std::vector<std::pair<uint64_t, uint64_t> > m_eidRoutes; //service id, outduct array index (grouped by node id)
+        uint64_t m_nodeRoutesMask;
     };
-    typedef std::unique_ptr<BundlePipelineAckingSet> BundlePipelineAckingSetPtr;
 
     std::unique_ptr<zmq::context_t> m_zmqCtxPtr;
     std::unique_ptr<zmq::socket_t> m_zmqPushSock_boundIngressToConnectingEgressPtr;
@@ -159,40 +168,31 @@ private:
     std::unique_ptr<boost::thread> m_threadZmqAckReaderPtr;
     std::unique_ptr<boost::thread> m_threadZmqTelemPtr;
     std::unique_ptr<boost::thread> m_threadTcpclOpportunisticBundlesFromEgressReaderPtr;
-    std::vector<BundlePipelineAckingSetPtr> m_vectorBundlePipelineAckingSet; //final dest node id to set
+    std::vector<BundlePipelineAckingSetPtr> m_vectorBundlePipelineAckingSet; //outduct array index to set (filled once by the initial outduct capabilities)
+    std::atomic<std::size_t> m_numBundlePipelineAckingSets; //published after m_vectorBundlePipelineAckingSet is filled, for the other threads
     BundlePipelineAckingSet m_singleStorageBundlePipelineAckingSet; //non-cut-through, outduct index of UINT64_MAX
-    std::map<uint64_t, uint64_t> m_mapNextHopNodeIdToOutductArrayIndex;
+
+    //the routes from which every RoutingSnapshot is built (protected by m_routingSnapshotWriterMutex)
     std::map<uint64_t, uint64_t> m_mapFinalDestNodeIdToOutductArrayIndex;
     std::map<cbhe_eid_t, uint64_t> m_mapFinalDestEidToOutductArrayIndex;
-
-#if (__cplusplus >= 201703L)
-    std::shared_mutex m_sharedMutexFinalDestsToOutductArrayIndexMaps;
-    typedef std::shared_lock<std::shared_mutex> ingress_shared_lock_t;
-    typedef std::unique_lock<std::shared_mutex> ingress_exclusive_lock_t;
-    #define ingress_adopt_lock std::adopt_lock
-#else
-    boost::shared_mutex m_sharedMutexFinalDestsToOutductArrayIndexMaps;
-    typedef boost::shared_lock<boost::shared_mutex> ingress_shared_lock_t;
-    typedef boost::unique_lock<boost::shared_mutex> ingress_exclusive_lock_t;
-    #define ingress_adopt_lock boost::adopt_lock
-#endif
-
+    std::map<uint64_t, Induct*> m_availableDestOpportunisticNodeIdToTcpclInductMap;
+    boost::mutex m_routingSnapshotWriterMutex;
+    RcuSnapshot<RoutingSnapshot> m_routingSnapshot;
 
 
     boost::mutex m_ingressToEgressZmqSocketMutex;
     boost::mutex m_ingressToStorageZmqSocketMutex;
+    ModuleBusBatcher<hdtn::ToEgressHdr> m_toEgressBatcher; //not running unless hdtn config moduleBusBatchMaxMessages > 1 (protected by m_ingressToEgressZmqSocketMutex)
+    ModuleBusBatcher<hdtn::ToStorageHdr> m_toStorageBatcher; //not running unless hdtn config moduleBusBatchMaxMessages > 1 (protected by m_ingressToStorageZmqSocketMutex)
+    InprocBundleRings* m_inprocBundleRingsPtr; //NULL unless one-process with the spsc-ring inproc transport (replaces the push sockets to egress and storage for bundles)
     std::size_t m_eventsTooManyInStorageCutThroughQueue;
     std::size_t m_eventsTooManyInEgressCutThroughQueue;
     std::size_t m_eventsTooManyInAllCutThroughQueues;
     std::atomic<bool> m_running;
     std::atomic_uint64_t m_nextBundleUniqueIdAtomic;
 
-    std::map<uint64_t, Induct*> m_availableDestOpportunisticNodeIdToTcpclInductMap;
-    boost::mutex m_availableDestOpportunisticNodeIdToTcpclInductMapMutex;
-
-    //prevent thread starving when obtaining exclusive lock
-    //of m_sharedMutexFinalDestsToOutductArrayIndexMaps
-    std::atomic<bool> m_aoctNeedsProcessing;
+    //ingress workers (hdtn config numIngressWorkerThreads), none started if bundles are processed on the induct threads
+    IngressWorkerPool m_ingressWorkerPool;
 
     //for blocking until worker-thread startup
     std::atomic<bool> m_workerThreadStartupInProgress;
@@ -218,103 +218,104 @@ private:
 #endif
 };
 
-Ingress::Impl::BundlePipelineAckingSet::BundlePipelineAckingSet(const uint64_t paramMaxBundlesInPipeline,
-    const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp) :
-    m_egressBytesInPipeline(0),
-    m_storageBytesInPipeline(0)
-{
-    Update(paramMaxBundlesInPipeline, paramMaxBundleSizeBytesInPipeline, paramNextHopNodeId, paramLinkIsUp);
+Ingress::Impl::RoutingSnapshot::RoutingSnapshot() :
+    m_nodeRoutes(1, NodeRoute{ 0, UINT64_MAX, NULL, 0, 0 }),
+    m_nodeRoutesMask(0) {}
+
+uint64_t Ingress::Impl::RoutingSnapshot::Hash(const uint64_t nodeId) const noexcept {
+    return ((nodeId * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & m_nodeRoutesMask; //fibonacci hashing spreads sequential node ids
 }
-void Ingress::Impl::BundlePipelineAckingSet::Update(const uint64_t paramMaxBundlesInPipeline,
-    const uint64_t paramMaxBundleSizeBytesInPipeline, const uint64_t paramNextHopNodeId, bool paramLinkIsUp)
-{
-    m_maxBundlesInPipeline = paramMaxBundlesInPipeline;
-    m_maxBundleSizeBytesInPipeline = paramMaxBundleSizeBytesInPipeline;
-    m_nextHopNodeId = paramNextHopNodeId;
-    m_linkIsUp = paramLinkIsUp;
-    //By default, unordered_set containers have a max_load_factor of 1.0.
-    m_mapEgressBundleUniqueIdToBundleSizeBytes.reserve(m_maxBundlesInPipeline); //maxBundlesInPipeline is double of half
-    m_mapEgressBundleUniqueIdToBundleSizeBytes.get_allocator().SetMaxListSizeFromGetAllocatorCopy(m_maxBundlesInPipeline + 2);
-
-    m_mapStorageBundleUniqueIdToBundleSizeBytes.reserve(m_maxBundlesInPipeline);
-    m_mapStorageBundleUniqueIdToBundleSizeBytes.get_allocator().SetMaxListSizeFromGetAllocatorCopy(m_maxBundlesInPipeline + 2);
+
+Ingress::Impl::RoutingSnapshot::NodeRoute& Ingress::Impl::RoutingSnapshot::FindOrInsert(const uint64_t nodeId) {
+    for (uint64_t i = Hash(nodeId); ; i = (i + 1) & m_nodeRoutesMask) {
+        NodeRoute& nodeRoute = m_nodeRoutes[i];
+        if (nodeRoute.nodeIdPlusOne == 0) {
+            nodeRoute.nodeIdPlusOne = nodeId + 1;
+            return nodeRoute;
+        }
+        else if (nodeRoute.nodeIdPlusOne == (nodeId + 1)) {
+            return nodeRoute;
+        }
+    }
 }
 
-bool Ingress::Impl::BundlePipelineAckingSet::CompareAndPop_ThreadSafe(const uint64_t uniqueId, const bool isEgress) {
-    
-    uint64_t& bytesInPipelineRef = (isEgress) ? m_egressBytesInPipeline : m_storageBytesInPipeline;
-    umap_64_to_64_t& mapBundleUniqueIdToBundleSizeBytes = (isEgress) ?
-        m_mapEgressBundleUniqueIdToBundleSizeBytes : m_mapStorageBundleUniqueIdToBundleSizeBytes;
+void Ingress::Impl::RoutingSnapshot::Build(const std::map<uint64_t, uint64_t>& mapFinalDestNodeIdToOutductArrayIndex,
+    const std::map<cbhe_eid_t, uint64_t>& mapFinalDestEidToOutductArrayIndex,
+    const std::map<uint64_t, Induct*>& mapOpportunisticNodeIdToInduct)
+{
+    const std::size_t maxNodes = mapFinalDestNodeIdToOutductArrayIndex.size()
+        + mapFinalDestEidToOutductArrayIndex.size() + mapOpportunisticNodeIdToInduct.size();
+    std::size_t numNodeRoutes = 16;
+    while (numNodeRoutes < (maxNodes * 2)) {
+        numNodeRoutes <<= 1;
+    }
+    m_nodeRoutes.assign(numNodeRoutes, NodeRoute{ 0, UINT64_MAX, NULL, 0, 0 });
+    m_nodeRoutesMask = numNodeRoutes - 1;
+    m_eidRoutes.clear();
+    m_eidRoutes.reserve(mapFinalDestEidToOutductArrayIndex.size());
 
-    boost::mutex::scoped_lock lock(m_mutex);
-    umap_64_to_64_t::iterator it = mapBundleUniqueIdToBundleSizeBytes.find(uniqueId);
-    if (it == mapBundleUniqueIdToBundleSizeBytes.end()) {
-        return false;
+    for (std::map<uint64_t, uint64_t>::const_iterator it = mapFinalDestNodeIdToOutductArrayIndex.cbegin();
+        it != mapFinalDestNodeIdToOutductArrayIndex.cend(); ++it)
+    {
+        FindOrInsert(it->first).outductArrayIndex = it->second;
+    }
+    for (std::map<uint64_t, Induct*>::const_iterator it = mapOpportunisticNodeIdToInduct.cbegin();
+        it != mapOpportunisticNodeIdToInduct.cend(); ++it)
+    {
+        FindOrInsert(it->first).opportunisticInductPtr = it->second;
+    }
+    //the map is sorted by node id first, so each node's service id routes are contiguous
+    for (std::map<cbhe_eid_t, uint64_t>::const_iterator it = mapFinalDestEidToOutductArrayIndex.cbegin();
+        it != mapFinalDestEidToOutductArrayIndex.cend(); ++it)
+    {
+        NodeRoute& nodeRoute = FindOrInsert(it->first.nodeId);
+        if (nodeRoute.eidRoutesCount == 0) {
+            nodeRoute.eidRoutesBeginIndex = static_cast<uint32_t>(m_eidRoutes.size());
+        }
+        ++nodeRoute.eidRoutesCount;
+        m_eidRoutes.emplace_back(it->first.serviceId, it->second);
     }
-    const uint64_t bundleSizeBytes = it->second;
-    bytesInPipelineRef -= bundleSizeBytes;
-    mapBundleUniqueIdToBundleSizeBytes.erase(it);
-    return true;
 }
 
-//make sure at least one of [checkEgressPipeline, checkStoragePipeline] are true, otherwise a timeout will occur followed by a return false
-//return true if either the egress or storage got reserved, false if timeout
-bool Ingress::Impl::BundlePipelineAckingSet::WaitForPipelineAvailabilityAndReserve(const bool checkEgressPipeline, const bool checkStoragePipeline,
-    const boost::posix_time::time_duration & timeoutDuration, const uint64_t uniqueId, const uint64_t bundleSizeBytes,
-    bool & reservedEgressPipelineAvailability, bool& reservedStoragePipelineAvailability)
-{
-    reservedEgressPipelineAvailability = false;
-    reservedStoragePipelineAvailability = false;
-    const uint64_t halfOfMaxBundlesInPipeline = m_maxBundlesInPipeline >> 1;
-    const uint64_t halfOfMaxBytesInPipeline = m_maxBundleSizeBytesInPipeline >> 1;
-    const boost::posix_time::ptime timeoutExpiry(boost::posix_time::microsec_clock::universal_time() + timeoutDuration);
-    boost::mutex::scoped_lock lock(m_mutex);
-    //timed_wait Returns: false if the call is returning because the time specified by abs_time was reached, true otherwise. (false=>timeout)
-    //wait while (queueIsFull AND hasNotTimedOutYet)
-    while (
-        ((m_mapEgressBundleUniqueIdToBundleSizeBytes.size() >= (halfOfMaxBundlesInPipeline * checkEgressPipeline))
-        || ((m_egressBytesInPipeline + bundleSizeBytes) > (halfOfMaxBytesInPipeline * checkEgressPipeline)))
-        && 
-        ((m_mapStorageBundleUniqueIdToBundleSizeBytes.size() >= (halfOfMaxBundlesInPipeline * checkStoragePipeline))
-        || ((m_storageBytesInPipeline + bundleSizeBytes) > (halfOfMaxBytesInPipeline * checkStoragePipeline)))
-        &&
-        m_conditionVariable.timed_wait(lock, timeoutExpiry)) {
-    }//lock mutex (above) before checking condition
-
-    //egress gets first priority, storage gets second priority
-    if (checkEgressPipeline) {
-        reservedEgressPipelineAvailability = (m_mapEgressBundleUniqueIdToBundleSizeBytes.size() < halfOfMaxBundlesInPipeline)
-            && ((m_egressBytesInPipeline + bundleSizeBytes) <= halfOfMaxBytesInPipeline);
-        if (reservedEgressPipelineAvailability) {
-            m_mapEgressBundleUniqueIdToBundleSizeBytes.emplace(uniqueId, bundleSizeBytes);
-            m_egressBytesInPipeline += bundleSizeBytes;
-            return true;
-        }
-    }
-    if (checkStoragePipeline) {
-        reservedStoragePipelineAvailability = (m_mapStorageBundleUniqueIdToBundleSizeBytes.size() < halfOfMaxBundlesInPipeline)
-            && ((m_storageBytesInPipeline + bundleSizeBytes) <= halfOfMaxBytesInPipeline);
-        if (reservedStoragePipelineAvailability) {
-            m_mapStorageBundleUniqueIdToBundleSizeBytes.emplace(uniqueId, bundleSizeBytes);
-            m_storageBytesInPipeline += bundleSizeBytes;
-            return true;
+const Ingress::Impl::RoutingSnapshot::NodeRoute* Ingress::Impl::RoutingSnapshot::Find(const uint64_t nodeId) const noexcept {
+    for (uint64_t i = Hash(nodeId); ; i = (i + 1) & m_nodeRoutesMask) {
+        const NodeRoute& nodeRoute = m_nodeRoutes[i];
+        if (nodeRoute.nodeIdPlusOne == (nodeId + 1)) {
+            return &nodeRoute;
+        }
+        else if (nodeRoute.nodeIdPlusOne == 0) { //never full, so always terminates
+            return NULL;
         }
     }
-    return false;
 }
-bool Ingress::Impl::BundlePipelineAckingSet::WaitForStoragePipelineAvailabilityAndReserve(const boost::posix_time::time_duration& timeoutDuration,
-    const uint64_t uniqueId, const uint64_t bundleSizeBytes)
-{
-    bool dontCare1, dontCare2;
-    return WaitForPipelineAvailabilityAndReserve(false, true,
-        timeoutDuration, uniqueId, bundleSizeBytes,
-        dontCare1, dontCare2);
+
+uint64_t Ingress::Impl::RoutingSnapshot::GetOutductArrayIndex(const NodeRoute& nodeRoute, const uint64_t serviceId) const noexcept {
+    for (uint32_t i = 0; i < nodeRoute.eidRoutesCount; ++i) {
+        const std::pair<uint64_t, uint64_t>& eidRoute = m_eidRoutes[nodeRoute.eidRoutesBeginIndex + i];
+        if (eidRoute.first == serviceId) {
+            return eidRoute.second;
+        }
+    }
+    return nodeRoute.outductArrayIndex;
 }
-void Ingress::Impl::BundlePipelineAckingSet::NotifyAll() {
-    m_conditionVariable.notify_all();
+
+void Ingress::Impl::LookupRoute(const cbhe_eid_t& finalDestEid, uint64_t& outductArrayIndex, Induct*& opportunisticInductPtr) const {
+    RcuSnapshot<RoutingSnapshot>::ReadGuard routingSnapshot(m_routingSnapshot);
+    if (const RoutingSnapshot::NodeRoute* nodeRoutePtr = routingSnapshot->Find(finalDestEid.nodeId)) {
+        outductArrayIndex = routingSnapshot->GetOutductArrayIndex(*nodeRoutePtr, finalDestEid.serviceId);
+        opportunisticInductPtr = nodeRoutePtr->opportunisticInductPtr;
+    }
+    else {
+        outductArrayIndex = UINT64_MAX;
+        opportunisticInductPtr = NULL;
+    }
 }
-uint64_t Ingress::Impl::BundlePipelineAckingSet::GetNextHopNodeId() const {
-    return m_nextHopNodeId;
+
+void Ingress::Impl::PublishRoutingSnapshot_NotThreadSafe() {
+    std::unique_ptr<RoutingSnapshot> routingSnapshotPtr = boost::make_unique<RoutingSnapshot>();
+    routingSnapshotPtr->Build(m_mapFinalDestNodeIdToOutductArrayIndex, m_mapFinalDestEidToOutductArrayIndex,
+        m_availableDestOpportunisticNodeIdToTcpclInductMap);
+    m_routingSnapshot.Publish(std::move(routingSnapshotPtr));
 }
 
 Ingress::Impl::Impl() : 
@@ -322,13 +323,14 @@ Ingress::Impl::Impl() :
     m_bundleByteCountStorage(0),
     m_bundleCountEgress(0),
     m_bundleByteCountEgress(0),
+    m_numBundlePipelineAckingSets(0),
     m_singleStorageBundlePipelineAckingSet(10, 10, UINT64_MAX, false), //initial don't cares for a deleted default constructor, set later
+    m_inprocBundleRingsPtr(NULL),
     m_eventsTooManyInStorageCutThroughQueue(0),
     m_eventsTooManyInEgressCutThroughQueue(0),
     m_eventsTooManyInAllCutThroughQueues(0),
     m_running(false),
     m_nextBundleUniqueIdAtomic(0),
-    m_aoctNeedsProcessing(false),
     m_workerThreadStartupInProgress(false),
     m_telemThreadStartupInProgress(false),
     m_inductsFullyLoaded(false),
@@ -357,6 +359,9 @@ void Ingress::Stop() {
 }
 void Ingress::Impl::Stop() {
     m_inductManager.Clear();
+    m_ingressWorkerPool.Stop(); //after the inducts so that no bundles are queued after the workers drain their queues
+    m_toEgressBatcher.Stop(); //after the workers so that the last partial batches are sent
+    m_toStorageBatcher.Stop();
 
 
     m_running = false; //thread stopping criteria
@@ -403,11 +408,13 @@ bool Ingress::Impl::Stopped() noexcept {
 }
 
 bool Ingress::Init(const HdtnConfig& hdtnConfig, const boost::filesystem::path& bpSecConfigFilePath,
-		   const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr, const std::string& maskerImpl) {
-    return m_pimpl->Init(hdtnConfig, bpSecConfigFilePath, hdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr, maskerImpl);
+		   const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr, const std::string& maskerImpl,
+		   InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr) {
+    return m_pimpl->Init(hdtnConfig, bpSecConfigFilePath, hdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr, maskerImpl, hdtnOneProcessInprocBundleRingsPtr);
 }
 bool Ingress::Impl::Init(const HdtnConfig& hdtnConfig, const boost::filesystem::path& bpSecConfigFilePath,
-    const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t * hdtnOneProcessZmqInprocContextPtr, const std::string& maskerImpl)
+    const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t * hdtnOneProcessZmqInprocContextPtr, const std::string& maskerImpl,
+    InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr)
 {
 #ifndef MASKING_ENABLED
     (void)maskerImpl; //parameter not used
@@ -418,6 +425,7 @@ bool Ingress::Impl::Init(const HdtnConfig& hdtnConfig, const boost::filesystem::
     }
 
     m_hdtnConfig = hdtnConfig;
+    m_inprocBundleRingsPtr = (hdtnOneProcessZmqInprocContextPtr) ? hdtnOneProcessInprocBundleRingsPtr : NULL;
 
     if (!bpSecConfigFilePath.empty()) {
 #ifdef BPSEC_SUPPORT_ENABLED
@@ -524,6 +532,21 @@ bool Ingress::Impl::Init(const HdtnConfig& hdtnConfig, const boost::filesystem::
     m_zmqPushSock_boundIngressToConnectingEgressPtr->set(zmq::sockopt::linger, 0); //prevent hang when deleting the zmqCtxPtr
     m_zmqPushSock_boundIngressToConnectingStoragePtr->set(zmq::sockopt::linger, 0); //prevent hang when deleting the zmqCtxPtr
 
+    //batch the bundles sent to egress and to storage (unless they go through the spsc rings)
+    const boost::posix_time::time_duration moduleBusBatchLinger = boost::posix_time::microseconds(m_hdtnConfig.m_moduleBusBatchLingerMicroseconds);
+    if ((!m_inprocBundleRingsPtr) && m_toEgressBatcher.Start(m_zmqPushSock_boundIngressToConnectingEgressPtr.get(), &m_ingressToEgressZmqSocketMutex,
+        HDTN_MSGTYPE_EGRESS_BATCH, true, m_hdtnConfig.m_moduleBusBatchMaxMessages, moduleBusBatchLinger,
+        boost::bind(&Ingress::Impl::OnToEgressBatchSendFailed, this, boost::placeholders::_1, boost::placeholders::_2), "ingressEgressBatch"))
+    {
+        LOG_INFO(subprocess) << "batching up to " << m_hdtnConfig.m_moduleBusBatchMaxMessages << " bundles per message to egress";
+    }
+    if ((!m_inprocBundleRingsPtr) && m_toStorageBatcher.Start(m_zmqPushSock_boundIngressToConnectingStoragePtr.get(), &m_ingressToStorageZmqSocketMutex,
+        HDTN_MSGTYPE_STORE_BATCH, true, m_hdtnConfig.m_moduleBusBatchMaxMessages, moduleBusBatchLinger,
+        boost::bind(&Ingress::Impl::OnToStorageBatchSendFailed, this, boost::placeholders::_1, boost::placeholders::_2), "ingressStoreBatch"))
+    {
+        LOG_INFO(subprocess) << "batching up to " << m_hdtnConfig.m_moduleBusBatchMaxMessages << " bundles per message to storage";
+    }
+
     //THIS PROBABLY DOESNT WORK SINCE IT HAPPENED AFTER BIND/CONNECT BUT NOT USED ANYWAY BECAUSE OF POLLITEMS
     //static const int timeout = 250;  // milliseconds
     //m_zmqPullSock_connectingStorageToBoundIngressPtr->set(zmq::sockopt::rcvtimeo, timeout);
@@ -638,6 +661,45 @@ static void CustomCleanupToStorageHdr(void *data, void *hint) {
     delete static_cast<hdtn::ToStorageHdr*>(hint);
 }
 
+//returns true if the ack was expected (called by ReadZmqAcksThreadFunc only)
+bool Ingress::Impl::ProcessEgressAck(const hdtn::EgressAckHdr& receivedEgressAckHdr) {
+    BundlePipelineAckingSet& bundlePipelineAckingSetObj = *(m_vectorBundlePipelineAckingSet[receivedEgressAckHdr.outductIndex]);
+    if (receivedEgressAckHdr.error == EGRESS_ACK_ERROR_TYPE::LINK_DOWN) {
+        //trigger a link down event in ingress more quickly than waiting for router.
+        //egress shall send the failed bundle to storage.
+        if (bundlePipelineAckingSetObj.m_linkIsUp) {
+            bundlePipelineAckingSetObj.m_linkIsUp = false; //no mutex needed as this flag is only set from ReadZmqAcksThreadFunc
+            LOG_INFO(subprocess) << "Got a link down notification from egress for outductIndex "
+                << receivedEgressAckHdr.outductIndex;
+        }
+    }
+    if (bundlePipelineAckingSetObj.CompareAndPop_ThreadSafe(receivedEgressAckHdr.custodyId, true)) { //true => isEgress
+        return true;
+    }
+    LOG_ERROR(subprocess) << "didn't receive expected egress ack";
+    return false;
+}
+
+//returns true if the ack was expected (called by ReadZmqAcksThreadFunc only)
+bool Ingress::Impl::ProcessStorageAck(const hdtn::StorageAckHdr& receivedStorageAck) {
+    BundlePipelineAckingSet& bundlePipelineAckingSetObj = (receivedStorageAck.outductIndex == UINT64_MAX) ?
+        m_singleStorageBundlePipelineAckingSet : (*(m_vectorBundlePipelineAckingSet[receivedStorageAck.outductIndex]));
+    if (receivedStorageAck.error && (receivedStorageAck.outductIndex != UINT64_MAX)) {
+        //trigger a link down event in ingress more quickly than waiting for router.
+        //storage shall write the failed bundle to storage.
+        if (bundlePipelineAckingSetObj.m_linkIsUp) {
+            bundlePipelineAckingSetObj.m_linkIsUp = false; //no mutex needed as this flag is only set from ReadZmqAcksThreadFunc
+            LOG_INFO(subprocess) << "Got a link down notification from storage for outductIndex "
+                << receivedStorageAck.outductIndex;
+        }
+    }
+    if (bundlePipelineAckingSetObj.CompareAndPop_ThreadSafe(receivedStorageAck.ingressUniqueId, false)) { //false => is Storage
+        return true;
+    }
+    LOG_ERROR(subprocess) << "storage ack with ingressUniqueId " << receivedStorageAck.ingressUniqueId << " not found!";
+    return false;
+}
+
 void Ingress::Impl::ReadZmqAcksThreadFunc() {
 
     ThreadNamer::SetThisThreadName("ingressZmqAckReader");
@@ -662,14 +724,14 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
 
     //outduct capabilities updates
     AllOutductCapabilitiesTelemetry_t aoct;
-    m_aoctNeedsProcessing = false;
+    bool aoctNeedsProcessing = false;
+    std::vector<hdtn::EgressAckHdr> receivedEgressAckHdrsVec; //ack batches
+    std::vector<hdtn::StorageAckHdr> receivedStorageAcksVec;
     bool egressFullyInitialized = false;
 
     while (m_running.load(std::memory_order_acquire)) { //keep thread alive if running
-        //relaxed read ok.. this thread is only one that writes to m_aoctNeedsProcessing
-        if (m_aoctNeedsProcessing.load(std::memory_order_relaxed) && m_sharedMutexFinalDestsToOutductArrayIndexMaps.try_lock()) { //try to gain exclusive access
-            ingress_exclusive_lock_t lockExclusive(m_sharedMutexFinalDestsToOutductArrayIndexMaps, ingress_adopt_lock);
-            m_aoctNeedsProcessing.store(false, std::memory_order_release); //release => inform other thread of the change
+        if (aoctNeedsProcessing) { //the bundle threads keep routing on the current snapshot until the new one is published below
+            aoctNeedsProcessing = false;
             const bool isInitial = m_vectorBundlePipelineAckingSet.empty();
             if (isInitial) {
                 LOG_INFO(subprocess) << "Ingress received initial " << aoct.outductCapabilityTelemetryList.size() << " outduct telemetries from egress";
@@ -681,7 +743,7 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                 LOG_ERROR(subprocess) << "outduct capability update but m_vectorEgressToIngressAckingSet.size() != aoct.outductCapabilityTelemetryList.size()";
             }
             else {
-                m_mapNextHopNodeIdToOutductArrayIndex.clear();
+                boost::mutex::scoped_lock routingSnapshotWriterLock(m_routingSnapshotWriterMutex);
                 m_mapFinalDestNodeIdToOutductArrayIndex.clear();
                 m_mapFinalDestEidToOutductArrayIndex.clear();
 
@@ -707,7 +769,6 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                         ackingSet.Update(oct.maxBundlesInPipeline,
                             oct.maxBundleSizeBytesInPipeline, oct.nextHopNodeId, ackingSet.m_linkIsUp);
                     }
-                    m_mapNextHopNodeIdToOutductArrayIndex[oct.nextHopNodeId] = oct.outductArrayIndex;
                     for (std::list<cbhe_eid_t>::const_iterator it = oct.finalDestinationEidList.cbegin(); it != oct.finalDestinationEidList.cend(); ++it) {
                         const cbhe_eid_t& eid = *it;
                         m_mapFinalDestEidToOutductArrayIndex[eid] = oct.outductArrayIndex;
@@ -717,6 +778,11 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                         m_mapFinalDestNodeIdToOutductArrayIndex[nodeId] = oct.outductArrayIndex;
                     }
                 }
+                if (isInitial) { //m_vectorBundlePipelineAckingSet is never resized again
+                    m_numBundlePipelineAckingSets.store(m_vectorBundlePipelineAckingSet.size(), std::memory_order_release);
+                }
+                PublishRoutingSnapshot_NotThreadSafe(); //the bundle threads route on the new snapshot from here on
+                routingSnapshotWriterLock.unlock();
 
                 if ((!foundError) && (!egressFullyInitialized)) { //first time this outduct capabilities telemetry received, start remaining ingress threads
                     m_singleStorageBundlePipelineAckingSet.Update(STORAGE_MAX_BUNDLES_IN_PIPELINE * 2, //*2 because egress map ignored and the acking set divides by 2
@@ -725,7 +791,11 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                     m_threadTcpclOpportunisticBundlesFromEgressReaderPtr = boost::make_unique<boost::thread>(
                         boost::bind(&Ingress::Impl::ReadTcpclOpportunisticBundlesFromEgressThreadFunc, this)); //create and start the worker thread
 
-                    if (!m_inductManager.LoadInductsFromConfig(boost::bind(&Ingress::Impl::WholeBundleReadyCallback, this, boost::placeholders::_1), m_hdtnConfig.m_inductsConfig,
+                    m_ingressWorkerPool.Start(static_cast<unsigned int>(m_hdtnConfig.m_numIngressWorkerThreads), INGRESS_WORKER_MAX_QUEUED_BUNDLES,
+                        boost::bind(&Ingress::Impl::ProcessBundleOnIngressWorker, this, boost::placeholders::_1));
+
+                    if (!m_inductManager.LoadInductsFromConfigWithInductIndex(boost::bind(&Ingress::Impl::WholeBundleReadyCallback, this,
+                        boost::placeholders::_1, boost::placeholders::_2), m_hdtnConfig.m_inductsConfig,
                         m_hdtnConfig.m_myNodeId, m_hdtnConfig.m_maxLtpReceiveUdpPacketSizeBytes, m_hdtnConfig.m_maxBundleSizeBytes,
                         boost::bind(&Ingress::Impl::OnNewOpportunisticLinkCallback, this, boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3),
                         boost::bind(&Ingress::Impl::OnDeletedOpportunisticLinkCallback, this, boost::placeholders::_1, boost::placeholders::_2, boost::placeholders::_3)))
@@ -752,8 +822,7 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
 
         int rc = 0;
         try {
-            //relaxed read ok.. this thread is only one that writes to m_aoctNeedsProcessing
-            rc = zmq::poll(&items[0], NUM_SOCKETS, m_aoctNeedsProcessing.load(std::memory_order_relaxed) ? 1L : DEFAULT_BIG_TIMEOUT_POLL);
+            rc = zmq::poll(&items[0], NUM_SOCKETS, DEFAULT_BIG_TIMEOUT_POLL);
         }
         catch (zmq::error_t & e) {
             LOG_ERROR(subprocess) << "caught zmq::error_t in Ingress::ReadZmqAcksThreadFunc: " << e.what();
@@ -766,30 +835,29 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                 if (!res) {
                     LOG_ERROR(subprocess) << "cannot read EgressAckHdr";
                 }
+                else if ((res->size == sizeof(hdtn::BatchHdr)) && (receivedEgressAckHdr.base.type == HDTN_MSGTYPE_EGRESS_ACK_BATCH_TO_INGRESS)) {
+                    hdtn::BatchHdr batchHdr;
+                    memcpy(&batchHdr, &receivedEgressAckHdr, sizeof(hdtn::BatchHdr));
+                    if (!ModuleBusBatcher<hdtn::EgressAckHdr>::ReceiveHeaders(*m_zmqPullSock_connectingEgressToBoundIngressPtr, batchHdr, receivedEgressAckHdrsVec)) {
+                        LOG_ERROR(subprocess) << "cannot read the " << batchHdr.numMessages << " EgressAckHdr of an ack batch";
+                        ModuleBusBatcher<hdtn::EgressAckHdr>::DiscardRemainingParts(*m_zmqPullSock_connectingEgressToBoundIngressPtr);
+                    }
+                    else {
+                        for (std::size_t i = 0; i < receivedEgressAckHdrsVec.size(); ++i) {
+                            if (ProcessEgressAck(receivedEgressAckHdrsVec[i])) {
+                                ++totalAcksFromEgress;
+                            }
+                        }
+                    }
+                }
                 else if ((res->truncated()) || (res->size != sizeof(hdtn::EgressAckHdr))) {
                     LOG_ERROR(subprocess) << "EgressAckHdr message mismatch: untruncated = " << res->untruncated_size
                         << " truncated = " << res->size << " expected = " << sizeof(hdtn::EgressAckHdr);
                 }
                 else if (receivedEgressAckHdr.base.type == HDTN_MSGTYPE_EGRESS_ACK_TO_INGRESS) {
-                    ingress_shared_lock_t lockShared(m_sharedMutexFinalDestsToOutductArrayIndexMaps);
-                    BundlePipelineAckingSet& bundlePipelineAckingSetObj = *(m_vectorBundlePipelineAckingSet[receivedEgressAckHdr.outductIndex]);
-                    if (receivedEgressAckHdr.error == EGRESS_ACK_ERROR_TYPE::LINK_DOWN) {
-                        //trigger a link down event in ingress more quickly than waiting for router.
-                        //egress shall send the failed bundle to storage.
-                        if (bundlePipelineAckingSetObj.m_linkIsUp) {
-                            bundlePipelineAckingSetObj.m_linkIsUp = false; //no mutex needed as this flag is only set from ReadZmqAcksThreadFunc
-                            LOG_INFO(subprocess) << "Got a link down notification from egress for outductIndex " 
-                                << receivedEgressAckHdr.outductIndex;
-                        }
-                    }
-                    if (bundlePipelineAckingSetObj.CompareAndPop_ThreadSafe(receivedEgressAckHdr.custodyId, true)) { //true => isEgress
-                        bundlePipelineAckingSetObj.NotifyAll();
+                    if (ProcessEgressAck(receivedEgressAckHdr)) {
                         ++totalAcksFromEgress;
                     }
-                    else {
-                        LOG_ERROR(subprocess) << "didn't receive expected egress ack";
-                    }
-
                 }
                 else if (receivedEgressAckHdr.base.type == HDTN_MSGTYPE_ALL_OUTDUCT_CAPABILITIES_TELEMETRY) {
                     
@@ -808,7 +876,7 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                             LOG_ERROR(subprocess) << "received outductCapabilityTelemetryList is empty!";
                         }
                         else {
-                            m_aoctNeedsProcessing.store(true, std::memory_order_release); //release => inform other thread of the change
+                            aoctNeedsProcessing = true; //processed at the top of the loop
                         }
                     }
                 }
@@ -823,6 +891,21 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                     LOG_ERROR(subprocess) << "BpIngressSyscall::ReadZmqAcksThreadFunc: cannot read storage BlockHdr ack";
 
                 }
+                else if ((res->size == sizeof(hdtn::BatchHdr)) && (receivedStorageAck.base.type == HDTN_MSGTYPE_STORAGE_ACK_BATCH_TO_INGRESS)) {
+                    hdtn::BatchHdr batchHdr;
+                    memcpy(&batchHdr, &receivedStorageAck, sizeof(hdtn::BatchHdr));
+                    if (!ModuleBusBatcher<hdtn::StorageAckHdr>::ReceiveHeaders(*m_zmqPullSock_connectingStorageToBoundIngressPtr, batchHdr, receivedStorageAcksVec)) {
+                        LOG_ERROR(subprocess) << "cannot read the " << batchHdr.numMessages << " StorageAckHdr of an ack batch";
+                        ModuleBusBatcher<hdtn::StorageAckHdr>::DiscardRemainingParts(*m_zmqPullSock_connectingStorageToBoundIngressPtr);
+                    }
+                    else {
+                        for (std::size_t i = 0; i < receivedStorageAcksVec.size(); ++i) {
+                            if (ProcessStorageAck(receivedStorageAcksVec[i])) {
+                                ++totalAcksFromStorage;
+                            }
+                        }
+                    }
+                }
                 else if ((res->truncated()) || (res->size != sizeof(hdtn::StorageAckHdr))) {
                     LOG_ERROR(subprocess) << "StorageAckHdr message mismatch: untruncated = " << res->untruncated_size
                         << " truncated = " << res->size << " expected = " << sizeof(hdtn::StorageAckHdr);
@@ -831,25 +914,9 @@ void Ingress::Impl::ReadZmqAcksThreadFunc() {
                     LOG_ERROR(subprocess) << "message ack not HDTN_MSGTYPE_STORAGE_ACK_TO_INGRESS";
                 }
                 else {
-                    ingress_shared_lock_t lockShared(m_sharedMutexFinalDestsToOutductArrayIndexMaps);
-                    BundlePipelineAckingSet& bundlePipelineAckingSetObj = (receivedStorageAck.outductIndex == UINT64_MAX) ?
-                        m_singleStorageBundlePipelineAckingSet : (*(m_vectorBundlePipelineAckingSet[receivedStorageAck.outductIndex]));
-                    if (receivedStorageAck.error && (receivedStorageAck.outductIndex != UINT64_MAX)) {
-                        //trigger a link down event in ingress more quickly than waiting for router.
-                        //storage shall write the failed bundle to storage.
-                        if (bundlePipelineAckingSetObj.m_linkIsUp) {
-                            bundlePipelineAckingSetObj.m_linkIsUp = false; //no mutex needed as this flag is only set from ReadZmqAcksThreadFunc
-                            LOG_INFO(subprocess) << "Got a link down notification from storage for outductIndex "
-                                << receivedStorageAck.outductIndex;
-                        }
-                    }
-                    if (bundlePipelineAckingSetObj.CompareAndPop_ThreadSafe(receivedStorageAck.ingressUniqueId, false)) { //false => is Storage
-                        bundlePipelineAckingSetObj.NotifyAll();
+                    if (ProcessStorageAck(receivedStorageAck)) {
                         ++totalAcksFromStorage;
                     }
-                    else {
-                        LOG_ERROR(subprocess) << "storage ack with ingressUniqueId " << receivedStorageAck.ingressUniqueId << " not found!";
-                    }
                 }
             }
             if (items[2].revents & ZMQ_POLLIN) { //events from Router
@@ -925,14 +992,10 @@ void Ingress::Impl::ZmqTelemThreadFunc() {
                 // Sync telemetry
                 AllInductTelemetry_t allInductTelem;
                 m_inductManager.PopulateAllInductTelemetry(allInductTelem); //sets timestamp
-                m_ingressToEgressZmqSocketMutex.lock();
                 allInductTelem.m_bundleCountEgress = m_bundleCountEgress;
                 allInductTelem.m_bundleByteCountEgress = m_bundleByteCountEgress;
-                m_ingressToEgressZmqSocketMutex.unlock();
-                m_ingressToStorageZmqSocketMutex.lock();
                 allInductTelem.m_bundleCountStorage = m_bundleCountStorage;
                 allInductTelem.m_bundleByteCountStorage = m_bundleByteCountStorage;
-                m_ingressToStorageZmqSocketMutex.unlock();
 
                 bool more = false;
                 do {
@@ -1029,18 +1092,17 @@ void Ingress::Impl::ReadTcpclOpportunisticBundlesFromEgressThreadFunc() {
                 LOG_ERROR(subprocess) << "ReadTcpclOpportunisticBundlesFromEgressThreadFunc: cannot receive zmq";
             }
             else {
-                static constexpr bool isSafeToYieldThisThread = true; //can yield
                 if (messageFlags) { //1 => from egress and needs processing (is padded from the convergence layer)
                     uint8_t * paddedDataBegin = (uint8_t *)zmqPotentiallyPaddedMessage->data();
                     uint8_t * bundleDataBegin = paddedDataBegin + PaddedMallocatorConstants::PADDING_ELEMENTS_BEFORE;
 
                     std::size_t bundleCurrentSize = zmqPotentiallyPaddedMessage->size() - PaddedMallocatorConstants::TOTAL_PADDING_ELEMENTS;
-                    ProcessPaddedData(bundleDataBegin, bundleCurrentSize, zmqPotentiallyPaddedMessage, unusedPaddedVec, true, true, isSafeToYieldThisThread);
+                    ProcessPaddedData(bundleDataBegin, bundleCurrentSize, zmqPotentiallyPaddedMessage, unusedPaddedVec, true, true);
                     ++totalOpportunisticBundlesFromEgress;
                 }
                 else { //0 => from storage and needs no processing (is not padded)
                     ProcessPaddedData((uint8_t *)zmqPotentiallyPaddedMessage->data(), zmqPotentiallyPaddedMessage->size(),
-                        zmqPotentiallyPaddedMessage, unusedPaddedVec, true, false, isSafeToYieldThisThread);
+                        zmqPotentiallyPaddedMessage, unusedPaddedVec, true, false);
                 }
             }
         }
@@ -1059,8 +1121,7 @@ void Ingress::Impl::RouterEventHandler() {
             << " truncated = " << res->size << " expected = " << sizeof(releaseChangeHdr);
     }
     else if (releaseChangeHdr.base.type == HDTN_MSGTYPE_ILINKUP) {
-        ingress_shared_lock_t lockShared(m_sharedMutexFinalDestsToOutductArrayIndexMaps);
-        if (releaseChangeHdr.outductArrayIndex < m_vectorBundlePipelineAckingSet.size()) {
+        if (releaseChangeHdr.outductArrayIndex < m_numBundlePipelineAckingSets.load(std::memory_order_acquire)) {
             BundlePipelineAckingSet& bundlePipelineAckingSetObj = *(m_vectorBundlePipelineAckingSet[releaseChangeHdr.outductArrayIndex]);
             if (!bundlePipelineAckingSetObj.m_linkIsUp) {
                 bundlePipelineAckingSetObj.m_linkIsUp = true; //no mutex needed as this flag is only set from ReadZmqAcksThreadFunc
@@ -1072,8 +1133,7 @@ void Ingress::Impl::RouterEventHandler() {
         }
     }
     else if (releaseChangeHdr.base.type == HDTN_MSGTYPE_ILINKDOWN) {
-        ingress_shared_lock_t lockShared(m_sharedMutexFinalDestsToOutductArrayIndexMaps);
-        if (releaseChangeHdr.outductArrayIndex < m_vectorBundlePipelineAckingSet.size()) {
+        if (releaseChangeHdr.outductArrayIndex < m_numBundlePipelineAckingSets.load(std::memory_order_acquire)) {
             BundlePipelineAckingSet& bundlePipelineAckingSetObj = *(m_vectorBundlePipelineAckingSet[releaseChangeHdr.outductArrayIndex]);
             if (bundlePipelineAckingSetObj.m_linkIsUp) {
                 bundlePipelineAckingSetObj.m_linkIsUp = false; //no mutex needed as this flag is only set from ReadZmqAcksThreadFunc
@@ -1092,11 +1152,13 @@ void Ingress::Impl::RouterEventHandler() {
         }
         else {
             static padded_vector_uint8_t unusedPaddedVecMessage;
-            static constexpr bool isSafeToYieldThisThread = false; //not safe to yield since called by the ReadZmqAcksThreadFunc
             ProcessPaddedData((uint8_t*)zmqMessageBundleFromRouterPtr->data(), zmqMessageBundleFromRouterPtr->size(),
-                zmqMessageBundleFromRouterPtr, unusedPaddedVecMessage, true, false, isSafeToYieldThisThread); //second to last param => does not need processing because it came from router
+                zmqMessageBundleFromRouterPtr, unusedPaddedVecMessage, true, false); //second to last param => does not need processing because it came from router
         }
     }
+    else if (releaseChangeHdr.base.type == HDTN_MSGTYPE_IPRELOAD) {
+        //storage only (published to all subscribers), nothing to do
+    }
     else {
         LOG_ERROR(subprocess) << "unknown IreleaseChangeHdr message type " << releaseChangeHdr.base.type;
     }
@@ -1105,7 +1167,7 @@ void Ingress::Impl::RouterEventHandler() {
 bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bundleCurrentSize,
     std::unique_ptr<zmq::message_t> & zmqPaddedMessageUnderlyingDataUniquePtr,
     padded_vector_uint8_t & paddedVecMessageUnderlyingData,
-    const bool usingZmqData, const bool needsProcessing, const bool isSafeToYieldThisThread)
+    const bool usingZmqData, const bool needsProcessing)
 {
     std::unique_ptr<zmq::message_t> zmqMessageToSendUniquePtr; //create on heap as zmq default constructor costly
     if (bundleCurrentSize > m_hdtnConfig.m_maxBundleSizeBytes) { //should never reach here as this is handled by induct
@@ -1344,8 +1406,18 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
         hdtn::ToEgressHdr* toEgressHdr = new hdtn::ToEgressHdr();
         zmq::message_t zmqMessageToEgressHdrWithDataStolen(toEgressHdr, sizeof(hdtn::ToEgressHdr), CustomCleanupToEgressHdr, toEgressHdr);
         toEgressHdr->base.type = HDTN_MSGTYPE_BUNDLES_TO_ROUTER;
-        {
+        if (m_inprocBundleRingsPtr) {
+            if (!PushToEgressRing(*toEgressHdr, zmqMessageToSendUniquePtr.get(), INPROC_RING_FULL_WAIT)) {
+                LOG_ERROR(subprocess) << "can't push bundle intended for router to the egress ring";
+            }
+            else { //success
+                ++m_bundleCountEgress;
+                m_bundleByteCountEgress += bundleCurrentSize;
+            }
+        }
+        else {
             boost::mutex::scoped_lock lock(m_ingressToEgressZmqSocketMutex);
+            m_toEgressBatcher.Send_NotThreadSafe(); //unbatched messages must not overtake the bundles already batched
             if (!m_zmqPushSock_boundIngressToConnectingEgressPtr->send(std::move(zmqMessageToEgressHdrWithDataStolen), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
                 LOG_ERROR(subprocess) << "can't send toEgressHdr to egress";
             }
@@ -1354,11 +1426,12 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
                     LOG_ERROR(subprocess) << "can't send bundle intended for router to egress";
                 }
                 else { //success
-                    ++m_bundleCountEgress; //protected by m_ingressToEgressZmqSocketMutex
-                    m_bundleByteCountEgress += bundleCurrentSize; //protected by m_ingressToEgressZmqSocketMutex
+                    ++m_bundleCountEgress;
+                    m_bundleByteCountEgress += bundleCurrentSize;
                 }
             }
         }
+        HandleFailedBatches(); //without the socket mutexes
         return true;
     }
     /*
@@ -1432,10 +1505,10 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
     //If custody flag is set, only send the bundle out of an ingress link if and only if the bundle came from storage, because storage handles all things custody related.
     //Otherwise if custody flag is set but it didn't come from storage (came either from egress or ingress), send to storage first, and it will eventually come
     //back to this point in the code once storage processes custody.
-    m_availableDestOpportunisticNodeIdToTcpclInductMapMutex.lock();
-    std::map<uint64_t, Induct*>::iterator tcpclInductIterator = m_availableDestOpportunisticNodeIdToTcpclInductMap.find(finalDestEid.nodeId);
-    const bool isOpportunisticLinkUp = (tcpclInductIterator != m_availableDestOpportunisticNodeIdToTcpclInductMap.end());
-    m_availableDestOpportunisticNodeIdToTcpclInductMapMutex.unlock();
+    uint64_t outductIndex; //UINT64_MAX => no cut-through path to egress
+    Induct* opportunisticInductPtr;
+    LookupRoute(finalDestEid, outductIndex, opportunisticInductPtr); //lock-free read of the current routing snapshot
+    const bool isOpportunisticLinkUp = (opportunisticInductPtr != NULL);
     const bool bundleCameFromStorageModule = (!needsProcessing);
     bool needsFragmenting = (m_hdtnConfig.m_fragmentBundlesLargerThanBytes &&
             isBpVersion6 && canBeFragmented &&
@@ -1445,7 +1518,7 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
                                       (bundleCameFromStorageModule || !(requestsCustody || isAdminRecordForHdtnStorage || needsFragmenting)) &&
                                       (!m_hdtnConfig.m_enforceBundlePriority);
     if (trySendOnOpportunisticLink) {
-        if (tcpclInductIterator->second->ForwardOnOpportunisticLink(finalDestEid.nodeId, *zmqMessageToSendUniquePtr, 3)) { //thread safe forward with 3 second timeout
+        if (opportunisticInductPtr->ForwardOnOpportunisticLink(finalDestEid.nodeId, *zmqMessageToSendUniquePtr, 3)) { //thread safe forward with 3 second timeout
             sentDataOnOpportunisticLink = true;
         }
         else {
@@ -1470,39 +1543,10 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
         // Query the Masker for pseudo-destination
 #ifdef MASKING_ENABLED
         finalDestEid = queryResult;
+        LookupRoute(finalDestEid, outductIndex, opportunisticInductPtr); //route the pseudo-destination
 #endif
 
-        { //begin scope for cut-through shared mutex lock
-            uint64_t outductIndex = UINT64_MAX;
-
-            //Prevent thread starving of writer thread trying to obtain exclusive lock
-            // of m_sharedMutexFinalDestsToOutductArrayIndexMaps in order to process a received aoct (from routing update).
-            // In other words, this thread knows (per the m_aoctNeedsProcessing boolean) that ReadZmqAcksThreadFunc is
-            // trying to obtain an exclusive lock, so make sure these induct threads don't try to obtain a shared lock and starve
-            // the ReadZmqAcksThread.
-            if (isSafeToYieldThisThread) { //prevent thread yielding when ProcessPaddedData is called by the ReadZmqAcksThreadFunc itself
-                for (unsigned int yieldAttempt = 0; m_aoctNeedsProcessing.load(std::memory_order_acquire); ++yieldAttempt) {
-                    LOG_DEBUG(subprocess) << "rx bundle thread yield for AOCT processing\n";
-                    if (yieldAttempt >= 400) {
-                        LOG_ERROR(subprocess) << "dropping bundle because AOCT not processed within 4 seconds of being received";
-                        return false;
-                    }
-                    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
-                }
-            }
-
-            ingress_shared_lock_t lockShared(m_sharedMutexFinalDestsToOutductArrayIndexMaps);
-            std::map<cbhe_eid_t, uint64_t>::const_iterator itEid = m_mapFinalDestEidToOutductArrayIndex.find(finalDestEid);
-            if (itEid != m_mapFinalDestEidToOutductArrayIndex.cend()) {
-                outductIndex = itEid->second;
-            }
-            else {
-                std::map<uint64_t, uint64_t>::const_iterator itNodeId = m_mapFinalDestNodeIdToOutductArrayIndex.find(finalDestEid.nodeId);
-                if (itNodeId != m_mapFinalDestNodeIdToOutductArrayIndex.cend()) {
-                    outductIndex = itNodeId->second;
-                }
-            }
-            
+        { //begin scope for cut-through
             bool reservedStorageCutThroughPipelineAvailability = false;
             if (outductIndex != UINT64_MAX) {
                 BundlePipelineAckingSet& bundleCutThroughPipelineAckingSetObj = *(m_vectorBundlePipelineAckingSet[outductIndex]);
@@ -1529,23 +1573,40 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
                         }
                         else { //if(reservedEgressPipelineAvailability) //pipeline limits not exceeded for egress cut-through path, continue to send the bundle to egress
 
-                            //force natural/64-bit alignment
-                            hdtn::ToEgressHdr* toEgressHdr = new hdtn::ToEgressHdr();
-                            zmq::message_t zmqMessageToEgressHdrWithDataStolen(toEgressHdr, sizeof(hdtn::ToEgressHdr), CustomCleanupToEgressHdr, toEgressHdr);
+                            //copied into the batch, the ring descriptor, or a zmq message (which is naturally aligned) when sent
+                            hdtn::ToEgressHdr toEgressHdr;
 
                             //memset 0 not needed because all values set below
-                            toEgressHdr->base.type = HDTN_MSGTYPE_EGRESS;
-                            toEgressHdr->base.flags = 0; //flags not used by egress // static_cast<uint16_t>(primary.flags);
-                            toEgressHdr->nextHopNodeId = bundleCutThroughPipelineAckingSetObj.GetNextHopNodeId();
-                            toEgressHdr->finalDestEid = finalDestEid;
-                            toEgressHdr->hasCustody = requestsCustody;
-                            toEgressHdr->isCutThroughFromStorage = 0;
-                            toEgressHdr->custodyId = fromIngressUniqueId;
-                            toEgressHdr->outductIndex = outductIndex;
-                            {
-                                //zmq::message_t messageWithDataStolen(hdrPtr.get(), sizeof(hdtn::BlockHdr), CustomIgnoreCleanupBlockHdr); //cleanup will occur in the queue below
+                            toEgressHdr.base.type = HDTN_MSGTYPE_EGRESS;
+                            toEgressHdr.base.flags = 0; //flags not used by egress // static_cast<uint16_t>(primary.flags);
+                            toEgressHdr.nextHopNodeId = bundleCutThroughPipelineAckingSetObj.GetNextHopNodeId();
+                            toEgressHdr.finalDestEid = finalDestEid;
+                            toEgressHdr.hasCustody = requestsCustody;
+                            toEgressHdr.isCutThroughFromStorage = 0;
+                            toEgressHdr.custodyId = fromIngressUniqueId;
+                            toEgressHdr.outductIndex = outductIndex;
+                            if (m_inprocBundleRingsPtr) { //no lock, each ingress thread pushes to a ring of its own
+                                //don't wait for a full egress ring, the bundle goes to storage instead (as when the zmq send fails)
+                                if (!PushToEgressRing(toEgressHdr, zmqMessageToSendUniquePtr.get(), boost::posix_time::time_duration(0, 0, 0, 0))) {
+                                    LOG_ERROR(subprocess) << "can't push bundle to the egress ring";
+                                    bundleCutThroughPipelineAckingSetObj.CompareAndPop_ThreadSafe(fromIngressUniqueId, true);
+                                    useStorage = true;
+                                }
+                                else {
+                                    //success
+                                    ++m_bundleCountEgress;
+                                    m_bundleByteCountEgress += bundleCurrentSize;
+                                }
+                            }
+                            else {
                                 boost::mutex::scoped_lock lock(m_ingressToEgressZmqSocketMutex);
-                                if (!m_zmqPushSock_boundIngressToConnectingEgressPtr->send(std::move(zmqMessageToEgressHdrWithDataStolen), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
+                                if (m_toEgressBatcher.IsRunning_NotThreadSafe()) {
+                                    //the unsent bundles of a batch which can't be sent go to storage once this lock is released (see OnToEgressBatchSendFailed)
+                                    m_toEgressBatcher.Append_NotThreadSafe(toEgressHdr, zmqMessageToSendUniquePtr.get());
+                                    ++m_bundleCountEgress;
+                                    m_bundleByteCountEgress += bundleCurrentSize;
+                                }
+                                else if (!m_zmqPushSock_boundIngressToConnectingEgressPtr->send(zmq::const_buffer(&toEgressHdr, sizeof(hdtn::ToEgressHdr)), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
                                     LOG_ERROR(subprocess) << "can't send toEgressHdr to egress";
                                     bundleCutThroughPipelineAckingSetObj.CompareAndPop_ThreadSafe(fromIngressUniqueId, true);
                                     useStorage = true;
@@ -1559,8 +1620,8 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
                                     }
                                     else {
                                         //success                            
-                                        ++m_bundleCountEgress; //protected by m_ingressToEgressZmqSocketMutex
-                                        m_bundleByteCountEgress += bundleCurrentSize; //protected by m_ingressToEgressZmqSocketMutex
+                                        ++m_bundleCountEgress;
+                                        m_bundleByteCountEgress += bundleCurrentSize;
                                     }
                                 }
                             }
@@ -1587,34 +1648,34 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
                     BundlePipelineAckingSet& ackingSetObj = (outductIndex == UINT64_MAX) ?
                         m_singleStorageBundlePipelineAckingSet : (*(m_vectorBundlePipelineAckingSet[outductIndex])); //only used to restore state if zmq fails
                     
-                    //force natural/64-bit alignment
-                    hdtn::ToStorageHdr* toStorageHdr = new hdtn::ToStorageHdr();
-                    zmq::message_t zmqMessageToStorageHdrWithDataStolen(toStorageHdr, sizeof(hdtn::ToStorageHdr), CustomCleanupToStorageHdr, toStorageHdr);
+                    //copied into the batch or a zmq message (which is naturally aligned) when sent
+                    hdtn::ToStorageHdr toStorageHdr;
 
                     //memset 0 not needed because all values set below
-                    toStorageHdr->base.type = HDTN_MSGTYPE_STORE;
-                    toStorageHdr->base.flags = 0; //flags not used by storage // static_cast<uint16_t>(primary.flags);
-                    toStorageHdr->ingressUniqueId = fromIngressUniqueId;
-                    toStorageHdr->outductIndex = outductIndex;
-                    toStorageHdr->dontStoreBundle = reservedStorageCutThroughPipelineAvailability;
-                    toStorageHdr->isCustodyOrAdminRecord = (requestsCustody || isAdminRecordForHdtnStorage || needsFragmenting);
-                    toStorageHdr->finalDestEid = finalDestEid;
-
-                    //zmq threads not thread safe but protected by mutex below
-                    boost::mutex::scoped_lock lock(m_ingressToStorageZmqSocketMutex);
-                    if (!m_zmqPushSock_boundIngressToConnectingStoragePtr->send(std::move(zmqMessageToStorageHdrWithDataStolen), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
-                        LOG_ERROR(subprocess) << "can't send toStorageHdr to storage, this bundle will be lost";
-                        ackingSetObj.CompareAndPop_ThreadSafe(fromIngressUniqueId, false);
-                    }
-                    else {
-                        if (!m_zmqPushSock_boundIngressToConnectingStoragePtr->send(std::move(*zmqMessageToSendUniquePtr), zmq::send_flags::dontwait)) {
-                            LOG_ERROR(subprocess) << "can't send bundle to storage, this bundle will be lost";
+                    toStorageHdr.base.type = HDTN_MSGTYPE_STORE;
+                    toStorageHdr.base.flags = 0; //flags not used by storage // static_cast<uint16_t>(primary.flags);
+                    toStorageHdr.ingressUniqueId = fromIngressUniqueId;
+                    toStorageHdr.outductIndex = outductIndex;
+                    toStorageHdr.dontStoreBundle = reservedStorageCutThroughPipelineAvailability;
+                    toStorageHdr.isCustodyOrAdminRecord = (requestsCustody || isAdminRecordForHdtnStorage || needsFragmenting);
+                    toStorageHdr.finalDestEid = finalDestEid;
+
+                    if (m_inprocBundleRingsPtr) { //no lock, each ingress thread pushes to a ring of its own
+                        //the pipeline slot is already reserved, so wait for storage to make room in the ring rather than drop the bundle
+                        if (!PushToStorageRing(toStorageHdr, zmqMessageToSendUniquePtr.get(), INPROC_RING_FULL_WAIT)) {
+                            LOG_ERROR(subprocess) << "storage ring full for " << INPROC_RING_FULL_WAIT.total_seconds() << " seconds, this bundle will be lost";
                             ackingSetObj.CompareAndPop_ThreadSafe(fromIngressUniqueId, false);
                         }
                         else {
-                            //success                            
-                            ++m_bundleCountStorage; //protected by m_ingressToStorageZmqSocketMutex
-                            m_bundleByteCountStorage += bundleCurrentSize; //protected by m_ingressToStorageZmqSocketMutex
+                            ++m_bundleCountStorage;
+                            m_bundleByteCountStorage += bundleCurrentSize;
+                        }
+                    }
+                    else {
+                        //zmq threads not thread safe but protected by mutex below
+                        boost::mutex::scoped_lock lock(m_ingressToStorageZmqSocketMutex);
+                        if (!SendToStorage_NotThreadSafe(toStorageHdr, *zmqMessageToSendUniquePtr)) {
+                            ackingSetObj.CompareAndPop_ThreadSafe(fromIngressUniqueId, false);
                         }
                     }
                 }
@@ -1622,19 +1683,140 @@ bool Ingress::Impl::ProcessPaddedData(uint8_t * bundleDataBegin, std::size_t bun
                     LOG_ERROR(subprocess) << "storage module unresponsive, this bundle will be lost";
                 }
             }
-        } //end scope for cut-through shared mutex lock
+        } //end scope for cut-through
+        HandleFailedBatches(); //without the socket mutexes
     }
 
     return true;
 }
 
 
-void Ingress::Impl::WholeBundleReadyCallback(padded_vector_uint8_t & wholeBundleVec) {
+void Ingress::Impl::WholeBundleReadyCallback(padded_vector_uint8_t & wholeBundleVec, const uint64_t inductIndex) {
+    if (m_ingressWorkerPool.GetNumWorkers()) {
+        //hand the bundle to the worker of its induct (so that the bundles of one induct are forwarded in order).
+        //Blocks this induct thread while that worker's queue is full, so that the induct still doesn't acknowledge
+        //data faster than ingress can process it.
+        if (!m_ingressWorkerPool.Push(inductIndex, wholeBundleVec)) {
+            LOG_ERROR(subprocess) << "dropping bundle received while the ingress workers are stopping";
+        }
+        return;
+    }
     //if more than 1 BpSinkAsync context, must protect shared resources with mutex.  Each BpSinkAsync context has
     //its own processing thread that calls this callback
     static std::unique_ptr<zmq::message_t> unusedZmqPtr;
-    static constexpr bool isSafeToYieldThisThread = true; //can yield ingress threads
-    ProcessPaddedData(wholeBundleVec.data(), wholeBundleVec.size(), unusedZmqPtr, wholeBundleVec, false, true, isSafeToYieldThisThread);
+    ProcessPaddedData(wholeBundleVec.data(), wholeBundleVec.size(), unusedZmqPtr, wholeBundleVec, false, true);
+}
+
+void Ingress::Impl::ProcessBundleOnIngressWorker(padded_vector_uint8_t & bundleVec) {
+    static thread_local std::unique_ptr<zmq::message_t> unusedZmqPtr;
+    ProcessPaddedData(bundleVec.data(), bundleVec.size(), unusedZmqPtr, bundleVec, false, true);
+}
+
+//thread safe without a lock: every induct thread or ingress worker is the single producer of a ring of its own
+//waits up to timeout for room in a full ring (the thread's own ring, or the shared ring 0 for threads beyond the dedicated rings)
+bool Ingress::Impl::PushToEgressRing(const hdtn::ToEgressHdr& toEgressHdr, zmq::message_t* zmqMessageBundlePtr, const boost::posix_time::time_duration& timeout) {
+    ToEgressDescriptor descriptor;
+    descriptor.toEgressHdr = toEgressHdr;
+    if (zmqMessageBundlePtr) {
+        descriptor.bundle = std::move(*zmqMessageBundlePtr);
+    }
+    if (!m_inprocBundleRingsPtr->ingressToEgressRings.TryPushFor(descriptor, timeout)) { //still full
+        if (zmqMessageBundlePtr) {
+            *zmqMessageBundlePtr = std::move(descriptor.bundle); //give the bundle back (e.g. so that it can go to storage instead)
+        }
+        return false;
+    }
+    return true;
+}
+
+//thread safe without a lock (see PushToEgressRing)
+bool Ingress::Impl::PushToStorageRing(const hdtn::ToStorageHdr& toStorageHdr, zmq::message_t* zmqMessageBundlePtr, const boost::posix_time::time_duration& timeout) {
+    ToStorageDescriptor descriptor;
+    descriptor.toStorageHdr = toStorageHdr;
+    if (zmqMessageBundlePtr) {
+        descriptor.bundle = std::move(*zmqMessageBundlePtr);
+    }
+    if (!m_inprocBundleRingsPtr->ingressToStorageRings.TryPushFor(descriptor, timeout)) { //still full
+        if (zmqMessageBundlePtr) {
+            *zmqMessageBundlePtr = std::move(descriptor.bundle);
+        }
+        return false;
+    }
+    return true;
+}
+
+//returns false if the bundle could not be sent (the caller holds m_ingressToStorageZmqSocketMutex)
+bool Ingress::Impl::SendToStorage_NotThreadSafe(const hdtn::ToStorageHdr& toStorageHdr, zmq::message_t& zmqMessageBundle) {
+    const std::size_t bundleSize = zmqMessageBundle.size();
+    if (m_toStorageBatcher.IsRunning_NotThreadSafe()) {
+        //the unsent bundles of a batch which can't be sent are handled by OnToStorageBatchSendFailed once this lock is released
+        m_toStorageBatcher.Append_NotThreadSafe(toStorageHdr, &zmqMessageBundle);
+    }
+    else if (!m_zmqPushSock_boundIngressToConnectingStoragePtr->send(zmq::const_buffer(&toStorageHdr, sizeof(hdtn::ToStorageHdr)), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
+        LOG_ERROR(subprocess) << "can't send toStorageHdr to storage, this bundle will be lost";
+        return false;
+    }
+    else if (!m_zmqPushSock_boundIngressToConnectingStoragePtr->send(std::move(zmqMessageBundle), zmq::send_flags::dontwait)) {
+        LOG_ERROR(subprocess) << "can't send bundle to storage, this bundle will be lost";
+        return false;
+    }
+    ++m_bundleCountStorage;
+    m_bundleByteCountStorage += bundleSize;
+    return true;
+}
+
+//called by the induct (or ingress worker) threads and the batchers' linger threads after releasing the socket mutexes,
+//so that the send failed callbacks below may block
+void Ingress::Impl::HandleFailedBatches() {
+    m_toEgressBatcher.HandleFailedBatches();
+    m_toStorageBatcher.HandleFailedBatches();
+}
+
+//called by m_toEgressBatcher (without a socket mutex held) with the bundles which were not handed to the egress socket,
+//which go to storage like a bundle whose single egress send failed
+void Ingress::Impl::OnToEgressBatchSendFailed(std::vector<hdtn::ToEgressHdr>& toEgressHdrs, std::vector<zmq::message_t>& zmqMessageBundles) {
+    static const boost::posix_time::time_duration twoSeconds = boost::posix_time::seconds(2); //same wait as the unbatched path
+    LOG_ERROR(subprocess) << "can't send " << toEgressHdrs.size() << " batched bundles to egress, sending them to storage instead";
+    for (std::size_t i = 0; i < toEgressHdrs.size(); ++i) {
+        const hdtn::ToEgressHdr& toEgressHdr = toEgressHdrs[i];
+        zmq::message_t& zmqMessageBundle = zmqMessageBundles[i];
+        m_vectorBundlePipelineAckingSet[toEgressHdr.outductIndex]->CompareAndPop_ThreadSafe(toEgressHdr.custodyId, true);
+        --m_bundleCountEgress;
+        m_bundleByteCountEgress -= zmqMessageBundle.size();
+        if (!m_singleStorageBundlePipelineAckingSet.WaitForStoragePipelineAvailabilityAndReserve(twoSeconds,
+            toEgressHdr.custodyId, zmqMessageBundle.size()))
+        {
+            LOG_ERROR(subprocess) << "storage module unresponsive, this bundle will be lost";
+            continue;
+        }
+        hdtn::ToStorageHdr toStorageHdr;
+        //memset 0 not needed because all values set below
+        toStorageHdr.base.type = HDTN_MSGTYPE_STORE;
+        toStorageHdr.base.flags = 0;
+        toStorageHdr.ingressUniqueId = toEgressHdr.custodyId;
+        toStorageHdr.outductIndex = UINT64_MAX;
+        toStorageHdr.dontStoreBundle = 0;
+        toStorageHdr.isCustodyOrAdminRecord = toEgressHdr.hasCustody;
+        toStorageHdr.finalDestEid = toEgressHdr.finalDestEid;
+        boost::mutex::scoped_lock lock(m_ingressToStorageZmqSocketMutex);
+        if (!SendToStorage_NotThreadSafe(toStorageHdr, zmqMessageBundle)) {
+            m_singleStorageBundlePipelineAckingSet.CompareAndPop_ThreadSafe(toEgressHdr.custodyId, false);
+        }
+    }
+    m_toStorageBatcher.HandleFailedBatches();
+}
+
+//called by m_toStorageBatcher (without a socket mutex held) with the bundles which were not handed to the storage socket
+void Ingress::Impl::OnToStorageBatchSendFailed(std::vector<hdtn::ToStorageHdr>& toStorageHdrs, std::vector<zmq::message_t>& zmqMessageBundles) {
+    LOG_ERROR(subprocess) << "can't send a batch of " << toStorageHdrs.size() << " bundles to storage, these bundles will be lost";
+    for (std::size_t i = 0; i < toStorageHdrs.size(); ++i) {
+        const hdtn::ToStorageHdr& toStorageHdr = toStorageHdrs[i];
+        BundlePipelineAckingSet& ackingSetObj = (toStorageHdr.outductIndex == UINT64_MAX) ?
+            m_singleStorageBundlePipelineAckingSet : (*(m_vectorBundlePipelineAckingSet[toStorageHdr.outductIndex]));
+        ackingSetObj.CompareAndPop_ThreadSafe(toStorageHdr.ingressUniqueId, false);
+        --m_bundleCountStorage;
+        m_bundleByteCountStorage -= zmqMessageBundles[i].size();
+    }
 }
 
 void Ingress::Impl::SendOpportunisticLinkMessages(const uint64_t remoteNodeId, bool isAvailable) {
@@ -1646,9 +1828,15 @@ void Ingress::Impl::SendOpportunisticLinkMessages(const uint64_t remoteNodeId, b
     //memset 0 not needed because all values set below
     toEgressHdr->base.type = isAvailable ? HDTN_MSGTYPE_EGRESS_ADD_OPPORTUNISTIC_LINK : HDTN_MSGTYPE_EGRESS_REMOVE_OPPORTUNISTIC_LINK;
     toEgressHdr->finalDestEid.nodeId = remoteNodeId; //only used field, rest are don't care
-    {
+    if (m_inprocBundleRingsPtr) {
+        if (!PushToEgressRing(*toEgressHdr, NULL, INPROC_RING_FULL_WAIT)) {
+            LOG_ERROR(subprocess) << "can't push ToEgressHdr Opportunistic link message to the egress ring";
+        }
+    }
+    else {
         //zmq::message_t messageWithDataStolen(hdrPtr.get(), sizeof(hdtn::BlockHdr), CustomIgnoreCleanupBlockHdr); //cleanup will occur in the queue below
         boost::mutex::scoped_lock lock(m_ingressToEgressZmqSocketMutex);
+        m_toEgressBatcher.Send_NotThreadSafe(); //unbatched messages must not overtake the bundles already batched
         if (!m_zmqPushSock_boundIngressToConnectingEgressPtr->send(std::move(zmqMessageToEgressHdrWithDataStolen), zmq::send_flags::dontwait)) {
             LOG_ERROR(subprocess) << "can't send ToEgressHdr Opportunistic link message to egress";
         }
@@ -1661,12 +1849,19 @@ void Ingress::Impl::SendOpportunisticLinkMessages(const uint64_t remoteNodeId, b
     //memset 0 not needed because all values set below
     toStorageHdr->base.type = isAvailable ? HDTN_MSGTYPE_STORAGE_ADD_OPPORTUNISTIC_LINK : HDTN_MSGTYPE_STORAGE_REMOVE_OPPORTUNISTIC_LINK;
     toStorageHdr->ingressUniqueId = remoteNodeId; //use this field as the remote node id
-    {
+    if (m_inprocBundleRingsPtr) {
+        if (!PushToStorageRing(*toStorageHdr, NULL, INPROC_RING_FULL_WAIT)) {
+            LOG_ERROR(subprocess) << "can't push ToStorageHdr Opportunistic link message to the storage ring";
+        }
+    }
+    else {
         boost::mutex::scoped_lock lock(m_ingressToStorageZmqSocketMutex);
+        m_toStorageBatcher.Send_NotThreadSafe(); //unbatched messages must not overtake the bundles already batched
         if (!m_zmqPushSock_boundIngressToConnectingStoragePtr->send(std::move(zmqMessageToStorageHdrWithDataStolen), zmq::send_flags::dontwait)) {
             LOG_ERROR(subprocess) << "can't send ToStorageHdr Opportunistic link message to storage";
         }
     }
+    HandleFailedBatches(); //without the socket mutexes
 }
 
 void Ingress::Impl::OnNewOpportunisticLinkCallback(const uint64_t remoteNodeId, Induct* thisInductPtr, void* sinkPtr) {
@@ -1674,14 +1869,16 @@ void Ingress::Impl::OnNewOpportunisticLinkCallback(const uint64_t remoteNodeId,
     if (TcpclInduct * tcpclInductPtr = dynamic_cast<TcpclInduct*>(thisInductPtr)) {
         LOG_INFO(subprocess) << "New opportunistic link detected on TcpclV3 induct for ipn:" << remoteNodeId << ".*";
         SendOpportunisticLinkMessages(remoteNodeId, true);
-        boost::mutex::scoped_lock lock(m_availableDestOpportunisticNodeIdToTcpclInductMapMutex);
+        boost::mutex::scoped_lock lock(m_routingSnapshotWriterMutex);
         m_availableDestOpportunisticNodeIdToTcpclInductMap[remoteNodeId] = tcpclInductPtr;
+        PublishRoutingSnapshot_NotThreadSafe();
     }
     else if (TcpclV4Induct * tcpclV4InductPtr = dynamic_cast<TcpclV4Induct*>(thisInductPtr)) {
         LOG_INFO(subprocess) << "New opportunistic link detected on TcpclV4 induct for ipn:" << remoteNodeId << ".*";
         SendOpportunisticLinkMessages(remoteNodeId, true);
-        boost::mutex::scoped_lock lock(m_availableDestOpportunisticNodeIdToTcpclInductMapMutex);
+        boost::mutex::scoped_lock lock(m_routingSnapshotWriterMutex);
         m_availableDestOpportunisticNodeIdToTcpclInductMap[remoteNodeId] = tcpclV4InductPtr;
+        PublishRoutingSnapshot_NotThreadSafe();
     }
     else if (dynamic_cast<StcpInduct*>(thisInductPtr)) {
 
@@ -1689,8 +1886,9 @@ void Ingress::Impl::OnNewOpportunisticLinkCallback(const uint64_t remoteNodeId,
     else if (SlipOverUartInduct* slipOverUartInductPtr = dynamic_cast<SlipOverUartInduct*>(thisInductPtr)) {
         LOG_INFO(subprocess) << "New opportunistic link detected on SlipOverUart induct for ipn:" << remoteNodeId << ".*";
         SendOpportunisticLinkMessages(remoteNodeId, true);
-        boost::mutex::scoped_lock lock(m_availableDestOpportunisticNodeIdToTcpclInductMapMutex);
+        boost::mutex::scoped_lock lock(m_routingSnapshotWriterMutex);
         m_availableDestOpportunisticNodeIdToTcpclInductMap[remoteNodeId] = slipOverUartInductPtr;
+        PublishRoutingSnapshot_NotThreadSafe();
     }
     else {
         LOG_ERROR(subprocess) << "OnNewOpportunisticLinkCallback: Induct ptr cannot cast to TcpclInduct or TcpclV4Induct";
@@ -1705,8 +1903,9 @@ void Ingress::Impl::OnDeletedOpportunisticLinkCallback(const uint64_t remoteNode
             << ((sinkPtrAboutToBeDeleted) ? "Tcpcl" : "SlipOverUart")
             << "induct for ipn : " << remoteNodeId << ".*";
         SendOpportunisticLinkMessages(remoteNodeId, false);
-        boost::mutex::scoped_lock lock(m_availableDestOpportunisticNodeIdToTcpclInductMapMutex);
+        boost::mutex::scoped_lock lock(m_routingSnapshotWriterMutex);
         m_availableDestOpportunisticNodeIdToTcpclInductMap.erase(remoteNodeId);
+        PublishRoutingSnapshot_NotThreadSafe();
     }
 }
 
@@ -1847,10 +2046,9 @@ void Ingress::Impl::SendPing(const uint64_t remoteNodeId, const uint64_t remoteP
         zmqMessageToSendUniquePtr = boost::make_unique<zmq::message_t>(rxBufRawPointer->data(), rxBufRawPointer->size(), CustomCleanupPaddedVecUint8, rxBufRawPointer);
     }
     static padded_vector_uint8_t unusedPaddedVecMessage;
-    static constexpr bool isSafeToYieldThisThread = false; //not safe to yield since called by the ReadZmqAcksThreadFunc
     ProcessPaddedData((uint8_t*)zmqMessageToSendUniquePtr->data(), zmqMessageToSendUniquePtr->size(),
         zmqMessageToSendUniquePtr, unusedPaddedVecMessage,
-        true, false, isSafeToYieldThisThread); //second to last param false => does not need processing because it came from here (also needed because not padded data!)
+        true, false); //second to last param false => does not need processing because it came from here (also needed because not padded data!)
 }
 
 void Ingress::Impl::ProcessReceivedPingPayload(const uint8_t* data, const uint64_t size, const uint64_t bpVersion) {
@@ -0,0 +1,191 @@
+/**
+ * @file TestBundlePipelineAckingSet.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "BundlePipelineAckingSet.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <boost/thread.hpp>
+
+BOOST_AUTO_TEST_CASE(BundlePipelineAckingSetReserveAndPopTestCase)
+{
+    static const boost::posix_time::time_duration noWait = boost::posix_time::seconds(0);
+    hdtn::BundlePipelineAckingSet ackingSet(8, 8000, 5, true); //4 bundles and 4000 bytes per path
+    BOOST_REQUIRE_EQUAL(ackingSet.GetHalfOfMaxBundlesInPipeline(), 4);
+    bool reservedEgress, reservedStorage;
+    for (uint64_t id = 0; id < 4; ++id) {
+        BOOST_REQUIRE(ackingSet.WaitForPipelineAvailabilityAndReserve(true, true, noWait, id, 100, reservedEgress, reservedStorage));
+        BOOST_REQUIRE(reservedEgress && (!reservedStorage)); //egress first
+    }
+    //egress full, so storage next
+    BOOST_REQUIRE(ackingSet.WaitForPipelineAvailabilityAndReserve(true, true, noWait, 4, 3900, reservedEgress, reservedStorage));
+    BOOST_REQUIRE((!reservedEgress) && reservedStorage);
+    BOOST_REQUIRE(!ackingSet.WaitForStoragePipelineAvailabilityAndReserve(noWait, 5, 101)); //byte limit
+    BOOST_REQUIRE(ackingSet.WaitForStoragePipelineAvailabilityAndReserve(noWait, 5, 100));
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(true), 4);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(true), 400);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(false), 2);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(false), 4000);
+
+    BOOST_REQUIRE(!ackingSet.CompareAndPop_ThreadSafe(4, true)); //on the storage path
+    BOOST_REQUIRE(!ackingSet.CompareAndPop_ThreadSafe(100, true)); //never reserved
+    BOOST_REQUIRE(ackingSet.CompareAndPop_ThreadSafe(4, false));
+    BOOST_REQUIRE(!ackingSet.CompareAndPop_ThreadSafe(4, false)); //already popped
+    BOOST_REQUIRE(ackingSet.CompareAndPop_ThreadSafe(5, false));
+    for (uint64_t id = 0; id < 4; ++id) {
+        BOOST_REQUIRE(ackingSet.CompareAndPop_ThreadSafe(id, true));
+    }
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(true), 0);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(true), 0);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(false), 0);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(false), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BundlePipelineAckingSetClampTestCase)
+{
+    static const boost::posix_time::time_duration noWait = boost::posix_time::seconds(0);
+    static const uint64_t MAX_PER_PATH = BUNDLE_PIPELINE_ACKING_SET_MAX_BUNDLES_IN_PIPELINE >> 1;
+    //a maxBundlesInPipeline beyond the bundle count bits of the packed word is clamped instead of overflowing into nothing
+    hdtn::BundlePipelineAckingSet ackingSet(static_cast<uint64_t>(1) << 40, UINT64_MAX, 5, true);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetHalfOfMaxBundlesInPipeline(), MAX_PER_PATH);
+    ackingSet.Update(UINT64_MAX, UINT64_MAX, 5, true);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetHalfOfMaxBundlesInPipeline(), MAX_PER_PATH);
+
+    bool reservedEgress, reservedStorage;
+    for (uint64_t id = 0; id < MAX_PER_PATH; ++id) {
+        BOOST_REQUIRE(ackingSet.WaitForPipelineAvailabilityAndReserve(true, false, noWait, id, 1, reservedEgress, reservedStorage));
+    }
+    BOOST_REQUIRE(!ackingSet.WaitForPipelineAvailabilityAndReserve(true, false, noWait, MAX_PER_PATH, 1, reservedEgress, reservedStorage));
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(true), MAX_PER_PATH);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(true), MAX_PER_PATH);
+    for (uint64_t id = 0; id < MAX_PER_PATH; ++id) {
+        BOOST_REQUIRE(ackingSet.CompareAndPop_ThreadSafe(id, true));
+    }
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(true), 0);
+    BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(true), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BundlePipelineAckingSetConcurrentTestCase)
+{
+    //reserving threads (like the induct threads) against acking threads (like the egress and storage ack handlers),
+    //where a lost wakeup times out a reserve and a leaked budget shows up as a non-empty pipeline at the end
+    static const unsigned int NUM_RESERVERS = 4;
+    static const unsigned int NUM_ACKERS = 2;
+    static const uint64_t NUM_RESERVES_PER_RESERVER = 20000;
+    static const uint64_t MAX_BUNDLES_PER_PATH = 16;
+    static const uint64_t MAX_BYTES_PER_PATH = 16000;
+    static const boost::posix_time::time_duration timeout = boost::posix_time::seconds(5);
+    hdtn::BundlePipelineAckingSet ackingSet(MAX_BUNDLES_PER_PATH * 2, MAX_BYTES_PER_PATH * 2, 5, true);
+
+    struct in_flight_t {
+        uint64_t uniqueId;
+        uint64_t bundleSizeBytes;
+        bool isEgress;
+    };
+    boost::mutex inFlightMutex;
+    boost::condition_variable inFlightConditionVariable;
+    std::deque<in_flight_t> inFlightQueue;
+    //counted after a reserve and before its pop, so never above the set's own accounting
+    std::atomic<uint64_t> numBundlesInFlight[2];
+    std::atomic<uint64_t> numBytesInFlight[2];
+    std::atomic<uint64_t> maxBundlesSeen[2];
+    std::atomic<uint64_t> maxBytesSeen[2];
+    for (unsigned int i = 0; i < 2; ++i) {
+        numBundlesInFlight[i] = 0;
+        numBytesInFlight[i] = 0;
+        maxBundlesSeen[i] = 0;
+        maxBytesSeen[i] = 0;
+    }
+    std::atomic<uint64_t> numTimeouts(0);
+    std::atomic<uint64_t> numFailedPops(0);
+    std::atomic<unsigned int> numReserversRunning(NUM_RESERVERS);
+
+    std::vector<std::unique_ptr<boost::thread> > threads;
+    for (unsigned int reserverIndex = 0; reserverIndex < NUM_RESERVERS; ++reserverIndex) {
+        threads.emplace_back(new boost::thread([&, reserverIndex]() {
+            for (uint64_t i = 0; i < NUM_RESERVES_PER_RESERVER; ++i) {
+                in_flight_t inFlight;
+                inFlight.uniqueId = (reserverIndex * NUM_RESERVES_PER_RESERVER) + i;
+                inFlight.bundleSizeBytes = 1 + ((inFlight.uniqueId * 7919) % 1000);
+                bool reservedEgress, reservedStorage;
+                if (!ackingSet.WaitForPipelineAvailabilityAndReserve(true, true, timeout,
+                    inFlight.uniqueId, inFlight.bundleSizeBytes, reservedEgress, reservedStorage))
+                {
+                    ++numTimeouts;
+                    continue;
+                }
+                inFlight.isEgress = reservedEgress;
+                const unsigned int pathIndex = (reservedEgress) ? 0 : 1;
+                const uint64_t bundles = numBundlesInFlight[pathIndex].fetch_add(1) + 1;
+                const uint64_t bytes = numBytesInFlight[pathIndex].fetch_add(inFlight.bundleSizeBytes) + inFlight.bundleSizeBytes;
+                uint64_t seen = maxBundlesSeen[pathIndex].load();
+                while ((bundles > seen) && (!maxBundlesSeen[pathIndex].compare_exchange_weak(seen, bundles))) {}
+                seen = maxBytesSeen[pathIndex].load();
+                while ((bytes > seen) && (!maxBytesSeen[pathIndex].compare_exchange_weak(seen, bytes))) {}
+                {
+                    boost::mutex::scoped_lock lock(inFlightMutex);
+                    inFlightQueue.push_back(inFlight);
+                }
+                inFlightConditionVariable.notify_one();
+            }
+            --numReserversRunning;
+            inFlightConditionVariable.notify_all();
+        }));
+    }
+    for (unsigned int ackerIndex = 0; ackerIndex < NUM_ACKERS; ++ackerIndex) {
+        threads.emplace_back(new boost::thread([&]() {
+            while (true) {
+                in_flight_t inFlight;
+                {
+                    boost::mutex::scoped_lock lock(inFlightMutex);
+                    while (inFlightQueue.empty() && numReserversRunning.load()) {
+                        inFlightConditionVariable.timed_wait(lock, boost::posix_time::milliseconds(10));
+                    }
+                    if (inFlightQueue.empty()) {
+                        return;
+                    }
+                    inFlight = inFlightQueue.front();
+                    inFlightQueue.pop_front();
+                }
+                const unsigned int pathIndex = (inFlight.isEgress) ? 0 : 1;
+                numBundlesInFlight[pathIndex].fetch_sub(1);
+                numBytesInFlight[pathIndex].fetch_sub(inFlight.bundleSizeBytes);
+                if (!ackingSet.CompareAndPop_ThreadSafe(inFlight.uniqueId, inFlight.isEgress)) {
+                    ++numFailedPops;
+                }
+            }
+        }));
+    }
+    for (std::size_t i = 0; i < threads.size(); ++i) {
+        threads[i]->join();
+    }
+
+    BOOST_REQUIRE_EQUAL(numTimeouts.load(), 0);
+    BOOST_REQUIRE_EQUAL(numFailedPops.load(), 0);
+    for (unsigned int pathIndex = 0; pathIndex < 2; ++pathIndex) {
+        BOOST_REQUIRE_LE(maxBundlesSeen[pathIndex].load(), MAX_BUNDLES_PER_PATH);
+        BOOST_REQUIRE_LE(maxBytesSeen[pathIndex].load(), MAX_BYTES_PER_PATH);
+        BOOST_REQUIRE_EQUAL(ackingSet.GetNumBundlesInPipeline(pathIndex == 0), 0);
+        BOOST_REQUIRE_EQUAL(ackingSet.GetNumBytesInPipeline(pathIndex == 0), 0);
+    }
+    BOOST_REQUIRE_GT(maxBundlesSeen[1].load(), 0); //the storage path was used once egress was full
+
+    //no budget leaked: a full path's worth can be reserved again
+    static const boost::posix_time::time_duration noWait = boost::posix_time::seconds(0);
+    for (uint64_t id = 0; id < MAX_BUNDLES_PER_PATH; ++id) {
+        BOOST_REQUIRE(ackingSet.WaitForStoragePipelineAvailabilityAndReserve(noWait, id, 1));
+    }
+}
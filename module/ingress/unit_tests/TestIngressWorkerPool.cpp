@@ -0,0 +1,93 @@
+/**
+ * @file TestIngressWorkerPool.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "IngressWorkerPool.h"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <set>
+#include <vector>
+#include <boost/bind/bind.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/thread.hpp>
+
+namespace {
+struct DeliveredBundles {
+    DeliveredBundles(const std::size_t numInducts) : seqsPerInduct(numInducts), threadIdsPerInduct(numInducts) {}
+    void OnBundle(padded_vector_uint8_t & bundle) {
+        uint64_t inductIndex;
+        uint64_t seq;
+        std::memcpy(&inductIndex, bundle.data(), sizeof(inductIndex));
+        std::memcpy(&seq, bundle.data() + sizeof(inductIndex), sizeof(seq));
+        boost::mutex::scoped_lock lock(mutex);
+        seqsPerInduct[inductIndex].push_back(seq);
+        threadIdsPerInduct[inductIndex].insert(boost::this_thread::get_id());
+    }
+    boost::mutex mutex;
+    std::vector<std::vector<uint64_t> > seqsPerInduct;
+    std::vector<std::set<boost::thread::id> > threadIdsPerInduct;
+};
+
+static void PushBundlesThreadFunc(hdtn::IngressWorkerPool* poolPtr, const uint64_t inductIndex, const uint64_t numBundles) {
+    for (uint64_t seq = 0; seq < numBundles; ++seq) {
+        padded_vector_uint8_t bundle(sizeof(inductIndex) + sizeof(seq));
+        std::memcpy(bundle.data(), &inductIndex, sizeof(inductIndex));
+        std::memcpy(bundle.data() + sizeof(inductIndex), &seq, sizeof(seq));
+        BOOST_REQUIRE(poolPtr->Push(inductIndex, bundle));
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE(IngressWorkerPoolPerInductOrderTestCase)
+{
+    static constexpr uint64_t numInducts = 5;
+    static constexpr unsigned int numWorkers = 3; //fewer workers than inducts so that some inducts share a worker
+    static constexpr uint64_t numBundlesPerInduct = 2000;
+    DeliveredBundles delivered(numInducts);
+    hdtn::IngressWorkerPool pool;
+    BOOST_REQUIRE(!pool.Push(0, *boost::make_unique<padded_vector_uint8_t>(16))); //not started
+    pool.Start(numWorkers, 4, boost::bind(&DeliveredBundles::OnBundle, &delivered, boost::placeholders::_1));
+    BOOST_REQUIRE_EQUAL(pool.GetNumWorkers(), numWorkers);
+
+    std::vector<std::unique_ptr<boost::thread> > inductThreads;
+    for (uint64_t inductIndex = 0; inductIndex < numInducts; ++inductIndex) {
+        inductThreads.emplace_back(boost::make_unique<boost::thread>(
+            boost::bind(&PushBundlesThreadFunc, &pool, inductIndex, numBundlesPerInduct)));
+    }
+    for (std::size_t i = 0; i < inductThreads.size(); ++i) {
+        inductThreads[i]->join();
+    }
+    pool.Stop(); //drains the queued bundles
+    BOOST_REQUIRE_EQUAL(pool.GetNumWorkers(), 0);
+
+    for (uint64_t inductIndex = 0; inductIndex < numInducts; ++inductIndex) {
+        //every bundle delivered exactly once and in the order pushed by its induct
+        const std::vector<uint64_t> & seqs = delivered.seqsPerInduct[inductIndex];
+        BOOST_REQUIRE_EQUAL(seqs.size(), numBundlesPerInduct);
+        for (uint64_t seq = 0; seq < numBundlesPerInduct; ++seq) {
+            BOOST_REQUIRE_EQUAL(seqs[seq], seq);
+        }
+        //pinned to one worker
+        BOOST_REQUIRE_EQUAL(delivered.threadIdsPerInduct[inductIndex].size(), 1);
+    }
+    //inducts 0 and 3 share worker 0, inducts 1 and 4 share worker 1, induct 2 has worker 2 to itself
+    BOOST_REQUIRE(delivered.threadIdsPerInduct[0] == delivered.threadIdsPerInduct[3]);
+    BOOST_REQUIRE(delivered.threadIdsPerInduct[1] == delivered.threadIdsPerInduct[4]);
+    BOOST_REQUIRE(delivered.threadIdsPerInduct[0] != delivered.threadIdsPerInduct[1]);
+    BOOST_REQUIRE(delivered.threadIdsPerInduct[0] != delivered.threadIdsPerInduct[2]);
+    BOOST_REQUIRE(delivered.threadIdsPerInduct[1] != delivered.threadIdsPerInduct[2]);
+
+    padded_vector_uint8_t lateBundle(16);
+    BOOST_REQUIRE(!pool.Push(0, lateBundle)); //stopped
+}
@@ -132,7 +132,8 @@ struct contactPlan_t {
     uint64_t rateBps;
 
     uint64_t outductArrayIndex; //not in operator <
-    bool isLinkUp;              //not in operator <
+    bool isLinkUp;
+    bool isPreload;             //storage preload event ahead of the link up event (isLinkUp is also true)
 
     bool operator<(const contactPlan_t& o) const; //operator < so it can be used as a map key
 };
@@ -217,6 +218,7 @@ private:
     void NotifyEgressOfTimeBasedLinkChange(uint64_t outductArrayIndex, uint64_t rateBps, bool linkIsUpTimeBased);
     void SendLinkUp(uint64_t outductArrayIndex);
     void SendLinkDown(uint64_t outductArrayIndex);
+    void SendPreload(uint64_t outductArrayIndex);
 
     void EgressEventsHandler();
     void StorageEventsHandler();
@@ -323,7 +325,10 @@ bool contactPlan_t::operator<(const contactPlan_t& o) const {
         if (source == o.source) {
             if (dest == o.dest) {
                 if (isLinkUp == o.isLinkUp) {
-                    return (start < o.start);
+                    if (isPreload == o.isPreload) {
+                        return (start < o.start);
+                    }
+                    return (isPreload < o.isPreload);
                 }
                 return (isLinkUp < o.isLinkUp);
             }
@@ -649,6 +654,31 @@ void Router::Impl::SendLinkUp(uint64_t outductArrayIndex) {
                          << " at time " << timeLocal;
 }
 
+/** Send preload message to storage (ingress ignores it) ahead of a scheduled contact
+ *
+ * Storage reads the next bundles for the outduct into RAM so that the
+ * start of the contact is not spent waiting on disk reads.
+ *
+ * @param outductArrayIndex - the outduct whose contact begins soon
+ */
+void Router::Impl::SendPreload(uint64_t outductArrayIndex) {
+    hdtn::IreleaseChangeHdr preloadMsg;
+    memset(&preloadMsg, 0, sizeof(preloadMsg));
+    preloadMsg.SetSubscribeAll();
+    preloadMsg.base.type = HDTN_MSGTYPE_IPRELOAD;
+    preloadMsg.outductArrayIndex = outductArrayIndex;
+
+    {
+        boost::mutex::scoped_lock lock(m_mutexZmqPubSock);
+        if (!m_zmqXPubSock_boundRouterToConnectingSubsPtr->send(
+            zmq::const_buffer(&preloadMsg, sizeof(preloadMsg)), zmq::send_flags::dontwait))
+        {
+            LOG_ERROR(subprocess) << "Cannot send preload message to storage";
+        }
+    }
+    LOG_DEBUG(subprocess) << " -- PRELOAD Event sent for outductArrayIndex=" << outductArrayIndex;
+}
+
 void Router::Impl::EgressEventsHandler() {
     //force this hdtn message struct to be aligned on a 64-byte boundary using zmq::mutable_buffer
     hdtn::LinkStatusHdr linkStatusHdr;
@@ -1333,10 +1363,19 @@ void Router::Impl::OnContactPlan_TimerExpired(const boost::system::error_code& e
         ptime_to_contactplan_bimap_t::left_iterator it = m_ptimeToContactPlanBimap.left.begin(); //get event that started the timer
         if (it != m_ptimeToContactPlanBimap.left.end()) {
             const contactPlan_t& contactPlan = it->second;
+            std::map<uint64_t, OutductInfo_t>::iterator outductInfoIt = m_mapOutductArrayIndexToOutductInfo.find(contactPlan.outductArrayIndex);
+            if (contactPlan.isPreload) {
+                //only worth preloading if the link is not already up (e.g. overlapping contacts)
+                if ((outductInfoIt != m_mapOutductArrayIndexToOutductInfo.end()) && (!outductInfoIt->second.IsUp())) {
+                    SendPreload(contactPlan.outductArrayIndex);
+                }
+                m_ptimeToContactPlanBimap.left.erase(it);
+                TryRestartContactPlanTimer(); //wait for next event
+                return;
+            }
             LOG_INFO(subprocess) << ((contactPlan.isLinkUp) ? "LINK UP" : "LINK DOWN") << " (time based) for source "
                 << contactPlan.source << " destination " << contactPlan.dest;
 
-            std::map<uint64_t, OutductInfo_t>::iterator outductInfoIt = m_mapOutductArrayIndexToOutductInfo.find(contactPlan.outductArrayIndex);
             if (outductInfoIt == m_mapOutductArrayIndexToOutductInfo.cend()) {
                 LOG_ERROR(subprocess) << "OnContactPlan_TimerExpired got event for unknown outductArrayIndex "
                     << contactPlan.outductArrayIndex;
@@ -1376,6 +1415,21 @@ void Router::Impl::OnContactPlan_TimerExpired(const boost::system::error_code& e
 
 /** Add contact to bimap for use with timer */
 bool Router::Impl::AddContact_NotThreadSafe(contactPlan_t& contact) {
+    contact.isPreload = false;
+    const uint64_t preloadSecondsBeforeContact = m_hdtnConfig.m_storageConfig.m_preloadSecondsBeforeContact;
+    if (preloadSecondsBeforeContact && contact.start) { //nothing to gain for a contact starting now
+        const uint64_t preloadTime = (contact.start > preloadSecondsBeforeContact) ? (contact.start - preloadSecondsBeforeContact) : 0;
+        ptime_index_pair_t pipPreload(m_epoch + boost::posix_time::seconds(preloadTime), 0);
+        while (m_ptimeToContactPlanBimap.left.count(pipPreload)) {
+            pipPreload.second += 1; //in case of events that occur at the same time
+        }
+        contact.isLinkUp = true;
+        contact.isPreload = true; //true => add storage preload event
+        if (!m_ptimeToContactPlanBimap.insert(ptime_to_contactplan_bimap_t::value_type(pipPreload, contact)).second) {
+            return false;
+        }
+        contact.isPreload = false;
+    }
     {
         ptime_index_pair_t pipStart(m_epoch + boost::posix_time::seconds(contact.start), 0);
         while (m_ptimeToContactPlanBimap.left.count(pipStart)) {
@@ -22,6 +22,8 @@
 
 #include <cstdint>
 #include <map>
+#include <set>
+#include <memory>
 #include "ForwardListQueue.h"
 #include <array>
 #include <vector>
@@ -29,7 +31,8 @@
 #include <string>
 #include "MemoryManagerTreeArray.h"
 #include "codec/PrimaryBlock.h"
-#include "HashMap16BitFixedSize.h"
+#include "HashMapRobinHood.h"
+#include "HierarchicalTimingWheel.h"
 #include <boost/bimap.hpp>
 #include <boost/date_time.hpp>
 #include "CatalogEntry.h"
@@ -42,9 +45,29 @@ typedef std::map<uint64_t, custids_flist_queue_t> expirations_to_custids_map_t;
 typedef std::array<expirations_to_custids_map_t, NUMBER_OF_PRIORITIES> priorities_to_expirations_array_t;
 typedef std::map<cbhe_eid_t, priorities_to_expirations_array_t> dest_eid_to_priorities_map_t;
 
-typedef HashMap16BitFixedSize<cbhe_bundle_uuid_t, uint64_t> uuid_to_custid_hashmap_t; //get the cteb custody id from fragmented bundle uuid
-typedef HashMap16BitFixedSize<cbhe_bundle_uuid_nofragment_t, uint64_t> uuidnofrag_to_custid_hashmap_t; //get the cteb custody id from non-fragmented bundle uuid
-typedef HashMap16BitFixedSize<uint64_t, catalog_entry_t> custid_to_catalog_entry_hashmap_t; //get the catalog entry from cteb custody id
+//Awaiting Send ready index of a destination group (i.e. the final destinations of one outduct):
+//one key per (destination, priority) with bundles awaiting send, ordered by highest priority then soonest expiration
+struct awaiting_send_ready_key_t {
+    awaiting_send_ready_key_t(const unsigned int paramPriorityIndex, const uint64_t paramExpiration, const cbhe_eid_t & paramDestEid) :
+        priorityIndex(paramPriorityIndex), expiration(paramExpiration), destEid(paramDestEid) {}
+    bool operator<(const awaiting_send_ready_key_t & o) const {
+        if (priorityIndex != o.priorityIndex) {
+            return (priorityIndex > o.priorityIndex); //00 = bulk, 01 = normal, 10 = expedited
+        }
+        if (expiration != o.expiration) {
+            return (expiration < o.expiration);
+        }
+        return (destEid < o.destEid);
+    }
+    unsigned int priorityIndex;
+    uint64_t expiration;
+    cbhe_eid_t destEid;
+};
+typedef std::set<awaiting_send_ready_key_t> awaiting_send_ready_set_t;
+
+typedef HashMapRobinHood<cbhe_bundle_uuid_t, uint64_t> uuid_to_custid_hashmap_t; //get the cteb custody id from fragmented bundle uuid
+typedef HashMapRobinHood<cbhe_bundle_uuid_nofragment_t, uint64_t> uuidnofrag_to_custid_hashmap_t; //get the cteb custody id from non-fragmented bundle uuid
+typedef HashMapRobinHood<uint64_t, catalog_entry_t> custid_to_catalog_entry_hashmap_t; //get the catalog entry from cteb custody id
 typedef boost::bimap<uint64_t, boost::posix_time::ptime> custid_to_custody_xfer_expiry_bimap_t;
 
 class BundleStorageCatalog {
@@ -58,18 +81,32 @@ public:
     STORAGE_LIB_EXPORT ~BundleStorageCatalog();
 
     STORAGE_LIB_EXPORT bool CatalogIncomingBundleForStore(catalog_entry_t & catalogEntryToTake, const PrimaryBlock & primary, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order);
+    //same as above but without a primary block (i.e. restoring from the catalog journal), bundleUuid is only used if the entry has custody
+    //(fragmentOffset and dataLength are ignored for a non-fragmented custody bundle)
+    STORAGE_LIB_EXPORT bool CatalogIncomingBundleForStore(catalog_entry_t & catalogEntryToTake, const cbhe_bundle_uuid_t & bundleUuid, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order);
 
     STORAGE_LIB_EXPORT catalog_entry_t * PopEntryFromAwaitingSend(uint64_t & custodyId, const std::vector<cbhe_eid_t> & availableDestEids);
     STORAGE_LIB_EXPORT catalog_entry_t * PopEntryFromAwaitingSend(uint64_t & custodyId, const std::vector<uint64_t> & availableDestNodeIds);
     STORAGE_LIB_EXPORT catalog_entry_t * PopEntryFromAwaitingSend(uint64_t & custodyId, const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests);
+
+    //Register a destination group (pair bool = true for any service ids) whose ready index is kept up to date on every
+    //insert and removal so that PopEntryFromAwaitingSend by group id is logarithmic regardless of the number of destinations.
+    //returns the destination group id
+    STORAGE_LIB_EXPORT uint64_t AddDestinationGroup(const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests);
+    STORAGE_LIB_EXPORT bool RemoveDestinationGroup(const uint64_t destinationGroupId);
+    STORAGE_LIB_EXPORT catalog_entry_t * PopEntryFromAwaitingSend(uint64_t & custodyId, const uint64_t destinationGroupId);
     
     STORAGE_LIB_EXPORT bool AddEntryToAwaitingSend(const catalog_entry_t & catalogEntry, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order);
     STORAGE_LIB_EXPORT bool ReturnEntryToAwaitingSend(const catalog_entry_t & catalogEntry, const uint64_t custodyId);
     STORAGE_LIB_EXPORT bool RemoveEntryFromAwaitingSend(const catalog_entry_t & catalogEntry, const uint64_t custodyId);
     STORAGE_LIB_EXPORT std::pair<bool, uint16_t> Remove(const uint64_t custodyId, bool alsoNeedsRemovedFromAwaitingSend);
     STORAGE_LIB_EXPORT catalog_entry_t * GetEntryFromCustodyId(const uint64_t custodyId);
+    STORAGE_LIB_EXPORT void GetAllEntries(std::vector<std::pair<uint64_t, const catalog_entry_t*> > & custodyIdAndEntryPtrs) const; //unordered
     STORAGE_LIB_EXPORT uint64_t * GetCustodyIdFromUuid(const cbhe_bundle_uuid_t & bundleUuid);
     STORAGE_LIB_EXPORT uint64_t * GetCustodyIdFromUuid(const cbhe_bundle_uuid_nofragment_t & bundleUuid);
+    //return the custody ids of bundles awaiting send whose expiration is <= expiry (maxNumberToFind = 0 for no limit).
+    //Bundles are found through an expiry timing wheel, so the caller is expected to remove every returned id
+    //(an id left in the catalog is not guaranteed to be returned again).
     STORAGE_LIB_EXPORT void GetExpiredBundleIds(const uint64_t expiry, const uint64_t maxNumberToFind, std::vector<uint64_t> & returnedIds);
     STORAGE_LIB_EXPORT bool GetStorageExpiringBeforeThresholdTelemetry(StorageExpiringBeforeThresholdTelemetry_t & telem);
 
@@ -83,6 +120,7 @@ public:
     STORAGE_LIB_EXPORT uint64_t GetTotalBundleByteEraseOperationsFromCatalog() const noexcept;
 
 private:
+    STORAGE_LIB_NO_EXPORT bool InsertCatalogEntry(catalog_entry_t & catalogEntryToTake, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order);
     STORAGE_LIB_NO_EXPORT catalog_entry_t * PopEntryFromAwaitingSend(uint64_t & custodyId,
         const std::vector<std::pair<const cbhe_eid_t*, priorities_to_expirations_array_t *> > & destEidPlusPriorityArrayPtrs);
     STORAGE_LIB_NO_EXPORT bool Insert_OrderBySequence(custids_flist_queue_t& custodyIdFlistQueue, const uint64_t custodyIdToInsert, const uint64_t mySequence);
@@ -90,6 +128,15 @@ private:
     STORAGE_LIB_NO_EXPORT void Insert_OrderByFilo(custids_flist_queue_t& custodyIdFlistQueue, const uint64_t custodyIdToInsert);
     STORAGE_LIB_NO_EXPORT bool Remove(custids_flist_queue_t& custodyIdFlistQueue, const uint64_t custodyIdToRemove);
 
+    struct destination_group_t {
+        std::vector<std::pair<cbhe_eid_t, bool> > availableDests;
+        awaiting_send_ready_set_t readySet;
+    };
+    typedef std::vector<destination_group_t*> destination_group_ptrs_t;
+    STORAGE_LIB_NO_EXPORT void UpdateDestinationGroups(const cbhe_eid_t & destEid, const unsigned int priorityIndex,
+        const bool hadHead, const uint64_t oldHeadExpiration, const expirations_to_custids_map_t & expirationMap);
+    STORAGE_LIB_NO_EXPORT void RebuildExpiryTimingWheel();
+
 protected:
     dest_eid_to_priorities_map_t m_destEidToPrioritiesMap;
     uuid_to_custid_hashmap_t m_uuidToCustodyIdHashMap;
@@ -102,6 +149,14 @@ protected:
     uint64_t m_totalBundleByteWriteOperationsToCatalog;
     uint64_t m_totalBundleEraseOperationsFromCatalog;
     uint64_t m_totalBundleByteEraseOperationsFromCatalog;
+    std::map<uint64_t, std::unique_ptr<destination_group_t> > m_destinationGroupIdToDestinationGroupMap;
+    std::map<cbhe_eid_t, destination_group_ptrs_t> m_fullyQualifiedEidToDestinationGroupsMap;
+    std::map<uint64_t, destination_group_ptrs_t> m_anyServiceNodeIdToDestinationGroupsMap;
+    uint64_t m_nextDestinationGroupId;
+    //every custody id added to awaiting send, keyed on its expiration; ids that left awaiting send are
+    //skipped when they expire, and the wheel is rebuilt from awaiting send once such stale ids outnumber the catalog
+    HierarchicalTimingWheel m_expiryTimingWheel;
+    std::vector<uint64_t> m_expiredCustodyIdCandidates; //popped from the wheel but not yet checked (maxNumberToFind reached)
 };
 
 
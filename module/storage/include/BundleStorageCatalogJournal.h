@@ -0,0 +1,141 @@
+/**
+ * @file BundleStorageCatalogJournal.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This BundleStorageCatalogJournal class keeps an append-only journal of every bundle added to or removed from
+ * the BundleStorageCatalog, plus a periodic snapshot of the whole catalog, so that a restart can rebuild the
+ * catalog and the MemoryManagerTreeArray by loading the snapshot and replaying the journal tail
+ * (time proportional to the number of stored bundles) instead of reading the head of every segment of every disk
+ * (time proportional to disk capacity).
+ * The snapshot and the journal each carry a generation number; a snapshot of generation g contains every journal of a
+ * generation less than g, so a journal older than the snapshot has already been folded into it.
+ * Once snapshotIntervalRecords records have been appended, the journal is rotated: it is renamed to the previous journal
+ * (the journal path with ".prev" appended) and restarted empty with the next generation, and a background thread then
+ * writes the snapshot of that generation from the old snapshot plus the previous journal (without touching the catalog),
+ * renames it into place and deletes the previous journal, so neither the snapshot nor its fsync is on the storage thread.
+ * Restore replays the previous journal, if it has not been folded yet, before the journal.
+ * If a write fails (or a background snapshot fails), the journal disables itself and deletes the snapshot and the journals,
+ * so that the next restore falls back to scanning the disks instead of loading a catalog that is missing bundles.
+ * Every record is protected by a CRC-32 and synced to the device before it is acknowledged, and the directory is synced
+ * after every rename or new journal.  An add record is appended once the bundle's segment writes are queued, not completed,
+ * so a restored bundle may be missing from the disks after a crash; the storage manager therefore checks the segment headers
+ * of every restored bundle on its disk and drops the ones which were never written.
+ */
+
+#ifndef _BUNDLE_STORAGE_CATALOG_JOURNAL_H
+#define _BUNDLE_STORAGE_CATALOG_JOURNAL_H 1
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <boost/thread.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/core/noncopyable.hpp>
+#include "BundleStorageCatalog.h"
+#include "MemoryManagerTreeArray.h"
+#include "storage_lib_export.h"
+
+class BundleStorageCatalogJournal : private boost::noncopyable {
+private:
+    BundleStorageCatalogJournal() = delete;
+public:
+    /**
+     * Constructor that reads the generation numbers of any existing snapshot and journal (no file is modified).
+     *
+     * @param journalFilePath The journal file path.  The snapshot is kept at this path with ".snapshot" appended,
+     *                        and the previous journal (while it is being folded into a new snapshot) with ".prev" appended.
+     * @param snapshotIntervalRecords The number of journal records after which a new snapshot is written.
+     */
+    STORAGE_LIB_EXPORT BundleStorageCatalogJournal(const boost::filesystem::path & journalFilePath, const uint64_t snapshotIntervalRecords);
+    STORAGE_LIB_EXPORT ~BundleStorageCatalogJournal();
+
+    /** Rebuild the catalog and the memory manager from the snapshot and the journal.
+     *
+     * @param catalog The (empty) catalog to populate.
+     * @param memoryManager The (empty) memory manager whose segments of every restored bundle will be allocated.
+     * @param totalBundlesRestored Set to the number of bundles restored.
+     * @param totalBytesRestored Set to the sum of the sizes of the bundles restored.
+     * @param totalSegmentsRestored Set to the number of segments restored.
+     * @return True if the catalog was restored, or False (with the reason logged) if the snapshot or journal is missing,
+     *         corrupt, or inconsistent, in which case neither the catalog nor the memory manager was modified.
+     */
+    STORAGE_LIB_EXPORT bool Restore(BundleStorageCatalog & catalog, MemoryManagerTreeArray & memoryManager,
+        uint64_t & totalBundlesRestored, uint64_t & totalBytesRestored, uint64_t & totalSegmentsRestored);
+
+    /** Write a snapshot of the given catalog entries under a new generation, then restart the journal empty with that generation
+     *  (done synchronously, once the catalog has been restored or found empty at startup).
+     *
+     * @param custodyIdAndEntryPtrs The catalog entries to snapshot, which must be exactly those that a restore should find
+     *                              (i.e. not the bundles still in the RAM hot tier, which are journaled once written to disk).
+     * @return True if both the snapshot and the new journal were written, or False otherwise (the journal is then disabled).
+     */
+    STORAGE_LIB_EXPORT bool WriteSnapshotAndRestartJournal(const std::vector<std::pair<uint64_t, const catalog_entry_t*> > & custodyIdAndEntryPtrs);
+
+    /** Append the record of a bundle that was added to the catalog, rotating the journal first if the snapshot interval has elapsed.
+     *
+     * @param custodyId The custody id of the added bundle.
+     * @param catalogEntry The catalog's entry of the added bundle.
+     * @return True if the record was appended, or False if the journal is (now) disabled.
+     */
+    STORAGE_LIB_EXPORT bool AppendAdd(const uint64_t custodyId, const catalog_entry_t & catalogEntry);
+
+    /** Append the record of a bundle that was removed from the catalog, rotating the journal first if the snapshot interval has elapsed.
+     *
+     * @param custodyId The custody id of the removed bundle.
+     * @return True if the record was appended, or False if the journal is (now) disabled.
+     */
+    STORAGE_LIB_EXPORT bool AppendRemove(const uint64_t custodyId);
+
+    /// Wait for any background snapshot to be written, then close the journal (its files are kept).
+    STORAGE_LIB_EXPORT void Close();
+    STORAGE_LIB_EXPORT const boost::filesystem::path & GetJournalFilePath() const noexcept;
+    STORAGE_LIB_EXPORT const boost::filesystem::path & GetSnapshotFilePath() const noexcept;
+    STORAGE_LIB_EXPORT const boost::filesystem::path & GetPreviousJournalFilePath() const noexcept;
+    STORAGE_LIB_EXPORT uint64_t GetGeneration() const noexcept;
+
+private:
+    /// Add records keyed by custody id (each one the record payload, without the size and crc header)
+    typedef std::map<uint64_t, std::vector<uint8_t> > custid_to_add_record_map_t;
+
+    STORAGE_LIB_NO_EXPORT bool AppendRecord(const std::vector<uint8_t> & record);
+    STORAGE_LIB_NO_EXPORT bool RotateJournal();
+    STORAGE_LIB_NO_EXPORT void Disable();
+    STORAGE_LIB_NO_EXPORT bool LoadAddRecords(const bool includeJournal, custid_to_add_record_map_t & addRecordsMap,
+        uint64_t & snapshotGeneration, uint64_t & nextJournalGeneration) const;
+    STORAGE_LIB_NO_EXPORT bool FoldPreviousJournalIntoSnapshot(const uint64_t newGeneration);
+    STORAGE_LIB_NO_EXPORT void SnapshotThreadFunc();
+
+private:
+    const boost::filesystem::path M_JOURNAL_FILE_PATH;
+    const boost::filesystem::path M_SNAPSHOT_FILE_PATH;
+    const boost::filesystem::path M_PREVIOUS_JOURNAL_FILE_PATH;
+    const uint64_t M_SNAPSHOT_INTERVAL_RECORDS;
+    uint64_t m_generation;
+    uint64_t m_numRecordsSinceSnapshot;
+    FILE * m_journalFileHandle;
+    std::vector<uint8_t> m_recordBuffer;
+
+    //background snapshot (started by the first rotation)
+    std::unique_ptr<boost::thread> m_snapshotThreadPtr;
+    boost::mutex m_snapshotMutex;
+    boost::condition_variable m_snapshotConditionVariable;
+    uint64_t m_pendingSnapshotGeneration; //0 if none, guarded by m_snapshotMutex
+    bool m_snapshotThreadRunning; //guarded by m_snapshotMutex
+    std::atomic<bool> m_snapshotPending; //cleared once the previous journal is folded, so that the journal may rotate again
+    std::atomic<bool> m_snapshotFailed;
+};
+
+#endif //_BUNDLE_STORAGE_CATALOG_JOURNAL_H
@@ -66,6 +66,28 @@ typedef uint64_t segment_id_t;
 #define SEGMENT_RESERVED_SPACE (sizeof(uint64_t) + sizeof(uint64_t) + sizeof(segment_id_t) + sizeof(uint64_t))
 #define BUNDLE_STORAGE_PER_SEGMENT_SIZE (SEGMENT_SIZE - SEGMENT_RESERVED_SPACE)
 #define READ_CACHE_NUM_SEGMENTS_PER_SESSION 50
+#define SEGMENT_BUFFER_ALIGNMENT 4096 //alignment of all segment read/write buffers (required by O_DIRECT disks)
+
+//SMALL BUNDLE SLABS (a slab is one segment split into equal slots of one size class, each slot holding one small bundle)
+#define SMALL_BUNDLE_SLAB_NUM_SIZE_CLASSES 4 //slot sizes of 128, 256, 512 and 1024 bytes
+#define SMALL_BUNDLE_SLAB_MIN_SLOT_SIZE 128
+#define SMALL_BUNDLE_SLAB_MAX_SLOTS 64 //per slab (one bit each of a uint64_t)
+#define SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE (sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint32_t)) //custodyId, bundleSizeBytes (0 if free), payloadSizeBytes
+#define SMALL_BUNDLE_SLAB_HEADER_BUNDLE_SIZE (UINT64_MAX - 1) //bundleSizeBytes of a slab segment's storage segment header
+#define SMALL_BUNDLE_SLAB_EXTENT_FLAG (static_cast<segment_id_t>(1) << ((sizeof(segment_id_t) * 8) - 1)) //numSegments of the only extent of a bundle in a slab is this flag | slot index
+#define SMALL_BUNDLE_SLAB_FLUSH_DELAY_MILLISECONDS 20 //longest time a changed slab waits to be written to its disk (see FlushSmallBundleSlabs)
+
+//DISK SPACE RECLAIMER (see DiskSpaceReclaimer.h)
+#define DISK_SPACE_RECLAIM_INTERVAL_MILLISECONDS 100 //longest time a freed segment waits to be reclaimed and freed
+#define DISK_SPACE_RECLAIM_BATCH_SEGMENTS 4096 //reclaim early once this many freed segments are queued
+
+//ADAPTIVE DISK STRIPING (see BundleStorageManagerBase::AllocateBundleSegmentExtents)
+#define ADAPTIVE_DISK_STRIPING_UPDATE_INTERVAL_MILLISECONDS 1000 //how often each disk's throughput (and so its striping weight) is remeasured
+#define ADAPTIVE_DISK_STRIPING_MAX_LEAVES_SCANNED 64 //leaf uint64_t (of 64 segments each) searched for free segments on the allowed disks
+#define ADAPTIVE_DISK_STRIPING_SLACK_SEGMENTS 30 //a disk is skipped once it is this many (throughput weighted) segments ahead of the least loaded disk (one full CIRCULAR_INDEX_BUFFER_SIZE)
+
+//RELEASE BUFFERS (see ReleaseBufferPool.h)
+#define RELEASE_BUFFER_POOL_MAX_FREE_BYTES (64ULL * 1024 * 1024) //most bytes of released bundle buffers kept for reuse once egress is done with them
 
 #ifdef _MSC_VER //Windows tests
 //#define FILE_SIZE (1024000000ULL * 1) //1 GByte total of files, or file_size / num_threads size per file
@@ -15,7 +15,8 @@
  *
  * This BundleStorageManagerAsio class inherits from the BundleStorageManagerBase class and implements
  * writing and reading bundles to and from solid state disk drive(s) using 1 thread regardless of number of drives
- * and uses cross-platform asynchronous I/O operations.
+ * and uses cross-platform asynchronous I/O operations.  Queued operations on adjacent segments of a disk are
+ * merged (up to maxCoalescedDiskIoSizeBytes) into a single scatter/gather read or write.
  */
 
 #ifndef _BUNDLE_STORAGE_MANAGER_ASIO_H
@@ -38,7 +39,7 @@ public:
 private:
     STORAGE_LIB_NO_EXPORT void TryDiskOperation_Consume_NotThreadSafe(const unsigned int diskId);
     STORAGE_LIB_NO_EXPORT void HandleDiskOperationCompleted(const boost::system::error_code& error, std::size_t bytes_transferred,
-        const unsigned int diskId, const unsigned int consumeIndex, const bool wasReadOperation);
+        const unsigned int diskId, const unsigned int consumeIndex, const unsigned int numSegments, const bool wasReadOperation);
 
     STORAGE_LIB_NO_EXPORT virtual void CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int diskId) override;
 
@@ -55,6 +56,8 @@ private:
 #endif
 
     std::vector<bool> m_diskOperationInProgressVec;
+    std::vector<boost::posix_time::ptime> m_diskOperationStartTimesVec; //per disk start of the operation in progress
+    std::vector<std::vector<boost::asio::mutable_buffer> > m_diskIoBuffersVec; //per disk scatter/gather list of the operation in progress
 };
 
 
@@ -15,6 +15,26 @@
  *
  * This BundleStorageManagerBase class implements the basic methods for
  * writing and reading bundles to and from solid state disk drive(s).
+ * When the storage config's ramHotTierMaxBytes is non-zero, bundles stored with PushAllSegments
+ * are first kept in a RAM hot tier and only written to disk once they have been resident for
+ * ramHotTierMaxResidentMilliseconds (see FlushRamHotTier) or when the hot tier is full, so that
+ * bundles which are released and deleted within that time never touch the disk.  Bundles still
+ * in the hot tier are not in the catalog journal and do not survive a crash.
+ * When the storage config's smallBundleSlabMaxBytes is non-zero, a bundle small enough for a slab slot is stored in
+ * one slot of a shared slab segment (see BundleStorageConfig.h) instead of a segment of its own.  Every slab segment is
+ * mirrored in RAM so that reading one of its bundles needs no disk I/O.  Storing or removing one of its bundles only
+ * changes the mirror and marks the slab dirty; every dirty slab is then written to its disk once, from the mirror, by
+ * FlushSmallBundleSlabs once SMALL_BUNDLE_SLAB_FLUSH_DELAY_MILLISECONDS have passed, so that a burst of small bundles costs one
+ * segment write per slab rather than one per bundle.  (RAM storage updates only the changed bytes, in place, right away.)
+ * When the storage config's diskSpaceReclaimMaxBytesPerSecond is non-zero, the segments of removed bundles are handed
+ * to a DiskSpaceReclaimer (started by the file backed implementations' Start()) which returns their blocks to the disks
+ * in rate limited batches before freeing them, so freed segments become allocatable again after at most
+ * DISK_SPACE_RECLAIM_INTERVAL_MILLISECONDS.
+ * When the storage config's adaptiveDiskStriping is true, each disk's throughput (bytes transferred per second the disk
+ * was busy) is remeasured every ADAPTIVE_DISK_STRIPING_UPDATE_INTERVAL_MILLISECONDS from the completions reported by the
+ * file backed implementations, and new bundles skip the segments of any disk that has been given more than
+ * ADAPTIVE_DISK_STRIPING_SLACK_SEGMENTS (throughput weighted) segments beyond the least loaded disk.  The segment layout
+ * (diskId = segmentId % numDisks) is unchanged, so stores remain restorable with or without it.
  */
 
 #ifndef _BUNDLE_STORAGE_MANAGER_BASE_H
@@ -30,6 +50,8 @@
 #include <boost/integer.hpp>
 #include <stdint.h>
 #include <map>
+#include <set>
+#include <deque>
 #include <array>
 #include <vector>
 #include <utility>
@@ -39,6 +61,8 @@
 #include <atomic>
 #include <boost/thread.hpp>
 #include <boost/bimap.hpp>
+#include <boost/align/aligned_delete.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include "CircularIndexBufferSingleProducerSingleConsumerConfigurable.h"
 #include "BundleStorageConfig.h"
 #include "Logger.h"
@@ -46,7 +70,10 @@
 #include "StorageConfig.h"
 #include "codec/bpv6.h"
 #include "BundleStorageCatalog.h"
+#include "BundleStorageCatalogJournal.h"
+#include "DiskSpaceReclaimer.h"
 #include "PaddedVectorUint8.h"
+#include "ReleaseBufferPool.h"
 
 
 
@@ -54,6 +81,7 @@
 struct BundleStorageManagerSession_WriteToDisk {
     catalog_entry_t catalogEntry;
     uint32_t nextLogicalSegment;
+    segment_id_extents_cursor_t nextSegmentCursor; //points to the segment Id of nextLogicalSegment
 };
 
 struct BundleStorageManagerSession_ReadFromDisk {
@@ -62,11 +90,13 @@ struct BundleStorageManagerSession_ReadFromDisk {
 
     uint32_t nextLogicalSegment;
     uint32_t nextLogicalSegmentToCache;
+    segment_id_extents_cursor_t nextSegmentCursor; //points to the segment Id of nextLogicalSegment
+    segment_id_extents_cursor_t nextSegmentToCacheCursor; //points to the segment Id of nextLogicalSegmentToCache
     uint32_t cacheReadIndex;
     uint32_t cacheWriteIndex;
 
     //std::unique_ptr<volatile uint8_t[]> readCache;
-    std::unique_ptr<uint8_t[]> readCache;// [READ_CACHE_NUM_SEGMENTS_PER_SESSION * SEGMENT_SIZE]; //may overflow stack, create on heap
+    std::unique_ptr<uint8_t[], boost::alignment::aligned_delete> readCache;// [READ_CACHE_NUM_SEGMENTS_PER_SESSION * SEGMENT_SIZE]; //may overflow stack, create on heap (SEGMENT_BUFFER_ALIGNMENT aligned)
     std::atomic<bool> readCacheIsSegmentReady[READ_CACHE_NUM_SEGMENTS_PER_SESSION];
 
     STORAGE_LIB_EXPORT BundleStorageManagerSession_ReadFromDisk();
@@ -97,12 +127,36 @@ public:
     STORAGE_LIB_EXPORT uint64_t PopTop(BundleStorageManagerSession_ReadFromDisk & session, const std::vector<cbhe_eid_t> & availableDestinationEids); //0 if empty, size if entry
     STORAGE_LIB_EXPORT uint64_t PopTop(BundleStorageManagerSession_ReadFromDisk & session, const std::vector<uint64_t> & availableDestNodeIds); //0 if empty, size if entry
     STORAGE_LIB_EXPORT uint64_t PopTop(BundleStorageManagerSession_ReadFromDisk & session, const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests); //0 if empty, size if entry
+    STORAGE_LIB_EXPORT uint64_t PopTop(BundleStorageManagerSession_ReadFromDisk & session, const uint64_t destinationGroupId); //0 if empty, size if entry
+    STORAGE_LIB_EXPORT uint64_t AddDestinationGroup(const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests); //returns destinationGroupId for PopTop
+    STORAGE_LIB_EXPORT bool RemoveDestinationGroup(const uint64_t destinationGroupId);
     STORAGE_LIB_EXPORT bool ReturnTop(BundleStorageManagerSession_ReadFromDisk & session);
     STORAGE_LIB_EXPORT bool ReturnCustodyIdToAwaitingSend(const uint64_t custodyId); //for expired custody timers
     STORAGE_LIB_EXPORT catalog_entry_t * GetCatalogEntryPtrFromCustodyId(const uint64_t custodyId); //for deletion of custody timer
     STORAGE_LIB_EXPORT std::size_t TopSegment(BundleStorageManagerSession_ReadFromDisk & session, void * buf);
     STORAGE_LIB_EXPORT bool ReadFirstSegment(BundleStorageManagerSession_ReadFromDisk & session, catalog_entry_t * enty, std::vector<uint8_t> & buf);
     STORAGE_LIB_EXPORT bool ReadAllSegments(BundleStorageManagerSession_ReadFromDisk & session, padded_vector_uint8_t& buf);
+    /**
+     * ReadAllSegments into a buffer of a ReleaseBufferPool, which can then be sent without copying.
+     * A bundle on disk is read by ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe, and a bundle in RAM is copied.
+     * @param session The caller's session, as returned by PopTop.
+     * @param releaseBuffer A buffer from ReleaseBufferPool::Acquire for at least the bundle's size, whose size is set to the bytes read.
+     * @return True if every byte of the bundle was read.
+     */
+    STORAGE_LIB_EXPORT bool ReadAllSegmentsIntoReleaseBuffer(BundleStorageManagerSession_ReadFromDisk & session, release_buffer_t & releaseBuffer);
+    /**
+     * Read a whole bundle from disk on a thread other than the one which pushes and pops bundles (i.e. a release worker).
+     * The disk threads read each segment straight into the release buffer (there is no read cache),
+     * and the segment headers are squeezed out in place as the reads complete.
+     * The catalog and the RAM hot tier are never touched, so session.catalogEntryPtr must point to a copy of the entry
+     * returned by PopTop, that bundle must not be in the RAM hot tier or a small bundle slab,
+     * and its segments must not be freed until this returns.
+     * Each calling thread must use its own session.
+     * @param session The caller's session, with catalogEntryPtr and custodyId set (the cursors are reset by this function).
+     * @param releaseBuffer A buffer from ReleaseBufferPool::Acquire for at least the bundle's size, whose size is set to the bytes read.
+     * @return True if every byte of the bundle was read.
+     */
+    STORAGE_LIB_EXPORT bool ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe(BundleStorageManagerSession_ReadFromDisk & session, release_buffer_t & releaseBuffer);
     STORAGE_LIB_EXPORT bool RemoveBundleFromDisk(const catalog_entry_t * catalogEntryPtr,const uint64_t custodyId);
     STORAGE_LIB_EXPORT bool RemoveBundleFromDisk(const uint64_t custodyId);
     STORAGE_LIB_EXPORT bool RemoveReadBundleFromDisk(const uint64_t custodyId);
@@ -123,11 +177,145 @@ public:
     STORAGE_LIB_EXPORT uint64_t GetUsedSpaceBytes() const noexcept;
     STORAGE_LIB_EXPORT uint64_t GetTotalCapacityBytes() const noexcept;
 
+    //RAM hot tier
+    /**
+     * Write to disk every bundle of the RAM hot tier which has been resident for at least ramHotTierMaxResidentMilliseconds.
+     * Must be called periodically from the thread which pushes and reads bundles.
+     * @param nowPtime The current time.
+     * @return The number of bundles written to disk.
+     */
+    STORAGE_LIB_EXPORT std::size_t FlushRamHotTier(const boost::posix_time::ptime & nowPtime);
+    /**
+     * Write to disk every bundle of the RAM hot tier regardless of age (i.e. before shutting down).
+     * @return The number of bundles written to disk.
+     */
+    STORAGE_LIB_EXPORT std::size_t FlushAllOfRamHotTier();
+    STORAGE_LIB_EXPORT bool IsInRamHotTier(const catalog_entry_t * catalogEntryPtr) const;
+    STORAGE_LIB_EXPORT uint64_t GetRamHotTierBytes() const noexcept;
+    STORAGE_LIB_EXPORT std::size_t GetRamHotTierNumBundles() const noexcept;
+
+    //small bundle slabs
+    STORAGE_LIB_EXPORT std::size_t GetNumSmallBundleSlabs() const noexcept;
+    STORAGE_LIB_EXPORT static uint64_t GetSmallBundleSlabSlotSize(const unsigned int sizeClassIndex) noexcept;
+    STORAGE_LIB_EXPORT static unsigned int GetSmallBundleSlabNumSlots(const unsigned int sizeClassIndex) noexcept;
+    STORAGE_LIB_EXPORT static uint64_t GetSmallBundleSlabMaxBundleSizeBytes() noexcept; //largest bundle that fits in a slab slot
+    /**
+     * Write every dirty small bundle slab to its disk if the first of them became dirty at least
+     * SMALL_BUNDLE_SLAB_FLUSH_DELAY_MILLISECONDS ago.  Must be called periodically from the thread which pushes and removes bundles.
+     * @param nowPtime The current time.
+     * @return The number of slab segments written.
+     */
+    STORAGE_LIB_EXPORT std::size_t FlushSmallBundleSlabs(const boost::posix_time::ptime & nowPtime);
+    /**
+     * Write every dirty small bundle slab to its disk regardless of age (i.e. before shutting down).
+     * @return The number of slab segments written.
+     */
+    STORAGE_LIB_EXPORT std::size_t FlushAllSmallBundleSlabs();
+
+    //disk space reclaimer (all 0 if not running)
+    STORAGE_LIB_EXPORT uint64_t GetTotalBytesReclaimedFromDisk() const noexcept;
+    STORAGE_LIB_EXPORT uint64_t GetTotalDiskSpaceReclaimOperations() const noexcept;
+    STORAGE_LIB_EXPORT uint64_t GetTotalBytesFreedWithoutReclaiming() const noexcept;
+    /// Block until the segments of every bundle removed so far have been reclaimed and freed (returns immediately if not running).
+    STORAGE_LIB_EXPORT void WaitUntilRemovedSegmentsFreed();
+
+    //adaptive disk striping
+    /**
+     * Called by a file backed implementation's disk thread (or completion handler) for every completed disk I/O.
+     * @param diskId The disk of the I/O.
+     * @param bytesTransferred The bytes read or written.
+     * @param busyMicroseconds The time the disk was busy with the I/O (0 if accounted for by a later call).
+     */
+    STORAGE_LIB_EXPORT void RecordDiskOperationCompleted(const unsigned int diskId, const uint64_t bytesTransferred, const uint64_t busyMicroseconds) noexcept;
+    /// @return Each disk's throughput in bytes per second of busy time, as of the last measurement interval (0 if never measured).
+    STORAGE_LIB_EXPORT std::vector<uint64_t> GetDiskThroughputBytesPerSecond();
+    /// @return Bit diskId set for every disk that new bundles are currently allowed to use (all disks unless adaptiveDiskStriping).
+    STORAGE_LIB_EXPORT uint64_t GetAdaptiveStripingAllowedDisksMask();
+
+    //raw block devices as storage disks
+    /**
+     * Find whether a storeFilePath is a raw block device (or partition) and, if so, probe its size with the BLKGETSIZE64 ioctl.
+     * @param storeFilePath The path of the store file or block device (which need not exist yet if it is a store file).
+     * @param blockDeviceSizeBytes Set to the size of the block device, or 0 if the path is not a block device.
+     * @return false (with the reason logged) if the path is a block device whose size could not be probed,
+     * including on platforms other than Linux.
+     */
+    STORAGE_LIB_EXPORT static bool GetBlockDeviceSizeBytes(const boost::filesystem::path & storeFilePath, uint64_t & blockDeviceSizeBytes);
+    STORAGE_LIB_EXPORT bool IsBlockDevice(const unsigned int diskId) const noexcept;
+    /// @return true if the disk is configured with useDirectIo and was opened with O_DIRECT (false if Start() failed or was not called).
+    STORAGE_LIB_EXPORT bool IsDirectIoActive(const unsigned int diskId) const noexcept;
+    /// @return false if catalogJournalFilePath is empty or the catalog journal disabled itself after a failure.
+    STORAGE_LIB_EXPORT bool IsCatalogJournalEnabled() const noexcept;
+    /// The bytes of each disk's store file or block device used by the storage (the capacity of its share of the segments).
+    STORAGE_LIB_EXPORT uint64_t GetPerDiskCapacityBytes() const noexcept;
+    /// @return false if the storage config was missing or its disks were unusable (e.g. a block device too small), in which case Start() does nothing.
+    STORAGE_LIB_EXPORT bool HasValidStorageConfig() const noexcept;
+
 
 protected:
 
     
     virtual void CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int diskId) = 0;
+    /**
+     * The memory holding a segment, for an implementation whose "disks" are directly addressable (BundleStorageManagerRam),
+     * so that the segment is written and read in place with a single copy instead of through its disk's circular buffer.
+     * @return NULL (the default, for the file backed implementations) if the segment must be queued to its disk.
+     */
+    STORAGE_LIB_EXPORT virtual uint8_t * GetSegmentMemoryPtr(const segment_id_t segmentId) noexcept;
+    STORAGE_LIB_NO_EXPORT void WriteSegmentToDisk(const segment_id_t segmentId, const segment_id_t nextSegmentId,
+        const bool isFirstLogicalSegment, const catalog_entry_t & catalogEntry, const uint64_t custodyId, const uint8_t * buf, std::size_t size);
+    STORAGE_LIB_NO_EXPORT uint64_t PushAllSegmentsToRamHotTier(BundleStorageManagerSession_WriteToDisk & session,
+        const PrimaryBlock & bundlePrimaryBlock, const uint64_t custodyId, const uint8_t * allData, const std::size_t allDataSize);
+    STORAGE_LIB_NO_EXPORT bool FlushFrontOfRamHotTierFifo(); //fifo must not be empty
+    /// Snapshot the catalog entries already journaled (all but those in the RAM hot tier) and restart the catalog journal.
+    STORAGE_LIB_NO_EXPORT bool WriteCatalogSnapshotAndRestartJournal();
+    STORAGE_LIB_NO_EXPORT std::size_t TopSegmentFromDisk(BundleStorageManagerSession_ReadFromDisk & session, void * buf);
+    /// Queue the read of a whole segment (SEGMENT_SIZE bytes) to segmentBuf on its disk, which sets *isReadCompletedPtr once done.
+    STORAGE_LIB_NO_EXPORT void QueueSegmentReadFromDisk(const segment_id_t segmentId, uint8_t * segmentBuf, std::atomic<bool> * isReadCompletedPtr);
+    STORAGE_LIB_NO_EXPORT void WaitForSegmentReadFromDisk(std::atomic<bool> & readIsReadyRef);
+    /// Verify the header of the session's next logical segment and advance the session past it.  Returns its payload size.
+    STORAGE_LIB_NO_EXPORT std::size_t CheckSegmentReadFromDisk(BundleStorageManagerSession_ReadFromDisk & session, const uint8_t * segmentBuf);
+    STORAGE_LIB_NO_EXPORT bool AllocateSmallBundleSlabSlot(const uint64_t bundleSizeBytes, catalog_entry_t & catalogEntry);
+    STORAGE_LIB_NO_EXPORT void WriteBundleToSmallBundleSlab(const catalog_entry_t & catalogEntry, const uint64_t custodyId, const uint8_t * buf, std::size_t size);
+    STORAGE_LIB_NO_EXPORT std::size_t ReadBundleFromSmallBundleSlab(BundleStorageManagerSession_ReadFromDisk & session, void * buf);
+    STORAGE_LIB_NO_EXPORT bool FreeSmallBundleSlabSlot(const catalog_entry_t & catalogEntry);
+    STORAGE_LIB_NO_EXPORT void WriteSmallBundleSlabToDisk(const segment_id_t segmentId, const uint8_t * segmentImage);
+    /// Mark a slab changed at [offset, offset + length) of its mirror, or for RAM storage copy just those bytes in place.
+    STORAGE_LIB_NO_EXPORT void MarkSmallBundleSlabDirty(const segment_id_t slabSegmentId, const std::size_t offset, const std::size_t length);
+    STORAGE_LIB_NO_EXPORT void RestoreSmallBundleSlabs();
+    STORAGE_LIB_NO_EXPORT void DropUnwrittenBundlesFromCatalogJournalRestore();
+    /// Allocate a new bundle's segments, steering them away from the slower disks if adaptiveDiskStriping.
+    STORAGE_LIB_NO_EXPORT bool AllocateBundleSegmentExtents(const uint64_t numSegments, segment_id_extents_vec_t & extentsVec);
+    STORAGE_LIB_NO_EXPORT void UpdateDiskThroughputIfDue_NotThreadSafe(const boost::posix_time::ptime & nowPtime);
+    STORAGE_LIB_NO_EXPORT uint64_t GetAdaptiveStripingAllowedDisksMask_NotThreadSafe() const;
+    /// Probe every disk configured as a block device and verify that it can hold its share of the segments.
+    STORAGE_LIB_NO_EXPORT bool ProbeBlockDevices();
+    /// Zero the used range of a block device when not restored, since unlike a truncated store file it still holds old segments.
+    STORAGE_LIB_NO_EXPORT bool ZeroBlockDevice(const unsigned int diskId);
+    /// Start the DiskSpaceReclaimer if the config enables it (called at the end of a file backed implementation's Start()).
+    STORAGE_LIB_EXPORT void StartDiskSpaceReclaimer();
+    /// Free the segments of a removed bundle, or queue them to the DiskSpaceReclaimer if it is running.
+    STORAGE_LIB_NO_EXPORT bool FreeRemovedSegmentExtents(const segment_id_extents_vec_t & extentsVec);
+    STORAGE_LIB_NO_EXPORT uint64_t GetNumAllocatedSegments() const noexcept;
+    /**
+     * Called by a disk's consumer to find how many of its queued segment operations, starting at consumeIndex,
+     * can be merged into one vectored read or write: all of them must be the same direction (read or write) and
+     * their segment Ids must be adjacent on the disk (each one M_NUM_STORAGE_DISKS greater than the previous).
+     * @param diskId The disk whose circular buffer is being consumed.
+     * @param consumeIndex The disk's current read index (which must not be CIRCULAR_INDEX_BUFFER_EMPTY).
+     * @return The number of operations (1 to M_MAX_SEGMENTS_PER_DISK_IO) to perform in one I/O.
+     */
+    STORAGE_LIB_EXPORT unsigned int GetNumCoalescableDiskOperations(const unsigned int diskId, const unsigned int consumeIndex) const;
+#ifndef _WIN32
+    /**
+     * Open (or create if not restored from disk) the store file of the given disk for reading and writing,
+     * with O_DIRECT if that disk is configured with useDirectIo.  There is no fallback to buffered I/O:
+     * if the file system rejects O_DIRECT the open fails, so that Start() fails rather than silently losing direct I/O.
+     * @param diskId The index of the disk within the storage config's storageDiskConfigVector.
+     * @return The file descriptor, or -1 (with the reason logged) if the file could not be opened.
+     */
+    STORAGE_LIB_EXPORT int OpenStorageDiskFile(const unsigned int diskId);
+#endif
 
 protected:
     StorageConfig_ptr m_storageConfigPtr;
@@ -135,14 +323,20 @@ public:
     const unsigned int M_NUM_STORAGE_DISKS;
     const uint64_t M_TOTAL_STORAGE_CAPACITY_BYTES; //old FILE_SIZE
     const uint64_t M_MAX_SEGMENTS;
+    const unsigned int M_MAX_SEGMENTS_PER_DISK_IO; //from maxCoalescedDiskIoSizeBytes, at most CIRCULAR_INDEX_BUFFER_SIZE
 protected:
     MemoryManagerTreeArray m_memoryManager;
     BundleStorageCatalog m_bundleStorageCatalog;
     boost::mutex m_mutexMainThread;
     boost::condition_variable m_conditionVariableMainThread;
     std::vector<boost::filesystem::path> m_filePathsVec;
+    std::vector<uint64_t> m_blockDeviceSizeBytesVec; //per disk, 0 if the disk is a store file
+    std::vector<uint8_t> m_directIoActiveVec; //per disk, set by OpenStorageDiskFile
     std::vector<unsigned int> m_tmpInitializerOfCircularIndexBuffersVec;
     std::vector<CircularIndexBufferSingleProducerSingleConsumerConfigurable> m_circularIndexBuffersVec;
+    //Serializes the producers of each disk's circular buffer (the thread which pushes and pops bundles plus any
+    //ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe callers) from GetIndexForWrite through CommitWrite.
+    std::vector<boost::mutex> m_diskProducerMutexesVec;
 
     uint8_t * m_circularBufferBlockDataPtr;
     segment_id_t * m_circularBufferSegmentIdsPtr;
@@ -151,12 +345,69 @@ protected:
     std::atomic<std::atomic<bool>* > m_circularBufferIsReadCompletedPointers[CIRCULAR_INDEX_BUFFER_SIZE * MAX_NUM_STORAGE_THREADS];
     std::atomic<uint8_t*> m_circularBufferReadFromStoragePointers[CIRCULAR_INDEX_BUFFER_SIZE * MAX_NUM_STORAGE_THREADS];
     std::atomic<bool> m_autoDeleteFilesOnExit;
+    std::unique_ptr<BundleStorageCatalogJournal> m_catalogJournalPtr; //NULL if catalogJournalFilePath is empty
+
+    struct ram_hot_tier_bundle_t {
+        uint64_t custodyId;
+        uint64_t sequence; //identifies its record in m_ramHotTierFifo
+        padded_vector_uint8_t bundleData;
+    };
+    struct ram_hot_tier_fifo_record_t {
+        const catalog_entry_t * catalogEntryPtr;
+        uint64_t sequence;
+        boost::posix_time::ptime writeToDiskTime;
+    };
+    typedef std::map<const catalog_entry_t *, ram_hot_tier_bundle_t> ram_hot_tier_map_t;
+    const uint64_t M_RAM_HOT_TIER_MAX_BYTES; //0 if disabled
+    const boost::posix_time::time_duration M_RAM_HOT_TIER_MAX_RESIDENT_TIME;
+    const bool M_RAM_HOT_TIER_WRITE_CUSTODY_BUNDLES_IMMEDIATELY;
+    ram_hot_tier_map_t m_ramHotTierMap; //keyed by the bundle's (stable) catalog entry pointer
+    std::deque<ram_hot_tier_fifo_record_t> m_ramHotTierFifo; //oldest first, records of bundles no longer in the map are skipped
+    uint64_t m_ramHotTierBytes;
+    uint64_t m_ramHotTierNextSequence;
+
+    struct small_bundle_slab_t {
+        unsigned int sizeClassIndex;
+        uint64_t usedSlotsMask; //bit i set if slot i holds a bundle (or is reserved for one by Push)
+        std::unique_ptr<uint8_t[]> segmentImage; //SEGMENT_SIZE bytes, the slab segment as it is (or will be) on disk
+        bool isOnDisk; //written to its disk at least once (a slab freed before then leaves nothing to destroy on the disk)
+    };
+    typedef std::map<segment_id_t, small_bundle_slab_t> small_bundle_slab_map_t;
+    const uint64_t M_SMALL_BUNDLE_SLAB_MAX_SEGMENTS; //0 if disabled
+    small_bundle_slab_map_t m_smallBundleSlabsMap; //keyed by slab segment id
+    //per size class, the slabs with a free slot (lowest segment id filled first)
+    std::array<std::set<segment_id_t>, SMALL_BUNDLE_SLAB_NUM_SIZE_CLASSES> m_smallBundleSlabsWithFreeSlotsSets;
+    std::set<segment_id_t> m_dirtySmallBundleSlabsSet; //slabs whose mirror is newer than the disk (ascending, so adjacent slabs coalesce)
+    boost::posix_time::ptime m_smallBundleSlabsFlushTime; //when the dirty slabs are due to be written (not_a_date_time if none)
+
+    std::unique_ptr<DiskSpaceReclaimer> m_diskSpaceReclaimerPtr; //NULL if diskSpaceReclaimMaxBytesPerSecond is 0 or not started
+
+    struct disk_throughput_counters_t {
+        disk_throughput_counters_t() : bytesTransferred(0), busyMicroseconds(0) {}
+        std::atomic<uint64_t> bytesTransferred;
+        std::atomic<uint64_t> busyMicroseconds;
+    };
+    const bool M_ADAPTIVE_DISK_STRIPING;
+    std::vector<disk_throughput_counters_t> m_diskThroughputCountersVec; //per disk, added to by the disk threads
+    boost::mutex m_diskStripingMutex; //protects the members below
+    boost::posix_time::ptime m_nextDiskThroughputUpdateTime; //not_a_date_time until the first measurement
+    std::vector<uint64_t> m_lastDiskBytesTransferredVec;
+    std::vector<uint64_t> m_lastDiskBusyMicrosecondsVec;
+    std::vector<uint64_t> m_diskThroughputBytesPerSecondVec; //0 until measured
+    std::vector<double> m_diskStripingLoadsVec; //segments given to each disk scaled by the disk's slowness, relative to the least loaded disk
+    bool m_simulateFileSystemRejectsDirectIo; //test hook (set by a derived test class), OpenStorageDiskFile behaves as if every file system rejects O_DIRECT
     
 public:
     bool m_successfullyRestoredFromDisk;
+    bool m_successfullyRestoredFromCatalogJournal; //restored without scanning the disks
     uint64_t m_totalBundlesRestored;
     uint64_t m_totalBytesRestored;
     uint64_t m_totalSegmentsRestored;
+    uint64_t m_totalBundlesWrittenFromRamHotTier;
+    uint64_t m_totalBundlesRemovedFromRamHotTier; //removed before ever being written to disk
+    uint64_t m_totalSmallBundleSlabSegmentsWritten;
+    uint64_t m_totalSmallBundlesDroppedFromRestore; //in the catalog but missing from their slab slot on the disk (e.g. journaled but never written)
+    uint64_t m_totalUnwrittenBundlesDroppedFromRestore; //journaled but whose first or last segment never reached the disk
 };
 
 
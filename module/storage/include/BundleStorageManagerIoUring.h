@@ -0,0 +1,64 @@
+/**
+ * @file BundleStorageManagerIoUring.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This BundleStorageManagerIoUring class inherits from the BundleStorageManagerBase class and implements
+ * writing and reading bundles to and from solid state disk drive(s) using 1 thread regardless of number of drives
+ * and the Linux io_uring interface.  All segment operations queued in every disk's circular buffer are submitted
+ * to the kernel as one batch per io_uring_enter system call, with the disk files registered (fixed files)
+ * and the write circular buffers registered (fixed buffers), so that a single core can keep multiple
+ * NVMe queues busy.  This class is only available on Linux when built with ENABLE_STORAGE_IO_URING.
+ */
+
+#ifndef _BUNDLE_STORAGE_MANAGER_IO_URING_H
+#define _BUNDLE_STORAGE_MANAGER_IO_URING_H 1
+
+#include "BundleStorageManagerBase.h"
+#include <atomic>
+#include <memory>
+
+
+class CLASS_VISIBILITY_STORAGE_LIB BundleStorageManagerIoUring : public BundleStorageManagerBase {
+public:
+    STORAGE_LIB_EXPORT BundleStorageManagerIoUring();
+    STORAGE_LIB_EXPORT BundleStorageManagerIoUring(const boost::filesystem::path& jsonConfigFilePath);
+    STORAGE_LIB_EXPORT BundleStorageManagerIoUring(const StorageConfig_ptr & storageConfigPtr);
+    STORAGE_LIB_EXPORT virtual ~BundleStorageManagerIoUring() override;
+    STORAGE_LIB_EXPORT virtual void Start() override;
+
+
+private:
+    STORAGE_LIB_NO_EXPORT bool OpenFilesAndSetupRing();
+    STORAGE_LIB_NO_EXPORT void StopThread();
+    STORAGE_LIB_NO_EXPORT void ThreadFunc();
+    STORAGE_LIB_NO_EXPORT unsigned int QueueNewDiskOperations_NotThreadSafe();
+    STORAGE_LIB_NO_EXPORT void ReapCompletedDiskOperations_NotThreadSafe();
+    STORAGE_LIB_NO_EXPORT bool HasUnqueuedDiskOperations_NotThreadSafe() const;
+    STORAGE_LIB_NO_EXPORT virtual void CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int diskId) override;
+
+private:
+    // Internal implementation class (hides the Linux io_uring ring structures)
+    struct Impl;
+    // Pointer to the internal implementation
+    std::unique_ptr<Impl> m_pimpl;
+
+    boost::condition_variable m_conditionVariableIoUringThread;
+    boost::mutex m_mutexIoUringThread;
+    std::unique_ptr<boost::thread> m_threadPtr;
+
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_noFatalErrorsOccurred;
+};
+
+
+#endif //_BUNDLE_STORAGE_MANAGER_IO_URING_H
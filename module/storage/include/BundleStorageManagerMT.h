@@ -15,7 +15,9 @@
  *
  * This BundleStorageManagerMT class inherits from the BundleStorageManagerBase class and implements
  * writing and reading bundles to and from solid state disk drive(s) using 1 thread per disk drive (i.e. 1 thread per storeFilePath)
- * and uses cross-platform blocking synchronous I/O operations from stdio.h such as fwrite.
+ * and uses blocking synchronous I/O operations.  Queued operations on adjacent segments of a disk are merged
+ * (up to maxCoalescedDiskIoSizeBytes) into a single preadv/pwritev call, or on Windows into one seek followed by stdio.h fread/fwrite calls.
+ * Disks configured with useDirectIo are opened with O_DIRECT (not supported on Windows).
  */
 
 #ifndef _BUNDLE_STORAGE_MANAGER_MT_H
@@ -45,6 +47,7 @@ private:
     //CircularIndexBufferSingleProducerSingleConsumer m_circularIndexBuffers[NUM_STORAGE_THREADS];
     std::vector<std::pair<boost::condition_variable, boost::mutex> > m_conditionVariablesPlusMutexesVec;
     std::vector<std::unique_ptr<boost::thread> > m_threadPtrsVec;
+    std::vector<int> m_directIoFileDescriptorsVec; //-1 for disks not configured with useDirectIo
 
     std::atomic<bool> m_running;
     std::atomic<bool> m_noFatalErrorsOccurred;
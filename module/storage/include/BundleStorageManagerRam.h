@@ -0,0 +1,57 @@
+/**
+ * @file BundleStorageManagerRam.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This BundleStorageManagerRam class inherits from the BundleStorageManagerBase class and implements
+ * "writing" and "reading" bundles to and from anonymous memory regions, one per configured disk,
+ * instead of files.  The catalog, custody and expiry semantics are identical to the disk based
+ * implementations, but segments are written and read in place (see GetSegmentMemoryPtr), so each
+ * bundle is copied once into its region when stored and once out of it when read, and any segment
+ * operation still queued is a memcpy performed synchronously in the caller's thread.  No storage
+ * threads are created and nothing survives a restart
+ * (tryToRestoreFromDisk must be false).  The regions may optionally be backed by huge pages
+ * (ramStorageUseHugePages), falling back to normal pages if they cannot be reserved.
+ */
+
+#ifndef _BUNDLE_STORAGE_MANAGER_RAM_H
+#define _BUNDLE_STORAGE_MANAGER_RAM_H 1
+
+#include "BundleStorageManagerBase.h"
+#include <vector>
+
+
+class CLASS_VISIBILITY_STORAGE_LIB BundleStorageManagerRam : public BundleStorageManagerBase {
+public:
+    STORAGE_LIB_EXPORT BundleStorageManagerRam();
+    STORAGE_LIB_EXPORT BundleStorageManagerRam(const boost::filesystem::path& jsonConfigFilePath);
+    STORAGE_LIB_EXPORT BundleStorageManagerRam(const StorageConfig_ptr & storageConfigPtr);
+    STORAGE_LIB_EXPORT virtual ~BundleStorageManagerRam() override;
+    STORAGE_LIB_EXPORT virtual void Start() override;
+
+
+private:
+    STORAGE_LIB_NO_EXPORT bool AllocateRegions();
+    STORAGE_LIB_NO_EXPORT void FreeRegions();
+    STORAGE_LIB_NO_EXPORT virtual void CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int diskId) override;
+    STORAGE_LIB_NO_EXPORT virtual uint8_t * GetSegmentMemoryPtr(const segment_id_t segmentId) noexcept override;
+
+private:
+    /// Size in bytes of every disk's region (rounded up to a whole number of huge pages)
+    std::size_t m_regionSizeBytes;
+    /// One anonymous memory region per disk, indexed by diskId (NULL until Start())
+    std::vector<uint8_t*> m_regionsVec;
+    bool m_started;
+};
+
+
+#endif //_BUNDLE_STORAGE_MANAGER_RAM_H
@@ -28,7 +28,7 @@
 struct catalog_entry_t {
     uint64_t bundleSizeBytes;
     uint64_t payloadSizeBytes;
-    segment_id_chain_vec_t segmentIdChainVec;
+    segment_id_extents_vec_t segmentIdExtentsVec; //the bundle's segments in logical order, as runs of contiguous segment Ids (inline unless fragmented)
     cbhe_eid_t destEid;
     uint64_t encodedAbsExpirationAndCustodyAndPriority;
     uint64_t sequence;
@@ -49,7 +49,10 @@ struct catalog_entry_t {
     STORAGE_LIB_EXPORT bool HasCustodyAndFragmentation() const;
     STORAGE_LIB_EXPORT bool HasCustodyAndNonFragmentation() const;
     STORAGE_LIB_EXPORT bool HasCustody() const;
-    STORAGE_LIB_EXPORT void Init(const PrimaryBlock & primary, const uint64_t paramBundleSizeBytes, const uint64_t paramPayloadSizeBytes, const uint64_t paramNumSegmentsRequired, void * paramPtrUuidKeyInMap, cbhe_eid_t *bundleEidMaskPtr = NULL);
+    STORAGE_LIB_EXPORT uint64_t GetNumSegments() const; //1 for a bundle in a small bundle slab
+    STORAGE_LIB_EXPORT bool IsInSmallBundleSlab() const; //the only extent's beginSegmentId is the slab segment
+    STORAGE_LIB_EXPORT unsigned int GetSmallBundleSlabSlotIndex() const;
+    STORAGE_LIB_EXPORT void Init(const PrimaryBlock & primary, const uint64_t paramBundleSizeBytes, const uint64_t paramPayloadSizeBytes, void * paramPtrUuidKeyInMap, cbhe_eid_t *bundleEidMaskPtr = NULL);
 };
 
 #endif //_CATALOG_ENTRY_H
@@ -14,46 +14,97 @@
  * @section DESCRIPTION
  *
  * This CustodyTimers class defines methods for knowing when to retransmit a bundle from storage.
+ * Timers live in a pool of nodes which are linked into two intrusive lists at once: the fifo list of their
+ * final destination (for polling the destinations of the available links) and one slot of a hashed timing wheel
+ * of NUM_WHEEL_SLOTS slots (for polling any destination).  Each wheel slot covers a tick of 1/512th of the
+ * custody timeout (at least 1 millisecond), so a timer is placed in the slot of its expiration tick and
+ * almost every slot holds only the timers of its current rotation.  Custody ids and destinations are found
+ * through HashMapRobinHood maps, so starting and cancelling a timer are O(1), and popping the expired
+ * timers only visits the slots the wheel has advanced through since the previous poll.
  */
 
 #ifndef _CUSTODY_TIMERS_H
 #define _CUSTODY_TIMERS_H 1
 
 #include <cstdint>
-#include <map>
-#include <list>
-#include <utility>
+#include <vector>
 #include <string>
 #include "codec/bpv6.h"
 #include <boost/date_time.hpp>
+#include "HashMapRobinHood.h"
 #include "storage_lib_export.h"
 
 class CustodyTimers {
 private:
     CustodyTimers();
 public:
-    
+
     STORAGE_LIB_EXPORT CustodyTimers(const boost::posix_time::time_duration & timeout);
     STORAGE_LIB_EXPORT ~CustodyTimers();
 
     STORAGE_LIB_EXPORT bool PollOneAndPopExpiredCustodyTimer(uint64_t & custodyId, const std::vector<cbhe_eid_t> & availableDestEids, const boost::posix_time::ptime & nowPtime);
     STORAGE_LIB_EXPORT bool PollOneAndPopAnyExpiredCustodyTimer(uint64_t & custodyId, const boost::posix_time::ptime & nowPtime);
+    /**
+     * Pop every expired timer of the given destinations in one pass.
+     * @param expiredCustodyIds The custody ids of the popped timers are appended to this (each destination's in fifo order).
+     * @return The number of custody ids appended.
+     */
+    STORAGE_LIB_EXPORT std::size_t PopAllExpiredCustodyTimers(std::vector<uint64_t> & expiredCustodyIds, const std::vector<cbhe_eid_t> & availableDestEids, const boost::posix_time::ptime & nowPtime);
+    /**
+     * Pop every expired timer of any destination in one pass.
+     * @param expiredCustodyIds The custody ids of the popped timers are appended to this (unordered).
+     * @return The number of custody ids appended.
+     */
+    STORAGE_LIB_EXPORT std::size_t PopAllAnyExpiredCustodyTimers(std::vector<uint64_t> & expiredCustodyIds, const boost::posix_time::ptime & nowPtime);
     STORAGE_LIB_EXPORT bool StartCustodyTransferTimer(const cbhe_eid_t & finalDestEid, const uint64_t custodyId);
     STORAGE_LIB_EXPORT bool CancelCustodyTransferTimer(const cbhe_eid_t & finalDestEid, const uint64_t custodyId);
     STORAGE_LIB_EXPORT std::size_t GetNumCustodyTransferTimers();
     STORAGE_LIB_EXPORT std::size_t GetNumCustodyTransferTimers(const cbhe_eid_t & finalDestEid);
 
 protected:
-    typedef std::pair<uint64_t, boost::posix_time::ptime> custid_ptime_pair_t;
-    typedef std::list<custid_ptime_pair_t> custid_ptime_list_t;
-    typedef std::map<uint64_t, custid_ptime_list_t::iterator> custid_to_listiterator_map_t;
-    typedef std::pair<uint64_t, custid_ptime_list_t::iterator> custid_to_listiterator_map_insertion_element_t;
-    typedef std::map<cbhe_eid_t, custid_ptime_list_t> desteid_to_custidexpirylist_map_t;
+    static constexpr uint32_t NULL_NODE_INDEX = UINT32_MAX;
+    static constexpr uint32_t NUM_WHEEL_SLOTS = 1024; //power of 2
+    static constexpr uint64_t NUM_TICKS_PER_TIMEOUT = 512;
+
+    struct timer_node_t {
+        uint64_t custodyId;
+        uint64_t expiryMicroseconds; //since M_EPOCH_PTIME
+        uint32_t destIndex;
+        uint32_t slotIndex;
+        uint32_t prevInSlot;
+        uint32_t nextInSlot; //also the free list link
+        uint32_t prevInDest;
+        uint32_t nextInDest;
+    };
+    struct timer_list_t {
+        timer_list_t() : head(NULL_NODE_INDEX), tail(NULL_NODE_INDEX) {}
+        uint32_t head;
+        uint32_t tail;
+    };
+    struct destination_t {
+        destination_t(const cbhe_eid_t & eid) : finalDestEid(eid), numTimers(0) {}
+        cbhe_eid_t finalDestEid;
+        timer_list_t timerList; //fifo (expirations are always appended in increasing order)
+        std::size_t numTimers;
+    };
 
-    desteid_to_custidexpirylist_map_t m_mapDestEidToCustodyIdExpiryList;
-    custid_to_listiterator_map_t m_mapCustodyIdToListIterator;
+    STORAGE_LIB_NO_EXPORT uint64_t GetMicrosecondsSinceEpoch(const boost::posix_time::ptime & ptime) const;
+    STORAGE_LIB_NO_EXPORT std::size_t PopExpiredFromWheel(std::vector<uint64_t> & expiredCustodyIds, const uint64_t nowMicroseconds, const std::size_t maxToPop);
+    STORAGE_LIB_NO_EXPORT void UnlinkAndFreeNode(const uint32_t nodeIndex); //does not remove the custody id from m_mapCustodyIdToNodeIndex
 
     const boost::posix_time::time_duration M_CUSTODY_TIMEOUT_DURATION;
+    const boost::posix_time::ptime M_EPOCH_PTIME;
+    const uint64_t M_TICK_MICROSECONDS;
+
+    std::vector<timer_node_t> m_nodes;
+    uint32_t m_freeNodesHead;
+    std::vector<timer_list_t> m_wheelSlots;
+    uint64_t m_wheelCursorTick; //every timer placed in a tick before this has been popped
+    std::vector<destination_t> m_destinations; //never removed
+    HashMapRobinHood<cbhe_eid_t, uint32_t> m_mapDestEidToDestIndex;
+    HashMapRobinHood<uint64_t, uint32_t> m_mapCustodyIdToNodeIndex;
+    std::size_t m_numTimers;
+    std::vector<uint64_t> m_pollOneCustodyIds; //reused by PollOneAndPopAnyExpiredCustodyTimer
 };
 
 
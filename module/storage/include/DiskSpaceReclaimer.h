@@ -0,0 +1,106 @@
+/**
+ * @file DiskSpaceReclaimer.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This DiskSpaceReclaimer class hands the blocks of freed storage segments back to the disks so that an SSD
+ * learns the space is free.  The storage thread queues the segment extents of each removed bundle instead of
+ * freeing them in the MemoryManagerTreeArray, and a background thread wakes every DISK_SPACE_RECLAIM_INTERVAL_MILLISECONDS
+ * (or sooner once DISK_SPACE_RECLAIM_BATCH_SEGMENTS are queued), merges the queued segments of each disk into runs
+ * of contiguous blocks, and reclaims each run with one fallocate(FALLOC_FL_PUNCH_HOLE) on a store file
+ * (or one BLKDISCARD ioctl on a block device).  Only then are the segments freed in the MemoryManagerTreeArray,
+ * so a segment can never be reallocated and rewritten while its hole is being punched.  Runs are reclaimed at no more
+ * than the configured bytes per second; a run over that budget is freed without being reclaimed.
+ * Reclaiming is only supported on Linux.
+ */
+
+#ifndef _DISK_SPACE_RECLAIMER_H
+#define _DISK_SPACE_RECLAIMER_H 1
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <boost/thread.hpp>
+#include <boost/filesystem/path.hpp>
+#include "MemoryManagerTreeArray.h"
+#include "TokenRateLimiter.h"
+#include "storage_lib_export.h"
+
+class DiskSpaceReclaimer {
+public:
+    /**
+     * Start the reclaimer thread.
+     * @param filePathsVec The store file (or block device) path of every disk, indexed by diskId.
+     * @param maxBytesPerSecond The maximum rate at which freed segments are reclaimed.
+     * @param memoryManager The memory manager in which reclaimed segments are freed (must outlive this).
+     */
+    STORAGE_LIB_EXPORT DiskSpaceReclaimer(const std::vector<boost::filesystem::path> & filePathsVec,
+        const uint64_t maxBytesPerSecond, MemoryManagerTreeArray & memoryManager);
+    /// Reclaims and frees whatever is still queued, then stops the thread.
+    STORAGE_LIB_EXPORT ~DiskSpaceReclaimer();
+
+    /**
+     * Queue the extents of segments which are no longer used (called instead of MemoryManagerTreeArray::FreeSegmentExtents_ThreadSafe).
+     * The segments remain allocated until the reclaimer thread has reclaimed them.
+     * @param extentsVec The extents to reclaim and then free.
+     */
+    STORAGE_LIB_EXPORT void QueueFreedSegmentExtents(const segment_id_extents_vec_t & extentsVec);
+    /// Block until every extent queued before this call has been reclaimed (or skipped) and freed.
+    STORAGE_LIB_EXPORT void WaitUntilQueuedExtentsFreed();
+
+    STORAGE_LIB_EXPORT uint64_t GetTotalBytesReclaimed() const noexcept;
+    STORAGE_LIB_EXPORT uint64_t GetTotalReclaimOperations() const noexcept;
+    STORAGE_LIB_EXPORT uint64_t GetTotalBytesFreedWithoutReclaiming() const noexcept; //over the rate limit or unsupported by the disk
+
+private:
+    /// A run of contiguous segments on one disk (local segment index = segmentId / numDisks)
+    struct disk_run_t {
+        uint64_t beginLocalSegmentIndex;
+        uint64_t endLocalSegmentIndex; //exclusive
+        bool operator<(const disk_run_t & o) const noexcept {
+            return beginLocalSegmentIndex < o.beginLocalSegmentIndex;
+        }
+    };
+
+    STORAGE_LIB_NO_EXPORT void ThreadFunc();
+    STORAGE_LIB_NO_EXPORT void ReclaimAndFreeBatch(const segment_id_extents_vec_t & batch);
+    STORAGE_LIB_NO_EXPORT bool ReclaimRun(const unsigned int diskId, const disk_run_t & run);
+
+    const std::vector<boost::filesystem::path> m_filePathsVec;
+    const unsigned int M_NUM_DISKS;
+    MemoryManagerTreeArray & m_memoryManager;
+    TokenRateLimiter m_rateLimiter; //in bytes, only used by the reclaimer thread
+    boost::posix_time::ptime m_lastRateLimiterUpdate;
+    std::vector<int> m_fileDescriptorsVec; //opened by the reclaimer thread on first use, -1 if not open
+    std::vector<bool> m_isBlockDeviceVec;
+    std::vector<bool> m_isReclaimUnsupportedVec; //set once a disk rejects a hole punch or discard
+    std::vector<std::vector<disk_run_t> > m_diskRunsVecs; //per disk, reused by every batch
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_conditionVariable; //wakes the reclaimer thread
+    boost::condition_variable m_conditionVariableBatchDone; //wakes WaitUntilQueuedExtentsFreed
+    segment_id_extents_vec_t m_queuedExtentsVec; //mutex protected
+    uint64_t m_numQueuedSegments; //mutex protected, segments in m_queuedExtentsVec
+    uint64_t m_totalSegmentsQueued; //mutex protected
+    uint64_t m_totalSegmentsFreed; //mutex protected
+    bool m_freeQueuedExtentsNow; //mutex protected, set by WaitUntilQueuedExtentsFreed
+    bool m_running; //mutex protected
+    std::unique_ptr<boost::thread> m_threadPtr;
+
+    std::atomic<uint64_t> m_totalBytesReclaimed;
+    std::atomic<uint64_t> m_totalReclaimOperations;
+    std::atomic<uint64_t> m_totalBytesFreedWithoutReclaiming;
+};
+
+
+#endif //_DISK_SPACE_RECLAIMER_H
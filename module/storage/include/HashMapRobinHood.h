@@ -0,0 +1,104 @@
+/**
+ * @file HashMapRobinHood.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This templated HashMapRobinHood class is a resizable open addressing (Robin Hood, linear probing)
+ * hash map for storing unique information about bundles, replacing the chained HashMap16BitFixedSize.
+ * The probed array holds only the full 64-bit hash and a pointer to each key/value node, so a lookup
+ * usually touches one or two contiguous cache lines plus the one node whose hash matches.
+ * Nodes are never moved, so pointers returned by Insert and GetValuePtr stay valid until that key is removed
+ * (the catalog keeps such pointers).  When the load factor is exceeded, the array doubles in size and
+ * the entries of the old array are migrated a few slots at a time by subsequent inserts and removals,
+ * so no single operation rehashes the whole map.
+ */
+
+#ifndef _HASH_MAP_ROBIN_HOOD_H
+#define _HASH_MAP_ROBIN_HOOD_H 1
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include "codec/bpv6.h"
+#include "storage_lib_export.h"
+
+template <typename keyType, typename valueType>
+class HashMapRobinHood {
+public:
+    typedef std::pair<keyType, valueType> key_value_pair_t;
+
+    STORAGE_LIB_EXPORT HashMapRobinHood();
+    STORAGE_LIB_EXPORT ~HashMapRobinHood();
+    HashMapRobinHood(const HashMapRobinHood&) = delete;
+    HashMapRobinHood& operator=(const HashMapRobinHood&) = delete;
+
+    STORAGE_LIB_EXPORT static uint64_t GetHash(const cbhe_bundle_uuid_t & bundleUuid);
+    STORAGE_LIB_EXPORT static uint64_t GetHash(const cbhe_bundle_uuid_nofragment_t & bundleUuid);
+    STORAGE_LIB_EXPORT static uint64_t GetHash(const uint64_t key);
+    STORAGE_LIB_EXPORT static uint64_t GetHash(const cbhe_eid_t & eid);
+
+    //return ptr of inserted pair if inserted, NULL if already exists
+    STORAGE_LIB_EXPORT const key_value_pair_t * Insert(const keyType & key, const valueType & value);
+    STORAGE_LIB_EXPORT const key_value_pair_t * Insert(const keyType & key, valueType && value);
+
+    //return true if exists, false if key doesn't exist in the map
+    STORAGE_LIB_EXPORT bool GetValueAndRemove(const keyType & key, valueType & value);
+
+    //return ptr if exists, NULL if key doesn't exist in the map
+    STORAGE_LIB_EXPORT valueType * GetValuePtr(const keyType & key);
+
+    STORAGE_LIB_EXPORT std::size_t Size() const noexcept;
+    STORAGE_LIB_EXPORT std::size_t GetSlotCapacity() const noexcept;
+    STORAGE_LIB_EXPORT bool IsResizing() const noexcept;
+    STORAGE_LIB_EXPORT void Clear();
+
+    //call f(const key_value_pair_t &) for every pair in the map, unordered
+    template <typename Func>
+    void ForEach(Func && f) const {
+        ForEachInSlots(m_slots, f);
+        ForEachInSlots(m_oldSlots, f);
+    }
+
+private:
+    struct slot_t {
+        uint64_t hash; //0 => empty slot (every stored hash has SLOT_HASH_IN_USE_BIT set)
+        key_value_pair_t * nodePtr; //NULL with a non-zero hash => removed or migrated (only in the old slots)
+    };
+    typedef std::vector<slot_t> slots_t;
+
+    template <typename Func>
+    static void ForEachInSlots(const slots_t & slots, Func & f) {
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            if (slots[i].nodePtr) {
+                f(static_cast<const key_value_pair_t &>(*slots[i].nodePtr));
+            }
+        }
+    }
+
+    STORAGE_LIB_NO_EXPORT static uint64_t GetSlotHash(const keyType & key);
+    STORAGE_LIB_NO_EXPORT static std::size_t Find(const slots_t & slots, const uint64_t slotHash, const keyType & key);
+    STORAGE_LIB_NO_EXPORT static void InsertNode(slots_t & slots, uint64_t slotHash, key_value_pair_t * nodePtr);
+    STORAGE_LIB_NO_EXPORT static void EraseAndShiftBack(slots_t & slots, std::size_t index);
+    STORAGE_LIB_NO_EXPORT void Grow();
+    STORAGE_LIB_NO_EXPORT void MigrateOldSlots(std::size_t maxSlotsToMigrate);
+    STORAGE_LIB_NO_EXPORT void DeleteAllNodes();
+
+private:
+    slots_t m_slots; //power of 2 size
+    slots_t m_oldSlots; //non-empty only while resizing
+    std::size_t m_oldSlotsMigrateIndex;
+    std::size_t m_numInOldSlots;
+    std::size_t m_size;
+};
+
+
+#endif //_HASH_MAP_ROBIN_HOOD_H
@@ -0,0 +1,67 @@
+/**
+ * @file HierarchicalTimingWheel.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This HierarchicalTimingWheel class stores values (i.e. custody ids) keyed on an absolute expiration in seconds.
+ * The wheel has 11 levels of 64 slots, each level covering 6 more bits of the expiration, so any uint64_t expiration
+ * fits without an overflow list.  A value is placed in the level of the highest bit in which its expiration differs
+ * from the wheel's current time, so inserting is O(1), and a value is moved down a level (at most 10 times)
+ * only when the current time enters its slot.  A 64-bit occupancy mask per level lets PopExpired jump straight to
+ * the next non-empty slot, so advancing the wheel across long idle periods costs nothing per empty second.
+ * Values are never removed individually; callers validate popped values against their own data structures.
+ */
+
+#ifndef _HIERARCHICAL_TIMING_WHEEL_H
+#define _HIERARCHICAL_TIMING_WHEEL_H 1
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include "storage_lib_export.h"
+
+class HierarchicalTimingWheel {
+public:
+    STORAGE_LIB_EXPORT HierarchicalTimingWheel();
+    STORAGE_LIB_EXPORT ~HierarchicalTimingWheel();
+
+    //an expiration already passed by PopExpired is returned by the next call to PopExpired
+    STORAGE_LIB_EXPORT void Insert(const uint64_t expiration, const uint64_t value);
+
+    //append every value whose expiration is <= expiry to expiredValues (unordered) and remove them from the wheel
+    STORAGE_LIB_EXPORT void PopExpired(const uint64_t expiry, std::vector<uint64_t> & expiredValues);
+
+    STORAGE_LIB_EXPORT std::size_t Size() const noexcept;
+    STORAGE_LIB_EXPORT void Clear();
+
+private:
+    struct wheel_entry_t {
+        uint64_t expiration;
+        uint64_t value;
+    };
+    typedef std::vector<wheel_entry_t> slot_t;
+    static constexpr unsigned int BITS_PER_LEVEL = 6;
+    static constexpr unsigned int SLOTS_PER_LEVEL = 1U << BITS_PER_LEVEL;
+    static constexpr unsigned int NUM_LEVELS = 11; //66 bits >= 64
+
+    STORAGE_LIB_NO_EXPORT void Place(const wheel_entry_t & entry);
+    STORAGE_LIB_NO_EXPORT uint64_t GetSlotStartTime(const unsigned int level, const unsigned int slotIndex) const noexcept;
+
+    std::array<std::array<slot_t, SLOTS_PER_LEVEL>, NUM_LEVELS> m_levels;
+    std::array<uint64_t, NUM_LEVELS> m_occupiedSlotMasks;
+    std::vector<uint64_t> m_alreadyExpiredValues; //inserted with an expiration before m_currentTime
+    uint64_t m_currentTime; //every expiration < m_currentTime has been popped
+    std::size_t m_size;
+};
+
+
+#endif //_HIERARCHICAL_TIMING_WHEEL_H
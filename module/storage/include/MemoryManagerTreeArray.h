@@ -25,12 +25,132 @@
 #include "BundleStorageConfig.h"
 #include <boost/thread.hpp>
 #include <vector>
+#include <initializer_list>
 #include <boost/core/noncopyable.hpp>
 #include "storage_lib_export.h"
 
 
 typedef std::vector<segment_id_t> segment_id_chain_vec_t;
 
+/// A run of numerically contiguous segment Ids.  Since segments are striped round robin across the disks
+/// (diskId = segmentId % numDisks), an extent is also a contiguous byte range on every disk it touches.
+struct segment_id_extent_t {
+    segment_id_t beginSegmentId;
+    segment_id_t numSegments;
+
+    bool operator==(const segment_id_extent_t & o) const noexcept {
+        return (beginSegmentId == o.beginSegmentId) && (numSegments == o.numSegments);
+    }
+    bool operator!=(const segment_id_extent_t & o) const noexcept {
+        return !(*this == o);
+    }
+};
+
+/// A vector of segment_id_extent_t which keeps up to NUM_INLINE_EXTENTS extents inside itself and only spills to a
+/// heap array when a bundle's segments are fragmented into more extents.  It is the same size as a std::vector
+/// (24 bytes on 64-bit platforms), so a catalog entry of a bundle allocated as one or two runs of contiguous segments
+/// (nearly every bundle) needs no heap allocation of its own.
+class segment_id_extents_vec_t {
+public:
+    static constexpr uint32_t NUM_INLINE_EXTENTS = static_cast<uint32_t>((2 * sizeof(void*)) / sizeof(segment_id_extent_t));
+
+    segment_id_extents_vec_t() noexcept : m_size(0), m_capacity(NUM_INLINE_EXTENTS) {}
+    STORAGE_LIB_EXPORT segment_id_extents_vec_t(std::initializer_list<segment_id_extent_t> il);
+    STORAGE_LIB_EXPORT segment_id_extents_vec_t(const segment_id_extents_vec_t& o);
+    STORAGE_LIB_EXPORT segment_id_extents_vec_t(segment_id_extents_vec_t&& o) noexcept; //leaves o empty
+    ~segment_id_extents_vec_t() {
+        if (IsSpilled()) {
+            delete[] m_heapExtents;
+        }
+    }
+    STORAGE_LIB_EXPORT segment_id_extents_vec_t& operator=(const segment_id_extents_vec_t& o);
+    STORAGE_LIB_EXPORT segment_id_extents_vec_t& operator=(segment_id_extents_vec_t&& o) noexcept; //leaves o empty
+    STORAGE_LIB_EXPORT segment_id_extents_vec_t& operator=(std::initializer_list<segment_id_extent_t> il);
+    STORAGE_LIB_EXPORT bool operator==(const segment_id_extents_vec_t& o) const noexcept;
+    bool operator!=(const segment_id_extents_vec_t& o) const noexcept {
+        return !(*this == o);
+    }
+
+    std::size_t size() const noexcept { return m_size; }
+    std::size_t capacity() const noexcept { return m_capacity; }
+    bool empty() const noexcept { return (m_size == 0); }
+    segment_id_extent_t* data() noexcept { return (IsSpilled()) ? m_heapExtents : m_inlineExtents; }
+    const segment_id_extent_t* data() const noexcept { return (IsSpilled()) ? m_heapExtents : m_inlineExtents; }
+    segment_id_extent_t& operator[](const std::size_t i) noexcept { return data()[i]; }
+    const segment_id_extent_t& operator[](const std::size_t i) const noexcept { return data()[i]; }
+    segment_id_extent_t& back() noexcept { return data()[m_size - 1]; }
+    const segment_id_extent_t& back() const noexcept { return data()[m_size - 1]; }
+    segment_id_extent_t* begin() noexcept { return data(); }
+    segment_id_extent_t* end() noexcept { return data() + m_size; }
+    const segment_id_extent_t* begin() const noexcept { return data(); }
+    const segment_id_extent_t* end() const noexcept { return data() + m_size; }
+    const segment_id_extent_t* cbegin() const noexcept { return data(); }
+    const segment_id_extent_t* cend() const noexcept { return data() + m_size; }
+
+    void push_back(const segment_id_extent_t& extent) {
+        if (m_size == m_capacity) {
+            reserve(static_cast<std::size_t>(m_capacity) * 2);
+        }
+        data()[m_size++] = extent;
+    }
+    /// Resize to n extents, new extents are zeroed.  Never releases a spilled heap array (use ShrinkToFit).
+    STORAGE_LIB_EXPORT void resize(const std::size_t n);
+    STORAGE_LIB_EXPORT void reserve(const std::size_t n);
+    void clear() noexcept { m_size = 0; }
+    /// Move a spilled array back inline if it fits, or reallocate it to exactly size() extents.
+    STORAGE_LIB_EXPORT void ShrinkToFit();
+    /// @return The bytes of the spilled heap array (0 while the extents are stored inline).
+    std::size_t GetHeapBytes() const noexcept {
+        return (IsSpilled()) ? (m_capacity * sizeof(segment_id_extent_t)) : 0;
+    }
+
+private:
+    bool IsSpilled() const noexcept { return (m_capacity > NUM_INLINE_EXTENTS); }
+
+    uint32_t m_size;
+    uint32_t m_capacity; //NUM_INLINE_EXTENTS while stored inline
+    union {
+        segment_id_extent_t m_inlineExtents[NUM_INLINE_EXTENTS];
+        segment_id_extent_t* m_heapExtents;
+    };
+};
+
+/** Append a segment Id to the end of an extents vector, growing the last extent if the segment Id immediately follows it.
+ *
+ * @param extentsVec The extents vector to append to.
+ * @param segmentId The segment Id to append.
+ */
+static inline void AppendSegmentIdToExtents(segment_id_extents_vec_t & extentsVec, const segment_id_t segmentId) {
+    if ((!extentsVec.empty()) && ((extentsVec.back().beginSegmentId + extentsVec.back().numSegments) == segmentId)) {
+        ++extentsVec.back().numSegments;
+    }
+    else {
+        extentsVec.push_back(segment_id_extent_t{ segmentId, 1 });
+    }
+}
+
+/// Walks, in logical order, the segment Ids of a segment_id_extents_vec_t
+struct segment_id_extents_cursor_t {
+    std::size_t extentIndex;
+    segment_id_t offsetInExtent;
+
+    void Reset() noexcept {
+        extentIndex = 0;
+        offsetInExtent = 0;
+    }
+    /// @return The segment Id at the cursor, or SEGMENT_ID_LAST if the cursor is past the last extent.
+    segment_id_t Get(const segment_id_extents_vec_t & extentsVec) const noexcept {
+        return (extentIndex < extentsVec.size()) ? (extentsVec[extentIndex].beginSegmentId + offsetInExtent) : SEGMENT_ID_LAST;
+    }
+    /// Move the cursor to the next segment Id (the cursor must not be past the last extent).
+    void Advance(const segment_id_extents_vec_t & extentsVec) noexcept {
+        if (++offsetInExtent == extentsVec[extentIndex].numSegments) {
+            ++extentIndex;
+            offsetInExtent = 0;
+        }
+    }
+};
+
 typedef std::vector< std::vector<uint64_t> > memmanager_t;
 
 class MemoryManagerTreeArray : private boost::noncopyable {
@@ -65,6 +185,41 @@ public:
      */
     STORAGE_LIB_EXPORT bool FreeSegments_ThreadSafe(const segment_id_chain_vec_t & segmentVec);
 
+    /** Thread safe method to allocate the given number of segments as runs of contiguous segment Ids (extents).
+     * The first available free segment numbers are taken in numerical order (i.e. the same segment Ids that AllocateSegments_ThreadSafe would return),
+     * but each run of free segments is claimed a leaf uint64_t at a time, so the cost is roughly proportional to the number of extents
+     * rather than the number of segments.
+     *
+     * @param numSegments The number of segments to allocate.
+     * @param extentsVec The vector of extents to be filled (any prior contents are discarded).  Will be resized to zero on failure.
+     * @return True if all numSegments were allocated, or False otherwise.
+     * @post The internal data structures are updated if and only if the MemoryManagerTreeArray was able to allocate all numSegments.
+     */
+    STORAGE_LIB_EXPORT bool AllocateSegmentExtents_ThreadSafe(const uint64_t numSegments, segment_id_extents_vec_t & extentsVec);
+
+    /** Thread safe method to allocate the given number of segments, taking only segments that lie on the allowed disks
+     * (diskId = segmentId % numDisks) from the leaf uint64_t holding the first free segment and the
+     * ADAPTIVE_DISK_STRIPING_MAX_LEAVES_SCANNED leaf uint64_t after it.  Whatever cannot be found there is allocated
+     * from the first available free segments regardless of disk, so an allocation only fails when the MemoryManagerTreeArray is full.
+     *
+     * @param numSegments The number of segments to allocate.
+     * @param numDisks The number of disks the segments are striped across (at most 64).
+     * @param allowedDisksMask Bit diskId set if segments on that disk may be taken (all disks allowed behaves as AllocateSegmentExtents_ThreadSafe).
+     * @param extentsVec The vector of extents to be filled (any prior contents are discarded).  Will be resized to zero on failure.
+     * @return True if all numSegments were allocated, or False otherwise.
+     * @post The internal data structures are updated if and only if the MemoryManagerTreeArray was able to allocate all numSegments.
+     */
+    STORAGE_LIB_EXPORT bool AllocateSegmentExtentsOnDisks_ThreadSafe(const uint64_t numSegments, const unsigned int numDisks,
+        const uint64_t allowedDisksMask, segment_id_extents_vec_t & extentsVec);
+
+    /** Thread safe method to free a vector of extents.
+     *
+     * @param extentsVec The vector of extents to mark as free in the internal data structure.
+     * @return True if every segment of every extent was freed, or False otherwise.
+     * @post The internal data structures are updated for only the segment IDs that were allocated (now they are marked free).  Segments that were already free remain unchanged (with False returned).
+     */
+    STORAGE_LIB_EXPORT bool FreeSegmentExtents_ThreadSafe(const segment_id_extents_vec_t & extentsVec);
+
     /** Test if the specified segment is free.
      *
      * @param segmentId The segment to be tested.
@@ -136,6 +291,13 @@ private:
 
 
     STORAGE_LIB_NO_EXPORT bool GetAndSetFirstFreeSegmentId(const segment_id_t depthIndex, segment_id_t & segmentId);
+    STORAGE_LIB_NO_EXPORT uint64_t AllocateFreeSegmentsStartingAt_NotThreadSafe(segment_id_t segmentId, const uint64_t maxSegments);
+    STORAGE_LIB_NO_EXPORT bool AppendFirstFreeSegmentExtents_NotThreadSafe(uint64_t numSegments, segment_id_extents_vec_t & extentsVec);
+    STORAGE_LIB_NO_EXPORT uint64_t AppendFreeSegmentsOnDisks_NotThreadSafe(uint64_t numSegments, const unsigned int numDisks,
+        const uint64_t allowedDisksMask, segment_id_extents_vec_t & extentsVec);
+    STORAGE_LIB_NO_EXPORT bool FreeSegmentExtent_NotThreadSafe(const segment_id_extent_t & extent);
+    STORAGE_LIB_NO_EXPORT void ClearParentBitsOfFullLeaf(segment_id_t leafLongIndex);
+    STORAGE_LIB_NO_EXPORT void SetParentBitsOfNonFullLeaf(segment_id_t leafLongIndex);
     STORAGE_LIB_NO_EXPORT void AllocateRows(const segment_id_t largestSegmentId);
     STORAGE_LIB_NO_EXPORT void AllocateRowsMaxMemory();
 private:
@@ -0,0 +1,80 @@
+/**
+ * @file ReleaseBufferPool.h
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ *
+ * @section DESCRIPTION
+ *
+ * This ReleaseBufferPool class recycles the buffers that bundles released from storage are read into.
+ * A buffer is SEGMENT_BUFFER_ALIGNMENT aligned and holds whole segments (header included), so the disk threads
+ * can read a bundle's segments straight into it (even with O_DIRECT), after which the payloads are packed
+ * to the front of the same buffer.  The buffer is then handed to egress as the data of a zmq message
+ * (zero-copy, freed through ZmqFreeCallback), and returned to the pool when zmq is done with it,
+ * from whichever thread that happens on.  Free buffers are kept, smallest fit first, up to a maximum
+ * number of bytes; any buffer beyond that is freed.
+ */
+
+#ifndef _RELEASE_BUFFER_POOL_H
+#define _RELEASE_BUFFER_POOL_H 1
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <boost/thread/mutex.hpp>
+#include "storage_lib_export.h"
+
+class ReleaseBufferPool;
+
+struct release_buffer_t {
+    uint8_t * data; //SEGMENT_BUFFER_ALIGNMENT aligned
+    std::size_t capacity; //a multiple of SEGMENT_SIZE
+    std::size_t size; //bytes of bundle at the front of data
+    std::shared_ptr<ReleaseBufferPool> poolPtr; //keeps the pool alive while the buffer is owned by zmq
+};
+
+class ReleaseBufferPool : public std::enable_shared_from_this<ReleaseBufferPool> {
+private:
+    ReleaseBufferPool(const uint64_t maxFreeBytes);
+public:
+    /**
+     * Create a pool.
+     * @param maxFreeBytes The most bytes of free buffers the pool keeps for reuse.
+     */
+    STORAGE_LIB_EXPORT static std::shared_ptr<ReleaseBufferPool> Create(const uint64_t maxFreeBytes);
+    STORAGE_LIB_EXPORT ~ReleaseBufferPool();
+
+    /**
+     * Get a buffer which can hold every segment of a bundle, reusing a free one when one fits (thread safe).
+     * @param bundleSizeBytes The size of the bundle to be read into the buffer.
+     * @return The buffer (size 0), to be given back through Recycle or ZmqFreeCallback.
+     */
+    STORAGE_LIB_EXPORT release_buffer_t * Acquire(const uint64_t bundleSizeBytes);
+    /// Return a buffer to its pool, or free it if the pool already keeps maxFreeBytes (thread safe).
+    STORAGE_LIB_EXPORT static void Recycle(release_buffer_t * releaseBuffer);
+    /// zmq::message_t free function, with the release_buffer_t as the hint.
+    STORAGE_LIB_EXPORT static void ZmqFreeCallback(void * data, void * hint);
+
+    STORAGE_LIB_EXPORT uint64_t GetNumBuffersAllocated();
+    STORAGE_LIB_EXPORT uint64_t GetNumBuffersReused();
+    STORAGE_LIB_EXPORT uint64_t GetFreeBytes();
+
+private:
+    STORAGE_LIB_NO_EXPORT static void FreeBuffer(release_buffer_t * releaseBuffer);
+
+    const uint64_t M_MAX_FREE_BYTES;
+    boost::mutex m_mutex;
+    std::multimap<std::size_t, release_buffer_t *> m_freeBuffersByCapacity; //mutex protected
+    uint64_t m_freeBytes; //mutex protected
+    uint64_t m_numBuffersAllocated; //mutex protected
+    uint64_t m_numBuffersReused; //mutex protected
+};
+
+#endif //_RELEASE_BUFFER_POOL_H
@@ -15,6 +15,9 @@
  *
  * This ZmqStorageInterface class is the HDTN storage module,
  * and controls all the threads and ZMQ sockets.
+ * With the storage config's numReleaseWorkerThreads non-zero, only the disk reads of released bundles run on
+ * the release worker threads.  Everything else (ingesting and writing bundles, custody signals and timers,
+ * and every catalog update) still runs on the one storage thread, which bounds storage throughput.
  */
 
 #ifndef _ZMQ_STORAGE_INTERFACE_H
@@ -29,6 +32,9 @@
 #include <boost/core/noncopyable.hpp>
 #include "storage_lib_export.h"
 
+namespace hdtn {
+struct InprocBundleRings;
+}
 
 class ZmqStorageInterface : private boost::noncopyable {
 public:
@@ -37,7 +43,8 @@ public:
     STORAGE_LIB_EXPORT void Stop();
     STORAGE_LIB_EXPORT bool Init(const HdtnConfig& hdtnConfig,
         const HdtnDistributedConfig& hdtnDistributedConfig,
-        zmq::context_t* hdtnOneProcessZmqInprocContextPtr = NULL);
+        zmq::context_t* hdtnOneProcessZmqInprocContextPtr = NULL,
+        hdtn::InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr = NULL);
     STORAGE_LIB_EXPORT std::size_t GetCurrentNumberOfBundlesDeletedFromStorage();
 
 
@@ -15,6 +15,7 @@
 #include "BundleStorageCatalog.h"
 #include <string>
 #include <boost/make_unique.hpp>
+#include <algorithm>
 
 
 BundleStorageCatalog::BundleStorageCatalog() : 
@@ -23,7 +24,8 @@ BundleStorageCatalog::BundleStorageCatalog() :
     m_totalBundleWriteOperationsToCatalog(0),
     m_totalBundleByteWriteOperationsToCatalog(0),
     m_totalBundleEraseOperationsFromCatalog(0),
-    m_totalBundleByteEraseOperationsFromCatalog(0) {}
+    m_totalBundleByteEraseOperationsFromCatalog(0),
+    m_nextDestinationGroupId(0) {}
 
 
 
@@ -106,6 +108,26 @@ bool BundleStorageCatalog::CatalogIncomingBundleForStore(catalog_entry_t & catal
             catalogEntryToTake.ptrUuidKeyInMap = &p->first;
         }
     }
+    return InsertCatalogEntry(catalogEntryToTake, custodyId, order);
+}
+bool BundleStorageCatalog::CatalogIncomingBundleForStore(catalog_entry_t & catalogEntryToTake, const cbhe_bundle_uuid_t & bundleUuid, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order) {
+    if (catalogEntryToTake.HasCustodyAndFragmentation()) {
+        const uuid_to_custid_hashmap_t::key_value_pair_t * p = m_uuidToCustodyIdHashMap.Insert(bundleUuid, custodyId);
+        if (p == NULL) {
+            return false;
+        }
+        catalogEntryToTake.ptrUuidKeyInMap = &p->first;
+    }
+    else if (catalogEntryToTake.HasCustodyAndNonFragmentation()) {
+        const uuidnofrag_to_custid_hashmap_t::key_value_pair_t * p = m_uuidNoFragToCustodyIdHashMap.Insert(cbhe_bundle_uuid_nofragment_t(bundleUuid), custodyId);
+        if (p == NULL) {
+            return false;
+        }
+        catalogEntryToTake.ptrUuidKeyInMap = &p->first;
+    }
+    return InsertCatalogEntry(catalogEntryToTake, custodyId, order);
+}
+bool BundleStorageCatalog::InsertCatalogEntry(catalog_entry_t & catalogEntryToTake, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order) {
     if (!AddEntryToAwaitingSend(catalogEntryToTake, custodyId, order)) {
         return false;
     }
@@ -124,21 +146,49 @@ bool BundleStorageCatalog::CatalogIncomingBundleForStore(catalog_entry_t & catal
 }
 bool BundleStorageCatalog::AddEntryToAwaitingSend(const catalog_entry_t & catalogEntry, const uint64_t custodyId, const DUPLICATE_EXPIRY_ORDER order) {
     priorities_to_expirations_array_t & priorityArray = m_destEidToPrioritiesMap[catalogEntry.destEid]; //created if not exist
-    expirations_to_custids_map_t & expirationMap = priorityArray[catalogEntry.GetPriorityIndex()];
+    const unsigned int priorityIndex = catalogEntry.GetPriorityIndex();
+    expirations_to_custids_map_t & expirationMap = priorityArray[priorityIndex];
+    const bool hadHead = !expirationMap.empty();
+    const uint64_t oldHeadExpiration = (hadHead) ? expirationMap.cbegin()->first : 0;
     custids_flist_queue_t& custodyIdFlistQueue = expirationMap[catalogEntry.GetAbsExpiration()];
+    bool success;
     if (order == DUPLICATE_EXPIRY_ORDER::SEQUENCE_NUMBER) {
-        return Insert_OrderBySequence(custodyIdFlistQueue, custodyId, catalogEntry.sequence);
+        success = Insert_OrderBySequence(custodyIdFlistQueue, custodyId, catalogEntry.sequence);
     }
     else if (order == DUPLICATE_EXPIRY_ORDER::FIFO) {
         Insert_OrderByFifo(custodyIdFlistQueue, custodyId);
-        return true;
+        success = true;
     }
     else if (order == DUPLICATE_EXPIRY_ORDER::FILO) {
         Insert_OrderByFilo(custodyIdFlistQueue, custodyId);
-        return true;
+        success = true;
     }
     else {
-        return false;
+        success = false;
+    }
+    UpdateDestinationGroups(catalogEntry.destEid, priorityIndex, hadHead, oldHeadExpiration, expirationMap);
+    if (success) {
+        m_expiryTimingWheel.Insert(catalogEntry.GetAbsExpiration(), custodyId);
+        if (m_expiryTimingWheel.Size() > ((m_numBundlesInCatalog * 2) + 1024)) { //mostly stale ids
+            RebuildExpiryTimingWheel();
+        }
+    }
+    return success;
+}
+void BundleStorageCatalog::RebuildExpiryTimingWheel() {
+    m_expiryTimingWheel.Clear();
+    m_expiredCustodyIdCandidates.clear(); //expired ids still awaiting send are reinserted as already expired
+    for (dest_eid_to_priorities_map_t::const_iterator dmIt = m_destEidToPrioritiesMap.cbegin(); dmIt != m_destEidToPrioritiesMap.cend(); ++dmIt) {
+        const priorities_to_expirations_array_t & priorityArray = dmIt->second;
+        for (std::size_t priorityIndex = 0; priorityIndex < NUMBER_OF_PRIORITIES; ++priorityIndex) {
+            const expirations_to_custids_map_t & expirationMap = priorityArray[priorityIndex];
+            for (expirations_to_custids_map_t::const_iterator expirationsIt = expirationMap.cbegin(); expirationsIt != expirationMap.cend(); ++expirationsIt) {
+                const custids_flist_queue_t & custodyIdFlistQueue = expirationsIt->second;
+                for (custids_flist_queue_t::const_iterator cidFlistIt = custodyIdFlistQueue.cbegin(); cidFlistIt != custodyIdFlistQueue.cend(); ++cidFlistIt) {
+                    m_expiryTimingWheel.Insert(expirationsIt->first, *cidFlistIt);
+                }
+            }
+        }
     }
 }
 bool BundleStorageCatalog::ReturnEntryToAwaitingSend(const catalog_entry_t & catalogEntry, const uint64_t custodyId) {
@@ -149,13 +199,16 @@ bool BundleStorageCatalog::RemoveEntryFromAwaitingSend(const catalog_entry_t & c
     dest_eid_to_priorities_map_t::iterator destEidIt = m_destEidToPrioritiesMap.find(catalogEntry.destEid);
     if (destEidIt != m_destEidToPrioritiesMap.end()) {
         priorities_to_expirations_array_t & priorityArray = destEidIt->second; //created if not exist
-        expirations_to_custids_map_t & expirationMap = priorityArray[catalogEntry.GetPriorityIndex()];
+        const unsigned int priorityIndex = catalogEntry.GetPriorityIndex();
+        expirations_to_custids_map_t & expirationMap = priorityArray[priorityIndex];
         expirations_to_custids_map_t::iterator expirationsIt = expirationMap.find(catalogEntry.GetAbsExpiration());
         if (expirationsIt != expirationMap.end()) {
+            const uint64_t oldHeadExpiration = expirationMap.cbegin()->first;
             custids_flist_queue_t& custodyIdFlistQueue = expirationsIt->second;
             bool removed = Remove(custodyIdFlistQueue, custodyId);
             if(custodyIdFlistQueue.empty()) {
                 expirationMap.erase(expirationsIt);
+                UpdateDestinationGroups(catalogEntry.destEid, priorityIndex, true, oldHeadExpiration, expirationMap);
             }
             return removed;
         }
@@ -236,6 +289,7 @@ catalog_entry_t * BundleStorageCatalog::PopEntryFromAwaitingSend(uint64_t & cust
         expirations_to_custids_map_t * expirationMapPtr = NULL;
         custids_flist_queue_t * custodyIdFlistQueuePtr = NULL;
         expirations_to_custids_map_t::iterator expirationMapIterator;
+        const cbhe_eid_t * destEidPtr = NULL;
 
         for (std::size_t j = 0; j < destEidPlusPriorityArrayPtrs.size(); ++j) {
             priorities_to_expirations_array_t * priorityArray = destEidPlusPriorityArrayPtrs[j].second;
@@ -248,6 +302,7 @@ catalog_entry_t * BundleStorageCatalog::PopEntryFromAwaitingSend(uint64_t & cust
                     expirationMapPtr = &expirationMap;
                     custodyIdFlistQueuePtr = &it->second;
                     expirationMapIterator = it;
+                    destEidPtr = destEidPlusPriorityArrayPtrs[j].first;
                 }
             }
         }
@@ -257,6 +312,7 @@ catalog_entry_t * BundleStorageCatalog::PopEntryFromAwaitingSend(uint64_t & cust
 
             if (custodyIdFlistQueuePtr->empty()) {
                 expirationMapPtr->erase(expirationMapIterator);
+                UpdateDestinationGroups(*destEidPtr, static_cast<unsigned int>(i), true, lowestExpiration, *expirationMapPtr);
             }
 
             return m_custodyIdToCatalogEntryHashmap.GetValuePtr(custodyId);
@@ -265,6 +321,136 @@ catalog_entry_t * BundleStorageCatalog::PopEntryFromAwaitingSend(uint64_t & cust
     return NULL;
 }
 
+uint64_t BundleStorageCatalog::AddDestinationGroup(const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests) {
+    const uint64_t destinationGroupId = m_nextDestinationGroupId++;
+    std::unique_ptr<destination_group_t> & groupPtr = m_destinationGroupIdToDestinationGroupMap[destinationGroupId];
+    groupPtr = boost::make_unique<destination_group_t>();
+    destination_group_t & group = *groupPtr;
+    group.availableDests = availableDests;
+
+    //index the group by destination and populate its ready index from what is already awaiting send
+    for (std::size_t i = 0; i < availableDests.size(); ++i) {
+        const cbhe_eid_t & eid = availableDests[i].first;
+        dest_eid_to_priorities_map_t::const_iterator dmIt;
+        dest_eid_to_priorities_map_t::const_iterator dmItEnd;
+        if (availableDests[i].second) { //wildcard * for any service id
+            m_anyServiceNodeIdToDestinationGroupsMap[eid.nodeId].push_back(&group);
+            dmIt = m_destEidToPrioritiesMap.lower_bound(cbhe_eid_t(eid.nodeId, 0));
+            dmItEnd = m_destEidToPrioritiesMap.upper_bound(cbhe_eid_t(eid.nodeId, UINT64_MAX));
+        }
+        else { //fully qualified eids
+            m_fullyQualifiedEidToDestinationGroupsMap[eid].push_back(&group);
+            dmIt = m_destEidToPrioritiesMap.lower_bound(eid);
+            dmItEnd = m_destEidToPrioritiesMap.upper_bound(eid);
+        }
+        for (; dmIt != dmItEnd; ++dmIt) {
+            for (unsigned int priorityIndex = 0; priorityIndex < NUMBER_OF_PRIORITIES; ++priorityIndex) {
+                const expirations_to_custids_map_t & expirationMap = dmIt->second[priorityIndex];
+                if (!expirationMap.empty()) {
+                    group.readySet.emplace(priorityIndex, expirationMap.cbegin()->first, dmIt->first);
+                }
+            }
+        }
+    }
+    return destinationGroupId;
+}
+
+template <typename mapType>
+static void RemoveGroupFromIndex(mapType & m, const typename mapType::key_type & key, const void * groupPtr) {
+    typename mapType::iterator it = m.find(key);
+    if (it != m.end()) {
+        it->second.erase(std::remove(it->second.begin(), it->second.end(), groupPtr), it->second.end());
+        if (it->second.empty()) {
+            m.erase(it);
+        }
+    }
+}
+
+bool BundleStorageCatalog::RemoveDestinationGroup(const uint64_t destinationGroupId) {
+    std::map<uint64_t, std::unique_ptr<destination_group_t> >::iterator it = m_destinationGroupIdToDestinationGroupMap.find(destinationGroupId);
+    if (it == m_destinationGroupIdToDestinationGroupMap.end()) {
+        return false;
+    }
+    const destination_group_t * const groupPtr = it->second.get();
+    const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests = groupPtr->availableDests;
+    for (std::size_t i = 0; i < availableDests.size(); ++i) {
+        if (availableDests[i].second) { //wildcard * for any service id
+            RemoveGroupFromIndex(m_anyServiceNodeIdToDestinationGroupsMap, availableDests[i].first.nodeId, groupPtr);
+        }
+        else {
+            RemoveGroupFromIndex(m_fullyQualifiedEidToDestinationGroupsMap, availableDests[i].first, groupPtr);
+        }
+    }
+    m_destinationGroupIdToDestinationGroupMap.erase(it);
+    return true;
+}
+
+//same selection as the other PopEntryFromAwaitingSend overloads (highest priority, then lowest expiration) except that
+//destinations with equal expirations are taken in eid order rather than the order they were listed in
+catalog_entry_t * BundleStorageCatalog::PopEntryFromAwaitingSend(uint64_t & custodyId, const uint64_t destinationGroupId) {
+    std::map<uint64_t, std::unique_ptr<destination_group_t> >::const_iterator groupIt = m_destinationGroupIdToDestinationGroupMap.find(destinationGroupId);
+    if ((groupIt == m_destinationGroupIdToDestinationGroupMap.cend()) || groupIt->second->readySet.empty()) {
+        return NULL;
+    }
+    const awaiting_send_ready_key_t readyKey = *(groupIt->second->readySet.cbegin()); //copy, erased below
+    dest_eid_to_priorities_map_t::iterator destEidIt = m_destEidToPrioritiesMap.find(readyKey.destEid);
+    if (destEidIt == m_destEidToPrioritiesMap.end()) {
+        return NULL; //unexpected error
+    }
+    expirations_to_custids_map_t & expirationMap = destEidIt->second[readyKey.priorityIndex];
+    expirations_to_custids_map_t::iterator expirationMapIterator = expirationMap.begin();
+    if (expirationMapIterator == expirationMap.end()) {
+        return NULL; //unexpected error
+    }
+    custids_flist_queue_t & custodyIdFlistQueue = expirationMapIterator->second;
+    custodyId = custodyIdFlistQueue.front();
+    custodyIdFlistQueue.pop();
+    if (custodyIdFlistQueue.empty()) {
+        expirationMap.erase(expirationMapIterator);
+        UpdateDestinationGroups(readyKey.destEid, readyKey.priorityIndex, true, readyKey.expiration, expirationMap);
+    }
+    return m_custodyIdToCatalogEntryHashmap.GetValuePtr(custodyId);
+}
+
+//keep the ready index of every destination group containing destEid in sync with the (possibly) new soonest expiration
+//of destEid's expirationMap (idempotent, so a group reached through both its fully qualified and any service id entries is fine)
+void BundleStorageCatalog::UpdateDestinationGroups(const cbhe_eid_t & destEid, const unsigned int priorityIndex,
+    const bool hadHead, const uint64_t oldHeadExpiration, const expirations_to_custids_map_t & expirationMap)
+{
+    if (m_destinationGroupIdToDestinationGroupMap.empty()) {
+        return;
+    }
+    const bool hasHead = !expirationMap.empty();
+    const uint64_t newHeadExpiration = (hasHead) ? expirationMap.cbegin()->first : 0;
+    if ((hadHead == hasHead) && ((!hasHead) || (oldHeadExpiration == newHeadExpiration))) {
+        return; //unchanged
+    }
+    const destination_group_ptrs_t * groupPtrsArray[2] = { NULL, NULL };
+    std::map<cbhe_eid_t, destination_group_ptrs_t>::const_iterator fqIt = m_fullyQualifiedEidToDestinationGroupsMap.find(destEid);
+    if (fqIt != m_fullyQualifiedEidToDestinationGroupsMap.cend()) {
+        groupPtrsArray[0] = &fqIt->second;
+    }
+    std::map<uint64_t, destination_group_ptrs_t>::const_iterator anyIt = m_anyServiceNodeIdToDestinationGroupsMap.find(destEid.nodeId);
+    if (anyIt != m_anyServiceNodeIdToDestinationGroupsMap.cend()) {
+        groupPtrsArray[1] = &anyIt->second;
+    }
+    for (unsigned int a = 0; a < 2; ++a) {
+        if (groupPtrsArray[a] == NULL) {
+            continue;
+        }
+        const destination_group_ptrs_t & groupPtrs = *groupPtrsArray[a];
+        for (std::size_t i = 0; i < groupPtrs.size(); ++i) {
+            awaiting_send_ready_set_t & readySet = groupPtrs[i]->readySet;
+            if (hadHead) {
+                readySet.erase(awaiting_send_ready_key_t(priorityIndex, oldHeadExpiration, destEid));
+            }
+            if (hasHead) {
+                readySet.emplace(priorityIndex, newHeadExpiration, destEid);
+            }
+        }
+    }
+}
+
 
 
 //return pair<success, numSuccessfulRemovals>
@@ -322,6 +508,13 @@ std::pair<bool, uint16_t> BundleStorageCatalog::Remove(const uint64_t custodyId,
 catalog_entry_t * BundleStorageCatalog::GetEntryFromCustodyId(const uint64_t custodyId) {
     return m_custodyIdToCatalogEntryHashmap.GetValuePtr(custodyId);
 }
+void BundleStorageCatalog::GetAllEntries(std::vector<std::pair<uint64_t, const catalog_entry_t*> > & custodyIdAndEntryPtrs) const {
+    custodyIdAndEntryPtrs.resize(0);
+    custodyIdAndEntryPtrs.reserve(m_numBundlesInCatalog);
+    m_custodyIdToCatalogEntryHashmap.ForEach([&custodyIdAndEntryPtrs](const custid_to_catalog_entry_hashmap_t::key_value_pair_t & kvp) {
+        custodyIdAndEntryPtrs.emplace_back(kvp.first, &(kvp.second));
+    });
+}
 uint64_t * BundleStorageCatalog::GetCustodyIdFromUuid(const cbhe_bundle_uuid_t & bundleUuid) {
     return m_uuidToCustodyIdHashMap.GetValuePtr(bundleUuid);
 }
@@ -333,29 +526,50 @@ void BundleStorageCatalog::GetExpiredBundleIds(const uint64_t expiry, const uint
 
     returnedIds.clear();
 
-    for(uint64_t priorityIndex = 0; priorityIndex < NUMBER_OF_PRIORITIES; priorityIndex++) {
-        for (dest_eid_to_priorities_map_t::iterator dmIt = m_destEidToPrioritiesMap.begin(); dmIt != m_destEidToPrioritiesMap.end(); ++dmIt) {
-            priorities_to_expirations_array_t & priorityArray = dmIt->second;
-            expirations_to_custids_map_t& expirationsMap = priorityArray[priorityIndex];
-            for (expirations_to_custids_map_t::iterator expirationsIt = expirationsMap.begin(); expirationsIt != expirationsMap.end(); ++expirationsIt) {
-                const uint64_t thisExpiration = expirationsIt->first;
-                if (thisExpiration <= expiry) {
-                    custids_flist_queue_t& custodyIdFlistQueue = expirationsIt->second;
-                    for (custids_flist_queue_t::iterator cidFlistIt = custodyIdFlistQueue.begin(); cidFlistIt != custodyIdFlistQueue.end(); ++cidFlistIt) {
-                        const uint64_t custodyId = *cidFlistIt;
-                        returnedIds.push_back(custodyId);
-                        if(maxNumberToFind && returnedIds.size() >= maxNumberToFind) {
-                            return;
-                        }
-                    }
-                }
-                else {
-                    // Expires in the future. Sorted map, so all following will expire in the future
-                    break;
-                }
+    m_expiryTimingWheel.PopExpired(expiry, m_expiredCustodyIdCandidates);
+
+    //A candidate may have been removed from the catalog, be in flight (not awaiting send), or be a duplicate from being
+    //returned to awaiting send.  Rather than searching its queue for the candidate, every id in the candidate's
+    //(destination, priority, expiration) queue is expired and awaiting send, so return each such queue once.
+    std::set<const custids_flist_queue_t*> visitedQueues;
+    std::size_t candidateIndex = 0;
+    for (; candidateIndex < m_expiredCustodyIdCandidates.size(); ++candidateIndex) {
+        if (maxNumberToFind && (returnedIds.size() >= maxNumberToFind)) {
+            break;
+        }
+        const catalog_entry_t * entryPtr = m_custodyIdToCatalogEntryHashmap.GetValuePtr(m_expiredCustodyIdCandidates[candidateIndex]);
+        if (entryPtr == NULL) {
+            continue; //already removed
+        }
+        const uint64_t thisExpiration = entryPtr->GetAbsExpiration();
+        if (thisExpiration > expiry) {
+            continue; //custody id reused by an unexpired bundle
+        }
+        dest_eid_to_priorities_map_t::iterator dmIt = m_destEidToPrioritiesMap.find(entryPtr->destEid);
+        if (dmIt == m_destEidToPrioritiesMap.end()) {
+            continue;
+        }
+        expirations_to_custids_map_t & expirationsMap = dmIt->second[entryPtr->GetPriorityIndex()];
+        expirations_to_custids_map_t::iterator expirationsIt = expirationsMap.find(thisExpiration);
+        if (expirationsIt == expirationsMap.end()) {
+            continue; //in flight, added back to the wheel if returned to awaiting send
+        }
+        const custids_flist_queue_t & custodyIdFlistQueue = expirationsIt->second;
+        if (!visitedQueues.insert(&custodyIdFlistQueue).second) {
+            continue;
+        }
+        custids_flist_queue_t::const_iterator cidFlistIt = custodyIdFlistQueue.cbegin();
+        for (; cidFlistIt != custodyIdFlistQueue.cend(); ++cidFlistIt) {
+            if (maxNumberToFind && (returnedIds.size() >= maxNumberToFind)) {
+                break;
             }
+            returnedIds.push_back(*cidFlistIt);
+        }
+        if (cidFlistIt != custodyIdFlistQueue.cend()) {
+            break; //keep this candidate so the rest of its queue is found by the next call
         }
     }
+    m_expiredCustodyIdCandidates.erase(m_expiredCustodyIdCandidates.begin(), m_expiredCustodyIdCandidates.begin() + candidateIndex);
 }
 
 bool BundleStorageCatalog::GetStorageExpiringBeforeThresholdTelemetry(StorageExpiringBeforeThresholdTelemetry_t & telem) {
@@ -0,0 +1,763 @@
+/**
+ * @file BundleStorageCatalogJournal.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "BundleStorageCatalogJournal.h"
+#include "Logger.h"
+#include "ThreadNamer.h"
+#include <cstring>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <boost/endian/conversion.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/predef/os.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::storage;
+
+//file header: 8 byte magic, uint64 version, uint64 generation (snapshot only: uint64 number of entries)
+static const char JOURNAL_MAGIC[8] = { 'H', 'D', 'T', 'N', 'C', 'J', 'N', 'L' };
+static const char SNAPSHOT_MAGIC[8] = { 'H', 'D', 'T', 'N', 'C', 'S', 'N', 'P' };
+static constexpr uint64_t FILE_FORMAT_VERSION = 1;
+//record: uint32 payload size, uint32 crc32 of payload, payload (first byte is the record type)
+static constexpr uint8_t RECORD_TYPE_ADD = 1;
+static constexpr uint8_t RECORD_TYPE_REMOVE = 2;
+static constexpr uint32_t MAX_RECORD_PAYLOAD_SIZE = 1U << 24; //anything larger is corruption
+
+struct journal_restored_bundle_t {
+    catalog_entry_t catalogEntry;
+    cbhe_bundle_uuid_t bundleUuid;
+};
+typedef std::map<uint64_t, journal_restored_bundle_t> custid_to_restored_bundle_map_t;
+
+static void AppendUint64(std::vector<uint8_t> & buf, uint64_t value) {
+    boost::endian::native_to_little_inplace(value);
+    const uint8_t * const p = reinterpret_cast<const uint8_t*>(&value);
+    buf.insert(buf.end(), p, p + sizeof(value));
+}
+
+//reserve the record header, to be filled in by FinishRecord
+static void BeginRecord(std::vector<uint8_t> & buf, const uint8_t recordType) {
+    buf.assign(2 * sizeof(uint32_t), 0);
+    buf.push_back(recordType);
+}
+
+static void FinishRecord(std::vector<uint8_t> & buf) {
+    const uint32_t payloadSize = static_cast<uint32_t>(buf.size() - (2 * sizeof(uint32_t)));
+    boost::crc_32_type crc;
+    crc.process_bytes(buf.data() + (2 * sizeof(uint32_t)), payloadSize);
+    uint32_t header[2] = { boost::endian::native_to_little(payloadSize), boost::endian::native_to_little(static_cast<uint32_t>(crc.checksum())) };
+    memcpy(buf.data(), header, sizeof(header));
+}
+
+static void SerializeAddRecord(std::vector<uint8_t> & buf, const uint64_t custodyId, const catalog_entry_t & catalogEntry) {
+    cbhe_bundle_uuid_t bundleUuid; //zero if no custody
+    if (catalogEntry.ptrUuidKeyInMap) {
+        if (catalogEntry.HasCustodyAndFragmentation()) {
+            bundleUuid = *static_cast<const cbhe_bundle_uuid_t*>(catalogEntry.ptrUuidKeyInMap);
+        }
+        else if (catalogEntry.HasCustodyAndNonFragmentation()) {
+            const cbhe_bundle_uuid_nofragment_t & uuidNoFrag = *static_cast<const cbhe_bundle_uuid_nofragment_t*>(catalogEntry.ptrUuidKeyInMap);
+            bundleUuid.creationSeconds = uuidNoFrag.creationSeconds;
+            bundleUuid.sequence = uuidNoFrag.sequence;
+            bundleUuid.srcEid = uuidNoFrag.srcEid;
+        }
+    }
+    BeginRecord(buf, RECORD_TYPE_ADD);
+    AppendUint64(buf, custodyId);
+    AppendUint64(buf, catalogEntry.bundleSizeBytes);
+    AppendUint64(buf, catalogEntry.payloadSizeBytes);
+    AppendUint64(buf, catalogEntry.destEid.nodeId);
+    AppendUint64(buf, catalogEntry.destEid.serviceId);
+    AppendUint64(buf, catalogEntry.encodedAbsExpirationAndCustodyAndPriority);
+    AppendUint64(buf, catalogEntry.sequence);
+    AppendUint64(buf, bundleUuid.creationSeconds);
+    AppendUint64(buf, bundleUuid.sequence);
+    AppendUint64(buf, bundleUuid.srcEid.nodeId);
+    AppendUint64(buf, bundleUuid.srcEid.serviceId);
+    AppendUint64(buf, bundleUuid.fragmentOffset);
+    AppendUint64(buf, bundleUuid.dataLength);
+    AppendUint64(buf, catalogEntry.segmentIdExtentsVec.size());
+    for (std::size_t i = 0; i < catalogEntry.segmentIdExtentsVec.size(); ++i) {
+        AppendUint64(buf, catalogEntry.segmentIdExtentsVec[i].beginSegmentId);
+        AppendUint64(buf, catalogEntry.segmentIdExtentsVec[i].numSegments);
+    }
+    FinishRecord(buf);
+}
+
+static void SerializeRemoveRecord(std::vector<uint8_t> & buf, const uint64_t custodyId) {
+    BeginRecord(buf, RECORD_TYPE_REMOVE);
+    AppendUint64(buf, custodyId);
+    FinishRecord(buf);
+}
+
+/// Walks the payload of one record
+struct journal_payload_reader_t {
+    const uint8_t * ptr;
+    std::size_t bytesRemaining;
+
+    bool ReadUint8(uint8_t & value) {
+        if (bytesRemaining == 0) {
+            return false;
+        }
+        value = *ptr++;
+        --bytesRemaining;
+        return true;
+    }
+    bool ReadUint64(uint64_t & value) {
+        if (bytesRemaining < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, ptr, sizeof(value));
+        boost::endian::little_to_native_inplace(value);
+        ptr += sizeof(value);
+        bytesRemaining -= sizeof(value);
+        return true;
+    }
+};
+
+static bool DeserializeAddRecord(journal_payload_reader_t & reader, uint64_t & custodyId, journal_restored_bundle_t & restoredBundle) {
+    catalog_entry_t & catalogEntry = restoredBundle.catalogEntry;
+    cbhe_bundle_uuid_t & bundleUuid = restoredBundle.bundleUuid;
+    uint64_t numExtents;
+    if (!(reader.ReadUint64(custodyId)
+        && reader.ReadUint64(catalogEntry.bundleSizeBytes)
+        && reader.ReadUint64(catalogEntry.payloadSizeBytes)
+        && reader.ReadUint64(catalogEntry.destEid.nodeId)
+        && reader.ReadUint64(catalogEntry.destEid.serviceId)
+        && reader.ReadUint64(catalogEntry.encodedAbsExpirationAndCustodyAndPriority)
+        && reader.ReadUint64(catalogEntry.sequence)
+        && reader.ReadUint64(bundleUuid.creationSeconds)
+        && reader.ReadUint64(bundleUuid.sequence)
+        && reader.ReadUint64(bundleUuid.srcEid.nodeId)
+        && reader.ReadUint64(bundleUuid.srcEid.serviceId)
+        && reader.ReadUint64(bundleUuid.fragmentOffset)
+        && reader.ReadUint64(bundleUuid.dataLength)
+        && reader.ReadUint64(numExtents)))
+    {
+        return false;
+    }
+    if (numExtents != (reader.bytesRemaining / (2 * sizeof(uint64_t)))) {
+        return false;
+    }
+    catalogEntry.segmentIdExtentsVec.resize(numExtents);
+    for (uint64_t i = 0; i < numExtents; ++i) {
+        uint64_t beginSegmentId, numSegments;
+        reader.ReadUint64(beginSegmentId);
+        reader.ReadUint64(numSegments);
+        if ((beginSegmentId >= SEGMENT_ID_LAST) || (numSegments == 0) || (numSegments >= SEGMENT_ID_LAST)) {
+            return false;
+        }
+        catalogEntry.segmentIdExtentsVec[i].beginSegmentId = static_cast<segment_id_t>(beginSegmentId);
+        catalogEntry.segmentIdExtentsVec[i].numSegments = static_cast<segment_id_t>(numSegments);
+    }
+    catalogEntry.ptrUuidKeyInMap = NULL;
+    return (reader.bytesRemaining == 0);
+}
+
+/// Reads the header and records of a journal or snapshot file
+class JournalFileReader : private boost::noncopyable {
+public:
+    enum class READ_RESULT { RECORD, END_OF_FILE, CORRUPT };
+
+    JournalFileReader(const boost::filesystem::path & filePath) :
+        m_fileHandle(fopen(filePath.string().c_str(), "rb")) {}
+    ~JournalFileReader() {
+        if (m_fileHandle) {
+            fclose(m_fileHandle);
+        }
+    }
+    bool IsOpen() const {
+        return (m_fileHandle != NULL);
+    }
+    bool ReadHeader(const char * magic, uint64_t & generation) {
+        char fileMagic[sizeof(JOURNAL_MAGIC)];
+        uint64_t version;
+        if ((fread(fileMagic, 1, sizeof(fileMagic), m_fileHandle) != sizeof(fileMagic)) || (memcmp(fileMagic, magic, sizeof(fileMagic)) != 0)) {
+            return false;
+        }
+        return ReadUint64(version) && (version == FILE_FORMAT_VERSION) && ReadUint64(generation);
+    }
+    bool ReadUint64(uint64_t & value) {
+        if (fread(&value, 1, sizeof(value), m_fileHandle) != sizeof(value)) {
+            return false;
+        }
+        boost::endian::little_to_native_inplace(value);
+        return true;
+    }
+    READ_RESULT ReadRecord(journal_payload_reader_t & payloadReader) {
+        uint32_t header[2];
+        const std::size_t headerBytesRead = fread(header, 1, sizeof(header), m_fileHandle);
+        if (headerBytesRead == 0) {
+            return READ_RESULT::END_OF_FILE;
+        }
+        else if (headerBytesRead != sizeof(header)) {
+            return READ_RESULT::CORRUPT; //torn header
+        }
+        const uint32_t payloadSize = boost::endian::little_to_native(header[0]);
+        const uint32_t expectedCrc = boost::endian::little_to_native(header[1]);
+        if ((payloadSize == 0) || (payloadSize > MAX_RECORD_PAYLOAD_SIZE)) {
+            return READ_RESULT::CORRUPT;
+        }
+        m_payload.resize(payloadSize);
+        if (fread(m_payload.data(), 1, payloadSize, m_fileHandle) != payloadSize) {
+            return READ_RESULT::CORRUPT; //torn payload
+        }
+        boost::crc_32_type crc;
+        crc.process_bytes(m_payload.data(), payloadSize);
+        if (crc.checksum() != expectedCrc) {
+            return READ_RESULT::CORRUPT;
+        }
+        payloadReader.ptr = m_payload.data();
+        payloadReader.bytesRemaining = payloadSize;
+        return READ_RESULT::RECORD;
+    }
+private:
+    FILE * m_fileHandle;
+    std::vector<uint8_t> m_payload;
+};
+
+static bool ReadGeneration(const boost::filesystem::path & filePath, const char * magic, uint64_t & generation) {
+    JournalFileReader reader(filePath);
+    return reader.IsOpen() && reader.ReadHeader(magic, generation);
+}
+
+//the custody id is the first field of both record types
+static bool PeekCustodyId(journal_payload_reader_t reader, uint64_t & custodyId) {
+    uint8_t recordType;
+    return reader.ReadUint8(recordType) && reader.ReadUint64(custodyId);
+}
+
+static bool WriteHeader(FILE * fileHandle, const char * magic, const uint64_t generation) {
+    std::vector<uint8_t> buf(magic, magic + sizeof(JOURNAL_MAGIC));
+    AppendUint64(buf, FILE_FORMAT_VERSION);
+    AppendUint64(buf, generation);
+    return (fwrite(buf.data(), 1, buf.size(), fileHandle) == buf.size());
+}
+
+//flush the stdio buffer and the OS cache to the device
+static bool SyncFile(FILE * fileHandle) {
+    if (fflush(fileHandle) != 0) {
+        return false;
+    }
+#ifdef _WIN32
+    return (_commit(_fileno(fileHandle)) == 0);
+#else
+    return (fsync(fileno(fileHandle)) == 0);
+#endif
+}
+
+//flush the stdio buffer and the file's data (and the metadata needed to read it back, e.g. its size) to the device
+static bool SyncFileData(FILE * fileHandle) {
+#if defined(_WIN32) || BOOST_OS_MACOS
+    return SyncFile(fileHandle);
+#else
+    if (fflush(fileHandle) != 0) {
+        return false;
+    }
+    return (fdatasync(fileno(fileHandle)) == 0);
+#endif
+}
+
+//sync the directory holding filePath so that a file created or renamed into it survives a power loss
+static bool SyncParentDirectory(const boost::filesystem::path & filePath) {
+#ifdef _WIN32
+    (void)filePath;
+    return true; //NTFS journals its directory entries
+#else
+    boost::filesystem::path directoryPath = filePath.parent_path();
+    if (directoryPath.empty()) {
+        directoryPath = ".";
+    }
+    const int fd = open(directoryPath.string().c_str(), O_RDONLY);
+    if (fd < 0) {
+        LOG_ERROR(subprocess) << "unable to open directory " << directoryPath << " to sync it";
+        return false;
+    }
+    const bool success = (fsync(fd) == 0);
+    close(fd);
+    if (!success) {
+        LOG_ERROR(subprocess) << "unable to sync directory " << directoryPath;
+    }
+    return success;
+#endif
+}
+
+//write numEntries records (each serialized into recordBuffer by serializeRecord) to a temporary file, sync it, and rename it into place
+template <typename SerializeRecordFunction>
+static bool WriteSnapshotFile(const boost::filesystem::path & snapshotFilePath, const uint64_t generation, const uint64_t numEntries,
+    std::vector<uint8_t> & recordBuffer, SerializeRecordFunction serializeRecord)
+{
+    const boost::filesystem::path tmpSnapshotFilePath = boost::filesystem::path(snapshotFilePath).concat(".tmp");
+    FILE * const snapshotFileHandle = fopen(tmpSnapshotFilePath.string().c_str(), "wb");
+    if (snapshotFileHandle == NULL) {
+        LOG_ERROR(subprocess) << "unable to create catalog snapshot " << tmpSnapshotFilePath;
+        return false;
+    }
+    bool success = WriteHeader(snapshotFileHandle, SNAPSHOT_MAGIC, generation);
+    recordBuffer.resize(0);
+    AppendUint64(recordBuffer, numEntries);
+    success = success && (fwrite(recordBuffer.data(), 1, recordBuffer.size(), snapshotFileHandle) == recordBuffer.size());
+    for (uint64_t i = 0; success && (i < numEntries); ++i) {
+        serializeRecord(recordBuffer);
+        success = (fwrite(recordBuffer.data(), 1, recordBuffer.size(), snapshotFileHandle) == recordBuffer.size());
+    }
+    success = success && SyncFile(snapshotFileHandle);
+    fclose(snapshotFileHandle);
+    if (!success) {
+        LOG_ERROR(subprocess) << "unable to write catalog snapshot " << tmpSnapshotFilePath;
+        return false;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmpSnapshotFilePath, snapshotFilePath, ec);
+    if (ec) {
+        LOG_ERROR(subprocess) << "unable to rename catalog snapshot " << tmpSnapshotFilePath << " to " << snapshotFilePath << ": " << ec.message();
+        return false;
+    }
+    return SyncParentDirectory(snapshotFilePath);
+}
+
+//delete the file, or if that fails truncate it so that it no longer has a valid header
+static void InvalidateFile(const boost::filesystem::path & filePath) {
+    boost::system::error_code ec;
+    if (boost::filesystem::remove(filePath, ec) || (!boost::filesystem::exists(filePath, ec))) {
+        return;
+    }
+    if (FILE * const fileHandle = fopen(filePath.string().c_str(), "wb")) {
+        fclose(fileHandle);
+    }
+    else {
+        LOG_ERROR(subprocess) << "unable to delete or truncate " << filePath;
+    }
+}
+
+BundleStorageCatalogJournal::BundleStorageCatalogJournal(const boost::filesystem::path & journalFilePath, const uint64_t snapshotIntervalRecords) :
+    M_JOURNAL_FILE_PATH(journalFilePath),
+    M_SNAPSHOT_FILE_PATH(boost::filesystem::path(journalFilePath).concat(".snapshot")),
+    M_PREVIOUS_JOURNAL_FILE_PATH(boost::filesystem::path(journalFilePath).concat(".prev")),
+    M_SNAPSHOT_INTERVAL_RECORDS(snapshotIntervalRecords),
+    m_generation(0),
+    m_numRecordsSinceSnapshot(0),
+    m_journalFileHandle(NULL),
+    m_pendingSnapshotGeneration(0),
+    m_snapshotThreadRunning(false),
+    m_snapshotPending(false),
+    m_snapshotFailed(false)
+{
+    //the next snapshot must have a generation greater than anything left on disk from a prior run
+    uint64_t generation;
+    if (ReadGeneration(M_SNAPSHOT_FILE_PATH, SNAPSHOT_MAGIC, generation)) {
+        m_generation = generation;
+    }
+    if (ReadGeneration(M_PREVIOUS_JOURNAL_FILE_PATH, JOURNAL_MAGIC, generation)) {
+        m_generation = std::max(m_generation, generation);
+    }
+    if (ReadGeneration(M_JOURNAL_FILE_PATH, JOURNAL_MAGIC, generation)) {
+        m_generation = std::max(m_generation, generation);
+    }
+}
+
+BundleStorageCatalogJournal::~BundleStorageCatalogJournal() {
+    Close();
+}
+
+void BundleStorageCatalogJournal::Close() {
+    if (m_snapshotThreadPtr) {
+        {
+            boost::mutex::scoped_lock lock(m_snapshotMutex);
+            m_snapshotThreadRunning = false; //a pending snapshot is still written first
+        }
+        m_snapshotConditionVariable.notify_one();
+        try {
+            m_snapshotThreadPtr->join();
+        }
+        catch (const boost::thread_resource_error&) {
+            LOG_ERROR(subprocess) << "error stopping catalog snapshot thread";
+        }
+        m_snapshotThreadPtr.reset();
+    }
+    if (m_journalFileHandle) {
+        fclose(m_journalFileHandle);
+        m_journalFileHandle = NULL;
+    }
+}
+
+void BundleStorageCatalogJournal::Disable() {
+    Close();
+    InvalidateFile(M_SNAPSHOT_FILE_PATH);
+    InvalidateFile(M_PREVIOUS_JOURNAL_FILE_PATH);
+    InvalidateFile(M_JOURNAL_FILE_PATH);
+    LOG_ERROR(subprocess) << "catalog journal disabled, deleted " << M_SNAPSHOT_FILE_PATH << " and " << M_JOURNAL_FILE_PATH
+        << " so that a restore scans the disks instead";
+}
+
+const boost::filesystem::path & BundleStorageCatalogJournal::GetJournalFilePath() const noexcept {
+    return M_JOURNAL_FILE_PATH;
+}
+const boost::filesystem::path & BundleStorageCatalogJournal::GetSnapshotFilePath() const noexcept {
+    return M_SNAPSHOT_FILE_PATH;
+}
+const boost::filesystem::path & BundleStorageCatalogJournal::GetPreviousJournalFilePath() const noexcept {
+    return M_PREVIOUS_JOURNAL_FILE_PATH;
+}
+uint64_t BundleStorageCatalogJournal::GetGeneration() const noexcept {
+    return m_generation;
+}
+
+bool BundleStorageCatalogJournal::LoadAddRecords(const bool includeJournal, custid_to_add_record_map_t & addRecordsMap,
+    uint64_t & snapshotGeneration, uint64_t & nextJournalGeneration) const
+{
+    journal_payload_reader_t payloadReader;
+    {
+        JournalFileReader reader(M_SNAPSHOT_FILE_PATH);
+        uint64_t numEntries;
+        if (!reader.IsOpen()) {
+            LOG_WARNING(subprocess) << "catalog snapshot " << M_SNAPSHOT_FILE_PATH << " does not exist";
+            return false;
+        }
+        if (!(reader.ReadHeader(SNAPSHOT_MAGIC, snapshotGeneration) && reader.ReadUint64(numEntries))) {
+            LOG_ERROR(subprocess) << "catalog snapshot " << M_SNAPSHOT_FILE_PATH << " has an invalid header";
+            return false;
+        }
+        for (uint64_t i = 0; i < numEntries; ++i) {
+            uint64_t custodyId;
+            if ((reader.ReadRecord(payloadReader) != JournalFileReader::READ_RESULT::RECORD)
+                || (payloadReader.ptr[0] != RECORD_TYPE_ADD)
+                || (!PeekCustodyId(payloadReader, custodyId))
+                || (!addRecordsMap.emplace(custodyId, std::vector<uint8_t>(payloadReader.ptr, payloadReader.ptr + payloadReader.bytesRemaining)).second))
+            {
+                LOG_ERROR(subprocess) << "catalog snapshot " << M_SNAPSHOT_FILE_PATH << " is corrupt at entry " << i;
+                return false;
+            }
+        }
+        if (reader.ReadRecord(payloadReader) != JournalFileReader::READ_RESULT::END_OF_FILE) {
+            LOG_ERROR(subprocess) << "catalog snapshot " << M_SNAPSHOT_FILE_PATH << " has more than " << numEntries << " entries";
+            return false;
+        }
+    }
+    //replay the previous journal (if not yet folded into the snapshot) and then the journal, in generation order
+    nextJournalGeneration = snapshotGeneration;
+    const boost::filesystem::path * const journalFilePaths[2] = { &M_PREVIOUS_JOURNAL_FILE_PATH, &M_JOURNAL_FILE_PATH };
+    const unsigned int numJournals = (includeJournal) ? 2 : 1;
+    for (unsigned int journalIndex = 0; journalIndex < numJournals; ++journalIndex) {
+        const boost::filesystem::path & journalFilePath = *journalFilePaths[journalIndex];
+        JournalFileReader reader(journalFilePath);
+        uint64_t journalGeneration;
+        if (!reader.IsOpen()) {
+            if ((journalIndex == 0) //no previous journal awaiting a snapshot
+                || (nextJournalGeneration > snapshotGeneration)) //stopped after renaming the journal to the previous journal but before restarting it
+            {
+                continue;
+            }
+            LOG_ERROR(subprocess) << "catalog journal " << journalFilePath << " does not exist";
+            return false;
+        }
+        if (!reader.ReadHeader(JOURNAL_MAGIC, journalGeneration)) {
+            LOG_ERROR(subprocess) << "catalog journal " << journalFilePath << " has an invalid header";
+            return false;
+        }
+        if (journalGeneration < nextJournalGeneration) {
+            //stopped after writing the snapshot but before restarting (or deleting) the journal
+            LOG_INFO(subprocess) << "catalog journal " << journalFilePath << " generation " << journalGeneration
+                << " is already contained in snapshot generation " << snapshotGeneration;
+            continue;
+        }
+        else if (journalGeneration > nextJournalGeneration) {
+            LOG_ERROR(subprocess) << "catalog journal " << journalFilePath << " generation " << journalGeneration
+                << " is newer than expected generation " << nextJournalGeneration;
+            return false;
+        }
+        for (uint64_t recordIndex = 0; ; ++recordIndex) {
+            const JournalFileReader::READ_RESULT result = reader.ReadRecord(payloadReader);
+            if (result == JournalFileReader::READ_RESULT::END_OF_FILE) {
+                break;
+            }
+            bool valid = (result == JournalFileReader::READ_RESULT::RECORD);
+            uint64_t custodyId;
+            valid = valid && PeekCustodyId(payloadReader, custodyId);
+            if (valid) {
+                const uint8_t recordType = payloadReader.ptr[0];
+                if (recordType == RECORD_TYPE_ADD) {
+                    valid = addRecordsMap.emplace(custodyId, std::vector<uint8_t>(payloadReader.ptr, payloadReader.ptr + payloadReader.bytesRemaining)).second;
+                }
+                else if (recordType == RECORD_TYPE_REMOVE) {
+                    valid = (payloadReader.bytesRemaining == (1 + sizeof(uint64_t))) && (addRecordsMap.erase(custodyId) == 1);
+                }
+                else {
+                    valid = false;
+                }
+            }
+            if (!valid) {
+                LOG_ERROR(subprocess) << "catalog journal " << journalFilePath << " is corrupt at record " << recordIndex;
+                return false;
+            }
+        }
+        nextJournalGeneration = journalGeneration + 1;
+    }
+    return true;
+}
+
+bool BundleStorageCatalogJournal::Restore(BundleStorageCatalog & catalog, MemoryManagerTreeArray & memoryManager,
+    uint64_t & totalBundlesRestored, uint64_t & totalBytesRestored, uint64_t & totalSegmentsRestored)
+{
+    totalBundlesRestored = 0; totalBytesRestored = 0; totalSegmentsRestored = 0;
+    custid_to_add_record_map_t addRecordsMap;
+    uint64_t snapshotGeneration;
+    uint64_t nextJournalGeneration;
+    if (!LoadAddRecords(true, addRecordsMap, snapshotGeneration, nextJournalGeneration)) {
+        return false;
+    }
+    //ordered by custody id so that bundles are returned to awaiting send in the order they were stored
+    custid_to_restored_bundle_map_t restoredBundlesMap;
+    for (custid_to_add_record_map_t::const_iterator it = addRecordsMap.cbegin(); it != addRecordsMap.cend(); ++it) {
+        journal_payload_reader_t payloadReader = { it->second.data(), it->second.size() };
+        uint8_t recordType;
+        uint64_t custodyId;
+        journal_restored_bundle_t restoredBundle;
+        if (!(payloadReader.ReadUint8(recordType) && DeserializeAddRecord(payloadReader, custodyId, restoredBundle))) {
+            LOG_ERROR(subprocess) << "catalog journal: the record of custody id " << it->first << " is corrupt";
+            return false;
+        }
+        restoredBundlesMap.emplace_hint(restoredBundlesMap.end(), custodyId, std::move(restoredBundle));
+    }
+
+    //verify every segment is in range and owned by exactly one bundle (or small bundle slab slot) before touching the catalog or memory manager
+    std::vector<segment_id_extent_t> allExtents;
+    std::set<std::pair<segment_id_t, segment_id_t> > slabSegmentIdAndSlots;
+    std::set<segment_id_t> slabSegmentIds;
+    for (custid_to_restored_bundle_map_t::const_iterator it = restoredBundlesMap.cbegin(); it != restoredBundlesMap.cend(); ++it) {
+        const catalog_entry_t & catalogEntry = it->second.catalogEntry;
+        const uint64_t totalSegmentsRequired = (catalogEntry.bundleSizeBytes / BUNDLE_STORAGE_PER_SEGMENT_SIZE) + ((catalogEntry.bundleSizeBytes % BUNDLE_STORAGE_PER_SEGMENT_SIZE) == 0 ? 0 : 1);
+        if (catalogEntry.GetNumSegments() != totalSegmentsRequired) {
+            LOG_ERROR(subprocess) << "catalog journal: custody id " << it->first << " has the wrong number of segments for its bundle size";
+            return false;
+        }
+        if (catalogEntry.IsInSmallBundleSlab()) { //the slab segment is shared, and allocated later by the storage manager
+            if (!slabSegmentIdAndSlots.emplace(catalogEntry.segmentIdExtentsVec[0].beginSegmentId, catalogEntry.segmentIdExtentsVec[0].numSegments).second) {
+                LOG_ERROR(subprocess) << "catalog journal: custody id " << it->first << " shares its small bundle slab slot with another bundle";
+                return false;
+            }
+            if (slabSegmentIds.insert(catalogEntry.segmentIdExtentsVec[0].beginSegmentId).second) {
+                allExtents.push_back(segment_id_extent_t{ catalogEntry.segmentIdExtentsVec[0].beginSegmentId, 1 });
+            }
+            continue;
+        }
+        allExtents.insert(allExtents.end(), catalogEntry.segmentIdExtentsVec.cbegin(), catalogEntry.segmentIdExtentsVec.cend());
+    }
+    std::sort(allExtents.begin(), allExtents.end(), [](const segment_id_extent_t & a, const segment_id_extent_t & b) {
+        return a.beginSegmentId < b.beginSegmentId;
+    });
+    for (std::size_t i = 0; i < allExtents.size(); ++i) {
+        const uint64_t endSegmentId = static_cast<uint64_t>(allExtents[i].beginSegmentId) + allExtents[i].numSegments;
+        if ((endSegmentId > memoryManager.GetMaxSegments())
+            || (((i + 1) < allExtents.size()) && (endSegmentId > allExtents[i + 1].beginSegmentId)))
+        {
+            LOG_ERROR(subprocess) << "catalog journal: segment extent starting at " << allExtents[i].beginSegmentId << " is out of range or overlaps another bundle";
+            return false;
+        }
+    }
+
+    for (custid_to_restored_bundle_map_t::iterator it = restoredBundlesMap.begin(); it != restoredBundlesMap.end(); ++it) {
+        catalog_entry_t & catalogEntry = it->second.catalogEntry;
+        const uint64_t bundleSizeBytes = catalogEntry.bundleSizeBytes;
+        const bool isInSmallBundleSlab = catalogEntry.IsInSmallBundleSlab();
+        const uint64_t numSegments = (isInSmallBundleSlab) ? 0 : catalogEntry.GetNumSegments();
+        for (std::size_t i = 0; (!isInSmallBundleSlab) && (i < catalogEntry.segmentIdExtentsVec.size()); ++i) {
+            const segment_id_extent_t & extent = catalogEntry.segmentIdExtentsVec[i];
+            for (segment_id_t j = 0; j < extent.numSegments; ++j) {
+                memoryManager.AllocateSegmentId_NotThreadSafe(extent.beginSegmentId + j);
+            }
+        }
+        const segment_id_extents_vec_t extentsVec(catalogEntry.segmentIdExtentsVec); //catalogEntry is moved from on success
+        if (!catalog.CatalogIncomingBundleForStore(catalogEntry, it->second.bundleUuid, it->first, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO)) {
+            LOG_ERROR(subprocess) << "catalog journal: unable to catalog custody id " << it->first << " (duplicate bundle uuid), dropping it";
+            if (!isInSmallBundleSlab) {
+                memoryManager.FreeSegmentExtents_ThreadSafe(extentsVec);
+            }
+            continue;
+        }
+        ++totalBundlesRestored;
+        totalBytesRestored += bundleSizeBytes;
+        totalSegmentsRestored += numSegments;
+    }
+    LOG_INFO(subprocess) << "restored " << totalBundlesRestored << " bundles from catalog snapshot generation " << snapshotGeneration;
+    return true;
+}
+
+bool BundleStorageCatalogJournal::WriteSnapshotAndRestartJournal(const std::vector<std::pair<uint64_t, const catalog_entry_t*> > & custodyIdAndEntryPtrs) {
+    Close();
+    const uint64_t newGeneration = m_generation + 1;
+    std::size_t entryIndex = 0;
+    if (!WriteSnapshotFile(M_SNAPSHOT_FILE_PATH, newGeneration, custodyIdAndEntryPtrs.size(), m_recordBuffer,
+        [&](std::vector<uint8_t> & recordBuffer) {
+            SerializeAddRecord(recordBuffer, custodyIdAndEntryPtrs[entryIndex].first, *custodyIdAndEntryPtrs[entryIndex].second);
+            ++entryIndex;
+        }))
+    {
+        Disable();
+        return false;
+    }
+    m_generation = newGeneration;
+    boost::system::error_code ec;
+    boost::filesystem::remove(M_PREVIOUS_JOURNAL_FILE_PATH, ec); //already contained in the new snapshot
+
+    m_journalFileHandle = fopen(M_JOURNAL_FILE_PATH.string().c_str(), "wb");
+    if (m_journalFileHandle == NULL) {
+        LOG_ERROR(subprocess) << "unable to create catalog journal " << M_JOURNAL_FILE_PATH;
+        Disable();
+        return false;
+    }
+    if (!(WriteHeader(m_journalFileHandle, JOURNAL_MAGIC, m_generation) && SyncFile(m_journalFileHandle) && SyncParentDirectory(M_JOURNAL_FILE_PATH))) {
+        LOG_ERROR(subprocess) << "unable to write catalog journal " << M_JOURNAL_FILE_PATH;
+        Disable();
+        return false;
+    }
+    m_numRecordsSinceSnapshot = 0;
+    m_snapshotFailed.store(false, std::memory_order_release);
+    return true;
+}
+
+bool BundleStorageCatalogJournal::AppendAdd(const uint64_t custodyId, const catalog_entry_t & catalogEntry) {
+    SerializeAddRecord(m_recordBuffer, custodyId, catalogEntry);
+    return AppendRecord(m_recordBuffer);
+}
+
+bool BundleStorageCatalogJournal::AppendRemove(const uint64_t custodyId) {
+    SerializeRemoveRecord(m_recordBuffer, custodyId);
+    return AppendRecord(m_recordBuffer);
+}
+
+bool BundleStorageCatalogJournal::AppendRecord(const std::vector<uint8_t> & record) {
+    if (m_journalFileHandle == NULL) {
+        return false;
+    }
+    if (m_snapshotFailed.load(std::memory_order_acquire)) {
+        LOG_ERROR(subprocess) << "the background catalog snapshot failed";
+        Disable();
+        return false;
+    }
+    if ((m_numRecordsSinceSnapshot >= M_SNAPSHOT_INTERVAL_RECORDS) && (!m_snapshotPending.load(std::memory_order_acquire))) {
+        //(otherwise the previous snapshot is still being written and the journal keeps growing until it is)
+        if (!RotateJournal()) {
+            Disable();
+            return false;
+        }
+    }
+    //synced to the device at every record boundary, so a record survives a power loss once appended
+    if ((fwrite(record.data(), 1, record.size(), m_journalFileHandle) != record.size()) || (!SyncFileData(m_journalFileHandle))) {
+        LOG_ERROR(subprocess) << "unable to append to catalog journal " << M_JOURNAL_FILE_PATH;
+        Disable();
+        return false;
+    }
+    ++m_numRecordsSinceSnapshot;
+    return true;
+}
+
+//restart the journal with the next generation and hand the old one to the snapshot thread
+bool BundleStorageCatalogJournal::RotateJournal() {
+    fclose(m_journalFileHandle);
+    m_journalFileHandle = NULL;
+    boost::system::error_code ec;
+    boost::filesystem::rename(M_JOURNAL_FILE_PATH, M_PREVIOUS_JOURNAL_FILE_PATH, ec);
+    if (ec) {
+        LOG_ERROR(subprocess) << "unable to rename catalog journal " << M_JOURNAL_FILE_PATH << " to " << M_PREVIOUS_JOURNAL_FILE_PATH << ": " << ec.message();
+        return false;
+    }
+    const uint64_t newGeneration = m_generation + 1;
+    m_journalFileHandle = fopen(M_JOURNAL_FILE_PATH.string().c_str(), "wb");
+    if (m_journalFileHandle == NULL) {
+        LOG_ERROR(subprocess) << "unable to create catalog journal " << M_JOURNAL_FILE_PATH;
+        return false;
+    }
+    //the rename and the new journal both reach the device before any record of the new generation is appended
+    if (!(WriteHeader(m_journalFileHandle, JOURNAL_MAGIC, newGeneration) && SyncFile(m_journalFileHandle) && SyncParentDirectory(M_JOURNAL_FILE_PATH))) {
+        LOG_ERROR(subprocess) << "unable to write catalog journal " << M_JOURNAL_FILE_PATH;
+        return false;
+    }
+    m_generation = newGeneration;
+    m_numRecordsSinceSnapshot = 0;
+    m_snapshotPending.store(true, std::memory_order_release);
+    {
+        boost::mutex::scoped_lock lock(m_snapshotMutex);
+        m_pendingSnapshotGeneration = newGeneration;
+        if (!m_snapshotThreadPtr) {
+            m_snapshotThreadRunning = true;
+            m_snapshotThreadPtr = boost::make_unique<boost::thread>(boost::bind(&BundleStorageCatalogJournal::SnapshotThreadFunc, this));
+        }
+    }
+    m_snapshotConditionVariable.notify_one();
+    return true;
+}
+
+//runs in the snapshot thread: the new snapshot is the old snapshot plus the previous journal, so the catalog is never read
+bool BundleStorageCatalogJournal::FoldPreviousJournalIntoSnapshot(const uint64_t newGeneration) {
+    custid_to_add_record_map_t addRecordsMap;
+    uint64_t snapshotGeneration;
+    uint64_t nextJournalGeneration;
+    if (!LoadAddRecords(false, addRecordsMap, snapshotGeneration, nextJournalGeneration)) {
+        return false;
+    }
+    if (nextJournalGeneration != newGeneration) {
+        LOG_ERROR(subprocess) << "catalog journal " << M_PREVIOUS_JOURNAL_FILE_PATH << " does not continue snapshot generation " << snapshotGeneration;
+        return false;
+    }
+    std::vector<uint8_t> recordBuffer;
+    custid_to_add_record_map_t::const_iterator it = addRecordsMap.cbegin();
+    if (!WriteSnapshotFile(M_SNAPSHOT_FILE_PATH, newGeneration, addRecordsMap.size(), recordBuffer,
+        [&](std::vector<uint8_t> & buf) {
+            buf.assign(2 * sizeof(uint32_t), 0);
+            buf.insert(buf.end(), it->second.cbegin(), it->second.cend());
+            FinishRecord(buf);
+            ++it;
+        }))
+    {
+        return false;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::remove(M_PREVIOUS_JOURNAL_FILE_PATH, ec); //now contained in the snapshot (skipped by a restore if left behind)
+    return true;
+}
+
+void BundleStorageCatalogJournal::SnapshotThreadFunc() {
+    ThreadNamer::SetThisThreadName("CatalogSnapshot");
+    boost::mutex::scoped_lock lock(m_snapshotMutex);
+    while (true) {
+        const uint64_t newGeneration = m_pendingSnapshotGeneration;
+        if (newGeneration) {
+            lock.unlock();
+            if (!FoldPreviousJournalIntoSnapshot(newGeneration)) {
+                //without a snapshot a restore scans the disks; the journal itself is deleted by the next append
+                LOG_ERROR(subprocess) << "unable to write catalog snapshot generation " << newGeneration << ", deleting " << M_SNAPSHOT_FILE_PATH;
+                InvalidateFile(M_SNAPSHOT_FILE_PATH);
+                InvalidateFile(M_PREVIOUS_JOURNAL_FILE_PATH);
+                m_snapshotFailed.store(true, std::memory_order_release);
+            }
+            lock.lock();
+            m_pendingSnapshotGeneration = 0;
+            m_snapshotPending.store(false, std::memory_order_release);
+        }
+        else if (!m_snapshotThreadRunning) {
+            break;
+        }
+        else {
+            m_snapshotConditionVariable.wait(lock);
+        }
+    }
+}
@@ -47,7 +47,9 @@ BundleStorageManagerAsio::BundleStorageManagerAsio(const StorageConfig_ptr & sto
 
     m_workPtr(boost::make_unique< boost::asio::io_service::work>(m_ioService)),
     m_asioHandlePtrsVec(M_NUM_STORAGE_DISKS),
-    m_diskOperationInProgressVec(M_NUM_STORAGE_DISKS)
+    m_diskOperationInProgressVec(M_NUM_STORAGE_DISKS),
+    m_diskOperationStartTimesVec(M_NUM_STORAGE_DISKS),
+    m_diskIoBuffersVec(M_NUM_STORAGE_DISKS)
 {
 
 
@@ -79,9 +81,9 @@ void BundleStorageManagerAsio::Start() {
     if (m_storageConfigPtr) {
         for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
             const boost::filesystem::path& filePath = m_filePathsVec[diskId];
-            const boost::filesystem::path::value_type* filePathCstr = filePath.c_str();
             LOG_INFO(subprocess) << ((m_successfullyRestoredFromDisk) ? "reopening " : "creating ") << filePath;
 #if BOOST_OS_WINDOWS
+            const boost::filesystem::path::value_type* filePathCstr = filePath.c_str();
             //
             //https://docs.microsoft.com/en-us/windows/win32/fileio/synchronous-and-asynchronous-i-o
             //In synchronous file I/O, a thread starts an I/O operation and immediately enters a wait state until the I/O request has completed.
@@ -96,7 +98,8 @@ void BundleStorageManagerAsio::Start() {
                 //CREATE_ALWAYS : Creates a new file, always. If the specified file exists and is writable, the function overwrites the file
                 //OPEN_EXISTING : Opens a file or device, only if it exists.  If the specified file or device does not exist, the function fails and the last - error code is set to ERROR_FILE_NOT_FOUND(2).
                 (m_successfullyRestoredFromDisk) ? OPEN_EXISTING : CREATE_ALWAYS,
-                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,  // normal file
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | //normal file
+                ((m_storageConfigPtr->m_storageDiskConfigVector[diskId].useDirectIo) ? FILE_FLAG_NO_BUFFERING : 0), //bypass the system cache
                 NULL);                  // no attr. template
 
             if (hFile == INVALID_HANDLE_VALUE) {
@@ -106,18 +109,10 @@ void BundleStorageManagerAsio::Start() {
             //
             //FILE * fileHandle = (m_successfullyRestoredFromDisk) ? fopen(filePath, "r+bR") : fopen(filePath, "w+bR");
             m_asioHandlePtrsVec[diskId] = boost::make_unique<boost::asio::windows::random_access_handle>(m_ioService, hFile);
-#elif (BOOST_OS_MACOS || BOOST_OS_BSD)
-            int file_desc = open(filePathCstr, (m_successfullyRestoredFromDisk) ? (O_RDWR) : (O_CREAT|O_RDWR|O_TRUNC), DEFFILEMODE);
+#else // Linux, APPLE, or BSD (O_DIRECT or F_NOCACHE if useDirectIo)
+            int file_desc = OpenStorageDiskFile(diskId);
             if(file_desc < 0) {
-                LOG_ERROR(subprocess) << "error opening " << filePath;
-                return;
-            }
-            m_asioHandlePtrsVec[diskId] = boost::make_unique<boost::asio::posix::stream_descriptor>(m_ioService, file_desc);
-#else // Linux (not WIN32 or APPLE)
-            int file_desc = open(filePathCstr, (m_successfullyRestoredFromDisk) ? (O_RDWR|O_LARGEFILE) : (O_CREAT|O_RDWR|O_TRUNC|O_LARGEFILE), DEFFILEMODE);
-            if(file_desc < 0) {
-                LOG_ERROR(subprocess) << "error opening " << filePath;
-                return;
+                return; //error already logged
             }
             m_asioHandlePtrsVec[diskId] = boost::make_unique<boost::asio::posix::stream_descriptor>(m_ioService, file_desc);
 #endif
@@ -125,6 +120,7 @@ void BundleStorageManagerAsio::Start() {
         }
         m_ioServiceThreadPtr = boost::make_unique<boost::thread>(boost::bind(&boost::asio::io_service::run, &m_ioService));
         ThreadNamer::SetIoServiceThreadName(m_ioService, "ioServiceStorageAsio");
+        StartDiskSpaceReclaimer();
     }
 }
 
@@ -139,14 +135,25 @@ void BundleStorageManagerAsio::TryDiskOperation_Consume_NotThreadSafe(const unsi
             segment_id_t * const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE];
 
             const segment_id_t segmentId = circularBufferSegmentIdsPtr[consumeIndex];
-            uint8_t * const readFromStorageDestPointer = m_circularBufferReadFromStoragePointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire);
-
-            const bool isWriteToDisk = (readFromStorageDestPointer == NULL);
+            const bool isWriteToDisk = (m_circularBufferReadFromStoragePointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire) == NULL);
             if (segmentId == SEGMENT_ID_LAST) {
                 LOG_ERROR(subprocess) << "error segmentId is last";
                 //continue;
             }
 
+            //merge the queued operations of adjacent segments on this disk into one scatter/gather I/O
+            const unsigned int numSegments = GetNumCoalescableDiskOperations(diskId, consumeIndex);
+            std::vector<boost::asio::mutable_buffer> & buffers = m_diskIoBuffersVec[diskId];
+            buffers.resize(numSegments);
+            boost::uint8_t * const circularBufferBlockDataPtr = &m_circularBufferBlockDataPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
+            for (unsigned int i = 0; i < numSegments; ++i) {
+                const unsigned int index = (consumeIndex + i) % CIRCULAR_INDEX_BUFFER_SIZE;
+                uint8_t * const segmentPtr = (isWriteToDisk) ?
+                    &circularBufferBlockDataPtr[index * SEGMENT_SIZE] :
+                    m_circularBufferReadFromStoragePointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + index].load(std::memory_order_acquire);
+                buffers[i] = boost::asio::buffer(segmentPtr, SEGMENT_SIZE);
+            }
+
             const boost::uint64_t offsetBytes = static_cast<boost::uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
 
 #if BOOST_OS_WINDOWS
@@ -155,20 +162,19 @@ void BundleStorageManagerAsio::TryDiskOperation_Consume_NotThreadSafe(const unsi
 #else // Linux (not WIN32 or APPLE)
             lseek64(m_asioHandlePtrsVec[diskId]->native_handle(), offsetBytes, SEEK_SET);
 #endif
+            m_diskOperationStartTimesVec[diskId] = boost::posix_time::microsec_clock::universal_time();
 
             if (isWriteToDisk) {
-                boost::uint8_t * const circularBufferBlockDataPtr = &m_circularBufferBlockDataPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
-                boost::uint8_t * const data = &circularBufferBlockDataPtr[consumeIndex * SEGMENT_SIZE]; //expected data for testing when reading
 #if BOOST_OS_WINDOWS
                 boost::asio::async_write_at(*m_asioHandlePtrsVec[diskId], offsetBytes,
 #else
                 boost::asio::async_write(*m_asioHandlePtrsVec[diskId],
 #endif
-                    boost::asio::buffer(data, SEGMENT_SIZE),
+                    buffers,
                     boost::bind(&BundleStorageManagerAsio::HandleDiskOperationCompleted, this,
                         boost::asio::placeholders::error,
                         boost::asio::placeholders::bytes_transferred,
-                        diskId, consumeIndex, false));
+                        diskId, consumeIndex, numSegments, false));
 
             }
             else { //read from disk
@@ -177,11 +183,11 @@ void BundleStorageManagerAsio::TryDiskOperation_Consume_NotThreadSafe(const unsi
 #else
                 boost::asio::async_read(*m_asioHandlePtrsVec[diskId],
 #endif
-                    boost::asio::buffer((void*)readFromStorageDestPointer, SEGMENT_SIZE),
+                    buffers,
                     boost::bind(&BundleStorageManagerAsio::HandleDiskOperationCompleted, this,
                         boost::asio::placeholders::error,
                         boost::asio::placeholders::bytes_transferred,
-                        diskId, consumeIndex, true));
+                        diskId, consumeIndex, numSegments, true));
             }
         }
     }
@@ -195,24 +201,31 @@ void BundleStorageManagerAsio::CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(con
 }
 
 
-void BundleStorageManagerAsio::HandleDiskOperationCompleted(const boost::system::error_code& error, std::size_t bytes_transferred, const unsigned int diskId, const unsigned int consumeIndex, const bool wasReadOperation) {
+void BundleStorageManagerAsio::HandleDiskOperationCompleted(const boost::system::error_code& error, std::size_t bytes_transferred,
+    const unsigned int diskId, const unsigned int consumeIndex, const unsigned int numSegments, const bool wasReadOperation)
+{
     m_diskOperationInProgressVec[diskId] = false;
     if (error) {
         LOG_ERROR(subprocess) << "error in BundleStorageManagerMT::HandleDiskOperationCompleted: " << error.message();
     }
-    else if (bytes_transferred != SEGMENT_SIZE) {
-        LOG_ERROR(subprocess) << "error in BundleStorageManagerMT::HandleDiskOperationCompleted: bytes_transferred(" << bytes_transferred << ") != SEGMENT_SIZE(" << SEGMENT_SIZE << ")";
+    else if (bytes_transferred != (static_cast<std::size_t>(numSegments) * SEGMENT_SIZE)) {
+        LOG_ERROR(subprocess) << "error in BundleStorageManagerMT::HandleDiskOperationCompleted: bytes_transferred(" << bytes_transferred
+            << ") != numSegments(" << numSegments << ") * SEGMENT_SIZE(" << SEGMENT_SIZE << ")";
     }
     else {
-        std::atomic<bool> junk;
-        std::atomic<bool>& isReadCompletedRef = (wasReadOperation) ?
-            *m_circularBufferIsReadCompletedPointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire) : junk;
+        RecordDiskOperationCompleted(diskId, bytes_transferred,
+            static_cast<uint64_t>((boost::posix_time::microsec_clock::universal_time() - m_diskOperationStartTimesVec[diskId]).total_microseconds()));
         CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskId];
         m_mutexMainThread.lock();
-        isReadCompletedRef.store(true, std::memory_order_release);
-        cb.CommitRead();
+        for (unsigned int i = 0; i < numSegments; ++i) {
+            if (wasReadOperation) {
+                const unsigned int index = (consumeIndex + i) % CIRCULAR_INDEX_BUFFER_SIZE;
+                m_circularBufferIsReadCompletedPointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + index].load(std::memory_order_acquire)->store(true, std::memory_order_release);
+            }
+            cb.CommitRead();
+        }
         m_mutexMainThread.unlock();
-        m_conditionVariableMainThread.notify_one();
+        m_conditionVariableMainThread.notify_all(); //release workers may be waiting on reads too
         TryDiskOperation_Consume_NotThreadSafe(diskId);
     }
 }
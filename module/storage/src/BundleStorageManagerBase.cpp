@@ -17,11 +17,27 @@
 #include <boost/filesystem/path.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <memory>
+#include <algorithm>
 #include <boost/make_unique.hpp>
 #include <boost/endian/conversion.hpp>
 #include "codec/BundleViewV6.h"
 #include "codec/BundleViewV7.h"
 #include <boost/predef/os.h>
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/multiprecision/detail/bitscan.hpp>
+#include <fstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
  //#ifdef _MSC_VER //Windows tests
  //static const char * FILE_PATHS[NUM_STORAGE_THREADS] = { "map0.bin", "map1.bin", "map2.bin", "map3.bin" };
@@ -57,7 +73,7 @@ BOOST_FORCEINLINE void StorageSegmentHeader::ToNativeEndianInplace() {
 }
 
 BundleStorageManagerSession_ReadFromDisk::BundleStorageManagerSession_ReadFromDisk() :
-    readCache(new uint8_t[READ_CACHE_NUM_SEGMENTS_PER_SESSION * SEGMENT_SIZE]) {}
+    readCache(static_cast<uint8_t*>(boost::alignment::aligned_alloc(SEGMENT_BUFFER_ALIGNMENT, READ_CACHE_NUM_SEGMENTS_PER_SESSION * SEGMENT_SIZE))) {}
 
 BundleStorageManagerSession_ReadFromDisk::~BundleStorageManagerSession_ReadFromDisk() {}
 
@@ -77,22 +93,46 @@ BundleStorageManagerBase::BundleStorageManagerBase(const StorageConfig_ptr & sto
     M_NUM_STORAGE_DISKS((m_storageConfigPtr) ? static_cast<unsigned int>(m_storageConfigPtr->m_storageDiskConfigVector.size()) : 1),
     M_TOTAL_STORAGE_CAPACITY_BYTES((m_storageConfigPtr) ? m_storageConfigPtr->m_totalStorageCapacityBytes : 1),
     M_MAX_SEGMENTS(M_TOTAL_STORAGE_CAPACITY_BYTES / SEGMENT_SIZE),
+    M_MAX_SEGMENTS_PER_DISK_IO((m_storageConfigPtr) ?
+        static_cast<unsigned int>(std::max<uint64_t>(1, std::min<uint64_t>(CIRCULAR_INDEX_BUFFER_SIZE, m_storageConfigPtr->m_maxCoalescedDiskIoSizeBytes / SEGMENT_SIZE))) : 1),
     m_memoryManager(M_MAX_SEGMENTS),
     m_filePathsVec(M_NUM_STORAGE_DISKS),
+    m_blockDeviceSizeBytesVec(M_NUM_STORAGE_DISKS, 0),
+    m_directIoActiveVec(M_NUM_STORAGE_DISKS, 0),
 
     //https://stackoverflow.com/a/46686862
     m_tmpInitializerOfCircularIndexBuffersVec(M_NUM_STORAGE_DISKS, CIRCULAR_INDEX_BUFFER_SIZE), //count, value
     m_circularIndexBuffersVec(m_tmpInitializerOfCircularIndexBuffersVec.begin(), m_tmpInitializerOfCircularIndexBuffersVec.end()),
+    m_diskProducerMutexesVec(M_NUM_STORAGE_DISKS),
 
     m_circularBufferBlockDataPtr(NULL),
     m_circularBufferSegmentIdsPtr(NULL),
     m_circularBufferIsReadCompletedPointers(), //zero initialize
     m_circularBufferReadFromStoragePointers(), //zero initialize
     m_autoDeleteFilesOnExit((m_storageConfigPtr) ? m_storageConfigPtr->m_autoDeleteFilesOnExit : false),
+    M_RAM_HOT_TIER_MAX_BYTES((m_storageConfigPtr) ? m_storageConfigPtr->m_ramHotTierMaxBytes : 0),
+    M_RAM_HOT_TIER_MAX_RESIDENT_TIME(boost::posix_time::milliseconds((m_storageConfigPtr) ? m_storageConfigPtr->m_ramHotTierMaxResidentMilliseconds : 0)),
+    M_RAM_HOT_TIER_WRITE_CUSTODY_BUNDLES_IMMEDIATELY((m_storageConfigPtr) ? m_storageConfigPtr->m_ramHotTierWriteCustodyBundlesImmediately : true),
+    m_ramHotTierBytes(0),
+    m_ramHotTierNextSequence(0),
+    M_SMALL_BUNDLE_SLAB_MAX_SEGMENTS((m_storageConfigPtr) ? (m_storageConfigPtr->m_smallBundleSlabMaxBytes / SEGMENT_SIZE) : 0),
+    M_ADAPTIVE_DISK_STRIPING((m_storageConfigPtr) ? m_storageConfigPtr->m_adaptiveDiskStriping : false),
+    m_diskThroughputCountersVec(M_NUM_STORAGE_DISKS),
+    m_lastDiskBytesTransferredVec(M_NUM_STORAGE_DISKS, 0),
+    m_lastDiskBusyMicrosecondsVec(M_NUM_STORAGE_DISKS, 0),
+    m_diskThroughputBytesPerSecondVec(M_NUM_STORAGE_DISKS, 0),
+    m_diskStripingLoadsVec(M_NUM_STORAGE_DISKS, 0.0),
+    m_simulateFileSystemRejectsDirectIo(false),
     m_successfullyRestoredFromDisk(false),
+    m_successfullyRestoredFromCatalogJournal(false),
     m_totalBundlesRestored(0),
     m_totalBytesRestored(0),
-    m_totalSegmentsRestored(0)
+    m_totalSegmentsRestored(0),
+    m_totalBundlesWrittenFromRamHotTier(0),
+    m_totalBundlesRemovedFromRamHotTier(0),
+    m_totalSmallBundleSlabSegmentsWritten(0),
+    m_totalSmallBundlesDroppedFromRestore(0),
+    m_totalUnwrittenBundlesDroppedFromRestore(0)
 {
     m_tmpInitializerOfCircularIndexBuffersVec.resize(0);
     m_tmpInitializerOfCircularIndexBuffersVec.shrink_to_fit();
@@ -101,8 +141,51 @@ BundleStorageManagerBase::BundleStorageManagerBase(const StorageConfig_ptr & sto
         return;
     }
 
+    if (!ProbeBlockDevices()) {
+        LOG_ERROR(subprocess) << "invalid storage disks, storage will not start";
+        m_storageConfigPtr.reset(); //as if the config were invalid, so that Start() does nothing
+        return;
+    }
+
+    if (!m_storageConfigPtr->m_catalogJournalFilePath.empty()) {
+        m_catalogJournalPtr = boost::make_unique<BundleStorageCatalogJournal>(m_storageConfigPtr->m_catalogJournalFilePath,
+            m_storageConfigPtr->m_catalogJournalSnapshotIntervalRecords);
+    }
+
     if (m_storageConfigPtr->m_tryToRestoreFromDisk) {
-        m_successfullyRestoredFromDisk = RestoreFromDisk(&m_totalBundlesRestored, &m_totalBytesRestored, &m_totalSegmentsRestored);
+        if (m_catalogJournalPtr && m_catalogJournalPtr->Restore(m_bundleStorageCatalog, m_memoryManager,
+            m_totalBundlesRestored, m_totalBytesRestored, m_totalSegmentsRestored))
+        {
+            m_successfullyRestoredFromDisk = true;
+            m_successfullyRestoredFromCatalogJournal = true;
+        }
+        else {
+            if (m_catalogJournalPtr) {
+                LOG_WARNING(subprocess) << "unable to restore from the catalog journal, falling back to scanning every segment of every disk";
+            }
+            m_successfullyRestoredFromDisk = RestoreFromDisk(&m_totalBundlesRestored, &m_totalBytesRestored, &m_totalSegmentsRestored);
+        }
+        if (m_successfullyRestoredFromCatalogJournal) {
+            DropUnwrittenBundlesFromCatalogJournalRestore();
+        }
+        if (m_successfullyRestoredFromDisk) {
+            RestoreSmallBundleSlabs();
+        }
+    }
+
+    if (!m_successfullyRestoredFromDisk) {
+        for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+            if (m_blockDeviceSizeBytesVec[diskId] && (!ZeroBlockDevice(diskId))) {
+                m_storageConfigPtr.reset();
+                return;
+            }
+        }
+    }
+
+    //start a new journal generation from whatever was restored (nothing if not restored)
+    if (m_catalogJournalPtr && (!WriteCatalogSnapshotAndRestartJournal())) {
+        LOG_ERROR(subprocess) << "unable to start the catalog journal, continuing without it";
+        m_catalogJournalPtr.reset();
     }
 
 
@@ -116,19 +199,31 @@ BundleStorageManagerBase::BundleStorageManagerBase(const StorageConfig_ptr & sto
         return;
     }
 
-    m_circularBufferBlockDataPtr = (uint8_t*)malloc(CIRCULAR_INDEX_BUFFER_SIZE * M_NUM_STORAGE_DISKS * SEGMENT_SIZE * sizeof(uint8_t));
+    //aligned so that every segment slot (a multiple of 4KB) can be written to an O_DIRECT disk
+    m_circularBufferBlockDataPtr = (uint8_t*)boost::alignment::aligned_alloc(SEGMENT_BUFFER_ALIGNMENT, CIRCULAR_INDEX_BUFFER_SIZE * M_NUM_STORAGE_DISKS * SEGMENT_SIZE * sizeof(uint8_t));
     m_circularBufferSegmentIdsPtr = (segment_id_t*)malloc(CIRCULAR_INDEX_BUFFER_SIZE * M_NUM_STORAGE_DISKS * sizeof(segment_id_t));
 
 
 }
 
 BundleStorageManagerBase::~BundleStorageManagerBase() {
+    m_diskSpaceReclaimerPtr.reset(); //reclaims whatever is queued before the files can be deleted
 
-    free(m_circularBufferBlockDataPtr);
+    boost::alignment::aligned_free(m_circularBufferBlockDataPtr);
     free(m_circularBufferSegmentIdsPtr);
 
-    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
-        const boost::filesystem::path & p = m_filePathsVec[diskId];
+    std::vector<boost::filesystem::path> filePathsToDelete(m_filePathsVec);
+    if (m_catalogJournalPtr) {
+        m_catalogJournalPtr->Close();
+        filePathsToDelete.push_back(m_catalogJournalPtr->GetJournalFilePath());
+        filePathsToDelete.push_back(m_catalogJournalPtr->GetSnapshotFilePath());
+        filePathsToDelete.push_back(m_catalogJournalPtr->GetPreviousJournalFilePath());
+    }
+    for (std::size_t i = 0; i < filePathsToDelete.size(); ++i) {
+        const boost::filesystem::path & p = filePathsToDelete[i];
+        if ((i < m_blockDeviceSizeBytesVec.size()) && m_blockDeviceSizeBytesVec[i]) {
+            continue; //never delete a block device
+        }
 
         if (m_autoDeleteFilesOnExit && boost::filesystem::exists(p)) {
             if (boost::filesystem::remove(p)) {
@@ -148,50 +243,314 @@ const MemoryManagerTreeArray& BundleStorageManagerBase::GetMemoryManagerConstRef
 const BundleStorageCatalog& BundleStorageManagerBase::GetBundleStorageCatalogConstRef() const {
     return m_bundleStorageCatalog;
 }
+uint64_t BundleStorageManagerBase::GetNumAllocatedSegments() const noexcept {
+    //the disk space reclaimer frees segments from its own thread
+    return (m_diskSpaceReclaimerPtr) ? m_memoryManager.GetNumAllocatedSegments_ThreadSafe() : m_memoryManager.GetNumAllocatedSegments_NotThreadSafe();
+}
 uint64_t BundleStorageManagerBase::GetFreeSpaceBytes() const noexcept {
-    return (M_MAX_SEGMENTS - m_memoryManager.GetNumAllocatedSegments_NotThreadSafe()) * SEGMENT_SIZE;
+    return (M_MAX_SEGMENTS - GetNumAllocatedSegments()) * SEGMENT_SIZE;
 }
 uint64_t BundleStorageManagerBase::GetUsedSpaceBytes() const noexcept {
-    return m_memoryManager.GetNumAllocatedSegments_NotThreadSafe() * SEGMENT_SIZE;
+    return GetNumAllocatedSegments() * SEGMENT_SIZE;
 }
 uint64_t BundleStorageManagerBase::GetTotalCapacityBytes() const noexcept {
     return M_MAX_SEGMENTS * SEGMENT_SIZE;
 }
 
+bool BundleStorageManagerBase::GetBlockDeviceSizeBytes(const boost::filesystem::path & storeFilePath, uint64_t & blockDeviceSizeBytes) {
+    blockDeviceSizeBytes = 0;
+    boost::system::error_code ec;
+    if (boost::filesystem::status(storeFilePath, ec).type() != boost::filesystem::block_file) {
+        return true; //a store file (or one not created yet)
+    }
+#ifdef __linux__
+    const int fd = open(storeFilePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR(subprocess) << "error opening block device " << storeFilePath << ": " << strerror(errno);
+        return false;
+    }
+    uint64_t sizeBytes = 0;
+    const int ret = ioctl(fd, BLKGETSIZE64, &sizeBytes);
+    const int errnoValue = errno;
+    close(fd);
+    if (ret != 0) {
+        LOG_ERROR(subprocess) << "unable to get the size of block device " << storeFilePath << ": " << strerror(errnoValue);
+        return false;
+    }
+    if (sizeBytes == 0) {
+        LOG_ERROR(subprocess) << "block device " << storeFilePath << " has a size of 0 bytes";
+        return false;
+    }
+    blockDeviceSizeBytes = sizeBytes;
+    return true;
+#else
+    LOG_ERROR(subprocess) << storeFilePath << " is a block device, which is only supported as a storage disk on Linux";
+    return false;
+#endif
+}
+bool BundleStorageManagerBase::IsBlockDevice(const unsigned int diskId) const noexcept {
+    return (diskId < m_blockDeviceSizeBytesVec.size()) && (m_blockDeviceSizeBytesVec[diskId] != 0);
+}
+bool BundleStorageManagerBase::IsDirectIoActive(const unsigned int diskId) const noexcept {
+    return (diskId < m_directIoActiveVec.size()) && (m_directIoActiveVec[diskId] != 0);
+}
+uint64_t BundleStorageManagerBase::GetPerDiskCapacityBytes() const noexcept {
+    return ((M_MAX_SEGMENTS + M_NUM_STORAGE_DISKS - 1) / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
+}
+bool BundleStorageManagerBase::HasValidStorageConfig() const noexcept {
+    return static_cast<bool>(m_storageConfigPtr);
+}
+bool BundleStorageManagerBase::ProbeBlockDevices() {
+    if (m_storageConfigPtr->m_storageImplementation == "ram") {
+        return true; //never touches the disks
+    }
+    const uint64_t perDiskCapacityBytes = GetPerDiskCapacityBytes();
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        const storage_disk_config_t & diskConfig = m_storageConfigPtr->m_storageDiskConfigVector[diskId];
+        uint64_t & blockDeviceSizeBytes = m_blockDeviceSizeBytesVec[diskId];
+        if (!GetBlockDeviceSizeBytes(diskConfig.storeFilePath, blockDeviceSizeBytes)) {
+            return false;
+        }
+        if (blockDeviceSizeBytes == 0) {
+            continue;
+        }
+        if (blockDeviceSizeBytes < perDiskCapacityBytes) {
+            LOG_ERROR(subprocess) << "block device " << diskConfig.storeFilePath << " of disk " << diskId << " holds only "
+                << blockDeviceSizeBytes << " bytes but needs " << perDiskCapacityBytes
+                << " bytes (totalStorageCapacityBytes divided among " << M_NUM_STORAGE_DISKS << " disks)";
+            return false;
+        }
+        LOG_INFO(subprocess) << "disk " << diskId << " is block device " << diskConfig.storeFilePath << " of " << blockDeviceSizeBytes
+            << " bytes, using the first " << perDiskCapacityBytes << " bytes";
+        if (!diskConfig.useDirectIo) {
+            LOG_WARNING(subprocess) << "block device " << diskConfig.storeFilePath << " is not configured with useDirectIo, so its writes go through the page cache";
+        }
+    }
+    return true;
+}
+bool BundleStorageManagerBase::ZeroBlockDevice(const unsigned int diskId) {
+#ifdef __linux__
+    const std::string & filePath = m_storageConfigPtr->m_storageDiskConfigVector[diskId].storeFilePath;
+    const int fd = open(filePath.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_ERROR(subprocess) << "error opening block device " << filePath << ": " << strerror(errno);
+        return false;
+    }
+    //without this, a later restore by scanning would bring back the bundles of an earlier run
+    uint64_t range[2] = { 0, GetPerDiskCapacityBytes() };
+    LOG_INFO(subprocess) << "zeroing the first " << range[1] << " bytes of block device " << filePath;
+    const int ret = ioctl(fd, BLKZEROOUT, &range);
+    const int errnoValue = errno;
+    close(fd);
+    if (ret != 0) {
+        LOG_ERROR(subprocess) << "unable to zero block device " << filePath << ": " << strerror(errnoValue);
+        return false;
+    }
+    return true;
+#else
+    (void)diskId;
+    return false; //ProbeBlockDevices already failed
+#endif
+}
+
+void BundleStorageManagerBase::RecordDiskOperationCompleted(const unsigned int diskId, const uint64_t bytesTransferred, const uint64_t busyMicroseconds) noexcept {
+    disk_throughput_counters_t & counters = m_diskThroughputCountersVec[diskId];
+    counters.bytesTransferred.fetch_add(bytesTransferred, std::memory_order_relaxed);
+    counters.busyMicroseconds.fetch_add(busyMicroseconds, std::memory_order_relaxed);
+}
+std::vector<uint64_t> BundleStorageManagerBase::GetDiskThroughputBytesPerSecond() {
+    boost::mutex::scoped_lock lock(m_diskStripingMutex);
+    UpdateDiskThroughputIfDue_NotThreadSafe(boost::posix_time::microsec_clock::universal_time());
+    return m_diskThroughputBytesPerSecondVec;
+}
+uint64_t BundleStorageManagerBase::GetAdaptiveStripingAllowedDisksMask() {
+    boost::mutex::scoped_lock lock(m_diskStripingMutex);
+    return GetAdaptiveStripingAllowedDisksMask_NotThreadSafe();
+}
+void BundleStorageManagerBase::UpdateDiskThroughputIfDue_NotThreadSafe(const boost::posix_time::ptime & nowPtime) {
+    if ((!m_nextDiskThroughputUpdateTime.is_not_a_date_time()) && (nowPtime < m_nextDiskThroughputUpdateTime)) {
+        return;
+    }
+    bool measuredAny = false;
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        const disk_throughput_counters_t & counters = m_diskThroughputCountersVec[diskId];
+        const uint64_t bytesTransferred = counters.bytesTransferred.load(std::memory_order_relaxed);
+        const uint64_t busyMicroseconds = counters.busyMicroseconds.load(std::memory_order_relaxed);
+        const uint64_t deltaBytes = bytesTransferred - m_lastDiskBytesTransferredVec[diskId];
+        const uint64_t deltaMicroseconds = busyMicroseconds - m_lastDiskBusyMicrosecondsVec[diskId];
+        if ((deltaBytes == 0) || (deltaMicroseconds == 0)) {
+            continue; //idle this interval, keep the last measurement
+        }
+        m_lastDiskBytesTransferredVec[diskId] = bytesTransferred;
+        m_lastDiskBusyMicrosecondsVec[diskId] = busyMicroseconds;
+        const uint64_t measured = static_cast<uint64_t>((static_cast<double>(deltaBytes) * 1000000.0) / static_cast<double>(deltaMicroseconds));
+        uint64_t & throughput = m_diskThroughputBytesPerSecondVec[diskId];
+        throughput = (throughput == 0) ? measured : ((throughput / 2) + (measured / 2)); //smooth out single slow intervals
+        measuredAny = true;
+    }
+    if (measuredAny || m_nextDiskThroughputUpdateTime.is_not_a_date_time()) {
+        m_nextDiskThroughputUpdateTime = nowPtime + boost::posix_time::milliseconds(ADAPTIVE_DISK_STRIPING_UPDATE_INTERVAL_MILLISECONDS);
+    }
+}
+uint64_t BundleStorageManagerBase::GetAdaptiveStripingAllowedDisksMask_NotThreadSafe() const {
+    uint64_t allowedDisksMask = 0;
+    for (unsigned int diskId = 0; diskId < std::min(M_NUM_STORAGE_DISKS, 64u); ++diskId) {
+        //the loads are relative to the least loaded disk (which is 0), so at least one disk is always allowed
+        if ((!M_ADAPTIVE_DISK_STRIPING) || (m_diskStripingLoadsVec[diskId] < ADAPTIVE_DISK_STRIPING_SLACK_SEGMENTS)) {
+            allowedDisksMask |= (static_cast<uint64_t>(1) << diskId);
+        }
+    }
+    return allowedDisksMask;
+}
+bool BundleStorageManagerBase::AllocateBundleSegmentExtents(const uint64_t numSegments, segment_id_extents_vec_t & extentsVec) {
+    if ((!M_ADAPTIVE_DISK_STRIPING) || (M_NUM_STORAGE_DISKS < 2) || (M_NUM_STORAGE_DISKS > 64)) {
+        return m_memoryManager.AllocateSegmentExtents_ThreadSafe(numSegments, extentsVec);
+    }
+    boost::mutex::scoped_lock lock(m_diskStripingMutex);
+    UpdateDiskThroughputIfDue_NotThreadSafe(boost::posix_time::microsec_clock::universal_time());
+    if (!m_memoryManager.AllocateSegmentExtentsOnDisks_ThreadSafe(numSegments, M_NUM_STORAGE_DISKS,
+        GetAdaptiveStripingAllowedDisksMask_NotThreadSafe(), extentsVec))
+    {
+        return false;
+    }
+
+    //charge each disk for its new segments, scaled by how much slower than the fastest disk it is (unmeasured disks count as the fastest)
+    const uint64_t maxThroughput = *std::max_element(m_diskThroughputBytesPerSecondVec.cbegin(), m_diskThroughputBytesPerSecondVec.cend());
+    for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+        const segment_id_extent_t & extent = extentsVec[i];
+        const uint64_t numFullStripes = extent.numSegments / M_NUM_STORAGE_DISKS;
+        const uint64_t numRemaining = extent.numSegments % M_NUM_STORAGE_DISKS;
+        const unsigned int firstDiskId = static_cast<unsigned int>(extent.beginSegmentId % M_NUM_STORAGE_DISKS);
+        for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+            const uint64_t numSegmentsOnDisk = numFullStripes + ((((diskId + M_NUM_STORAGE_DISKS - firstDiskId) % M_NUM_STORAGE_DISKS) < numRemaining) ? 1 : 0);
+            const uint64_t throughput = m_diskThroughputBytesPerSecondVec[diskId];
+            const double slowness = (throughput == 0) ? 1.0 : (static_cast<double>(maxThroughput) / static_cast<double>(throughput));
+            m_diskStripingLoadsVec[diskId] += static_cast<double>(numSegmentsOnDisk) * slowness;
+        }
+    }
+    const double minLoad = *std::min_element(m_diskStripingLoadsVec.cbegin(), m_diskStripingLoadsVec.cend());
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        m_diskStripingLoadsVec[diskId] -= minLoad;
+    }
+    return true;
+}
+
+void BundleStorageManagerBase::StartDiskSpaceReclaimer() {
+    if ((!m_storageConfigPtr) || (m_storageConfigPtr->m_diskSpaceReclaimMaxBytesPerSecond == 0) || m_diskSpaceReclaimerPtr) {
+        return;
+    }
+#ifdef __linux__
+    LOG_INFO(subprocess) << "reclaiming the disk space of removed bundles at up to "
+        << m_storageConfigPtr->m_diskSpaceReclaimMaxBytesPerSecond << " bytes per second";
+    m_diskSpaceReclaimerPtr = boost::make_unique<DiskSpaceReclaimer>(m_filePathsVec,
+        m_storageConfigPtr->m_diskSpaceReclaimMaxBytesPerSecond, m_memoryManager);
+#else
+    LOG_WARNING(subprocess) << "diskSpaceReclaimMaxBytesPerSecond is only supported on Linux, freed disk space will not be reclaimed";
+#endif
+}
+bool BundleStorageManagerBase::FreeRemovedSegmentExtents(const segment_id_extents_vec_t & extentsVec) {
+    if (m_diskSpaceReclaimerPtr) {
+        m_diskSpaceReclaimerPtr->QueueFreedSegmentExtents(extentsVec);
+        return true;
+    }
+    return m_memoryManager.FreeSegmentExtents_ThreadSafe(extentsVec);
+}
+uint64_t BundleStorageManagerBase::GetTotalBytesReclaimedFromDisk() const noexcept {
+    return (m_diskSpaceReclaimerPtr) ? m_diskSpaceReclaimerPtr->GetTotalBytesReclaimed() : 0;
+}
+uint64_t BundleStorageManagerBase::GetTotalDiskSpaceReclaimOperations() const noexcept {
+    return (m_diskSpaceReclaimerPtr) ? m_diskSpaceReclaimerPtr->GetTotalReclaimOperations() : 0;
+}
+uint64_t BundleStorageManagerBase::GetTotalBytesFreedWithoutReclaiming() const noexcept {
+    return (m_diskSpaceReclaimerPtr) ? m_diskSpaceReclaimerPtr->GetTotalBytesFreedWithoutReclaiming() : 0;
+}
+void BundleStorageManagerBase::WaitUntilRemovedSegmentsFreed() {
+    if (m_diskSpaceReclaimerPtr) {
+        m_diskSpaceReclaimerPtr->WaitUntilQueuedExtentsFreed();
+    }
+}
+
+
+//the bundles still in the RAM hot tier are left out, since they are journaled (AppendAdd) only once written to disk
+//and are never journaled at all (AppendRemove) if they are removed before then
+bool BundleStorageManagerBase::WriteCatalogSnapshotAndRestartJournal() {
+    std::vector<std::pair<uint64_t, const catalog_entry_t*> > custodyIdAndEntryPtrs;
+    m_bundleStorageCatalog.GetAllEntries(custodyIdAndEntryPtrs);
+    if (!m_ramHotTierMap.empty()) {
+        custodyIdAndEntryPtrs.erase(std::remove_if(custodyIdAndEntryPtrs.begin(), custodyIdAndEntryPtrs.end(),
+            [this](const std::pair<uint64_t, const catalog_entry_t*> & p) { return (m_ramHotTierMap.count(p.second) != 0); }),
+            custodyIdAndEntryPtrs.end());
+    }
+    return m_catalogJournalPtr->WriteSnapshotAndRestartJournal(custodyIdAndEntryPtrs);
+}
+
+bool BundleStorageManagerBase::IsCatalogJournalEnabled() const noexcept {
+    return static_cast<bool>(m_catalogJournalPtr);
+}
+
+uint8_t * BundleStorageManagerBase::GetSegmentMemoryPtr(const segment_id_t) noexcept {
+    return NULL;
+}
+
+unsigned int BundleStorageManagerBase::GetNumCoalescableDiskOperations(const unsigned int diskId, const unsigned int consumeIndex) const {
+    const unsigned int maxOperations = std::min(m_circularIndexBuffersVec[diskId].NumInBuffer(), M_MAX_SEGMENTS_PER_DISK_IO);
+    const segment_id_t * const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE];
+    const std::atomic<uint8_t*> * const readFromStoragePointers = &m_circularBufferReadFromStoragePointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE];
+    const segment_id_t firstSegmentId = circularBufferSegmentIdsPtr[consumeIndex];
+    const bool isWriteToDisk = (readFromStoragePointers[consumeIndex].load(std::memory_order_acquire) == NULL);
+    unsigned int numOperations = 1;
+    for (; numOperations < maxOperations; ++numOperations) {
+        const unsigned int index = (consumeIndex + numOperations) % CIRCULAR_INDEX_BUFFER_SIZE;
+        if ((circularBufferSegmentIdsPtr[index] != (firstSegmentId + (numOperations * M_NUM_STORAGE_DISKS)))
+            || ((readFromStoragePointers[index].load(std::memory_order_acquire) == NULL) != isWriteToDisk))
+        {
+            break;
+        }
+    }
+    return numOperations;
+}
 
 uint64_t BundleStorageManagerBase::Push(BundleStorageManagerSession_WriteToDisk & session, const PrimaryBlock & bundlePrimaryBlock, const uint64_t bundleSizeBytes, 
         const uint64_t payloadSizeBytes, cbhe_eid_t *bundleEidMaskPtr) {
     catalog_entry_t & catalogEntry = session.catalogEntry;
-    segment_id_chain_vec_t & segmentIdChainVec = catalogEntry.segmentIdChainVec;
     const uint64_t totalSegmentsRequired = (bundleSizeBytes / BUNDLE_STORAGE_PER_SEGMENT_SIZE) + ((bundleSizeBytes % BUNDLE_STORAGE_PER_SEGMENT_SIZE) == 0 ? 0 : 1);
-    catalogEntry.Init(bundlePrimaryBlock, bundleSizeBytes, payloadSizeBytes, totalSegmentsRequired, NULL, bundleEidMaskPtr); //NULL replaced later at CatalogIncomingBundleForStore
+    catalogEntry.Init(bundlePrimaryBlock, bundleSizeBytes, payloadSizeBytes, NULL, bundleEidMaskPtr); //NULL replaced later at CatalogIncomingBundleForStore
     session.nextLogicalSegment = 0;
+    session.nextSegmentCursor.Reset();
 
+    if (M_SMALL_BUNDLE_SLAB_MAX_SEGMENTS && (bundleSizeBytes <= GetSmallBundleSlabMaxBundleSizeBytes())
+        && AllocateSmallBundleSlabSlot(bundleSizeBytes, catalogEntry))
+    {
+        return 1; //falls back to segments of its own once the slabs are full
+    }
 
-    if (m_memoryManager.AllocateSegments_ThreadSafe(segmentIdChainVec)) {
+    if (AllocateBundleSegmentExtents(totalSegmentsRequired, catalogEntry.segmentIdExtentsVec)) {
         return totalSegmentsRequired;
     }
 
     return 0;
 }
 
-int BundleStorageManagerBase::PushSegment(BundleStorageManagerSession_WriteToDisk & session, const PrimaryBlock & bundlePrimaryBlock,
-    const uint64_t custodyId, const uint8_t * buf, std::size_t size)
+//queue one segment (with its storage segment header) to be written to its disk
+void BundleStorageManagerBase::WriteSegmentToDisk(const segment_id_t segmentId, const segment_id_t nextSegmentId,
+    const bool isFirstLogicalSegment, const catalog_entry_t & catalogEntry, const uint64_t custodyId, const uint8_t * buf, std::size_t size)
 {
-    catalog_entry_t & catalogEntry = session.catalogEntry;
-    segment_id_chain_vec_t & segmentIdChainVec = catalogEntry.segmentIdChainVec;
-
-    if (session.nextLogicalSegment >= segmentIdChainVec.size()) {
-        return 0;
-    }
     StorageSegmentHeaderUnion storageSegmentHeaderUnion;
     StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
     //note: SEGMENT_RESERVED_SPACE is 4 bytes smaller than sizeof(StorageSegmentHeader) if segment_id_t is 32-bit
-    storageSegmentHeader.bundleSizeBytes = (session.nextLogicalSegment == 0) ? catalogEntry.bundleSizeBytes : UINT64_MAX;
-    storageSegmentHeader.payloadSizeBytes = (session.nextLogicalSegment == 0) ? catalogEntry.payloadSizeBytes : UINT64_MAX;
-    const segment_id_t segmentId = segmentIdChainVec[session.nextLogicalSegment++];
+    storageSegmentHeader.bundleSizeBytes = (isFirstLogicalSegment) ? catalogEntry.bundleSizeBytes : UINT64_MAX;
+    storageSegmentHeader.payloadSizeBytes = (isFirstLogicalSegment) ? catalogEntry.payloadSizeBytes : UINT64_MAX;
+    storageSegmentHeader.nextSegmentId = nextSegmentId;
+    storageSegmentHeader.custodyId = custodyId;
+    storageSegmentHeader.ToLittleEndianInplace(); //should optimize out and do nothing
+    if (uint8_t * const segmentMemoryPtr = GetSegmentMemoryPtr(segmentId)) { //written in place, there is no disk operation to queue
+        memcpy(segmentMemoryPtr, storageSegmentHeaderUnion.rawBytes, SEGMENT_RESERVED_SPACE);
+        memcpy(segmentMemoryPtr + SEGMENT_RESERVED_SPACE, buf, size);
+        return;
+    }
     const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
     CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskIndex];
+    boost::mutex::scoped_lock lockProducer(m_diskProducerMutexesVec[diskIndex]);
     unsigned int produceIndex = cb.GetIndexForWrite();
     while (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full, wait until not full	
         //try again, but with the mutex
@@ -212,15 +571,47 @@ int BundleStorageManagerBase::PushSegment(BundleStorageManagerSession_WriteToDis
     circularBufferSegmentIdsPtr[produceIndex] = segmentId;
     m_circularBufferReadFromStoragePointers[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex].store(NULL, std::memory_order_release); //isWriteToDisk = true
 
-    storageSegmentHeader.nextSegmentId = (session.nextLogicalSegment == segmentIdChainVec.size()) ? SEGMENT_ID_LAST : segmentIdChainVec[session.nextLogicalSegment];
-    storageSegmentHeader.custodyId = custodyId;
-    storageSegmentHeader.ToLittleEndianInplace(); //should optimize out and do nothing
     memcpy(dataCb, storageSegmentHeaderUnion.rawBytes, SEGMENT_RESERVED_SPACE);
     memcpy(dataCb + SEGMENT_RESERVED_SPACE, buf, size);
 
     CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(diskIndex);
-    if (session.nextLogicalSegment == segmentIdChainVec.size()) {
-        m_bundleStorageCatalog.CatalogIncomingBundleForStore(catalogEntry, bundlePrimaryBlock, custodyId, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO);
+}
+
+int BundleStorageManagerBase::PushSegment(BundleStorageManagerSession_WriteToDisk & session, const PrimaryBlock & bundlePrimaryBlock,
+    const uint64_t custodyId, const uint8_t * buf, std::size_t size)
+{
+    catalog_entry_t & catalogEntry = session.catalogEntry;
+    const segment_id_extents_vec_t & segmentIdExtentsVec = catalogEntry.segmentIdExtentsVec;
+
+    bool isLastLogicalSegment;
+    if (catalogEntry.IsInSmallBundleSlab()) { //the whole bundle is the only logical segment
+        if (session.nextLogicalSegment != 0) { //already pushed
+            return 0;
+        }
+        ++session.nextLogicalSegment;
+        WriteBundleToSmallBundleSlab(catalogEntry, custodyId, buf, size);
+        isLastLogicalSegment = true;
+    }
+    else {
+        const segment_id_t segmentId = session.nextSegmentCursor.Get(segmentIdExtentsVec);
+        if (segmentId == SEGMENT_ID_LAST) { //all segments already pushed
+            return 0;
+        }
+        const bool isFirstLogicalSegment = (session.nextLogicalSegment == 0);
+        ++session.nextLogicalSegment;
+        session.nextSegmentCursor.Advance(segmentIdExtentsVec);
+        const segment_id_t nextSegmentId = session.nextSegmentCursor.Get(segmentIdExtentsVec); //SEGMENT_ID_LAST if this is the last segment
+        WriteSegmentToDisk(segmentId, nextSegmentId, isFirstLogicalSegment, catalogEntry, custodyId, buf, size);
+        isLastLogicalSegment = (nextSegmentId == SEGMENT_ID_LAST);
+    }
+    if (isLastLogicalSegment) {
+        if (m_bundleStorageCatalog.CatalogIncomingBundleForStore(catalogEntry, bundlePrimaryBlock, custodyId, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO)
+            && m_catalogJournalPtr)
+        {
+            if (!m_catalogJournalPtr->AppendAdd(custodyId, *m_bundleStorageCatalog.GetEntryFromCustodyId(custodyId))) {
+                m_catalogJournalPtr.reset(); //disabled (and its files deleted) by the failure
+            }
+        }
     }
 
     return 1;
@@ -231,8 +622,13 @@ uint64_t BundleStorageManagerBase::PushAllSegments(BundleStorageManagerSession_W
     const PrimaryBlock & bundlePrimaryBlock,
     const uint64_t custodyId, const uint8_t * allData, const std::size_t allDataSize)
 {
+    if (M_RAM_HOT_TIER_MAX_BYTES && (allDataSize <= M_RAM_HOT_TIER_MAX_BYTES)
+        && (!(M_RAM_HOT_TIER_WRITE_CUSTODY_BUNDLES_IMMEDIATELY && session.catalogEntry.HasCustody())))
+    {
+        return PushAllSegmentsToRamHotTier(session, bundlePrimaryBlock, custodyId, allData, allDataSize);
+    }
     uint64_t totalBytesCopied = 0;
-    const uint64_t totalSegmentsRequired = session.catalogEntry.segmentIdChainVec.size();
+    const uint64_t totalSegmentsRequired = session.catalogEntry.GetNumSegments();
     for (uint64_t i = 0; i < totalSegmentsRequired; ++i) {
         std::size_t bytesToCopy = BUNDLE_STORAGE_PER_SEGMENT_SIZE;
         if (i == totalSegmentsRequired - 1) {
@@ -249,6 +645,321 @@ uint64_t BundleStorageManagerBase::PushAllSegments(BundleStorageManagerSession_W
     }
     return totalBytesCopied;
 }
+//catalog the bundle now but keep its data in RAM; its (already allocated) segments are written later
+//by FlushRamHotTier, or never if the bundle is removed first
+uint64_t BundleStorageManagerBase::PushAllSegmentsToRamHotTier(BundleStorageManagerSession_WriteToDisk & session,
+    const PrimaryBlock & bundlePrimaryBlock,
+    const uint64_t custodyId, const uint8_t * allData, const std::size_t allDataSize)
+{
+    if (!m_bundleStorageCatalog.CatalogIncomingBundleForStore(session.catalogEntry, bundlePrimaryBlock, custodyId, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO)) {
+        LOG_ERROR(subprocess) << "unable to catalog custody id " << custodyId << " for the ram hot tier";
+        return 0;
+    }
+    const catalog_entry_t * catalogEntryPtr = m_bundleStorageCatalog.GetEntryFromCustodyId(custodyId);
+    std::pair<ram_hot_tier_map_t::iterator, bool> ret = m_ramHotTierMap.emplace(catalogEntryPtr, ram_hot_tier_bundle_t());
+    if (!ret.second) {
+        LOG_ERROR(subprocess) << "custody id " << custodyId << " is already in the ram hot tier";
+        return 0;
+    }
+    ram_hot_tier_bundle_t & hotBundle = ret.first->second;
+    hotBundle.custodyId = custodyId;
+    hotBundle.sequence = m_ramHotTierNextSequence++;
+    hotBundle.bundleData.assign(allData, allData + allDataSize);
+    m_ramHotTierFifo.push_back(ram_hot_tier_fifo_record_t{ catalogEntryPtr, hotBundle.sequence,
+        boost::posix_time::microsec_clock::universal_time() + M_RAM_HOT_TIER_MAX_RESIDENT_TIME });
+    m_ramHotTierBytes += allDataSize;
+
+    //memory pressure: write the oldest bundles to disk
+    while ((m_ramHotTierBytes > M_RAM_HOT_TIER_MAX_BYTES) && (!m_ramHotTierFifo.empty())) {
+        FlushFrontOfRamHotTierFifo();
+    }
+    return allDataSize;
+}
+
+//pop the oldest fifo record and write its bundle to disk, returns false if that bundle was already removed
+bool BundleStorageManagerBase::FlushFrontOfRamHotTierFifo() {
+    const ram_hot_tier_fifo_record_t record = m_ramHotTierFifo.front();
+    m_ramHotTierFifo.pop_front();
+    ram_hot_tier_map_t::iterator it = m_ramHotTierMap.find(record.catalogEntryPtr);
+    if ((it == m_ramHotTierMap.end()) || (it->second.sequence != record.sequence)) {
+        return false;
+    }
+    const catalog_entry_t & catalogEntry = *(it->first);
+    const ram_hot_tier_bundle_t & hotBundle = it->second;
+    const segment_id_extents_vec_t & segmentIdExtentsVec = catalogEntry.segmentIdExtentsVec;
+    segment_id_extents_cursor_t cursor;
+    cursor.Reset();
+    const uint8_t * data = hotBundle.bundleData.data();
+    uint64_t bytesRemaining = hotBundle.bundleData.size();
+    bool isFirstLogicalSegment = true;
+    if (catalogEntry.IsInSmallBundleSlab()) {
+        WriteBundleToSmallBundleSlab(catalogEntry, hotBundle.custodyId, data, static_cast<std::size_t>(bytesRemaining));
+    }
+    else {
+        for (segment_id_t segmentId = cursor.Get(segmentIdExtentsVec); segmentId != SEGMENT_ID_LAST; ) {
+            cursor.Advance(segmentIdExtentsVec);
+            const segment_id_t nextSegmentId = cursor.Get(segmentIdExtentsVec); //SEGMENT_ID_LAST if this is the last segment
+            const std::size_t size = static_cast<std::size_t>(std::min<uint64_t>(bytesRemaining, BUNDLE_STORAGE_PER_SEGMENT_SIZE));
+            WriteSegmentToDisk(segmentId, nextSegmentId, isFirstLogicalSegment, catalogEntry, hotBundle.custodyId, data, size);
+            isFirstLogicalSegment = false;
+            data += size;
+            bytesRemaining -= size;
+            segmentId = nextSegmentId;
+        }
+    }
+    if (m_catalogJournalPtr) { //journaled only once written so that a restore never finds a bundle missing from the disk
+        if (!m_catalogJournalPtr->AppendAdd(hotBundle.custodyId, catalogEntry)) {
+            m_catalogJournalPtr.reset(); //disabled (and its files deleted) by the failure
+        }
+    }
+    m_ramHotTierBytes -= hotBundle.bundleData.size();
+    m_ramHotTierMap.erase(it);
+    ++m_totalBundlesWrittenFromRamHotTier;
+    return true;
+}
+
+std::size_t BundleStorageManagerBase::FlushRamHotTier(const boost::posix_time::ptime & nowPtime) {
+    std::size_t numFlushed = 0;
+    while ((!m_ramHotTierFifo.empty()) && (m_ramHotTierFifo.front().writeToDiskTime <= nowPtime)) {
+        numFlushed += FlushFrontOfRamHotTierFifo();
+    }
+    return numFlushed;
+}
+
+std::size_t BundleStorageManagerBase::FlushAllOfRamHotTier() {
+    std::size_t numFlushed = 0;
+    while (!m_ramHotTierFifo.empty()) {
+        numFlushed += FlushFrontOfRamHotTierFifo();
+    }
+    return numFlushed;
+}
+
+bool BundleStorageManagerBase::IsInRamHotTier(const catalog_entry_t * catalogEntryPtr) const {
+    return (m_ramHotTierMap.count(catalogEntryPtr) != 0);
+}
+
+uint64_t BundleStorageManagerBase::GetRamHotTierBytes() const noexcept {
+    return m_ramHotTierBytes;
+}
+
+std::size_t BundleStorageManagerBase::GetRamHotTierNumBundles() const noexcept {
+    return m_ramHotTierMap.size();
+}
+
+std::size_t BundleStorageManagerBase::GetNumSmallBundleSlabs() const noexcept {
+    return m_smallBundleSlabsMap.size();
+}
+
+uint64_t BundleStorageManagerBase::GetSmallBundleSlabSlotSize(const unsigned int sizeClassIndex) noexcept {
+    return static_cast<uint64_t>(SMALL_BUNDLE_SLAB_MIN_SLOT_SIZE) << sizeClassIndex;
+}
+
+unsigned int BundleStorageManagerBase::GetSmallBundleSlabNumSlots(const unsigned int sizeClassIndex) noexcept {
+    return static_cast<unsigned int>(std::min<uint64_t>(SMALL_BUNDLE_SLAB_MAX_SLOTS, BUNDLE_STORAGE_PER_SEGMENT_SIZE / GetSmallBundleSlabSlotSize(sizeClassIndex)));
+}
+
+uint64_t BundleStorageManagerBase::GetSmallBundleSlabMaxBundleSizeBytes() noexcept {
+    return GetSmallBundleSlabSlotSize(SMALL_BUNDLE_SLAB_NUM_SIZE_CLASSES - 1) - SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE;
+}
+
+//reserve a slot of the smallest size class that fits the bundle, opening a new slab if none of that class has a free slot,
+//returns false if a new slab is needed but the slabs are at their limit (or the disks are full)
+bool BundleStorageManagerBase::AllocateSmallBundleSlabSlot(const uint64_t bundleSizeBytes, catalog_entry_t & catalogEntry) {
+    unsigned int sizeClassIndex = 0;
+    while ((bundleSizeBytes + SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE) > GetSmallBundleSlabSlotSize(sizeClassIndex)) {
+        ++sizeClassIndex;
+    }
+    std::set<segment_id_t> & slabsWithFreeSlots = m_smallBundleSlabsWithFreeSlotsSets[sizeClassIndex];
+    small_bundle_slab_map_t::iterator it;
+    if (!slabsWithFreeSlots.empty()) {
+        it = m_smallBundleSlabsMap.find(*slabsWithFreeSlots.cbegin());
+    }
+    else {
+        if (m_smallBundleSlabsMap.size() >= M_SMALL_BUNDLE_SLAB_MAX_SEGMENTS) {
+            return false;
+        }
+        segment_id_extents_vec_t newSlabExtentsVec;
+        if (!m_memoryManager.AllocateSegmentExtents_ThreadSafe(1, newSlabExtentsVec)) {
+            return false;
+        }
+        const segment_id_t slabSegmentId = newSlabExtentsVec[0].beginSegmentId;
+        it = m_smallBundleSlabsMap.emplace(slabSegmentId, small_bundle_slab_t()).first;
+        small_bundle_slab_t & newSlab = it->second;
+        newSlab.sizeClassIndex = sizeClassIndex;
+        newSlab.usedSlotsMask = 0;
+        newSlab.segmentImage.reset(new uint8_t[SEGMENT_SIZE]()); //zeroed so every slot is free
+        newSlab.isOnDisk = false;
+        StorageSegmentHeaderUnion storageSegmentHeaderUnion;
+        StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
+        storageSegmentHeader.bundleSizeBytes = SMALL_BUNDLE_SLAB_HEADER_BUNDLE_SIZE;
+        storageSegmentHeader.payloadSizeBytes = GetSmallBundleSlabSlotSize(sizeClassIndex);
+        storageSegmentHeader.custodyId = UINT64_MAX;
+        storageSegmentHeader.nextSegmentId = SEGMENT_ID_LAST;
+        storageSegmentHeader.ToLittleEndianInplace(); //should optimize out and do nothing
+        memcpy(newSlab.segmentImage.get(), storageSegmentHeaderUnion.rawBytes, SEGMENT_RESERVED_SPACE);
+        slabsWithFreeSlots.insert(slabSegmentId);
+    }
+    small_bundle_slab_t & slab = it->second;
+    const unsigned int slotIndex = boost::multiprecision::detail::find_lsb<uint64_t>(~slab.usedSlotsMask);
+    slab.usedSlotsMask |= (static_cast<uint64_t>(1) << slotIndex);
+    const uint64_t allSlotsMask = UINT64_MAX >> (SMALL_BUNDLE_SLAB_MAX_SLOTS - GetSmallBundleSlabNumSlots(sizeClassIndex));
+    if (slab.usedSlotsMask == allSlotsMask) {
+        slabsWithFreeSlots.erase(it->first);
+    }
+    catalogEntry.segmentIdExtentsVec = { segment_id_extent_t{ it->first, static_cast<segment_id_t>(SMALL_BUNDLE_SLAB_EXTENT_FLAG | slotIndex) } };
+    return true;
+}
+
+//copy the bundle into its slot of the slab mirror (written to the disk by the next flush)
+void BundleStorageManagerBase::WriteBundleToSmallBundleSlab(const catalog_entry_t & catalogEntry, const uint64_t custodyId, const uint8_t * buf, std::size_t size) {
+    const segment_id_t slabSegmentId = catalogEntry.segmentIdExtentsVec[0].beginSegmentId;
+    small_bundle_slab_map_t::iterator it = m_smallBundleSlabsMap.find(slabSegmentId);
+    if (it == m_smallBundleSlabsMap.end()) {
+        LOG_ERROR(subprocess) << "custody id " << custodyId << " refers to a small bundle slab segment " << slabSegmentId << " which does not exist";
+        return;
+    }
+    small_bundle_slab_t & slab = it->second;
+    uint8_t * const slot = slab.segmentImage.get() + SEGMENT_RESERVED_SPACE
+        + (catalogEntry.GetSmallBundleSlabSlotIndex() * GetSmallBundleSlabSlotSize(slab.sizeClassIndex));
+    const uint64_t custodyIdLittleEndian = boost::endian::native_to_little(custodyId);
+    const uint32_t bundleSizeBytesLittleEndian = boost::endian::native_to_little(static_cast<uint32_t>(size));
+    const uint32_t payloadSizeBytesLittleEndian = boost::endian::native_to_little(static_cast<uint32_t>(catalogEntry.payloadSizeBytes));
+    memcpy(slot, &custodyIdLittleEndian, sizeof(custodyIdLittleEndian));
+    memcpy(slot + sizeof(uint64_t), &bundleSizeBytesLittleEndian, sizeof(bundleSizeBytesLittleEndian));
+    memcpy(slot + sizeof(uint64_t) + sizeof(uint32_t), &payloadSizeBytesLittleEndian, sizeof(payloadSizeBytesLittleEndian));
+    memcpy(slot + SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE, buf, size);
+    MarkSmallBundleSlabDirty(slabSegmentId, static_cast<std::size_t>(slot - slab.segmentImage.get()), SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE + size);
+}
+
+std::size_t BundleStorageManagerBase::ReadBundleFromSmallBundleSlab(BundleStorageManagerSession_ReadFromDisk & session, void * buf) {
+    if (session.nextLogicalSegment != 0) { //already read
+        return 0;
+    }
+    const catalog_entry_t & catalogEntry = *session.catalogEntryPtr;
+    const segment_id_t slabSegmentId = catalogEntry.segmentIdExtentsVec[0].beginSegmentId;
+    small_bundle_slab_map_t::const_iterator it = m_smallBundleSlabsMap.find(slabSegmentId);
+    if (it == m_smallBundleSlabsMap.cend()) {
+        LOG_ERROR(subprocess) << "Error: custody id " << session.custodyId << " refers to a small bundle slab segment " << slabSegmentId << " which does not exist";
+        return 0;
+    }
+    const small_bundle_slab_t & slab = it->second;
+    const uint8_t * const slot = slab.segmentImage.get() + SEGMENT_RESERVED_SPACE
+        + (catalogEntry.GetSmallBundleSlabSlotIndex() * GetSmallBundleSlabSlotSize(slab.sizeClassIndex));
+    uint64_t custodyIdLittleEndian;
+    memcpy(&custodyIdLittleEndian, slot, sizeof(custodyIdLittleEndian));
+    if (boost::endian::little_to_native(custodyIdLittleEndian) != session.custodyId) {
+        LOG_ERROR(subprocess) << "Error: read slab slot custody id = " << boost::endian::little_to_native(custodyIdLittleEndian)
+            << " does not match custody id = " << session.custodyId;
+    }
+    const std::size_t size = static_cast<std::size_t>(catalogEntry.bundleSizeBytes);
+    memcpy(buf, slot + SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE, size);
+    ++session.nextLogicalSegment;
+    return size;
+}
+
+//free the bundle's slot in the slab mirror (written to the disk by the next flush), or if that was the slab's last bundle,
+//free the slab segment and destroy its head on the disk right away (before the segment can be reallocated)
+bool BundleStorageManagerBase::FreeSmallBundleSlabSlot(const catalog_entry_t & catalogEntry) {
+    const segment_id_t slabSegmentId = catalogEntry.segmentIdExtentsVec[0].beginSegmentId;
+    small_bundle_slab_map_t::iterator it = m_smallBundleSlabsMap.find(slabSegmentId);
+    if (it == m_smallBundleSlabsMap.end()) {
+        return false;
+    }
+    small_bundle_slab_t & slab = it->second;
+    const unsigned int slotIndex = catalogEntry.GetSmallBundleSlabSlotIndex();
+    const uint64_t slotMask = static_cast<uint64_t>(1) << slotIndex;
+    if ((slab.usedSlotsMask & slotMask) == 0) {
+        return false;
+    }
+    slab.usedSlotsMask &= ~slotMask;
+    uint8_t * const segmentImage = slab.segmentImage.get();
+    if (slab.usedSlotsMask == 0) {
+        m_dirtySmallBundleSlabsSet.erase(slabSegmentId);
+        if (slab.isOnDisk) {
+            static const uint64_t bundleSizeBytesLittleEndian = UINT64_MAX;
+            memcpy(segmentImage, &bundleSizeBytesLittleEndian, sizeof(bundleSizeBytesLittleEndian));
+            if (uint8_t * const segmentMemoryPtr = GetSegmentMemoryPtr(slabSegmentId)) {
+                memcpy(segmentMemoryPtr, &bundleSizeBytesLittleEndian, sizeof(bundleSizeBytesLittleEndian));
+            }
+            else {
+                WriteSmallBundleSlabToDisk(slabSegmentId, segmentImage);
+            }
+        }
+        m_smallBundleSlabsWithFreeSlotsSets[slab.sizeClassIndex].erase(slabSegmentId);
+        m_smallBundleSlabsMap.erase(it);
+        const segment_id_extents_vec_t slabExtentsVec({ segment_id_extent_t{ slabSegmentId, 1 } });
+        return FreeRemovedSegmentExtents(slabExtentsVec);
+    }
+    const std::size_t slotOffset = SEGMENT_RESERVED_SPACE + (slotIndex * GetSmallBundleSlabSlotSize(slab.sizeClassIndex));
+    memset(segmentImage + slotOffset, 0, SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE);
+    MarkSmallBundleSlabDirty(slabSegmentId, slotOffset, SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE);
+    m_smallBundleSlabsWithFreeSlotsSets[slab.sizeClassIndex].insert(slabSegmentId);
+    return true;
+}
+
+void BundleStorageManagerBase::MarkSmallBundleSlabDirty(const segment_id_t slabSegmentId, const std::size_t offset, const std::size_t length) {
+    small_bundle_slab_t & slab = m_smallBundleSlabsMap[slabSegmentId];
+    if (uint8_t * const segmentMemoryPtr = GetSegmentMemoryPtr(slabSegmentId)) { //written in place (the whole slab the first time)
+        if (slab.isOnDisk) {
+            memcpy(segmentMemoryPtr + offset, slab.segmentImage.get() + offset, length);
+        }
+        else {
+            memcpy(segmentMemoryPtr, slab.segmentImage.get(), SEGMENT_SIZE);
+            slab.isOnDisk = true;
+        }
+        return;
+    }
+    if (m_dirtySmallBundleSlabsSet.empty()) {
+        m_smallBundleSlabsFlushTime = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(SMALL_BUNDLE_SLAB_FLUSH_DELAY_MILLISECONDS);
+    }
+    m_dirtySmallBundleSlabsSet.insert(slabSegmentId);
+}
+
+std::size_t BundleStorageManagerBase::FlushSmallBundleSlabs(const boost::posix_time::ptime & nowPtime) {
+    if (m_dirtySmallBundleSlabsSet.empty() || (nowPtime < m_smallBundleSlabsFlushTime)) {
+        return 0;
+    }
+    return FlushAllSmallBundleSlabs();
+}
+
+std::size_t BundleStorageManagerBase::FlushAllSmallBundleSlabs() {
+    const std::size_t numFlushed = m_dirtySmallBundleSlabsSet.size();
+    for (std::set<segment_id_t>::const_iterator it = m_dirtySmallBundleSlabsSet.cbegin(); it != m_dirtySmallBundleSlabsSet.cend(); ++it) {
+        small_bundle_slab_t & slab = m_smallBundleSlabsMap[*it];
+        WriteSmallBundleSlabToDisk(*it, slab.segmentImage.get());
+        slab.isOnDisk = true;
+    }
+    m_dirtySmallBundleSlabsSet.clear();
+    m_smallBundleSlabsFlushTime = boost::posix_time::not_a_date_time;
+    return numFlushed;
+}
+
+//queue the whole slab segment (already containing its storage segment header) to be written to its disk
+void BundleStorageManagerBase::WriteSmallBundleSlabToDisk(const segment_id_t segmentId, const uint8_t * segmentImage) {
+    ++m_totalSmallBundleSlabSegmentsWritten;
+    const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
+    CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskIndex];
+    boost::mutex::scoped_lock lockProducer(m_diskProducerMutexesVec[diskIndex]);
+    unsigned int produceIndex = cb.GetIndexForWrite();
+    while (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full, wait until not full	
+        //try again, but with the mutex
+        boost::mutex::scoped_lock lockMainThread(m_mutexMainThread);
+        produceIndex = cb.GetIndexForWrite();
+        if (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full again (lock mutex (above) before checking condition)
+            m_conditionVariableMainThread.wait(lockMainThread); // call lock.unlock() and blocks the current thread
+            //thread is now unblocked, and the lock is reacquired by invoking lock.lock()
+            produceIndex = cb.GetIndexForWrite(); //should definitely have an index now (prevents an extra lock, unlock operation)
+        }
+    }
+
+    uint8_t * const dataCb = &m_circularBufferBlockDataPtr[(diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex) * SEGMENT_SIZE];
+    m_circularBufferSegmentIdsPtr[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex] = segmentId;
+    m_circularBufferReadFromStoragePointers[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex].store(NULL, std::memory_order_release); //isWriteToDisk = true
+    memcpy(dataCb, segmentImage, SEGMENT_SIZE);
+
+    CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(diskIndex);
+}
+
 uint64_t BundleStorageManagerBase::PopTop(BundleStorageManagerSession_ReadFromDisk & session, const std::vector<cbhe_eid_t> & availableDestinationEids) { //0 if empty, size if entry
 
     session.catalogEntryPtr = m_bundleStorageCatalog.PopEntryFromAwaitingSend(session.custodyId, availableDestinationEids);
@@ -257,6 +968,8 @@ uint64_t BundleStorageManagerBase::PopTop(BundleStorageManagerSession_ReadFromDi
     }
     session.nextLogicalSegment = 0;
     session.nextLogicalSegmentToCache = 0;
+    session.nextSegmentCursor.Reset();
+    session.nextSegmentToCacheCursor.Reset();
     session.cacheReadIndex = 0;
     session.cacheWriteIndex = 0;
 
@@ -270,6 +983,8 @@ uint64_t BundleStorageManagerBase::PopTop(BundleStorageManagerSession_ReadFromDi
     }
     session.nextLogicalSegment = 0;
     session.nextLogicalSegmentToCache = 0;
+    session.nextSegmentCursor.Reset();
+    session.nextSegmentToCacheCursor.Reset();
     session.cacheReadIndex = 0;
     session.cacheWriteIndex = 0;
 
@@ -283,12 +998,34 @@ uint64_t BundleStorageManagerBase::PopTop(BundleStorageManagerSession_ReadFromDi
     }
     session.nextLogicalSegment = 0;
     session.nextLogicalSegmentToCache = 0;
+    session.nextSegmentCursor.Reset();
+    session.nextSegmentToCacheCursor.Reset();
     session.cacheReadIndex = 0;
     session.cacheWriteIndex = 0;
 
     return session.catalogEntryPtr->bundleSizeBytes;
 }
+uint64_t BundleStorageManagerBase::PopTop(BundleStorageManagerSession_ReadFromDisk & session, const uint64_t destinationGroupId) { //0 if empty, size if entry
 
+    session.catalogEntryPtr = m_bundleStorageCatalog.PopEntryFromAwaitingSend(session.custodyId, destinationGroupId);
+    if (session.catalogEntryPtr == NULL) {
+        return 0;
+    }
+    session.nextLogicalSegment = 0;
+    session.nextLogicalSegmentToCache = 0;
+    session.nextSegmentCursor.Reset();
+    session.nextSegmentToCacheCursor.Reset();
+    session.cacheReadIndex = 0;
+    session.cacheWriteIndex = 0;
+
+    return session.catalogEntryPtr->bundleSizeBytes;
+}
+uint64_t BundleStorageManagerBase::AddDestinationGroup(const std::vector<std::pair<cbhe_eid_t, bool> > & availableDests) {
+    return m_bundleStorageCatalog.AddDestinationGroup(availableDests);
+}
+bool BundleStorageManagerBase::RemoveDestinationGroup(const uint64_t destinationGroupId) {
+    return m_bundleStorageCatalog.RemoveDestinationGroup(destinationGroupId);
+}
 
 bool BundleStorageManagerBase::ReturnTop(BundleStorageManagerSession_ReadFromDisk & session) { //0 if empty, size if entry
     return ((session.catalogEntryPtr != NULL) && m_bundleStorageCatalog.ReturnEntryToAwaitingSend(*session.catalogEntryPtr, session.custodyId));
@@ -305,39 +1042,57 @@ catalog_entry_t * BundleStorageManagerBase::GetCatalogEntryPtrFromCustodyId(cons
 }
 
 std::size_t BundleStorageManagerBase::TopSegment(BundleStorageManagerSession_ReadFromDisk & session, void * buf) {
-    const segment_id_chain_vec_t & segments = session.catalogEntryPtr->segmentIdChainVec;
-
-    while (((session.nextLogicalSegmentToCache - session.nextLogicalSegment) < READ_CACHE_NUM_SEGMENTS_PER_SESSION)
-        && (session.nextLogicalSegmentToCache < segments.size()))
-    {
-        const segment_id_t segmentId = segments[session.nextLogicalSegmentToCache++];
-        const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
-        CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskIndex];
-        unsigned int produceIndex = cb.GetIndexForWrite();
-        while (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full, wait until not full	
-            //try again, but with the mutex
-            boost::mutex::scoped_lock lockMainThread(m_mutexMainThread);
-            produceIndex = cb.GetIndexForWrite();
-            if (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full again (lock mutex (above) before checking condition)
-                m_conditionVariableMainThread.wait(lockMainThread); // call lock.unlock() and blocks the current thread
-                //thread is now unblocked, and the lock is reacquired by invoking lock.lock()
-                produceIndex = cb.GetIndexForWrite(); //should definitely have an index now (prevents an extra lock, unlock operation)
+    const segment_id_extents_vec_t & segmentIdExtentsVec = session.catalogEntryPtr->segmentIdExtentsVec;
+
+    if (!m_ramHotTierMap.empty()) {
+        ram_hot_tier_map_t::const_iterator it = m_ramHotTierMap.find(session.catalogEntryPtr);
+        if (it != m_ramHotTierMap.cend()) { //nothing was read ahead from disk for this bundle
+            const padded_vector_uint8_t & bundleData = it->second.bundleData;
+            const uint64_t offset = static_cast<uint64_t>(session.nextLogicalSegment) * BUNDLE_STORAGE_PER_SEGMENT_SIZE;
+            if (offset >= bundleData.size()) {
+                return 0;
             }
+            const std::size_t size = static_cast<std::size_t>(std::min<uint64_t>(bundleData.size() - offset, BUNDLE_STORAGE_PER_SEGMENT_SIZE));
+            memcpy(buf, bundleData.data() + offset, size);
+            ++session.nextLogicalSegment;
+            session.nextSegmentCursor.Advance(segmentIdExtentsVec);
+            session.nextLogicalSegmentToCache = session.nextLogicalSegment;
+            session.nextSegmentToCacheCursor = session.nextSegmentCursor;
+            return size;
         }
+    }
+    if (session.catalogEntryPtr->IsInSmallBundleSlab()) { //read from the slab mirror
+        return ReadBundleFromSmallBundleSlab(session, buf);
+    }
+    return TopSegmentFromDisk(session, buf);
+}
 
-        session.readCacheIsSegmentReady[session.cacheWriteIndex].store(false, std::memory_order_release);
-        const unsigned int cbPtrIndex = diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex;
-        m_circularBufferIsReadCompletedPointers[cbPtrIndex].store(
-            &session.readCacheIsSegmentReady[session.cacheWriteIndex], std::memory_order_release);
-        m_circularBufferSegmentIdsPtr[cbPtrIndex] = segmentId;
-        m_circularBufferReadFromStoragePointers[cbPtrIndex].store(
-            &session.readCache[session.cacheWriteIndex * SEGMENT_SIZE], std::memory_order_release);
-        session.cacheWriteIndex = (session.cacheWriteIndex + 1) % READ_CACHE_NUM_SEGMENTS_PER_SESSION;
-
-        CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(diskIndex);
+void BundleStorageManagerBase::QueueSegmentReadFromDisk(const segment_id_t segmentId, uint8_t * segmentBuf, std::atomic<bool> * isReadCompletedPtr) {
+    const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
+    CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskIndex];
+    boost::mutex::scoped_lock lockProducer(m_diskProducerMutexesVec[diskIndex]);
+    unsigned int produceIndex = cb.GetIndexForWrite();
+    while (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full, wait until not full	
+        //try again, but with the mutex
+        boost::mutex::scoped_lock lockMainThread(m_mutexMainThread);
+        produceIndex = cb.GetIndexForWrite();
+        if (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full again (lock mutex (above) before checking condition)
+            m_conditionVariableMainThread.wait(lockMainThread); // call lock.unlock() and blocks the current thread
+            //thread is now unblocked, and the lock is reacquired by invoking lock.lock()
+            produceIndex = cb.GetIndexForWrite(); //should definitely have an index now (prevents an extra lock, unlock operation)
+        }
     }
 
-    std::atomic<bool> & readIsReadyRef = session.readCacheIsSegmentReady[session.cacheReadIndex];
+    isReadCompletedPtr->store(false, std::memory_order_release);
+    const unsigned int cbPtrIndex = diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex;
+    m_circularBufferIsReadCompletedPointers[cbPtrIndex].store(isReadCompletedPtr, std::memory_order_release);
+    m_circularBufferSegmentIdsPtr[cbPtrIndex] = segmentId;
+    m_circularBufferReadFromStoragePointers[cbPtrIndex].store(segmentBuf, std::memory_order_release);
+
+    CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(diskIndex);
+}
+
+void BundleStorageManagerBase::WaitForSegmentReadFromDisk(std::atomic<bool> & readIsReadyRef) {
     while (!readIsReadyRef.load(std::memory_order_acquire)) { //wait until read is ready		
         //try again, but with the mutex
         boost::mutex::scoped_lock lockMainThread(m_mutexMainThread);
@@ -346,11 +1101,15 @@ std::size_t BundleStorageManagerBase::TopSegment(BundleStorageManagerSession_Rea
             //thread is now unblocked, and the lock is reacquired by invoking lock.lock()
         }
     }
+}
+
+std::size_t BundleStorageManagerBase::CheckSegmentReadFromDisk(BundleStorageManagerSession_ReadFromDisk & session, const uint8_t * segmentBuf) {
+    const segment_id_extents_vec_t & segmentIdExtentsVec = session.catalogEntryPtr->segmentIdExtentsVec;
 
     StorageSegmentHeaderUnion storageSegmentHeaderUnion;
     StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
     //note: SEGMENT_RESERVED_SPACE is 4 bytes smaller than sizeof(StorageSegmentHeader) if segment_id_t is 32-bit
-    memcpy(storageSegmentHeaderUnion.rawBytes, &session.readCache[session.cacheReadIndex * SEGMENT_SIZE + 0], SEGMENT_RESERVED_SPACE);
+    memcpy(storageSegmentHeaderUnion.rawBytes, segmentBuf, SEGMENT_RESERVED_SPACE);
     storageSegmentHeader.ToNativeEndianInplace(); //should optimize out and do nothing
     if ((session.nextLogicalSegment == 0) && (storageSegmentHeader.bundleSizeBytes != session.catalogEntryPtr->bundleSizeBytes)) {// ? chainInfo.first : UINT64_MAX;
         LOG_ERROR(subprocess) << "Error: read bundle size bytes = " << storageSegmentHeader.bundleSizeBytes <<
@@ -369,11 +1128,13 @@ std::size_t BundleStorageManagerBase::TopSegment(BundleStorageManagerSession_Rea
     }
 
     ++session.nextLogicalSegment;
-    if ((session.nextLogicalSegment != segments.size()) && (storageSegmentHeader.nextSegmentId != segments[session.nextLogicalSegment])) {
+    session.nextSegmentCursor.Advance(segmentIdExtentsVec);
+    const segment_id_t expectedNextSegmentId = session.nextSegmentCursor.Get(segmentIdExtentsVec);
+    if ((expectedNextSegmentId != SEGMENT_ID_LAST) && (storageSegmentHeader.nextSegmentId != expectedNextSegmentId)) {
         LOG_ERROR(subprocess) << "Error: read nextSegmentId = " << (storageSegmentHeader.nextSegmentId) <<
-            " does not match segment = " << segments[session.nextLogicalSegment];
+            " does not match segment = " << expectedNextSegmentId;
     }
-    else if ((session.nextLogicalSegment == segments.size()) && (storageSegmentHeader.nextSegmentId != SEGMENT_ID_LAST)) {
+    else if ((expectedNextSegmentId == SEGMENT_ID_LAST) && (storageSegmentHeader.nextSegmentId != SEGMENT_ID_LAST)) {
         LOG_ERROR(subprocess) << "Error: read nextSegmentId = " << storageSegmentHeader.nextSegmentId << " is not SEGMENT_ID_LAST";
     }
 
@@ -384,8 +1145,36 @@ std::size_t BundleStorageManagerBase::TopSegment(BundleStorageManagerSession_Rea
             size = modBytes;
         }
     }
+    return size;
+}
+
+std::size_t BundleStorageManagerBase::TopSegmentFromDisk(BundleStorageManagerSession_ReadFromDisk & session, void * buf) {
+    const segment_id_extents_vec_t & segmentIdExtentsVec = session.catalogEntryPtr->segmentIdExtentsVec;
+
+    if (const uint8_t * const segmentMemoryPtr = GetSegmentMemoryPtr(session.nextSegmentCursor.Get(segmentIdExtentsVec))) { //read in place, nothing to read ahead
+        const std::size_t size = CheckSegmentReadFromDisk(session, segmentMemoryPtr);
+        memcpy(buf, segmentMemoryPtr + SEGMENT_RESERVED_SPACE, size);
+        session.nextLogicalSegmentToCache = session.nextLogicalSegment;
+        session.nextSegmentToCacheCursor = session.nextSegmentCursor;
+        return size;
+    }
+
+    while ((session.nextLogicalSegmentToCache - session.nextLogicalSegment) < READ_CACHE_NUM_SEGMENTS_PER_SESSION) {
+        const segment_id_t segmentId = session.nextSegmentToCacheCursor.Get(segmentIdExtentsVec);
+        if (segmentId == SEGMENT_ID_LAST) { //all segments already cached
+            break;
+        }
+        ++session.nextLogicalSegmentToCache;
+        session.nextSegmentToCacheCursor.Advance(segmentIdExtentsVec);
+        QueueSegmentReadFromDisk(segmentId, &session.readCache[session.cacheWriteIndex * SEGMENT_SIZE],
+            &session.readCacheIsSegmentReady[session.cacheWriteIndex]);
+        session.cacheWriteIndex = (session.cacheWriteIndex + 1) % READ_CACHE_NUM_SEGMENTS_PER_SESSION;
+    }
 
-    memcpy(buf, &session.readCache[session.cacheReadIndex * SEGMENT_SIZE + SEGMENT_RESERVED_SPACE], size);
+    WaitForSegmentReadFromDisk(session.readCacheIsSegmentReady[session.cacheReadIndex]);
+    const uint8_t * const segmentBuf = &session.readCache[session.cacheReadIndex * SEGMENT_SIZE];
+    const std::size_t size = CheckSegmentReadFromDisk(session, segmentBuf);
+    memcpy(buf, segmentBuf + SEGMENT_RESERVED_SPACE, size);
     session.cacheReadIndex = (session.cacheReadIndex + 1) % READ_CACHE_NUM_SEGMENTS_PER_SESSION;
 
 
@@ -399,11 +1188,13 @@ bool BundleStorageManagerBase::ReadFirstSegment(BundleStorageManagerSession_Read
     session.catalogEntryPtr = entry;
     session.nextLogicalSegment = 0;
     session.nextLogicalSegmentToCache = 0;
+    session.nextSegmentCursor.Reset();
+    session.nextSegmentToCacheCursor.Reset();
     session.cacheReadIndex = 0;
     session.cacheWriteIndex = 0;
 
     // Sanity check
-    if(session.catalogEntryPtr->segmentIdChainVec.size() == 0) {
+    if(session.catalogEntryPtr->segmentIdExtentsVec.empty()) {
         return false;
     }
 
@@ -413,7 +1204,14 @@ bool BundleStorageManagerBase::ReadFirstSegment(BundleStorageManagerSession_Read
     return (totalBytesRead == totalBytesToRead);
 }
 bool BundleStorageManagerBase::ReadAllSegments(BundleStorageManagerSession_ReadFromDisk & session, padded_vector_uint8_t& buf) {
-    const std::size_t numSegmentsToRead = session.catalogEntryPtr->segmentIdChainVec.size();
+    if (!m_ramHotTierMap.empty()) {
+        ram_hot_tier_map_t::const_iterator it = m_ramHotTierMap.find(session.catalogEntryPtr);
+        if (it != m_ramHotTierMap.cend()) {
+            buf.assign(it->second.bundleData.cbegin(), it->second.bundleData.cend()); //kept in case the bundle is sent again
+            return true;
+        }
+    }
+    const std::size_t numSegmentsToRead = session.catalogEntryPtr->GetNumSegments();
     const uint64_t totalBytesToRead = session.catalogEntryPtr->bundleSizeBytes;
     buf.resize(totalBytesToRead);
     std::size_t totalBytesRead = 0;
@@ -422,6 +1220,79 @@ bool BundleStorageManagerBase::ReadAllSegments(BundleStorageManagerSession_ReadF
     }
     return (totalBytesRead == totalBytesToRead);
 }
+bool BundleStorageManagerBase::ReadAllSegmentsIntoReleaseBuffer(BundleStorageManagerSession_ReadFromDisk & session, release_buffer_t & releaseBuffer) {
+    const uint64_t totalBytesToRead = session.catalogEntryPtr->bundleSizeBytes;
+    if (totalBytesToRead > releaseBuffer.capacity) {
+        LOG_ERROR(subprocess) << "release buffer of " << releaseBuffer.capacity << " bytes is too small for custody id " << session.custodyId;
+        return false;
+    }
+    if (!m_ramHotTierMap.empty()) {
+        ram_hot_tier_map_t::const_iterator it = m_ramHotTierMap.find(session.catalogEntryPtr);
+        if (it != m_ramHotTierMap.cend()) {
+            const padded_vector_uint8_t & bundleData = it->second.bundleData; //kept in case the bundle is sent again
+            memcpy(releaseBuffer.data, bundleData.data(), bundleData.size());
+            releaseBuffer.size = bundleData.size();
+            return true;
+        }
+    }
+    if (session.catalogEntryPtr->IsInSmallBundleSlab()) { //copied from the slab mirror
+        releaseBuffer.size = ReadBundleFromSmallBundleSlab(session, releaseBuffer.data);
+        return (releaseBuffer.size == totalBytesToRead);
+    }
+    return ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe(session, releaseBuffer);
+}
+bool BundleStorageManagerBase::ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe(BundleStorageManagerSession_ReadFromDisk & session, release_buffer_t & releaseBuffer) {
+    if (session.catalogEntryPtr->IsInSmallBundleSlab()) {
+        LOG_ERROR(subprocess) << "custody id " << session.custodyId << " is in a small bundle slab and must be read by ReadAllSegmentsIntoReleaseBuffer";
+        return false;
+    }
+    const segment_id_extents_vec_t & segmentIdExtentsVec = session.catalogEntryPtr->segmentIdExtentsVec;
+    const std::size_t numSegmentsToRead = session.catalogEntryPtr->GetNumSegments();
+    const uint64_t totalBytesToRead = session.catalogEntryPtr->bundleSizeBytes;
+    if ((static_cast<uint64_t>(numSegmentsToRead) * SEGMENT_SIZE) > releaseBuffer.capacity) {
+        LOG_ERROR(subprocess) << "release buffer of " << releaseBuffer.capacity << " bytes cannot hold the "
+            << numSegmentsToRead << " segments of custody id " << session.custodyId;
+        return false;
+    }
+    session.nextLogicalSegment = 0;
+    session.nextLogicalSegmentToCache = 0;
+    session.nextSegmentCursor.Reset();
+    session.nextSegmentToCacheCursor.Reset();
+    session.cacheReadIndex = 0;
+    session.cacheWriteIndex = 0;
+
+    std::size_t totalBytesRead = 0;
+    if (GetSegmentMemoryPtr(segmentIdExtentsVec[0].beginSegmentId)) { //read in place, each payload is copied straight to its final offset
+        for (std::size_t i = 0; i < numSegmentsToRead; ++i) {
+            totalBytesRead += TopSegmentFromDisk(session, releaseBuffer.data + (i * BUNDLE_STORAGE_PER_SEGMENT_SIZE));
+        }
+        releaseBuffer.size = static_cast<std::size_t>(totalBytesRead);
+        return (totalBytesRead == totalBytesToRead);
+    }
+
+    //Logical segment i is read whole (header included) to offset i * SEGMENT_SIZE of the buffer, with at most
+    //READ_CACHE_NUM_SEGMENTS_PER_SESSION reads outstanding.  Once it completes (in order), its payload is moved down
+    //to offset i * BUNDLE_STORAGE_PER_SEGMENT_SIZE, which ends before offset (i + 1) * SEGMENT_SIZE where the
+    //reads still outstanding land, so the bundle ends up contiguous at the front of the buffer without a second copy.
+    for (std::size_t i = 0; i < numSegmentsToRead; ++i) {
+        while ((session.nextLogicalSegmentToCache < numSegmentsToRead)
+            && ((session.nextLogicalSegmentToCache - i) < READ_CACHE_NUM_SEGMENTS_PER_SESSION))
+        {
+            const segment_id_t segmentId = session.nextSegmentToCacheCursor.Get(segmentIdExtentsVec);
+            QueueSegmentReadFromDisk(segmentId, releaseBuffer.data + (static_cast<std::size_t>(session.nextLogicalSegmentToCache) * SEGMENT_SIZE),
+                &session.readCacheIsSegmentReady[session.nextLogicalSegmentToCache % READ_CACHE_NUM_SEGMENTS_PER_SESSION]);
+            ++session.nextLogicalSegmentToCache;
+            session.nextSegmentToCacheCursor.Advance(segmentIdExtentsVec);
+        }
+        WaitForSegmentReadFromDisk(session.readCacheIsSegmentReady[i % READ_CACHE_NUM_SEGMENTS_PER_SESSION]);
+        const uint8_t * const segmentBuf = releaseBuffer.data + (i * SEGMENT_SIZE);
+        const std::size_t size = CheckSegmentReadFromDisk(session, segmentBuf);
+        memmove(releaseBuffer.data + (i * BUNDLE_STORAGE_PER_SEGMENT_SIZE), segmentBuf + SEGMENT_RESERVED_SPACE, size);
+        totalBytesRead += size;
+    }
+    releaseBuffer.size = static_cast<std::size_t>(totalBytesRead);
+    return (totalBytesRead == totalBytesToRead);
+}
 bool BundleStorageManagerBase::RemoveBundleFromDisk(const catalog_entry_t *catalogEntryPtr, const uint64_t custodyId) {
     // "read" the bundle so that we can call RemoveReadBundleFromDisk
     // don't care if this fails, that just means that it wasn't awaiting send
@@ -450,42 +1321,64 @@ bool BundleStorageManagerBase::RemoveReadBundleFromDisk(BundleStorageManagerSess
     return RemoveReadBundleFromDisk(sessionRead.catalogEntryPtr, sessionRead.custodyId);
 }
 bool BundleStorageManagerBase::RemoveReadBundleFromDisk(const catalog_entry_t * catalogEntryPtr, const uint64_t custodyId) {
-    const segment_id_chain_vec_t & segmentIdChainVec = catalogEntryPtr->segmentIdChainVec;
-
-    //destroy the head on the disk by writing UINT64_MAX to bundleSizeBytes of first logical segment
+    const segment_id_extents_vec_t & segmentIdExtentsVec = catalogEntryPtr->segmentIdExtentsVec;
+    const bool isInSmallBundleSlab = catalogEntryPtr->IsInSmallBundleSlab();
+
+    ram_hot_tier_map_t::iterator hotIt = m_ramHotTierMap.find(catalogEntryPtr);
+    const bool wasOnlyInRam = (hotIt != m_ramHotTierMap.end());
+    if (wasOnlyInRam) { //never written to disk (or journaled), so nothing to destroy on the disk
+        m_ramHotTierBytes -= hotIt->second.bundleData.size();
+        m_ramHotTierMap.erase(hotIt); //its fifo record is skipped later
+        ++m_totalBundlesRemovedFromRamHotTier;
+    }
+    else if (!isInSmallBundleSlab) { //(a slab slot is freed on the disk by FreeSmallBundleSlabSlot)
+        //destroy the head on the disk by writing UINT64_MAX to bundleSizeBytes of first logical segment
 
 
-    static const uint64_t bundleSizeBytesLittleEndian = UINT64_MAX;
-    const segment_id_t segmentId = segmentIdChainVec[0];
-    const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
-    CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskIndex];
-    unsigned int produceIndex = cb.GetIndexForWrite();
-    while (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full, wait until not full	
-        //try again, but with the mutex
-        boost::mutex::scoped_lock lockMainThread(m_mutexMainThread);
-        produceIndex = cb.GetIndexForWrite();
-        if (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full again (lock mutex (above) before checking condition)
-            m_conditionVariableMainThread.wait(lockMainThread); // call lock.unlock() and blocks the current thread
-            //thread is now unblocked, and the lock is reacquired by invoking lock.lock()
-            produceIndex = cb.GetIndexForWrite(); //should definitely have an index now (prevents an extra lock, unlock operation)
+        static const uint64_t bundleSizeBytesLittleEndian = UINT64_MAX;
+        const segment_id_t segmentId = segmentIdExtentsVec[0].beginSegmentId;
+        if (uint8_t * const segmentMemoryPtr = GetSegmentMemoryPtr(segmentId)) { //destroyed in place
+            memcpy(segmentMemoryPtr, &bundleSizeBytesLittleEndian, sizeof(bundleSizeBytesLittleEndian));
         }
-    }
+        else {
+            const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
+            CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskIndex];
+            boost::mutex::scoped_lock lockProducer(m_diskProducerMutexesVec[diskIndex]);
+            unsigned int produceIndex = cb.GetIndexForWrite();
+            while (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full, wait until not full	
+                //try again, but with the mutex
+                boost::mutex::scoped_lock lockMainThread(m_mutexMainThread);
+                produceIndex = cb.GetIndexForWrite();
+                if (produceIndex == CIRCULAR_INDEX_BUFFER_FULL) { //if full again (lock mutex (above) before checking condition)
+                    m_conditionVariableMainThread.wait(lockMainThread); // call lock.unlock() and blocks the current thread
+                    //thread is now unblocked, and the lock is reacquired by invoking lock.lock()
+                    produceIndex = cb.GetIndexForWrite(); //should definitely have an index now (prevents an extra lock, unlock operation)
+                }
+            }
 
-    uint8_t * const circularBufferBlockDataPtr = &m_circularBufferBlockDataPtr[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
-    segment_id_t * const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE];
+            uint8_t * const circularBufferBlockDataPtr = &m_circularBufferBlockDataPtr[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
+            segment_id_t * const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE];
 
 
-    uint8_t * const dataCb = &circularBufferBlockDataPtr[produceIndex * SEGMENT_SIZE];
-    circularBufferSegmentIdsPtr[produceIndex] = segmentId;
-    m_circularBufferReadFromStoragePointers[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex].store(NULL, std::memory_order_release); //isWriteToDisk = true
+            uint8_t * const dataCb = &circularBufferBlockDataPtr[produceIndex * SEGMENT_SIZE];
+            circularBufferSegmentIdsPtr[produceIndex] = segmentId;
+            m_circularBufferReadFromStoragePointers[diskIndex * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex].store(NULL, std::memory_order_release); //isWriteToDisk = true
 
-    memcpy(dataCb, &bundleSizeBytesLittleEndian, sizeof(bundleSizeBytesLittleEndian));
+            memcpy(dataCb, &bundleSizeBytesLittleEndian, sizeof(bundleSizeBytesLittleEndian));
 
 
-    CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(diskIndex);
+            CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(diskIndex);
+        }
+    }
 
-    const bool successFreedSegments = m_memoryManager.FreeSegments_ThreadSafe(segmentIdChainVec);
-    return (m_bundleStorageCatalog.Remove(custodyId, false).first && successFreedSegments);
+    const bool successFreedSegments = (isInSmallBundleSlab) ? FreeSmallBundleSlabSlot(*catalogEntryPtr) : FreeRemovedSegmentExtents(segmentIdExtentsVec);
+    const bool successRemovedFromCatalog = m_bundleStorageCatalog.Remove(custodyId, false).first;
+    if (successRemovedFromCatalog && m_catalogJournalPtr && (!wasOnlyInRam)) {
+        if (!m_catalogJournalPtr->AppendRemove(custodyId)) {
+            m_catalogJournalPtr.reset(); //disabled (and its files deleted) by the failure
+        }
+    }
+    return (successRemovedFromCatalog && successFreedSegments);
 }
 uint64_t * BundleStorageManagerBase::GetCustodyIdFromUuid(const cbhe_bundle_uuid_t & bundleUuid) {
     return m_bundleStorageCatalog.GetCustodyIdFromUuid(bundleUuid);
@@ -503,158 +1396,534 @@ void BundleStorageManagerBase::GetExpiredBundleIds(const uint64_t expiry, const
 //	return session.chainInfoVecPtr->front().second.size(); //use the front as new writes will be pushed back
 //}
 
+namespace {
+/// The part of a segment header needed to follow a bundle's chain of segments during a restore
+struct restore_segment_link_t {
+    uint64_t custodyId;
+    segment_id_t nextSegmentId;
+};
+/// A potential head segment (bundleSizeBytes != UINT64_MAX) found during a restore, decoded by its disk's scanner thread
+struct restore_head_segment_t {
+    segment_id_t segmentId;
+    uint64_t custodyId;
+    bool primaryLoaded; //false if malformed, which is only an error if the head is not part of another bundle's chain
+    catalog_entry_t catalogEntry;
+    cbhe_bundle_uuid_t bundleUuid;
+};
+/// A bundle found in a slot of a small bundle slab segment during a restore
+struct restore_slab_slot_t {
+    segment_id_t segmentId;
+    unsigned int slotIndex;
+    uint64_t custodyId;
+    bool primaryLoaded;
+    catalog_entry_t catalogEntry;
+    cbhe_bundle_uuid_t bundleUuid;
+};
+/// Everything one disk's scanner thread read from that disk
+struct restore_disk_scan_t {
+    restore_disk_scan_t() : success(false) {}
+    std::vector<restore_segment_link_t> segmentLinksVec; //index is segmentId / numDisks
+    std::vector<restore_head_segment_t> headSegmentsVec; //ascending segmentId
+    std::vector<restore_slab_slot_t> slabSlotsVec; //ascending segmentId then slotIndex
+    bool success;
+};
+}
+
+/// Decode the primary block of a stored bundle and initialize its catalog entry and uuid from it.
+static bool RestoreLoadPrimary(uint8_t * bundleDataBegin, const uint64_t maxBytesToDecode, const uint64_t bundleSizeBytes, const uint64_t payloadSizeBytes,
+    BundleViewV6 & bv6, BundleViewV7 & bv7, catalog_entry_t & catalogEntry, cbhe_bundle_uuid_t & bundleUuid)
+{
+    const uint8_t firstByte = bundleDataBegin[0];
+    const bool isBpVersion6 = (firstByte == 6);
+    const bool isBpVersion7 = (firstByte == ((4U << 5) | 31U));  //CBOR major type 4, additional information 31 (Indefinite-Length Array)
+    PrimaryBlock * primaryBasePtr = NULL;
+    if (isBpVersion6) {
+        if (bv6.LoadBundle(bundleDataBegin, maxBytesToDecode, true)) { //load primary only
+            primaryBasePtr = &bv6.m_primaryBlockView.header;
+        }
+    }
+    else if (isBpVersion7) {
+        if (bv7.LoadBundle(bundleDataBegin, maxBytesToDecode, true, true)) { //load primary only
+            primaryBasePtr = &bv7.m_primaryBlockView.header;
+        }
+    }
+    if (primaryBasePtr == NULL) {
+        return false;
+    }
+    catalogEntry.Init(*primaryBasePtr, bundleSizeBytes, payloadSizeBytes, NULL); //NULL replaced later at CatalogIncomingBundleForStore
+    bundleUuid = primaryBasePtr->GetCbheBundleUuidFragmentFromPrimary(payloadSizeBytes);
+    return true;
+}
+
+/// Find the size class of a small bundle slab from the slot size in its storage segment header
+static bool GetSmallBundleSlabSizeClassIndex(const uint64_t slotSize, unsigned int & sizeClassIndex) {
+    for (sizeClassIndex = 0; sizeClassIndex < SMALL_BUNDLE_SLAB_NUM_SIZE_CLASSES; ++sizeClassIndex) {
+        if (BundleStorageManagerBase::GetSmallBundleSlabSlotSize(sizeClassIndex) == slotSize) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Read every segment header of one disk sequentially, decoding the primary block of every potential head segment.
+static void RestoreScanDisk(const char * const filePath, const unsigned int diskId, const unsigned int numDisks,
+    const uint64_t numSegmentsOnDisk, restore_disk_scan_t & scan)
+{
+    static constexpr uint64_t READ_CHUNK_SEGMENTS = 32;
+    FILE * const fileHandle = fopen(filePath, "rbS"); //S => optimize for sequential access (Windows)
+    if (fileHandle == NULL) {
+        LOG_ERROR(subprocess) << "Error opening file " << filePath <<
+            " for reading and restoring";
+        return;
+    }
+    std::unique_ptr<uint8_t[]> dataReadBuf(new uint8_t[READ_CHUNK_SEGMENTS * SEGMENT_SIZE]);
+    scan.segmentLinksVec.resize(numSegmentsOnDisk);
+    BundleViewV6 bv6;
+    BundleViewV7 bv7;
+    for (uint64_t chunkBegin = 0; chunkBegin < numSegmentsOnDisk; chunkBegin += READ_CHUNK_SEGMENTS) {
+        const uint64_t numSegmentsInChunk = std::min(READ_CHUNK_SEGMENTS, numSegmentsOnDisk - chunkBegin);
+        const std::size_t bytesReadFromFread = fread((void*)dataReadBuf.get(), 1, numSegmentsInChunk * SEGMENT_SIZE, fileHandle);
+        if (bytesReadFromFread != (numSegmentsInChunk * SEGMENT_SIZE)) {
+            LOG_ERROR(subprocess) << "Error reading at offset " << (chunkBegin * SEGMENT_SIZE) <<
+                " for disk " << diskId << " bytesread " << bytesReadFromFread;
+            fclose(fileHandle);
+            return;
+        }
+        for (uint64_t i = 0; i < numSegmentsInChunk; ++i) {
+            uint8_t * const segmentData = &dataReadBuf[i * SEGMENT_SIZE];
+            StorageSegmentHeaderUnion storageSegmentHeaderUnion;
+            StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
+            //note: SEGMENT_RESERVED_SPACE is 4 bytes smaller than sizeof(StorageSegmentHeader) if segment_id_t is 32-bit
+            memcpy(storageSegmentHeaderUnion.rawBytes, segmentData, SEGMENT_RESERVED_SPACE);
+            storageSegmentHeader.ToNativeEndianInplace(); //should optimize out and do nothing
+
+            const uint64_t localSegmentIndex = chunkBegin + i;
+            restore_segment_link_t & link = scan.segmentLinksVec[localSegmentIndex];
+            link.custodyId = storageSegmentHeader.custodyId;
+            link.nextSegmentId = storageSegmentHeader.nextSegmentId;
+            if (storageSegmentHeader.bundleSizeBytes == UINT64_MAX) { //not a head segment
+                continue;
+            }
+            if (storageSegmentHeader.bundleSizeBytes == 0) { //a freed segment whose blocks were reclaimed (reads back as zeros)
+                continue;
+            }
+            if (storageSegmentHeader.bundleSizeBytes == SMALL_BUNDLE_SLAB_HEADER_BUNDLE_SIZE) {
+                const segment_id_t slabSegmentId = static_cast<segment_id_t>((localSegmentIndex * numDisks) + diskId);
+                unsigned int sizeClassIndex;
+                if (!GetSmallBundleSlabSizeClassIndex(storageSegmentHeader.payloadSizeBytes, sizeClassIndex)) {
+                    LOG_ERROR(subprocess) << "small bundle slab segment " << slabSegmentId << " has an unknown slot size of " << storageSegmentHeader.payloadSizeBytes;
+                    scan.slabSlotsVec.push_back(restore_slab_slot_t{ slabSegmentId, 0, 0, false, catalog_entry_t(), cbhe_bundle_uuid_t() });
+                    continue;
+                }
+                const uint64_t slotSize = BundleStorageManagerBase::GetSmallBundleSlabSlotSize(sizeClassIndex);
+                const unsigned int numSlots = BundleStorageManagerBase::GetSmallBundleSlabNumSlots(sizeClassIndex);
+                for (unsigned int slotIndex = 0; slotIndex < numSlots; ++slotIndex) {
+                    uint8_t * const slot = segmentData + SEGMENT_RESERVED_SPACE + (slotIndex * slotSize);
+                    uint64_t custodyIdLittleEndian;
+                    uint32_t bundleSizeBytesLittleEndian;
+                    uint32_t payloadSizeBytesLittleEndian;
+                    memcpy(&custodyIdLittleEndian, slot, sizeof(custodyIdLittleEndian));
+                    memcpy(&bundleSizeBytesLittleEndian, slot + sizeof(uint64_t), sizeof(bundleSizeBytesLittleEndian));
+                    memcpy(&payloadSizeBytesLittleEndian, slot + sizeof(uint64_t) + sizeof(uint32_t), sizeof(payloadSizeBytesLittleEndian));
+                    const uint32_t slotBundleSizeBytes = boost::endian::little_to_native(bundleSizeBytesLittleEndian);
+                    if (slotBundleSizeBytes == 0) { //free slot
+                        continue;
+                    }
+                    scan.slabSlotsVec.emplace_back();
+                    restore_slab_slot_t & slabSlot = scan.slabSlotsVec.back();
+                    slabSlot.segmentId = slabSegmentId;
+                    slabSlot.slotIndex = slotIndex;
+                    slabSlot.custodyId = boost::endian::little_to_native(custodyIdLittleEndian);
+                    slabSlot.primaryLoaded = ((slotBundleSizeBytes + SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE) <= slotSize)
+                        && RestoreLoadPrimary(slot + SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE, slotBundleSizeBytes, slotBundleSizeBytes,
+                            boost::endian::little_to_native(payloadSizeBytesLittleEndian), bv6, bv7, slabSlot.catalogEntry, slabSlot.bundleUuid);
+                }
+                continue;
+            }
+            scan.headSegmentsVec.emplace_back();
+            restore_head_segment_t & head = scan.headSegmentsVec.back();
+            head.segmentId = static_cast<segment_id_t>((localSegmentIndex * numDisks) + diskId);
+            head.custodyId = storageSegmentHeader.custodyId;
+            head.primaryLoaded = RestoreLoadPrimary(segmentData + SEGMENT_RESERVED_SPACE, BUNDLE_STORAGE_PER_SEGMENT_SIZE,
+                storageSegmentHeader.bundleSizeBytes, storageSegmentHeader.payloadSizeBytes, bv6, bv7, head.catalogEntry, head.bundleUuid);
+        }
+    }
+    fclose(fileHandle);
+    scan.success = true;
+}
+
 bool BundleStorageManagerBase::RestoreFromDisk(uint64_t * totalBundlesRestored, uint64_t * totalBytesRestored, uint64_t * totalSegmentsRestored) {
     *totalBundlesRestored = 0; *totalBytesRestored = 0; *totalSegmentsRestored = 0;
-    uint8_t dataReadBuf[SEGMENT_SIZE];
-    std::vector<FILE *> fileHandlesVec(M_NUM_STORAGE_DISKS);
-    std::vector <uint64_t> fileSizesVec(M_NUM_STORAGE_DISKS);
+    std::vector <uint64_t> numSegmentsOnDiskVec(M_NUM_STORAGE_DISKS);
+    //the serial restore stopped at the first segment id that lies beyond the end of its disk's file
+    uint64_t endSegmentId = UINT64_MAX;
     for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
         const char * const filePath = m_storageConfigPtr->m_storageDiskConfigVector[diskId].storeFilePath.c_str();
         const boost::filesystem::path p(filePath);
         if (boost::filesystem::exists(p)) {
-            fileSizesVec[diskId] = boost::filesystem::file_size(p);
+            //a block device is much larger than what was ever written to it, so only scan the range storage uses
+            const uint64_t fileSize = (m_blockDeviceSizeBytesVec[diskId]) ?
+                std::min(m_blockDeviceSizeBytesVec[diskId], GetPerDiskCapacityBytes()) : boost::filesystem::file_size(p);
             LOG_DEBUG(subprocess) << "diskId " << diskId
-                << " has file size of " << fileSizesVec[diskId];
+                << " has file size of " << fileSize;
+            numSegmentsOnDiskVec[diskId] = fileSize / SEGMENT_SIZE;
+            endSegmentId = std::min(endSegmentId, (numSegmentsOnDiskVec[diskId] * M_NUM_STORAGE_DISKS) + diskId);
         }
         else {
             LOG_ERROR(subprocess) << "Error: " << filePath << " does not exist";
             return false;
         }
-        fileHandlesVec[diskId] = fopen(filePath, "rbR");
-        if (fileHandlesVec[diskId] == NULL) {
-            LOG_ERROR(subprocess) << "Error opening file " << filePath <<
-                " for reading and restoring";
+    }
+
+    //scan every disk concurrently (one thread per disk, like the disk worker threads)
+    std::vector<restore_disk_scan_t> diskScansVec(M_NUM_STORAGE_DISKS);
+    {
+        std::vector<std::unique_ptr<boost::thread> > scanThreadPtrsVec(M_NUM_STORAGE_DISKS);
+        for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+            scanThreadPtrsVec[diskId] = boost::make_unique<boost::thread>(
+                boost::bind(&RestoreScanDisk, m_storageConfigPtr->m_storageDiskConfigVector[diskId].storeFilePath.c_str(),
+                    diskId, M_NUM_STORAGE_DISKS, numSegmentsOnDiskVec[diskId], boost::ref(diskScansVec[diskId])));
+        }
+        for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+            scanThreadPtrsVec[diskId]->join();
+        }
+    }
+    std::vector<restore_head_segment_t*> headSegmentPtrsVec;
+    std::vector<restore_slab_slot_t*> slabSlotPtrsVec;
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        restore_disk_scan_t & scan = diskScansVec[diskId];
+        if (!scan.success) {
             return false;
         }
+        for (std::size_t i = 0; i < scan.headSegmentsVec.size(); ++i) {
+            headSegmentPtrsVec.push_back(&scan.headSegmentsVec[i]);
+        }
+        for (std::size_t i = 0; i < scan.slabSlotsVec.size(); ++i) {
+            if (scan.slabSlotsVec[i].segmentId < endSegmentId) {
+                slabSlotPtrsVec.push_back(&scan.slabSlotsVec[i]);
+            }
+        }
     }
+    //merge in ascending head segment id order (the order of the serial restore) so that FIFO order and error handling are unchanged
+    std::sort(headSegmentPtrsVec.begin(), headSegmentPtrsVec.end(),
+        [](const restore_head_segment_t * a, const restore_head_segment_t * b) { return a->segmentId < b->segmentId; });
+
+    for (std::size_t headIndex = 0; headIndex < headSegmentPtrsVec.size(); ++headIndex) {
+        restore_head_segment_t & head = *headSegmentPtrsVec[headIndex];
+        if (head.segmentId >= endSegmentId) {
+            break;
+        }
+        if (!m_memoryManager.IsSegmentFree(head.segmentId)) continue; //part of a previously restored bundle's chain
+        if (!head.primaryLoaded) {
+            LOG_ERROR(subprocess) << "malformed bundle or unknown bundle version detected at segment " << head.segmentId;
+            return false;
+        }
+        catalog_entry_t & catalogEntry = head.catalogEntry;
+        const uint64_t totalSegmentsRequired = (catalogEntry.bundleSizeBytes / BUNDLE_STORAGE_PER_SEGMENT_SIZE) + ((catalogEntry.bundleSizeBytes % BUNDLE_STORAGE_PER_SEGMENT_SIZE) == 0 ? 0 : 1);
+        *totalBytesRestored += catalogEntry.bundleSizeBytes;
+        *totalSegmentsRestored += totalSegmentsRequired;
 
-    bool restoreInProgress = true;
-    BundleViewV6 bv6;
-    BundleViewV7 bv7;
-    for (segment_id_t potentialHeadSegmentId = 0; restoreInProgress; ++potentialHeadSegmentId) {
-        if (!m_memoryManager.IsSegmentFree(potentialHeadSegmentId)) continue;
-        segment_id_t segmentId = potentialHeadSegmentId;
-        BundleStorageManagerSession_WriteToDisk session;
-        catalog_entry_t & catalogEntry = session.catalogEntry;
-        segment_id_chain_vec_t & segmentIdChainVec = catalogEntry.segmentIdChainVec;
-        bool headSegmentFound = false;
-        uint64_t custodyIdHeadSegment = 0; //initialization doesn't matter, only used if headSegmentFound
-        PrimaryBlock * primaryBasePtr = NULL;
-        for (session.nextLogicalSegment = 0; ; ++session.nextLogicalSegment) {
+        segment_id_t segmentId = head.segmentId;
+        for (uint64_t logicalSegment = 0; ; ++logicalSegment) {
             const unsigned int diskIndex = segmentId % M_NUM_STORAGE_DISKS;
-            FILE * const fileHandle = fileHandlesVec[diskIndex];
-            const uint64_t offsetBytes = static_cast<uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
-            const uint64_t fileSize = fileSizesVec[diskIndex];
-            if ((session.nextLogicalSegment == 0) && ((offsetBytes + SEGMENT_SIZE) > fileSize)) {
-                LOG_INFO(subprocess) << "end of restore";
-                restoreInProgress = false;
-                break;
-            }
-#ifdef _MSC_VER 
-            _fseeki64_nolock(fileHandle, offsetBytes, SEEK_SET);
-#elif (BOOST_OS_MACOS || BOOST_OS_BSD)
-            fseeko(fileHandle, offsetBytes, SEEK_SET);
-#else //Linux or other OS
-            fseeko64(fileHandle, offsetBytes, SEEK_SET);
-#endif
-
-            const std::size_t bytesReadFromFread = fread((void*)dataReadBuf, 1, SEGMENT_SIZE, fileHandle);
-            if (bytesReadFromFread != SEGMENT_SIZE) {
-                LOG_ERROR(subprocess) << "Error reading at offset " << offsetBytes <<
-                    " for disk " << diskIndex << " filesize " << fileSize << " logical segment "
-                    << session.nextLogicalSegment << " bytesread " << bytesReadFromFread;
+            const uint64_t localSegmentIndex = segmentId / M_NUM_STORAGE_DISKS;
+            const std::vector<restore_segment_link_t> & segmentLinksVec = diskScansVec[diskIndex].segmentLinksVec;
+            if (localSegmentIndex >= segmentLinksVec.size()) {
+                LOG_ERROR(subprocess) << "Error: segment " << segmentId << " of logical segment " << logicalSegment
+                    << " is beyond the end of disk " << diskIndex;
                 return false;
             }
-
-            StorageSegmentHeaderUnion storageSegmentHeaderUnion;
-            StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
-            //note: SEGMENT_RESERVED_SPACE is 4 bytes smaller than sizeof(StorageSegmentHeader) if segment_id_t is 32-bit
-            memcpy(storageSegmentHeaderUnion.rawBytes, dataReadBuf, SEGMENT_RESERVED_SPACE);
-            storageSegmentHeader.ToNativeEndianInplace(); //should optimize out and do nothing
-
-            
-            if ((session.nextLogicalSegment == 0) && (storageSegmentHeader.bundleSizeBytes != UINT64_MAX)) { //head segment
-                headSegmentFound = true;
-                custodyIdHeadSegment = storageSegmentHeader.custodyId;
-
-                uint8_t * bundleDataBegin = dataReadBuf + SEGMENT_RESERVED_SPACE;
-                
-                const uint8_t firstByte = bundleDataBegin[0];
-                const bool isBpVersion6 = (firstByte == 6);
-                const bool isBpVersion7 = (firstByte == ((4U << 5) | 31U));  //CBOR major type 4, additional information 31 (Indefinite-Length Array)
-                if (isBpVersion6) {
-                    if (!bv6.LoadBundle(bundleDataBegin, BUNDLE_STORAGE_PER_SEGMENT_SIZE, true)) { //load primary only
-                        LOG_ERROR(subprocess) << "malformed bundle";
-                        return false;
-                    }
-                    Bpv6CbhePrimaryBlock & primary = bv6.m_primaryBlockView.header;
-                    primaryBasePtr = &primary;
-                }
-                else if (isBpVersion7) {
-                    if (!bv7.LoadBundle(bundleDataBegin, BUNDLE_STORAGE_PER_SEGMENT_SIZE, true, true)) { //load primary only
-                        LOG_ERROR(subprocess) << "malformed bundle";
-                        return false;
-                    }
-                    Bpv7CbhePrimaryBlock & primary = bv7.m_primaryBlockView.header;
-                    primaryBasePtr = &primary;
-                }
-                else {
-                    LOG_ERROR(subprocess) << "error in BundleStorageManagerBase::RestoreFromDisk: unknown bundle version detected";
-                    return false;
-                }
-                const uint64_t totalSegmentsRequired = (storageSegmentHeader.bundleSizeBytes / BUNDLE_STORAGE_PER_SEGMENT_SIZE) + ((storageSegmentHeader.bundleSizeBytes % BUNDLE_STORAGE_PER_SEGMENT_SIZE) == 0 ? 0 : 1);
-
-                *totalBytesRestored += storageSegmentHeader.bundleSizeBytes;
-                *totalSegmentsRestored += totalSegmentsRequired;
-                catalogEntry.Init(*primaryBasePtr, storageSegmentHeader.bundleSizeBytes, storageSegmentHeader.payloadSizeBytes, totalSegmentsRequired, NULL); //NULL replaced later at CatalogIncomingBundleForStore
-            }
-            if (!headSegmentFound) break;
-            if (custodyIdHeadSegment != storageSegmentHeader.custodyId) { //shall be the same across all segments
+            const restore_segment_link_t & link = segmentLinksVec[localSegmentIndex];
+            if (head.custodyId != link.custodyId) { //shall be the same across all segments
                 LOG_ERROR(subprocess) << "error: custodyIdHeadSegment != custodyId";
                 return false;
             }
-            if ((session.nextLogicalSegment) >= segmentIdChainVec.size()) {
-                LOG_ERROR(subprocess) << "error: logical segment exceeds total segments required";
-                return false;
-            }
-            if (!m_memoryManager.IsSegmentFree(segmentId)) { //todo this is redundant per function below
-                LOG_ERROR(subprocess) << "error: segmentId is already allocated";
-                return false;
-            }
             if (!m_memoryManager.AllocateSegmentId_NotThreadSafe(segmentId)) {
                 LOG_ERROR(subprocess) << "error: AllocateSegmentId_NotThreadSafe: segmentId is already allocated";
                 return false;
             }
-            segmentIdChainVec[session.nextLogicalSegment] = segmentId;
-
+            AppendSegmentIdToExtents(catalogEntry.segmentIdExtentsVec, segmentId);
 
-
-            if ((session.nextLogicalSegment + 1) >= segmentIdChainVec.size()) { //==
-                if (storageSegmentHeader.nextSegmentId != SEGMENT_ID_LAST) { //there are more segments
+            if ((logicalSegment + 1) >= totalSegmentsRequired) { //==
+                if (link.nextSegmentId != SEGMENT_ID_LAST) { //there are more segments
                     LOG_ERROR(subprocess) << "error: at the last logical segment but nextSegmentId != SEGMENT_ID_LAST";
                     return false;
                 }
-                m_bundleStorageCatalog.CatalogIncomingBundleForStore(catalogEntry, *primaryBasePtr, storageSegmentHeader.custodyId, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO);
+                catalogEntry.segmentIdExtentsVec.ShrinkToFit();
+                m_bundleStorageCatalog.CatalogIncomingBundleForStore(catalogEntry, head.bundleUuid, head.custodyId, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO);
                 *totalBundlesRestored += 1;
                 break;
             }
 
-            if (storageSegmentHeader.nextSegmentId == SEGMENT_ID_LAST) { //there are more segments
+            if (link.nextSegmentId == SEGMENT_ID_LAST) { //there are more segments
                 LOG_ERROR(subprocess) << "error: there are more logical segments but nextSegmentId == SEGMENT_ID_LAST";
                 return false;
             }
-            segmentId = storageSegmentHeader.nextSegmentId;
-
+            segmentId = link.nextSegmentId;
         }
     }
 
-
-    for (unsigned int tId = 0; tId < M_NUM_STORAGE_DISKS; ++tId) {
-        fclose(fileHandlesVec[tId]);
+    //then the bundles of the small bundle slabs (whose slab segments are allocated by RestoreSmallBundleSlabs)
+    std::sort(slabSlotPtrsVec.begin(), slabSlotPtrsVec.end(), [](const restore_slab_slot_t * a, const restore_slab_slot_t * b) {
+        return (a->segmentId < b->segmentId) || ((a->segmentId == b->segmentId) && (a->slotIndex < b->slotIndex));
+    });
+    for (std::size_t i = 0; i < slabSlotPtrsVec.size(); ++i) {
+        restore_slab_slot_t & slabSlot = *slabSlotPtrsVec[i];
+        if (!slabSlot.primaryLoaded) {
+            LOG_ERROR(subprocess) << "malformed bundle or unknown bundle version detected in small bundle slab segment " << slabSlot.segmentId;
+            return false;
+        }
+        if (!m_memoryManager.IsSegmentFree(slabSlot.segmentId)) {
+            LOG_ERROR(subprocess) << "error: small bundle slab segment " << slabSlot.segmentId << " is part of another bundle's chain";
+            return false;
+        }
+        catalog_entry_t & catalogEntry = slabSlot.catalogEntry;
+        catalogEntry.segmentIdExtentsVec = { segment_id_extent_t{ slabSlot.segmentId, static_cast<segment_id_t>(SMALL_BUNDLE_SLAB_EXTENT_FLAG | slabSlot.slotIndex) } };
+        *totalBytesRestored += catalogEntry.bundleSizeBytes;
+        m_bundleStorageCatalog.CatalogIncomingBundleForStore(catalogEntry, slabSlot.bundleUuid, slabSlot.custodyId, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO);
+        *totalBundlesRestored += 1;
     }
+    LOG_INFO(subprocess) << "end of restore";
 
     m_successfullyRestoredFromDisk = true;
     return true;
 }
 
 
+
+//Rebuild the small bundle slabs (and their RAM mirrors) from the restored catalog entries of bundles in slab slots,
+//reading each slab segment from its disk.  Called after either kind of restore, before the disk threads are started.
+//A bundle whose slot does not hold it (e.g. journaled but its slab never written before a crash) is dropped from the catalog
+//(and from the restore totals) rather than failing the whole restore, as is every bundle of a slab which cannot be read.
+void BundleStorageManagerBase::RestoreSmallBundleSlabs() {
+    typedef std::vector<std::pair<uint64_t, const catalog_entry_t*> > custody_id_entry_ptr_vec_t;
+    custody_id_entry_ptr_vec_t custodyIdAndEntryPtrs;
+    m_bundleStorageCatalog.GetAllEntries(custodyIdAndEntryPtrs);
+    std::map<segment_id_t, custody_id_entry_ptr_vec_t> slabSegmentIdToBundlesMap;
+    for (std::size_t i = 0; i < custodyIdAndEntryPtrs.size(); ++i) {
+        const catalog_entry_t * catalogEntryPtr = custodyIdAndEntryPtrs[i].second;
+        if (catalogEntryPtr->IsInSmallBundleSlab()) {
+            slabSegmentIdToBundlesMap[catalogEntryPtr->segmentIdExtentsVec[0].beginSegmentId].push_back(custodyIdAndEntryPtrs[i]);
+        }
+    }
+    std::vector<std::pair<uint64_t, uint64_t> > droppedCustodyIdsAndSizes; //removed from the catalog once every entry pointer is done with
+    std::vector<std::unique_ptr<std::ifstream> > diskFilesVec(M_NUM_STORAGE_DISKS);
+    for (std::map<segment_id_t, custody_id_entry_ptr_vec_t>::const_iterator it = slabSegmentIdToBundlesMap.cbegin();
+        it != slabSegmentIdToBundlesMap.cend(); ++it)
+    {
+        const segment_id_t slabSegmentId = it->first;
+        const custody_id_entry_ptr_vec_t & slabBundlesVec = it->second;
+        const std::size_t numDroppedBefore = droppedCustodyIdsAndSizes.size();
+        small_bundle_slab_t slab;
+        slab.usedSlotsMask = 0;
+        slab.isOnDisk = true;
+        bool slabIsValid = false;
+        bool slabSegmentAllocated = false;
+        if (!m_memoryManager.AllocateSegmentId_NotThreadSafe(slabSegmentId)) {
+            LOG_ERROR(subprocess) << "error: small bundle slab segment " << slabSegmentId << " is already allocated";
+        }
+        else {
+            slabSegmentAllocated = true;
+            const unsigned int diskId = slabSegmentId % M_NUM_STORAGE_DISKS;
+            std::unique_ptr<std::ifstream> & diskFilePtr = diskFilesVec[diskId];
+            if (!diskFilePtr) {
+                diskFilePtr = boost::make_unique<std::ifstream>(m_storageConfigPtr->m_storageDiskConfigVector[diskId].storeFilePath, std::ifstream::in | std::ifstream::binary);
+            }
+            slab.segmentImage.reset(new uint8_t[SEGMENT_SIZE]);
+            diskFilePtr->clear(); //a failed read of a previous slab must not fail this one
+            diskFilePtr->seekg(static_cast<std::streamoff>((slabSegmentId / M_NUM_STORAGE_DISKS) * static_cast<uint64_t>(SEGMENT_SIZE)));
+            diskFilePtr->read(reinterpret_cast<char*>(slab.segmentImage.get()), SEGMENT_SIZE);
+            StorageSegmentHeaderUnion storageSegmentHeaderUnion;
+            StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
+            memcpy(storageSegmentHeaderUnion.rawBytes, slab.segmentImage.get(), SEGMENT_RESERVED_SPACE);
+            storageSegmentHeader.ToNativeEndianInplace(); //should optimize out and do nothing
+            if (!(*diskFilePtr)) {
+                LOG_ERROR(subprocess) << "Error reading small bundle slab segment " << slabSegmentId << " from disk " << diskId;
+            }
+            else if ((storageSegmentHeader.bundleSizeBytes != SMALL_BUNDLE_SLAB_HEADER_BUNDLE_SIZE)
+                || (!GetSmallBundleSlabSizeClassIndex(storageSegmentHeader.payloadSizeBytes, slab.sizeClassIndex)))
+            {
+                LOG_ERROR(subprocess) << "error: segment " << slabSegmentId << " is not a small bundle slab";
+            }
+            else {
+                slabIsValid = true;
+            }
+        }
+        if (!slabIsValid) {
+            for (std::size_t i = 0; i < slabBundlesVec.size(); ++i) {
+                droppedCustodyIdsAndSizes.emplace_back(slabBundlesVec[i].first, slabBundlesVec[i].second->bundleSizeBytes);
+            }
+        }
+        else {
+            const uint64_t slotSize = GetSmallBundleSlabSlotSize(slab.sizeClassIndex);
+            const unsigned int numSlots = GetSmallBundleSlabNumSlots(slab.sizeClassIndex);
+            for (std::size_t i = 0; i < slabBundlesVec.size(); ++i) {
+                const uint64_t custodyId = slabBundlesVec[i].first;
+                const catalog_entry_t & catalogEntry = *slabBundlesVec[i].second;
+                const unsigned int slotIndex = catalogEntry.GetSmallBundleSlabSlotIndex();
+                const uint64_t slotMask = static_cast<uint64_t>(1) << slotIndex;
+                if ((slotIndex >= numSlots) || (slab.usedSlotsMask & slotMask)) {
+                    LOG_ERROR(subprocess) << "error: custody id " << custodyId << " has an invalid slot in small bundle slab segment " << slabSegmentId;
+                    droppedCustodyIdsAndSizes.emplace_back(custodyId, catalogEntry.bundleSizeBytes);
+                    continue;
+                }
+                const uint8_t * const slot = slab.segmentImage.get() + SEGMENT_RESERVED_SPACE + (slotIndex * slotSize);
+                uint64_t custodyIdLittleEndian;
+                uint32_t bundleSizeBytesLittleEndian;
+                memcpy(&custodyIdLittleEndian, slot, sizeof(custodyIdLittleEndian));
+                memcpy(&bundleSizeBytesLittleEndian, slot + sizeof(uint64_t), sizeof(bundleSizeBytesLittleEndian));
+                if ((boost::endian::little_to_native(custodyIdLittleEndian) != custodyId)
+                    || (boost::endian::little_to_native(bundleSizeBytesLittleEndian) != catalogEntry.bundleSizeBytes))
+                {
+                    LOG_ERROR(subprocess) << "error: custody id " << custodyId << " is not in its slot of small bundle slab segment " << slabSegmentId;
+                    droppedCustodyIdsAndSizes.emplace_back(custodyId, catalogEntry.bundleSizeBytes);
+                    continue;
+                }
+                slab.usedSlotsMask |= slotMask;
+            }
+        }
+        if (droppedCustodyIdsAndSizes.size() != numDroppedBefore) {
+            LOG_WARNING(subprocess) << "dropping " << (droppedCustodyIdsAndSizes.size() - numDroppedBefore) << " of the "
+                << slabBundlesVec.size() << " bundles of small bundle slab segment " << slabSegmentId << " from the restore";
+        }
+        if (slab.usedSlotsMask == 0) { //nothing left to restore in this slab
+            if (slabSegmentAllocated) {
+                m_memoryManager.FreeSegmentId_NotThreadSafe(slabSegmentId);
+            }
+            continue;
+        }
+        const uint64_t slotSize = GetSmallBundleSlabSlotSize(slab.sizeClassIndex);
+        const unsigned int numSlots = GetSmallBundleSlabNumSlots(slab.sizeClassIndex);
+        bool forgotSlotsOnDisk = false;
+        for (unsigned int slotIndex = 0; slotIndex < numSlots; ++slotIndex) { //forget slots removed from the catalog but not from the disk
+            uint8_t * const slot = slab.segmentImage.get() + SEGMENT_RESERVED_SPACE + (slotIndex * slotSize);
+            if (((slab.usedSlotsMask & (static_cast<uint64_t>(1) << slotIndex)) == 0)
+                && (std::count(slot, slot + SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE, 0) != SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE))
+            {
+                memset(slot, 0, SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE);
+                forgotSlotsOnDisk = true;
+            }
+        }
+        if (slab.usedSlotsMask != (UINT64_MAX >> (SMALL_BUNDLE_SLAB_MAX_SLOTS - numSlots))) {
+            m_smallBundleSlabsWithFreeSlotsSets[slab.sizeClassIndex].insert(slabSegmentId);
+        }
+        m_smallBundleSlabsMap.emplace(slabSegmentId, std::move(slab));
+        if (forgotSlotsOnDisk) { //so that a later restore by scanning the disks cannot bring them back
+            MarkSmallBundleSlabDirty(slabSegmentId, 0, SEGMENT_SIZE);
+        }
+        ++m_totalSegmentsRestored;
+    }
+    for (std::size_t i = 0; i < droppedCustodyIdsAndSizes.size(); ++i) {
+        m_bundleStorageCatalog.Remove(droppedCustodyIdsAndSizes[i].first, true);
+        --m_totalBundlesRestored;
+        m_totalBytesRestored -= droppedCustodyIdsAndSizes[i].second;
+    }
+    m_totalSmallBundlesDroppedFromRestore = droppedCustodyIdsAndSizes.size();
+    if (!m_smallBundleSlabsMap.empty()) {
+        LOG_INFO(subprocess) << "restored " << m_smallBundleSlabsMap.size() << " small bundle slabs";
+    }
+}
+
+//The journal records a bundle once its segment writes are queued, so after a crash a journal restored bundle may never have
+//reached the disks.  Read the header of the first and last segment of every restored bundle (other than those of the small
+//bundle slabs, which RestoreSmallBundleSlabs checks) from its disk and drop the bundle from the catalog (and from the restore
+//totals), freeing its segments, if either does not hold that bundle.  Called before the disk threads are started.
+void BundleStorageManagerBase::DropUnwrittenBundlesFromCatalogJournalRestore() {
+    typedef std::vector<std::pair<uint64_t, const catalog_entry_t*> > custody_id_entry_ptr_vec_t;
+    custody_id_entry_ptr_vec_t custodyIdAndEntryPtrs;
+    m_bundleStorageCatalog.GetAllEntries(custodyIdAndEntryPtrs);
+    std::vector<std::unique_ptr<std::ifstream> > diskFilesVec(M_NUM_STORAGE_DISKS);
+    //returns false if the segment's header can't be read or is not of the bundle
+    auto segmentHeaderMatches = [&](const segment_id_t segmentId, const uint64_t custodyId, const uint64_t expectedBundleSizeBytes) -> bool {
+        const unsigned int diskId = segmentId % M_NUM_STORAGE_DISKS;
+        std::unique_ptr<std::ifstream> & diskFilePtr = diskFilesVec[diskId];
+        if (!diskFilePtr) {
+            diskFilePtr = boost::make_unique<std::ifstream>(m_storageConfigPtr->m_storageDiskConfigVector[diskId].storeFilePath, std::ifstream::in | std::ifstream::binary);
+        }
+        StorageSegmentHeaderUnion storageSegmentHeaderUnion;
+        StorageSegmentHeader& storageSegmentHeader = storageSegmentHeaderUnion.hdr;
+        diskFilePtr->clear(); //a failed read of a previous segment must not fail this one
+        diskFilePtr->seekg(static_cast<std::streamoff>((segmentId / M_NUM_STORAGE_DISKS) * static_cast<uint64_t>(SEGMENT_SIZE)));
+        diskFilePtr->read(reinterpret_cast<char*>(storageSegmentHeaderUnion.rawBytes), SEGMENT_RESERVED_SPACE);
+        if (!(*diskFilePtr)) {
+            return false;
+        }
+        storageSegmentHeader.ToNativeEndianInplace(); //should optimize out and do nothing
+        return (storageSegmentHeader.custodyId == custodyId) && (storageSegmentHeader.bundleSizeBytes == expectedBundleSizeBytes);
+    };
+    std::vector<std::pair<uint64_t, const catalog_entry_t*> > droppedCustodyIdAndEntryPtrs; //removed from the catalog once every entry pointer is done with
+    for (std::size_t i = 0; i < custodyIdAndEntryPtrs.size(); ++i) {
+        const uint64_t custodyId = custodyIdAndEntryPtrs[i].first;
+        const catalog_entry_t & catalogEntry = *custodyIdAndEntryPtrs[i].second;
+        if (catalogEntry.IsInSmallBundleSlab()) {
+            continue;
+        }
+        const segment_id_extents_vec_t & segmentIdExtentsVec = catalogEntry.segmentIdExtentsVec;
+        const segment_id_t headSegmentId = segmentIdExtentsVec[0].beginSegmentId;
+        const segment_id_t lastSegmentId = segmentIdExtentsVec.back().beginSegmentId + (segmentIdExtentsVec.back().numSegments - 1);
+        if ((!segmentHeaderMatches(headSegmentId, custodyId, catalogEntry.bundleSizeBytes))
+            || ((lastSegmentId != headSegmentId) && (!segmentHeaderMatches(lastSegmentId, custodyId, UINT64_MAX))))
+        {
+            LOG_ERROR(subprocess) << "error: custody id " << custodyId << " was journaled but is not on the disks, dropping it from the restore";
+            droppedCustodyIdAndEntryPtrs.push_back(custodyIdAndEntryPtrs[i]);
+        }
+    }
+    for (std::size_t i = 0; i < droppedCustodyIdAndEntryPtrs.size(); ++i) {
+        const uint64_t custodyId = droppedCustodyIdAndEntryPtrs[i].first;
+        const segment_id_extents_vec_t extentsVec(droppedCustodyIdAndEntryPtrs[i].second->segmentIdExtentsVec); //the entry is freed by Remove
+        const uint64_t bundleSizeBytes = droppedCustodyIdAndEntryPtrs[i].second->bundleSizeBytes;
+        const uint64_t numSegments = droppedCustodyIdAndEntryPtrs[i].second->GetNumSegments();
+        m_bundleStorageCatalog.Remove(custodyId, true);
+        m_memoryManager.FreeSegmentExtents_ThreadSafe(extentsVec);
+        --m_totalBundlesRestored;
+        m_totalBytesRestored -= bundleSizeBytes;
+        m_totalSegmentsRestored -= numSegments;
+    }
+    m_totalUnwrittenBundlesDroppedFromRestore = droppedCustodyIdAndEntryPtrs.size();
+}
+
+#ifndef _WIN32
+int BundleStorageManagerBase::OpenStorageDiskFile(const unsigned int diskId) {
+    const boost::filesystem::path& filePath = m_filePathsVec[diskId];
+    const bool useDirectIo = m_storageConfigPtr->m_storageDiskConfigVector[diskId].useDirectIo;
+    int flags = (m_successfullyRestoredFromDisk) ? (O_RDWR) : (O_CREAT | O_RDWR | O_TRUNC);
+#if !(BOOST_OS_MACOS || BOOST_OS_BSD)
+    flags |= O_LARGEFILE;
+#endif
+    if (useDirectIo) {
+#ifdef O_DIRECT
+        flags |= O_DIRECT;
+#elif !BOOST_OS_MACOS
+        LOG_ERROR(subprocess) << "error opening " << filePath << ": useDirectIo is not supported on this platform";
+        return -1;
+#endif
+    }
+    int fd;
+    if (useDirectIo && m_simulateFileSystemRejectsDirectIo) {
+        fd = -1;
+        errno = EINVAL;
+    }
+    else {
+        fd = open(filePath.c_str(), flags, DEFFILEMODE);
+    }
+    if (useDirectIo && (fd < 0) && (errno == EINVAL)) {
+        LOG_ERROR(subprocess) << "error opening " << filePath << ": the file system does not support O_DIRECT "
+            << "(set useDirectIo to false for this disk to use buffered I/O)";
+        return -1;
+    }
+    if (fd < 0) {
+        LOG_ERROR(subprocess) << "error opening " << filePath << ": " << strerror(errno);
+        return -1;
+    }
+#if BOOST_OS_MACOS
+    if (useDirectIo && (fcntl(fd, F_NOCACHE, 1) == -1)) {
+        LOG_ERROR(subprocess) << "error opening " << filePath << ": unable to set F_NOCACHE (" << strerror(errno)
+            << ") (set useDirectIo to false for this disk to use buffered I/O)";
+        close(fd);
+        return -1;
+    }
+#endif
+    m_directIoActiveVec[diskId] = useDirectIo;
+    return fd;
+}
+#endif
@@ -0,0 +1,481 @@
+/**
+ * @file BundleStorageManagerIoUring.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#ifndef _LARGEFILE64_SOURCE
+#define _LARGEFILE64_SOURCE
+#endif
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstring>
+
+#include "BundleStorageManagerIoUring.h"
+#include <string>
+#include <boost/filesystem/path.hpp>
+#include <memory>
+#include <boost/make_unique.hpp>
+#include "ThreadNamer.h"
+
+static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::storage;
+
+//io_uring user_data encoding of a circular buffer slot: upper 32 bits diskId, lower 32 bits consumeIndex
+static BOOST_FORCEINLINE uint64_t EncodeUserData(const unsigned int diskId, const unsigned int cbIndex) {
+    return (static_cast<uint64_t>(diskId) << 32) | cbIndex;
+}
+
+struct BundleStorageManagerIoUring::Impl : private boost::noncopyable {
+    Impl(const unsigned int numDisks);
+    ~Impl();
+    bool Setup(const unsigned int numEntries);
+    void Teardown();
+    io_uring_sqe* GetSqe();
+    int Enter(const unsigned int toSubmit, const unsigned int minComplete);
+
+    struct PerDiskState {
+        PerDiskState() : fd(-1), numQueued(0), numInFlight(0), isCompleted() {}
+        int fd;
+        //number of circular buffer slots, starting at the read index, that have been handed to the kernel
+        //(either in flight or completed but not yet committed because an older slot is still in flight)
+        unsigned int numQueued;
+        unsigned int numInFlight;
+        boost::posix_time::ptime busyStartPtime; //when numInFlight last became non-zero
+        bool isCompleted[CIRCULAR_INDEX_BUFFER_SIZE];
+    };
+    std::vector<PerDiskState> m_perDiskStates;
+
+    int m_ringFd;
+    unsigned int m_sqEntries;
+    unsigned int m_numInFlight;
+    unsigned int m_numSqesPendingSubmit;
+    bool m_usingFixedFiles;
+    bool m_usingFixedBuffers;
+
+    void* m_sqRingPtr;
+    std::size_t m_sqRingSize;
+    void* m_cqRingPtr;
+    std::size_t m_cqRingSize;
+    io_uring_sqe* m_sqesPtr;
+    std::size_t m_sqesSize;
+
+    unsigned int* m_sqHeadPtr;
+    unsigned int* m_sqTailPtr;
+    unsigned int* m_sqRingMaskPtr;
+    unsigned int* m_sqArrayPtr;
+    unsigned int* m_cqHeadPtr;
+    unsigned int* m_cqTailPtr;
+    unsigned int* m_cqRingMaskPtr;
+    io_uring_cqe* m_cqesPtr;
+};
+
+BundleStorageManagerIoUring::Impl::Impl(const unsigned int numDisks) :
+    m_perDiskStates(numDisks),
+    m_ringFd(-1),
+    m_sqEntries(0),
+    m_numInFlight(0),
+    m_numSqesPendingSubmit(0),
+    m_usingFixedFiles(false),
+    m_usingFixedBuffers(false),
+    m_sqRingPtr(MAP_FAILED),
+    m_sqRingSize(0),
+    m_cqRingPtr(MAP_FAILED),
+    m_cqRingSize(0),
+    m_sqesPtr(static_cast<io_uring_sqe*>(MAP_FAILED)),
+    m_sqesSize(0),
+    m_sqHeadPtr(NULL),
+    m_sqTailPtr(NULL),
+    m_sqRingMaskPtr(NULL),
+    m_sqArrayPtr(NULL),
+    m_cqHeadPtr(NULL),
+    m_cqTailPtr(NULL),
+    m_cqRingMaskPtr(NULL),
+    m_cqesPtr(NULL) {}
+
+BundleStorageManagerIoUring::Impl::~Impl() {
+    Teardown();
+}
+
+bool BundleStorageManagerIoUring::Impl::Setup(const unsigned int numEntries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, numEntries, &params));
+    if (m_ringFd < 0) {
+        LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: io_uring_setup failed: " << strerror(errno);
+        return false;
+    }
+    m_sqEntries = params.sq_entries;
+    m_sqRingSize = params.sq_off.array + (params.sq_entries * sizeof(unsigned int));
+    m_cqRingSize = params.cq_off.cqes + (params.cq_entries * sizeof(io_uring_cqe));
+    const bool singleMmap = ((params.features & IORING_FEAT_SINGLE_MMAP) != 0);
+    if (singleMmap) {
+        m_sqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        m_cqRingSize = m_sqRingSize;
+    }
+    m_sqRingPtr = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+    if (m_sqRingPtr == MAP_FAILED) {
+        LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: unable to mmap submission queue ring: " << strerror(errno);
+        return false;
+    }
+    if (singleMmap) {
+        m_cqRingPtr = m_sqRingPtr;
+    }
+    else {
+        m_cqRingPtr = mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+        if (m_cqRingPtr == MAP_FAILED) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: unable to mmap completion queue ring: " << strerror(errno);
+            return false;
+        }
+    }
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqesPtr = static_cast<io_uring_sqe*>(mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES));
+    if (m_sqesPtr == MAP_FAILED) {
+        LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: unable to mmap submission queue entries: " << strerror(errno);
+        return false;
+    }
+    uint8_t* const sqRing = static_cast<uint8_t*>(m_sqRingPtr);
+    m_sqHeadPtr = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.head);
+    m_sqTailPtr = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.tail);
+    m_sqRingMaskPtr = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.ring_mask);
+    m_sqArrayPtr = reinterpret_cast<unsigned int*>(sqRing + params.sq_off.array);
+    uint8_t* const cqRing = static_cast<uint8_t*>(m_cqRingPtr);
+    m_cqHeadPtr = reinterpret_cast<unsigned int*>(cqRing + params.cq_off.head);
+    m_cqTailPtr = reinterpret_cast<unsigned int*>(cqRing + params.cq_off.tail);
+    m_cqRingMaskPtr = reinterpret_cast<unsigned int*>(cqRing + params.cq_off.ring_mask);
+    m_cqesPtr = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+    return true;
+}
+
+void BundleStorageManagerIoUring::Impl::Teardown() {
+    if (m_sqesPtr != MAP_FAILED) {
+        munmap(m_sqesPtr, m_sqesSize);
+        m_sqesPtr = static_cast<io_uring_sqe*>(MAP_FAILED);
+    }
+    if ((m_cqRingPtr != MAP_FAILED) && (m_cqRingPtr != m_sqRingPtr)) {
+        munmap(m_cqRingPtr, m_cqRingSize);
+    }
+    m_cqRingPtr = MAP_FAILED;
+    if (m_sqRingPtr != MAP_FAILED) {
+        munmap(m_sqRingPtr, m_sqRingSize);
+        m_sqRingPtr = MAP_FAILED;
+    }
+    if (m_ringFd >= 0) {
+        close(m_ringFd); //also unregisters files and buffers
+        m_ringFd = -1;
+    }
+    for (std::size_t i = 0; i < m_perDiskStates.size(); ++i) {
+        if (m_perDiskStates[i].fd >= 0) {
+            close(m_perDiskStates[i].fd);
+            m_perDiskStates[i].fd = -1;
+        }
+    }
+}
+
+//returns NULL if the submission queue is full (never expected since the ring is sized for every circular buffer slot)
+io_uring_sqe* BundleStorageManagerIoUring::Impl::GetSqe() {
+    const unsigned int head = __atomic_load_n(m_sqHeadPtr, __ATOMIC_ACQUIRE);
+    const unsigned int tail = *m_sqTailPtr; //only this thread writes the tail
+    if ((tail - head) >= m_sqEntries) {
+        return NULL;
+    }
+    const unsigned int index = tail & (*m_sqRingMaskPtr);
+    io_uring_sqe* const sqe = &m_sqesPtr[index];
+    memset(sqe, 0, sizeof(io_uring_sqe));
+    m_sqArrayPtr[index] = index;
+    __atomic_store_n(m_sqTailPtr, tail + 1, __ATOMIC_RELEASE);
+    ++m_numSqesPendingSubmit;
+    return sqe;
+}
+
+int BundleStorageManagerIoUring::Impl::Enter(const unsigned int toSubmit, const unsigned int minComplete) {
+    const unsigned int flags = (minComplete) ? IORING_ENTER_GETEVENTS : 0;
+    return static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, NULL, 0));
+}
+
+BundleStorageManagerIoUring::BundleStorageManagerIoUring() : BundleStorageManagerIoUring("storageConfig.json") {}
+
+BundleStorageManagerIoUring::BundleStorageManagerIoUring(const boost::filesystem::path& jsonConfigFilePath) :
+    BundleStorageManagerIoUring(StorageConfig::CreateFromJsonFilePath(jsonConfigFilePath))
+{
+    if (!m_storageConfigPtr) {
+        LOG_ERROR(subprocess) << "cannot open storage json config file: " << jsonConfigFilePath;
+        return;
+    }
+}
+
+BundleStorageManagerIoUring::BundleStorageManagerIoUring(const StorageConfig_ptr & storageConfigPtr) :
+    BundleStorageManagerBase(storageConfigPtr),
+    m_pimpl(boost::make_unique<Impl>(M_NUM_STORAGE_DISKS)),
+    m_running(false),
+    m_noFatalErrorsOccurred(true)
+{
+
+}
+
+void BundleStorageManagerIoUring::StopThread() {
+    //lock then unlock the thread's mutex to prevent a missed notify after setting thread stopping criteria
+    m_mutexIoUringThread.lock();
+    m_running = false; //thread stopping criteria
+    m_mutexIoUringThread.unlock();
+    m_conditionVariableIoUringThread.notify_one();
+}
+
+BundleStorageManagerIoUring::~BundleStorageManagerIoUring() {
+    StopThread();
+    if (m_threadPtr) {
+        try {
+            m_threadPtr->join();
+            m_threadPtr.reset(); //delete it
+        }
+        catch (const boost::thread_resource_error&) {
+            LOG_ERROR(subprocess) << "error stopping BundleStorageManagerIoUring thread";
+        }
+    }
+    m_pimpl->Teardown();
+}
+
+bool BundleStorageManagerIoUring::OpenFilesAndSetupRing() {
+    Impl& impl = *m_pimpl;
+    std::vector<int> fds(M_NUM_STORAGE_DISKS);
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        LOG_INFO(subprocess) << ((m_successfullyRestoredFromDisk) ? "reopening " : "creating ") << m_filePathsVec[diskId];
+        const int fd = OpenStorageDiskFile(diskId);
+        if (fd < 0) {
+            return false;
+        }
+        impl.m_perDiskStates[diskId].fd = fd;
+        fds[diskId] = fd;
+    }
+
+    //one submission queue entry for every circular buffer slot of every disk
+    if (!impl.Setup(CIRCULAR_INDEX_BUFFER_SIZE * M_NUM_STORAGE_DISKS)) {
+        return false;
+    }
+
+    //fixed files: avoids the per-operation fget/fput of the file descriptor
+    impl.m_usingFixedFiles = (syscall(__NR_io_uring_register, impl.m_ringFd, IORING_REGISTER_FILES, fds.data(), M_NUM_STORAGE_DISKS) == 0);
+    if (!impl.m_usingFixedFiles) {
+        LOG_WARNING(subprocess) << "BundleStorageManagerIoUring: unable to register files (" << strerror(errno) << "), using regular file descriptors";
+    }
+
+    //fixed buffers: the write circular buffers are pinned once rather than mapped on every write operation
+    //(session read caches are not registered since they are allocated per read session)
+    std::vector<struct iovec> iovecs(M_NUM_STORAGE_DISKS);
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        iovecs[diskId].iov_base = &m_circularBufferBlockDataPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
+        iovecs[diskId].iov_len = CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE;
+    }
+    impl.m_usingFixedBuffers = (syscall(__NR_io_uring_register, impl.m_ringFd, IORING_REGISTER_BUFFERS, iovecs.data(), M_NUM_STORAGE_DISKS) == 0);
+    if (!impl.m_usingFixedBuffers) {
+        LOG_WARNING(subprocess) << "BundleStorageManagerIoUring: unable to register buffers (" << strerror(errno)
+            << "), using unregistered buffers (check RLIMIT_MEMLOCK)";
+    }
+    return true;
+}
+
+void BundleStorageManagerIoUring::Start() {
+    if ((!m_running) && (m_storageConfigPtr)) {
+        if (!OpenFilesAndSetupRing()) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: unable to start";
+            m_pimpl->Teardown();
+            return;
+        }
+        m_running = true;
+        m_noFatalErrorsOccurred = true;
+        m_threadPtr = boost::make_unique<boost::thread>(
+            boost::bind(&BundleStorageManagerIoUring::ThreadFunc, this)); //create and start the worker thread
+        StartDiskSpaceReclaimer();
+    }
+}
+
+bool BundleStorageManagerIoUring::HasUnqueuedDiskOperations_NotThreadSafe() const {
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        if (m_circularIndexBuffersVec[diskId].NumInBuffer() > m_pimpl->m_perDiskStates[diskId].numQueued) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//Turn every newly committed circular buffer slot of every disk into a submission queue entry.
+//Returns the number of submission queue entries prepared.
+unsigned int BundleStorageManagerIoUring::QueueNewDiskOperations_NotThreadSafe() {
+    Impl& impl = *m_pimpl;
+    unsigned int numPrepared = 0;
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        CircularIndexBufferSingleProducerSingleConsumerConfigurable& cb = m_circularIndexBuffersVec[diskId];
+        Impl::PerDiskState& diskState = impl.m_perDiskStates[diskId];
+        const unsigned int readIndex = cb.GetIndexForRead();
+        if (readIndex == CIRCULAR_INDEX_BUFFER_EMPTY) {
+            continue;
+        }
+        const unsigned int numInBuffer = cb.NumInBuffer();
+        segment_id_t* const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE];
+        while (diskState.numQueued < numInBuffer) {
+            const unsigned int consumeIndex = (readIndex + diskState.numQueued) % CIRCULAR_INDEX_BUFFER_SIZE;
+            const segment_id_t segmentId = circularBufferSegmentIdsPtr[consumeIndex];
+            if (segmentId == SEGMENT_ID_LAST) {
+                LOG_ERROR(subprocess) << "error segmentId is last";
+                m_noFatalErrorsOccurred = false; //a fatal error occurred
+                return numPrepared;
+            }
+
+            //Operations within a batch may complete in any order, so an operation on a segment that is
+            //already queued (i.e. a write followed by a read of the same segment) must wait for the older one.
+            bool conflicts = false;
+            for (unsigned int i = 0; i < diskState.numQueued; ++i) {
+                const unsigned int queuedIndex = (readIndex + i) % CIRCULAR_INDEX_BUFFER_SIZE;
+                if ((!diskState.isCompleted[queuedIndex]) && (circularBufferSegmentIdsPtr[queuedIndex] == segmentId)) {
+                    conflicts = true;
+                    break;
+                }
+            }
+            if (conflicts) {
+                break;
+            }
+
+            io_uring_sqe* const sqe = impl.GetSqe();
+            if (sqe == NULL) {
+                return numPrepared; //try again after reaping completions
+            }
+            const uint64_t offsetBytes = static_cast<uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
+            uint8_t* const readFromStorageDestPointer = m_circularBufferReadFromStoragePointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire);
+            const bool isWriteToDisk = (readFromStorageDestPointer == NULL);
+            if (isWriteToDisk) {
+                sqe->opcode = (impl.m_usingFixedBuffers) ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<uint64_t>(&m_circularBufferBlockDataPtr[(diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex) * SEGMENT_SIZE]);
+                sqe->buf_index = static_cast<uint16_t>(diskId);
+            }
+            else { //read from disk
+                sqe->opcode = IORING_OP_READ;
+                sqe->addr = reinterpret_cast<uint64_t>(readFromStorageDestPointer);
+            }
+            if (impl.m_usingFixedFiles) {
+                sqe->fd = static_cast<int32_t>(diskId);
+                sqe->flags = IOSQE_FIXED_FILE;
+            }
+            else {
+                sqe->fd = diskState.fd;
+            }
+            sqe->off = offsetBytes;
+            sqe->len = SEGMENT_SIZE;
+            sqe->user_data = EncodeUserData(diskId, consumeIndex);
+
+            diskState.isCompleted[consumeIndex] = false;
+            if (diskState.numInFlight++ == 0) {
+                diskState.busyStartPtime = boost::posix_time::microsec_clock::universal_time();
+            }
+            ++diskState.numQueued;
+            ++impl.m_numInFlight;
+            ++numPrepared;
+        }
+    }
+    return numPrepared;
+}
+
+void BundleStorageManagerIoUring::ReapCompletedDiskOperations_NotThreadSafe() {
+    Impl& impl = *m_pimpl;
+    unsigned int head = *impl.m_cqHeadPtr; //only this thread writes the head
+    const unsigned int tail = __atomic_load_n(impl.m_cqTailPtr, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return;
+    }
+
+    m_mutexMainThread.lock();
+    for (; head != tail; ++head) {
+        const io_uring_cqe& cqe = impl.m_cqesPtr[head & (*impl.m_cqRingMaskPtr)];
+        const unsigned int diskId = static_cast<unsigned int>(cqe.user_data >> 32);
+        const unsigned int consumeIndex = static_cast<unsigned int>(cqe.user_data);
+        --impl.m_numInFlight;
+        if (cqe.res < 0) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: disk " << diskId << " operation failed: " << strerror(-cqe.res);
+        }
+        else if (cqe.res != SEGMENT_SIZE) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: disk " << diskId << " bytes_transferred(" << cqe.res << ") != SEGMENT_SIZE(" << SEGMENT_SIZE << ")";
+        }
+        Impl::PerDiskState& diskState = impl.m_perDiskStates[diskId];
+        diskState.isCompleted[consumeIndex] = true;
+        //the disk is busy from when its first operation is queued until it has none in flight, however many overlap
+        uint64_t busyMicroseconds = 0;
+        if (--diskState.numInFlight == 0) {
+            busyMicroseconds = static_cast<uint64_t>((boost::posix_time::microsec_clock::universal_time() - diskState.busyStartPtime).total_microseconds());
+        }
+        RecordDiskOperationCompleted(diskId, (cqe.res > 0) ? static_cast<uint64_t>(cqe.res) : 0, busyMicroseconds);
+        //reads are made visible to the waiting session immediately, even if an older slot on this disk is still in flight
+        const unsigned int cbPtrIndex = diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex;
+        if (m_circularBufferReadFromStoragePointers[cbPtrIndex].load(std::memory_order_acquire) != NULL) {
+            m_circularBufferIsReadCompletedPointers[cbPtrIndex].load(std::memory_order_acquire)->store(true, std::memory_order_release);
+        }
+    }
+    __atomic_store_n(impl.m_cqHeadPtr, head, __ATOMIC_RELEASE);
+
+    //circular buffer slots can only be given back to the producer in order
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+        CircularIndexBufferSingleProducerSingleConsumerConfigurable& cb = m_circularIndexBuffersVec[diskId];
+        Impl::PerDiskState& diskState = impl.m_perDiskStates[diskId];
+        while (diskState.numQueued) {
+            const unsigned int consumeIndex = cb.GetIndexForRead();
+            if (!diskState.isCompleted[consumeIndex]) {
+                break;
+            }
+            diskState.isCompleted[consumeIndex] = false;
+            --diskState.numQueued;
+            cb.CommitRead();
+        }
+    }
+    m_mutexMainThread.unlock();
+    m_conditionVariableMainThread.notify_all(); //release workers may be waiting on reads too
+}
+
+void BundleStorageManagerIoUring::ThreadFunc() {
+    ThreadNamer::SetThisThreadName("StorageIoUring");
+    Impl& impl = *m_pimpl;
+
+    while (m_noFatalErrorsOccurred.load(std::memory_order_acquire)) {
+        QueueNewDiskOperations_NotThreadSafe();
+        if (impl.m_numInFlight == 0) {
+            boost::mutex::scoped_lock lock(m_mutexIoUringThread);
+            if (!HasUnqueuedDiskOperations_NotThreadSafe()) { //if empty again (lock mutex (above) before checking condition)
+                if (!m_running.load(std::memory_order_acquire)) {
+                    break; //thread stopping criteria (empty and not running)
+                }
+                m_conditionVariableIoUringThread.wait(lock); // call lock.unlock() and blocks the current thread
+            }
+            continue;
+        }
+
+        //submit the whole batch and wait for at least one completion in a single system call
+        const int ret = impl.Enter(impl.m_numSqesPendingSubmit, 1);
+        if (ret < 0) {
+            if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY)) {
+                continue;
+            }
+            LOG_ERROR(subprocess) << "BundleStorageManagerIoUring: io_uring_enter failed: " << strerror(errno);
+            m_noFatalErrorsOccurred = false; //a fatal error occurred
+            break;
+        }
+        impl.m_numSqesPendingSubmit -= std::min(static_cast<unsigned int>(ret), impl.m_numSqesPendingSubmit);
+        ReapCompletedDiskOperations_NotThreadSafe();
+    }
+}
+
+//virtual function to be called immediately after a disk's circular buffer CommitWrite();
+void BundleStorageManagerIoUring::CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int diskId) {
+    CircularIndexBufferSingleProducerSingleConsumerConfigurable& cb = m_circularIndexBuffersVec[diskId];
+    m_mutexIoUringThread.lock();
+    cb.CommitWrite();
+    m_mutexIoUringThread.unlock();
+    m_conditionVariableIoUringThread.notify_one();
+}
@@ -19,6 +19,10 @@
 #include <boost/make_unique.hpp>
 #include "ThreadNamer.h"
 #include <boost/predef/os.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
 
 static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::storage;
 
@@ -37,6 +41,7 @@ BundleStorageManagerMT::BundleStorageManagerMT(const StorageConfig_ptr & storage
 
     m_conditionVariablesPlusMutexesVec(M_NUM_STORAGE_DISKS),
     m_threadPtrsVec(M_NUM_STORAGE_DISKS),
+    m_directIoFileDescriptorsVec(M_NUM_STORAGE_DISKS, -1),
     m_running(false),
     m_noFatalErrorsOccurred(true)
 {
@@ -70,12 +75,36 @@ BundleStorageManagerMT::~BundleStorageManagerMT() {
 
 void BundleStorageManagerMT::Start() {
     if ((!m_running) && (m_storageConfigPtr)) {
+        //open the O_DIRECT disks up front so that a file system which rejects O_DIRECT fails before any thread starts
+        for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+            if (!m_storageConfigPtr->m_storageDiskConfigVector[diskId].useDirectIo) {
+                continue;
+            }
+#ifdef _WIN32
+            LOG_ERROR(subprocess) << "BundleStorageManagerMT: useDirectIo is not supported on Windows (use asio_single_threaded)";
+            return;
+#else
+            LOG_INFO(subprocess) << ((m_successfullyRestoredFromDisk) ? "reopening " : "creating ") << m_filePathsVec[diskId] << " with direct I/O";
+            m_directIoFileDescriptorsVec[diskId] = OpenStorageDiskFile(diskId);
+            if (m_directIoFileDescriptorsVec[diskId] < 0) {
+                for (unsigned int i = 0; i < diskId; ++i) {
+                    if (m_directIoFileDescriptorsVec[i] >= 0) {
+                        close(m_directIoFileDescriptorsVec[i]);
+                        m_directIoFileDescriptorsVec[i] = -1;
+                    }
+                }
+                LOG_ERROR(subprocess) << "BundleStorageManagerMT: unable to start";
+                return;
+            }
+#endif
+        }
         m_running = true;
         m_noFatalErrorsOccurred = true;
         for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
             m_threadPtrsVec[diskId] = boost::make_unique<boost::thread>(
                 boost::bind(&BundleStorageManagerMT::ThreadFunc, this, diskId)); //create and start the worker thread
         }
+        StartDiskSpaceReclaimer();
     }
 }
 
@@ -91,17 +120,27 @@ void BundleStorageManagerMT::ThreadFunc(const unsigned int threadIndex) {
     //const char * const filePath = m_storageConfigPtr->m_storageDiskConfigVector[threadIndex].storeFilePath.c_str();
     const boost::filesystem::path& filePath = m_filePathsVec[threadIndex];
     const boost::filesystem::path::value_type* filePathCstr = filePath.c_str();
-    LOG_INFO(subprocess) << ((m_successfullyRestoredFromDisk) ? "reopening " : "creating ") << filePath;
-    FILE * fileHandle = (m_successfullyRestoredFromDisk) ? 
+    const int directIoFileDescriptor = m_directIoFileDescriptorsVec[threadIndex]; //already opened by Start()
+    FILE * fileHandle = NULL;
+    if (directIoFileDescriptor < 0) {
+        LOG_INFO(subprocess) << ((m_successfullyRestoredFromDisk) ? "reopening " : "creating ") << filePath;
+        fileHandle = (m_successfullyRestoredFromDisk) ?
 #ifdef _WIN32
-        _wfopen(filePathCstr, L"r+bR") : _wfopen(filePathCstr, L"w+bR");
+            _wfopen(filePathCstr, L"r+bR") : _wfopen(filePathCstr, L"w+bR");
 #else
-        fopen(filePathCstr, "r+bR") : fopen(filePathCstr, "w+bR");
+            fopen(filePathCstr, "r+bR") : fopen(filePathCstr, "w+bR");
 #endif // _WIN32
+    }
 
         
     boost::uint8_t * const circularBufferBlockDataPtr = &m_circularBufferBlockDataPtr[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
     segment_id_t * const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE];
+#ifndef _WIN32
+    const int fileDescriptor = (directIoFileDescriptor >= 0) ? directIoFileDescriptor : ((fileHandle) ? fileno(fileHandle) : -1);
+    struct iovec ioVecs[CIRCULAR_INDEX_BUFFER_SIZE];
+#else
+    uint8_t * segmentPtrs[CIRCULAR_INDEX_BUFFER_SIZE];
+#endif
 
     while (m_noFatalErrorsOccurred.load(std::memory_order_acquire)) { //keep thread alive if running or cb not empty, i.e. "while (m_running || (m_circularIndexBuffer.GetIndexForRead() != CIRCULAR_INDEX_BUFFER_EMPTY))"
         unsigned int consumeIndex = cb.GetIndexForRead(); //store the volatile
@@ -119,13 +158,8 @@ void BundleStorageManagerMT::ThreadFunc(const unsigned int threadIndex) {
             }
         }
 
-        boost::uint8_t * const data = &circularBufferBlockDataPtr[consumeIndex * SEGMENT_SIZE]; //expected data for testing when reading
         const segment_id_t segmentId = circularBufferSegmentIdsPtr[consumeIndex];
-        uint8_t * const readFromStorageDestPointer = m_circularBufferReadFromStoragePointers[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire);
-        const bool isWriteToDisk = (readFromStorageDestPointer == NULL);
-        std::atomic<bool> junk;
-        std::atomic<bool>& isReadCompletedRef = (isWriteToDisk) ?
-            junk : *m_circularBufferIsReadCompletedPointers[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire);
+        const bool isWriteToDisk = (m_circularBufferReadFromStoragePointers[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex].load(std::memory_order_acquire) == NULL);
         if (segmentId == SEGMENT_ID_LAST) {
             LOG_ERROR(subprocess) << "error segmentId is last";
             m_noFatalErrorsOccurred = false; //a fatal error occurred
@@ -133,44 +167,89 @@ void BundleStorageManagerMT::ThreadFunc(const unsigned int threadIndex) {
             break;
         }
 
-        const boost::uint64_t offsetBytes = static_cast<boost::uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
-#ifdef _MSC_VER 
-        //If successful, returns 0. Otherwise, it returns a nonzero value.
-        const bool seekSuccess = _fseeki64_nolock(fileHandle, offsetBytes, SEEK_SET) == 0;
-#elif (BOOST_OS_MACOS || BOOST_OS_BSD)
-        const bool seekSuccess = fseeko(fileHandle, offsetBytes, SEEK_SET) == 0;
-#else //Linux or other OS
-        //Upon successful completion, the fseek, fseeko and fseeko64 subroutine return a value of 0. Otherwise, it returns a value of -1
-        const bool seekSuccess = fseeko64(fileHandle, offsetBytes, SEEK_SET) == 0;
+        //merge the queued operations of adjacent segments on this disk into one I/O
+        const unsigned int numSegments = GetNumCoalescableDiskOperations(threadIndex, consumeIndex);
+        for (unsigned int i = 0; i < numSegments; ++i) {
+            const unsigned int index = (consumeIndex + i) % CIRCULAR_INDEX_BUFFER_SIZE;
+            uint8_t * const segmentPtr = (isWriteToDisk) ?
+                &circularBufferBlockDataPtr[index * SEGMENT_SIZE] :
+                m_circularBufferReadFromStoragePointers[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE + index].load(std::memory_order_acquire);
+#ifndef _WIN32
+            ioVecs[i].iov_base = segmentPtr;
+            ioVecs[i].iov_len = SEGMENT_SIZE;
+#else
+            segmentPtrs[i] = segmentPtr;
 #endif
-        
-        if (seekSuccess) {
-            if (isWriteToDisk) {
-                if (fwrite(data, 1, SEGMENT_SIZE, fileHandle) != SEGMENT_SIZE) {
-                    LOG_ERROR(subprocess) << "BundleStorageManagerMT: error writing";
-                }
+        }
+
+        const boost::uint64_t offsetBytes = static_cast<boost::uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
+        const std::size_t totalBytes = static_cast<std::size_t>(numSegments) * SEGMENT_SIZE;
+        const boost::posix_time::ptime ioStartPtime = boost::posix_time::microsec_clock::universal_time();
+#ifndef _WIN32
+        //positional vectored I/O straight from/to the segment buffers (the stdio FILE is never read from or written to, so its buffer is unused)
+        if (isWriteToDisk) {
+            if (pwritev(fileDescriptor, ioVecs, static_cast<int>(numSegments), static_cast<off_t>(offsetBytes)) != static_cast<ssize_t>(totalBytes)) {
+                LOG_ERROR(subprocess) << "BundleStorageManagerMT: error writing";
             }
-            else { //read from disk
-                if (fread((void*)readFromStorageDestPointer, 1, SEGMENT_SIZE, fileHandle) != SEGMENT_SIZE) {
-                    LOG_ERROR(subprocess) << "BundleStorageManagerMT: error reading";
-                }
+        }
+        else { //read from disk
+            if (preadv(fileDescriptor, ioVecs, static_cast<int>(numSegments), static_cast<off_t>(offsetBytes)) != static_cast<ssize_t>(totalBytes)) {
+                LOG_ERROR(subprocess) << "BundleStorageManagerMT: error reading";
             }
         }
-        else {
-            LOG_ERROR(subprocess) << "BundleStorageManagerMT: error seeking";
+#else
+        {
+# ifdef _MSC_VER 
+            //If successful, returns 0. Otherwise, it returns a nonzero value.
+            const bool seekSuccess = _fseeki64_nolock(fileHandle, offsetBytes, SEEK_SET) == 0;
+# else
+            const bool seekSuccess = fseeko64(fileHandle, offsetBytes, SEEK_SET) == 0;
+# endif
+            //one seek for all the adjacent segments
+            if (seekSuccess) {
+                for (unsigned int i = 0; i < numSegments; ++i) {
+                    if (isWriteToDisk) {
+                        if (fwrite(segmentPtrs[i], 1, SEGMENT_SIZE, fileHandle) != SEGMENT_SIZE) {
+                            LOG_ERROR(subprocess) << "BundleStorageManagerMT: error writing";
+                        }
+                    }
+                    else { //read from disk
+                        if (fread(segmentPtrs[i], 1, SEGMENT_SIZE, fileHandle) != SEGMENT_SIZE) {
+                            LOG_ERROR(subprocess) << "BundleStorageManagerMT: error reading";
+                        }
+                    }
+                }
+            }
+            else {
+                LOG_ERROR(subprocess) << "BundleStorageManagerMT: error seeking";
+            }
         }
+#endif
+        RecordDiskOperationCompleted(threadIndex, totalBytes,
+            static_cast<uint64_t>((boost::posix_time::microsec_clock::universal_time() - ioStartPtime).total_microseconds()));
 
         m_mutexMainThread.lock();
-        isReadCompletedRef.store(true, std::memory_order_release);
-        cb.CommitRead();
+        for (unsigned int i = 0; i < numSegments; ++i) {
+            if (!isWriteToDisk) {
+                const unsigned int index = (consumeIndex + i) % CIRCULAR_INDEX_BUFFER_SIZE;
+                m_circularBufferIsReadCompletedPointers[threadIndex * CIRCULAR_INDEX_BUFFER_SIZE + index].load(std::memory_order_acquire)->store(true, std::memory_order_release);
+            }
+            cb.CommitRead();
+        }
         m_mutexMainThread.unlock();
-        m_conditionVariableMainThread.notify_one();
+        m_conditionVariableMainThread.notify_all(); //release workers may be waiting on reads too
     }
 
     if (fileHandle) {
         fclose(fileHandle);
         fileHandle = NULL;
     }
+#ifndef _WIN32
+    if (directIoFileDescriptor >= 0) {
+        close(directIoFileDescriptor);
+        m_directIoFileDescriptorsVec[threadIndex] = -1;
+    }
+#endif
 }
 
 //virtual function to be called immediately after a disk's circular buffer CommitWrite();
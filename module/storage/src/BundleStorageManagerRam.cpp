@@ -0,0 +1,165 @@
+/**
+ * @file BundleStorageManagerRam.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "BundleStorageManagerRam.h"
+#include <cstring>
+#include <boost/filesystem/path.hpp>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::storage;
+
+//regions are rounded up to this size so that they can be backed by (2MiB) huge pages
+static constexpr std::size_t HUGE_PAGE_SIZE_BYTES = 2 * 1024 * 1024;
+
+BundleStorageManagerRam::BundleStorageManagerRam() : BundleStorageManagerRam("storageConfig.json") {}
+
+BundleStorageManagerRam::BundleStorageManagerRam(const boost::filesystem::path& jsonConfigFilePath) :
+    BundleStorageManagerRam(StorageConfig::CreateFromJsonFilePath(jsonConfigFilePath))
+{
+    if (!m_storageConfigPtr) {
+        LOG_ERROR(subprocess) << "cannot open storage json config file: " << jsonConfigFilePath;
+        return;
+    }
+}
+
+BundleStorageManagerRam::BundleStorageManagerRam(const StorageConfig_ptr & storageConfigPtr) :
+    BundleStorageManagerBase(storageConfigPtr),
+    m_regionSizeBytes(0),
+    m_regionsVec(M_NUM_STORAGE_DISKS, NULL),
+    m_started(false)
+{
+    //no files are ever created, so never delete whatever may already exist at the configured storeFilePaths
+    m_autoDeleteFilesOnExit = false;
+    if (M_NUM_STORAGE_DISKS) {
+        const uint64_t maxSegmentsPerDisk = (M_MAX_SEGMENTS + M_NUM_STORAGE_DISKS - 1) / M_NUM_STORAGE_DISKS;
+        const uint64_t regionSizeBytes = maxSegmentsPerDisk * SEGMENT_SIZE;
+        m_regionSizeBytes = static_cast<std::size_t>(((regionSizeBytes + HUGE_PAGE_SIZE_BYTES - 1) / HUGE_PAGE_SIZE_BYTES) * HUGE_PAGE_SIZE_BYTES);
+    }
+}
+
+BundleStorageManagerRam::~BundleStorageManagerRam() {
+    FreeRegions();
+}
+
+bool BundleStorageManagerRam::AllocateRegions() {
+    const bool useHugePages = m_storageConfigPtr->m_ramStorageUseHugePages;
+    for (unsigned int diskId = 0; diskId < M_NUM_STORAGE_DISKS; ++diskId) {
+#ifdef _WIN32
+        if (useHugePages && (diskId == 0)) {
+            LOG_WARNING(subprocess) << "BundleStorageManagerRam: huge pages are not supported on Windows, using normal pages";
+        }
+        void* regionPtr = VirtualAlloc(NULL, m_regionSizeBytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (regionPtr == NULL) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerRam: unable to allocate " << m_regionSizeBytes << " bytes for disk " << diskId;
+            return false;
+        }
+#else
+        void* regionPtr = MAP_FAILED;
+# ifdef MAP_HUGETLB
+        if (useHugePages) {
+            regionPtr = mmap(NULL, m_regionSizeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (regionPtr == MAP_FAILED) {
+                LOG_WARNING(subprocess) << "BundleStorageManagerRam: unable to reserve huge pages for disk " << diskId
+                    << " (see /proc/sys/vm/nr_hugepages), falling back to normal pages";
+            }
+        }
+# endif
+        if (regionPtr == MAP_FAILED) {
+            regionPtr = mmap(NULL, m_regionSizeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (regionPtr == MAP_FAILED) {
+                LOG_ERROR(subprocess) << "BundleStorageManagerRam: unable to map " << m_regionSizeBytes << " bytes for disk " << diskId;
+                return false;
+            }
+# ifdef MADV_HUGEPAGE
+            if (useHugePages) {
+                madvise(regionPtr, m_regionSizeBytes, MADV_HUGEPAGE); //transparent huge pages, best effort
+            }
+# endif
+        }
+#endif
+        m_regionsVec[diskId] = static_cast<uint8_t*>(regionPtr);
+    }
+    return true;
+}
+
+void BundleStorageManagerRam::FreeRegions() {
+    for (std::size_t diskId = 0; diskId < m_regionsVec.size(); ++diskId) {
+        if (m_regionsVec[diskId]) {
+#ifdef _WIN32
+            VirtualFree(m_regionsVec[diskId], 0, MEM_RELEASE);
+#else
+            munmap(m_regionsVec[diskId], m_regionSizeBytes);
+#endif
+            m_regionsVec[diskId] = NULL;
+        }
+    }
+}
+
+void BundleStorageManagerRam::Start() {
+    if ((!m_started) && (m_storageConfigPtr)) {
+        if (!AllocateRegions()) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerRam: unable to start";
+            FreeRegions();
+            return;
+        }
+        LOG_INFO(subprocess) << "BundleStorageManagerRam: allocated " << M_NUM_STORAGE_DISKS << " region(s) of " << m_regionSizeBytes << " bytes";
+        m_started = true;
+    }
+}
+
+uint8_t* BundleStorageManagerRam::GetSegmentMemoryPtr(const segment_id_t segmentId) noexcept {
+    if (segmentId == SEGMENT_ID_LAST) {
+        return NULL;
+    }
+    uint8_t* const regionPtr = m_regionsVec[segmentId % M_NUM_STORAGE_DISKS];
+    const uint64_t offsetBytes = static_cast<uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
+    if ((regionPtr == NULL) || ((offsetBytes + SEGMENT_SIZE) > m_regionSizeBytes)) {
+        return NULL; //not started, or invalid (logged when queued instead)
+    }
+    return &regionPtr[offsetBytes];
+}
+
+//virtual function to be called immediately after a disk's circular buffer CommitWrite();
+//the "disk operation" is a memcpy, so it is completed right here in the caller's thread,
+//leaving the circular buffer empty by the time this function returns
+void BundleStorageManagerRam::CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int diskId) {
+    CircularIndexBufferSingleProducerSingleConsumerConfigurable& cb = m_circularIndexBuffersVec[diskId];
+    cb.CommitWrite();
+
+    uint8_t* const regionPtr = m_regionsVec[diskId];
+    uint8_t* const circularBufferBlockDataPtr = &m_circularBufferBlockDataPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE * SEGMENT_SIZE];
+    const segment_id_t* const circularBufferSegmentIdsPtr = &m_circularBufferSegmentIdsPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE];
+    for (unsigned int consumeIndex = cb.GetIndexForRead(); consumeIndex != CIRCULAR_INDEX_BUFFER_EMPTY; consumeIndex = cb.GetIndexForRead()) {
+        const segment_id_t segmentId = circularBufferSegmentIdsPtr[consumeIndex];
+        const unsigned int cbGlobalIndex = diskId * CIRCULAR_INDEX_BUFFER_SIZE + consumeIndex;
+        uint8_t* const readToPtr = m_circularBufferReadFromStoragePointers[cbGlobalIndex].load(std::memory_order_acquire);
+        const uint64_t offsetBytes = static_cast<uint64_t>(segmentId / M_NUM_STORAGE_DISKS) * SEGMENT_SIZE;
+        if ((regionPtr == NULL) || (segmentId == SEGMENT_ID_LAST) || ((offsetBytes + SEGMENT_SIZE) > m_regionSizeBytes)) {
+            LOG_ERROR(subprocess) << "BundleStorageManagerRam: invalid segment operation for segmentId " << segmentId << " on disk " << diskId;
+        }
+        else if (readToPtr == NULL) { //write
+            memcpy(&regionPtr[offsetBytes], &circularBufferBlockDataPtr[consumeIndex * SEGMENT_SIZE], SEGMENT_SIZE);
+        }
+        else { //read
+            memcpy(readToPtr, &regionPtr[offsetBytes], SEGMENT_SIZE);
+        }
+        if (readToPtr) {
+            m_circularBufferIsReadCompletedPointers[cbGlobalIndex].load(std::memory_order_acquire)->store(true, std::memory_order_release);
+        }
+        cb.CommitRead();
+    }
+}
@@ -15,6 +15,9 @@
 #include "CatalogEntry.h"
 #include <string>
 
+//every catalog entry lives in a hash map node, so keep it at 80 bytes with no heap allocation for an unfragmented bundle
+static_assert((sizeof(void*) != 8) || (sizeof(catalog_entry_t) == 80), "catalog_entry_t grew");
+
 catalog_entry_t::catalog_entry_t() :
     bundleSizeBytes(0),
     payloadSizeBytes(0),
@@ -25,7 +28,7 @@ catalog_entry_t::~catalog_entry_t() { } //a destructor: ~X()
 catalog_entry_t::catalog_entry_t(const catalog_entry_t& o) :
     bundleSizeBytes(o.bundleSizeBytes),
     payloadSizeBytes(o.payloadSizeBytes),
-    segmentIdChainVec(o.segmentIdChainVec),
+    segmentIdExtentsVec(o.segmentIdExtentsVec),
     destEid(o.destEid),
     encodedAbsExpirationAndCustodyAndPriority(o.encodedAbsExpirationAndCustodyAndPriority),
     sequence(o.sequence),
@@ -33,7 +36,7 @@ catalog_entry_t::catalog_entry_t(const catalog_entry_t& o) :
 catalog_entry_t::catalog_entry_t(catalog_entry_t&& o) :
     bundleSizeBytes(o.bundleSizeBytes),
     payloadSizeBytes(o.payloadSizeBytes),
-    segmentIdChainVec(std::move(o.segmentIdChainVec)),
+    segmentIdExtentsVec(std::move(o.segmentIdExtentsVec)),
     destEid(o.destEid),
     encodedAbsExpirationAndCustodyAndPriority(o.encodedAbsExpirationAndCustodyAndPriority),
     sequence(o.sequence),
@@ -41,7 +44,7 @@ catalog_entry_t::catalog_entry_t(catalog_entry_t&& o) :
 catalog_entry_t& catalog_entry_t::operator=(const catalog_entry_t& o) { //a copy assignment: operator=(const X&)
     bundleSizeBytes = o.bundleSizeBytes;
     payloadSizeBytes = o.payloadSizeBytes;
-    segmentIdChainVec = o.segmentIdChainVec;
+    segmentIdExtentsVec = o.segmentIdExtentsVec;
     destEid = o.destEid;
     encodedAbsExpirationAndCustodyAndPriority = o.encodedAbsExpirationAndCustodyAndPriority;
     sequence = o.sequence;
@@ -51,7 +54,7 @@ catalog_entry_t& catalog_entry_t::operator=(const catalog_entry_t& o) { //a copy
 catalog_entry_t& catalog_entry_t::operator=(catalog_entry_t && o) { //a move assignment: operator=(X&&)
     bundleSizeBytes = o.bundleSizeBytes;
     payloadSizeBytes = o.payloadSizeBytes;
-    segmentIdChainVec = std::move(o.segmentIdChainVec);
+    segmentIdExtentsVec = std::move(o.segmentIdExtentsVec);
     destEid = o.destEid;
     encodedAbsExpirationAndCustodyAndPriority = o.encodedAbsExpirationAndCustodyAndPriority;
     sequence = o.sequence;
@@ -62,7 +65,7 @@ bool catalog_entry_t::operator==(const catalog_entry_t & o) const {
     return
         (bundleSizeBytes == o.bundleSizeBytes) &&
         (payloadSizeBytes == o.payloadSizeBytes) &&
-        (segmentIdChainVec == o.segmentIdChainVec) &&
+        (segmentIdExtentsVec == o.segmentIdExtentsVec) &&
         (destEid == o.destEid) &&
         (encodedAbsExpirationAndCustodyAndPriority == o.encodedAbsExpirationAndCustodyAndPriority) &&
         (sequence == o.sequence) &&
@@ -72,14 +75,14 @@ bool catalog_entry_t::operator!=(const catalog_entry_t & o) const {
     return
         (bundleSizeBytes != o.bundleSizeBytes) ||
         (payloadSizeBytes != o.payloadSizeBytes) ||
-        (segmentIdChainVec != o.segmentIdChainVec) ||
+        (segmentIdExtentsVec != o.segmentIdExtentsVec) ||
         (destEid != o.destEid) ||
         (encodedAbsExpirationAndCustodyAndPriority != o.encodedAbsExpirationAndCustodyAndPriority) ||
         (sequence != o.sequence) ||
         (ptrUuidKeyInMap != o.ptrUuidKeyInMap);
 }
 bool catalog_entry_t::operator<(const catalog_entry_t & o) const {
-    return (segmentIdChainVec[0] < o.segmentIdChainVec[0]);
+    return (segmentIdExtentsVec[0].beginSegmentId < o.segmentIdExtentsVec[0].beginSegmentId);
 }
 uint8_t catalog_entry_t::GetPriorityIndex() const {
     return static_cast<uint8_t>(encodedAbsExpirationAndCustodyAndPriority & 3);
@@ -93,10 +96,26 @@ bool catalog_entry_t::HasCustodyAndFragmentation() const {
 bool catalog_entry_t::HasCustodyAndNonFragmentation() const {
     return ((encodedAbsExpirationAndCustodyAndPriority & (1U << 3)) != 0);
 }
+uint64_t catalog_entry_t::GetNumSegments() const {
+    if (IsInSmallBundleSlab()) {
+        return 1;
+    }
+    uint64_t numSegments = 0;
+    for (std::size_t i = 0; i < segmentIdExtentsVec.size(); ++i) {
+        numSegments += segmentIdExtentsVec[i].numSegments;
+    }
+    return numSegments;
+}
+bool catalog_entry_t::IsInSmallBundleSlab() const {
+    return (segmentIdExtentsVec.size() == 1) && ((segmentIdExtentsVec[0].numSegments & SMALL_BUNDLE_SLAB_EXTENT_FLAG) != 0);
+}
+unsigned int catalog_entry_t::GetSmallBundleSlabSlotIndex() const {
+    return static_cast<unsigned int>(segmentIdExtentsVec[0].numSegments & (~SMALL_BUNDLE_SLAB_EXTENT_FLAG));
+}
 bool catalog_entry_t::HasCustody() const {
     return ((encodedAbsExpirationAndCustodyAndPriority & ((1U << 2) | (1U << 3)) ) != 0);
 }
-void catalog_entry_t::Init(const PrimaryBlock & primary, const uint64_t paramBundleSizeBytes, const uint64_t paramPayloadSizeBytes, const uint64_t paramNumSegmentsRequired, void * paramPtrUuidKeyInMap, cbhe_eid_t *bundleEidMaskPtr) {
+void catalog_entry_t::Init(const PrimaryBlock & primary, const uint64_t paramBundleSizeBytes, const uint64_t paramPayloadSizeBytes, void * paramPtrUuidKeyInMap, cbhe_eid_t *bundleEidMaskPtr) {
     bundleSizeBytes = paramBundleSizeBytes;
     payloadSizeBytes = paramPayloadSizeBytes;
     if (bundleEidMaskPtr == NULL) { // Replaced ternary operator for coverage purposes
@@ -116,6 +135,6 @@ void catalog_entry_t::Init(const PrimaryBlock & primary, const uint64_t paramBun
     }
     ptrUuidKeyInMap = paramPtrUuidKeyInMap;
     sequence = primary.GetSequenceForSecondsScale();
-    segmentIdChainVec.resize(paramNumSegmentsRequired);
+    segmentIdExtentsVec.resize(0);
 }
 
@@ -14,111 +14,234 @@
 
 #include "CustodyTimers.h"
 #include <string>
+#include <algorithm>
 #include <boost/make_unique.hpp>
 
 
-CustodyTimers::CustodyTimers(const boost::posix_time::time_duration & timeout) : M_CUSTODY_TIMEOUT_DURATION(timeout) {}
+CustodyTimers::CustodyTimers(const boost::posix_time::time_duration & timeout) :
+    M_CUSTODY_TIMEOUT_DURATION(timeout),
+    M_EPOCH_PTIME(boost::posix_time::microsec_clock::universal_time()),
+    M_TICK_MICROSECONDS(std::max<uint64_t>(1000, static_cast<uint64_t>(std::max<int64_t>(0, timeout.total_microseconds())) / NUM_TICKS_PER_TIMEOUT)),
+    m_freeNodesHead(NULL_NODE_INDEX),
+    m_wheelSlots(NUM_WHEEL_SLOTS),
+    m_wheelCursorTick(0),
+    m_numTimers(0) {}
 
 
 
 CustodyTimers::~CustodyTimers() {}
 
+uint64_t CustodyTimers::GetMicrosecondsSinceEpoch(const boost::posix_time::ptime & ptime) const {
+    if (ptime.is_pos_infinity()) {
+        return UINT64_MAX;
+    }
+    if (ptime.is_special() || (ptime <= M_EPOCH_PTIME)) {
+        return 0;
+    }
+    return static_cast<uint64_t>((ptime - M_EPOCH_PTIME).total_microseconds());
+}
 
-bool CustodyTimers::PollOneAndPopExpiredCustodyTimer(uint64_t & custodyId, const std::vector<cbhe_eid_t> & availableDestEids, const boost::posix_time::ptime & nowPtime) {
-    boost::posix_time::ptime lowestExpiry = boost::posix_time::special_values::pos_infin;
-    desteid_to_custidexpirylist_map_t::iterator lowestExpiryIt;
-    for (std::size_t i = 0; i < availableDestEids.size(); ++i) {
-        const cbhe_eid_t & currentAvailableLink = availableDestEids[i];
-        desteid_to_custidexpirylist_map_t::iterator it = m_mapDestEidToCustodyIdExpiryList.find(currentAvailableLink);
-        if (it != m_mapDestEidToCustodyIdExpiryList.end()) {
-            custid_ptime_list_t & custIdPlusPtimeList = it->second;
-            if (!custIdPlusPtimeList.empty()) {
-                custid_ptime_pair_t & thisCustodyIdPlusPtimePair = custIdPlusPtimeList.front();
-                boost::posix_time::ptime & thisExpiry = thisCustodyIdPlusPtimePair.second;
-                if (lowestExpiry > thisExpiry) {
-                    lowestExpiry = thisExpiry;
-                    lowestExpiryIt = it;
+void CustodyTimers::UnlinkAndFreeNode(const uint32_t nodeIndex) {
+    timer_node_t & node = m_nodes[nodeIndex];
+    timer_list_t & slot = m_wheelSlots[node.slotIndex];
+    if (node.prevInSlot == NULL_NODE_INDEX) {
+        slot.head = node.nextInSlot;
+    }
+    else {
+        m_nodes[node.prevInSlot].nextInSlot = node.nextInSlot;
+    }
+    if (node.nextInSlot == NULL_NODE_INDEX) {
+        slot.tail = node.prevInSlot;
+    }
+    else {
+        m_nodes[node.nextInSlot].prevInSlot = node.prevInSlot;
+    }
+    destination_t & dest = m_destinations[node.destIndex];
+    if (node.prevInDest == NULL_NODE_INDEX) {
+        dest.timerList.head = node.nextInDest;
+    }
+    else {
+        m_nodes[node.prevInDest].nextInDest = node.nextInDest;
+    }
+    if (node.nextInDest == NULL_NODE_INDEX) {
+        dest.timerList.tail = node.prevInDest;
+    }
+    else {
+        m_nodes[node.nextInDest].prevInDest = node.prevInDest;
+    }
+    --dest.numTimers;
+    --m_numTimers;
+    node.nextInSlot = m_freeNodesHead;
+    m_freeNodesHead = nodeIndex;
+}
+
+std::size_t CustodyTimers::PopExpiredFromWheel(std::vector<uint64_t> & expiredCustodyIds, const uint64_t nowMicroseconds, const std::size_t maxToPop) {
+    const uint64_t nowTick = nowMicroseconds / M_TICK_MICROSECONDS;
+    std::size_t numPopped = 0;
+    uint32_t numSlotsChecked = 0;
+    uint32_t removedNodeIndex;
+    while (m_numTimers) {
+        timer_list_t & slot = m_wheelSlots[m_wheelCursorTick & (NUM_WHEEL_SLOTS - 1)];
+        for (uint32_t nodeIndex = slot.head; nodeIndex != NULL_NODE_INDEX; ) {
+            const timer_node_t & node = m_nodes[nodeIndex];
+            const uint32_t nextNodeIndex = node.nextInSlot;
+            if (node.expiryMicroseconds <= nowMicroseconds) { //a later rotation's timers share the slot, so check every one
+                expiredCustodyIds.push_back(node.custodyId);
+                m_mapCustodyIdToNodeIndex.GetValueAndRemove(node.custodyId, removedNodeIndex);
+                UnlinkAndFreeNode(nodeIndex);
+                if (++numPopped == maxToPop) {
+                    return numPopped; //resume at this slot next time
                 }
             }
+            nodeIndex = nextNodeIndex;
         }
-    }
-    if (lowestExpiry <= nowPtime) {
-        custid_ptime_list_t & custIdPlusPtimeList = lowestExpiryIt->second;
-        const custid_ptime_pair_t & thisCustodyIdPlusPtimePair = custIdPlusPtimeList.front();
-        custodyId = thisCustodyIdPlusPtimePair.first;
-        custIdPlusPtimeList.pop_front();
-        if (custIdPlusPtimeList.empty()) {
-            m_mapDestEidToCustodyIdExpiryList.erase(lowestExpiryIt);
+        if (m_wheelCursorTick >= nowTick) {
+            return numPopped; //the current tick's slot may still receive timers that expire later in the tick
+        }
+        ++m_wheelCursorTick;
+        if (++numSlotsChecked == NUM_WHEEL_SLOTS) {
+            //every slot has been emptied of expired timers, so no timer remains in a tick before nowTick
+            m_wheelCursorTick = nowTick;
         }
-        return (m_mapCustodyIdToListIterator.erase(custodyId) == 1);
     }
-    return false;
+    m_wheelCursorTick = std::max(m_wheelCursorTick, nowTick); //skip the idle ticks
+    return numPopped;
 }
 
-bool CustodyTimers::PollOneAndPopAnyExpiredCustodyTimer(uint64_t & custodyId, const boost::posix_time::ptime & nowPtime) {
-    for (desteid_to_custidexpirylist_map_t::iterator it = m_mapDestEidToCustodyIdExpiryList.begin(); it != m_mapDestEidToCustodyIdExpiryList.end(); ++it) {
-        custid_ptime_list_t & custIdPlusPtimeList = it->second;
-        if (!custIdPlusPtimeList.empty()) {
-            const custid_ptime_pair_t & thisCustodyIdPlusPtimePair = custIdPlusPtimeList.front();
-            const boost::posix_time::ptime & thisExpiry = thisCustodyIdPlusPtimePair.second;
-            if (thisExpiry <= nowPtime) {
-                custodyId = thisCustodyIdPlusPtimePair.first;
-                custIdPlusPtimeList.pop_front();
-                if (custIdPlusPtimeList.empty()) {
-                    m_mapDestEidToCustodyIdExpiryList.erase(it);
-                }
-                return (m_mapCustodyIdToListIterator.erase(custodyId) == 1);
+bool CustodyTimers::PollOneAndPopExpiredCustodyTimer(uint64_t & custodyId, const std::vector<cbhe_eid_t> & availableDestEids, const boost::posix_time::ptime & nowPtime) {
+    uint64_t lowestExpiry = UINT64_MAX;
+    uint32_t lowestExpiryNodeIndex = NULL_NODE_INDEX;
+    for (std::size_t i = 0; i < availableDestEids.size(); ++i) {
+        const uint32_t * destIndexPtr = m_mapDestEidToDestIndex.GetValuePtr(availableDestEids[i]);
+        if (destIndexPtr) {
+            const uint32_t headNodeIndex = m_destinations[*destIndexPtr].timerList.head;
+            if ((headNodeIndex != NULL_NODE_INDEX) && (lowestExpiry > m_nodes[headNodeIndex].expiryMicroseconds)) {
+                lowestExpiry = m_nodes[headNodeIndex].expiryMicroseconds;
+                lowestExpiryNodeIndex = headNodeIndex;
             }
         }
     }
+    if ((lowestExpiryNodeIndex != NULL_NODE_INDEX) && (lowestExpiry <= GetMicrosecondsSinceEpoch(nowPtime))) {
+        custodyId = m_nodes[lowestExpiryNodeIndex].custodyId;
+        uint32_t removedNodeIndex;
+        const bool removed = m_mapCustodyIdToNodeIndex.GetValueAndRemove(custodyId, removedNodeIndex);
+        UnlinkAndFreeNode(lowestExpiryNodeIndex);
+        return removed;
+    }
     return false;
 }
 
-bool CustodyTimers::StartCustodyTransferTimer(const cbhe_eid_t & finalDestEid, const uint64_t custodyId) {
-    //expiry will always be appended to list (always greater than previous) (duplicate expiries ok)
-    const boost::posix_time::ptime expiry = boost::posix_time::microsec_clock::universal_time() + M_CUSTODY_TIMEOUT_DURATION;
-
-    typename std::pair<custid_to_listiterator_map_t::iterator, bool> retVal =
-        m_mapCustodyIdToListIterator.insert(
-            custid_to_listiterator_map_insertion_element_t(custodyId, custid_ptime_list_t::iterator()));
-    if (retVal.second) {
-        //value was inserted
-        custid_ptime_list_t & listRef = m_mapDestEidToCustodyIdExpiryList[finalDestEid];
-        retVal.first->second = listRef.insert(listRef.end(), custid_ptime_pair_t(custodyId, expiry));
+bool CustodyTimers::PollOneAndPopAnyExpiredCustodyTimer(uint64_t & custodyId, const boost::posix_time::ptime & nowPtime) {
+    m_pollOneCustodyIds.clear();
+    if (PopExpiredFromWheel(m_pollOneCustodyIds, GetMicrosecondsSinceEpoch(nowPtime), 1)) {
+        custodyId = m_pollOneCustodyIds[0];
         return true;
     }
     return false;
 }
-bool CustodyTimers::CancelCustodyTransferTimer(const cbhe_eid_t & finalDestEid, const uint64_t custodyId) {
-    custid_to_listiterator_map_t::iterator itCidToListItMap = m_mapCustodyIdToListIterator.find(custodyId);
-    if (itCidToListItMap != m_mapCustodyIdToListIterator.end()) {
-        desteid_to_custidexpirylist_map_t::iterator itEidToCidExpiryListMap = m_mapDestEidToCustodyIdExpiryList.find(finalDestEid);
-        if (itEidToCidExpiryListMap != m_mapDestEidToCustodyIdExpiryList.end()) {
-            custid_ptime_list_t & listRef = itEidToCidExpiryListMap->second;
-            listRef.erase(itCidToListItMap->second);
-            if (listRef.empty()) {
-                m_mapDestEidToCustodyIdExpiryList.erase(itEidToCidExpiryListMap);
-            }
-            m_mapCustodyIdToListIterator.erase(itCidToListItMap);
-            return true;
+
+std::size_t CustodyTimers::PopAllExpiredCustodyTimers(std::vector<uint64_t> & expiredCustodyIds, const std::vector<cbhe_eid_t> & availableDestEids, const boost::posix_time::ptime & nowPtime) {
+    const uint64_t nowMicroseconds = GetMicrosecondsSinceEpoch(nowPtime);
+    std::size_t numPopped = 0;
+    uint32_t removedNodeIndex;
+    for (std::size_t i = 0; i < availableDestEids.size(); ++i) {
+        const uint32_t * destIndexPtr = m_mapDestEidToDestIndex.GetValuePtr(availableDestEids[i]);
+        if (destIndexPtr == NULL) {
+            continue;
+        }
+        const timer_list_t & timerList = m_destinations[*destIndexPtr].timerList;
+        while ((timerList.head != NULL_NODE_INDEX) && (m_nodes[timerList.head].expiryMicroseconds <= nowMicroseconds)) {
+            const uint32_t nodeIndex = timerList.head;
+            const uint64_t custodyId = m_nodes[nodeIndex].custodyId;
+            expiredCustodyIds.push_back(custodyId);
+            m_mapCustodyIdToNodeIndex.GetValueAndRemove(custodyId, removedNodeIndex);
+            UnlinkAndFreeNode(nodeIndex);
+            ++numPopped;
         }
+    }
+    return numPopped;
+}
+
+std::size_t CustodyTimers::PopAllAnyExpiredCustodyTimers(std::vector<uint64_t> & expiredCustodyIds, const boost::posix_time::ptime & nowPtime) {
+    return PopExpiredFromWheel(expiredCustodyIds, GetMicrosecondsSinceEpoch(nowPtime), SIZE_MAX);
+}
+
+bool CustodyTimers::StartCustodyTransferTimer(const cbhe_eid_t & finalDestEid, const uint64_t custodyId) {
+    //expiry will always be appended to the destination's list (always greater than previous) (duplicate expiries ok)
+    const uint64_t expiryMicroseconds = GetMicrosecondsSinceEpoch(boost::posix_time::microsec_clock::universal_time() + M_CUSTODY_TIMEOUT_DURATION);
+
+    const bool isNewNode = (m_freeNodesHead == NULL_NODE_INDEX);
+    const uint32_t nodeIndex = (isNewNode) ? static_cast<uint32_t>(m_nodes.size()) : m_freeNodesHead;
+    if (m_mapCustodyIdToNodeIndex.Insert(custodyId, nodeIndex) == NULL) {
+        return false; //already started
+    }
+    if (isNewNode) {
+        m_nodes.emplace_back();
+    }
+    else {
+        m_freeNodesHead = m_nodes[nodeIndex].nextInSlot;
+    }
+
+    uint32_t destIndex;
+    if (const uint32_t * destIndexPtr = m_mapDestEidToDestIndex.GetValuePtr(finalDestEid)) {
+        destIndex = *destIndexPtr;
+    }
+    else {
+        destIndex = static_cast<uint32_t>(m_destinations.size());
+        m_destinations.emplace_back(finalDestEid);
+        m_mapDestEidToDestIndex.Insert(finalDestEid, destIndex);
+    }
+    destination_t & dest = m_destinations[destIndex];
+
+    //a timer that would belong to an already passed tick is placed in the current tick so the next poll sees it
+    const uint64_t tick = std::max(expiryMicroseconds / M_TICK_MICROSECONDS, m_wheelCursorTick);
+    timer_node_t & node = m_nodes[nodeIndex];
+    node.custodyId = custodyId;
+    node.expiryMicroseconds = expiryMicroseconds;
+    node.destIndex = destIndex;
+    node.slotIndex = static_cast<uint32_t>(tick & (NUM_WHEEL_SLOTS - 1));
+    timer_list_t & slot = m_wheelSlots[node.slotIndex];
+    node.prevInSlot = slot.tail;
+    node.nextInSlot = NULL_NODE_INDEX;
+    if (slot.tail == NULL_NODE_INDEX) {
+        slot.head = nodeIndex;
+    }
+    else {
+        m_nodes[slot.tail].nextInSlot = nodeIndex;
+    }
+    slot.tail = nodeIndex;
+    node.prevInDest = dest.timerList.tail;
+    node.nextInDest = NULL_NODE_INDEX;
+    if (dest.timerList.tail == NULL_NODE_INDEX) {
+        dest.timerList.head = nodeIndex;
+    }
+    else {
+        m_nodes[dest.timerList.tail].nextInDest = nodeIndex;
+    }
+    dest.timerList.tail = nodeIndex;
+    ++dest.numTimers;
+    ++m_numTimers;
+    return true;
+}
+bool CustodyTimers::CancelCustodyTransferTimer(const cbhe_eid_t & finalDestEid, const uint64_t custodyId) {
+    const uint32_t * nodeIndexPtr = m_mapCustodyIdToNodeIndex.GetValuePtr(custodyId);
+    if ((nodeIndexPtr == NULL) || (m_destinations[m_nodes[*nodeIndexPtr].destIndex].finalDestEid != finalDestEid)) {
         return false;
     }
-    return false;
+    const uint32_t nodeIndex = *nodeIndexPtr;
+    uint32_t removedNodeIndex;
+    m_mapCustodyIdToNodeIndex.GetValueAndRemove(custodyId, removedNodeIndex);
+    UnlinkAndFreeNode(nodeIndex);
+    return true;
 }
 
 std::size_t CustodyTimers::GetNumCustodyTransferTimers() {
-    std::size_t sum = 0;
-    for (desteid_to_custidexpirylist_map_t::iterator it = m_mapDestEidToCustodyIdExpiryList.begin(); it != m_mapDestEidToCustodyIdExpiryList.end(); ++it) {
-        sum += it->second.size();
-    }
-    return sum;
+    return m_numTimers;
 }
 
 std::size_t CustodyTimers::GetNumCustodyTransferTimers(const cbhe_eid_t & finalDestEid) {
-    desteid_to_custidexpirylist_map_t::iterator itEidToCidExpiryListMap = m_mapDestEidToCustodyIdExpiryList.find(finalDestEid);
-    if (itEidToCidExpiryListMap != m_mapDestEidToCustodyIdExpiryList.end()) {
-        return itEidToCidExpiryListMap->second.size();
+    if (const uint32_t * destIndexPtr = m_mapDestEidToDestIndex.GetValuePtr(finalDestEid)) {
+        return m_destinations[*destIndexPtr].numTimers;
     }
     return 0;
 }
@@ -0,0 +1,243 @@
+/**
+ * @file DiskSpaceReclaimer.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "DiskSpaceReclaimer.h"
+#include "Logger.h"
+#include "ThreadNamer.h"
+#include <algorithm>
+#include <boost/make_unique.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#endif
+
+static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess::storage;
+
+DiskSpaceReclaimer::DiskSpaceReclaimer(const std::vector<boost::filesystem::path> & filePathsVec,
+    const uint64_t maxBytesPerSecond, MemoryManagerTreeArray & memoryManager) :
+    m_filePathsVec(filePathsVec),
+    M_NUM_DISKS(static_cast<unsigned int>(filePathsVec.size())),
+    m_memoryManager(memoryManager),
+    m_lastRateLimiterUpdate(boost::posix_time::microsec_clock::universal_time()),
+    m_fileDescriptorsVec(M_NUM_DISKS, -1),
+    m_isBlockDeviceVec(M_NUM_DISKS, false),
+    m_isReclaimUnsupportedVec(M_NUM_DISKS, false),
+    m_diskRunsVecs(M_NUM_DISKS),
+    m_numQueuedSegments(0),
+    m_totalSegmentsQueued(0),
+    m_totalSegmentsFreed(0),
+    m_freeQueuedExtentsNow(false),
+    m_running(true),
+    m_totalBytesReclaimed(0),
+    m_totalReclaimOperations(0),
+    m_totalBytesFreedWithoutReclaiming(0)
+{
+    //allow a burst of at most one second worth of bytes
+    m_rateLimiter.SetRate(static_cast<int64_t>(std::min<uint64_t>(maxBytesPerSecond, INT64_MAX)),
+        boost::posix_time::seconds(1), boost::posix_time::seconds(1));
+    m_threadPtr = boost::make_unique<boost::thread>(boost::bind(&DiskSpaceReclaimer::ThreadFunc, this));
+}
+
+DiskSpaceReclaimer::~DiskSpaceReclaimer() {
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        m_running = false;
+    }
+    m_conditionVariable.notify_one();
+    if (m_threadPtr) {
+        try {
+            m_threadPtr->join();
+        }
+        catch (const boost::thread_resource_error&) {
+            LOG_ERROR(subprocess) << "error stopping DiskSpaceReclaimer thread";
+        }
+        m_threadPtr.reset();
+    }
+#ifdef __linux__
+    for (std::size_t i = 0; i < m_fileDescriptorsVec.size(); ++i) {
+        if (m_fileDescriptorsVec[i] >= 0) {
+            close(m_fileDescriptorsVec[i]);
+        }
+    }
+#endif
+    LOG_INFO(subprocess) << "DiskSpaceReclaimer reclaimed " << m_totalBytesReclaimed.load(std::memory_order_relaxed)
+        << " bytes in " << m_totalReclaimOperations.load(std::memory_order_relaxed) << " operations ("
+        << m_totalBytesFreedWithoutReclaiming.load(std::memory_order_relaxed) << " bytes freed without reclaiming)";
+}
+
+void DiskSpaceReclaimer::QueueFreedSegmentExtents(const segment_id_extents_vec_t & extentsVec) {
+    bool notify = false;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+            m_queuedExtentsVec.push_back(extentsVec[i]);
+            m_numQueuedSegments += extentsVec[i].numSegments;
+            m_totalSegmentsQueued += extentsVec[i].numSegments;
+        }
+        notify = (m_numQueuedSegments >= DISK_SPACE_RECLAIM_BATCH_SEGMENTS);
+    }
+    if (notify) {
+        m_conditionVariable.notify_one();
+    }
+}
+
+void DiskSpaceReclaimer::WaitUntilQueuedExtentsFreed() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    const uint64_t totalSegmentsQueued = m_totalSegmentsQueued;
+    m_freeQueuedExtentsNow = true;
+    m_conditionVariable.notify_one();
+    while (m_totalSegmentsFreed < totalSegmentsQueued) {
+        m_conditionVariableBatchDone.wait(lock);
+    }
+}
+
+uint64_t DiskSpaceReclaimer::GetTotalBytesReclaimed() const noexcept {
+    return m_totalBytesReclaimed.load(std::memory_order_relaxed);
+}
+uint64_t DiskSpaceReclaimer::GetTotalReclaimOperations() const noexcept {
+    return m_totalReclaimOperations.load(std::memory_order_relaxed);
+}
+uint64_t DiskSpaceReclaimer::GetTotalBytesFreedWithoutReclaiming() const noexcept {
+    return m_totalBytesFreedWithoutReclaiming.load(std::memory_order_relaxed);
+}
+
+void DiskSpaceReclaimer::ThreadFunc() {
+    ThreadNamer::SetThisThreadName("StorageReclaimer");
+    segment_id_extents_vec_t batch;
+    boost::mutex::scoped_lock lock(m_mutex);
+    while (true) {
+        if (m_running && (m_numQueuedSegments < DISK_SPACE_RECLAIM_BATCH_SEGMENTS) && (!m_freeQueuedExtentsNow)) {
+            m_conditionVariable.timed_wait(lock, boost::posix_time::milliseconds(DISK_SPACE_RECLAIM_INTERVAL_MILLISECONDS));
+        }
+        m_freeQueuedExtentsNow = false;
+        if (m_queuedExtentsVec.empty()) {
+            if (!m_running) {
+                break;
+            }
+            continue;
+        }
+        std::swap(batch, m_queuedExtentsVec);
+        const uint64_t numSegmentsInBatch = m_numQueuedSegments;
+        m_numQueuedSegments = 0;
+        lock.unlock();
+        ReclaimAndFreeBatch(batch);
+        batch.clear();
+        lock.lock();
+        m_totalSegmentsFreed += numSegmentsInBatch;
+        m_conditionVariableBatchDone.notify_all();
+    }
+}
+
+void DiskSpaceReclaimer::ReclaimAndFreeBatch(const segment_id_extents_vec_t & batch) {
+    //an extent is a contiguous range of segments on every disk it touches
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        const uint64_t beginSegmentId = batch[i].beginSegmentId;
+        const uint64_t endSegmentId = beginSegmentId + batch[i].numSegments; //exclusive
+        for (unsigned int diskId = 0; diskId < M_NUM_DISKS; ++diskId) {
+            const uint64_t firstSegmentId = beginSegmentId + ((diskId + M_NUM_DISKS - (beginSegmentId % M_NUM_DISKS)) % M_NUM_DISKS);
+            if (firstSegmentId >= endSegmentId) {
+                continue;
+            }
+            const uint64_t lastSegmentId = (endSegmentId - 1) - ((((endSegmentId - 1) % M_NUM_DISKS) + M_NUM_DISKS - diskId) % M_NUM_DISKS);
+            m_diskRunsVecs[diskId].push_back(disk_run_t{ firstSegmentId / M_NUM_DISKS, (lastSegmentId / M_NUM_DISKS) + 1 });
+        }
+    }
+
+    const boost::posix_time::ptime nowPtime = boost::posix_time::microsec_clock::universal_time();
+    m_rateLimiter.AddTime(nowPtime - m_lastRateLimiterUpdate);
+    m_lastRateLimiterUpdate = nowPtime;
+
+    //merge adjacent runs of each disk so that each run is one hole punch
+    for (unsigned int diskId = 0; diskId < M_NUM_DISKS; ++diskId) {
+        std::vector<disk_run_t> & runsVec = m_diskRunsVecs[diskId];
+        if (runsVec.empty()) {
+            continue;
+        }
+        std::sort(runsVec.begin(), runsVec.end());
+        disk_run_t mergedRun = runsVec[0];
+        for (std::size_t i = 1; i <= runsVec.size(); ++i) {
+            if ((i < runsVec.size()) && (runsVec[i].beginLocalSegmentIndex <= mergedRun.endLocalSegmentIndex)) {
+                mergedRun.endLocalSegmentIndex = std::max(mergedRun.endLocalSegmentIndex, runsVec[i].endLocalSegmentIndex);
+                continue;
+            }
+            const uint64_t runBytes = (mergedRun.endLocalSegmentIndex - mergedRun.beginLocalSegmentIndex) * SEGMENT_SIZE;
+            if (m_rateLimiter.CanTakeTokens() && ReclaimRun(diskId, mergedRun)) {
+                m_rateLimiter.TakeTokens(runBytes);
+                m_totalBytesReclaimed.fetch_add(runBytes, std::memory_order_relaxed);
+                m_totalReclaimOperations.fetch_add(1, std::memory_order_relaxed);
+            }
+            else {
+                m_totalBytesFreedWithoutReclaiming.fetch_add(runBytes, std::memory_order_relaxed);
+            }
+            if (i < runsVec.size()) {
+                mergedRun = runsVec[i];
+            }
+        }
+        runsVec.clear();
+    }
+
+    if (!m_memoryManager.FreeSegmentExtents_ThreadSafe(batch)) {
+        LOG_ERROR(subprocess) << "DiskSpaceReclaimer: unable to free some of the reclaimed segments";
+    }
+}
+
+bool DiskSpaceReclaimer::ReclaimRun(const unsigned int diskId, const disk_run_t & run) {
+#ifdef __linux__
+    if (m_isReclaimUnsupportedVec[diskId]) {
+        return false;
+    }
+    int & fd = m_fileDescriptorsVec[diskId];
+    if (fd < 0) {
+        fd = open(m_filePathsVec[diskId].c_str(), O_RDWR | O_CLOEXEC); //never create, the disk's thread creates it
+        if (fd < 0) {
+            return false; //try again with the next batch
+        }
+        struct stat st;
+        m_isBlockDeviceVec[diskId] = ((fstat(fd, &st) == 0) && S_ISBLK(st.st_mode));
+    }
+    const uint64_t offset = run.beginLocalSegmentIndex * SEGMENT_SIZE;
+    const uint64_t length = (run.endLocalSegmentIndex - run.beginLocalSegmentIndex) * SEGMENT_SIZE;
+    int ret;
+    if (m_isBlockDeviceVec[diskId]) {
+        uint64_t range[2] = { offset, length };
+        ret = ioctl(fd, BLKDISCARD, &range);
+    }
+    else {
+        ret = fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset), static_cast<off_t>(length));
+    }
+    if (ret != 0) {
+        const int errnoValue = errno;
+        if ((errnoValue == EOPNOTSUPP) || (errnoValue == ENOTTY) || (errnoValue == ENOSYS)) {
+            LOG_WARNING(subprocess) << m_filePathsVec[diskId] << " does not support "
+                << ((m_isBlockDeviceVec[diskId]) ? "discard" : "hole punching") << ", its freed segments will not be reclaimed";
+            m_isReclaimUnsupportedVec[diskId] = true;
+        }
+        else {
+            LOG_ERROR(subprocess) << "unable to reclaim " << length << " bytes at offset " << offset << " of "
+                << m_filePathsVec[diskId] << ": " << strerror(errnoValue);
+        }
+        return false;
+    }
+    return true;
+#else
+    (void)diskId;
+    (void)run;
+    return false;
+#endif
+}
@@ -0,0 +1,270 @@
+/**
+ * @file HashMapRobinHood.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "HashMapRobinHood.h"
+#include <boost/config.hpp>
+#include "CatalogEntry.h"
+
+static constexpr std::size_t INITIAL_SLOT_CAPACITY = 1024; //power of 2
+static constexpr std::size_t MIGRATE_SLOTS_PER_OPERATION = 16; //must finish migrating before the doubled slots reach the max load factor
+static constexpr std::size_t NOT_FOUND = SIZE_MAX;
+static constexpr uint64_t SLOT_HASH_IN_USE_BIT = (static_cast<uint64_t>(1) << 63); //never part of a slot index
+
+//MurmurHash3 64-bit finalizer
+static BOOST_FORCEINLINE uint64_t Mix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+template <typename keyType, typename valueType>
+HashMapRobinHood<keyType, valueType>::HashMapRobinHood() :
+    m_slots(INITIAL_SLOT_CAPACITY),
+    m_oldSlotsMigrateIndex(0),
+    m_numInOldSlots(0),
+    m_size(0) {}
+
+template <typename keyType, typename valueType>
+HashMapRobinHood<keyType, valueType>::~HashMapRobinHood() {
+    DeleteAllNodes();
+}
+
+template <typename keyType, typename valueType>
+uint64_t HashMapRobinHood<keyType, valueType>::GetHash(const cbhe_bundle_uuid_t & bundleUuid) {
+    uint64_t h = Mix64(bundleUuid.creationSeconds);
+    h = Mix64(h ^ bundleUuid.sequence);
+    h = Mix64(h ^ bundleUuid.srcEid.nodeId);
+    h = Mix64(h ^ bundleUuid.srcEid.serviceId);
+    h = Mix64(h ^ bundleUuid.fragmentOffset);
+    return Mix64(h ^ bundleUuid.dataLength);
+}
+
+template <typename keyType, typename valueType>
+uint64_t HashMapRobinHood<keyType, valueType>::GetHash(const cbhe_bundle_uuid_nofragment_t & bundleUuid) {
+    uint64_t h = Mix64(bundleUuid.creationSeconds);
+    h = Mix64(h ^ bundleUuid.sequence);
+    h = Mix64(h ^ bundleUuid.srcEid.nodeId);
+    return Mix64(h ^ bundleUuid.srcEid.serviceId);
+}
+
+template <typename keyType, typename valueType>
+uint64_t HashMapRobinHood<keyType, valueType>::GetHash(const uint64_t key) {
+    return Mix64(key);
+}
+
+template <typename keyType, typename valueType>
+uint64_t HashMapRobinHood<keyType, valueType>::GetHash(const cbhe_eid_t & eid) {
+    return Mix64(Mix64(eid.nodeId) ^ eid.serviceId);
+}
+
+template <typename keyType, typename valueType>
+uint64_t HashMapRobinHood<keyType, valueType>::GetSlotHash(const keyType & key) {
+    return GetHash(key) | SLOT_HASH_IN_USE_BIT;
+}
+
+//return slot index if found, NOT_FOUND if key doesn't exist in the slots
+template <typename keyType, typename valueType>
+std::size_t HashMapRobinHood<keyType, valueType>::Find(const slots_t & slots, const uint64_t slotHash, const keyType & key) {
+    if (slots.empty()) {
+        return NOT_FOUND;
+    }
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t index = slotHash & mask, distance = 0; ; index = (index + 1) & mask, ++distance) {
+        const slot_t & slot = slots[index];
+        if (slot.hash == 0) {
+            return NOT_FOUND;
+        }
+        if (((index - slot.hash) & mask) < distance) { //the key would have displaced this richer slot when inserted
+            return NOT_FOUND;
+        }
+        if ((slot.hash == slotHash) && slot.nodePtr && (slot.nodePtr->first == key)) {
+            return index;
+        }
+    }
+}
+
+//Robin Hood insert of a key known not to be in the slots (slots must have at least one empty slot)
+template <typename keyType, typename valueType>
+void HashMapRobinHood<keyType, valueType>::InsertNode(slots_t & slots, uint64_t slotHash, key_value_pair_t * nodePtr) {
+    const std::size_t mask = slots.size() - 1;
+    for (std::size_t index = slotHash & mask, distance = 0; ; index = (index + 1) & mask, ++distance) {
+        slot_t & slot = slots[index];
+        if (slot.hash == 0) {
+            slot.hash = slotHash;
+            slot.nodePtr = nodePtr;
+            return;
+        }
+        const std::size_t slotDistance = (index - slot.hash) & mask;
+        if (slotDistance < distance) { //take from the rich, continue inserting the displaced slot
+            std::swap(slotHash, slot.hash);
+            std::swap(nodePtr, slot.nodePtr);
+            distance = slotDistance;
+        }
+    }
+}
+
+//backward shift deletion (no tombstones in m_slots)
+template <typename keyType, typename valueType>
+void HashMapRobinHood<keyType, valueType>::EraseAndShiftBack(slots_t & slots, std::size_t index) {
+    const std::size_t mask = slots.size() - 1;
+    while (true) {
+        const std::size_t nextIndex = (index + 1) & mask;
+        const slot_t & nextSlot = slots[nextIndex];
+        if ((nextSlot.hash == 0) || (((nextIndex - nextSlot.hash) & mask) == 0)) {
+            slots[index].hash = 0;
+            slots[index].nodePtr = NULL;
+            return;
+        }
+        slots[index] = nextSlot;
+        index = nextIndex;
+    }
+}
+
+template <typename keyType, typename valueType>
+void HashMapRobinHood<keyType, valueType>::Grow() {
+    MigrateOldSlots(SIZE_MAX); //finish any previous resize
+    m_oldSlots.swap(m_slots);
+    m_numInOldSlots = m_size;
+    m_oldSlotsMigrateIndex = 0;
+    m_slots = slots_t(m_oldSlots.size() * 2);
+}
+
+//migrated slots keep their hash with a NULL nodePtr so that lookups still probe past them
+template <typename keyType, typename valueType>
+void HashMapRobinHood<keyType, valueType>::MigrateOldSlots(const std::size_t maxSlotsToMigrate) {
+    if (m_oldSlots.empty()) {
+        return;
+    }
+    for (std::size_t i = 0; (i < maxSlotsToMigrate) && (m_numInOldSlots != 0); ++i, ++m_oldSlotsMigrateIndex) {
+        slot_t & slot = m_oldSlots[m_oldSlotsMigrateIndex];
+        if (slot.nodePtr) {
+            InsertNode(m_slots, slot.hash, slot.nodePtr);
+            slot.nodePtr = NULL;
+            --m_numInOldSlots;
+        }
+    }
+    if (m_numInOldSlots == 0) {
+        slots_t().swap(m_oldSlots); //free the memory
+        m_oldSlotsMigrateIndex = 0;
+    }
+}
+
+//return ptr of inserted pair if inserted, NULL if already exists
+template <typename keyType, typename valueType>
+const typename HashMapRobinHood<keyType, valueType>::key_value_pair_t * HashMapRobinHood<keyType, valueType>::Insert(const keyType & key, const valueType & value) {
+    return Insert(key, std::move(valueType(value)));
+}
+
+//return ptr of inserted pair if inserted, NULL if already exists
+template <typename keyType, typename valueType>
+const typename HashMapRobinHood<keyType, valueType>::key_value_pair_t * HashMapRobinHood<keyType, valueType>::Insert(const keyType & key, valueType && value) {
+    const uint64_t slotHash = GetSlotHash(key);
+    if ((Find(m_slots, slotHash, key) != NOT_FOUND) || (Find(m_oldSlots, slotHash, key) != NOT_FOUND)) {
+        return NULL;
+    }
+    if (((m_size + 1) * 4) > (m_slots.size() * 3)) { //max load factor 0.75
+        Grow();
+    }
+    key_value_pair_t * const nodePtr = new key_value_pair_t(key, std::move(value));
+    InsertNode(m_slots, slotHash, nodePtr);
+    ++m_size;
+    MigrateOldSlots(MIGRATE_SLOTS_PER_OPERATION);
+    return nodePtr;
+}
+
+//return true if exists, false if key doesn't exist in the map
+template <typename keyType, typename valueType>
+bool HashMapRobinHood<keyType, valueType>::GetValueAndRemove(const keyType & key, valueType & value) {
+    //note: key may reference the key of the node being removed, so it is not used after the node is deleted
+    const uint64_t slotHash = GetSlotHash(key);
+    key_value_pair_t * nodePtr;
+    std::size_t index = Find(m_slots, slotHash, key);
+    if (index != NOT_FOUND) {
+        nodePtr = m_slots[index].nodePtr;
+        EraseAndShiftBack(m_slots, index);
+    }
+    else {
+        index = Find(m_oldSlots, slotHash, key);
+        if (index == NOT_FOUND) {
+            return false;
+        }
+        nodePtr = m_oldSlots[index].nodePtr;
+        m_oldSlots[index].nodePtr = NULL; //keep the hash for probing like a migrated slot
+        --m_numInOldSlots;
+    }
+    value = std::move(nodePtr->second);
+    delete nodePtr;
+    --m_size;
+    MigrateOldSlots(MIGRATE_SLOTS_PER_OPERATION);
+    return true;
+}
+
+//return ptr if exists, NULL if key doesn't exist in the map
+template <typename keyType, typename valueType>
+valueType * HashMapRobinHood<keyType, valueType>::GetValuePtr(const keyType & key) {
+    const uint64_t slotHash = GetSlotHash(key);
+    std::size_t index = Find(m_slots, slotHash, key);
+    if (index != NOT_FOUND) {
+        return &(m_slots[index].nodePtr->second);
+    }
+    index = Find(m_oldSlots, slotHash, key);
+    if (index != NOT_FOUND) {
+        return &(m_oldSlots[index].nodePtr->second);
+    }
+    return NULL;
+}
+
+template <typename keyType, typename valueType>
+std::size_t HashMapRobinHood<keyType, valueType>::Size() const noexcept {
+    return m_size;
+}
+
+template <typename keyType, typename valueType>
+std::size_t HashMapRobinHood<keyType, valueType>::GetSlotCapacity() const noexcept {
+    return m_slots.size();
+}
+
+template <typename keyType, typename valueType>
+bool HashMapRobinHood<keyType, valueType>::IsResizing() const noexcept {
+    return !m_oldSlots.empty();
+}
+
+template <typename keyType, typename valueType>
+void HashMapRobinHood<keyType, valueType>::DeleteAllNodes() {
+    for (std::size_t i = 0; i < m_slots.size(); ++i) {
+        delete m_slots[i].nodePtr;
+    }
+    for (std::size_t i = 0; i < m_oldSlots.size(); ++i) {
+        delete m_oldSlots[i].nodePtr;
+    }
+}
+
+template <typename keyType, typename valueType>
+void HashMapRobinHood<keyType, valueType>::Clear() {
+    DeleteAllNodes();
+    m_slots = slots_t(INITIAL_SLOT_CAPACITY);
+    slots_t().swap(m_oldSlots);
+    m_oldSlotsMigrateIndex = 0;
+    m_numInOldSlots = 0;
+    m_size = 0;
+}
+
+// Explicit template instantiation
+template class HashMapRobinHood<cbhe_bundle_uuid_t, uint64_t>;
+template class HashMapRobinHood<cbhe_bundle_uuid_nofragment_t, uint64_t>;
+template class HashMapRobinHood<uint64_t, catalog_entry_t>;
+template class HashMapRobinHood<uint64_t, uint32_t>; //CustodyTimers
+template class HashMapRobinHood<cbhe_eid_t, uint32_t>; //CustodyTimers
@@ -0,0 +1,139 @@
+/**
+ * @file HierarchicalTimingWheel.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "HierarchicalTimingWheel.h"
+#include <boost/multiprecision/cpp_int.hpp>
+#include <boost/multiprecision/detail/bitscan.hpp>
+
+HierarchicalTimingWheel::HierarchicalTimingWheel() :
+    m_currentTime(0),
+    m_size(0)
+{
+    m_occupiedSlotMasks.fill(0);
+}
+
+HierarchicalTimingWheel::~HierarchicalTimingWheel() {}
+
+//the earliest expiration a slot can hold given the current time
+//(the bits above the level are shared with the current time, the bits below are zero)
+uint64_t HierarchicalTimingWheel::GetSlotStartTime(const unsigned int level, const unsigned int slotIndex) const noexcept {
+    const unsigned int shift = level * BITS_PER_LEVEL;
+    const unsigned int highShift = shift + BITS_PER_LEVEL;
+    const uint64_t highBits = (highShift >= 64) ? 0 : ((m_currentTime >> highShift) << highShift);
+    return highBits | (static_cast<uint64_t>(slotIndex) << shift);
+}
+
+//requires entry.expiration >= m_currentTime
+void HierarchicalTimingWheel::Place(const wheel_entry_t & entry) {
+    const uint64_t diff = entry.expiration ^ m_currentTime;
+    const unsigned int level = (diff == 0) ? 0 : (boost::multiprecision::detail::find_msb<uint64_t>(diff) / BITS_PER_LEVEL);
+    const unsigned int slotIndex = static_cast<unsigned int>(entry.expiration >> (level * BITS_PER_LEVEL)) & (SLOTS_PER_LEVEL - 1);
+    m_levels[level][slotIndex].push_back(entry);
+    m_occupiedSlotMasks[level] |= (static_cast<uint64_t>(1) << slotIndex);
+}
+
+void HierarchicalTimingWheel::Insert(const uint64_t expiration, const uint64_t value) {
+    ++m_size;
+    if (expiration < m_currentTime) {
+        m_alreadyExpiredValues.push_back(value);
+    }
+    else {
+        Place(wheel_entry_t{ expiration, value });
+    }
+}
+
+void HierarchicalTimingWheel::PopExpired(const uint64_t expiry, std::vector<uint64_t> & expiredValues) {
+    expiredValues.insert(expiredValues.end(), m_alreadyExpiredValues.cbegin(), m_alreadyExpiredValues.cend());
+    m_size -= m_alreadyExpiredValues.size();
+    m_alreadyExpiredValues.clear();
+    const uint64_t newCurrentTime = (expiry == UINT64_MAX) ? UINT64_MAX : (expiry + 1);
+
+    slot_t slotEntries;
+    while (true) {
+        //find the non-empty slot with the earliest start time, preferring the higher level on a tie
+        //so that a slot which the current time has entered is moved down before a level 0 slot fires
+        unsigned int bestLevel = NUM_LEVELS;
+        unsigned int bestSlotIndex = 0;
+        uint64_t bestStartTime = UINT64_MAX;
+        for (unsigned int level = NUM_LEVELS; level > 0; ) {
+            --level;
+            const uint64_t mask = m_occupiedSlotMasks[level];
+            if (mask) {
+                const unsigned int slotIndex = boost::multiprecision::detail::find_lsb<uint64_t>(mask);
+                const uint64_t startTime = GetSlotStartTime(level, slotIndex);
+                if ((bestLevel == NUM_LEVELS) || (startTime < bestStartTime)) {
+                    bestLevel = level;
+                    bestSlotIndex = slotIndex;
+                    bestStartTime = startTime;
+                }
+            }
+        }
+        if (bestLevel == NUM_LEVELS) { //empty wheel
+            if (m_currentTime < newCurrentTime) {
+                m_currentTime = newCurrentTime;
+            }
+            break;
+        }
+        if (bestStartTime > expiry) {
+            if (m_currentTime < newCurrentTime) {
+                m_currentTime = newCurrentTime;
+            }
+            //nothing else expired, but a higher level slot which the new current time just entered must be moved down
+            if ((bestLevel == 0) || (bestStartTime > m_currentTime)) {
+                break;
+            }
+        }
+        else if (m_currentTime < bestStartTime) {
+            m_currentTime = bestStartTime; //skip the empty seconds
+        }
+
+        slotEntries.swap(m_levels[bestLevel][bestSlotIndex]);
+        m_occupiedSlotMasks[bestLevel] &= ~(static_cast<uint64_t>(1) << bestSlotIndex);
+        if (bestLevel == 0) { //every entry has expiration == bestStartTime <= expiry
+            for (std::size_t i = 0; i < slotEntries.size(); ++i) {
+                expiredValues.push_back(slotEntries[i].value);
+            }
+            m_size -= slotEntries.size();
+            m_currentTime = bestStartTime + 1;
+        }
+        else {
+            for (std::size_t i = 0; i < slotEntries.size(); ++i) {
+                const wheel_entry_t & entry = slotEntries[i];
+                if (entry.expiration < m_currentTime) {
+                    expiredValues.push_back(entry.value);
+                    --m_size;
+                }
+                else {
+                    Place(entry);
+                }
+            }
+        }
+        slotEntries.clear(); //keep the capacity for the next swap
+    }
+}
+
+std::size_t HierarchicalTimingWheel::Size() const noexcept {
+    return m_size;
+}
+
+void HierarchicalTimingWheel::Clear() {
+    for (unsigned int level = 0; level < NUM_LEVELS; ++level) {
+        for (unsigned int slotIndex = 0; slotIndex < SLOTS_PER_LEVEL; ++slotIndex) {
+            m_levels[level][slotIndex].clear();
+        }
+    }
+    m_occupiedSlotMasks.fill(0);
+    m_alreadyExpiredValues.clear();
+    m_size = 0;
+    //keep m_currentTime so that an expiration already passed is still returned by the next PopExpired
+}
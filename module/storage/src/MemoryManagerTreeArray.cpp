@@ -16,6 +16,8 @@
 #include <boost/multiprecision/detail/bitscan.hpp>
 #include <string>
 #include <inttypes.h>
+#include <algorithm>
+#include <bitset>
 #ifdef USE_BITTEST
 # include <immintrin.h>
 # ifdef HAVE_INTRIN_H
@@ -259,6 +261,364 @@ bool MemoryManagerTreeArray::FreeSegments_ThreadSafe(const segment_id_chain_vec_
     return success;
 }
 
+/** Private function to propagate a leaf uint64_t becoming full (all zeros) up the tree.
+*
+* @param leafLongIndex The index of the leaf uint64_t that just became full.
+* @post Each parent bit is cleared while its child uint64_t is full.
+*/
+void MemoryManagerTreeArray::ClearParentBitsOfFullLeaf(segment_id_t leafLongIndex) {
+    bool childIsFull = true;
+    for (segment_id_t depth = MAX_TREE_ARRAY_DEPTH - 1; ((depth != 0) && (childIsFull)); --depth) {
+        const segment_id_t bitIndex = leafLongIndex & 63;
+        leafLongIndex >>= 6; //divide by 64 bits per ui64
+        uint64_t & longRef = m_bitMasks[depth - 1][leafLongIndex];
+        const uint64_t mask64 = (((uint64_t)1) << bitIndex);
+        longRef &= (~mask64);
+        childIsFull = (longRef == 0);
+    }
+}
+
+/** Private function to propagate a full leaf uint64_t becoming not full up the tree.
+*
+* @param leafLongIndex The index of the leaf uint64_t that was full and now has at least one free segment.
+* @post Each parent bit is set while its uint64_t was full prior to the set (ancestors of a non-full uint64_t are already set).
+*/
+void MemoryManagerTreeArray::SetParentBitsOfNonFullLeaf(segment_id_t leafLongIndex) {
+    bool parentWasFull = true;
+    for (segment_id_t depth = MAX_TREE_ARRAY_DEPTH - 1; ((depth != 0) && (parentWasFull)); --depth) {
+        const segment_id_t bitIndex = leafLongIndex & 63;
+        leafLongIndex >>= 6; //divide by 64 bits per ui64
+        uint64_t & longRef = m_bitMasks[depth - 1][leafLongIndex];
+        parentWasFull = (longRef == 0);
+        const uint64_t mask64 = (((uint64_t)1) << bitIndex);
+        longRef |= mask64;
+    }
+}
+
+/** Private function to allocate the run of free segments beginning at segmentId, one leaf uint64_t at a time.
+*
+* @param segmentId The first segment Id of the run.
+* @param maxSegments The maximum number of segments to allocate.
+* @return The number of segments allocated, which stops at the first already allocated segment, at M_MAX_SEGMENTS, or at maxSegments.
+* @post The allocated segments are marked allocated in the internal data structures.
+*/
+uint64_t MemoryManagerTreeArray::AllocateFreeSegmentsStartingAt_NotThreadSafe(segment_id_t segmentId, const uint64_t maxSegments) {
+    if (segmentId >= M_MAX_SEGMENTS) return 0;
+    const uint64_t limit = std::min<uint64_t>(maxSegments, M_MAX_SEGMENTS - segmentId);
+    uint64_t numAllocated = 0;
+    while (numAllocated < limit) {
+        const segment_id_t longIndex = segmentId >> 6; //divide by 64 bits per ui64
+        const unsigned int bitIndex = static_cast<unsigned int>(segmentId & 63);
+        uint64_t & longRef = m_bitMasks[MAX_TREE_ARRAY_DEPTH - 1][longIndex];
+        //count the consecutive free (1) bits starting at bitIndex
+        const uint64_t allocatedBitsFromBitIndex = ~(longRef >> bitIndex);
+        uint64_t runLength = (allocatedBitsFromBitIndex == 0) ? 64 : boost::multiprecision::detail::find_lsb<uint64_t>(allocatedBitsFromBitIndex);
+        if (runLength == 0) {
+            break;
+        }
+        runLength = std::min<uint64_t>(runLength, limit - numAllocated);
+        const uint64_t mask64 = ((runLength == 64) ? UINT64_MAX : ((((uint64_t)1) << runLength) - 1)) << bitIndex;
+        longRef &= (~mask64);
+        if (longRef == 0) {
+            ClearParentBitsOfFullLeaf(longIndex);
+        }
+        numAllocated += runLength;
+        segmentId += static_cast<segment_id_t>(runLength);
+        if ((segmentId & 63) != 0) { //the run (or the limit) ended within this uint64_t
+            break;
+        }
+    }
+    m_numSegmentsAllocated += numAllocated;
+    return numAllocated;
+}
+
+segment_id_extents_vec_t::segment_id_extents_vec_t(std::initializer_list<segment_id_extent_t> il) : segment_id_extents_vec_t() {
+    reserve(il.size());
+    std::copy(il.begin(), il.end(), data());
+    m_size = static_cast<uint32_t>(il.size());
+}
+
+segment_id_extents_vec_t::segment_id_extents_vec_t(const segment_id_extents_vec_t& o) : segment_id_extents_vec_t() {
+    reserve(o.m_size);
+    std::copy(o.cbegin(), o.cend(), data());
+    m_size = o.m_size;
+}
+
+segment_id_extents_vec_t::segment_id_extents_vec_t(segment_id_extents_vec_t&& o) noexcept :
+    m_size(o.m_size),
+    m_capacity(o.m_capacity)
+{
+    if (o.IsSpilled()) {
+        m_heapExtents = o.m_heapExtents; //steal
+    }
+    else {
+        std::copy(o.m_inlineExtents, o.m_inlineExtents + o.m_size, m_inlineExtents);
+    }
+    o.m_size = 0;
+    o.m_capacity = NUM_INLINE_EXTENTS;
+}
+
+segment_id_extents_vec_t& segment_id_extents_vec_t::operator=(const segment_id_extents_vec_t& o) {
+    if (this != &o) {
+        m_size = 0;
+        reserve(o.m_size);
+        std::copy(o.cbegin(), o.cend(), data());
+        m_size = o.m_size;
+    }
+    return *this;
+}
+
+segment_id_extents_vec_t& segment_id_extents_vec_t::operator=(segment_id_extents_vec_t&& o) noexcept {
+    if (this != &o) {
+        if (IsSpilled()) {
+            delete[] m_heapExtents;
+        }
+        m_size = o.m_size;
+        m_capacity = o.m_capacity;
+        if (o.IsSpilled()) {
+            m_heapExtents = o.m_heapExtents; //steal
+        }
+        else {
+            std::copy(o.m_inlineExtents, o.m_inlineExtents + o.m_size, m_inlineExtents);
+        }
+        o.m_size = 0;
+        o.m_capacity = NUM_INLINE_EXTENTS;
+    }
+    return *this;
+}
+
+segment_id_extents_vec_t& segment_id_extents_vec_t::operator=(std::initializer_list<segment_id_extent_t> il) {
+    m_size = 0;
+    reserve(il.size());
+    std::copy(il.begin(), il.end(), data());
+    m_size = static_cast<uint32_t>(il.size());
+    return *this;
+}
+
+bool segment_id_extents_vec_t::operator==(const segment_id_extents_vec_t& o) const noexcept {
+    return (m_size == o.m_size) && std::equal(cbegin(), cend(), o.cbegin());
+}
+
+void segment_id_extents_vec_t::reserve(const std::size_t n) {
+    if (n <= m_capacity) {
+        return;
+    }
+    segment_id_extent_t* newHeapExtents = new segment_id_extent_t[n];
+    std::copy(cbegin(), cend(), newHeapExtents);
+    if (IsSpilled()) {
+        delete[] m_heapExtents;
+    }
+    m_heapExtents = newHeapExtents;
+    m_capacity = static_cast<uint32_t>(n);
+}
+
+void segment_id_extents_vec_t::resize(const std::size_t n) {
+    reserve(n);
+    segment_id_extent_t* const d = data();
+    for (std::size_t i = m_size; i < n; ++i) {
+        d[i] = segment_id_extent_t{ 0, 0 };
+    }
+    m_size = static_cast<uint32_t>(n);
+}
+
+void segment_id_extents_vec_t::ShrinkToFit() {
+    if ((!IsSpilled()) || (m_size == m_capacity)) {
+        return;
+    }
+    segment_id_extent_t* const oldHeapExtents = m_heapExtents;
+    if (m_size <= NUM_INLINE_EXTENTS) {
+        std::copy(oldHeapExtents, oldHeapExtents + m_size, m_inlineExtents);
+        m_capacity = NUM_INLINE_EXTENTS;
+    }
+    else {
+        m_heapExtents = new segment_id_extent_t[m_size];
+        std::copy(oldHeapExtents, oldHeapExtents + m_size, m_heapExtents);
+        m_capacity = m_size;
+    }
+    delete[] oldHeapExtents;
+}
+
+bool MemoryManagerTreeArray::AllocateSegmentExtents_ThreadSafe(const uint64_t numSegments, segment_id_extents_vec_t & extentsVec) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    extentsVec.resize(0);
+    if (numSegments > (M_MAX_SEGMENTS - m_numSegmentsAllocated)) {
+        return false;
+    }
+    if (!AppendFirstFreeSegmentExtents_NotThreadSafe(numSegments, extentsVec)) { //fail (should not happen given the free count check above)
+        for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+            FreeSegmentExtent_NotThreadSafe(extentsVec[i]);
+        }
+        extentsVec.resize(0);
+        return false;
+    }
+    extentsVec.ShrinkToFit(); //no slack from doubling if the extents spilled to the heap
+    return true;
+}
+
+bool MemoryManagerTreeArray::AllocateSegmentExtentsOnDisks_ThreadSafe(const uint64_t numSegments, const unsigned int numDisks,
+    const uint64_t allowedDisksMask, segment_id_extents_vec_t & extentsVec)
+{
+    if ((numDisks == 0) || (numDisks > 64)) {
+        extentsVec.resize(0);
+        return false;
+    }
+    const uint64_t allDisksMask = (numDisks == 64) ? UINT64_MAX : ((((uint64_t)1) << numDisks) - 1);
+    if (((allowedDisksMask & allDisksMask) == allDisksMask) || ((allowedDisksMask & allDisksMask) == 0)) {
+        return AllocateSegmentExtents_ThreadSafe(numSegments, extentsVec);
+    }
+    boost::mutex::scoped_lock lock(m_mutex);
+    extentsVec.resize(0);
+    if (numSegments > (M_MAX_SEGMENTS - m_numSegmentsAllocated)) {
+        return false;
+    }
+    const uint64_t numSegmentsOnAllowedDisks = AppendFreeSegmentsOnDisks_NotThreadSafe(numSegments, numDisks, allowedDisksMask, extentsVec);
+    if (!AppendFirstFreeSegmentExtents_NotThreadSafe(numSegments - numSegmentsOnAllowedDisks, extentsVec)) {
+        for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+            FreeSegmentExtent_NotThreadSafe(extentsVec[i]);
+        }
+        extentsVec.resize(0);
+        return false;
+    }
+    extentsVec.ShrinkToFit();
+    return true;
+}
+
+/** Private function to allocate the given number of the first available free segments, appending them to an extents vector.
+*
+* @param numSegments The number of segments to allocate.
+* @param extentsVec The extents vector to append to (its last extent is grown if the first new segment immediately follows it).
+* @return True if all numSegments were allocated, or False if the MemoryManagerTreeArray became full (the appended segments remain allocated).
+*/
+bool MemoryManagerTreeArray::AppendFirstFreeSegmentExtents_NotThreadSafe(uint64_t numSegments, segment_id_extents_vec_t & extentsVec) {
+    while (numSegments) {
+        //the first free segment is found by descending the tree, after which the run is extended along the leaf row.
+        //The next first free segment can never be adjacent to the previous run, so only the first run may need merging.
+        const segment_id_t beginSegmentId = GetAndSetFirstFreeSegmentId_NotThreadSafe();
+        if (beginSegmentId == SEGMENT_ID_FULL) {
+            return false;
+        }
+        --numSegments;
+        const uint64_t numFollowing = AllocateFreeSegmentsStartingAt_NotThreadSafe(beginSegmentId + 1, numSegments);
+        numSegments -= numFollowing;
+        if ((!extentsVec.empty()) && ((extentsVec.back().beginSegmentId + extentsVec.back().numSegments) == beginSegmentId)) {
+            extentsVec.back().numSegments += static_cast<segment_id_t>(numFollowing + 1);
+        }
+        else {
+            extentsVec.push_back(segment_id_extent_t{ beginSegmentId, static_cast<segment_id_t>(numFollowing + 1) });
+        }
+    }
+    return true;
+}
+
+/** Private function to allocate up to the given number of free segments lying on the allowed disks, scanning the leaf row
+* from the leaf uint64_t of the first free segment through at most ADAPTIVE_DISK_STRIPING_MAX_LEAVES_SCANNED more leaf uint64_t.
+*
+* @param numSegments The maximum number of segments to allocate.
+* @param numDisks The number of disks the segments are striped across (at most 64).
+* @param allowedDisksMask Bit diskId set if segments on that disk may be taken.
+* @param extentsVec The extents vector to append to, in ascending segment Id order.
+* @return The number of segments allocated.
+*/
+uint64_t MemoryManagerTreeArray::AppendFreeSegmentsOnDisks_NotThreadSafe(uint64_t numSegments, const unsigned int numDisks,
+    const uint64_t allowedDisksMask, segment_id_extents_vec_t & extentsVec)
+{
+    if (m_bitMasks[0][0] == 0) {
+        return 0; //full (prevent undefined behavior in boost::multiprecision::detail::find_lsb)
+    }
+    //the bits of a leaf uint64_t which lie on an allowed disk, indexed by the disk of the leaf's first bit
+    uint64_t allowedBitsByFirstDisk[64];
+    for (unsigned int firstDiskId = 0; firstDiskId < numDisks; ++firstDiskId) {
+        uint64_t allowedBits = 0;
+        for (unsigned int bitIndex = 0; bitIndex < 64; ++bitIndex) {
+            if ((allowedDisksMask >> ((firstDiskId + bitIndex) % numDisks)) & 1) {
+                allowedBits |= (((uint64_t)1) << bitIndex);
+            }
+        }
+        allowedBitsByFirstDisk[firstDiskId] = allowedBits;
+    }
+    //descend the tree (without allocating) to the leaf uint64_t holding the first free segment
+    segment_id_t leafLongIndex = 0;
+    for (segment_id_t depthIndex = 0; depthIndex < (MAX_TREE_ARRAY_DEPTH - 1); ++depthIndex) {
+        leafLongIndex = (leafLongIndex << 6) | boost::multiprecision::detail::find_lsb<uint64_t>(m_bitMasks[depthIndex][leafLongIndex]);
+    }
+    std::vector<uint64_t> & leafRow = m_bitMasks[MAX_TREE_ARRAY_DEPTH - 1];
+    const uint64_t endLeafLongIndex = std::min<uint64_t>(leafRow.size(),
+        std::min<uint64_t>((M_MAX_SEGMENTS + 63) >> 6, static_cast<uint64_t>(leafLongIndex) + ADAPTIVE_DISK_STRIPING_MAX_LEAVES_SCANNED + 1));
+    const uint64_t numSegmentsRequested = numSegments;
+    for (uint64_t longIndex = leafLongIndex; (longIndex < endLeafLongIndex) && numSegments; ++longIndex) {
+        uint64_t & longRef = leafRow[longIndex];
+        const uint64_t firstSegmentIdOfLong = longIndex << 6;
+        uint64_t availableBits = longRef & allowedBitsByFirstDisk[firstSegmentIdOfLong % numDisks];
+        if ((firstSegmentIdOfLong + 64) > M_MAX_SEGMENTS) {
+            availableBits &= ((((uint64_t)1) << (M_MAX_SEGMENTS - firstSegmentIdOfLong)) - 1);
+        }
+        uint64_t takenBits = 0;
+        while (availableBits && numSegments) {
+            const unsigned int bitIndex = boost::multiprecision::detail::find_lsb<uint64_t>(availableBits);
+            const uint64_t mask64 = (((uint64_t)1) << bitIndex);
+            availableBits &= (~mask64);
+            takenBits |= mask64;
+            AppendSegmentIdToExtents(extentsVec, static_cast<segment_id_t>(firstSegmentIdOfLong + bitIndex));
+            --numSegments;
+        }
+        if (takenBits) {
+            longRef &= (~takenBits);
+            if (longRef == 0) {
+                ClearParentBitsOfFullLeaf(static_cast<segment_id_t>(longIndex));
+            }
+        }
+    }
+    const uint64_t numAllocated = numSegmentsRequested - numSegments;
+    m_numSegmentsAllocated += numAllocated;
+    return numAllocated;
+}
+
+/** Private function to free every segment of an extent, one leaf uint64_t at a time.
+*
+* @param extent The extent to free.
+* @return True if every segment of the extent was allocated prior to the call, or False otherwise.
+* @post The segments of the extent that were allocated are marked free.  Segments that were already free remain unchanged.
+*/
+bool MemoryManagerTreeArray::FreeSegmentExtent_NotThreadSafe(const segment_id_extent_t & extent) {
+    if ((extent.beginSegmentId >= M_MAX_SEGMENTS) || (extent.numSegments > (M_MAX_SEGMENTS - extent.beginSegmentId))) {
+        return false;
+    }
+    bool success = true;
+    segment_id_t segmentId = extent.beginSegmentId;
+    uint64_t numSegmentsRemaining = extent.numSegments;
+    while (numSegmentsRemaining) {
+        const segment_id_t longIndex = segmentId >> 6; //divide by 64 bits per ui64
+        const unsigned int bitIndex = static_cast<unsigned int>(segmentId & 63);
+        const uint64_t runLength = std::min<uint64_t>(64 - bitIndex, numSegmentsRemaining);
+        const uint64_t mask64 = ((runLength == 64) ? UINT64_MAX : ((((uint64_t)1) << runLength) - 1)) << bitIndex;
+        uint64_t & longRef = m_bitMasks[MAX_TREE_ARRAY_DEPTH - 1][longIndex];
+        const uint64_t allocatedBits = mask64 & (~longRef);
+        if (allocatedBits != mask64) {
+            success = false; //error if leaf bit is already 1 (empty)
+        }
+        const bool wasFull = (longRef == 0);
+        longRef |= mask64;
+        if (wasFull) {
+            SetParentBitsOfNonFullLeaf(longIndex);
+        }
+        m_numSegmentsAllocated -= std::bitset<64>(allocatedBits).count();
+        numSegmentsRemaining -= runLength;
+        segmentId += static_cast<segment_id_t>(runLength);
+    }
+    return success;
+}
+
+bool MemoryManagerTreeArray::FreeSegmentExtents_ThreadSafe(const segment_id_extents_vec_t & extentsVec) {
+    boost::mutex::scoped_lock lock(m_mutex);
+    bool success = true;
+    for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+        if (!FreeSegmentExtent_NotThreadSafe(extentsVec[i])) {
+            success = false;
+        }
+    }
+    return success;
+}
+
 uint64_t MemoryManagerTreeArray::GetNumAllocatedSegments_NotThreadSafe() const noexcept {
     return m_numSegmentsAllocated;
 }
@@ -0,0 +1,107 @@
+/**
+ * @file ReleaseBufferPool.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include "ReleaseBufferPool.h"
+#include "BundleStorageConfig.h"
+#include <algorithm>
+#include <boost/align/aligned_alloc.hpp>
+
+ReleaseBufferPool::ReleaseBufferPool(const uint64_t maxFreeBytes) :
+    M_MAX_FREE_BYTES(maxFreeBytes),
+    m_freeBytes(0),
+    m_numBuffersAllocated(0),
+    m_numBuffersReused(0) {}
+
+std::shared_ptr<ReleaseBufferPool> ReleaseBufferPool::Create(const uint64_t maxFreeBytes) {
+    return std::shared_ptr<ReleaseBufferPool>(new ReleaseBufferPool(maxFreeBytes));
+}
+
+ReleaseBufferPool::~ReleaseBufferPool() {
+    //every buffer given out holds a shared_ptr to this pool, so only free buffers remain
+    for (std::multimap<std::size_t, release_buffer_t *>::iterator it = m_freeBuffersByCapacity.begin(); it != m_freeBuffersByCapacity.end(); ++it) {
+        FreeBuffer(it->second);
+    }
+}
+
+void ReleaseBufferPool::FreeBuffer(release_buffer_t * releaseBuffer) {
+    boost::alignment::aligned_free(releaseBuffer->data);
+    delete releaseBuffer;
+}
+
+release_buffer_t * ReleaseBufferPool::Acquire(const uint64_t bundleSizeBytes) {
+    const uint64_t numSegments = std::max<uint64_t>(1, (bundleSizeBytes + (BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1)) / BUNDLE_STORAGE_PER_SEGMENT_SIZE);
+    const std::size_t capacityNeeded = static_cast<std::size_t>(numSegments * SEGMENT_SIZE);
+    release_buffer_t * releaseBuffer = NULL;
+    {
+        boost::mutex::scoped_lock lock(m_mutex);
+        //the smallest free buffer that fits, unless it would waste more than it holds
+        std::multimap<std::size_t, release_buffer_t *>::iterator it = m_freeBuffersByCapacity.lower_bound(capacityNeeded);
+        if ((it != m_freeBuffersByCapacity.end()) && (it->first <= (capacityNeeded * 2))) {
+            releaseBuffer = it->second;
+            m_freeBytes -= it->first;
+            m_freeBuffersByCapacity.erase(it);
+            ++m_numBuffersReused;
+        }
+        else {
+            ++m_numBuffersAllocated;
+        }
+    }
+    if (releaseBuffer == NULL) {
+        releaseBuffer = new release_buffer_t();
+        releaseBuffer->data = static_cast<uint8_t *>(boost::alignment::aligned_alloc(SEGMENT_BUFFER_ALIGNMENT, capacityNeeded));
+        if (releaseBuffer->data == NULL) {
+            delete releaseBuffer;
+            return NULL;
+        }
+        releaseBuffer->capacity = capacityNeeded;
+    }
+    releaseBuffer->size = 0;
+    releaseBuffer->poolPtr = shared_from_this();
+    return releaseBuffer;
+}
+
+void ReleaseBufferPool::Recycle(release_buffer_t * releaseBuffer) {
+    std::shared_ptr<ReleaseBufferPool> poolPtr;
+    poolPtr.swap(releaseBuffer->poolPtr); //the pool may be destroyed when poolPtr goes out of scope
+    bool keep = false;
+    if (poolPtr) {
+        ReleaseBufferPool & pool = *poolPtr;
+        boost::mutex::scoped_lock lock(pool.m_mutex);
+        if ((pool.m_freeBytes + releaseBuffer->capacity) <= pool.M_MAX_FREE_BYTES) {
+            pool.m_freeBuffersByCapacity.emplace(releaseBuffer->capacity, releaseBuffer);
+            pool.m_freeBytes += releaseBuffer->capacity;
+            keep = true;
+        }
+    }
+    if (!keep) {
+        FreeBuffer(releaseBuffer);
+    }
+}
+
+void ReleaseBufferPool::ZmqFreeCallback(void * data, void * hint) {
+    (void)data;
+    Recycle(static_cast<release_buffer_t *>(hint));
+}
+
+uint64_t ReleaseBufferPool::GetNumBuffersAllocated() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_numBuffersAllocated;
+}
+uint64_t ReleaseBufferPool::GetNumBuffersReused() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_numBuffersReused;
+}
+uint64_t ReleaseBufferPool::GetFreeBytes() {
+    boost::mutex::scoped_lock lock(m_mutex);
+    return m_freeBytes;
+}
@@ -14,8 +14,14 @@
 
 #include "ZmqStorageInterface.h"
 #include "message.hpp"
+#include "InprocBundleRings.hpp"
+#include "ModuleBusBatcher.hpp"
 #include "BundleStorageManagerMT.h"
 #include "BundleStorageManagerAsio.h"
+#include "BundleStorageManagerRam.h"
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+#include "BundleStorageManagerIoUring.h"
+#endif
 #include "Logger.h"
 #include <map>
 #include <string>
@@ -27,6 +33,7 @@
 #include "TelemetryDefinitions.h"
 #include <boost/core/noncopyable.hpp>
 #include <set>
+#include <deque>
 #include <unordered_set>
 #include <unordered_map>
 #include <boost/lexical_cast.hpp>
@@ -48,8 +55,6 @@ static constexpr hdtn::Logger::SubProcess subprocess = hdtn::Logger::SubProcess:
 static const boost::posix_time::time_duration DELETE_EXPIRED_PERIOD = boost::posix_time::milliseconds(2000);
 /** Threshold for deleting expired bundles dependent on policy (0.9 is 90%) */
 static const float DELETE_ALL_EXPIRED_THRESHOLD = 0.9f;
-/** Maximum number of expired bundles to delete per iteration unless threshold reached */
-static const uint64_t MAX_DELETE_EXPIRED_PER_ITER = 100;
 
 struct ZmqStorageInterface::Impl : private boost::noncopyable {
     struct CutThroughQueueData : private boost::noncopyable {
@@ -73,6 +78,47 @@ struct ZmqStorageInterface::Impl : private boost::noncopyable {
     typedef std::queue<CutThroughQueueData> cut_through_queue_t;
     typedef std::unordered_map<uint64_t, uint64_t> custodyid_to_size_map_t;
     typedef std::unordered_map<uint64_t, CutThroughMapAckData> map_id_to_ackdata_t;
+    //a bundle popped from awaiting send and read from disk ahead of its outduct's contact (HDTN_MSGTYPE_IPRELOAD)
+    struct PreloadedBundle {
+        PreloadedBundle() = delete;
+        PreloadedBundle(const PreloadedBundle&) = delete;
+        PreloadedBundle& operator=(const PreloadedBundle&) = delete;
+        PreloadedBundle(const uint64_t paramCustodyId, const uint64_t paramBundleSizeBytes, std::unique_ptr<padded_vector_uint8_t>&& paramBundleDataPtr) :
+            custodyId(paramCustodyId), bundleSizeBytes(paramBundleSizeBytes), bundleDataPtr(std::move(paramBundleDataPtr)) {}
+        PreloadedBundle(PreloadedBundle&& o) = default;
+        PreloadedBundle& operator=(PreloadedBundle&& o) = default;
+        uint64_t custodyId;
+        uint64_t bundleSizeBytes;
+        std::unique_ptr<padded_vector_uint8_t> bundleDataPtr;
+    };
+    typedef std::deque<PreloadedBundle> preloaded_bundles_queue_t;
+    //a bundle popped from awaiting send (and not in the RAM hot tier) which a release worker reads from disk
+    struct ReleaseJob {
+        catalog_entry_t catalogEntry; //a copy, so that the release worker never touches the catalog
+        uint64_t custodyId;
+        uint64_t outductIndex;
+        uint64_t nextHopNodeId;
+    };
+    //sent from a release worker to the storage thread, followed by a message part with the bundle read from disk
+    struct ReleaseWorkerResultHdr {
+        cbhe_eid_t finalDestEid;
+        uint64_t custodyId;
+        uint64_t outductIndex;
+        uint64_t nextHopNodeId;
+        uint64_t bundleSizeBytes;
+        uint8_t hasCustody;
+        uint8_t success;
+    };
+    //a thread which reads from disk the bundles released to its shard of the outducts
+    struct ReleaseWorker : private boost::noncopyable {
+        std::unique_ptr<boost::thread> threadPtr;
+        std::unique_ptr<zmq::socket_t> zmqPushSock_releaseWorkerToStoragePtr; //connected by the storage thread, then used only by the worker
+        boost::mutex mutex;
+        boost::condition_variable conditionVariable;
+        std::deque<ReleaseJob> jobs; //protected by mutex
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+    };
+    typedef std::unique_ptr<ReleaseWorker> ReleaseWorkerPtr_t;
     struct OutductInfo_t : private boost::noncopyable {
         OutductInfo_t() :
             halfOfMaxBundlesInPipeline_StorageToEgressPath(0),
@@ -81,7 +127,9 @@ struct ZmqStorageInterface::Impl : private boost::noncopyable {
             nextHopNodeId(0),
             linkIsUp(false),
             stateTryCutThrough(false),
-            bytesInPipeline(0)
+            destinationGroupId(UINT64_MAX),
+            bytesInPipeline(0),
+            preloadedBytes(0)
         {}
 
         uint64_t halfOfMaxBundlesInPipeline_StorageToEgressPath;
@@ -91,10 +139,14 @@ struct ZmqStorageInterface::Impl : private boost::noncopyable {
         bool linkIsUp;
         bool stateTryCutThrough;
         std::vector<eid_plus_isanyserviceid_pair_t> eidVec;
+        uint64_t destinationGroupId; //eidVec as registered with the storage catalog (UINT64_MAX if not registered)
         custodyid_to_size_map_t mapOpenCustodyIdToBundleSizeBytes;
         map_id_to_ackdata_t mapIngressUniqueIdToIngressAckData;
         cut_through_queue_t cutThroughQueue;
         uint64_t bytesInPipeline;
+        preloaded_bundles_queue_t preloadedBundles; //released before anything else once the link is up
+        uint64_t preloadedBytes;
+        boost::posix_time::ptime preloadExpiry; //return the preloaded bundles to awaiting send if the link is not up by then
         friend std::ostream& operator<<(std::ostream& os, const OutductInfo_t& o);
 
         bool IsOpportunisticLink() const noexcept {
@@ -107,7 +159,8 @@ struct ZmqStorageInterface::Impl : private boost::noncopyable {
     Impl();
     ~Impl();
     void Stop();
-    bool Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr);
+    bool Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr,
+        hdtn::InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr);
     std::size_t GetCurrentNumberOfBundlesDeletedFromStorage();
 
 private:
@@ -122,9 +175,29 @@ private:
     bool WriteBundle(BundleViewV7 &bv, const uint64_t newCustodyId, cbhe_eid_t *bundleEidMaskPtr = NULL);
     bool WriteBundle(const PrimaryBlock& bundlePrimaryBlock,
         const uint64_t newCustodyId, const uint8_t* allData, const std::size_t allDataSize, uint64_t payloadSizeBytes, cbhe_eid_t *bundleEidMaskPtr = NULL);
-    uint64_t PeekOne(const std::vector<eid_plus_isanyserviceid_pair_t>& availableDestLinks);
-    uint64_t PeekOne(const std::vector<eid_plus_isanyserviceid_pair_t> & availableDestLinks, int &priority);
-    bool ReleaseOne_NoBlock(const OutductInfo_t& info, const uint64_t maxBundleSizeToRead, uint64_t& returnedBundleSize);
+    uint64_t PeekOne(const OutductInfo_t& info);
+    uint64_t PeekOne(const OutductInfo_t& info, int &priority);
+    void SetDestinationGroup(OutductInfo_t& info);
+    void RemoveDestinationGroup(OutductInfo_t& info);
+    bool ReleaseOne_NoBlock(OutductInfo_t& info, const uint64_t maxBundleSizeToRead, uint64_t& returnedBundleSize);
+    bool ReleasePreloadedOne_NoBlock(OutductInfo_t& info, const uint64_t maxBundleSizeToRead, uint64_t& returnedBundleSize);
+    void PreloadOutduct(OutductInfo_t& info);
+    void ReturnPreloadedBundles(OutductInfo_t& info);
+    void DropPreloadedBundle(const uint64_t custodyId);
+    void ReturnExpiredPreloadedBundles(const boost::posix_time::ptime& nowPtime);
+    bool PushToEgressRing(const hdtn::ToEgressHdr& toEgressHdr, zmq::message_t& zmqBundleDataMessage);
+    bool StoreBundleFromIngress(const hdtn::ToStorageHdr& toStorageHeader, zmq::message_t& zmqBundleDataReceived, hdtn::StorageAckHdr& storageAck);
+    bool HandleToStorageMessage(const hdtn::ToStorageHdr& toStorageHeader, zmq::message_t& zmqBundleDataReceived, hdtn::StorageAckHdr& storageAck);
+    void SendStorageAcksToIngress(std::vector<hdtn::StorageAckHdr>& storageAcks);
+    void PopFromIngressRings(std::vector<hdtn::StorageAckHdr>& storageAcks);
+    bool SendStoredBundleToEgress(const uint64_t nextHopNodeId, const uint64_t outductIndex, const cbhe_eid_t& finalDestEid,
+        const bool hasCustody, const uint64_t custodyId, zmq::message_t&& zmqBundleDataMessage);
+    bool StartReleaseWorkers(const unsigned int numReleaseWorkers);
+    void StopReleaseWorkers();
+    void ReleaseWorkerThreadFunc(ReleaseWorker* releaseWorkerPtr, const unsigned int releaseWorkerIndex);
+    bool HandleReleaseWorkerResult();
+    bool RemoveBundleFromDiskOrDeferUntilRead(const catalog_entry_t* catalogEntryPtr, const uint64_t custodyId);
+    OutductInfo_t* GetOutductInfo(const uint64_t outductIndex, const uint64_t nextHopNodeId);
     void RepopulateUpLinksVec();
     void SetLinkDown(OutductInfo_t & info);
     void ThreadFunc();
@@ -161,6 +234,7 @@ private:
     HdtnConfig m_hdtnConfig;
 
     zmq::context_t* m_hdtnOneProcessZmqInprocContextPtr;
+    hdtn::InprocBundleRings* m_inprocBundleRingsPtr; //NULL unless one-process with the spsc-ring inproc transport (replaces m_zmqPushSock_connectingStorageToBoundEgressPtr)
     std::unique_ptr<boost::thread> m_threadPtr;
     std::atomic<bool> m_running;
     bool m_isOutOfStorageSpace;
@@ -172,10 +246,20 @@ private:
     std::unique_ptr<CustodyTimers> m_custodyTimersPtr;
     BundleViewV6 m_custodySignalRfc5050RenderedBundleView;
     BundleStorageManagerSession_ReadFromDisk m_sessionRead; //reuse this due to expensive heap allocation
+    std::shared_ptr<ReleaseBufferPool> m_releaseBufferPoolPtr; //buffers of bundles released to egress (also used by the release workers)
     std::vector<OutductInfoPtr_t> m_vectorOutductInfo; //outductIndex to info
     std::map<uint64_t, OutductInfoPtr_t> m_mapOpportunisticNextHopNodeIdToOutductInfo;
     std::vector<OutductInfo_t*> m_vectorUpLinksOutductInfoPtrs; //outductIndex to info
 
+    //release workers (storage config numReleaseWorkerThreads), each owning the outducts whose index (or nextHopNodeId
+    //if opportunistic) modulo the number of workers is its index; empty if bundles are read from disk by ThreadFunc()
+    std::vector<ReleaseWorkerPtr_t> m_releaseWorkersVec;
+    std::unique_ptr<zmq::socket_t> m_zmqPullSock_releaseWorkersToStoragePtr;
+    std::atomic<bool> m_releaseWorkersRunning;
+    //custody ids handed to a release worker and not yet returned, mapped to whether the bundle must be
+    //removed from disk (i.e. by a custody signal or expiration) once the worker has finished reading it
+    std::unordered_map<uint64_t, bool> m_mapReleaseWorkerCustodyIdToRemoveWhenRead;
+
     //for blocking until worker-thread startup
     std::atomic<bool> m_workerThreadStartupInProgress;
     boost::mutex m_workerThreadStartupMutex;
@@ -197,6 +281,10 @@ private:
     TelemetryServer m_telemServer;
 
     std::size_t m_lastIndexToUpLinkVectorOutductInfoRoundRobin;
+    bool m_hasPreloadedBundles; //some outduct has bundles preloaded ahead of its contact
+    //the outduct holding each preloaded bundle, so that a bundle removed while preloaded (custody signal or expiry)
+    //is dropped from the preload queue rather than released later under a custody id since reallocated to another bundle
+    std::unordered_map<uint64_t, OutductInfo_t*> m_mapPreloadedCustodyIdToOutductInfo;
 
     // stats
     std::size_t m_totalEventsNoDataInStorageForAvailableLinks;
@@ -205,11 +293,14 @@ private:
 
 ZmqStorageInterface::Impl::Impl() :
     m_hdtnOneProcessZmqInprocContextPtr(nullptr),
+    m_inprocBundleRingsPtr(nullptr),
     m_running(false),
     m_isOutOfStorageSpace(false),
+    m_releaseWorkersRunning(false),
     m_workerThreadStartupInProgress(false),
     m_deletionPolicy(DeletionPolicy::never),
     m_lastIndexToUpLinkVectorOutductInfoRoundRobin(0),
+    m_hasPreloadedBundles(false),
     m_totalEventsNoDataInStorageForAvailableLinks(0),
     m_totalEventsDataInStorageForCloggedLinks(0)
 {}
@@ -243,10 +334,14 @@ void ZmqStorageInterface::Impl::Stop() {
     }
 }
 
-bool ZmqStorageInterface::Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr) {
-    return m_pimpl->Init(hdtnConfig, hdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr);
+bool ZmqStorageInterface::Init(const HdtnConfig& hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t* hdtnOneProcessZmqInprocContextPtr,
+    hdtn::InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr)
+{
+    return m_pimpl->Init(hdtnConfig, hdtnDistributedConfig, hdtnOneProcessZmqInprocContextPtr, hdtnOneProcessInprocBundleRingsPtr);
 }
-bool ZmqStorageInterface::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t * hdtnOneProcessZmqInprocContextPtr) {
+bool ZmqStorageInterface::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDistributedConfig& hdtnDistributedConfig, zmq::context_t * hdtnOneProcessZmqInprocContextPtr,
+    hdtn::InprocBundleRings* hdtnOneProcessInprocBundleRingsPtr)
+{
 
     if (m_running) {
         LOG_ERROR(subprocess) << "ZmqStorageInterface::Init called while ZmqStorageInterface is already running";
@@ -260,6 +355,7 @@ bool ZmqStorageInterface::Impl::Init(const HdtnConfig & hdtnConfig, const HdtnDi
     //HDTN shall default m_myCustodialServiceId to 0 although it is changeable in the hdtn config json file
     M_HDTN_EID_CUSTODY.Set(m_hdtnConfig.m_myNodeId, m_hdtnConfig.m_myCustodialServiceId);
     m_hdtnOneProcessZmqInprocContextPtr = hdtnOneProcessZmqInprocContextPtr;
+    m_inprocBundleRingsPtr = (hdtnOneProcessZmqInprocContextPtr) ? hdtnOneProcessInprocBundleRingsPtr : nullptr;
 
     if(m_hdtnConfig.m_storageConfig.m_storageDeletionPolicy == "never") {
         m_deletionPolicy = DeletionPolicy::never;
@@ -513,11 +609,11 @@ bool ZmqStorageInterface::Impl::ProcessAdminRecord(BundleViewV6 &bv)
         //todo figure out what to do with failed custody from next hop
         for (FragmentSet::data_fragment_set_t::const_iterator it = acs.m_custodyIdFills.cbegin(); it != acs.m_custodyIdFills.cend(); ++it) {
             m_telem.m_numAcsCustodyTransfers += (it->endIndex + 1) - it->beginIndex;
-            m_custodyIdAllocatorPtr->FreeCustodyIdRange(it->beginIndex, it->endIndex);
             for (uint64_t currentCustodyId = it->beginIndex; currentCustodyId <= it->endIndex; ++currentCustodyId) {
                 catalog_entry_t* catalogEntryPtr = m_bsmPtr->GetCatalogEntryPtrFromCustodyId(currentCustodyId);
                 if (catalogEntryPtr == NULL) {
                     LOG_ERROR(subprocess) << "error finding catalog entry for bundle identified by acs custody signal";
+                    m_custodyIdAllocatorPtr->FreeCustodyId(currentCustodyId);
                     continue;
                 }
                 if(!m_custodyIdsWaitingTimerStart.count(currentCustodyId)) {
@@ -527,7 +623,7 @@ bool ZmqStorageInterface::Impl::ProcessAdminRecord(BundleViewV6 &bv)
                 } else {
                     m_custodyIdsWaitingTimerStart.erase(currentCustodyId);
                 }
-                if (!m_bsmPtr->RemoveBundleFromDisk(catalogEntryPtr, currentCustodyId)) {
+                if (!RemoveBundleFromDiskOrDeferUntilRead(catalogEntryPtr, currentCustodyId)) {
                     LOG_ERROR(subprocess) << "error freeing bundle identified by acs custody signal from disk";
                     continue;
                 }
@@ -583,10 +679,10 @@ bool ZmqStorageInterface::Impl::ProcessAdminRecord(BundleViewV6 &bv)
             return false;
         }
         const uint64_t custodyIdFromRfc5050 = *custodyIdPtr;
-        m_custodyIdAllocatorPtr->FreeCustodyId(custodyIdFromRfc5050);
         catalog_entry_t* catalogEntryPtr = m_bsmPtr->GetCatalogEntryPtrFromCustodyId(custodyIdFromRfc5050);
         if (catalogEntryPtr == NULL) {
             LOG_ERROR(subprocess) << "error finding catalog entry for bundle identified by rfc5050 custody signal";
+            m_custodyIdAllocatorPtr->FreeCustodyId(custodyIdFromRfc5050);
             return false;
         }
         if(!m_custodyIdsWaitingTimerStart.count(custodyIdFromRfc5050)) {
@@ -596,7 +692,7 @@ bool ZmqStorageInterface::Impl::ProcessAdminRecord(BundleViewV6 &bv)
         } else {
             m_custodyIdsWaitingTimerStart.erase(custodyIdFromRfc5050);
         }
-        if (!m_bsmPtr->RemoveBundleFromDisk(catalogEntryPtr, custodyIdFromRfc5050)) {
+        if (!RemoveBundleFromDiskOrDeferUntilRead(catalogEntryPtr, custodyIdFromRfc5050)) {
             LOG_ERROR(subprocess) << "error freeing bundle identified by rfc5050 custody signal from disk";
             return false;
         }
@@ -887,8 +983,15 @@ bool ZmqStorageInterface::Impl::WriteBundle(const PrimaryBlock& bundlePrimaryBlo
     return true;
 }
 
-uint64_t ZmqStorageInterface::Impl::PeekOne(const std::vector<eid_plus_isanyserviceid_pair_t> & availableDestLinks, int &priority) {
-    const uint64_t bytesToReadFromDisk = m_bsmPtr->PopTop(m_sessionRead, availableDestLinks);
+uint64_t ZmqStorageInterface::Impl::PeekOne(const OutductInfo_t& info, int &priority) {
+    if (!info.preloadedBundles.empty()) {
+        const PreloadedBundle& pb = info.preloadedBundles.front();
+        if (const catalog_entry_t* catalogEntryPtr = m_bsmPtr->GetCatalogEntryPtrFromCustodyId(pb.custodyId)) {
+            priority = catalogEntryPtr->GetPriorityIndex();
+        }
+        return pb.bundleSizeBytes;
+    }
+    const uint64_t bytesToReadFromDisk = m_bsmPtr->PopTop(m_sessionRead, info.destinationGroupId);
     if (bytesToReadFromDisk == 0) { //no more of these links to read
         return 0; //no bytes to read
     }
@@ -901,9 +1004,24 @@ uint64_t ZmqStorageInterface::Impl::PeekOne(const std::vector<eid_plus_isanyserv
 }
 
 //return number of bytes to read for specified links
-uint64_t ZmqStorageInterface::Impl::PeekOne(const std::vector<eid_plus_isanyserviceid_pair_t> & availableDestLinks) {
+uint64_t ZmqStorageInterface::Impl::PeekOne(const OutductInfo_t& info) {
     int priority = 0;
-    return PeekOne(availableDestLinks, priority);
+    return PeekOne(info, priority);
+}
+
+//(re)register the outduct's final destinations with the storage catalog so that
+//releasing from storage does not have to search every final destination
+void ZmqStorageInterface::Impl::SetDestinationGroup(OutductInfo_t& info) {
+    ReturnPreloadedBundles(info); //may no longer be routed to this outduct
+    RemoveDestinationGroup(info);
+    info.destinationGroupId = m_bsmPtr->AddDestinationGroup(info.eidVec);
+}
+
+void ZmqStorageInterface::Impl::RemoveDestinationGroup(OutductInfo_t& info) {
+    if (info.destinationGroupId != UINT64_MAX) {
+        m_bsmPtr->RemoveDestinationGroup(info.destinationGroupId);
+        info.destinationGroupId = UINT64_MAX;
+    }
 }
 
 static void CustomCleanupToEgressHdr(void *data, void *hint) {
@@ -919,9 +1037,12 @@ static void CustomCleanupPaddedVecUint8(void* data, void* hint) {
     delete static_cast<padded_vector_uint8_t*>(hint);
 }
 
-bool ZmqStorageInterface::Impl::ReleaseOne_NoBlock(const OutductInfo_t& info, const uint64_t maxBundleSizeToRead, uint64_t& returnedBundleSize)
+bool ZmqStorageInterface::Impl::ReleaseOne_NoBlock(OutductInfo_t& info, const uint64_t maxBundleSizeToRead, uint64_t& returnedBundleSize)
 {
-    const uint64_t bytesToReadFromDisk = m_bsmPtr->PopTop(m_sessionRead, info.eidVec);
+    if (!info.preloadedBundles.empty()) {
+        return ReleasePreloadedOne_NoBlock(info, maxBundleSizeToRead, returnedBundleSize);
+    }
+    const uint64_t bytesToReadFromDisk = m_bsmPtr->PopTop(m_sessionRead, info.destinationGroupId);
     if (bytesToReadFromDisk == 0) { //no more of these links to read
         return false;
     }
@@ -936,17 +1057,187 @@ bool ZmqStorageInterface::Impl::ReleaseOne_NoBlock(const OutductInfo_t& info, co
         return false;
         //bytesToReadFromDisk = bsm.PopTop(sessionRead, availableDestLinks); //get it back
     }
+
+    if ((!m_releaseWorkersVec.empty()) && (!m_bsmPtr->IsInRamHotTier(m_sessionRead.catalogEntryPtr))
+        && (!m_sessionRead.catalogEntryPtr->IsInSmallBundleSlab())) //(bundles in RAM are copied on this thread)
+    {
+        //hand the disk read to the outduct's release worker, which returns the bundle to HandleReleaseWorkerResult for sending,
+        //so that the bundle is counted in the pipeline from now on (and undone by HandleReleaseWorkerResult on failure)
+        ReleaseWorker& releaseWorker = *m_releaseWorkersVec[((info.IsOpportunisticLink()) ? info.nextHopNodeId : info.outductIndex) % m_releaseWorkersVec.size()];
+        m_mapReleaseWorkerCustodyIdToRemoveWhenRead[m_sessionRead.custodyId] = false;
+        releaseWorker.mutex.lock();
+        releaseWorker.jobs.push_back(ReleaseJob{ *m_sessionRead.catalogEntryPtr, m_sessionRead.custodyId, info.outductIndex, info.nextHopNodeId });
+        releaseWorker.mutex.unlock();
+        releaseWorker.conditionVariable.notify_one();
+        returnedBundleSize = bytesToReadFromDisk;
+        return true;
+    }
         
-    padded_vector_uint8_t* vecUint8BundleDataRawPointer = new padded_vector_uint8_t();
-    const bool successReadAllSegments = m_bsmPtr->ReadAllSegments(m_sessionRead, *vecUint8BundleDataRawPointer);
-    zmq::message_t zmqBundleDataMessageWithDataStolen(vecUint8BundleDataRawPointer->data(), vecUint8BundleDataRawPointer->size(), CustomCleanupPaddedVecUint8, vecUint8BundleDataRawPointer);
+    release_buffer_t* releaseBufferRawPointer = m_releaseBufferPoolPtr->Acquire(bytesToReadFromDisk);
+    if (releaseBufferRawPointer == NULL) {
+        LOG_ERROR(subprocess) << "unable to allocate " << bytesToReadFromDisk << " bytes to read a bundle from disk";
+        m_bsmPtr->ReturnTop(m_sessionRead);
+        return false;
+    }
+    const bool successReadAllSegments = m_bsmPtr->ReadAllSegmentsIntoReleaseBuffer(m_sessionRead, *releaseBufferRawPointer);
+    zmq::message_t zmqBundleDataMessageWithDataStolen(releaseBufferRawPointer->data, releaseBufferRawPointer->size, ReleaseBufferPool::ZmqFreeCallback, releaseBufferRawPointer);
         
     if (!successReadAllSegments) {
         LOG_ERROR(subprocess) << "unable to read all segments from disk";
         return false;
     }
 
+    if (!SendStoredBundleToEgress(info.nextHopNodeId, info.outductIndex, m_sessionRead.catalogEntryPtr->destEid,
+        m_sessionRead.catalogEntryPtr->HasCustody(), m_sessionRead.custodyId, std::move(zmqBundleDataMessageWithDataStolen)))
+    {
+        m_bsmPtr->ReturnTop(m_sessionRead);
+        return false;
+    }
 
+    returnedBundleSize = bytesToReadFromDisk;
+    return true;
+
+}
+
+//The storage thread is the only producer of the storage to egress ring.
+bool ZmqStorageInterface::Impl::PushToEgressRing(const hdtn::ToEgressHdr& toEgressHdr, zmq::message_t& zmqBundleDataMessage) {
+    hdtn::ToEgressDescriptor descriptor;
+    descriptor.toEgressHdr = toEgressHdr;
+    descriptor.bundle = std::move(zmqBundleDataMessage);
+    return m_inprocBundleRingsPtr->storageToEgressRing.TryPush(descriptor); //false if full
+}
+
+//Handles a message of ingress (from the socket or a ring), where zmqBundleDataReceived is the bundle of an HDTN_MSGTYPE_STORE (else empty).
+//Returns true if storageAck is to be sent to ingress now (see StoreBundleFromIngress).
+bool ZmqStorageInterface::Impl::HandleToStorageMessage(const hdtn::ToStorageHdr& toStorageHeader, zmq::message_t& zmqBundleDataReceived,
+    hdtn::StorageAckHdr& storageAck)
+{
+    if (toStorageHeader.base.type == HDTN_MSGTYPE_STORE) {
+        //storageStats.inBytes += sizeof(hdtn::ToStorageHdr);
+        //++storageStats.inMsg;
+        return StoreBundleFromIngress(toStorageHeader, zmqBundleDataReceived, storageAck);
+    }
+    else if (toStorageHeader.base.type == HDTN_MSGTYPE_STORAGE_ADD_OPPORTUNISTIC_LINK) {
+        const uint64_t nodeId = toStorageHeader.ingressUniqueId;
+
+        std::pair<std::map<uint64_t, OutductInfoPtr_t>::iterator, bool> ret = m_mapOpportunisticNextHopNodeIdToOutductInfo.
+#if (__cplusplus >= 201703L) //try_emplace would be most ideal so it doesnt create and destroy element if exists
+            try_emplace( 
+#else
+            emplace(
+#endif
+        nodeId, boost::make_unique<OutductInfo_t>());
+        //(true if insertion happened, false if it did not).
+        if (ret.second) {
+            OutductInfo_t& info = *(ret.first->second);
+            info.eidVec.resize(1);
+            const eid_plus_isanyserviceid_pair_t key(cbhe_eid_t(nodeId, 0), true); //true => any service id.. 0 is don't care
+            info.eidVec[0] = key;
+            SetDestinationGroup(info);
+            info.nextHopNodeId = nodeId;
+            info.linkIsUp = true;
+            info.outductIndex = UINT64_MAX;
+            info.halfOfMaxBundlesInPipeline_StorageToEgressPath = 5; //TODO
+            info.halfOfMaxBundleSizeBytesInPipeline_StorageToEgressPath = info.halfOfMaxBundlesInPipeline_StorageToEgressPath * m_hdtnConfig.m_maxBundleSizeBytes;
+            RepopulateUpLinksVec();
+            LOG_INFO(subprocess) << "Adding Opportunistic link from ingress connection.. " << info;
+        }
+        else {
+            LOG_ERROR(subprocess) << "Ignoring Duplicate Message for adding Opportunistic link from ingress connection.. ";
+        }
+    }
+    else if (toStorageHeader.base.type == HDTN_MSGTYPE_STORAGE_REMOVE_OPPORTUNISTIC_LINK) {
+        const uint64_t nodeId = toStorageHeader.ingressUniqueId;
+        std::map<uint64_t, OutductInfoPtr_t>::iterator it = m_mapOpportunisticNextHopNodeIdToOutductInfo.find(nodeId);
+        const bool wasErased = (it != m_mapOpportunisticNextHopNodeIdToOutductInfo.end());
+        if (wasErased) {
+            RemoveDestinationGroup(*(it->second));
+            m_mapOpportunisticNextHopNodeIdToOutductInfo.erase(it);
+            RepopulateUpLinksVec();
+        }
+        LOG_INFO(subprocess) << "Removing Opportunistic link from ingress connection.. finalDestEid ("
+            << Uri::GetIpnUriStringAnyServiceNumber(nodeId)
+            << ") will " << ((wasErased) ? "STOP" : "REMAIN STOPPED FROM") << " being released from storage";
+    }
+    else {
+        LOG_ERROR(subprocess) << "hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) unknown message type";
+    }
+    return false;
+}
+
+//Sends the immediate acks of one batch (or ring drain) of ingress bundles to ingress as one message.
+void ZmqStorageInterface::Impl::SendStorageAcksToIngress(std::vector<hdtn::StorageAckHdr>& storageAcks) {
+    if ((storageAcks.size() == 1) && (!m_zmqPushSock_connectingStorageToBoundIngressPtr->send(
+        zmq::const_buffer(&storageAcks[0], sizeof(hdtn::StorageAckHdr)), zmq::send_flags::dontwait)))
+    {
+        LOG_ERROR(subprocess) << "zmq could not send ingress an ack from storage";
+    }
+    else if ((storageAcks.size() > 1) && (!hdtn::ModuleBusBatcher<hdtn::StorageAckHdr>::SendBatch(*m_zmqPushSock_connectingStorageToBoundIngressPtr,
+        HDTN_MSGTYPE_STORAGE_ACK_BATCH_TO_INGRESS, storageAcks, NULL)))
+    {
+        LOG_ERROR(subprocess) << "zmq could not send ingress a batch of " << storageAcks.size() << " acks from storage";
+    }
+}
+
+//Pops at most one ring's worth from every ring of the ingress producer threads (so that the sockets are not starved),
+//then sends the immediate acks of those bundles to ingress as one message.
+void ZmqStorageInterface::Impl::PopFromIngressRings(std::vector<hdtn::StorageAckHdr>& storageAcks) {
+    hdtn::ToStorageRingGroup& ringGroup = m_inprocBundleRingsPtr->ingressToStorageRings;
+    hdtn::ToStorageDescriptor descriptor;
+    storageAcks.clear();
+    for (unsigned int ringIndex = 0; ringIndex < ringGroup.GetNumRings(); ++ringIndex) {
+        hdtn::ToStorageRingGroup::ring_t& ring = ringGroup.GetRing(ringIndex);
+        ring.FinishWait();
+        const unsigned int maxToPop = ring.GetCapacity();
+        for (unsigned int i = 0; (i < maxToPop) && ring.TryPop(descriptor); ++i) {
+            storageAcks.emplace_back();
+            if (!HandleToStorageMessage(descriptor.toStorageHdr, descriptor.bundle, storageAcks.back())) {
+                storageAcks.pop_back(); //acked later from the cut-through queue (or not a bundle)
+            }
+        }
+    }
+    descriptor.bundle.rebuild(); //release a bundle that wasn't moved into storage
+    SendStorageAcksToIngress(storageAcks);
+}
+
+//Returns true if storageAck is to be sent to ingress now, or false if the ack was queued with a cut-through bundle
+//(i.e. the bundle is not stored and is acked once egress takes it).
+bool ZmqStorageInterface::Impl::StoreBundleFromIngress(const hdtn::ToStorageHdr& toStorageHeader, zmq::message_t& zmqBundleDataReceived,
+    hdtn::StorageAckHdr& storageAck)
+{
+    //memset 0 not needed because all values set below
+    storageAck.base.type = HDTN_MSGTYPE_STORAGE_ACK_TO_INGRESS;
+    storageAck.base.flags = 0;
+    storageAck.error = 0;
+    storageAck.ingressUniqueId = toStorageHeader.ingressUniqueId;
+    storageAck.outductIndex = toStorageHeader.outductIndex;
+
+    if ((toStorageHeader.dontStoreBundle)
+        && (toStorageHeader.outductIndex < m_vectorOutductInfo.size()) //if outductIndex is UINT64_MAX then bundle needs stored
+        && m_vectorOutductInfo[toStorageHeader.outductIndex]->linkIsUp)
+    {
+        //force natural/64-bit alignment
+        hdtn::StorageAckHdr* storageAckHdr = new hdtn::StorageAckHdr(storageAck);
+        zmq::message_t zmqMessageStorageAckHdrWithDataStolen(storageAckHdr, sizeof(hdtn::StorageAckHdr), CustomCleanupStorageAckHdr, storageAckHdr);
+        OutductInfo_t& info = *(m_vectorOutductInfo[toStorageHeader.outductIndex]);
+        info.cutThroughQueue.emplace(std::move(zmqBundleDataReceived),
+            std::move(zmqMessageStorageAckHdrWithDataStolen), toStorageHeader.finalDestEid, toStorageHeader.ingressUniqueId);
+        return false;
+    }
+    //storageStats.inBytes += zmqBundleDataReceived.size();
+
+    cbhe_eid_t finalDestEidReturnedFromWrite;
+    const bool isCertainThatThisBundleHasNoCustodyOrIsNotAdminRecord = (toStorageHeader.isCustodyOrAdminRecord == 0);
+    cbhe_eid_t finalDestEidMask = toStorageHeader.finalDestEid;
+    Write(&zmqBundleDataReceived, finalDestEidReturnedFromWrite, false, isCertainThatThisBundleHasNoCustodyOrIsNotAdminRecord, &finalDestEidMask);
+
+    //storageAck.finalDestEid = finalDestEidReturnedFromWrite; //no longer needed as ingress decodes that
+    return true;
+}
+
+bool ZmqStorageInterface::Impl::SendStoredBundleToEgress(const uint64_t nextHopNodeId, const uint64_t outductIndex, const cbhe_eid_t& finalDestEid,
+    const bool hasCustody, const uint64_t custodyId, zmq::message_t&& zmqBundleDataMessage)
+{
     //force natural/64-bit alignment
     hdtn::ToEgressHdr * toEgressHdr = new hdtn::ToEgressHdr();
     zmq::message_t zmqMessageToEgressHdrWithDataStolen(toEgressHdr, sizeof(hdtn::ToEgressHdr), CustomCleanupToEgressHdr, toEgressHdr);
@@ -954,29 +1245,344 @@ bool ZmqStorageInterface::Impl::ReleaseOne_NoBlock(const OutductInfo_t& info, co
     //memset 0 not needed because all values set below
     toEgressHdr->base.type = HDTN_MSGTYPE_EGRESS;
     toEgressHdr->base.flags = 0;
-    toEgressHdr->nextHopNodeId = info.nextHopNodeId;
-    toEgressHdr->finalDestEid = m_sessionRead.catalogEntryPtr->destEid;
-    toEgressHdr->hasCustody = m_sessionRead.catalogEntryPtr->HasCustody();
+    toEgressHdr->nextHopNodeId = nextHopNodeId;
+    toEgressHdr->finalDestEid = finalDestEid;
+    toEgressHdr->hasCustody = hasCustody;
     toEgressHdr->isCutThroughFromStorage = 0;
-    toEgressHdr->custodyId = m_sessionRead.custodyId;
-    toEgressHdr->outductIndex = info.outductIndex;
+    toEgressHdr->custodyId = custodyId;
+    toEgressHdr->outductIndex = outductIndex;
     
+    if (m_inprocBundleRingsPtr) {
+        if (!PushToEgressRing(*toEgressHdr, zmqBundleDataMessage)) {
+            LOG_ERROR(subprocess) << "could not push bundle to the egress ring";
+            return false;
+        }
+        return true;
+    }
     if (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(zmqMessageToEgressHdrWithDataStolen), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
         LOG_ERROR(subprocess) << "zmq could not send";
-        m_bsmPtr->ReturnTop(m_sessionRead);
         return false;
     }
-    if (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(zmqBundleDataMessageWithDataStolen), zmq::send_flags::dontwait)) {
+    if (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(zmqBundleDataMessage), zmq::send_flags::dontwait)) {
         LOG_ERROR(subprocess) << "zmq could not send bundle";
-        m_bsmPtr->ReturnTop(m_sessionRead);
         return false;
     }
+    return true;
+}
 
-    returnedBundleSize = bytesToReadFromDisk;
+
+//Send the oldest preloaded bundle of the outduct.  Like ReleaseOne_NoBlock, on success m_sessionRead
+//holds the custody id and catalog entry of the bundle that was sent.
+bool ZmqStorageInterface::Impl::ReleasePreloadedOne_NoBlock(OutductInfo_t& info, const uint64_t maxBundleSizeToRead, uint64_t& returnedBundleSize)
+{
+    PreloadedBundle& pb = info.preloadedBundles.front();
+    if (pb.bundleSizeBytes > maxBundleSizeToRead) {
+        return false; //too large right now, keep it first in line
+    }
+    catalog_entry_t* catalogEntryPtr = m_bsmPtr->GetCatalogEntryPtrFromCustodyId(pb.custodyId);
+    if (catalogEntryPtr == NULL) {
+        LOG_ERROR(subprocess) << "preloaded custody id " << pb.custodyId << " is no longer in the storage catalog";
+        m_mapPreloadedCustodyIdToOutductInfo.erase(pb.custodyId);
+        info.preloadedBytes -= pb.bundleSizeBytes;
+        info.preloadedBundles.pop_front();
+        return false;
+    }
+
+    padded_vector_uint8_t* vecUint8BundleDataRawPointer = pb.bundleDataPtr.release();
+    zmq::message_t zmqBundleDataMessageWithDataStolen(vecUint8BundleDataRawPointer->data(), vecUint8BundleDataRawPointer->size(), CustomCleanupPaddedVecUint8, vecUint8BundleDataRawPointer);
+    const uint64_t custodyId = pb.custodyId;
+    const uint64_t bundleSizeBytes = pb.bundleSizeBytes;
+    m_mapPreloadedCustodyIdToOutductInfo.erase(custodyId);
+    info.preloadedBytes -= bundleSizeBytes;
+    info.preloadedBundles.pop_front();
+
+    if (!SendStoredBundleToEgress(info.nextHopNodeId, info.outductIndex, catalogEntryPtr->destEid,
+        catalogEntryPtr->HasCustody(), custodyId, std::move(zmqBundleDataMessageWithDataStolen)))
+    {
+        LOG_ERROR(subprocess) << "zmq could not send preloaded bundle";
+        m_bsmPtr->ReturnCustodyIdToAwaitingSend(custodyId); //read it from disk again later
+        return false;
+    }
+
+    m_sessionRead.catalogEntryPtr = catalogEntryPtr;
+    m_sessionRead.custodyId = custodyId;
+    returnedBundleSize = bundleSizeBytes;
+    return true;
+}
+
+//Pop the outduct's next bundles from awaiting send and read them from disk into RAM (up to preloadMaxBytesPerOutduct)
+//so that the first seconds of its upcoming contact are not spent waiting on disk reads.
+void ZmqStorageInterface::Impl::PreloadOutduct(OutductInfo_t& info) {
+    const uint64_t maxBytes = m_hdtnConfig.m_storageConfig.m_preloadMaxBytesPerOutduct;
+    if (info.linkIsUp || (info.destinationGroupId == UINT64_MAX)) {
+        return;
+    }
+    std::size_t numPreloaded = 0;
+    while (info.preloadedBytes < maxBytes) {
+        const uint64_t bytesToReadFromDisk = m_bsmPtr->PopTop(m_sessionRead, info.destinationGroupId);
+        if (bytesToReadFromDisk == 0) { //nothing more for this outduct
+            break;
+        }
+        if ((info.preloadedBytes + bytesToReadFromDisk) > maxBytes) {
+            m_bsmPtr->ReturnTop(m_sessionRead);
+            break;
+        }
+        std::unique_ptr<padded_vector_uint8_t> bundleDataPtr = boost::make_unique<padded_vector_uint8_t>();
+        if (!m_bsmPtr->ReadAllSegments(m_sessionRead, *bundleDataPtr)) {
+            LOG_ERROR(subprocess) << "unable to read all segments from disk while preloading";
+            m_bsmPtr->ReturnTop(m_sessionRead);
+            break;
+        }
+        info.preloadedBundles.emplace_back(m_sessionRead.custodyId, bytesToReadFromDisk, std::move(bundleDataPtr));
+        m_mapPreloadedCustodyIdToOutductInfo[m_sessionRead.custodyId] = &info;
+        info.preloadedBytes += bytesToReadFromDisk;
+        ++numPreloaded;
+    }
+    if (!info.preloadedBundles.empty()) {
+        m_hasPreloadedBundles = true;
+        //give the contact twice the lead time to begin
+        info.preloadExpiry = boost::posix_time::microsec_clock::universal_time()
+            + boost::posix_time::seconds(2 * m_hdtnConfig.m_storageConfig.m_preloadSecondsBeforeContact);
+    }
+    LOG_INFO(subprocess) << "preloaded " << numPreloaded << " bundles (" << info.preloadedBundles.size() << " bundles, "
+        << info.preloadedBytes << " bytes total) for nextHopNodeId " << info.nextHopNodeId;
+}
+
+void ZmqStorageInterface::Impl::ReturnPreloadedBundles(OutductInfo_t& info) {
+    //return newest first so that the oldest ends up back in front of its queue
+    while (!info.preloadedBundles.empty()) {
+        const PreloadedBundle& pb = info.preloadedBundles.back();
+        if (!m_bsmPtr->ReturnCustodyIdToAwaitingSend(pb.custodyId)) {
+            LOG_ERROR(subprocess) << "unable to return preloaded custody id " << pb.custodyId << " to the awaiting send";
+        }
+        m_mapPreloadedCustodyIdToOutductInfo.erase(pb.custodyId);
+        info.preloadedBundles.pop_back();
+    }
+    info.preloadedBytes = 0;
+}
+
+//Forget a preloaded bundle that is being removed from storage.  It was popped from awaiting send,
+//so only its preload queue entry holds it.
+void ZmqStorageInterface::Impl::DropPreloadedBundle(const uint64_t custodyId) {
+    std::unordered_map<uint64_t, OutductInfo_t*>::iterator it = m_mapPreloadedCustodyIdToOutductInfo.find(custodyId);
+    if (it == m_mapPreloadedCustodyIdToOutductInfo.end()) {
+        return;
+    }
+    OutductInfo_t& info = *(it->second);
+    m_mapPreloadedCustodyIdToOutductInfo.erase(it);
+    for (preloaded_bundles_queue_t::iterator pbIt = info.preloadedBundles.begin(); pbIt != info.preloadedBundles.end(); ++pbIt) {
+        if (pbIt->custodyId == custodyId) {
+            info.preloadedBytes -= pbIt->bundleSizeBytes;
+            info.preloadedBundles.erase(pbIt);
+            return;
+        }
+    }
+}
+
+void ZmqStorageInterface::Impl::ReturnExpiredPreloadedBundles(const boost::posix_time::ptime& nowPtime) {
+    m_hasPreloadedBundles = false;
+    for (std::size_t i = 0; i < m_vectorOutductInfo.size(); ++i) {
+        OutductInfo_t& info = *(m_vectorOutductInfo[i]);
+        if (!info.preloadedBundles.empty()) {
+            if ((!info.linkIsUp) && (info.preloadExpiry <= nowPtime)) {
+                LOG_INFO(subprocess) << "contact for nextHopNodeId " << info.nextHopNodeId << " did not begin, returning "
+                    << info.preloadedBundles.size() << " preloaded bundles to storage";
+                ReturnPreloadedBundles(info);
+            }
+            else {
+                m_hasPreloadedBundles = true;
+            }
+        }
+    }
+}
+
+static const std::string RELEASE_WORKERS_TO_STORAGE_INPROC_PATH("inproc://release_workers_to_storage");
+
+bool ZmqStorageInterface::Impl::StartReleaseWorkers(const unsigned int numReleaseWorkers) {
+    try {
+        m_zmqPullSock_releaseWorkersToStoragePtr = boost::make_unique<zmq::socket_t>(*m_zmqContextPtr, zmq::socket_type::pull);
+        m_zmqPullSock_releaseWorkersToStoragePtr->bind(RELEASE_WORKERS_TO_STORAGE_INPROC_PATH);
+        m_releaseWorkersVec.resize(numReleaseWorkers);
+        for (unsigned int i = 0; i < numReleaseWorkers; ++i) {
+            m_releaseWorkersVec[i] = boost::make_unique<ReleaseWorker>();
+            ReleaseWorker& releaseWorker = *m_releaseWorkersVec[i];
+            releaseWorker.zmqPushSock_releaseWorkerToStoragePtr = boost::make_unique<zmq::socket_t>(*m_zmqContextPtr, zmq::socket_type::push);
+            releaseWorker.zmqPushSock_releaseWorkerToStoragePtr->set(zmq::sockopt::linger, 0);
+            releaseWorker.zmqPushSock_releaseWorkerToStoragePtr->set(zmq::sockopt::sndtimeo, static_cast<int>(DEFAULT_BIG_TIMEOUT_POLL)); //so that a stopping worker never blocks
+            releaseWorker.zmqPushSock_releaseWorkerToStoragePtr->connect(RELEASE_WORKERS_TO_STORAGE_INPROC_PATH);
+        }
+    }
+    catch (const zmq::error_t& ex) {
+        LOG_ERROR(subprocess) << "cannot create release worker sockets (bundles will be read from disk by the storage thread): " << ex.what();
+        m_releaseWorkersVec.clear();
+        m_zmqPullSock_releaseWorkersToStoragePtr.reset();
+        return false;
+    }
+    m_releaseWorkersRunning = true;
+    for (unsigned int i = 0; i < numReleaseWorkers; ++i) {
+        m_releaseWorkersVec[i]->threadPtr = boost::make_unique<boost::thread>(
+            boost::bind(&ZmqStorageInterface::Impl::ReleaseWorkerThreadFunc, this, m_releaseWorkersVec[i].get(), i));
+    }
+    LOG_INFO(subprocess) << "started " << numReleaseWorkers << " release worker threads";
     return true;
+}
 
+void ZmqStorageInterface::Impl::StopReleaseWorkers() {
+    m_releaseWorkersRunning = false; //thread stopping criteria
+    for (std::size_t i = 0; i < m_releaseWorkersVec.size(); ++i) {
+        ReleaseWorker& releaseWorker = *m_releaseWorkersVec[i];
+        //lock then unlock the worker's mutex to prevent a missed notify after setting the stopping criteria above
+        releaseWorker.mutex.lock();
+        releaseWorker.mutex.unlock();
+        releaseWorker.conditionVariable.notify_one();
+    }
+    for (std::size_t i = 0; i < m_releaseWorkersVec.size(); ++i) {
+        ReleaseWorker& releaseWorker = *m_releaseWorkersVec[i];
+        if (releaseWorker.threadPtr) {
+            try {
+                releaseWorker.threadPtr->join();
+                releaseWorker.threadPtr.reset();
+            }
+            catch (boost::thread_resource_error& e) {
+                LOG_ERROR(subprocess) << "error stopping release worker thread: " << e.what();
+            }
+        }
+    }
+    m_releaseWorkersVec.clear(); //closes the push sockets
+    m_zmqPullSock_releaseWorkersToStoragePtr.reset();
+    m_mapReleaseWorkerCustodyIdToRemoveWhenRead.clear();
 }
 
+//Read from disk the bundles released to this worker's outducts (in the order they were released) and
+//return each one to the storage thread, which sends it to egress.  Reads of different workers proceed in parallel.
+void ZmqStorageInterface::Impl::ReleaseWorkerThreadFunc(ReleaseWorker* releaseWorkerPtr, const unsigned int releaseWorkerIndex) {
+    ThreadNamer::SetThisThreadName("StorageRelease" + boost::lexical_cast<std::string>(releaseWorkerIndex));
+    ReleaseWorker& releaseWorker = *releaseWorkerPtr;
+    zmq::socket_t& pushSock = *releaseWorker.zmqPushSock_releaseWorkerToStoragePtr;
+    ReleaseJob job;
+    while (true) {
+        {
+            boost::mutex::scoped_lock lock(releaseWorker.mutex);
+            while (releaseWorker.jobs.empty() && m_releaseWorkersRunning.load(std::memory_order_acquire)) { //lock mutex (above) before checking condition
+                releaseWorker.conditionVariable.wait(lock);
+            }
+            if (!m_releaseWorkersRunning.load(std::memory_order_acquire)) {
+                break;
+            }
+            job = std::move(releaseWorker.jobs.front());
+            releaseWorker.jobs.pop_front();
+        }
+
+        releaseWorker.sessionRead.catalogEntryPtr = &job.catalogEntry;
+        releaseWorker.sessionRead.custodyId = job.custodyId;
+        //the disk threads read straight into the buffer that egress sends from
+        release_buffer_t* releaseBufferRawPointer = m_releaseBufferPoolPtr->Acquire(job.catalogEntry.bundleSizeBytes);
+        bool successReadAllSegments = false;
+        zmq::message_t zmqBundleDataMessageWithDataStolen;
+        if (releaseBufferRawPointer == NULL) {
+            LOG_ERROR(subprocess) << "release worker " << releaseWorkerIndex << " unable to allocate " << job.catalogEntry.bundleSizeBytes << " bytes";
+        }
+        else {
+            successReadAllSegments = m_bsmPtr->ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe(releaseWorker.sessionRead, *releaseBufferRawPointer);
+            zmqBundleDataMessageWithDataStolen.rebuild(releaseBufferRawPointer->data, releaseBufferRawPointer->size, ReleaseBufferPool::ZmqFreeCallback, releaseBufferRawPointer);
+        }
+
+        ReleaseWorkerResultHdr resultHdr;
+        resultHdr.finalDestEid = job.catalogEntry.destEid;
+        resultHdr.custodyId = job.custodyId;
+        resultHdr.outductIndex = job.outductIndex;
+        resultHdr.nextHopNodeId = job.nextHopNodeId;
+        resultHdr.bundleSizeBytes = job.catalogEntry.bundleSizeBytes;
+        resultHdr.hasCustody = job.catalogEntry.HasCustody();
+        resultHdr.success = successReadAllSegments;
+        if ((!pushSock.send(zmq::const_buffer(&resultHdr, sizeof(resultHdr)), zmq::send_flags::sndmore))
+            || (!pushSock.send(std::move(zmqBundleDataMessageWithDataStolen), zmq::send_flags::none)))
+        {
+            LOG_ERROR(subprocess) << "release worker " << releaseWorkerIndex << " could not return custody id " << job.custodyId << " to the storage thread";
+        }
+    }
+}
+
+//Receive one bundle read by a release worker (without blocking) and send it to egress, or if it can't be sent,
+//undo what SendFromStorage counted when the bundle was handed to the worker.
+//Returns false if no bundle was waiting.
+bool ZmqStorageInterface::Impl::HandleReleaseWorkerResult() {
+    ReleaseWorkerResultHdr resultHdr;
+    const zmq::recv_buffer_result_t res = m_zmqPullSock_releaseWorkersToStoragePtr->recv(zmq::mutable_buffer(&resultHdr, sizeof(resultHdr)), zmq::recv_flags::dontwait);
+    if (!res) {
+        return false;
+    }
+    zmq::message_t zmqBundleDataReceived;
+    if ((res->truncated()) || (res->size != sizeof(resultHdr)) || (!m_zmqPullSock_releaseWorkersToStoragePtr->recv(zmqBundleDataReceived, zmq::recv_flags::none))) {
+        LOG_ERROR(subprocess) << "invalid message received from a release worker";
+        return true;
+    }
+
+    bool removeWhenRead = false;
+    std::unordered_map<uint64_t, bool>::iterator itRemove = m_mapReleaseWorkerCustodyIdToRemoveWhenRead.find(resultHdr.custodyId);
+    if (itRemove != m_mapReleaseWorkerCustodyIdToRemoveWhenRead.end()) {
+        removeWhenRead = itRemove->second;
+        m_mapReleaseWorkerCustodyIdToRemoveWhenRead.erase(itRemove);
+    }
+    OutductInfo_t* outductInfoRawPtr = GetOutductInfo(resultHdr.outductIndex, resultHdr.nextHopNodeId);
+    if ((!removeWhenRead) && resultHdr.success && outductInfoRawPtr && outductInfoRawPtr->linkIsUp
+        && SendStoredBundleToEgress(resultHdr.nextHopNodeId, resultHdr.outductIndex, resultHdr.finalDestEid,
+            resultHdr.hasCustody, resultHdr.custodyId, std::move(zmqBundleDataReceived)))
+    {
+        return true;
+    }
+
+    if (outductInfoRawPtr) {
+        custodyid_to_size_map_t& mapCustodyIdToSize = outductInfoRawPtr->mapOpenCustodyIdToBundleSizeBytes;
+        custodyid_to_size_map_t::iterator it = mapCustodyIdToSize.find(resultHdr.custodyId);
+        if (it != mapCustodyIdToSize.end()) {
+            outductInfoRawPtr->bytesInPipeline -= it->second;
+            mapCustodyIdToSize.erase(it);
+        }
+    }
+    m_custodyIdsWaitingTimerStart.erase(resultHdr.custodyId);
+    --m_telem.m_totalBundlesSentToEgressFromStorageReadFromDisk;
+    m_telem.m_totalBundleBytesSentToEgressFromStorageReadFromDisk -= resultHdr.bundleSizeBytes;
+    if (removeWhenRead) {
+        const catalog_entry_t* catalogEntryPtr = m_bsmPtr->GetCatalogEntryPtrFromCustodyId(resultHdr.custodyId);
+        if ((catalogEntryPtr == NULL) || (!m_bsmPtr->RemoveBundleFromDisk(catalogEntryPtr, resultHdr.custodyId))) {
+            LOG_ERROR(subprocess) << "error removing custody id " << resultHdr.custodyId << " from disk after its release worker read";
+        }
+        m_custodyIdAllocatorPtr->FreeCustodyId(resultHdr.custodyId);
+    }
+    else {
+        if (!resultHdr.success) {
+            LOG_ERROR(subprocess) << "unable to read all segments from disk";
+        }
+        if (!m_bsmPtr->ReturnCustodyIdToAwaitingSend(resultHdr.custodyId)) {
+            LOG_ERROR(subprocess) << "error returning custody id " << resultHdr.custodyId << " to awaiting send";
+        }
+    }
+    return true;
+}
+
+//Remove a bundle from disk and free its custody id.
+//A bundle being read by a release worker must keep its segments until the read completes, and it also keeps its custody id,
+//since a freed custody id could be allocated to a new bundle that the deferred removal would then remove.
+//For the same reason a preloaded bundle is dropped from its preload queue before its custody id is freed.
+bool ZmqStorageInterface::Impl::RemoveBundleFromDiskOrDeferUntilRead(const catalog_entry_t* catalogEntryPtr, const uint64_t custodyId) {
+    DropPreloadedBundle(custodyId);
+    std::unordered_map<uint64_t, bool>::iterator it = m_mapReleaseWorkerCustodyIdToRemoveWhenRead.find(custodyId);
+    if (it != m_mapReleaseWorkerCustodyIdToRemoveWhenRead.end()) {
+        it->second = true; //removed and freed by HandleReleaseWorkerResult
+        return true;
+    }
+    m_custodyIdAllocatorPtr->FreeCustodyId(custodyId);
+    return m_bsmPtr->RemoveBundleFromDisk(catalogEntryPtr, custodyId);
+}
+
+ZmqStorageInterface::Impl::OutductInfo_t* ZmqStorageInterface::Impl::GetOutductInfo(const uint64_t outductIndex, const uint64_t nextHopNodeId) {
+    if (outductIndex == UINT64_MAX) { //opportunistic link
+        std::map<uint64_t, OutductInfoPtr_t>::iterator it = m_mapOpportunisticNextHopNodeIdToOutductInfo.find(nextHopNodeId);
+        return (it == m_mapOpportunisticNextHopNodeIdToOutductInfo.end()) ? NULL : it->second.get();
+    }
+    return (outductIndex < m_vectorOutductInfo.size()) ? m_vectorOutductInfo[outductIndex].get() : NULL;
+}
 
 std::ostream& operator<<(std::ostream& os, const ZmqStorageInterface::Impl::OutductInfo_t& o) {
     os << "Currently " << ((o.linkIsUp) ? "" : "NOT")
@@ -1024,6 +1630,7 @@ std::string ZmqStorageInterface::Impl::SprintCustodyidToSizeMap(const custodyid_
 }
 
 void ZmqStorageInterface::Impl::SetLinkDown(OutductInfo_t & info) {
+    ReturnPreloadedBundles(info);
     if (info.linkIsUp) {
         info.linkIsUp = false;
         if (!info.cutThroughQueue.empty()) {
@@ -1058,6 +1665,9 @@ void ZmqStorageInterface::Impl::SyncTelemetry() {
 
         m_telem.m_usedSpaceBytes = m_bsmPtr->GetUsedSpaceBytes();
         m_telem.m_freeSpaceBytes = m_bsmPtr->GetFreeSpaceBytes();
+        m_telem.m_totalBytesReclaimedFromDisk = m_bsmPtr->GetTotalBytesReclaimedFromDisk();
+        m_telem.m_totalDiskSpaceReclaimOperations = m_bsmPtr->GetTotalDiskSpaceReclaimOperations();
+        m_telem.m_diskThroughputBytesPerSecondVec = m_bsmPtr->GetDiskThroughputBytesPerSecond();
     }
 }
 
@@ -1139,9 +1749,7 @@ void ZmqStorageInterface::Impl::DeleteBundleById(const uint64_t custodyId) {
         }
     }
 
-    m_custodyIdAllocatorPtr->FreeCustodyId(custodyId);
-
-    bool success = m_bsmPtr->RemoveBundleFromDisk(entry, custodyId);
+    bool success = RemoveBundleFromDiskOrDeferUntilRead(entry, custodyId);
     if (!success) {
         LOG_ERROR(subprocess) << "Failed to remove bundle from disk " << custodyId << " while deleting for expiry";
     }
@@ -1151,9 +1759,8 @@ void ZmqStorageInterface::Impl::DeleteBundleById(const uint64_t custodyId) {
  *
  * Deletes expired bundles from disk per storage deletion policy.
  *
- * If storage is less full than DELETE_ALL_EXPIRED_THRESHOLD, then at most
- * MAX_DELETE_EXPIRED_PER_ITER bundles are deleted. Otherwise, all expired
- * bundles are deleted. (Avoid blocking event loop unless full).
+ * Expired bundles are found through the catalog's expiry timing wheel
+ * (O(1) per bundle), so all expired bundles are deleted in one pass.
  *
  */
 void ZmqStorageInterface::Impl::DeleteExpiredBundles(const boost::posix_time::ptime& nowPtime, float storageUsagePercentage) {
@@ -1168,12 +1775,9 @@ void ZmqStorageInterface::Impl::DeleteExpiredBundles(const boost::posix_time::pt
 
     // If we reach here then either storage is full or policy == "on_expiration"
 
-    uint64_t numToDelete = storageUsagePercentage >= DELETE_ALL_EXPIRED_THRESHOLD ?
-        0 : MAX_DELETE_EXPIRED_PER_ITER;
-
     uint64_t expiry = TimestampUtil::GetSecondsSinceEpochRfc5050(nowPtime);
 
-    m_bsmPtr->GetExpiredBundleIds(expiry, numToDelete, m_expiredIds);
+    m_bsmPtr->GetExpiredBundleIds(expiry, 0, m_expiredIds);
 
     for(uint64_t custodyId : m_expiredIds) {
         DeleteBundleById(custodyId);
@@ -1198,6 +1802,8 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
     static const boost::posix_time::time_duration ACS_SEND_PERIOD = boost::posix_time::milliseconds(m_hdtnConfig.m_acsSendPeriodMilliseconds);
     m_ctmPtr = boost::make_unique<CustodyTransferManager>(IS_HDTN_ACS_AWARE, M_HDTN_EID_CUSTODY.nodeId, M_HDTN_EID_CUSTODY.serviceId);
     LOG_INFO(subprocess) << "Worker thread starting up.";
+    std::vector<hdtn::ToStorageHdr> toStorageHdrsBatch;
+    std::vector<hdtn::StorageAckHdr> storageAcksBatch; //acked together in one message
 
    
 
@@ -1211,11 +1817,33 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
         LOG_INFO(subprocess) << "[ZmqStorageInterface] Initializing BundleStorageManagerAsio ... ";
         m_bsmPtr = boost::make_unique<BundleStorageManagerAsio>(std::make_shared<StorageConfig>(m_hdtnConfig.m_storageConfig));
     }
+    else if (m_hdtnConfig.m_storageConfig.m_storageImplementation == "io_uring_single_threaded") {
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+        LOG_INFO(subprocess) << "[ZmqStorageInterface] Initializing BundleStorageManagerIoUring ... ";
+        m_bsmPtr = boost::make_unique<BundleStorageManagerIoUring>(std::make_shared<StorageConfig>(m_hdtnConfig.m_storageConfig));
+#else
+        LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc: storage implementation io_uring_single_threaded "
+            << "requires HDTN to be built with ENABLE_STORAGE_IO_URING";
+        return;
+#endif
+    }
+    else if (m_hdtnConfig.m_storageConfig.m_storageImplementation == "ram") {
+        LOG_INFO(subprocess) << "[ZmqStorageInterface] Initializing BundleStorageManagerRam ... ";
+        m_bsmPtr = boost::make_unique<BundleStorageManagerRam>(std::make_shared<StorageConfig>(m_hdtnConfig.m_storageConfig));
+    }
     else {
         LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc: invalid storage implementation " << m_hdtnConfig.m_storageConfig.m_storageImplementation;
         return;
     }
+    if (!m_bsmPtr->HasValidStorageConfig()) {
+        LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc: unable to initialize storage";
+        return;
+    }
     m_bsmPtr->Start();
+    m_releaseBufferPoolPtr = ReleaseBufferPool::Create(RELEASE_BUFFER_POOL_MAX_FREE_BYTES);
+    if (m_hdtnConfig.m_storageConfig.m_numReleaseWorkerThreads) {
+        StartReleaseWorkers(static_cast<unsigned int>(m_hdtnConfig.m_storageConfig.m_numReleaseWorkerThreads));
+    }
     
 
     
@@ -1232,15 +1860,25 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
     bool egressFullyInitialized = false;
 
 
-    zmq::pollitem_t pollItems[4] = {
+    std::vector<zmq::pollitem_t> pollItems = {
         {m_zmqPullSock_boundEgressToConnectingStoragePtr->handle(), 0, ZMQ_POLLIN, 0},
         {m_zmqPullSock_boundIngressToConnectingStoragePtr->handle(), 0, ZMQ_POLLIN, 0},
         {m_zmqSubSock_boundReleaseToConnectingStoragePtr->handle(), 0, ZMQ_POLLIN, 0},
-        {m_zmqRepSock_connectingTelemToFromBoundStoragePtr->handle(), 0, ZMQ_POLLIN, 0},
+        {m_zmqRepSock_connectingTelemToFromBoundStoragePtr->handle(), 0, ZMQ_POLLIN, 0}
     };
+    const bool hasReleaseWorkersPollItem = (m_zmqPullSock_releaseWorkersToStoragePtr.get() != NULL);
+    if (hasReleaseWorkersPollItem) {
+        pollItems.push_back({m_zmqPullSock_releaseWorkersToStoragePtr->handle(), 0, ZMQ_POLLIN, 0});
+    }
+    //the inproc bundle rings of the ingress producer threads (if used) are polled by their wakeup file descriptors after the sockets
+    const unsigned int numIngressRings = (m_inprocBundleRingsPtr) ? m_inprocBundleRingsPtr->ingressToStorageRings.GetNumRings() : 0;
+    for (unsigned int ringIndex = 0; ringIndex < numIngressRings; ++ringIndex) {
+        pollItems.push_back({NULL, m_inprocBundleRingsPtr->ingressToStorageRings.GetRing(ringIndex).GetPollFd(), ZMQ_POLLIN, 0});
+    }
     long timeoutPoll = DEFAULT_BIG_TIMEOUT_POLL; //0 => no blocking
     boost::posix_time::ptime acsSendNowExpiry = boost::posix_time::microsec_clock::universal_time() + ACS_SEND_PERIOD;
     boost::posix_time::ptime tryDeleteTime = boost::posix_time::microsec_clock::universal_time();
+    std::vector<uint64_t> expiredCustodyIdsVec; //reused by every pass over the custody timers
 
     //notify Init function that worker thread startup is complete
     m_workerThreadStartupMutex.lock();
@@ -1250,13 +1888,22 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
 
     while (m_running.load(std::memory_order_acquire)) {
         int rc = 0;
+        long thisTimeoutPoll = timeoutPoll;
+        for (unsigned int ringIndex = 0; ringIndex < numIngressRings; ++ringIndex) {
+            if (!m_inprocBundleRingsPtr->ingressToStorageRings.GetRing(ringIndex).PrepareToWait()) { //not empty
+                thisTimeoutPoll = 0;
+            }
+        }
         try {
-            rc = zmq::poll(pollItems, 4, timeoutPoll);
+            rc = zmq::poll(pollItems.data(), pollItems.size(), thisTimeoutPoll);
         }
         catch (zmq::error_t & e) {
             LOG_ERROR(subprocess) << "caught zmq::error_t in hdtn::ZmqStorageInterface::ThreadFunc: " << e.what();
             continue;
         }
+        if (numIngressRings) {
+            PopFromIngressRings(storageAcksBatch);
+        }
         if (rc > 0) {            
             if (pollItems[0].revents & ZMQ_POLLIN) { //from egress sock
                 hdtn::EgressAckHdr egressAckHdr;
@@ -1489,6 +2136,7 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
                                     const eid_plus_isanyserviceid_pair_t key(cbhe_eid_t(nodeId, 0), true); //true => any service id.. 0 is don't care
                                     outductInfo.eidVec.push_back(key);
                                 }
+                                SetDestinationGroup(outductInfo);
                             }
                             
 
@@ -1531,94 +2179,48 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
                 if (!res) {
                     LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) message hdr not received";
                 }
-                else if ((res->truncated()) || (res->size != sizeof(hdtn::ToStorageHdr))) {
-                    LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) rhdr.size() != sizeof(hdtn::ToStorageHdr)";
-                }
-                else if (toStorageHeader.base.type == HDTN_MSGTYPE_STORAGE_ADD_OPPORTUNISTIC_LINK) {
-                    const uint64_t nodeId = toStorageHeader.ingressUniqueId;
-                    
-                    std::pair<std::map<uint64_t, OutductInfoPtr_t>::iterator, bool> ret = m_mapOpportunisticNextHopNodeIdToOutductInfo.
-#if (__cplusplus >= 201703L) //try_emplace would be most ideal so it doesnt create and destroy element if exists
-                        try_emplace( 
-#else
-                        emplace(
-#endif
-                    nodeId, boost::make_unique<OutductInfo_t>());
-                    //(true if insertion happened, false if it did not).
-                    if (ret.second) {
-                        OutductInfo_t& info = *(ret.first->second);
-                        info.eidVec.resize(1);
-                        const eid_plus_isanyserviceid_pair_t key(cbhe_eid_t(nodeId, 0), true); //true => any service id.. 0 is don't care
-                        info.eidVec[0] = key;
-                        info.nextHopNodeId = nodeId;
-                        info.linkIsUp = true;
-                        info.outductIndex = UINT64_MAX;
-                        info.halfOfMaxBundlesInPipeline_StorageToEgressPath = 5; //TODO
-                        info.halfOfMaxBundleSizeBytesInPipeline_StorageToEgressPath = info.halfOfMaxBundlesInPipeline_StorageToEgressPath * m_hdtnConfig.m_maxBundleSizeBytes;
-                        RepopulateUpLinksVec();
-                        LOG_INFO(subprocess) << "Adding Opportunistic link from ingress connection.. " << info;
+                else if ((res->size == sizeof(hdtn::BatchHdr)) && (toStorageHeader.base.type == HDTN_MSGTYPE_STORE_BATCH)) {
+                    hdtn::BatchHdr batchHdr;
+                    memcpy(&batchHdr, &toStorageHeader, sizeof(hdtn::BatchHdr));
+                    storageAcksBatch.clear();
+                    if (!hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::ReceiveHeaders(*m_zmqPullSock_boundIngressToConnectingStoragePtr, batchHdr, toStorageHdrsBatch)) {
+                        LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) cannot read the "
+                            << batchHdr.numMessages << " ToStorageHdr of a bundle batch";
+                        hdtn::ModuleBusBatcher<hdtn::ToStorageHdr>::DiscardRemainingParts(*m_zmqPullSock_boundIngressToConnectingStoragePtr);
+                        toStorageHdrsBatch.clear();
                     }
-                    else {
-                        LOG_ERROR(subprocess) << "Ignoring Duplicate Message for adding Opportunistic link from ingress connection.. ";
+                    for (std::size_t i = 0; i < toStorageHdrsBatch.size(); ++i) {
+                        zmq::message_t zmqBundleDataReceived;
+                        storageAcksBatch.emplace_back();
+                        //message guaranteed to be there due to the zmq::send_flags::sndmore
+                        if (!m_zmqPullSock_boundIngressToConnectingStoragePtr->recv(zmqBundleDataReceived, zmq::recv_flags::none)) {
+                            LOG_ERROR(subprocess) << "hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) bundle " << i << " of a bundle batch not received";
+                            storageAcksBatch.pop_back();
+                            break;
+                        }
+                        if (!StoreBundleFromIngress(toStorageHdrsBatch[i], zmqBundleDataReceived, storageAcksBatch.back())) {
+                            storageAcksBatch.pop_back(); //acked later from the cut-through queue
+                        }
                     }
+                    SendStorageAcksToIngress(storageAcksBatch);
                 }
-                else if (toStorageHeader.base.type == HDTN_MSGTYPE_STORAGE_REMOVE_OPPORTUNISTIC_LINK) {
-                    const uint64_t nodeId = toStorageHeader.ingressUniqueId;
-                    const bool wasErased = (m_mapOpportunisticNextHopNodeIdToOutductInfo.erase(nodeId) == 1);
-                    if (wasErased) {
-                        RepopulateUpLinksVec();
-                    }
-                    LOG_INFO(subprocess) << "Removing Opportunistic link from ingress connection.. finalDestEid ("
-                        << Uri::GetIpnUriStringAnyServiceNumber(nodeId)
-                        << ") will " << ((wasErased) ? "STOP" : "REMAIN STOPPED FROM") << " being released from storage";
+                else if ((res->truncated()) || (res->size != sizeof(hdtn::ToStorageHdr))) {
+                    LOG_ERROR(subprocess) << "error in hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) rhdr.size() != sizeof(hdtn::ToStorageHdr)";
                 }
-                else if (toStorageHeader.base.type == HDTN_MSGTYPE_STORE) {
-                    //storageStats.inBytes += sizeof(hdtn::ToStorageHdr);
-                    //++storageStats.inMsg;
-
-                    zmq::message_t zmqBundleDataReceived;
-                    if (!m_zmqPullSock_boundIngressToConnectingStoragePtr->recv(zmqBundleDataReceived, zmq::recv_flags::none)) {
+                else {
+                    zmq::message_t zmqBundleDataReceived; //empty unless a bundle to store
+                    hdtn::StorageAckHdr storageAck;
+                    //message guaranteed to be there due to the zmq::send_flags::sndmore
+                    if ((toStorageHeader.base.type == HDTN_MSGTYPE_STORE) && (!m_zmqPullSock_boundIngressToConnectingStoragePtr->recv(zmqBundleDataReceived, zmq::recv_flags::none))) {
                         LOG_ERROR(subprocess) << "hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) message not received";
                     }
-                    else {
+                    else if (HandleToStorageMessage(toStorageHeader, zmqBundleDataReceived, storageAck)) {
                         //send ack message to ingress
-                        //force natural/64-bit alignment
-                        hdtn::StorageAckHdr* storageAckHdr = new hdtn::StorageAckHdr();
-                        zmq::message_t zmqMessageStorageAckHdrWithDataStolen(storageAckHdr, sizeof(hdtn::StorageAckHdr), CustomCleanupStorageAckHdr, storageAckHdr);
-
-                        //memset 0 not needed because all values set below
-                        storageAckHdr->base.type = HDTN_MSGTYPE_STORAGE_ACK_TO_INGRESS;
-                        storageAckHdr->base.flags = 0;
-                        storageAckHdr->error = 0;
-                        storageAckHdr->ingressUniqueId = toStorageHeader.ingressUniqueId;
-                        storageAckHdr->outductIndex = toStorageHeader.outductIndex;
-
-                        if ((toStorageHeader.dontStoreBundle)
-                            && (toStorageHeader.outductIndex < m_vectorOutductInfo.size()) //if outductIndex is UINT64_MAX then bundle needs stored
-                            && m_vectorOutductInfo[toStorageHeader.outductIndex]->linkIsUp)
-                        {
-                            OutductInfo_t& info = *(m_vectorOutductInfo[toStorageHeader.outductIndex]);
-                            info.cutThroughQueue.emplace(std::move(zmqBundleDataReceived),
-                                std::move(zmqMessageStorageAckHdrWithDataStolen), toStorageHeader.finalDestEid, toStorageHeader.ingressUniqueId);
-                        }
-                        else {
-                            //storageStats.inBytes += zmqBundleDataReceived.size();
-
-                            cbhe_eid_t finalDestEidReturnedFromWrite;
-                            const bool isCertainThatThisBundleHasNoCustodyOrIsNotAdminRecord = (toStorageHeader.isCustodyOrAdminRecord == 0);
-                            Write(&zmqBundleDataReceived, finalDestEidReturnedFromWrite, false, isCertainThatThisBundleHasNoCustodyOrIsNotAdminRecord, &toStorageHeader.finalDestEid);
-
-                            //storageAckHdr->finalDestEid = finalDestEidReturnedFromWrite; //no longer needed as ingress decodes that
-
-                            if (!m_zmqPushSock_connectingStorageToBoundIngressPtr->send(std::move(zmqMessageStorageAckHdrWithDataStolen), zmq::send_flags::dontwait)) {
-                                LOG_ERROR(subprocess) << "zmq could not send ingress an ack from storage";
-                            }
+                        if (!m_zmqPushSock_connectingStorageToBoundIngressPtr->send(zmq::const_buffer(&storageAck, sizeof(hdtn::StorageAckHdr)), zmq::send_flags::dontwait)) {
+                            LOG_ERROR(subprocess) << "zmq could not send ingress an ack from storage";
                         }
                     }
                 }
-                else {
-                    LOG_ERROR(subprocess) << "hdtn::ZmqStorageInterface::ThreadFunc (from ingress bundle data) unknown message type";
-                }
             }
             if (pollItems[2].revents & ZMQ_POLLIN) { //release messages
                 hdtn::IreleaseChangeHdr releaseChangeHdr;
@@ -1651,6 +2253,16 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
                             << ") will be released from storage once egress is fully initialized";
                     }
                 }
+                else if (releaseChangeHdr.base.type == HDTN_MSGTYPE_IPRELOAD) {
+                    if (egressFullyInitialized && m_hdtnConfig.m_storageConfig.m_preloadMaxBytesPerOutduct) {
+                        if (releaseChangeHdr.outductArrayIndex < m_vectorOutductInfo.size()) {
+                            PreloadOutduct(*(m_vectorOutductInfo[releaseChangeHdr.outductArrayIndex]));
+                        }
+                        else {
+                            LOG_ERROR(subprocess) << "preload message received with out of bounds outductArrayIndex " << releaseChangeHdr.outductArrayIndex;
+                        }
+                    }
+                }
                 else if (releaseChangeHdr.base.type == HDTN_MSGTYPE_ILINKDOWN) {
                     if (egressFullyInitialized) {
                         if (releaseChangeHdr.outductArrayIndex < m_vectorOutductInfo.size()) {
@@ -1674,6 +2286,9 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
             if (pollItems[3].revents & ZMQ_POLLIN) { //telem requests data
                 TelemEventsHandler();
             }
+            if (hasReleaseWorkersPollItem && (pollItems[4].revents & ZMQ_POLLIN)) { //bundles read from disk by the release workers
+                while (HandleReleaseWorkerResult()) {}
+            }
         }
 
         const boost::posix_time::ptime nowPtime = boost::posix_time::microsec_clock::universal_time();
@@ -1688,8 +2303,10 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
             acsSendNowExpiry = nowPtime + ACS_SEND_PERIOD;
         }
 
-        uint64_t custodyIdExpiredAndNeedingResent;
-        while (m_custodyTimersPtr->PollOneAndPopAnyExpiredCustodyTimer(custodyIdExpiredAndNeedingResent, nowPtime)) {
+        expiredCustodyIdsVec.clear();
+        m_custodyTimersPtr->PopAllAnyExpiredCustodyTimers(expiredCustodyIdsVec, nowPtime); //a retransmission burst in one pass
+        for (std::size_t i = 0; i < expiredCustodyIdsVec.size(); ++i) {
+            const uint64_t custodyIdExpiredAndNeedingResent = expiredCustodyIdsVec[i];
             if (m_bsmPtr->ReturnCustodyIdToAwaitingSend(custodyIdExpiredAndNeedingResent)) {
                 ++numCustodyTransferTimeouts;
             }
@@ -1698,6 +2315,13 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
             }
         }
 
+        if (m_hasPreloadedBundles) {
+            ReturnExpiredPreloadedBundles(nowPtime);
+        }
+
+        m_bsmPtr->FlushRamHotTier(nowPtime); //write bundles resident longer than ramHotTierMaxResidentMilliseconds to disk
+        m_bsmPtr->FlushSmallBundleSlabs(nowPtime); //write the small bundle slabs changed SMALL_BUNDLE_SLAB_FLUSH_DELAY_MILLISECONDS ago to disk
+
         float storageUsagePercentage = m_bsmPtr->GetUsedSpaceBytes()  / (float)m_bsmPtr->GetTotalCapacityBytes();
 
         if((storageUsagePercentage > DELETE_ALL_EXPIRED_THRESHOLD) || (tryDeleteTime < nowPtime)) {
@@ -1708,6 +2332,12 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
         DoSendBundles(timeoutPoll);
 
     }
+    StopReleaseWorkers();
+    if (!m_hdtnConfig.m_storageConfig.m_autoDeleteFilesOnExit) {
+        //write them before the disk threads are stopped so that they can be restored
+        LOG_INFO(subprocess) << "writing " << m_bsmPtr->FlushAllOfRamHotTier() << " bundles from the ram hot tier to disk before exiting";
+        LOG_INFO(subprocess) << "writing " << m_bsmPtr->FlushAllSmallBundleSlabs() << " small bundle slabs to disk before exiting";
+    }
     LOG_DEBUG(subprocess) << "Storage bundles sent: FromDisk=" << m_telem.m_totalBundlesSentToEgressFromStorageReadFromDisk
         << "  FromCutThroughForward=" << m_telem.m_totalBundlesSentToEgressFromStorageForwardCutThrough;
     LOG_DEBUG(subprocess) << "totalEventsNoDataInStorageForAvailableLinks: " << m_totalEventsNoDataInStorageForAvailableLinks;
@@ -1719,6 +2349,8 @@ void ZmqStorageInterface::Impl::ThreadFunc() {
     LOG_DEBUG(subprocess) << "m_totalBundlesErasedFromStorageWithCustodyTransfer: " << m_telem.m_totalBundlesErasedFromStorageWithCustodyTransfer;
     LOG_DEBUG(subprocess) << "numCustodyTransferTimeouts: " << numCustodyTransferTimeouts;
     LOG_DEBUG(subprocess) << "m_totalBundlesRewrittenToStorageFromFailedEgressSend: " << m_telem.m_totalBundlesRewrittenToStorageFromFailedEgressSend;
+    LOG_DEBUG(subprocess) << "totalBundlesWrittenFromRamHotTier: " << m_bsmPtr->m_totalBundlesWrittenFromRamHotTier;
+    LOG_DEBUG(subprocess) << "totalBundlesRemovedFromRamHotTier: " << m_bsmPtr->m_totalBundlesRemovedFromRamHotTier;
 }
 
 void ZmqStorageInterface::Impl::DoSendBundles(long & timeoutPoll) {
@@ -1758,7 +2390,7 @@ void ZmqStorageInterface::Impl::DoSendBundles(long & timeoutPoll) {
                 break; //return to zmq loop with zero timeout
             }
             else if (timeoutPoll != shortestTimeoutPoll1Ms) { //potentially clogged
-                if (PeekOne(info.eidVec) > 0) { //data available in storage for clogged links
+                if (PeekOne(info) > 0) { //data available in storage for clogged links
                     timeoutPoll = shortestTimeoutPoll1Ms; //shortest timeout 1ms as we wait for acks
                     ++m_totalEventsDataInStorageForCloggedLinks;
                 }
@@ -1781,7 +2413,7 @@ void ZmqStorageInterface::Impl::PrioritySend(OutductInfo_t &info, uint64_t maxBu
     }
 
     bool queueBundleSmallEnough = (info.cutThroughQueue.front().bundleToEgress.size() <= maxBundleSizeToRead);
-    if(!PeekOne(info.eidVec, storageBundlePriority)) {
+    if(!PeekOne(info, storageBundlePriority)) {
         if(queueBundleSmallEnough) {
             SendFromCutThroughQueue(info, timeoutPoll);
         }
@@ -1910,10 +2542,13 @@ void ZmqStorageInterface::Impl::SendFromCutThroughQueue(OutductInfo_t &info, lon
 
                     const uint64_t bundleSizeBytes = qd.bundleToEgress.size(); //capture before move
 
-                    if (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(zmqMessageToEgressHdrWithDataStolen), zmq::send_flags::sndmore | zmq::send_flags::dontwait)) {
+                    if (m_inprocBundleRingsPtr && (!PushToEgressRing(*toEgressHdr, qd.bundleToEgress))) {
+                        LOG_ERROR(subprocess) << "could not push cut-through bundle to the egress ring";
+                    }
+                    else if ((!m_inprocBundleRingsPtr) && (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(zmqMessageToEgressHdrWithDataStolen), zmq::send_flags::sndmore | zmq::send_flags::dontwait))) {
                         LOG_ERROR(subprocess) << "could not forward header of cut-through bundle to egress";
                     }
-                    else if (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(qd.bundleToEgress), zmq::send_flags::dontwait)) {
+                    else if ((!m_inprocBundleRingsPtr) && (!m_zmqPushSock_connectingStorageToBoundEgressPtr->send(std::move(qd.bundleToEgress), zmq::send_flags::dontwait))) {
                         LOG_ERROR(subprocess) << "could not forward cut-through bundle to egress";
                     }
                     //with cut through bundles, don't send an ack to ingress until fully sent confirmation ack from egress, hence the map below to defer that
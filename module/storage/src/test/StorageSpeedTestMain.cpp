@@ -15,6 +15,10 @@
 #include <string>
 #include "BundleStorageManagerMT.h"
 #include "BundleStorageManagerAsio.h"
+#include "BundleStorageManagerRam.h"
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+#include "BundleStorageManagerIoUring.h"
+#endif
 #include <boost/make_unique.hpp>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
@@ -22,6 +26,8 @@
 #include "SignalHandler.h"
 #include "Logger.h"
 #include <atomic>
+#include <iomanip>
+#include <sstream>
 
 static const uint64_t PRIMARY_SRC_NODE = 100;
 static const uint64_t PRIMARY_SRC_SVC = 1;
@@ -58,7 +64,7 @@ struct TestFile {
 //two days
 #define NUMBER_OF_EXPIRATIONS (86400*2)
 
-bool TestSpeed(BundleStorageManagerBase & bsm) {
+bool TestSpeed(BundleStorageManagerBase & bsm, double & readAvgGigaBitsPerSec, double & writeAvgGigaBitsPerSec) {
     boost::random::mt19937 gen(static_cast<unsigned int>(std::time(0)));
     const boost::random::uniform_int_distribution<> distLinkId(0, 9);
     const boost::random::uniform_int_distribution<> distFileId(0, 9);
@@ -66,8 +72,6 @@ bool TestSpeed(BundleStorageManagerBase & bsm) {
     const boost::random::uniform_int_distribution<> distAbsExpiration(0, NUMBER_OF_EXPIRATIONS - 1);
     const boost::random::uniform_int_distribution<> distTotalBundleSize(1, 65536);
 
-    g_sigHandler.Start();
-
     static const cbhe_eid_t DEST_LINKS[10] = {
         cbhe_eid_t(1,1),
         cbhe_eid_t(2,1),
@@ -192,7 +196,7 @@ bool TestSpeed(BundleStorageManagerBase & bsm) {
                 padded_vector_uint8_t dataReadBack(bytesToReadFromDisk);
                 TestFile & originalFile = *fileMap[bytesToReadFromDisk];
 
-                const std::size_t numSegmentsToRead = sessionRead.catalogEntryPtr->segmentIdChainVec.size();
+                const std::size_t numSegmentsToRead = sessionRead.catalogEntryPtr->GetNumSegments();
                 bsm.ReadAllSegments(sessionRead, dataReadBack);
                 const std::size_t totalBytesRead = dataReadBack.size();
                 
@@ -221,9 +225,11 @@ bool TestSpeed(BundleStorageManagerBase & bsm) {
         }
     }
 
+    readAvgGigaBitsPerSec = gigaBitsPerSecReadDoubleAvg / NUM_TESTS;
+    writeAvgGigaBitsPerSec = gigaBitsPerSecWriteDoubleAvg / NUM_TESTS;
     if (g_running.load(std::memory_order_acquire)) {
-        LOG_DEBUG(subprocess) << "Read avg GBits/sec=" << gigaBitsPerSecReadDoubleAvg / NUM_TESTS;
-        LOG_DEBUG(subprocess) << "Write avg GBits/sec=" << gigaBitsPerSecWriteDoubleAvg / NUM_TESTS;
+        LOG_DEBUG(subprocess) << "Read avg GBits/sec=" << readAvgGigaBitsPerSec;
+        LOG_DEBUG(subprocess) << "Write avg GBits/sec=" << writeAvgGigaBitsPerSec;
     }
     return true;
 
@@ -232,13 +238,55 @@ bool TestSpeed(BundleStorageManagerBase & bsm) {
 
 int main() {
     hdtn::Logger::initializeWithProcess(hdtn::Logger::Process::storagespeedtest);
-    std::unique_ptr<BundleStorageManagerBase> bsmPtr;
-    if (true) {
-        boost::make_unique<BundleStorageManagerMT>();
+    g_sigHandler.Start();
+
+    //run every storage implementation built into this binary against the same storageConfig.json
+    //so that their throughputs can be compared side by side
+    static const std::vector<std::string> implementationNames = {
+        "stdio_multi_threaded",
+        "asio_single_threaded",
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+        "io_uring_single_threaded",
+#endif
+        "ram"
+    };
+    std::vector<double> readAvgs(implementationNames.size(), 0.0);
+    std::vector<double> writeAvgs(implementationNames.size(), 0.0);
+    std::vector<bool> results(implementationNames.size(), false);
+    for (std::size_t i = 0; (i < implementationNames.size()) && g_running.load(std::memory_order_acquire); ++i) {
+        const std::string& name = implementationNames[i];
+        LOG_INFO(subprocess) << "testing storage implementation " << name;
+        std::unique_ptr<BundleStorageManagerBase> bsmPtr;
+        if (name == "stdio_multi_threaded") {
+            bsmPtr = boost::make_unique<BundleStorageManagerMT>();
+        }
+        else if (name == "asio_single_threaded") {
+            bsmPtr = boost::make_unique<BundleStorageManagerAsio>();
+        }
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+        else if (name == "io_uring_single_threaded") {
+            bsmPtr = boost::make_unique<BundleStorageManagerIoUring>();
+        }
+#endif
+        else if (name == "ram") {
+            bsmPtr = boost::make_unique<BundleStorageManagerRam>();
+        }
+        results[i] = TestSpeed(*bsmPtr, readAvgs[i], writeAvgs[i]);
+        LOG_INFO(subprocess) << name << " result: " << results[i];
     }
-    else {
-        boost::make_unique<BundleStorageManagerAsio>();
+
+    std::ostringstream oss;
+    oss << "\n" << std::left << std::setw(28) << "implementation"
+        << std::right << std::setw(18) << "read avg GBits/s" << std::setw(18) << "write avg GBits/s" << "\n";
+    for (std::size_t i = 0; i < implementationNames.size(); ++i) {
+        oss << std::left << std::setw(28) << implementationNames[i] << std::right << std::fixed << std::setprecision(3);
+        if (results[i]) {
+            oss << std::setw(18) << readAvgs[i] << std::setw(18) << writeAvgs[i] << "\n";
+        }
+        else {
+            oss << std::setw(18) << "n/a" << std::setw(18) << "n/a" << "\n";
+        }
     }
-    LOG_INFO(subprocess) << TestSpeed(*bsmPtr);
+    LOG_INFO(subprocess) << oss.str();
     return 0;
 }
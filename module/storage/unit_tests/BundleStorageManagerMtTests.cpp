@@ -15,18 +15,32 @@
 #include <boost/test/unit_test.hpp>
 #include "BundleStorageManagerMT.h"
 #include "BundleStorageManagerAsio.h"
+#include "BundleStorageManagerRam.h"
+static const unsigned int WHICH_BSM_RAM = 2; //ram storage is never restored from
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+#include "BundleStorageManagerIoUring.h"
+static const unsigned int NUM_BSM_IMPLEMENTATIONS = 4;
+#else
+static const unsigned int NUM_BSM_IMPLEMENTATIONS = 3;
+#endif
 #include <iostream>
 #include <string>
+#include <fstream>
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 #include <boost/timer/timer.hpp>
+#include <boost/thread.hpp>
 #include <memory>
 #include <boost/make_unique.hpp>
+#include <boost/filesystem/operations.hpp>
 #include "SignalHandler.h"
 #include "Environment.h"
 #include "Sdnv.h"
 #include "codec/BundleViewV7.h"
 #include "codec/BundleViewV6.h"
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
 
 static const uint64_t PRIMARY_SRC_NODE = 100;
 static const uint64_t PRIMARY_SRC_SVC = 1;
@@ -100,7 +114,7 @@ static bool GenerateBundleV7(padded_vector_uint8_t& bundle, const Bpv7CbhePrimar
 
 BOOST_AUTO_TEST_CASE(BundleStorageManagerAllTestCase)
 {
-    for (unsigned int whichBsm = 0; whichBsm < 2; ++whichBsm) {
+    for (unsigned int whichBsm = 0; whichBsm < NUM_BSM_IMPLEMENTATIONS; ++whichBsm) {
         boost::random::mt19937 gen(static_cast<unsigned int>(std::time(0)));
         const boost::random::uniform_int_distribution<> distRandomData(0, 255);
         const boost::random::uniform_int_distribution<> distLinkId(0, 9);
@@ -142,10 +156,20 @@ BOOST_AUTO_TEST_CASE(BundleStorageManagerAllTestCase)
             std::cout << "create BundleStorageManagerMT" << std::endl;
             bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
         }
-        else {
+        else if (whichBsm == 1) {
             std::cout << "create BundleStorageManagerAsio" << std::endl;
             bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
         }
+        else if (whichBsm == WHICH_BSM_RAM) {
+            std::cout << "create BundleStorageManagerRam" << std::endl;
+            bsmPtr = boost::make_unique<BundleStorageManagerRam>(ptrStorageConfig);
+        }
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+        else {
+            std::cout << "create BundleStorageManagerIoUring" << std::endl;
+            bsmPtr = boost::make_unique<BundleStorageManagerIoUring>(ptrStorageConfig);
+        }
+#endif
         BundleStorageManagerBase & bsm = *bsmPtr;
 
         bsm.Start();
@@ -252,226 +276,1363 @@ BOOST_AUTO_TEST_CASE(BundleStorageManagerAllTestCase)
 BOOST_AUTO_TEST_CASE(BundleStorageManagerAll_RestoreFromDisk_TestCase)
 {
     for (unsigned int whichBundleVersion = 6; whichBundleVersion <= 7; ++whichBundleVersion) {
-        for (unsigned int whichBsm = 0; whichBsm < 2; ++whichBsm) {
-            boost::random::mt19937 gen(static_cast<unsigned int>(std::time(0)));
-            const boost::random::uniform_int_distribution<> distRandomData(0, 255);
-            const boost::random::uniform_int_distribution<> distPriorityIndex(0, 2);
-
-            static const cbhe_eid_t DEST_LINKS[10] = {
-                cbhe_eid_t(1,1),
-                cbhe_eid_t(2,1),
-                cbhe_eid_t(3,1),
-                cbhe_eid_t(4,1),
-                cbhe_eid_t(5,1),
-                cbhe_eid_t(6,1),
-                cbhe_eid_t(7,1),
-                cbhe_eid_t(8,1),
-                cbhe_eid_t(9,1),
-                cbhe_eid_t(10,1)
-            };
-            const std::vector<cbhe_eid_t> availableDestLinks = {
-                cbhe_eid_t(1,1),
-                cbhe_eid_t(2,1),
-                cbhe_eid_t(3,1),
-                cbhe_eid_t(4,1),
-                cbhe_eid_t(5,1),
-                cbhe_eid_t(6,1),
-                cbhe_eid_t(7,1),
-                cbhe_eid_t(8,1),
-                cbhe_eid_t(9,1),
-                cbhe_eid_t(10,1)
-            };
-            const std::vector<cbhe_eid_t> availableDestLinks2 = { cbhe_eid_t(2,1) };
+        for (unsigned int whichBsm = 0; whichBsm < NUM_BSM_IMPLEMENTATIONS; ++whichBsm) {
+            if (whichBsm == WHICH_BSM_RAM) {
+                continue;
+            }
+            //0 => scan every segment, 1 => catalog journal, 2 => corrupted catalog journal (falls back to the scan),
+            //3 => catalog journal which disables itself when it cannot rotate (falls back to the scan)
+            for (unsigned int journalMode = 0; journalMode < 4; ++journalMode) {
+                boost::random::mt19937 gen(static_cast<unsigned int>(std::time(0)));
+                const boost::random::uniform_int_distribution<> distRandomData(0, 255);
+                const boost::random::uniform_int_distribution<> distPriorityIndex(0, 2);
+
+                static const cbhe_eid_t DEST_LINKS[10] = {
+                    cbhe_eid_t(1,1),
+                    cbhe_eid_t(2,1),
+                    cbhe_eid_t(3,1),
+                    cbhe_eid_t(4,1),
+                    cbhe_eid_t(5,1),
+                    cbhe_eid_t(6,1),
+                    cbhe_eid_t(7,1),
+                    cbhe_eid_t(8,1),
+                    cbhe_eid_t(9,1),
+                    cbhe_eid_t(10,1)
+                };
+                const std::vector<cbhe_eid_t> availableDestLinks = {
+                    cbhe_eid_t(1,1),
+                    cbhe_eid_t(2,1),
+                    cbhe_eid_t(3,1),
+                    cbhe_eid_t(4,1),
+                    cbhe_eid_t(5,1),
+                    cbhe_eid_t(6,1),
+                    cbhe_eid_t(7,1),
+                    cbhe_eid_t(8,1),
+                    cbhe_eid_t(9,1),
+                    cbhe_eid_t(10,1)
+                };
+                const std::vector<cbhe_eid_t> availableDestLinks2 = { cbhe_eid_t(2,1) };
+
+
+
+
+                static const uint64_t sizes[15] = {
+                    BUNDLE_STORAGE_PER_SEGMENT_SIZE - 2,
+                    BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1,
+                    BUNDLE_STORAGE_PER_SEGMENT_SIZE - 0,
+                    BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1,
+                    BUNDLE_STORAGE_PER_SEGMENT_SIZE + 2,
+
+                    2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 2,
+                    2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1,
+                    2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 0,
+                    2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1,
+                    2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 2,
+
+                    1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 2,
+                    1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1,
+                    1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 0,
+                    1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1,
+                    1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 2,
+                };
+                std::map < uint64_t, padded_vector_uint8_t> mapBundleSizeToBundleData;
+                std::map < uint64_t, std::unique_ptr<PrimaryBlock> > mapBundleSizeToPrimary;
+
+                uint64_t bytesWritten = 0, totalSegmentsWritten = 0;
+                memmanager_t backup;
+
+                {
+                    std::unique_ptr<BundleStorageManagerBase> bsmPtr;
+                    StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+                    ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+                    ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+                    if (journalMode != 0) {
+                        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal.bin";
+                        ptrStorageConfig->m_catalogJournalSnapshotIntervalRecords = 6; //16 records => snapshots mid-test plus a journal tail to replay
+                    }
+                    if (whichBsm == 0) {
+                        std::cout << "create BundleStorageManagerMT for Restore" << std::endl;
+                        bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
+                    }
+                    else if (whichBsm == 1) {
+                        std::cout << "create BundleStorageManagerAsio for Restore" << std::endl;
+                        bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
+                    }
+    #ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+                    else {
+                        std::cout << "create BundleStorageManagerIoUring for Restore" << std::endl;
+                        bsmPtr = boost::make_unique<BundleStorageManagerIoUring>(ptrStorageConfig);
+                    }
+    #endif
+                    BundleStorageManagerBase & bsm = *bsmPtr;
+                    if (journalMode == 3) {
+                        //a non-empty directory in the way of the previous journal makes the first rotation fail
+                        boost::filesystem::create_directories(boost::filesystem::path("catalog_journal.bin.prev") / "blocker");
+                    }
 
+                    bsm.Start();
+
+                    uint64_t deletedMiddleBundleSize = 0;
+
+                    for (unsigned int sizeI = 0; sizeI < 15; ++sizeI) {
+                        const uint64_t custodyId = sizeI;
+                        const uint64_t targetBundleSize = sizes[sizeI];
+
+                        const unsigned int linkId = (sizeI == 12) ? 1 : 0;
+
+                        const unsigned int priorityIndex = distPriorityIndex(gen);
+                        static const BPV6_BUNDLEFLAG priorityBundleFlags[4] = {
+                            BPV6_BUNDLEFLAG::PRIORITY_BULK, BPV6_BUNDLEFLAG::PRIORITY_NORMAL, BPV6_BUNDLEFLAG::PRIORITY_EXPEDITED, BPV6_BUNDLEFLAG::PRIORITY_BIT_MASK
+                        };
+                        const uint64_t absExpiration = sizeI;
+
+                        BundleStorageManagerSession_WriteToDisk sessionWrite;
+                        padded_vector_uint8_t bundle;
+                        std::unique_ptr<PrimaryBlock> primaryBlockPtr;
+                        if (whichBundleVersion == 6) {
+                            Bpv6CbhePrimaryBlock primary;
+                            primary.SetZero();
+                            primary.m_bundleProcessingControlFlags = priorityBundleFlags[priorityIndex] | (BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT);
+                            primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+                            primary.m_destinationEid = DEST_LINKS[linkId];
+                            primary.m_custodianEid.SetZero();
+                            primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+                            primary.m_lifetimeSeconds = absExpiration;
+                            primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+                            primaryBlockPtr = boost::make_unique<Bpv6CbhePrimaryBlock>(primary);
+                        
+                            BOOST_REQUIRE(GenerateBundle(bundle, primary, targetBundleSize, static_cast<uint8_t>(sizeI)));
+                        }
+                        else {
+                            Bpv7CbhePrimaryBlock primary;
+                            primary.SetZero();
+                            primary.m_bundleProcessingControlFlags = BPV7_BUNDLEFLAG::NOFRAGMENT;
+                            primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+                            primary.m_destinationEid = DEST_LINKS[linkId];
+                            primary.m_creationTimestamp.millisecondsSinceStartOfYear2000 = 0;
+                            primary.m_lifetimeMilliseconds = absExpiration * 1000;
+                            primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+                            primaryBlockPtr = boost::make_unique<Bpv7CbhePrimaryBlock>(primary);
+                            BOOST_REQUIRE(GenerateBundleV7(bundle, primary, targetBundleSize, static_cast<uint8_t>(sizeI)));
+                        }
+                        //std::cout << "generate bundle of size " << bundle.size() << std::endl;
+                        //std::cout << "writing\n";
+                        uint64_t totalSegmentsRequired = bsm.Push(sessionWrite, *primaryBlockPtr, bundle.size(), 0);
+
+                        //std::cout << "totalSegmentsRequired " << totalSegmentsRequired << "\n";
+                        BOOST_REQUIRE_NE(totalSegmentsRequired, 0);
+
+                        const uint64_t totalBytesPushed = bsm.PushAllSegments(sessionWrite, *primaryBlockPtr, custodyId, bundle.data(), bundle.size());
+                        BOOST_REQUIRE_EQUAL(totalBytesPushed, bundle.size());
+
+                        if (sizeI != 12) {
+                            bytesWritten += bundle.size();
+                            totalSegmentsWritten += totalSegmentsRequired;
+                            const uint64_t bundleSize = bundle.size();
+                            mapBundleSizeToBundleData[bundleSize] = std::move(bundle);
+                            mapBundleSizeToPrimary[bundleSize] = std::move(primaryBlockPtr);
+                        }
+                        else {
+                            deletedMiddleBundleSize = bundle.size();
+                        }
+                    }
 
+                    //delete a middle out
+                    BundleStorageManagerSession_ReadFromDisk sessionRead;
+                    boost::uint64_t bytesToReadFromDisk = bsm.PopTop(sessionRead, availableDestLinks2);
+                    BOOST_REQUIRE_EQUAL(bytesToReadFromDisk, deletedMiddleBundleSize);
+                    BOOST_REQUIRE_MESSAGE(bsm.RemoveReadBundleFromDisk(sessionRead), "error force freeing bundle from disk");
+
+                    bsm.GetMemoryManagerConstRef().BackupDataToVector(backup);
+                    BOOST_REQUIRE(bsm.GetMemoryManagerConstRef().IsBackupEqual(backup));
+                    BOOST_REQUIRE_EQUAL(bsm.IsCatalogJournalEnabled(), (journalMode != 0) && (journalMode != 3));
+                    if (journalMode == 3) {
+                        //the snapshot and journal no longer describe the stored bundles, so they must not be left to be restored
+                        BOOST_REQUIRE(!boost::filesystem::exists("catalog_journal.bin.snapshot"));
+                        BOOST_REQUIRE(!boost::filesystem::exists("catalog_journal.bin"));
+                        boost::filesystem::remove_all("catalog_journal.bin.prev");
+                    }
+                }
+                if ((journalMode == 1) || (journalMode == 2)) {
+                    //the last rotation's previous journal was folded into the snapshot by the background thread
+                    BOOST_REQUIRE(!boost::filesystem::exists("catalog_journal.bin.prev"));
+                }
 
+                std::cout << "wrote bundles but leaving files\n";
+                if (journalMode == 2) {
+                    //flip the last byte of the journal tail so its record crc fails
+                    std::fstream journalFile("catalog_journal.bin", std::ios::in | std::ios::out | std::ios::binary);
+                    BOOST_REQUIRE(journalFile.is_open());
+                    journalFile.seekg(-1, std::ios::end);
+                    const int lastByte = journalFile.get();
+                    BOOST_REQUIRE_NE(lastByte, std::char_traits<char>::eof());
+                    journalFile.seekp(-1, std::ios::end);
+                    journalFile.put(static_cast<char>(lastByte ^ 0xff));
+                }
+                //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+                std::cout << "restoring...\n";
+                {
+                    std::unique_ptr<BundleStorageManagerBase> bsmPtr;
+                    StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+                    ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+                    ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+                    if (journalMode != 0) {
+                        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal.bin";
+                        ptrStorageConfig->m_catalogJournalSnapshotIntervalRecords = 6;
+                    }
+                    if (whichBsm == 0) {
+                        std::cout << "create BundleStorageManagerMT for Restore" << std::endl;
+                        bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
+                    }
+                    else if (whichBsm == 1) {
+                        std::cout << "create BundleStorageManagerAsio for Restore" << std::endl;
+                        bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
+                    }
+    #ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+                    else {
+                        std::cout << "create BundleStorageManagerIoUring for Restore" << std::endl;
+                        bsmPtr = boost::make_unique<BundleStorageManagerIoUring>(ptrStorageConfig);
+                    }
+    #endif
+                    BundleStorageManagerBase & bsm = *bsmPtr;
 
-            static const uint64_t sizes[15] = {
-                BUNDLE_STORAGE_PER_SEGMENT_SIZE - 2,
-                BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1,
-                BUNDLE_STORAGE_PER_SEGMENT_SIZE - 0,
-                BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1,
-                BUNDLE_STORAGE_PER_SEGMENT_SIZE + 2,
 
-                2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 2,
-                2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1,
-                2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 0,
-                2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1,
-                2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 2,
 
-                1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 2,
-                1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 1,
-                1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE - 0,
-                1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1,
-                1000 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 2,
-            };
-            std::map < uint64_t, padded_vector_uint8_t> mapBundleSizeToBundleData;
-            std::map < uint64_t, std::unique_ptr<PrimaryBlock> > mapBundleSizeToPrimary;
+                    //BOOST_REQUIRE(!bsm.GetMemoryManagerConstRef().IsBackupEqual(backup));
+                    BOOST_REQUIRE_MESSAGE(bsm.m_successfullyRestoredFromDisk, "error restoring from disk");
+                    BOOST_REQUIRE_EQUAL(bsm.m_successfullyRestoredFromCatalogJournal, (journalMode == 1));
+                    BOOST_REQUIRE(bsm.GetMemoryManagerConstRef().IsBackupEqual(backup));
+                    std::cout << "restored\n";
+                    BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, (15 - 1));
+                    BOOST_REQUIRE_EQUAL(bsm.m_totalBytesRestored, bytesWritten);
+                    BOOST_REQUIRE_EQUAL(bsm.m_totalSegmentsRestored, totalSegmentsWritten);
 
-            uint64_t bytesWritten = 0, totalSegmentsWritten = 0;
-            memmanager_t backup;
+                    bsm.Start();
 
-            {
-                std::unique_ptr<BundleStorageManagerBase> bsmPtr;
-                StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
-                ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
-                ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
-                if (whichBsm == 0) {
-                    std::cout << "create BundleStorageManagerMT for Restore" << std::endl;
-                    bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
-                }
-                else {
-                    std::cout << "create BundleStorageManagerAsio for Restore" << std::endl;
-                    bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
-                }
-                BundleStorageManagerBase & bsm = *bsmPtr;
 
-                bsm.Start();
+                    BOOST_REQUIRE_EQUAL(mapBundleSizeToBundleData.size(), 15 - 1);
+
+                    uint64_t totalBytesReadFromRestored = 0, totalSegmentsReadFromRestored = 0;
+                    BundleStorageManagerSession_ReadFromDisk sessionRead; //contains heap allocation so reuse it
+                    for (unsigned int sizeI = 0; sizeI < (15 - 1); ++sizeI) {
+
+
+                        //std::cout << "reading\n";
+                        const uint64_t bytesToReadFromDisk = bsm.PopTop(sessionRead, availableDestLinks);
+                        //std::cout << "bytesToReadFromDisk " << bytesToReadFromDisk << "\n";
+                        BOOST_REQUIRE_NE(bytesToReadFromDisk, 0);
+                        padded_vector_uint8_t dataReadBack(bytesToReadFromDisk);
+                        totalBytesReadFromRestored += bytesToReadFromDisk;
+
+                        const std::size_t numSegmentsToRead = sessionRead.catalogEntryPtr->GetNumSegments();
+                        totalSegmentsReadFromRestored += numSegmentsToRead;
+
+                        BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+                        const std::size_t totalBytesRead = dataReadBack.size();
+
+                        //std::cout << "totalBytesRead " << totalBytesRead << "\n";
+                        BOOST_REQUIRE_EQUAL(totalBytesRead, bytesToReadFromDisk);
+                        BOOST_REQUIRE_EQUAL(mapBundleSizeToBundleData.count(totalBytesRead), 1);
+                        BOOST_REQUIRE_EQUAL(mapBundleSizeToBundleData[totalBytesRead].size(), totalBytesRead);
+                        BOOST_REQUIRE(mapBundleSizeToBundleData[totalBytesRead] == dataReadBack);
+                        BOOST_REQUIRE_EQUAL(sessionRead.catalogEntryPtr->destEid.nodeId, mapBundleSizeToPrimary[totalBytesRead]->GetFinalDestinationEid().nodeId);
+                        BOOST_REQUIRE_EQUAL(sessionRead.catalogEntryPtr->GetPriorityIndex(), mapBundleSizeToPrimary[totalBytesRead]->GetPriority());
+
+                        BOOST_REQUIRE_MESSAGE(bsm.RemoveReadBundleFromDisk(sessionRead), "error freeing bundle from disk");
 
-                uint64_t deletedMiddleBundleSize = 0;
-
-                for (unsigned int sizeI = 0; sizeI < 15; ++sizeI) {
-                    const uint64_t custodyId = sizeI;
-                    const uint64_t targetBundleSize = sizes[sizeI];
-
-                    const unsigned int linkId = (sizeI == 12) ? 1 : 0;
-
-                    const unsigned int priorityIndex = distPriorityIndex(gen);
-                    static const BPV6_BUNDLEFLAG priorityBundleFlags[4] = {
-                        BPV6_BUNDLEFLAG::PRIORITY_BULK, BPV6_BUNDLEFLAG::PRIORITY_NORMAL, BPV6_BUNDLEFLAG::PRIORITY_EXPEDITED, BPV6_BUNDLEFLAG::PRIORITY_BIT_MASK
-                    };
-                    const uint64_t absExpiration = sizeI;
-
-                    BundleStorageManagerSession_WriteToDisk sessionWrite;
-                    padded_vector_uint8_t bundle;
-                    std::unique_ptr<PrimaryBlock> primaryBlockPtr;
-                    if (whichBundleVersion == 6) {
-                        Bpv6CbhePrimaryBlock primary;
-                        primary.SetZero();
-                        primary.m_bundleProcessingControlFlags = priorityBundleFlags[priorityIndex] | (BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT);
-                        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
-                        primary.m_destinationEid = DEST_LINKS[linkId];
-                        primary.m_custodianEid.SetZero();
-                        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
-                        primary.m_lifetimeSeconds = absExpiration;
-                        primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
-                        primaryBlockPtr = boost::make_unique<Bpv6CbhePrimaryBlock>(primary);
-                        
-                        BOOST_REQUIRE(GenerateBundle(bundle, primary, targetBundleSize, static_cast<uint8_t>(sizeI)));
-                    }
-                    else {
-                        Bpv7CbhePrimaryBlock primary;
-                        primary.SetZero();
-                        primary.m_bundleProcessingControlFlags = BPV7_BUNDLEFLAG::NOFRAGMENT;
-                        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
-                        primary.m_destinationEid = DEST_LINKS[linkId];
-                        primary.m_creationTimestamp.millisecondsSinceStartOfYear2000 = 0;
-                        primary.m_lifetimeMilliseconds = absExpiration * 1000;
-                        primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
-                        primaryBlockPtr = boost::make_unique<Bpv7CbhePrimaryBlock>(primary);
-                        BOOST_REQUIRE(GenerateBundleV7(bundle, primary, targetBundleSize, static_cast<uint8_t>(sizeI)));
-                    }
-                    //std::cout << "generate bundle of size " << bundle.size() << std::endl;
-                    //std::cout << "writing\n";
-                    uint64_t totalSegmentsRequired = bsm.Push(sessionWrite, *primaryBlockPtr, bundle.size(), 0);
-
-                    //std::cout << "totalSegmentsRequired " << totalSegmentsRequired << "\n";
-                    BOOST_REQUIRE_NE(totalSegmentsRequired, 0);
-
-                    const uint64_t totalBytesPushed = bsm.PushAllSegments(sessionWrite, *primaryBlockPtr, custodyId, bundle.data(), bundle.size());
-                    BOOST_REQUIRE_EQUAL(totalBytesPushed, bundle.size());
-
-                    if (sizeI != 12) {
-                        bytesWritten += bundle.size();
-                        totalSegmentsWritten += totalSegmentsRequired;
-                        const uint64_t bundleSize = bundle.size();
-                        mapBundleSizeToBundleData[bundleSize] = std::move(bundle);
-                        mapBundleSizeToPrimary[bundleSize] = std::move(primaryBlockPtr);
-                    }
-                    else {
-                        deletedMiddleBundleSize = bundle.size();
                     }
-                }
 
-                //delete a middle out
-                BundleStorageManagerSession_ReadFromDisk sessionRead;
-                boost::uint64_t bytesToReadFromDisk = bsm.PopTop(sessionRead, availableDestLinks2);
-                BOOST_REQUIRE_EQUAL(bytesToReadFromDisk, deletedMiddleBundleSize);
-                BOOST_REQUIRE_MESSAGE(bsm.RemoveReadBundleFromDisk(sessionRead), "error force freeing bundle from disk");
+                    BOOST_REQUIRE_EQUAL(totalBytesReadFromRestored, bytesWritten);
+                    BOOST_REQUIRE_EQUAL(totalSegmentsReadFromRestored, totalSegmentsWritten);
+
 
-                bsm.GetMemoryManagerConstRef().BackupDataToVector(backup);
-                BOOST_REQUIRE(bsm.GetMemoryManagerConstRef().IsBackupEqual(backup));
+
+                }
             }
+        }
+    }
+}
 
-            std::cout << "wrote bundles but leaving files\n";
-            //boost::this_thread::sleep(boost::posix_time::milliseconds(500));
-            std::cout << "restoring...\n";
-            {
-                std::unique_ptr<BundleStorageManagerBase> bsmPtr;
-                StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
-                ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
-                ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
-                if (whichBsm == 0) {
-                    std::cout << "create BundleStorageManagerMT for Restore" << std::endl;
-                    bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_RamHotTier_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    static const uint64_t TARGET_BUNDLE_SIZE = 2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1; //3 segments
+    std::vector<padded_vector_uint8_t> bundles(5);
+    std::vector<std::unique_ptr<Bpv6CbhePrimaryBlock> > primaries(5);
+
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_hot_tier.bin";
+        ptrStorageConfig->m_ramHotTierMaxBytes = 3 * TARGET_BUNDLE_SIZE + 10; //room for 3 bundles
+        ptrStorageConfig->m_ramHotTierMaxResidentMilliseconds = 60000;
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        bsm.Start();
+
+        for (unsigned int i = 0; i < 5; ++i) {
+            Bpv6CbhePrimaryBlock primary;
+            primary.SetZero();
+            primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+            primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+            primary.m_destinationEid = availableDestLinks[0];
+            primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+            primary.m_lifetimeSeconds = 1000 + i; //released in push order
+            primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+            primaries[i] = boost::make_unique<Bpv6CbhePrimaryBlock>(primary);
+            BOOST_REQUIRE(GenerateBundle(bundles[i], primary, TARGET_BUNDLE_SIZE, static_cast<uint8_t>(i)));
+
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, *primaries[i], bundles[i].size(), 0), 3);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, *primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+        }
+        //memory pressure wrote the two oldest to disk
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesWrittenFromRamHotTier, 2);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierNumBundles(), 3);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierBytes(), 3 * bundles[0].size());
+
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        for (unsigned int i = 0; i < 3; ++i) { //bundles 0 and 1 from disk, bundle 2 from ram
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+            BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+            BOOST_REQUIRE_EQUAL(bsm.IsInRamHotTier(sessionRead.catalogEntryPtr), (i == 2));
+            BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+            BOOST_REQUIRE(dataReadBack == bundles[i]);
+            std::vector<uint8_t> firstSegment;
+            BOOST_REQUIRE(bsm.ReadFirstSegment(sessionRead, sessionRead.catalogEntryPtr, firstSegment));
+            BOOST_REQUIRE(std::equal(firstSegment.cbegin(), firstSegment.cend(), bundles[i].cbegin()));
+            BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        }
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRemovedFromRamHotTier, 1);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierNumBundles(), 2);
+
+        const boost::posix_time::ptime nowPtime = boost::posix_time::microsec_clock::universal_time();
+        BOOST_REQUIRE_EQUAL(bsm.FlushRamHotTier(nowPtime), 0); //not resident long enough
+        BOOST_REQUIRE_EQUAL(bsm.FlushRamHotTier(nowPtime + boost::posix_time::minutes(2)), 2);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierNumBundles(), 0);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierBytes(), 0);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesWrittenFromRamHotTier, 4);
+    }
+
+    //only the bundles written from the hot tier and never removed are restored
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_hot_tier.bin";
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromCatalogJournal);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, 2);
+        bsm.Start();
+
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        for (unsigned int i = 3; i < 5; ++i) {
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+            BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+            BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+            BOOST_REQUIRE(dataReadBack == bundles[i]);
+            BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        }
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+    }
+}
+
+//catalog snapshots taken while bundles are in the RAM hot tier must contain neither the hot bundles later written to disk
+//(journaled then, so they would be restored twice) nor the hot bundles removed before being written (never journaled)
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_RamHotTierCatalogSnapshot_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    static const uint64_t TARGET_BUNDLE_SIZE = 2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1; //3 segments
+    std::vector<padded_vector_uint8_t> bundles(5);
+    std::vector<std::unique_ptr<Bpv6CbhePrimaryBlock> > primaries(5);
+
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_hot_tier_snapshot.bin";
+        ptrStorageConfig->m_catalogJournalSnapshotIntervalRecords = 1; //a new snapshot for (almost) every record
+        ptrStorageConfig->m_ramHotTierMaxBytes = 3 * TARGET_BUNDLE_SIZE + 10; //room for 3 bundles
+        ptrStorageConfig->m_ramHotTierMaxResidentMilliseconds = 60000;
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        bsm.Start();
+
+        for (unsigned int i = 0; i < 5; ++i) {
+            Bpv6CbhePrimaryBlock primary;
+            primary.SetZero();
+            primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+            primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+            primary.m_destinationEid = availableDestLinks[0];
+            primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+            primary.m_lifetimeSeconds = 1000 + i; //released in push order
+            primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+            primaries[i] = boost::make_unique<Bpv6CbhePrimaryBlock>(primary);
+            BOOST_REQUIRE(GenerateBundle(bundles[i], primary, TARGET_BUNDLE_SIZE, static_cast<uint8_t>(i)));
+
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, *primaries[i], bundles[i].size(), 0), 3);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, *primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+        }
+        //memory pressure wrote bundles 0 and 1 to disk, bundles 2, 3 and 4 are in the hot tier
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesWrittenFromRamHotTier, 2);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierNumBundles(), 3);
+
+        BOOST_REQUIRE(bsm.RemoveBundleFromDisk(1)); //journaled remove
+        BOOST_REQUIRE(bsm.RemoveBundleFromDisk(3)); //removed from the hot tier, never journaled
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRemovedFromRamHotTier, 1);
+        BOOST_REQUIRE_EQUAL(bsm.FlushRamHotTier(boost::posix_time::microsec_clock::universal_time() + boost::posix_time::minutes(2)), 2);
+        BOOST_REQUIRE_EQUAL(bsm.GetRamHotTierNumBundles(), 0);
+        BOOST_REQUIRE(bsm.IsCatalogJournalEnabled());
+    }
+
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_hot_tier_snapshot.bin";
+        ptrStorageConfig->m_catalogJournalSnapshotIntervalRecords = 1;
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromCatalogJournal); //no duplicate or dangling record
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, 3);
+        bsm.Start();
+
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        const uint64_t expectedCustodyIds[3] = { 0, 2, 4 };
+        for (unsigned int i = 0; i < 3; ++i) {
+            const uint64_t custodyId = expectedCustodyIds[i];
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[custodyId].size());
+            BOOST_REQUIRE_EQUAL(sessionRead.custodyId, custodyId);
+            BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+            BOOST_REQUIRE(dataReadBack == bundles[custodyId]);
+            BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        }
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_ConcurrentReads_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    static const uint64_t TARGET_BUNDLE_SIZE = 2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1; //3 segments
+    static const unsigned int NUM_READER_THREADS = 4;
+    static const unsigned int NUM_BUNDLES_READ = 40;
+    static const unsigned int NUM_BUNDLES_PUSHED_WHILE_READING = 40;
+    static const unsigned int NUM_BUNDLES = NUM_BUNDLES_READ + NUM_BUNDLES_PUSHED_WHILE_READING;
+    std::vector<padded_vector_uint8_t> bundles(NUM_BUNDLES);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(NUM_BUNDLES);
+
+    StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+    ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+    ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+    BundleStorageManagerMT bsm(ptrStorageConfig);
+    bsm.Start();
+
+    for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+        Bpv6CbhePrimaryBlock& primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, TARGET_BUNDLE_SIZE, static_cast<uint8_t>(i)));
+    }
+    //push bundles [beginIndex, endIndex)
+    auto PushBundles = [&](const unsigned int beginIndex, const unsigned int endIndex) {
+        for (unsigned int i = beginIndex; i < endIndex; ++i) {
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 3);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+        }
+    };
+    PushBundles(0, NUM_BUNDLES_READ);
+
+    //the released catalog entries are copied so that the readers don't share them with the catalog
+    std::vector<catalog_entry_t> releasedEntries(NUM_BUNDLES_READ);
+    {
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        for (unsigned int i = 0; i < NUM_BUNDLES_READ; ++i) {
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+            BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+            releasedEntries[i] = *sessionRead.catalogEntryPtr;
+        }
+    }
+
+    //each reader thread (like a release worker) reads every NUM_READER_THREADS'th bundle while this thread keeps pushing
+    std::shared_ptr<ReleaseBufferPool> poolPtr = ReleaseBufferPool::Create(RELEASE_BUFFER_POOL_MAX_FREE_BYTES);
+    std::vector<padded_vector_uint8_t> dataReadBack(NUM_BUNDLES_READ);
+    std::vector<uint8_t> readSuccess(NUM_BUNDLES_READ, 0);
+    std::vector<std::unique_ptr<boost::thread> > readerThreads;
+    for (unsigned int t = 0; t < NUM_READER_THREADS; ++t) {
+        readerThreads.emplace_back(boost::make_unique<boost::thread>([&, t]() {
+            BundleStorageManagerSession_ReadFromDisk sessionRead;
+            for (unsigned int i = t; i < NUM_BUNDLES_READ; i += NUM_READER_THREADS) {
+                sessionRead.catalogEntryPtr = &releasedEntries[i];
+                sessionRead.custodyId = i;
+                release_buffer_t* releaseBufferPtr = poolPtr->Acquire(releasedEntries[i].bundleSizeBytes);
+                if (releaseBufferPtr == NULL) {
+                    continue;
                 }
-                else {
-                    std::cout << "create BundleStorageManagerAsio for Restore" << std::endl;
-                    bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
+                readSuccess[i] = bsm.ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe(sessionRead, *releaseBufferPtr);
+                dataReadBack[i].assign(releaseBufferPtr->data, releaseBufferPtr->data + releaseBufferPtr->size);
+                ReleaseBufferPool::Recycle(releaseBufferPtr);
+            }
+        }));
+    }
+    PushBundles(NUM_BUNDLES_READ, NUM_BUNDLES);
+    for (std::size_t t = 0; t < readerThreads.size(); ++t) {
+        readerThreads[t]->join();
+    }
+    for (unsigned int i = 0; i < NUM_BUNDLES_READ; ++i) {
+        BOOST_REQUIRE(readSuccess[i]);
+        BOOST_REQUIRE(dataReadBack[i] == bundles[i]);
+        BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(i));
+    }
+
+    //the bundles pushed while reading are intact
+    BundleStorageManagerSession_ReadFromDisk sessionRead;
+    padded_vector_uint8_t data;
+    for (unsigned int i = NUM_BUNDLES_READ; i < NUM_BUNDLES; ++i) {
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+        BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+        BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, data));
+        BOOST_REQUIRE(data == bundles[i]);
+        BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+    }
+    BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_SmallBundleSlabs_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    //30 bundles in two 256-byte-slot slabs, then 7 bundles in three 1024-byte-slot slabs (the last slab is shared with no one),
+    //then 1 bundle too large for a slab, and 1 bundle which fits a slab but falls back to a segment of its own (slab limit reached)
+    std::vector<uint64_t> bundleSizes(30, 200);
+    bundleSizes.insert(bundleSizes.end(), 7, 900);
+    bundleSizes.push_back(2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1);
+    bundleSizes.push_back(300);
+    const std::size_t numBundles = bundleSizes.size();
+    BOOST_REQUIRE_EQUAL(BundleStorageManagerBase::GetSmallBundleSlabMaxBundleSizeBytes(), 1024 - SMALL_BUNDLE_SLAB_SLOT_HEADER_SIZE);
+    BOOST_REQUIRE_GE(BundleStorageManagerBase::GetSmallBundleSlabNumSlots(1), 15); //200 byte bundles
+    BOOST_REQUIRE_GE(BundleStorageManagerBase::GetSmallBundleSlabNumSlots(3), 3); //900 byte bundles
+    const unsigned int numSlots200 = BundleStorageManagerBase::GetSmallBundleSlabNumSlots(1);
+    const unsigned int numSlots900 = BundleStorageManagerBase::GetSmallBundleSlabNumSlots(3);
+    const std::size_t expectedNumSlabs = ((30 + numSlots200 - 1) / numSlots200) + ((7 + numSlots900 - 1) / numSlots900);
+
+    std::vector<padded_vector_uint8_t> bundles(numBundles);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(numBundles);
+    for (std::size_t i = 0; i < numBundles; ++i) {
+        Bpv6CbhePrimaryBlock& primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = i;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, bundleSizes[i], static_cast<uint8_t>(i)));
+    }
+
+    //0 => restore by scanning every segment, 1 => restore from the catalog journal
+    for (unsigned int journalMode = 0; journalMode < 2; ++journalMode) {
+        std::vector<bool> removed(numBundles, false);
+        {
+            StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+            ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+            ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+            ptrStorageConfig->m_catalogJournalFilePath = (journalMode) ? "catalog_journal_slabs.bin" : "";
+            ptrStorageConfig->m_smallBundleSlabMaxBytes = expectedNumSlabs * SEGMENT_SIZE;
+            BundleStorageManagerMT bsm(ptrStorageConfig);
+            bsm.Start();
+
+            for (std::size_t i = 0; i < numBundles; ++i) {
+                BundleStorageManagerSession_WriteToDisk sessionWrite;
+                const uint64_t expectedSegments = (i == 37) ? 3 : 1;
+                BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), expectedSegments);
+                BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+                BOOST_REQUIRE_EQUAL(bsm.GetCatalogEntryPtrFromCustodyId(i)->IsInSmallBundleSlab(), (i < 37));
+            }
+            BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), expectedNumSlabs);
+            BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), (expectedNumSlabs + 3 + 1) * SEGMENT_SIZE);
+            //the 37 small bundles cost one write per slab, not one per bundle
+            BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundleSlabSegmentsWritten, 0);
+            BOOST_REQUIRE_EQUAL(bsm.FlushSmallBundleSlabs(boost::posix_time::microsec_clock::universal_time() - boost::posix_time::seconds(1)), 0); //not yet due
+            BOOST_REQUIRE_EQUAL(bsm.FlushSmallBundleSlabs(boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(1)), expectedNumSlabs);
+            BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundleSlabSegmentsWritten, expectedNumSlabs);
+
+            //release every 200 byte bundle but only remove the first 5, then remove the 900 byte bundles of the first 1024-byte-slot slab (which frees that slab)
+            BundleStorageManagerSession_ReadFromDisk sessionRead;
+            padded_vector_uint8_t dataReadBack;
+            for (std::size_t i = 0; i < 30 + numSlots900; ++i) {
+                BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+                BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+                BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+                BOOST_REQUIRE(dataReadBack == bundles[i]);
+                std::vector<uint8_t> firstSegment;
+                BOOST_REQUIRE(bsm.ReadFirstSegment(sessionRead, sessionRead.catalogEntryPtr, firstSegment));
+                BOOST_REQUIRE(std::equal(firstSegment.cbegin(), firstSegment.cend(), bundles[i].cbegin()));
+                if ((i < 5) || (i >= 30)) {
+                    BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+                    removed[i] = true;
                 }
-                BundleStorageManagerBase & bsm = *bsmPtr;
+                BOOST_REQUIRE(!bsm.RemoveReadBundleFromDisk(i + 1000)); //not in the catalog
+            }
+            BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), expectedNumSlabs - 1);
 
+            //a freed slot is reused by the next bundle of its size class
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[0], bundles[0].size(), 0), 1);
+            BOOST_REQUIRE_EQUAL(sessionWrite.catalogEntry.GetSmallBundleSlabSlotIndex(), 0);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[0], 0, bundles[0].data(), bundles[0].size()), bundles[0].size());
+            removed[0] = false;
+
+            //the freed slab's head was destroyed right away, and the slab whose slots changed is written once
+            BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundleSlabSegmentsWritten, expectedNumSlabs + 1);
+            BOOST_REQUIRE_EQUAL(bsm.FlushAllSmallBundleSlabs(), 1);
+            BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundleSlabSegmentsWritten, expectedNumSlabs + 2);
+        }
 
+        //only the bundles never removed are restored, and the slabs are rebuilt from the disk
+        {
+            StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+            ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+            ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+            ptrStorageConfig->m_catalogJournalFilePath = (journalMode) ? "catalog_journal_slabs.bin" : "";
+            ptrStorageConfig->m_smallBundleSlabMaxBytes = expectedNumSlabs * SEGMENT_SIZE;
+            BundleStorageManagerMT bsm(ptrStorageConfig);
+            BOOST_REQUIRE(bsm.m_successfullyRestoredFromDisk);
+            BOOST_REQUIRE_EQUAL(bsm.m_successfullyRestoredFromCatalogJournal, (journalMode != 0));
+            const std::size_t numRemoved = static_cast<std::size_t>(std::count(removed.cbegin(), removed.cend(), true));
+            BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, numBundles - numRemoved);
+            BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), expectedNumSlabs - 1);
+            BOOST_REQUIRE_EQUAL(bsm.m_totalSegmentsRestored, (expectedNumSlabs - 1) + 3 + 1);
+            BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundlesDroppedFromRestore, 0);
+            bsm.Start();
+
+            BundleStorageManagerSession_ReadFromDisk sessionRead;
+            padded_vector_uint8_t dataReadBack;
+            std::vector<bool> restored(numBundles, false);
+            for (std::size_t n = 0; n < numBundles - numRemoved; ++n) {
+                BOOST_REQUIRE_GT(bsm.PopTop(sessionRead, availableDestLinks), 0);
+                const uint64_t custodyId = sessionRead.custodyId;
+                BOOST_REQUIRE_LT(custodyId, numBundles);
+                BOOST_REQUIRE(!removed[custodyId]);
+                BOOST_REQUIRE(!restored[custodyId]);
+                restored[custodyId] = true;
+                BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+                BOOST_REQUIRE(dataReadBack == bundles[custodyId]);
+                BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+            }
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+            BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), 0);
+            BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), 0);
+        }
+    }
+}
 
-                //BOOST_REQUIRE(!bsm.GetMemoryManagerConstRef().IsBackupEqual(backup));
-                BOOST_REQUIRE_MESSAGE(bsm.m_successfullyRestoredFromDisk, "error restoring from disk");
-                BOOST_REQUIRE(bsm.GetMemoryManagerConstRef().IsBackupEqual(backup));
-                std::cout << "restored\n";
-                BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, (15 - 1));
-                BOOST_REQUIRE_EQUAL(bsm.m_totalBytesRestored, bytesWritten);
-                BOOST_REQUIRE_EQUAL(bsm.m_totalSegmentsRestored, totalSegmentsWritten);
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_SmallBundleSlabsUnwrittenSlot_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    //4 bundles in a slab which is written, 2 more in that slab's mirror and 2 in a new slab which are journaled but
+    //never written (the storage is destroyed without a flush, as by a crash), and 1 bundle too large for a slab
+    std::vector<uint64_t> bundleSizes(6, 200);
+    bundleSizes.insert(bundleSizes.end(), 2, 900);
+    bundleSizes.push_back(BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1);
+    const std::size_t numBundles = bundleSizes.size();
+    const std::size_t numBundlesWritten = 4;
+    const uint64_t largeBundleCustodyId = numBundles - 1;
+
+    std::vector<padded_vector_uint8_t> bundles(numBundles);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(numBundles);
+    for (std::size_t i = 0; i < numBundles; ++i) {
+        Bpv6CbhePrimaryBlock& primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = i;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, bundleSizes[i], static_cast<uint8_t>(i)));
+    }
 
-                bsm.Start();
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_slabs_unwritten.bin";
+        ptrStorageConfig->m_smallBundleSlabMaxBytes = 10 * SEGMENT_SIZE;
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        bsm.Start();
+        for (std::size_t i = 0; i < numBundles; ++i) {
+            if (i == numBundlesWritten) {
+                BOOST_REQUIRE_EQUAL(bsm.FlushAllSmallBundleSlabs(), 1);
+            }
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_GT(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 0);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+            BOOST_REQUIRE_EQUAL(bsm.GetCatalogEntryPtrFromCustodyId(i)->IsInSmallBundleSlab(), (i != largeBundleCustodyId));
+        }
+        BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), 2);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundleSlabSegmentsWritten, 1);
+    }
 
+    //only the bundles whose slots were written are restored, the others are dropped instead of failing the restore
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_slabs_unwritten.bin";
+        ptrStorageConfig->m_smallBundleSlabMaxBytes = 10 * SEGMENT_SIZE;
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromDisk);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromCatalogJournal);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalSmallBundlesDroppedFromRestore, numBundles - numBundlesWritten - 1);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, numBundlesWritten + 1);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBytesRestored, (numBundlesWritten * 200) + bundleSizes[largeBundleCustodyId]);
+        BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), 1); //the slab never written is freed
+        BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), (1 + 2) * SEGMENT_SIZE);
+        for (uint64_t custodyId = numBundlesWritten; custodyId < largeBundleCustodyId; ++custodyId) {
+            BOOST_REQUIRE(bsm.GetCatalogEntryPtrFromCustodyId(custodyId) == NULL);
+        }
+        bsm.Start();
 
-                BOOST_REQUIRE_EQUAL(mapBundleSizeToBundleData.size(), 15 - 1);
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        std::vector<uint64_t> custodyIdsRead;
+        while (bsm.PopTop(sessionRead, availableDestLinks)) {
+            custodyIdsRead.push_back(sessionRead.custodyId);
+            BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+            BOOST_REQUIRE(dataReadBack == bundles[sessionRead.custodyId]);
+            BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        }
+        BOOST_REQUIRE(custodyIdsRead == std::vector<uint64_t>({ 0, 1, 2, 3, largeBundleCustodyId }));
+        BOOST_REQUIRE_EQUAL(bsm.GetNumSmallBundleSlabs(), 0);
+        BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), 0);
+    }
+}
 
-                uint64_t totalBytesReadFromRestored = 0, totalSegmentsReadFromRestored = 0;
-                BundleStorageManagerSession_ReadFromDisk sessionRead; //contains heap allocation so reuse it
-                for (unsigned int sizeI = 0; sizeI < (15 - 1); ++sizeI) {
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_CatalogJournalUnwrittenSegments_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    //3 bundles of 3 segments each are journaled and written, then (as if storage crashed before their writes completed)
+    //the first segment of bundle 1 and the last segment of bundle 2 are wiped from the disks
+    static const uint64_t NUM_BUNDLES = 3;
+    const uint64_t bundleSize = (2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE) + 100;
+    std::vector<padded_vector_uint8_t> bundles(NUM_BUNDLES);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(NUM_BUNDLES);
+    for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+        Bpv6CbhePrimaryBlock& primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i;
+        primary.m_creationTimestamp.sequenceNumber = i;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, bundleSize, static_cast<uint8_t>(i)));
+    }
 
+    segment_id_t wipedSegmentIds[2];
+    std::vector<std::string> storeFilePaths;
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_segments_unwritten.bin";
+        for (std::size_t i = 0; i < ptrStorageConfig->m_storageDiskConfigVector.size(); ++i) {
+            storeFilePaths.push_back(ptrStorageConfig->m_storageDiskConfigVector[i].storeFilePath);
+        }
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        bsm.Start();
+        for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 3);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+        }
+        const segment_id_extents_vec_t & extentsOfBundle1 = bsm.GetCatalogEntryPtrFromCustodyId(1)->segmentIdExtentsVec;
+        const segment_id_extents_vec_t & extentsOfBundle2 = bsm.GetCatalogEntryPtrFromCustodyId(2)->segmentIdExtentsVec;
+        wipedSegmentIds[0] = extentsOfBundle1[0].beginSegmentId;
+        wipedSegmentIds[1] = extentsOfBundle2.back().beginSegmentId + (extentsOfBundle2.back().numSegments - 1);
+    }
+    for (unsigned int i = 0; i < 2; ++i) {
+        const segment_id_t segmentId = wipedSegmentIds[i];
+        std::fstream storeFile(storeFilePaths[segmentId % storeFilePaths.size()], std::fstream::in | std::fstream::out | std::fstream::binary);
+        BOOST_REQUIRE(storeFile.is_open());
+        storeFile.seekp(static_cast<std::streamoff>((segmentId / storeFilePaths.size()) * static_cast<uint64_t>(SEGMENT_SIZE)));
+        const std::vector<char> zeros(SEGMENT_RESERVED_SPACE, 0);
+        storeFile.write(zeros.data(), zeros.size());
+        BOOST_REQUIRE(storeFile.good());
+    }
 
-                    //std::cout << "reading\n";
-                    const uint64_t bytesToReadFromDisk = bsm.PopTop(sessionRead, availableDestLinks);
-                    //std::cout << "bytesToReadFromDisk " << bytesToReadFromDisk << "\n";
-                    BOOST_REQUIRE_NE(bytesToReadFromDisk, 0);
-                    padded_vector_uint8_t dataReadBack(bytesToReadFromDisk);
-                    totalBytesReadFromRestored += bytesToReadFromDisk;
+    //only bundle 0 is restored, the others are dropped (and their segments freed) instead of being released as garbage
+    {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "catalog_journal_segments_unwritten.bin";
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromDisk);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromCatalogJournal);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalUnwrittenBundlesDroppedFromRestore, 2);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, 1);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBytesRestored, bundles[0].size());
+        BOOST_REQUIRE_EQUAL(bsm.m_totalSegmentsRestored, 3);
+        BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), 3 * SEGMENT_SIZE);
+        BOOST_REQUIRE(bsm.GetCatalogEntryPtrFromCustodyId(1) == NULL);
+        BOOST_REQUIRE(bsm.GetCatalogEntryPtrFromCustodyId(2) == NULL);
+        bsm.Start();
 
-                    const std::size_t numSegmentsToRead = sessionRead.catalogEntryPtr->segmentIdChainVec.size();
-                    totalSegmentsReadFromRestored += numSegmentsToRead;
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[0].size());
+        BOOST_REQUIRE_EQUAL(sessionRead.custodyId, 0);
+        BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+        BOOST_REQUIRE(dataReadBack == bundles[0]);
+        BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+        BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), 0);
+    }
+}
 
-                    BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
-                    const std::size_t totalBytesRead = dataReadBack.size();
+#ifdef __linux__
+static uint64_t GetAllocatedBytesOfStoreFiles(const StorageConfig & storageConfig) {
+    uint64_t allocatedBytes = 0;
+    for (std::size_t i = 0; i < storageConfig.m_storageDiskConfigVector.size(); ++i) {
+        struct stat st;
+        if (stat(storageConfig.m_storageDiskConfigVector[i].storeFilePath.c_str(), &st) == 0) {
+            allocatedBytes += static_cast<uint64_t>(st.st_blocks) * 512;
+        }
+    }
+    return allocatedBytes;
+}
+#endif
 
-                    //std::cout << "totalBytesRead " << totalBytesRead << "\n";
-                    BOOST_REQUIRE_EQUAL(totalBytesRead, bytesToReadFromDisk);
-                    BOOST_REQUIRE_EQUAL(mapBundleSizeToBundleData.count(totalBytesRead), 1);
-                    BOOST_REQUIRE_EQUAL(mapBundleSizeToBundleData[totalBytesRead].size(), totalBytesRead);
-                    BOOST_REQUIRE(mapBundleSizeToBundleData[totalBytesRead] == dataReadBack);
-                    BOOST_REQUIRE_EQUAL(sessionRead.catalogEntryPtr->destEid.nodeId, mapBundleSizeToPrimary[totalBytesRead]->GetFinalDestinationEid().nodeId);
-                    BOOST_REQUIRE_EQUAL(sessionRead.catalogEntryPtr->GetPriorityIndex(), mapBundleSizeToPrimary[totalBytesRead]->GetPriority());
+BOOST_AUTO_TEST_CASE(BundleStorageManagerMT_DiskSpaceReclaimer_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    static const uint64_t TARGET_BUNDLE_SIZE = 2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1; //3 segments
+    static const unsigned int NUM_BUNDLES = 10;
+    std::vector<padded_vector_uint8_t> bundles(NUM_BUNDLES);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(NUM_BUNDLES);
+    for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+        Bpv6CbhePrimaryBlock & primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = i;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, TARGET_BUNDLE_SIZE, static_cast<uint8_t>(i)));
+    }
 
-                    BOOST_REQUIRE_MESSAGE(bsm.RemoveReadBundleFromDisk(sessionRead), "error freeing bundle from disk");
+    //0 => unlimited rate (every removed segment is reclaimed, then restored by scanning the disks with holes in them)
+    //1 => 1 byte per second (only the first run is reclaimed, the rest are freed without being reclaimed)
+    for (unsigned int rateMode = 0; rateMode < 2; ++rateMode) {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = (rateMode != 0); //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "";
+        ptrStorageConfig->m_diskSpaceReclaimMaxBytesPerSecond = (rateMode == 0) ? (static_cast<uint64_t>(1) << 40) : 1;
+        {
+            BundleStorageManagerMT bsm(ptrStorageConfig);
+            bsm.Start();
+            for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+                BundleStorageManagerSession_WriteToDisk sessionWrite;
+                BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 3);
+                BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+            }
+            BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), 3 * NUM_BUNDLES * SEGMENT_SIZE);
+
+            //read every bundle (so that every write has reached the disk) but only remove the even ones
+            BundleStorageManagerSession_ReadFromDisk sessionRead;
+            padded_vector_uint8_t dataReadBack;
+            for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+                BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+                BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+                BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+                BOOST_REQUIRE(dataReadBack == bundles[i]);
+                if ((i % 2) == 0) {
+                    BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+                }
+            }
+            bsm.WaitUntilRemovedSegmentsFreed();
+            BOOST_REQUIRE_EQUAL(bsm.GetUsedSpaceBytes(), 3 * (NUM_BUNDLES / 2) * SEGMENT_SIZE);
+            const uint64_t removedBytes = 3 * (NUM_BUNDLES / 2) * SEGMENT_SIZE;
+            BOOST_REQUIRE_EQUAL(bsm.GetTotalBytesReclaimedFromDisk() + bsm.GetTotalBytesFreedWithoutReclaiming(), removedBytes);
+#ifdef __linux__
+            if (rateMode == 0) {
+                BOOST_REQUIRE_EQUAL(bsm.GetTotalBytesReclaimedFromDisk(), removedBytes);
+                BOOST_REQUIRE_GE(bsm.GetTotalDiskSpaceReclaimOperations(), 2); //at least one per disk
+                BOOST_REQUIRE_LE(bsm.GetTotalDiskSpaceReclaimOperations(), 3 * (NUM_BUNDLES / 2));
+                //every removed segment is a hole, except for those rewritten by a removed bundle's head segment tombstone after its hole was punched
+                BOOST_REQUIRE_LE(GetAllocatedBytesOfStoreFiles(*ptrStorageConfig), (3 * NUM_BUNDLES * SEGMENT_SIZE) - removedBytes + ((NUM_BUNDLES / 2) * SEGMENT_SIZE));
+            }
+            else {
+                BOOST_REQUIRE_EQUAL(bsm.GetTotalDiskSpaceReclaimOperations(), 1); //then out of tokens
+                BOOST_REQUIRE_GT(bsm.GetTotalBytesFreedWithoutReclaiming(), 0);
+            }
+#endif
+            //freed segments are allocated again
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[0], bundles[0].size(), 0), 3);
+            BOOST_REQUIRE_EQUAL(sessionWrite.catalogEntry.segmentIdExtentsVec[0].beginSegmentId, 0);
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[0], 0, bundles[0].data(), bundles[0].size()), bundles[0].size());
+        }
+        if (rateMode != 0) {
+            continue;
+        }
 
+        //the odd bundles and the rewritten bundle 0 are restored from disks with holes punched in them
+        ptrStorageConfig->m_tryToRestoreFromDisk = true; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        BundleStorageManagerMT bsm(ptrStorageConfig);
+        BOOST_REQUIRE(bsm.m_successfullyRestoredFromDisk);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, (NUM_BUNDLES / 2) + 1);
+        BOOST_REQUIRE_EQUAL(bsm.m_totalSegmentsRestored, 3 * ((NUM_BUNDLES / 2) + 1));
+        bsm.Start();
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        std::vector<bool> restored(NUM_BUNDLES, false);
+        for (unsigned int n = 0; n < (NUM_BUNDLES / 2) + 1; ++n) {
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), TARGET_BUNDLE_SIZE);
+            const uint64_t custodyId = sessionRead.custodyId;
+            BOOST_REQUIRE_LT(custodyId, NUM_BUNDLES);
+            BOOST_REQUIRE((custodyId == 0) || ((custodyId % 2) == 1));
+            BOOST_REQUIRE(!restored[custodyId]);
+            restored[custodyId] = true;
+            BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+            BOOST_REQUIRE(dataReadBack == bundles[custodyId]);
+            BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        }
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BundleStorageManager_BlockDeviceProbe_TestCase)
+{
+    //only a block device (never a store file, a missing path or a character device) has a probed size
+    uint64_t blockDeviceSizeBytes = 1;
+    BOOST_REQUIRE(BundleStorageManagerBase::GetBlockDeviceSizeBytes("storeFileThatDoesNotExist.bin", blockDeviceSizeBytes));
+    BOOST_REQUIRE_EQUAL(blockDeviceSizeBytes, 0);
+    const boost::filesystem::path sourceFilePath = Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json";
+    blockDeviceSizeBytes = 1;
+    BOOST_REQUIRE(BundleStorageManagerBase::GetBlockDeviceSizeBytes(sourceFilePath, blockDeviceSizeBytes));
+    BOOST_REQUIRE_EQUAL(blockDeviceSizeBytes, 0);
+#ifdef __linux__
+    blockDeviceSizeBytes = 1;
+    BOOST_REQUIRE(BundleStorageManagerBase::GetBlockDeviceSizeBytes("/dev/null", blockDeviceSizeBytes));
+    BOOST_REQUIRE_EQUAL(blockDeviceSizeBytes, 0);
+#endif
+
+    StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(sourceFilePath);
+    ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+    ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+    ptrStorageConfig->m_catalogJournalFilePath = "";
+    BundleStorageManagerMT bsm(ptrStorageConfig);
+    BOOST_REQUIRE_GE(bsm.GetPerDiskCapacityBytes() * bsm.M_NUM_STORAGE_DISKS, bsm.GetTotalCapacityBytes());
+    for (unsigned int diskId = 0; diskId < bsm.M_NUM_STORAGE_DISKS; ++diskId) {
+        BOOST_REQUIRE(!bsm.IsBlockDevice(diskId));
+    }
+    BOOST_REQUIRE(bsm.HasValidStorageConfig());
+}
+
+BOOST_AUTO_TEST_CASE(BundleStorageManager_AdaptiveDiskStriping_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    static const uint64_t TARGET_BUNDLE_SIZE = 2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 1; //3 segments
+    static const unsigned int NUM_BUNDLES = 200;
+    std::vector<padded_vector_uint8_t> bundles(NUM_BUNDLES);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(NUM_BUNDLES);
+    for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+        Bpv6CbhePrimaryBlock & primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = i;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, TARGET_BUNDLE_SIZE, static_cast<uint8_t>(i)));
+    }
+
+    //disk 0 measures 10 times faster than disk 1 (the ram implementation never reports completions of its own)
+    for (unsigned int adaptive = 0; adaptive < 2; ++adaptive) {
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        ptrStorageConfig->m_catalogJournalFilePath = "";
+        ptrStorageConfig->m_adaptiveDiskStriping = (adaptive != 0);
+        BundleStorageManagerRam bsm(ptrStorageConfig);
+        BOOST_REQUIRE_EQUAL(bsm.M_NUM_STORAGE_DISKS, 2);
+        bsm.Start();
+        bsm.RecordDiskOperationCompleted(0, 100000000, 1000000);
+        bsm.RecordDiskOperationCompleted(1, 10000000, 1000000);
+        BOOST_REQUIRE(bsm.GetDiskThroughputBytesPerSecond() == std::vector<uint64_t>({ 100000000, 10000000 }));
+
+        std::vector<uint64_t> numSegmentsPerDisk(2, 0);
+        for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+            BundleStorageManagerSession_WriteToDisk sessionWrite;
+            BOOST_REQUIRE_EQUAL(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 3);
+            const segment_id_extents_vec_t & extentsVec = sessionWrite.catalogEntry.segmentIdExtentsVec;
+            for (std::size_t j = 0; j < extentsVec.size(); ++j) {
+                for (segment_id_t segmentId = extentsVec[j].beginSegmentId; segmentId < (extentsVec[j].beginSegmentId + extentsVec[j].numSegments); ++segmentId) {
+                    ++numSegmentsPerDisk[segmentId % 2];
                 }
+            }
+            BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+            BOOST_REQUIRE_NE(bsm.GetAdaptiveStripingAllowedDisksMask() & 3, 0);
+        }
+        BOOST_REQUIRE_EQUAL(numSegmentsPerDisk[0] + numSegmentsPerDisk[1], 3 * NUM_BUNDLES);
+        if (adaptive) {
+            //about ten segments on the fast disk for every one on the slow disk
+            BOOST_REQUIRE_GT(numSegmentsPerDisk[0], 6 * numSegmentsPerDisk[1]);
+            BOOST_REQUIRE_GT(numSegmentsPerDisk[1], 0);
+        }
+        else {
+            BOOST_REQUIRE_LE(std::max(numSegmentsPerDisk[0], numSegmentsPerDisk[1]) - std::min(numSegmentsPerDisk[0], numSegmentsPerDisk[1]), 1);
+            BOOST_REQUIRE_EQUAL(bsm.GetAdaptiveStripingAllowedDisksMask(), 3);
+        }
 
-                BOOST_REQUIRE_EQUAL(totalBytesReadFromRestored, bytesWritten);
-                BOOST_REQUIRE_EQUAL(totalSegmentsReadFromRestored, totalSegmentsWritten);
+        BundleStorageManagerSession_ReadFromDisk sessionRead;
+        padded_vector_uint8_t dataReadBack;
+        for (unsigned int i = 0; i < NUM_BUNDLES; ++i) {
+            BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+            BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+            BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+            BOOST_REQUIRE(dataReadBack == bundles[i]);
+            BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+        }
+        BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), 0);
+    }
+}
 
+BOOST_AUTO_TEST_CASE(BundleStorageManager_ReleaseBuffer_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    //one segment, an exact number of segments, and more segments than the reads a session keeps outstanding
+    static const uint64_t BUNDLE_SIZES[3] = {
+        500,
+        2 * BUNDLE_STORAGE_PER_SEGMENT_SIZE,
+        (READ_CACHE_NUM_SEGMENTS_PER_SESSION + 10) * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 7
+    };
+    std::vector<padded_vector_uint8_t> bundles(3);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(3);
+    for (unsigned int i = 0; i < 3; ++i) {
+        Bpv6CbhePrimaryBlock& primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, BUNDLE_SIZES[i], static_cast<uint8_t>(i * 50)));
+    }
 
+    for (unsigned int whichBsm = 0; whichBsm < NUM_BSM_IMPLEMENTATIONS; ++whichBsm) {
+        std::unique_ptr<BundleStorageManagerBase> bsmPtr;
+        StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+        ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+        ptrStorageConfig->m_autoDeleteFilesOnExit = true; //manually set this json entry
+        if (whichBsm == 0) {
+            bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
+        }
+        else if (whichBsm == 1) {
+            bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
+        }
+        else if (whichBsm == WHICH_BSM_RAM) {
+            bsmPtr = boost::make_unique<BundleStorageManagerRam>(ptrStorageConfig);
+        }
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+        else {
+            bsmPtr = boost::make_unique<BundleStorageManagerIoUring>(ptrStorageConfig);
+        }
+#endif
+        BundleStorageManagerBase & bsm = *bsmPtr;
+        bsm.Start();
+        std::shared_ptr<ReleaseBufferPool> poolPtr = ReleaseBufferPool::Create(RELEASE_BUFFER_POOL_MAX_FREE_BYTES);
+
+        //each bundle is released twice, once read on this thread and once (from a copy of its entry) on another thread
+        for (unsigned int pass = 0; pass < 2; ++pass) {
+            for (unsigned int i = 0; i < 3; ++i) {
+                BundleStorageManagerSession_WriteToDisk sessionWrite;
+                const uint64_t custodyId = (pass * 3) + i;
+                BOOST_REQUIRE_GT(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 0);
+                BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], custodyId, bundles[i].data(), bundles[i].size()), bundles[i].size());
+            }
+            BundleStorageManagerSession_ReadFromDisk sessionRead;
+            for (unsigned int i = 0; i < 3; ++i) {
+                const uint64_t custodyId = (pass * 3) + i;
+                BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+                BOOST_REQUIRE_EQUAL(sessionRead.custodyId, custodyId);
+                release_buffer_t* releaseBufferPtr = poolPtr->Acquire(bundles[i].size());
+                BOOST_REQUIRE(releaseBufferPtr != NULL);
+                BOOST_REQUIRE_EQUAL(reinterpret_cast<uintptr_t>(releaseBufferPtr->data) % SEGMENT_BUFFER_ALIGNMENT, 0);
+                bool success;
+                if (pass == 0) {
+                    success = bsm.ReadAllSegmentsIntoReleaseBuffer(sessionRead, *releaseBufferPtr);
+                }
+                else {
+                    const catalog_entry_t releasedEntry = *sessionRead.catalogEntryPtr;
+                    boost::thread readerThread([&]() {
+                        BundleStorageManagerSession_ReadFromDisk sessionReadThreadSafe;
+                        sessionReadThreadSafe.catalogEntryPtr = const_cast<catalog_entry_t*>(&releasedEntry);
+                        sessionReadThreadSafe.custodyId = custodyId;
+                        success = bsm.ReadAllSegmentsFromDiskIntoReleaseBuffer_ThreadSafe(sessionReadThreadSafe, *releaseBufferPtr);
+                    });
+                    readerThread.join();
+                }
+                BOOST_REQUIRE(success);
+                BOOST_REQUIRE_EQUAL(releaseBufferPtr->size, bundles[i].size());
+                BOOST_REQUIRE(memcmp(releaseBufferPtr->data, bundles[i].data(), bundles[i].size()) == 0);
+                ReleaseBufferPool::ZmqFreeCallback(releaseBufferPtr->data, releaseBufferPtr);
+                BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+            }
+        }
+        //the second pass reused the buffers of the first
+        BOOST_REQUIRE_EQUAL(poolPtr->GetNumBuffersAllocated(), 3);
+        BOOST_REQUIRE_EQUAL(poolPtr->GetNumBuffersReused(), 3);
+    }
+}
+
+#ifndef _WIN32
+//a storage implementation whose OpenStorageDiskFile behaves as if every file system rejects O_DIRECT
+template <class BsmType>
+class BundleStorageManagerRejectingDirectIo : public BsmType {
+public:
+    BundleStorageManagerRejectingDirectIo(const StorageConfig_ptr & storageConfigPtr) : BsmType(storageConfigPtr) {
+        this->m_simulateFileSystemRejectsDirectIo = true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(BundleStorageManager_DirectIo_TestCase)
+{
+    const std::vector<cbhe_eid_t> availableDestLinks = { cbhe_eid_t(1,1) };
+    //one partial segment, one whole segment, and enough segments to coalesce
+    static const uint64_t BUNDLE_SIZES[3] = {
+        500,
+        BUNDLE_STORAGE_PER_SEGMENT_SIZE,
+        20 * BUNDLE_STORAGE_PER_SEGMENT_SIZE + 7
+    };
+    std::vector<padded_vector_uint8_t> bundles(3);
+    std::vector<Bpv6CbhePrimaryBlock> primaries(3);
+    for (unsigned int i = 0; i < 3; ++i) {
+        Bpv6CbhePrimaryBlock& primary = primaries[i];
+        primary.SetZero();
+        primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_NORMAL | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+        primary.m_sourceNodeId.Set(PRIMARY_SRC_NODE, PRIMARY_SRC_SVC);
+        primary.m_destinationEid = availableDestLinks[0];
+        primary.m_creationTimestamp.secondsSinceStartOfYear2000 = 0;
+        primary.m_lifetimeSeconds = 1000 + i; //released in push order
+        primary.m_creationTimestamp.sequenceNumber = PRIMARY_SEQ;
+        BOOST_REQUIRE(GenerateBundle(bundles[i], primary, BUNDLE_SIZES[i], static_cast<uint8_t>(i * 50)));
+    }
 
+    //the file backed implementations, first on file systems which accept O_DIRECT, then on ones which reject it (Start fails)
+    for (unsigned int whichBsm = 0; whichBsm < NUM_BSM_IMPLEMENTATIONS; ++whichBsm) {
+        if (whichBsm == WHICH_BSM_RAM) {
+            continue;
+        }
+        for (unsigned int rejectsDirectIo = 0; rejectsDirectIo < 2; ++rejectsDirectIo) {
+            StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+            ptrStorageConfig->m_tryToRestoreFromDisk = false; //manually set this json entry
+            ptrStorageConfig->m_autoDeleteFilesOnExit = false; //manually set this json entry
+            ptrStorageConfig->m_catalogJournalFilePath = "";
+            for (std::size_t diskId = 0; diskId < ptrStorageConfig->m_storageDiskConfigVector.size(); ++diskId) {
+                ptrStorageConfig->m_storageDiskConfigVector[diskId].useDirectIo = true;
+            }
+
+            //store the bundles and read them back through the disks
+            for (unsigned int restore = 0; restore < 2; ++restore) {
+                ptrStorageConfig->m_tryToRestoreFromDisk = (restore != 0);
+                ptrStorageConfig->m_autoDeleteFilesOnExit = (restore != 0);
+                std::unique_ptr<BundleStorageManagerBase> bsmPtr;
+                if (whichBsm == 0) {
+                    if (rejectsDirectIo) {
+                        bsmPtr = boost::make_unique<BundleStorageManagerRejectingDirectIo<BundleStorageManagerMT> >(ptrStorageConfig);
+                    }
+                    else {
+                        bsmPtr = boost::make_unique<BundleStorageManagerMT>(ptrStorageConfig);
+                    }
+                }
+                else if (whichBsm == 1) {
+                    if (rejectsDirectIo) {
+                        bsmPtr = boost::make_unique<BundleStorageManagerRejectingDirectIo<BundleStorageManagerAsio> >(ptrStorageConfig);
+                    }
+                    else {
+                        bsmPtr = boost::make_unique<BundleStorageManagerAsio>(ptrStorageConfig);
+                    }
+                }
+#ifdef STORAGE_IO_URING_SUPPORT_ENABLED
+                else {
+                    if (rejectsDirectIo) {
+                        bsmPtr = boost::make_unique<BundleStorageManagerRejectingDirectIo<BundleStorageManagerIoUring> >(ptrStorageConfig);
+                    }
+                    else {
+                        bsmPtr = boost::make_unique<BundleStorageManagerIoUring>(ptrStorageConfig);
+                    }
+                }
+#endif
+                BundleStorageManagerBase& bsm = *bsmPtr;
+                BOOST_REQUIRE_EQUAL(bsm.m_successfullyRestoredFromDisk, (restore != 0));
+                bsm.Start();
+                for (unsigned int diskId = 0; diskId < bsm.M_NUM_STORAGE_DISKS; ++diskId) {
+                    BOOST_REQUIRE_EQUAL(bsm.IsDirectIoActive(diskId), (rejectsDirectIo == 0));
+                }
+                if (rejectsDirectIo) {
+                    break; //no silent fallback to buffered I/O: Start failed without opening the disks, so nothing can be stored
+                }
+                if (restore == 0) {
+                    for (unsigned int i = 0; i < 3; ++i) {
+                        BundleStorageManagerSession_WriteToDisk sessionWrite;
+                        BOOST_REQUIRE_GT(bsm.Push(sessionWrite, primaries[i], bundles[i].size(), 0), 0);
+                        BOOST_REQUIRE_EQUAL(bsm.PushAllSegments(sessionWrite, primaries[i], i, bundles[i].data(), bundles[i].size()), bundles[i].size());
+                    }
+                }
+                else {
+                    BOOST_REQUIRE_EQUAL(bsm.m_totalBundlesRestored, 3);
+                }
+                BundleStorageManagerSession_ReadFromDisk sessionRead;
+                padded_vector_uint8_t dataReadBack;
+                for (unsigned int i = 0; i < 3; ++i) {
+                    BOOST_REQUIRE_EQUAL(bsm.PopTop(sessionRead, availableDestLinks), bundles[i].size());
+                    BOOST_REQUIRE_EQUAL(sessionRead.custodyId, i);
+                    BOOST_REQUIRE(bsm.ReadAllSegments(sessionRead, dataReadBack));
+                    BOOST_REQUIRE(dataReadBack == bundles[i]);
+                    if (restore != 0) {
+                        BOOST_REQUIRE(bsm.RemoveReadBundleFromDisk(sessionRead));
+                    } //else kept on the disks for the restore
+                }
             }
         }
     }
 }
+#endif
+
+//exposes the disk circular buffers so that queued segment operations can be staged without any consumer draining them
+class BundleStorageManagerCoalescingTester : public BundleStorageManagerBase {
+public:
+    BundleStorageManagerCoalescingTester(const StorageConfig_ptr & storageConfigPtr) : BundleStorageManagerBase(storageConfigPtr) {}
+    virtual ~BundleStorageManagerCoalescingTester() override {}
+    virtual void Start() override {}
+    void QueueOperation(const unsigned int diskId, const segment_id_t segmentId, const bool isWriteToDisk) {
+        CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskId];
+        const unsigned int produceIndex = cb.GetIndexForWrite();
+        BOOST_REQUIRE_NE(produceIndex, CIRCULAR_INDEX_BUFFER_FULL);
+        m_circularBufferSegmentIdsPtr[diskId * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex] = segmentId;
+        m_circularBufferReadFromStoragePointers[diskId * CIRCULAR_INDEX_BUFFER_SIZE + produceIndex] = (isWriteToDisk) ? NULL : m_dummyReadBuffer;
+        cb.CommitWrite();
+    }
+    unsigned int ConsumeCoalescedOperations(const unsigned int diskId) { //returns the number merged into the next I/O
+        CircularIndexBufferSingleProducerSingleConsumerConfigurable & cb = m_circularIndexBuffersVec[diskId];
+        const unsigned int consumeIndex = cb.GetIndexForRead();
+        BOOST_REQUIRE_NE(consumeIndex, CIRCULAR_INDEX_BUFFER_EMPTY);
+        const unsigned int numOperations = GetNumCoalescableDiskOperations(diskId, consumeIndex);
+        for (unsigned int i = 0; i < numOperations; ++i) {
+            cb.CommitRead();
+        }
+        return numOperations;
+    }
+    unsigned int NumQueued(const unsigned int diskId) const {
+        return m_circularIndexBuffersVec[diskId].NumInBuffer();
+    }
+    unsigned int NextConsumeIndex(const unsigned int diskId) const {
+        return m_circularIndexBuffersVec[diskId].GetIndexForRead();
+    }
+private:
+    virtual void CommitWriteAndNotifyDiskOfWorkToDo_ThreadSafe(const unsigned int) override {}
+    uint8_t m_dummyReadBuffer[1];
+};
+
+BOOST_AUTO_TEST_CASE(BundleStorageManager_CoalescedDiskIo_TestCase)
+{
+    static const unsigned int MAX_SEGMENTS_PER_IO = 8;
+    StorageConfig_ptr ptrStorageConfig = StorageConfig::CreateFromJsonFilePath(
+        (Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json"));
+    BOOST_REQUIRE(ptrStorageConfig);
+    ptrStorageConfig->m_tryToRestoreFromDisk = false;
+    ptrStorageConfig->m_autoDeleteFilesOnExit = false; //the tester never creates the store files
+    ptrStorageConfig->m_catalogJournalFilePath.clear();
+    ptrStorageConfig->m_maxCoalescedDiskIoSizeBytes = MAX_SEGMENTS_PER_IO * SEGMENT_SIZE;
+    BundleStorageManagerCoalescingTester bsm(ptrStorageConfig);
+    const unsigned int numDisks = bsm.M_NUM_STORAGE_DISKS;
+    BOOST_REQUIRE_EQUAL(numDisks, 2);
+    BOOST_REQUIRE_EQUAL(bsm.M_MAX_SEGMENTS_PER_DISK_IO, MAX_SEGMENTS_PER_IO);
+    const unsigned int diskId = 1;
+
+    //adjacent writes on a disk (segment ids numDisks apart) merge into one I/O
+    for (unsigned int i = 0; i < 5; ++i) {
+        bsm.QueueOperation(diskId, diskId + (i * numDisks), true);
+    }
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 5);
+    BOOST_REQUIRE_EQUAL(bsm.NumQueued(diskId), 0);
+
+    //a lone operation is not merged
+    bsm.QueueOperation(diskId, 101, true);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 1);
+
+    //a run longer than maxCoalescedDiskIoSizeBytes is split
+    for (unsigned int i = 0; i < 20; ++i) {
+        bsm.QueueOperation(diskId, 201 + (i * numDisks), true);
+    }
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), MAX_SEGMENTS_PER_IO);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), MAX_SEGMENTS_PER_IO);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 4);
+
+    //non-contiguous segment ids break the run: a gap, consecutive ids (which are on different disks), and a descending id
+    const segment_id_t nonContiguousIds[] = { 301, 303, 307, 309, 310, 311, 309 };
+    for (std::size_t i = 0; i < sizeof(nonContiguousIds) / sizeof(nonContiguousIds[0]); ++i) {
+        bsm.QueueOperation(diskId, nonContiguousIds[i], true);
+    }
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 2); //301, 303
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 2); //307, 309
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 1); //310
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 1); //311
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 1); //309
+    BOOST_REQUIRE_EQUAL(bsm.NumQueued(diskId), 0);
+
+    //adjacent segments of different directions are never merged
+    bsm.QueueOperation(diskId, 401, true);
+    bsm.QueueOperation(diskId, 403, true);
+    bsm.QueueOperation(diskId, 405, false);
+    bsm.QueueOperation(diskId, 407, false);
+    bsm.QueueOperation(diskId, 409, false);
+    bsm.QueueOperation(diskId, 411, true);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 2);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 3);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 1);
+
+    //a run which wraps around the end of the circular buffer is still merged
+    const unsigned int stagedSoFar = 5 + 1 + 20 + 7 + 6;
+    const unsigned int toEndOfRing = CIRCULAR_INDEX_BUFFER_SIZE - (stagedSoFar % CIRCULAR_INDEX_BUFFER_SIZE);
+    for (unsigned int i = 0; i < toEndOfRing - 3; ++i) { //leave 3 slots before the end
+        bsm.QueueOperation(diskId, 1001 + (i * 2 * numDisks), true); //never adjacent
+        BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 1);
+    }
+    for (unsigned int i = 0; i < 6; ++i) {
+        bsm.QueueOperation(diskId, 2001 + (i * numDisks), false);
+    }
+    BOOST_REQUIRE_EQUAL(bsm.NextConsumeIndex(diskId), CIRCULAR_INDEX_BUFFER_SIZE - 3);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(diskId), 6);
+
+    //a full circular buffer is merged at most M_MAX_SEGMENTS_PER_DISK_IO at a time, and the other disk is unaffected
+    const unsigned int circularBufferCapacity = CIRCULAR_INDEX_BUFFER_SIZE - 1;
+    for (unsigned int i = 0; i < circularBufferCapacity; ++i) {
+        bsm.QueueOperation(diskId, 3001 + (i * numDisks), true);
+    }
+    bsm.QueueOperation(0, 3000, true);
+    unsigned int totalConsumed = 0;
+    while (bsm.NumQueued(diskId)) {
+        const unsigned int numOperations = bsm.ConsumeCoalescedOperations(diskId);
+        BOOST_REQUIRE_LE(numOperations, MAX_SEGMENTS_PER_IO);
+        totalConsumed += numOperations;
+    }
+    BOOST_REQUIRE_EQUAL(totalConsumed, circularBufferCapacity);
+    BOOST_REQUIRE_EQUAL(bsm.ConsumeCoalescedOperations(0), 1);
+}
@@ -337,3 +337,249 @@ BOOST_AUTO_TEST_CASE(MemoryManagerTreeArrayFullTestCase)
         BOOST_REQUIRE(t.AllocateSegmentId_NotThreadSafe(i));
     }
 }
+
+BOOST_AUTO_TEST_CASE(MemoryManagerTreeArrayExtentsTestCase)
+{
+    //the extent allocator must hand out exactly the same segment Ids as the per-segment allocator,
+    //so run both side by side on identically fragmented trees and compare
+    const uint64_t MAX_SEGMENTS = (64 * 64 * 3) + 17;
+    MemoryManagerTreeArray tSegments(MAX_SEGMENTS);
+    MemoryManagerTreeArray tExtents(MAX_SEGMENTS);
+    memmanager_t emptyBackup;
+    tExtents.BackupDataToVector(emptyBackup);
+
+    //fill both, then free a deterministic pseudo-random pattern of segments (runs of varying length)
+    segment_id_chain_vec_t allSegments(MAX_SEGMENTS);
+    BOOST_REQUIRE(tSegments.AllocateSegments_ThreadSafe(allSegments));
+    segment_id_extents_vec_t allExtents;
+    BOOST_REQUIRE(tExtents.AllocateSegmentExtents_ThreadSafe(MAX_SEGMENTS, allExtents));
+    BOOST_REQUIRE_EQUAL(allExtents.size(), 1);
+    BOOST_REQUIRE(allExtents[0] == segment_id_extent_t({ 0, static_cast<segment_id_t>(MAX_SEGMENTS) }));
+    BOOST_REQUIRE(tExtents.IsBackupEqual(tSegments.GetVectorsConstRef()));
+    BOOST_REQUIRE_EQUAL(tExtents.GetNumAllocatedSegments_NotThreadSafe(), MAX_SEGMENTS);
+    {
+        segment_id_extents_vec_t tooMany;
+        BOOST_REQUIRE(!tExtents.AllocateSegmentExtents_ThreadSafe(1, tooMany)); //full
+        BOOST_REQUIRE(tooMany.empty());
+    }
+    uint32_t lcg = 12345;
+    for (segment_id_t segmentId = 0; segmentId < MAX_SEGMENTS; ) {
+        lcg = lcg * 1103515245 + 12345;
+        const segment_id_t runLength = static_cast<segment_id_t>(((lcg >> 16) % 150) + 1);
+        const bool freeThisRun = (((lcg >> 8) & 1) != 0);
+        for (segment_id_t i = 0; (i < runLength) && (segmentId < MAX_SEGMENTS); ++i, ++segmentId) {
+            if (freeThisRun) {
+                BOOST_REQUIRE(tSegments.FreeSegmentId_NotThreadSafe(segmentId));
+                BOOST_REQUIRE(tExtents.FreeSegmentExtents_ThreadSafe(segment_id_extents_vec_t({ segment_id_extent_t({ segmentId, 1 }) })));
+            }
+        }
+    }
+    BOOST_REQUIRE(tExtents.IsBackupEqual(tSegments.GetVectorsConstRef()));
+    BOOST_REQUIRE_EQUAL(tExtents.GetNumAllocatedSegments_NotThreadSafe(), tSegments.GetNumAllocatedSegments_NotThreadSafe());
+
+    //more segments than are free must fail without modifying anything
+    {
+        memmanager_t backup;
+        tExtents.BackupDataToVector(backup);
+        segment_id_extents_vec_t extents;
+        BOOST_REQUIRE(!tExtents.AllocateSegmentExtents_ThreadSafe(MAX_SEGMENTS - tExtents.GetNumAllocatedSegments_NotThreadSafe() + 1, extents));
+        BOOST_REQUIRE(extents.empty());
+        BOOST_REQUIRE(tExtents.IsBackupEqual(backup));
+    }
+
+    std::vector<segment_id_extents_vec_t> allocatedExtentsVec;
+    std::vector<segment_id_chain_vec_t> allocatedSegmentsVec;
+    for (uint64_t numSegments = 1; ; numSegments += 7) {
+        segment_id_chain_vec_t segmentVec(numSegments);
+        segment_id_extents_vec_t extentsVec;
+        const bool successSegments = tSegments.AllocateSegments_ThreadSafe(segmentVec);
+        const bool successExtents = tExtents.AllocateSegmentExtents_ThreadSafe(numSegments, extentsVec);
+        BOOST_REQUIRE_EQUAL(successSegments, successExtents);
+        BOOST_REQUIRE(tExtents.IsBackupEqual(tSegments.GetVectorsConstRef()));
+        if (!successExtents) {
+            BOOST_REQUIRE(extentsVec.empty());
+            break;
+        }
+        //expand the extents and compare
+        segment_id_chain_vec_t expanded;
+        segment_id_extents_cursor_t cursor;
+        cursor.Reset();
+        for (segment_id_t segmentId = cursor.Get(extentsVec); segmentId != SEGMENT_ID_LAST; segmentId = cursor.Get(extentsVec)) {
+            expanded.push_back(segmentId);
+            cursor.Advance(extentsVec);
+        }
+        BOOST_REQUIRE(expanded == segmentVec);
+        for (std::size_t i = 1; i < extentsVec.size(); ++i) { //extents are maximal (never adjacent)
+            BOOST_REQUIRE_LT(extentsVec[i - 1].beginSegmentId + extentsVec[i - 1].numSegments, extentsVec[i].beginSegmentId);
+        }
+        //rebuilding extents one segment at a time (as in restore from disk) gives the same extents
+        segment_id_extents_vec_t rebuilt;
+        for (std::size_t i = 0; i < expanded.size(); ++i) {
+            AppendSegmentIdToExtents(rebuilt, expanded[i]);
+        }
+        BOOST_REQUIRE(rebuilt == extentsVec);
+        allocatedExtentsVec.push_back(std::move(extentsVec));
+        allocatedSegmentsVec.push_back(std::move(segmentVec));
+    }
+    BOOST_REQUIRE_GT(allocatedExtentsVec.size(), 5);
+
+    //free every other allocation, then everything
+    for (unsigned int pass = 0; pass < 2; ++pass) {
+        for (std::size_t i = pass; i < allocatedExtentsVec.size(); i += (2 - pass)) {
+            if (allocatedExtentsVec[i].empty()) continue;
+            BOOST_REQUIRE(tSegments.FreeSegments_ThreadSafe(allocatedSegmentsVec[i]));
+            BOOST_REQUIRE(tExtents.FreeSegmentExtents_ThreadSafe(allocatedExtentsVec[i]));
+            BOOST_REQUIRE(!tExtents.FreeSegmentExtents_ThreadSafe(allocatedExtentsVec[i])); //already free
+            BOOST_REQUIRE(tExtents.IsBackupEqual(tSegments.GetVectorsConstRef()));
+            allocatedExtentsVec[i].clear();
+        }
+    }
+    BOOST_REQUIRE(!tExtents.FreeSegmentExtents_ThreadSafe(segment_id_extents_vec_t({ segment_id_extent_t({ 0, static_cast<segment_id_t>(MAX_SEGMENTS + 1) }) }))); //out of range
+    segment_id_extents_vec_t remainingExtents;
+    for (segment_id_t segmentId = 0; segmentId < MAX_SEGMENTS; ++segmentId) {
+        if (!tExtents.IsSegmentFree(segmentId)) {
+            AppendSegmentIdToExtents(remainingExtents, segmentId);
+        }
+    }
+    BOOST_REQUIRE(tExtents.FreeSegmentExtents_ThreadSafe(remainingExtents));
+    BOOST_REQUIRE_EQUAL(tExtents.GetNumAllocatedSegments_NotThreadSafe(), 0);
+    BOOST_REQUIRE(tExtents.IsBackupEqual(emptyBackup));
+}
+
+BOOST_AUTO_TEST_CASE(MemoryManagerTreeArrayExtentsOnDisksTestCase)
+{
+    const uint64_t MAX_SEGMENTS = (64 * 64 * 2) + 5;
+    const unsigned int NUM_DISKS = 3;
+    MemoryManagerTreeArray t(MAX_SEGMENTS);
+    memmanager_t emptyBackup;
+    t.BackupDataToVector(emptyBackup);
+    std::vector<segment_id_extents_vec_t> allocatedExtentsVec;
+
+    //only segments on the allowed disks are taken while the scanned leaves have them
+    for (uint64_t allowedDisksMask = 1; allowedDisksMask < 7; ++allowedDisksMask) {
+        segment_id_extents_vec_t extentsVec;
+        BOOST_REQUIRE(t.AllocateSegmentExtentsOnDisks_ThreadSafe(100, NUM_DISKS, allowedDisksMask, extentsVec));
+        uint64_t numSegments = 0;
+        for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+            for (segment_id_t segmentId = extentsVec[i].beginSegmentId; segmentId < (extentsVec[i].beginSegmentId + extentsVec[i].numSegments); ++segmentId) {
+                BOOST_REQUIRE((allowedDisksMask >> (segmentId % NUM_DISKS)) & 1);
+                BOOST_REQUIRE(!t.IsSegmentFree(segmentId));
+                ++numSegments;
+            }
+        }
+        BOOST_REQUIRE_EQUAL(numSegments, 100);
+        allocatedExtentsVec.push_back(std::move(extentsVec));
+    }
+    BOOST_REQUIRE_EQUAL(t.GetNumAllocatedSegments_NotThreadSafe(), 600);
+
+    //all disks allowed (or none) is the same as AllocateSegmentExtents_ThreadSafe
+    {
+        MemoryManagerTreeArray tCompare(MAX_SEGMENTS);
+        for (segment_id_t segmentId = 0; segmentId < MAX_SEGMENTS; ++segmentId) {
+            if (!t.IsSegmentFree(segmentId)) {
+                BOOST_REQUIRE(tCompare.AllocateSegmentId_NotThreadSafe(segmentId));
+            }
+        }
+        BOOST_REQUIRE(t.IsBackupEqual(tCompare.GetVectorsConstRef()));
+        segment_id_extents_vec_t extentsVec;
+        segment_id_extents_vec_t compareExtentsVec;
+        BOOST_REQUIRE(t.AllocateSegmentExtentsOnDisks_ThreadSafe(50, NUM_DISKS, 7, extentsVec));
+        BOOST_REQUIRE(tCompare.AllocateSegmentExtents_ThreadSafe(50, compareExtentsVec));
+        BOOST_REQUIRE(extentsVec == compareExtentsVec);
+        allocatedExtentsVec.push_back(std::move(extentsVec));
+        extentsVec.clear();
+        compareExtentsVec.clear();
+        BOOST_REQUIRE(t.AllocateSegmentExtentsOnDisks_ThreadSafe(50, NUM_DISKS, 0, extentsVec));
+        BOOST_REQUIRE(tCompare.AllocateSegmentExtents_ThreadSafe(50, compareExtentsVec));
+        BOOST_REQUIRE(extentsVec == compareExtentsVec);
+        BOOST_REQUIRE(t.IsBackupEqual(tCompare.GetVectorsConstRef()));
+        allocatedExtentsVec.push_back(std::move(extentsVec));
+    }
+
+    //invalid disk counts fail
+    {
+        segment_id_extents_vec_t extentsVec;
+        BOOST_REQUIRE(!t.AllocateSegmentExtentsOnDisks_ThreadSafe(1, 0, 1, extentsVec));
+        BOOST_REQUIRE(!t.AllocateSegmentExtentsOnDisks_ThreadSafe(1, 65, 1, extentsVec));
+        BOOST_REQUIRE(extentsVec.empty());
+    }
+
+    //more segments than the allowed disks have falls back to any free segment, so only a full tree fails
+    {
+        const uint64_t numFree = MAX_SEGMENTS - t.GetNumAllocatedSegments_NotThreadSafe();
+        memmanager_t backup;
+        t.BackupDataToVector(backup);
+        segment_id_extents_vec_t extentsVec;
+        BOOST_REQUIRE(!t.AllocateSegmentExtentsOnDisks_ThreadSafe(numFree + 1, NUM_DISKS, 2, extentsVec));
+        BOOST_REQUIRE(extentsVec.empty());
+        BOOST_REQUIRE(t.IsBackupEqual(backup));
+        BOOST_REQUIRE(t.AllocateSegmentExtentsOnDisks_ThreadSafe(numFree, NUM_DISKS, 2, extentsVec));
+        BOOST_REQUIRE_EQUAL(t.GetNumAllocatedSegments_NotThreadSafe(), MAX_SEGMENTS);
+        uint64_t numSegments = 0;
+        for (std::size_t i = 0; i < extentsVec.size(); ++i) {
+            numSegments += extentsVec[i].numSegments;
+        }
+        BOOST_REQUIRE_EQUAL(numSegments, numFree);
+        allocatedExtentsVec.push_back(std::move(extentsVec));
+        extentsVec.clear();
+        BOOST_REQUIRE(!t.AllocateSegmentExtentsOnDisks_ThreadSafe(1, NUM_DISKS, 2, extentsVec)); //full
+        BOOST_REQUIRE(extentsVec.empty());
+    }
+
+    //everything frees back to an empty tree
+    for (std::size_t i = 0; i < allocatedExtentsVec.size(); ++i) {
+        BOOST_REQUIRE(t.FreeSegmentExtents_ThreadSafe(allocatedExtentsVec[i]));
+    }
+    BOOST_REQUIRE_EQUAL(t.GetNumAllocatedSegments_NotThreadSafe(), 0);
+    BOOST_REQUIRE(t.IsBackupEqual(emptyBackup));
+}
+
+BOOST_AUTO_TEST_CASE(SegmentIdExtentsVecTestCase)
+{
+    BOOST_REQUIRE_EQUAL(sizeof(segment_id_extents_vec_t), sizeof(std::vector<segment_id_extent_t>));
+    const std::size_t N = segment_id_extents_vec_t::NUM_INLINE_EXTENTS;
+    BOOST_REQUIRE_GE(N, 1);
+
+    //inline
+    segment_id_extents_vec_t v;
+    BOOST_REQUIRE(v.empty());
+    for (std::size_t i = 0; i < N; ++i) {
+        v.push_back(segment_id_extent_t{ static_cast<segment_id_t>(i * 10), 1 });
+    }
+    BOOST_REQUIRE_EQUAL(v.size(), N);
+    BOOST_REQUIRE_EQUAL(v.GetHeapBytes(), 0);
+
+    //spill, then copy and move in both states
+    v.push_back(segment_id_extent_t{ 1000, 5 });
+    BOOST_REQUIRE_EQUAL(v.size(), N + 1);
+    BOOST_REQUIRE_GT(v.GetHeapBytes(), 0);
+    BOOST_REQUIRE(v.back() == segment_id_extent_t({ 1000, 5 }));
+    segment_id_extents_vec_t copy(v);
+    BOOST_REQUIRE(copy == v);
+    segment_id_extents_vec_t moved(std::move(copy));
+    BOOST_REQUIRE(moved == v);
+    BOOST_REQUIRE(copy.empty());
+    BOOST_REQUIRE_EQUAL(copy.GetHeapBytes(), 0); //moved from is inline again
+    segment_id_extents_vec_t small = { segment_id_extent_t{ 7, 3 } };
+    moved = small;
+    BOOST_REQUIRE(moved == small);
+    moved = std::move(v);
+    BOOST_REQUIRE(v.empty());
+    BOOST_REQUIRE_EQUAL(moved.size(), N + 1);
+    small = std::move(moved);
+    BOOST_REQUIRE_EQUAL(small.size(), N + 1);
+    BOOST_REQUIRE(small != moved);
+
+    //shrink back inline
+    small.resize(1);
+    BOOST_REQUIRE_GT(small.GetHeapBytes(), 0);
+    small.ShrinkToFit();
+    BOOST_REQUIRE_EQUAL(small.GetHeapBytes(), 0);
+    BOOST_REQUIRE(small == segment_id_extents_vec_t({ segment_id_extent_t{ 0, 1 } }));
+    small.resize(N + 3);
+    BOOST_REQUIRE(small[N + 2] == segment_id_extent_t({ 0, 0 }));
+    small.ShrinkToFit();
+    BOOST_REQUIRE_EQUAL(small.GetHeapBytes(), (N + 3) * sizeof(segment_id_extent_t));
+    small.clear();
+    BOOST_REQUIRE(small.empty());
+}
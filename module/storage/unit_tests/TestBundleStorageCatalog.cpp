@@ -18,8 +18,13 @@
 #include <string>
 #include <inttypes.h>
 #include <set>
+#include <vector>
+#include <new>
 #include "codec/bpv6.h"
 #include "codec/bpv7.h"
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
 
 static void CreatePrimaryV6(Bpv6CbhePrimaryBlock & p, const cbhe_eid_t & srcEid, const cbhe_eid_t & destEid, bool reqCustody, uint64_t creation, uint64_t sequence, BPV6_BUNDLEFLAG priority = BPV6_BUNDLEFLAG::PRIORITY_BULK) {
     
@@ -87,9 +92,9 @@ static void TestBundleStorage(const BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER
                 primaries.push_back(&primariesV7[i]);
             }
             catalog_entry_t catalogEntryToTake;
-            catalogEntryToTake.Init(*primaries[i], 1000 + i, 800 + i, 1, NULL);
+            catalogEntryToTake.Init(*primaries[i], 1000 + i, 800 + i, NULL);
             sumBundleBytes += 1000 + i;
-            catalogEntryToTake.segmentIdChainVec = { static_cast<segment_id_t>(i) };
+            catalogEntryToTake.segmentIdExtentsVec = { segment_id_extent_t{ static_cast<segment_id_t>(i), 1 } };
             catalogEntryCopiesForVerification.push_back(catalogEntryToTake); //make a copy for verification
 
             // misc catalog_entry_t tests
@@ -103,10 +108,10 @@ static void TestBundleStorage(const BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER
                 CreatePrimaryV6(primaryTest, cbhe_eid_t(500, 500), cbhe_eid_t(501, 501), true, 1000, seq, pri);
                 primaryTest.m_bundleProcessingControlFlags |= BPV6_BUNDLEFLAG::ISFRAGMENT;
                 cbhe_eid_t bundleEidMaskPtr(500, 500);
-                catalogEntryToTakeCopy.Init(primaryTest, 100, 100, 1, &paramPtrUuidKeyInMap, &bundleEidMaskPtr);
+                catalogEntryToTakeCopy.Init(primaryTest, 100, 100, &paramPtrUuidKeyInMap, &bundleEidMaskPtr);
 
                 // do it again with NULL bundleEidMaskPtr
-                catalogEntryToTakeCopy.Init(primaryTest, 100, 100, 1, &paramPtrUuidKeyInMap, NULL);
+                catalogEntryToTakeCopy.Init(primaryTest, 100, 100, &paramPtrUuidKeyInMap, NULL);
             }
 
             catalogEntryToTakeCopy = catalogEntryToTakeConstCopy; // test const assignment operator
@@ -139,11 +144,11 @@ static void TestBundleStorage(const BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER
             BOOST_REQUIRE_EQUAL(catalogEntryToTake != catalogEntryToTakeCopy, true);
             catalogEntryToTakeCopy.destEid = tmpDestEid;
 
-            catalogEntryToTakeCopy.segmentIdChainVec[0]++;
+            catalogEntryToTakeCopy.segmentIdExtentsVec[0].beginSegmentId++;
             BOOST_REQUIRE_EQUAL(catalogEntryToTake == catalogEntryToTakeCopy, false);
             BOOST_REQUIRE_EQUAL(catalogEntryToTake != catalogEntryToTakeCopy, true);
             BOOST_REQUIRE_EQUAL(catalogEntryToTake < catalogEntryToTakeCopy, true);
-            catalogEntryToTakeCopy.segmentIdChainVec[0]--;
+            catalogEntryToTakeCopy.segmentIdExtentsVec[0].beginSegmentId--;
 
             catalogEntryToTake.payloadSizeBytes++;
             BOOST_REQUIRE_EQUAL(catalogEntryToTake == catalogEntryToTakeCopy, false);
@@ -156,7 +161,7 @@ static void TestBundleStorage(const BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER
             catalogEntryToTake.bundleSizeBytes--;
 
             const uint64_t custodyId = i;
-            BOOST_REQUIRE_EQUAL(catalogEntryToTake.segmentIdChainVec.size(), 1); //verify before move
+            BOOST_REQUIRE_EQUAL(catalogEntryToTake.GetNumSegments(), 1); //verify before move
             BOOST_REQUIRE(bsc.CatalogIncomingBundleForStore(catalogEntryToTake, *primaries[i], custodyId, order));
             if (order == BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::SEQUENCE_NUMBER && i == 2) {
                 // Test duplicate insertion
@@ -170,7 +175,7 @@ static void TestBundleStorage(const BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER
             BOOST_REQUIRE_EQUAL(bsc.GetTotalBundleEraseOperationsFromCatalog(), 0);
             BOOST_REQUIRE_EQUAL(bsc.GetTotalBundleByteEraseOperationsFromCatalog(), 0);
             catalogEntryCopiesForVerification.back().ptrUuidKeyInMap = catalogEntryToTake.ptrUuidKeyInMap; //was potentially modified at CatalogIncomingBundleForStore
-            BOOST_REQUIRE_EQUAL(catalogEntryToTake.segmentIdChainVec.size(), 0); //verify was moved
+            BOOST_REQUIRE_EQUAL(catalogEntryToTake.segmentIdExtentsVec.size(), 0); //verify was moved
         }
         const uint64_t highestSumBundleBytes = sumBundleBytes;
         uint64_t sumBundleBytesDeleted = 0;
@@ -271,7 +276,6 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogExpiredCase)
 {
     const uint64_t bundleSize = 1000;
     const uint64_t payloadSize = 800;
-    const uint64_t bundleRequiredSegments = 1;
     const uint64_t creation = 0;
 
     for(unsigned int whichBundleVersion = 6; whichBundleVersion <= 7; ++whichBundleVersion) {
@@ -290,8 +294,8 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogExpiredCase)
             }
 
             catalog_entry_t catalogEntryToTake;
-            catalogEntryToTake.Init(*primary, bundleSize, payloadSize, bundleRequiredSegments, NULL);
-            catalogEntryToTake.segmentIdChainVec = { static_cast<segment_id_t>(i) };
+            catalogEntryToTake.Init(*primary, bundleSize, payloadSize, NULL);
+            catalogEntryToTake.segmentIdExtentsVec = { segment_id_extent_t{ static_cast<segment_id_t>(i), 1 } };
 
             bool ret = bsc.CatalogIncomingBundleForStore(
                     catalogEntryToTake,
@@ -329,7 +333,6 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogNoExpiredTestCase)
 
     const uint64_t bundleSize = 1000;
     const uint64_t payloadSize = 800;
-    const uint64_t bundleRequiredSegments = 1;
     const uint64_t custodyId = 1;
     const uint64_t creation = 0;
 
@@ -349,8 +352,8 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogNoExpiredTestCase)
 
 
         catalog_entry_t catalogEntryToTake;
-        catalogEntryToTake.Init(*primary, bundleSize, payloadSize, bundleRequiredSegments, NULL);
-        catalogEntryToTake.segmentIdChainVec = { static_cast<segment_id_t>(0) };
+        catalogEntryToTake.Init(*primary, bundleSize, payloadSize, NULL);
+        catalogEntryToTake.segmentIdExtentsVec = { segment_id_extent_t{ static_cast<segment_id_t>(0), 1 } };
 
         bool ret = bsc.CatalogIncomingBundleForStore(
                 catalogEntryToTake,
@@ -372,7 +375,6 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogMaxExpiredCase)
 {
     const uint64_t bundleSize = 1000;
     const uint64_t payloadSize = 800;
-    const uint64_t bundleRequiredSegments = 1;
     const uint64_t creation = 0;
 
     for(unsigned int whichBundleVersion = 6; whichBundleVersion <= 7; ++whichBundleVersion) {
@@ -391,8 +393,8 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogMaxExpiredCase)
             }
 
             catalog_entry_t catalogEntryToTake;
-            catalogEntryToTake.Init(*primary, bundleSize, payloadSize, bundleRequiredSegments, NULL);
-            catalogEntryToTake.segmentIdChainVec = { static_cast<segment_id_t>(i) };
+            catalogEntryToTake.Init(*primary, bundleSize, payloadSize, NULL);
+            catalogEntryToTake.segmentIdExtentsVec = { segment_id_extent_t{ static_cast<segment_id_t>(i), 1 } };
 
             bool ret = bsc.CatalogIncomingBundleForStore(
                     catalogEntryToTake,
@@ -411,3 +413,290 @@ BOOST_AUTO_TEST_CASE(BundleStorageCatalogMaxExpiredCase)
     }
 }
 
+
+BOOST_AUTO_TEST_CASE(BundleStorageCatalogExpiredInFlightTestCase)
+{
+    //bundles popped from awaiting send (in flight) are not expired until returned to awaiting send
+    BundleStorageCatalog bsc;
+    const std::vector<cbhe_eid_t> availableDestEids = { cbhe_eid_t(501, 501) };
+    for (uint64_t i = 0; i < 10; ++i) {
+        Bpv6CbhePrimaryBlock primary;
+        CreatePrimaryV6(primary, cbhe_eid_t(500, 500), cbhe_eid_t(501, 501), true, i / 5, i); //expirations 1000 and 1001
+        catalog_entry_t catalogEntryToTake;
+        catalogEntryToTake.Init(primary, 1000, 800, NULL);
+        catalogEntryToTake.segmentIdExtentsVec = { segment_id_extent_t{ static_cast<segment_id_t>(i), 1 } };
+        BOOST_REQUIRE(bsc.CatalogIncomingBundleForStore(catalogEntryToTake, primary, i, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO));
+    }
+    std::vector<uint64_t> inFlightIds;
+    for (unsigned int i = 0; i < 3; ++i) {
+        uint64_t custodyId;
+        BOOST_REQUIRE(bsc.PopEntryFromAwaitingSend(custodyId, availableDestEids) != NULL);
+        inFlightIds.push_back(custodyId);
+    }
+    BOOST_REQUIRE(inFlightIds == std::vector<uint64_t>({ 0, 1, 2 }));
+    //return and pop again so that the wheel holds duplicate ids
+    BOOST_REQUIRE(bsc.ReturnEntryToAwaitingSend(*bsc.GetEntryFromCustodyId(2), 2));
+    uint64_t custodyIdPoppedAgain;
+    BOOST_REQUIRE(bsc.PopEntryFromAwaitingSend(custodyIdPoppedAgain, availableDestEids) != NULL);
+    BOOST_REQUIRE_EQUAL(custodyIdPoppedAgain, 2);
+
+    std::vector<uint64_t> ids;
+    bsc.GetExpiredBundleIds(999, 0, ids);
+    BOOST_REQUIRE(ids.empty());
+    bsc.GetExpiredBundleIds(1000, 0, ids);
+    std::sort(ids.begin(), ids.end());
+    BOOST_REQUIRE(ids == std::vector<uint64_t>({ 3, 4 }));
+    BOOST_REQUIRE(bsc.Remove(3, true).first);
+    BOOST_REQUIRE(bsc.Remove(4, true).first);
+    bsc.GetExpiredBundleIds(2000, 0, ids);
+    std::sort(ids.begin(), ids.end());
+    BOOST_REQUIRE(ids == std::vector<uint64_t>({ 5, 6, 7, 8, 9 }));
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        BOOST_REQUIRE(bsc.Remove(ids[i], true).first);
+    }
+    bsc.GetExpiredBundleIds(2000, 0, ids);
+    BOOST_REQUIRE(ids.empty());
+
+    //return one in flight bundle (already expired), finish the others
+    BOOST_REQUIRE(bsc.ReturnEntryToAwaitingSend(*bsc.GetEntryFromCustodyId(1), 1));
+    BOOST_REQUIRE(bsc.Remove(0, false).first);
+    BOOST_REQUIRE(bsc.Remove(2, false).first);
+    bsc.GetExpiredBundleIds(2001, 0, ids);
+    BOOST_REQUIRE(ids == std::vector<uint64_t>({ 1 }));
+    BOOST_REQUIRE(bsc.Remove(1, true).first);
+    bsc.GetExpiredBundleIds(2002, 0, ids);
+    BOOST_REQUIRE(ids.empty());
+    BOOST_REQUIRE_EQUAL(bsc.GetNumBundlesInCatalog(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(BundleStorageCatalogDestinationGroupTestCase)
+{
+    //catalog "a" searches the listed destinations on every pop, catalog "b" pops from registered destination groups;
+    //every bundle has a unique expiration so both must release the same bundles in the same order
+    static const BPV6_BUNDLEFLAG priorities[3] = { BPV6_BUNDLEFLAG::PRIORITY_BULK, BPV6_BUNDLEFLAG::PRIORITY_NORMAL, BPV6_BUNDLEFLAG::PRIORITY_EXPEDITED };
+    BundleStorageCatalog bscA;
+    BundleStorageCatalog bscB;
+
+    std::vector<std::pair<cbhe_eid_t, bool> > dests1; //registered before any bundles are stored
+    for (uint64_t nodeId = 1; nodeId <= 50; ++nodeId) {
+        dests1.emplace_back(cbhe_eid_t(nodeId, 0), true);
+    }
+    for (uint64_t nodeId = 60; nodeId <= 100; ++nodeId) {
+        dests1.emplace_back(cbhe_eid_t(nodeId, 1), false);
+    }
+    dests1.emplace_back(cbhe_eid_t(10, 1), false); //also covered by the wildcard above
+    const uint64_t groupId1 = bscB.AddDestinationGroup(dests1);
+    {
+        uint64_t custodyIdEmpty;
+        BOOST_REQUIRE(bscB.PopEntryFromAwaitingSend(custodyIdEmpty, groupId1) == NULL);
+    }
+
+    for (uint64_t i = 0; i < 3000; ++i) {
+        const uint64_t nodeId = 1 + ((i * 7919) % 100);
+        const uint64_t serviceId = 1 + (i % 2);
+        const uint64_t creation = (i * 104729) % 3001; //unique
+        Bpv6CbhePrimaryBlock primary;
+        CreatePrimaryV6(primary, cbhe_eid_t(500, 500), cbhe_eid_t(nodeId, serviceId), false, creation, i, priorities[(i / 3) % 3]);
+        for (unsigned int c = 0; c < 2; ++c) {
+            BundleStorageCatalog & bsc = (c == 0) ? bscA : bscB;
+            catalog_entry_t catalogEntryToTake;
+            catalogEntryToTake.Init(primary, 1000, 800, NULL);
+            catalogEntryToTake.segmentIdExtentsVec = { segment_id_extent_t{ static_cast<segment_id_t>(i), 1 } };
+            BOOST_REQUIRE(bsc.CatalogIncomingBundleForStore(catalogEntryToTake, primary, i, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO));
+        }
+    }
+
+    //pop, sometimes returning the bundle or removing another one
+    for (unsigned int i = 0; i < 1000; ++i) {
+        uint64_t custodyIdA = UINT64_MAX, custodyIdB = UINT64_MAX;
+        catalog_entry_t * entryA = bscA.PopEntryFromAwaitingSend(custodyIdA, dests1);
+        catalog_entry_t * entryB = bscB.PopEntryFromAwaitingSend(custodyIdB, groupId1);
+        BOOST_REQUIRE(entryA != NULL);
+        BOOST_REQUIRE(entryB != NULL);
+        BOOST_REQUIRE_EQUAL(custodyIdA, custodyIdB);
+        if ((i % 5) == 0) {
+            BOOST_REQUIRE(bscA.ReturnEntryToAwaitingSend(*entryA, custodyIdA));
+            BOOST_REQUIRE(bscB.ReturnEntryToAwaitingSend(*entryB, custodyIdB));
+        }
+        else {
+            BOOST_REQUIRE(bscA.Remove(custodyIdA, false).first);
+            BOOST_REQUIRE(bscB.Remove(custodyIdB, false).first);
+        }
+        const uint64_t custodyIdToRemove = (i * 13) % 3000;
+        if (bscA.GetEntryFromCustodyId(custodyIdToRemove) && (custodyIdToRemove != custodyIdA)) {
+            BOOST_REQUIRE(bscA.Remove(custodyIdToRemove, true).first);
+            BOOST_REQUIRE(bscB.Remove(custodyIdToRemove, true).first);
+        }
+    }
+
+    //registered after bundles are stored, release everything that is left
+    std::vector<std::pair<cbhe_eid_t, bool> > dests2;
+    for (uint64_t nodeId = 1; nodeId <= 100; ++nodeId) {
+        dests2.emplace_back(cbhe_eid_t(nodeId, 0), true);
+    }
+    const uint64_t groupId2 = bscB.AddDestinationGroup(dests2);
+    BOOST_REQUIRE(bscB.RemoveDestinationGroup(groupId1));
+    BOOST_REQUIRE(!bscB.RemoveDestinationGroup(groupId1));
+    uint64_t numPopped = 0;
+    while (true) {
+        uint64_t custodyIdA = UINT64_MAX, custodyIdB = UINT64_MAX;
+        catalog_entry_t * entryA = bscA.PopEntryFromAwaitingSend(custodyIdA, dests2);
+        catalog_entry_t * entryB = bscB.PopEntryFromAwaitingSend(custodyIdB, groupId2);
+        BOOST_REQUIRE_EQUAL((entryA == NULL), (entryB == NULL));
+        if (entryA == NULL) {
+            break;
+        }
+        BOOST_REQUIRE_EQUAL(custodyIdA, custodyIdB);
+        BOOST_REQUIRE(bscA.Remove(custodyIdA, false).first);
+        BOOST_REQUIRE(bscB.Remove(custodyIdB, false).first);
+        ++numPopped;
+    }
+    BOOST_REQUIRE_GT(numPopped, 0);
+    BOOST_REQUIRE_EQUAL(bscA.GetNumBundlesInCatalog(), 0);
+    BOOST_REQUIRE_EQUAL(bscB.GetNumBundlesInCatalog(), 0);
+}
+
+//counts heap allocations of the catalog entry layouts in BundleStorageCatalogBytesPerBundleTestCase,
+//including the per-allocation overhead of the allocator where it can be queried (glibc)
+struct heap_allocation_counter_t {
+    uint64_t numAllocations;
+    uint64_t bytesRequested;
+    uint64_t bytesFootprint;
+};
+static heap_allocation_counter_t g_heapAllocationCounter = { 0, 0, 0 };
+
+static void CountHeapAllocation(const void * ptr, const std::size_t bytesRequested) {
+    ++g_heapAllocationCounter.numAllocations;
+    g_heapAllocationCounter.bytesRequested += bytesRequested;
+#if defined(__GLIBC__)
+    g_heapAllocationCounter.bytesFootprint += malloc_usable_size(const_cast<void*>(ptr)) + sizeof(std::size_t); //plus the chunk header
+#else
+    (void)ptr;
+    g_heapAllocationCounter.bytesFootprint += bytesRequested;
+#endif
+}
+
+template <typename T>
+struct CountingAllocator {
+    typedef T value_type;
+    CountingAllocator() noexcept {}
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept {}
+    T * allocate(const std::size_t n) {
+        T * const ptr = static_cast<T*>(::operator new(n * sizeof(T)));
+        CountHeapAllocation(ptr, n * sizeof(T));
+        return ptr;
+    }
+    void deallocate(T * ptr, std::size_t) noexcept {
+        ::operator delete(ptr);
+    }
+};
+template <typename T, typename U>
+static bool operator==(const CountingAllocator<T>&, const CountingAllocator<U>&) { return true; }
+template <typename T, typename U>
+static bool operator!=(const CountingAllocator<T>&, const CountingAllocator<U>&) { return false; }
+
+//the catalog entry before the inline extents: a std::vector holding one heap allocation per bundle
+struct legacy_catalog_entry_t {
+    uint64_t bundleSizeBytes;
+    uint64_t payloadSizeBytes;
+    std::vector<segment_id_extent_t, CountingAllocator<segment_id_extent_t> > segmentIdExtentsVec;
+    cbhe_eid_t destEid;
+    uint64_t encodedAbsExpirationAndCustodyAndPriority;
+    uint64_t sequence;
+    const void * ptrUuidKeyInMap;
+};
+
+BOOST_AUTO_TEST_CASE(BundleStorageCatalogBytesPerBundleTestCase)
+{
+    //catalog entry bytes per stored bundle, where 1 in 100 bundles is fragmented into 5 extents
+    static const std::size_t NUM_BUNDLES = 100000;
+    BundleStorageCatalog bsc;
+    Bpv6CbhePrimaryBlock primary;
+    for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+        CreatePrimaryV6(primary, cbhe_eid_t(500, 500), cbhe_eid_t(501 + (i % 10), 1), false, 1000 + (i % 50), i);
+        catalog_entry_t catalogEntryToTake;
+        catalogEntryToTake.Init(primary, 1000, 800, NULL);
+        const std::size_t numExtents = ((i % 100) == 0) ? 5 : 1;
+        for (std::size_t j = 0; j < numExtents; ++j) {
+            catalogEntryToTake.segmentIdExtentsVec.push_back(segment_id_extent_t{ static_cast<segment_id_t>((i * 10) + (j * 2)), 1 });
+        }
+        catalogEntryToTake.segmentIdExtentsVec.ShrinkToFit(); //as allocated by the memory manager
+        BOOST_REQUIRE(bsc.CatalogIncomingBundleForStore(catalogEntryToTake, primary, i, BundleStorageCatalog::DUPLICATE_EXPIRY_ORDER::FIFO));
+    }
+    uint64_t numSpilledEntries = 0;
+    for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+        const catalog_entry_t * entryPtr = bsc.GetEntryFromCustodyId(i);
+        BOOST_REQUIRE(entryPtr);
+        BOOST_REQUIRE_EQUAL(entryPtr->segmentIdExtentsVec.size(), ((i % 100) == 0) ? 5 : 1);
+        numSpilledEntries += (entryPtr->segmentIdExtentsVec.GetHeapBytes() != 0);
+    }
+    BOOST_REQUIRE_EQUAL(numSpilledEntries, NUM_BUNDLES / 100);
+
+    //measure both layouts the same way: one counted allocation per hash map node (as HashMapRobinHood allocates
+    //one node per entry) plus every extent allocation; the hash map slots are identical for both and not counted
+    typedef std::pair<uint64_t, legacy_catalog_entry_t> legacy_node_t;
+    typedef custid_to_catalog_entry_hashmap_t::key_value_pair_t node_t;
+    CountingAllocator<legacy_node_t> legacyNodeAllocator;
+    CountingAllocator<node_t> nodeAllocator;
+    std::vector<legacy_node_t*> legacyNodes(NUM_BUNDLES);
+    std::vector<node_t*> nodes(NUM_BUNDLES);
+
+    g_heapAllocationCounter = { 0, 0, 0 };
+    for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+        const catalog_entry_t & entry = *bsc.GetEntryFromCustodyId(i);
+        legacyNodes[i] = legacyNodeAllocator.allocate(1);
+        legacy_node_t * const legacyNodePtr = new (legacyNodes[i]) legacy_node_t();
+        legacyNodePtr->first = i;
+        legacy_catalog_entry_t & legacyEntry = legacyNodePtr->second;
+        legacyEntry.bundleSizeBytes = entry.bundleSizeBytes;
+        legacyEntry.payloadSizeBytes = entry.payloadSizeBytes;
+        legacyEntry.segmentIdExtentsVec.assign(entry.segmentIdExtentsVec.cbegin(), entry.segmentIdExtentsVec.cend());
+        legacyEntry.segmentIdExtentsVec.shrink_to_fit();
+        legacyEntry.destEid = entry.destEid;
+        legacyEntry.encodedAbsExpirationAndCustodyAndPriority = entry.encodedAbsExpirationAndCustodyAndPriority;
+        legacyEntry.sequence = entry.sequence;
+        legacyEntry.ptrUuidKeyInMap = entry.ptrUuidKeyInMap;
+    }
+    const heap_allocation_counter_t before = g_heapAllocationCounter;
+
+    g_heapAllocationCounter = { 0, 0, 0 };
+    for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+        nodes[i] = nodeAllocator.allocate(1);
+        node_t * const nodePtr = new (nodes[i]) node_t(i, *bsc.GetEntryFromCustodyId(i));
+        const std::size_t heapBytes = nodePtr->second.segmentIdExtentsVec.GetHeapBytes();
+        if (heapBytes) { //spilled by the catalog_entry_t copy (new[] in storage_lib)
+            CountHeapAllocation(nodePtr->second.segmentIdExtentsVec.data(), heapBytes);
+        }
+    }
+    const heap_allocation_counter_t after = g_heapAllocationCounter;
+
+    for (std::size_t i = 0; i < NUM_BUNDLES; ++i) {
+        legacyNodes[i]->~legacy_node_t();
+        legacyNodeAllocator.deallocate(legacyNodes[i], 1);
+        nodes[i]->~node_t();
+        nodeAllocator.deallocate(nodes[i], 1);
+    }
+
+    const double bytesPerBundleBefore = static_cast<double>(before.bytesFootprint) / NUM_BUNDLES;
+    const double bytesPerBundleAfter = static_cast<double>(after.bytesFootprint) / NUM_BUNDLES;
+    std::cout << "catalog entry heap bytes per stored bundle (nodes + extents, including allocator overhead, excluding hash map slots): before="
+        << bytesPerBundleBefore << " (" << before.numAllocations << " allocations, " << before.bytesRequested << " bytes requested) after="
+        << bytesPerBundleAfter << " (" << after.numAllocations << " allocations, " << after.bytesRequested << " bytes requested)\n";
+    BOOST_REQUIRE_EQUAL(before.numAllocations, 2 * NUM_BUNDLES);
+    BOOST_REQUIRE_EQUAL(after.numAllocations, NUM_BUNDLES + (NUM_BUNDLES / 100));
+    BOOST_REQUIRE_EQUAL(after.bytesRequested, (NUM_BUNDLES * sizeof(node_t)) + ((NUM_BUNDLES / 100) * 5 * sizeof(segment_id_extent_t)));
+    BOOST_REQUIRE_LT(after.bytesRequested, before.bytesRequested);
+    BOOST_REQUIRE_LT(after.bytesFootprint, before.bytesFootprint);
+
+    //entries survive being popped and returned
+    std::vector<cbhe_eid_t> availableDests;
+    for (uint64_t nodeId = 501; nodeId < 511; ++nodeId) {
+        availableDests.emplace_back(nodeId, 1);
+    }
+    uint64_t custodyId;
+    catalog_entry_t * entryPtr = bsc.PopEntryFromAwaitingSend(custodyId, availableDests);
+    BOOST_REQUIRE(entryPtr);
+    BOOST_REQUIRE_EQUAL(entryPtr->segmentIdExtentsVec.size(), ((custodyId % 100) == 0) ? 5 : 1);
+    BOOST_REQUIRE(bsc.ReturnEntryToAwaitingSend(*entryPtr, custodyId));
+}
@@ -16,6 +16,8 @@
 #include <iostream>
 #include "CustodyTimers.h"
 #include <boost/thread.hpp>
+#include <algorithm>
+#include <vector>
 
     
 BOOST_AUTO_TEST_CASE(CustodyTimersTestCase)
@@ -161,3 +163,69 @@ BOOST_AUTO_TEST_CASE(CustodyTimersTestCase)
 
 
 }
+
+BOOST_AUTO_TEST_CASE(CustodyTimersPopAllExpiredTestCase)
+{
+    static const cbhe_eid_t EID1(5, 5);
+    static const cbhe_eid_t EID2(10, 5);
+    static const cbhe_eid_t EID3(15, 5);
+
+    //bulk pop of the available destinations, each in fifo order
+    {
+        CustodyTimers ct(boost::posix_time::seconds(0));
+        for (uint64_t cid = 1; cid <= 10; ++cid) {
+            BOOST_REQUIRE(ct.StartCustodyTransferTimer(EID1, cid));
+            BOOST_REQUIRE(ct.StartCustodyTransferTimer(EID2, cid + 100));
+            BOOST_REQUIRE(ct.StartCustodyTransferTimer(EID3, cid + 200));
+        }
+        BOOST_REQUIRE(!ct.CancelCustodyTransferTimer(EID2, 5)); //wrong destination
+        BOOST_REQUIRE(ct.CancelCustodyTransferTimer(EID1, 5));
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1)); //expired now (called after StartCustodyTransferTimer)
+        std::vector<uint64_t> expired;
+        BOOST_REQUIRE_EQUAL(ct.PopAllExpiredCustodyTimers(expired, { EID2, EID1 }, boost::posix_time::microsec_clock::universal_time()), 19);
+        BOOST_REQUIRE(expired == std::vector<uint64_t>({ 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 1, 2, 3, 4, 6, 7, 8, 9, 10 }));
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(), 10);
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(EID1), 0);
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(EID2), 0);
+        BOOST_REQUIRE_EQUAL(ct.PopAllExpiredCustodyTimers(expired, { EID1 }, boost::posix_time::microsec_clock::universal_time()), 0);
+        expired.clear();
+        BOOST_REQUIRE_EQUAL(ct.PopAllAnyExpiredCustodyTimers(expired, boost::posix_time::microsec_clock::universal_time()), 10);
+        std::sort(expired.begin(), expired.end());
+        BOOST_REQUIRE(expired == std::vector<uint64_t>({ 201, 202, 203, 204, 205, 206, 207, 208, 209, 210 }));
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(), 0);
+        BOOST_REQUIRE(ct.StartCustodyTransferTimer(EID3, 201)); //popped custody ids may be started again
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(EID3), 1);
+    }
+
+    //many timers only expire once the timeout has passed, across several rotations of the wheel
+    {
+        static const uint64_t NUM_TIMERS = 100000;
+        const boost::posix_time::time_duration timeout = boost::posix_time::seconds(10);
+        CustodyTimers ct(timeout);
+        const boost::posix_time::ptime startPtime = boost::posix_time::microsec_clock::universal_time();
+        for (uint64_t cid = 0; cid < NUM_TIMERS; ++cid) {
+            BOOST_REQUIRE(ct.StartCustodyTransferTimer(((cid % 3) == 0) ? EID1 : EID2, cid));
+        }
+        const boost::posix_time::ptime endStartPtime = boost::posix_time::microsec_clock::universal_time();
+        BOOST_REQUIRE(!ct.StartCustodyTransferTimer(EID1, 0)); //already started
+        for (uint64_t cid = 0; cid < NUM_TIMERS; cid += 1000) { //cancel 100 of them
+            BOOST_REQUIRE(ct.CancelCustodyTransferTimer(((cid % 3) == 0) ? EID1 : EID2, cid));
+        }
+        std::vector<uint64_t> expired;
+        uint64_t custodyId;
+        BOOST_REQUIRE_EQUAL(ct.PopAllAnyExpiredCustodyTimers(expired, startPtime + boost::posix_time::seconds(9)), 0);
+        BOOST_REQUIRE(!ct.PollOneAndPopAnyExpiredCustodyTimer(custodyId, startPtime + boost::posix_time::seconds(9)));
+        BOOST_REQUIRE_EQUAL(ct.PopAllExpiredCustodyTimers(expired, { EID1, EID2, EID3 }, startPtime + boost::posix_time::seconds(9)), 0);
+        BOOST_REQUIRE(ct.PollOneAndPopAnyExpiredCustodyTimer(custodyId, endStartPtime + boost::posix_time::seconds(55)));
+        BOOST_REQUIRE_EQUAL(ct.PopAllAnyExpiredCustodyTimers(expired, endStartPtime + boost::posix_time::seconds(55)), NUM_TIMERS - 100 - 1);
+        expired.push_back(custodyId);
+        std::sort(expired.begin(), expired.end());
+        BOOST_REQUIRE(std::adjacent_find(expired.begin(), expired.end()) == expired.end()); //each popped once
+        for (std::size_t i = 0; i < expired.size(); ++i) {
+            BOOST_REQUIRE_NE(expired[i] % 1000, 0); //never a cancelled one
+        }
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(), 0);
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(EID1), 0);
+        BOOST_REQUIRE_EQUAL(ct.GetNumCustodyTransferTimers(EID2), 0);
+    }
+}
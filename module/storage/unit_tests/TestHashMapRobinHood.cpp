@@ -0,0 +1,169 @@
+/**
+ * @file TestHashMapRobinHood.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "HashMapRobinHood.h"
+#include "HashMap16BitFixedSize.h"
+#include "CatalogEntry.h"
+#include <iostream>
+#include <map>
+#include <vector>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/timer/timer.hpp>
+
+extern template class HashMapRobinHood<cbhe_bundle_uuid_t, uint64_t>;
+extern template class HashMapRobinHood<cbhe_bundle_uuid_nofragment_t, uint64_t>;
+extern template class HashMapRobinHood<uint64_t, catalog_entry_t>;
+extern template class HashMap16BitFixedSize<cbhe_bundle_uuid_nofragment_t, uint64_t>;
+
+static cbhe_bundle_uuid_nofragment_t MakeUuid(const uint64_t i) {
+    return cbhe_bundle_uuid_nofragment_t(
+        1000 + (i >> 20), //creationSeconds
+        i, // sequence,
+        10, // srcNodeId,
+        20 // srcServiceId
+    );
+}
+
+BOOST_AUTO_TEST_CASE(HashMapRobinHoodTestCase)
+{
+    //basic operations
+    {
+        HashMapRobinHood<cbhe_bundle_uuid_t, uint64_t> hm;
+        const cbhe_bundle_uuid_t uuid1(1000, 1, 10, 20, 0, 0);
+        const cbhe_bundle_uuid_t uuid2(1000, 1, 10, 20, 100, 50); //same bundle, different fragment
+        BOOST_REQUIRE(hm.GetValuePtr(uuid1) == NULL);
+        const HashMapRobinHood<cbhe_bundle_uuid_t, uint64_t>::key_value_pair_t * p1 = hm.Insert(uuid1, 1);
+        BOOST_REQUIRE(p1 != NULL);
+        BOOST_REQUIRE(p1->first == uuid1);
+        BOOST_REQUIRE_EQUAL(p1->second, 1);
+        BOOST_REQUIRE(hm.Insert(uuid1, 5) == NULL); //already exists
+        BOOST_REQUIRE(hm.Insert(uuid2, 2) != NULL);
+        BOOST_REQUIRE_EQUAL(hm.Size(), 2);
+        BOOST_REQUIRE(hm.GetValuePtr(uuid1) != NULL);
+        BOOST_REQUIRE_EQUAL(*hm.GetValuePtr(uuid1), 1);
+        BOOST_REQUIRE_EQUAL(*hm.GetValuePtr(uuid2), 2);
+        uint64_t value = 0;
+        BOOST_REQUIRE(hm.GetValueAndRemove(uuid1, value));
+        BOOST_REQUIRE_EQUAL(value, 1);
+        BOOST_REQUIRE(!hm.GetValueAndRemove(uuid1, value));
+        BOOST_REQUIRE(hm.GetValuePtr(uuid1) == NULL);
+        BOOST_REQUIRE_EQUAL(*hm.GetValuePtr(uuid2), 2);
+        BOOST_REQUIRE_EQUAL(hm.Size(), 1);
+        hm.Clear();
+        BOOST_REQUIRE_EQUAL(hm.Size(), 0);
+        BOOST_REQUIRE(hm.GetValuePtr(uuid2) == NULL);
+    }
+
+    //random inserts and removals across several incremental resizes, checked against std::map
+    //and checking that pointers into the map remain valid
+    {
+        HashMapRobinHood<uint64_t, catalog_entry_t> hm;
+        std::map<uint64_t, const catalog_entry_t*> expected;
+        boost::random::mt19937 gen(12345);
+        const boost::random::uniform_int_distribution<uint64_t> distKey(0, 150000);
+        const boost::random::uniform_int_distribution<> distOp(0, 9);
+        const std::size_t initialSlotCapacity = hm.GetSlotCapacity();
+        bool sawResizing = false;
+        for (unsigned int i = 0; i < 400000; ++i) {
+            const uint64_t key = distKey(gen);
+            if (distOp(gen) < 7) { //insert
+                catalog_entry_t entry;
+                entry.bundleSizeBytes = key * 3;
+                const HashMapRobinHood<uint64_t, catalog_entry_t>::key_value_pair_t * p = hm.Insert(key, std::move(entry));
+                if (expected.count(key)) {
+                    BOOST_REQUIRE(p == NULL);
+                }
+                else {
+                    BOOST_REQUIRE(p != NULL);
+                    expected[key] = &p->second;
+                }
+            }
+            else { //remove
+                catalog_entry_t entry;
+                const bool removed = hm.GetValueAndRemove(key, entry);
+                BOOST_REQUIRE_EQUAL(removed, (expected.erase(key) == 1));
+                if (removed) {
+                    BOOST_REQUIRE_EQUAL(entry.bundleSizeBytes, key * 3);
+                }
+            }
+            sawResizing |= hm.IsResizing();
+            BOOST_REQUIRE_EQUAL(hm.Size(), expected.size());
+        }
+        BOOST_REQUIRE(sawResizing);
+        BOOST_REQUIRE_GT(hm.GetSlotCapacity(), initialSlotCapacity);
+        for (std::map<uint64_t, const catalog_entry_t*>::const_iterator it = expected.cbegin(); it != expected.cend(); ++it) {
+            catalog_entry_t * entryPtr = hm.GetValuePtr(it->first);
+            BOOST_REQUIRE(entryPtr == it->second); //never moved
+            BOOST_REQUIRE_EQUAL(entryPtr->bundleSizeBytes, it->first * 3);
+        }
+        std::size_t numVisited = 0;
+        hm.ForEach([&](const HashMapRobinHood<uint64_t, catalog_entry_t>::key_value_pair_t & kvp) {
+            BOOST_REQUIRE(expected.count(kvp.first));
+            ++numVisited;
+        });
+        BOOST_REQUIRE_EQUAL(numVisited, expected.size());
+    }
+}
+
+template <class hashMapType>
+static void DoSpeedTest(const char * name, const std::vector<cbhe_bundle_uuid_nofragment_t> & uuids, const std::vector<std::size_t> & lookupOrder) {
+    std::unique_ptr<hashMapType> hmPtr(new hashMapType());
+    hashMapType & hm = *hmPtr;
+    std::cout << name << " with " << uuids.size() << " entries" << std::endl;
+    {
+        std::cout << "  insert: ";
+        boost::timer::auto_cpu_timer t;
+        for (std::size_t i = 0; i < uuids.size(); ++i) {
+            hm.Insert(uuids[i], i);
+        }
+    }
+    uint64_t sum = 0;
+    {
+        std::cout << "  lookup: ";
+        boost::timer::auto_cpu_timer t;
+        for (std::size_t i = 0; i < lookupOrder.size(); ++i) {
+            sum += *hm.GetValuePtr(uuids[lookupOrder[i]]);
+        }
+    }
+    {
+        std::cout << "  remove: ";
+        boost::timer::auto_cpu_timer t;
+        uint64_t value;
+        for (std::size_t i = 0; i < lookupOrder.size(); ++i) {
+            hm.GetValueAndRemove(uuids[lookupOrder[i]], value);
+            sum -= value;
+        }
+    }
+    BOOST_REQUIRE_EQUAL(sum, 0);
+}
+
+BOOST_AUTO_TEST_CASE(HashMapRobinHoodSpeedTestCase, *boost::unit_test::disabled())
+{
+    static const std::size_t NUM_ENTRIES[2] = { 1000000, 10000000 };
+    for (unsigned int n = 0; n < 2; ++n) {
+        std::vector<cbhe_bundle_uuid_nofragment_t> uuids(NUM_ENTRIES[n]);
+        std::vector<std::size_t> lookupOrder(NUM_ENTRIES[n]);
+        for (std::size_t i = 0; i < uuids.size(); ++i) {
+            uuids[i] = MakeUuid(i);
+            lookupOrder[i] = i;
+        }
+        boost::random::mt19937 gen(12345);
+        for (std::size_t i = lookupOrder.size() - 1; i > 0; --i) { //shuffle
+            std::swap(lookupOrder[i], lookupOrder[boost::random::uniform_int_distribution<std::size_t>(0, i)(gen)]);
+        }
+        DoSpeedTest<HashMap16BitFixedSize<cbhe_bundle_uuid_nofragment_t, uint64_t> >("HashMap16BitFixedSize", uuids, lookupOrder);
+        DoSpeedTest<HashMapRobinHood<cbhe_bundle_uuid_nofragment_t, uint64_t> >("HashMapRobinHood", uuids, lookupOrder);
+    }
+}
@@ -0,0 +1,101 @@
+/**
+ * @file TestHierarchicalTimingWheel.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "HierarchicalTimingWheel.h"
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+
+BOOST_AUTO_TEST_CASE(HierarchicalTimingWheelTestCase)
+{
+    //basic operations
+    {
+        HierarchicalTimingWheel tw;
+        std::vector<uint64_t> expired;
+        tw.Insert(800000000, 1); //typical seconds since year 2000
+        tw.Insert(800000000, 2);
+        tw.Insert(800000063, 3);
+        tw.Insert(800000064, 4);
+        tw.Insert(UINT64_MAX - 5, 5);
+        BOOST_REQUIRE_EQUAL(tw.Size(), 5);
+        tw.PopExpired(799999999, expired);
+        BOOST_REQUIRE(expired.empty());
+        tw.PopExpired(800000000, expired);
+        std::sort(expired.begin(), expired.end());
+        BOOST_REQUIRE(expired == std::vector<uint64_t>({ 1, 2 }));
+        expired.clear();
+        tw.PopExpired(800000000, expired); //same expiry again
+        BOOST_REQUIRE(expired.empty());
+        tw.Insert(700000000, 6); //already passed, returned by the next call
+        BOOST_REQUIRE_EQUAL(tw.Size(), 4);
+        tw.PopExpired(800000062, expired);
+        BOOST_REQUIRE(expired == std::vector<uint64_t>({ 6 }));
+        expired.clear();
+        tw.PopExpired(800000064, expired);
+        std::sort(expired.begin(), expired.end());
+        BOOST_REQUIRE(expired == std::vector<uint64_t>({ 3, 4 }));
+        expired.clear();
+        BOOST_REQUIRE_EQUAL(tw.Size(), 1);
+        tw.PopExpired(UINT64_MAX - 6, expired);
+        BOOST_REQUIRE(expired.empty());
+        tw.PopExpired(UINT64_MAX - 5, expired);
+        BOOST_REQUIRE(expired == std::vector<uint64_t>({ 5 }));
+        BOOST_REQUIRE_EQUAL(tw.Size(), 0);
+    }
+
+    //random inserts and advances (small steps, large jumps, and expirations in every level) checked against std::multimap
+    {
+        HierarchicalTimingWheel tw;
+        std::multimap<uint64_t, uint64_t> expected;
+        boost::random::mt19937 gen(12345);
+        const boost::random::uniform_int_distribution<> distOp(0, 9);
+        const boost::random::uniform_int_distribution<unsigned int> distBits(0, 40);
+        uint64_t now = 800000000;
+        uint64_t nextValue = 0;
+        std::vector<uint64_t> expired;
+        for (unsigned int i = 0; i < 200000; ++i) {
+            const int op = distOp(gen);
+            if (op < 7) { //insert
+                const uint64_t range = (static_cast<uint64_t>(1) << distBits(gen));
+                const uint64_t offset = boost::random::uniform_int_distribution<uint64_t>(0, range)(gen);
+                const uint64_t expiration = (op == 0) ? (now - (offset % 100)) : (now + offset); //sometimes already passed
+                tw.Insert(expiration, nextValue);
+                expected.emplace(expiration, nextValue);
+                ++nextValue;
+            }
+            else { //advance
+                const uint64_t range = (static_cast<uint64_t>(1) << ((op == 9) ? distBits(gen) : 3));
+                now += boost::random::uniform_int_distribution<uint64_t>(0, range)(gen);
+                expired.clear();
+                tw.PopExpired(now, expired);
+                std::vector<uint64_t> expectedExpired;
+                const std::multimap<uint64_t, uint64_t>::iterator itEnd = expected.upper_bound(now);
+                for (std::multimap<uint64_t, uint64_t>::iterator it = expected.begin(); it != itEnd; ++it) {
+                    expectedExpired.push_back(it->second);
+                }
+                expected.erase(expected.begin(), itEnd);
+                std::sort(expired.begin(), expired.end());
+                std::sort(expectedExpired.begin(), expectedExpired.end());
+                BOOST_REQUIRE(expired == expectedExpired);
+            }
+            BOOST_REQUIRE_EQUAL(tw.Size(), expected.size());
+        }
+        expired.clear();
+        tw.PopExpired(UINT64_MAX, expired);
+        BOOST_REQUIRE_EQUAL(expired.size(), expected.size());
+        BOOST_REQUIRE_EQUAL(tw.Size(), 0);
+    }
+}
@@ -0,0 +1,402 @@
+/**
+ * @file TestZmqStorageInterface.cpp
+ *
+ * @copyright Copyright (c) 2021 United States Government as represented by
+ * the National Aeronautics and Space Administration.
+ * No copyright is claimed in the United States under Title 17, U.S.Code.
+ * All Other Rights Reserved.
+ *
+ * @section LICENSE
+ * Released under the NASA Open Source Agreement (NOSA)
+ * See LICENSE.md in the source root directory for more information.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include "ZmqStorageInterface.h"
+#include "HdtnConfig.h"
+#include "HdtnDistributedConfig.h"
+#include "StorageConfig.h"
+#include "Environment.h"
+#include "message.hpp"
+#include "TelemetryDefinitions.h"
+#include "TimestampUtil.h"
+#include "codec/BundleViewV6.h"
+#include <boost/lexical_cast.hpp>
+#include <boost/make_unique.hpp>
+#include <boost/thread/thread.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+static void GenerateBundleV6(const uint64_t srcNodeId, const uint64_t destNodeId, const uint64_t sequence, const std::string& payload, std::vector<uint8_t>& bundleSerialized) {
+    BundleViewV6 bv;
+    Bpv6CbhePrimaryBlock& primary = bv.m_primaryBlockView.header;
+    primary.SetZero();
+    primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_EXPEDITED | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT;
+    primary.m_sourceNodeId.Set(srcNodeId, 1);
+    primary.m_destinationEid.Set(destNodeId, 1);
+    primary.m_custodianEid.SetZero();
+    primary.m_reportToEid.SetZero();
+    primary.m_creationTimestamp.secondsSinceStartOfYear2000 = TimestampUtil::GetSecondsSinceEpochRfc5050(boost::posix_time::microsec_clock::universal_time());
+    primary.m_creationTimestamp.sequenceNumber = sequence;
+    primary.m_lifetimeSeconds = 1000;
+    bv.m_primaryBlockView.SetManuallyModified();
+
+    std::unique_ptr<Bpv6CanonicalBlock> blockPtr = boost::make_unique<Bpv6CanonicalBlock>();
+    Bpv6CanonicalBlock& block = *blockPtr;
+    block.m_blockTypeCode = BPV6_BLOCK_TYPE_CODE::PAYLOAD;
+    block.m_blockProcessingControlFlags = BPV6_BLOCKFLAG::NO_FLAGS_SET;
+    block.m_blockTypeSpecificDataLength = payload.length();
+    block.m_blockTypeSpecificDataPtr = (uint8_t*)payload.data(); //payload must remain in scope until after render
+    bv.AppendMoveCanonicalBlock(std::move(blockPtr));
+    BOOST_REQUIRE(bv.Render(payload.size() + 1000));
+    bundleSerialized.assign(bv.m_frontBuffer.begin(), bv.m_frontBuffer.end());
+}
+
+//an aggregate custody signal (acs) to hdtn saying the next custodian accepted custody of the bundles with the given custody ids
+static void GenerateAcsBundleV6(const cbhe_eid_t& hdtnCustodyEid, const uint64_t firstCustodyId, const uint64_t lastCustodyId, std::vector<uint8_t>& bundleSerialized) {
+    BundleViewV6 bv;
+    Bpv6CbhePrimaryBlock& primary = bv.m_primaryBlockView.header;
+    primary.SetZero();
+    primary.m_bundleProcessingControlFlags = BPV6_BUNDLEFLAG::PRIORITY_EXPEDITED | BPV6_BUNDLEFLAG::SINGLETON | BPV6_BUNDLEFLAG::NOFRAGMENT | BPV6_BUNDLEFLAG::ADMINRECORD;
+    primary.m_sourceNodeId.Set(20, 0);
+    primary.m_destinationEid = hdtnCustodyEid;
+    primary.m_custodianEid.SetZero();
+    primary.m_reportToEid.SetZero();
+    primary.m_creationTimestamp.secondsSinceStartOfYear2000 = TimestampUtil::GetSecondsSinceEpochRfc5050(boost::posix_time::microsec_clock::universal_time());
+    primary.m_lifetimeSeconds = 1000;
+    bv.m_primaryBlockView.SetManuallyModified();
+
+    std::unique_ptr<Bpv6CanonicalBlock> blockPtr = boost::make_unique<Bpv6AdministrativeRecord>();
+    Bpv6AdministrativeRecord& block = *(reinterpret_cast<Bpv6AdministrativeRecord*>(blockPtr.get()));
+    block.m_blockProcessingControlFlags = BPV6_BLOCKFLAG::NO_FLAGS_SET;
+    block.m_adminRecordTypeCode = BPV6_ADMINISTRATIVE_RECORD_TYPE_CODE::AGGREGATE_CUSTODY_SIGNAL;
+    block.m_adminRecordContentPtr = boost::make_unique<Bpv6AdministrativeRecordContentAggregateCustodySignal>();
+    Bpv6AdministrativeRecordContentAggregateCustodySignal& acs = *(reinterpret_cast<Bpv6AdministrativeRecordContentAggregateCustodySignal*>(block.m_adminRecordContentPtr.get()));
+    acs.SetCustodyTransferStatusAndReason(true, BPV6_CUSTODY_SIGNAL_REASON_CODES_7BIT::NO_ADDITIONAL_INFORMATION);
+    acs.AddContiguousCustodyIdsToFill(firstCustodyId, lastCustodyId);
+    bv.AppendMoveCanonicalBlock(std::move(blockPtr));
+    BOOST_REQUIRE(bv.Render(1000));
+    bundleSerialized.assign(bv.m_frontBuffer.begin(), bv.m_frontBuffer.end());
+}
+
+//Bundles stored by storage are read from disk by its release workers and handed back to the storage thread,
+//which sends them to egress.  Ingress, egress, and router are played by this test over the hdtn-one-process inproc sockets.
+BOOST_AUTO_TEST_CASE(ZmqStorageInterfaceReleaseWorkerHandoffTestCase)
+{
+    static const uint64_t NUM_BUNDLES = 40;
+    static const uint64_t NEXT_HOP_NODE_IDS[2] = { 2, 3 }; //one per release worker (opportunistic links are sharded by next hop node id)
+
+    HdtnConfig_ptr hdtnConfigPtr = HdtnConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "hdtn" / "hdtn_ingress1tcpcl_port4556_egress1tcpcl_port4558flowid2.json");
+    BOOST_REQUIRE(hdtnConfigPtr);
+    StorageConfig_ptr storageConfigPtr = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+    BOOST_REQUIRE(storageConfigPtr);
+    hdtnConfigPtr->m_storageConfig = *storageConfigPtr;
+    hdtnConfigPtr->m_storageConfig.m_numReleaseWorkerThreads = 2;
+
+    zmq::context_t inprocContext;
+    zmq::socket_t storageToEgressSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t egressToStorageSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t storageToIngressSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t ingressToStorageSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t storageToRouterSock(inprocContext, zmq::socket_type::pair);
+    storageToEgressSock.bind(std::string("inproc://connecting_storage_to_bound_egress"));
+    egressToStorageSock.bind(std::string("inproc://bound_egress_to_connecting_storage"));
+    storageToIngressSock.bind(std::string("inproc://connecting_storage_to_bound_ingress"));
+    ingressToStorageSock.bind(std::string("inproc://bound_ingress_to_connecting_storage"));
+    storageToRouterSock.bind(std::string("inproc://connecting_storage_to_bound_router"));
+
+    std::unique_ptr<ZmqStorageInterface> storagePtr = boost::make_unique<ZmqStorageInterface>();
+    BOOST_REQUIRE(storagePtr->Init(*hdtnConfigPtr, HdtnDistributedConfig(), &inprocContext));
+
+    //egress is fully initialized (with no outducts) once storage has its outduct capabilities
+    {
+        hdtn::EgressAckHdr aoctHdr;
+        memset(&aoctHdr, 0, sizeof(aoctHdr));
+        aoctHdr.base.type = HDTN_MSGTYPE_ALL_OUTDUCT_CAPABILITIES_TELEMETRY;
+        const std::string aoctJson = AllOutductCapabilitiesTelemetry_t().ToJson();
+        BOOST_REQUIRE(egressToStorageSock.send(zmq::const_buffer(&aoctHdr, sizeof(aoctHdr)), zmq::send_flags::sndmore));
+        BOOST_REQUIRE(egressToStorageSock.send(zmq::const_buffer(aoctJson.data(), aoctJson.size()), zmq::send_flags::none));
+    }
+    //the bundles are released to opportunistic links added by ingress
+    for (unsigned int i = 0; i < 2; ++i) {
+        hdtn::ToStorageHdr addLinkHdr;
+        memset(&addLinkHdr, 0, sizeof(addLinkHdr));
+        addLinkHdr.base.type = HDTN_MSGTYPE_STORAGE_ADD_OPPORTUNISTIC_LINK;
+        addLinkHdr.ingressUniqueId = NEXT_HOP_NODE_IDS[i];
+        BOOST_REQUIRE(ingressToStorageSock.send(zmq::const_buffer(&addLinkHdr, sizeof(addLinkHdr)), zmq::send_flags::none));
+    }
+
+    std::map<uint64_t, std::vector<uint8_t> > mapSequenceToBundle;
+    for (uint64_t sequence = 0; sequence < NUM_BUNDLES; ++sequence) {
+        const uint64_t destNodeId = NEXT_HOP_NODE_IDS[sequence % 2];
+        const std::string payload((sequence % 3) ? 100 : 6000, static_cast<char>('a' + (sequence % 26))); //some span two segments
+        std::vector<uint8_t>& bundle = mapSequenceToBundle[sequence];
+        GenerateBundleV6(1, destNodeId, sequence, payload, bundle);
+
+        hdtn::ToStorageHdr storeHdr;
+        memset(&storeHdr, 0, sizeof(storeHdr));
+        storeHdr.base.type = HDTN_MSGTYPE_STORE;
+        storeHdr.ingressUniqueId = sequence;
+        storeHdr.outductIndex = UINT64_MAX;
+        storeHdr.finalDestEid.Set(destNodeId, 1);
+        BOOST_REQUIRE(ingressToStorageSock.send(zmq::const_buffer(&storeHdr, sizeof(storeHdr)), zmq::send_flags::sndmore));
+        BOOST_REQUIRE(ingressToStorageSock.send(zmq::const_buffer(bundle.data(), bundle.size()), zmq::send_flags::none));
+    }
+
+    //play egress: check every bundle sent from storage and ack it so that it is deleted and more are released
+    uint64_t numBundlesReceived = 0;
+    uint64_t numStorageAcksReceived = 0;
+    std::map<uint64_t, uint64_t> mapNextHopToNumReceived;
+    zmq::pollitem_t pollItems[2] = {
+        {storageToEgressSock.handle(), 0, ZMQ_POLLIN, 0},
+        {storageToIngressSock.handle(), 0, ZMQ_POLLIN, 0}
+    };
+    const boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(10);
+    while (((numBundlesReceived < NUM_BUNDLES) || (numStorageAcksReceived < NUM_BUNDLES))
+        && (boost::posix_time::microsec_clock::universal_time() < deadline))
+    {
+        if (zmq::poll(pollItems, 2, std::chrono::milliseconds(100)) <= 0) {
+            continue;
+        }
+        if (pollItems[0].revents & ZMQ_POLLIN) {
+            hdtn::ToEgressHdr toEgressHdr;
+            const zmq::recv_buffer_result_t res = storageToEgressSock.recv(zmq::mutable_buffer(&toEgressHdr, sizeof(toEgressHdr)), zmq::recv_flags::none);
+            BOOST_REQUIRE(res);
+            BOOST_REQUIRE_EQUAL(res->size, sizeof(toEgressHdr));
+            BOOST_REQUIRE_EQUAL(toEgressHdr.base.type, HDTN_MSGTYPE_EGRESS);
+            BOOST_REQUIRE(toEgressHdr.IsOpportunisticLink());
+            zmq::message_t bundleReceived;
+            BOOST_REQUIRE(storageToEgressSock.recv(bundleReceived, zmq::recv_flags::none));
+
+            BundleViewV6 bv;
+            BOOST_REQUIRE(bv.LoadBundle((uint8_t*)bundleReceived.data(), bundleReceived.size(), true));
+            const uint64_t sequence = bv.m_primaryBlockView.header.m_creationTimestamp.sequenceNumber;
+            std::map<uint64_t, std::vector<uint8_t> >::iterator it = mapSequenceToBundle.find(sequence);
+            BOOST_REQUIRE(it != mapSequenceToBundle.end()); //each bundle sent once
+            const std::vector<uint8_t>& bundleSent = it->second;
+            BOOST_REQUIRE_EQUAL(bundleReceived.size(), bundleSent.size());
+            BOOST_REQUIRE(memcmp(bundleReceived.data(), bundleSent.data(), bundleSent.size()) == 0);
+            BOOST_REQUIRE_EQUAL(toEgressHdr.nextHopNodeId, NEXT_HOP_NODE_IDS[sequence % 2]);
+            BOOST_REQUIRE_EQUAL(toEgressHdr.finalDestEid, cbhe_eid_t(NEXT_HOP_NODE_IDS[sequence % 2], 1));
+            BOOST_REQUIRE_EQUAL(toEgressHdr.hasCustody, 0);
+            mapSequenceToBundle.erase(it);
+            ++mapNextHopToNumReceived[toEgressHdr.nextHopNodeId];
+            ++numBundlesReceived;
+
+            hdtn::EgressAckHdr egressAckHdr;
+            memset(&egressAckHdr, 0, sizeof(egressAckHdr));
+            egressAckHdr.base.type = HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
+            egressAckHdr.error = hdtn::EGRESS_ACK_ERROR_TYPE::NO_ERRORS;
+            egressAckHdr.deleteNow = 1; //no custody
+            egressAckHdr.nextHopNodeId = toEgressHdr.nextHopNodeId;
+            egressAckHdr.finalDestEid = toEgressHdr.finalDestEid;
+            egressAckHdr.custodyId = toEgressHdr.custodyId;
+            egressAckHdr.outductIndex = toEgressHdr.outductIndex;
+            BOOST_REQUIRE(egressToStorageSock.send(zmq::const_buffer(&egressAckHdr, sizeof(egressAckHdr)), zmq::send_flags::none));
+        }
+        if (pollItems[1].revents & ZMQ_POLLIN) {
+            hdtn::StorageAckHdr storageAckHdr;
+            const zmq::recv_buffer_result_t res = storageToIngressSock.recv(zmq::mutable_buffer(&storageAckHdr, sizeof(storageAckHdr)), zmq::recv_flags::none);
+            BOOST_REQUIRE(res);
+            BOOST_REQUIRE_EQUAL(res->size, sizeof(storageAckHdr));
+            BOOST_REQUIRE_EQUAL(storageAckHdr.base.type, HDTN_MSGTYPE_STORAGE_ACK_TO_INGRESS);
+            BOOST_REQUIRE_EQUAL(storageAckHdr.error, 0);
+            ++numStorageAcksReceived;
+        }
+    }
+    BOOST_REQUIRE_EQUAL(numStorageAcksReceived, NUM_BUNDLES);
+    BOOST_REQUIRE_EQUAL(numBundlesReceived, NUM_BUNDLES);
+    BOOST_REQUIRE(mapSequenceToBundle.empty());
+    BOOST_REQUIRE_EQUAL(mapNextHopToNumReceived[NEXT_HOP_NODE_IDS[0]], NUM_BUNDLES / 2);
+    BOOST_REQUIRE_EQUAL(mapNextHopToNumReceived[NEXT_HOP_NODE_IDS[1]], NUM_BUNDLES / 2);
+
+    //the last egress acks are processed by the storage thread within its next poll
+    for (unsigned int attempt = 0; (attempt < 100) && (storagePtr->m_telemRef.m_totalBundlesErasedFromStorageNoCustodyTransfer < NUM_BUNDLES); ++attempt) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+    }
+    storagePtr->Stop();
+    BOOST_REQUIRE_EQUAL(storagePtr->m_telemRef.m_totalBundlesSentToEgressFromStorageReadFromDisk, NUM_BUNDLES);
+    BOOST_REQUIRE_EQUAL(storagePtr->m_telemRef.m_totalBundlesErasedFromStorageNoCustodyTransfer, NUM_BUNDLES);
+    storagePtr.reset();
+}
+
+//play ingress: send a bundle to storage and wait for storage to ack it
+static void StoreBundle(zmq::socket_t& ingressToStorageSock, zmq::socket_t& storageToIngressSock,
+    const uint64_t ingressUniqueId, const uint64_t destNodeId, const std::vector<uint8_t>& bundle, const bool isAdminRecord = false)
+{
+    hdtn::ToStorageHdr storeHdr;
+    memset(&storeHdr, 0, sizeof(storeHdr));
+    storeHdr.base.type = HDTN_MSGTYPE_STORE;
+    storeHdr.isCustodyOrAdminRecord = isAdminRecord;
+    storeHdr.ingressUniqueId = ingressUniqueId;
+    storeHdr.outductIndex = UINT64_MAX;
+    storeHdr.finalDestEid.Set(destNodeId, 1);
+    BOOST_REQUIRE(ingressToStorageSock.send(zmq::const_buffer(&storeHdr, sizeof(storeHdr)), zmq::send_flags::sndmore));
+    BOOST_REQUIRE(ingressToStorageSock.send(zmq::const_buffer(bundle.data(), bundle.size()), zmq::send_flags::none));
+
+    zmq::pollitem_t pollItem = { storageToIngressSock.handle(), 0, ZMQ_POLLIN, 0 };
+    BOOST_REQUIRE_EQUAL(zmq::poll(&pollItem, 1, std::chrono::milliseconds(5000)), 1);
+    hdtn::StorageAckHdr storageAckHdr;
+    const zmq::recv_buffer_result_t res = storageToIngressSock.recv(zmq::mutable_buffer(&storageAckHdr, sizeof(storageAckHdr)), zmq::recv_flags::none);
+    BOOST_REQUIRE(res);
+    BOOST_REQUIRE_EQUAL(res->size, sizeof(storageAckHdr));
+    BOOST_REQUIRE_EQUAL(storageAckHdr.base.type, HDTN_MSGTYPE_STORAGE_ACK_TO_INGRESS);
+    BOOST_REQUIRE_EQUAL(storageAckHdr.error, 0);
+    BOOST_REQUIRE_EQUAL(storageAckHdr.ingressUniqueId, ingressUniqueId);
+}
+
+//play router: publish a link change message for the outduct to storage
+static void PublishReleaseChange(zmq::socket_t& routerXPubSock, const uint16_t type, const uint64_t outductArrayIndex) {
+    hdtn::IreleaseChangeHdr releaseChangeHdr;
+    memset(&releaseChangeHdr, 0, sizeof(releaseChangeHdr));
+    releaseChangeHdr.SetSubscribeAll();
+    releaseChangeHdr.base.type = type;
+    releaseChangeHdr.outductArrayIndex = outductArrayIndex;
+    BOOST_REQUIRE(routerXPubSock.send(zmq::const_buffer(&releaseChangeHdr, sizeof(releaseChangeHdr)), zmq::send_flags::none));
+}
+
+//A bundle preloaded ahead of its outduct's contact is removed by a custody signal, and its custody id is then
+//reallocated to a new bundle.  Custody ids are allocated to each bundle source in blocks of 256, and a block is reused
+//once all of its custody ids are freed.  Once the contact begins, storage must release only the bundles still stored,
+//each with its own data, and never the removed bundle under the reused custody id.
+BOOST_AUTO_TEST_CASE(ZmqStorageInterfaceRemovePreloadedBundleTestCase)
+{
+    static const uint64_t NEXT_HOP_NODE_ID = 20;
+    static const uint64_t CUSTODY_ID_BLOCK_SIZE = 256;
+
+    std::vector<std::vector<uint8_t> > firstSourceBundles(CUSTODY_ID_BLOCK_SIZE); //from source node 1, given custody ids 0 to 255
+    for (uint64_t i = 0; i < firstSourceBundles.size(); ++i) {
+        GenerateBundleV6(1, NEXT_HOP_NODE_ID, i, std::string(100, 'a'), firstSourceBundles[i]);
+    }
+    std::vector<std::vector<uint8_t> > laterBundles(2); //from source nodes 2 and 3
+    for (uint64_t i = 0; i < laterBundles.size(); ++i) {
+        GenerateBundleV6(i + 2, NEXT_HOP_NODE_ID, i, std::string(200 + i, static_cast<char>('b' + i)), laterBundles[i]);
+    }
+
+    HdtnConfig_ptr hdtnConfigPtr = HdtnConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "hdtn" / "hdtn_ingress1tcpcl_port4556_egress1tcpcl_port4558flowid2.json");
+    BOOST_REQUIRE(hdtnConfigPtr);
+    StorageConfig_ptr storageConfigPtr = StorageConfig::CreateFromJsonFilePath(Environment::GetPathHdtnSourceRoot() / "config_files" / "storage" / "storageConfigRelativePaths.json");
+    BOOST_REQUIRE(storageConfigPtr);
+    hdtnConfigPtr->m_storageConfig = *storageConfigPtr;
+    hdtnConfigPtr->m_storageConfig.m_preloadMaxBytesPerOutduct = firstSourceBundles[0].size(); //preload only the first bundle
+    hdtnConfigPtr->m_storageConfig.m_preloadSecondsBeforeContact = 60;
+    const cbhe_eid_t hdtnCustodyEid(hdtnConfigPtr->m_myNodeId, hdtnConfigPtr->m_myCustodialServiceId);
+
+    zmq::context_t inprocContext;
+    zmq::socket_t storageToEgressSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t egressToStorageSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t storageToIngressSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t ingressToStorageSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t storageToRouterSock(inprocContext, zmq::socket_type::pair);
+    zmq::socket_t routerXPubSock(inprocContext, zmq::socket_type::xpub);
+    storageToEgressSock.bind(std::string("inproc://connecting_storage_to_bound_egress"));
+    egressToStorageSock.bind(std::string("inproc://bound_egress_to_connecting_storage"));
+    storageToIngressSock.bind(std::string("inproc://connecting_storage_to_bound_ingress"));
+    ingressToStorageSock.bind(std::string("inproc://bound_ingress_to_connecting_storage"));
+    storageToRouterSock.bind(std::string("inproc://connecting_storage_to_bound_router"));
+    routerXPubSock.set(zmq::sockopt::linger, 0);
+    routerXPubSock.bind(std::string("tcp://*:") + boost::lexical_cast<std::string>(hdtnConfigPtr->m_zmqBoundRouterPubSubPortPath));
+
+    std::unique_ptr<ZmqStorageInterface> storagePtr = boost::make_unique<ZmqStorageInterface>();
+    BOOST_REQUIRE(storagePtr->Init(*hdtnConfigPtr, HdtnDistributedConfig(), &inprocContext));
+
+    //wait for storage to subscribe so that no release change message is dropped
+    {
+        zmq::pollitem_t pollItem = { routerXPubSock.handle(), 0, ZMQ_POLLIN, 0 };
+        BOOST_REQUIRE_EQUAL(zmq::poll(&pollItem, 1, std::chrono::milliseconds(5000)), 1);
+        zmq::message_t subscriptionMessage;
+        BOOST_REQUIRE(routerXPubSock.recv(subscriptionMessage, zmq::recv_flags::none));
+        BOOST_REQUIRE_GE(subscriptionMessage.size(), 1);
+        BOOST_REQUIRE_EQUAL(static_cast<const uint8_t*>(subscriptionMessage.data())[0], 1); //subscribe
+    }
+
+    //egress is fully initialized with one outduct (whose link is down) to the next hop
+    {
+        AllOutductCapabilitiesTelemetry_t aoct;
+        aoct.outductCapabilityTelemetryList.emplace_back();
+        OutductCapabilityTelemetry_t& oct = aoct.outductCapabilityTelemetryList.back();
+        oct.outductArrayIndex = 0;
+        oct.maxBundlesInPipeline = 10;
+        oct.maxBundleSizeBytesInPipeline = 10000000;
+        oct.nextHopNodeId = NEXT_HOP_NODE_ID;
+        oct.finalDestinationNodeIdList.push_back(NEXT_HOP_NODE_ID);
+        hdtn::EgressAckHdr aoctHdr;
+        memset(&aoctHdr, 0, sizeof(aoctHdr));
+        aoctHdr.base.type = HDTN_MSGTYPE_ALL_OUTDUCT_CAPABILITIES_TELEMETRY;
+        const std::string aoctJson = aoct.ToJson();
+        BOOST_REQUIRE(egressToStorageSock.send(zmq::const_buffer(&aoctHdr, sizeof(aoctHdr)), zmq::send_flags::sndmore));
+        BOOST_REQUIRE(egressToStorageSock.send(zmq::const_buffer(aoctJson.data(), aoctJson.size()), zmq::send_flags::none));
+    }
+
+    //the first bundle of source node 1 is given custody id 0 and preloaded
+    for (uint64_t i = 0; i < firstSourceBundles.size(); ++i) {
+        StoreBundle(ingressToStorageSock, storageToIngressSock, i, NEXT_HOP_NODE_ID, firstSourceBundles[i]);
+    }
+    PublishReleaseChange(routerXPubSock, HDTN_MSGTYPE_IPRELOAD, 0);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(250)); //no reply to a preload, so give storage time to read the bundle
+
+    //the next custodian accepts custody of all of them (including the preloaded one), which frees custody ids 0 to 255
+    {
+        std::vector<uint8_t> acsBundle;
+        GenerateAcsBundleV6(hdtnCustodyEid, 0, CUSTODY_ID_BLOCK_SIZE - 1, acsBundle);
+        StoreBundle(ingressToStorageSock, storageToIngressSock, CUSTODY_ID_BLOCK_SIZE, hdtnCustodyEid.nodeId, acsBundle, true);
+        BOOST_REQUIRE_EQUAL(storagePtr->m_telemRef.m_totalBundlesErasedFromStorageWithCustodyTransfer, CUSTODY_ID_BLOCK_SIZE);
+    }
+
+    //the first bundle of source node 2 reserves the freed block of custody ids, so that the bundle of source node 3 is given custody id 0
+    for (uint64_t i = 0; i < laterBundles.size(); ++i) {
+        StoreBundle(ingressToStorageSock, storageToIngressSock, CUSTODY_ID_BLOCK_SIZE + 1 + i, NEXT_HOP_NODE_ID, laterBundles[i]);
+    }
+
+    //the contact begins: play egress and ack each bundle released
+    PublishReleaseChange(routerXPubSock, HDTN_MSGTYPE_ILINKUP, 0);
+    std::map<uint64_t, uint64_t> mapSrcNodeIdToNumReceived;
+    uint64_t numBundlesReceived = 0;
+    const boost::posix_time::ptime deadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(3);
+    while (boost::posix_time::microsec_clock::universal_time() < deadline) { //also wait for anything sent that should not have been
+        zmq::pollitem_t pollItem = { storageToEgressSock.handle(), 0, ZMQ_POLLIN, 0 };
+        if (zmq::poll(&pollItem, 1, std::chrono::milliseconds(100)) <= 0) {
+            if (numBundlesReceived >= 2) {
+                break;
+            }
+            continue;
+        }
+        hdtn::ToEgressHdr toEgressHdr;
+        const zmq::recv_buffer_result_t res = storageToEgressSock.recv(zmq::mutable_buffer(&toEgressHdr, sizeof(toEgressHdr)), zmq::recv_flags::none);
+        BOOST_REQUIRE(res);
+        BOOST_REQUIRE_EQUAL(res->size, sizeof(toEgressHdr));
+        BOOST_REQUIRE_EQUAL(toEgressHdr.base.type, HDTN_MSGTYPE_EGRESS);
+        zmq::message_t bundleReceived;
+        BOOST_REQUIRE(storageToEgressSock.recv(bundleReceived, zmq::recv_flags::none));
+
+        BundleViewV6 bv;
+        BOOST_REQUIRE(bv.LoadBundle((uint8_t*)bundleReceived.data(), bundleReceived.size(), true));
+        const uint64_t srcNodeId = bv.m_primaryBlockView.header.m_sourceNodeId.nodeId;
+        BOOST_REQUIRE_NE(srcNodeId, 1); //removed
+        BOOST_REQUIRE_LT(srcNodeId - 2, laterBundles.size());
+        const std::vector<uint8_t>& bundleSent = laterBundles[srcNodeId - 2];
+        BOOST_REQUIRE_EQUAL(bundleReceived.size(), bundleSent.size());
+        BOOST_REQUIRE(memcmp(bundleReceived.data(), bundleSent.data(), bundleSent.size()) == 0);
+        BOOST_REQUIRE_EQUAL(toEgressHdr.outductIndex, 0);
+        ++mapSrcNodeIdToNumReceived[srcNodeId];
+        ++numBundlesReceived;
+
+        hdtn::EgressAckHdr egressAckHdr;
+        memset(&egressAckHdr, 0, sizeof(egressAckHdr));
+        egressAckHdr.base.type = HDTN_MSGTYPE_EGRESS_ACK_TO_STORAGE;
+        egressAckHdr.error = hdtn::EGRESS_ACK_ERROR_TYPE::NO_ERRORS;
+        egressAckHdr.deleteNow = 1; //no custody
+        egressAckHdr.nextHopNodeId = toEgressHdr.nextHopNodeId;
+        egressAckHdr.finalDestEid = toEgressHdr.finalDestEid;
+        egressAckHdr.custodyId = toEgressHdr.custodyId;
+        egressAckHdr.outductIndex = toEgressHdr.outductIndex;
+        BOOST_REQUIRE(egressToStorageSock.send(zmq::const_buffer(&egressAckHdr, sizeof(egressAckHdr)), zmq::send_flags::none));
+    }
+    BOOST_REQUIRE_EQUAL(numBundlesReceived, 2);
+    BOOST_REQUIRE_EQUAL(mapSrcNodeIdToNumReceived[2], 1);
+    BOOST_REQUIRE_EQUAL(mapSrcNodeIdToNumReceived[3], 1);
+
+    storagePtr->Stop();
+    storagePtr.reset();
+}
@@ -431,7 +431,10 @@ var STORAGE_TELEM_UPDATE = {
     "totalBundleEraseOperationsFromDisk": 130,
     "totalBundleByteEraseOperationsFromDisk": 140,
     "usedSpaceBytes": 0,
-    "freeSpaceBytes": 1000
+    "freeSpaceBytes": 1000,
+    "totalBytesReclaimedFromDisk": 0,
+    "totalDiskSpaceReclaimOperations": 0,
+    "diskThroughputBytesPerSecond": [0, 0]
 };
 
 var AOCT = {